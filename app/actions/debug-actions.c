@@ -54,6 +54,21 @@ static const GimpActionEntry debug_actions[] =
     debug_benchmark_projection_cmd_callback,
     NULL },
 
+  { "debug-benchmark-async", NULL,
+    "Benchmark _Async Tasks", NULL,
+    "Runs a batch of small and a batch of large async tasks through the "
+    "thread pool, and prints their throughput and latency to stdout.",
+    debug_benchmark_async_cmd_callback,
+    NULL },
+
+  { "debug-benchmark-layer-stack", NULL,
+    "Benchmark _Layer Stack", NULL,
+    "Composites a stack of random layers using a chain of layer-mode nodes, "
+    "and using a single fused layer-stack node, and prints their timings "
+    "to stdout.",
+    debug_benchmark_layer_stack_cmd_callback,
+    NULL },
+
   { "debug-show-image-graph", NULL,
     "Show Image _Graph", NULL,
     "Creates a new image showing the GEGL graph of this image",
@@ -17,24 +17,32 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <gegl.h>
 #include <gtk/gtk.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "actions-types.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimp-utils.h"
+#include "core/gimpasync.h"
 #include "core/gimpcontext.h"
 #include "core/gimpimage.h"
 #include "core/gimpprojectable.h"
 #include "core/gimpprojection.h"
+#include "core/gimpwaitable.h"
 
+#include "gegl/gimp-gegl-nodes.h"
 #include "gegl/gimp-gegl-utils.h"
 
+#include "operations/layer-modes/gimpoperationlayerstack.h"
+
 #include "widgets/gimpaction.h"
 #include "widgets/gimpactiongroup.h"
 #include "widgets/gimpmenufactory.h"
@@ -50,9 +58,39 @@
 #include "debug-commands.h"
 
 
+#define DEBUG_BENCHMARK_ASYNC_N_SMALL_TASKS      10000
+#define DEBUG_BENCHMARK_ASYNC_SMALL_TASK_SIZE    1000
+#define DEBUG_BENCHMARK_ASYNC_N_LARGE_TASKS      200
+#define DEBUG_BENCHMARK_ASYNC_LARGE_TASK_SIZE    5000000
+
+#define DEBUG_BENCHMARK_LAYER_STACK_N_LAYERS     16
+#define DEBUG_BENCHMARK_LAYER_STACK_IMAGE_SIZE   2048
+#define DEBUG_BENCHMARK_LAYER_STACK_LAYER_SIZE   1024
+
+
+typedef struct
+{
+  gint   size;
+  gint64 start_time;
+  gint64 end_time;
+} DebugAsyncTask;
+
+
 /*  local function prototypes  */
 
 static gboolean  debug_benchmark_projection    (GimpDisplay *display);
+static gboolean  debug_benchmark_async         (Gimp        *gimp);
+static void      debug_benchmark_async_run     (const gchar *name,
+                                                gint         n_tasks,
+                                                gint         size);
+static void      debug_benchmark_async_func    (GimpAsync      *async,
+                                                DebugAsyncTask *task);
+static gint      debug_benchmark_async_compare (const gint64   *latency1,
+                                                const gint64   *latency2);
+static gboolean  debug_benchmark_layer_stack   (Gimp        *gimp);
+static gdouble   debug_benchmark_layer_stack_blit
+                                               (GeglNode    *node,
+                                                GeglBuffer  *buffer);
 static gboolean  debug_show_image_graph        (GimpImage   *source_image);
 
 static void      debug_dump_menus_recurse_menu (GtkWidget   *menu,
@@ -106,6 +144,28 @@ debug_benchmark_projection_cmd_callback (GimpAction *action,
   g_idle_add ((GSourceFunc) debug_benchmark_projection, g_object_ref (display));
 }
 
+void
+debug_benchmark_async_cmd_callback (GimpAction *action,
+                                    GVariant   *value,
+                                    gpointer    data)
+{
+  Gimp *gimp;
+  return_if_no_gimp (gimp, data);
+
+  g_idle_add ((GSourceFunc) debug_benchmark_async, gimp);
+}
+
+void
+debug_benchmark_layer_stack_cmd_callback (GimpAction *action,
+                                          GVariant   *value,
+                                          gpointer    data)
+{
+  Gimp *gimp;
+  return_if_no_gimp (gimp, data);
+
+  g_idle_add ((GSourceFunc) debug_benchmark_layer_stack, gimp);
+}
+
 void
 debug_show_image_graph_cmd_callback (GimpAction *action,
                                      GVariant   *value,
@@ -317,6 +377,259 @@ debug_benchmark_projection (GimpDisplay *display)
   return FALSE;
 }
 
+static gboolean
+debug_benchmark_async (Gimp *gimp)
+{
+  debug_benchmark_async_run ("small tasks",
+                             DEBUG_BENCHMARK_ASYNC_N_SMALL_TASKS,
+                             DEBUG_BENCHMARK_ASYNC_SMALL_TASK_SIZE);
+  debug_benchmark_async_run ("large tasks",
+                             DEBUG_BENCHMARK_ASYNC_N_LARGE_TASKS,
+                             DEBUG_BENCHMARK_ASYNC_LARGE_TASK_SIZE);
+
+  return FALSE;
+}
+
+static void
+debug_benchmark_async_run (const gchar *name,
+                           gint         n_tasks,
+                           gint         size)
+{
+  DebugAsyncTask  *tasks;
+  GimpAsync      **asyncs;
+  gint64          *latencies;
+  gint64           start_time;
+  gdouble          total_time;
+  gint             i;
+
+  tasks     = g_new0 (DebugAsyncTask, n_tasks);
+  asyncs    = g_new (GimpAsync *, n_tasks);
+  latencies = g_new (gint64, n_tasks);
+
+  start_time = g_get_monotonic_time ();
+
+  for (i = 0; i < n_tasks; i++)
+    {
+      tasks[i].size       = size;
+      tasks[i].start_time = g_get_monotonic_time ();
+
+      asyncs[i] = gimp_parallel_run_async (
+        (GimpRunAsyncFunc) debug_benchmark_async_func,
+        &tasks[i]);
+    }
+
+  for (i = 0; i < n_tasks; i++)
+    {
+      gimp_waitable_wait (GIMP_WAITABLE (asyncs[i]));
+
+      g_object_unref (asyncs[i]);
+    }
+
+  total_time = (g_get_monotonic_time () - start_time) / 1000000.0;
+
+  for (i = 0; i < n_tasks; i++)
+    latencies[i] = tasks[i].end_time - tasks[i].start_time;
+
+  qsort (latencies, n_tasks, sizeof (gint64),
+         (GCompareFunc) debug_benchmark_async_compare);
+
+  g_print ("Async %s: %d tasks in %0.4f seconds (%0.1f tasks/s), "
+           "latency: median %0.3f ms, 99%% %0.3f ms, max %0.3f ms\n",
+           name, n_tasks, total_time, n_tasks / total_time,
+           latencies[n_tasks / 2]             / 1000.0,
+           latencies[(gint) (n_tasks * 0.99)] / 1000.0,
+           latencies[n_tasks - 1]             / 1000.0);
+
+  g_free (latencies);
+  g_free (asyncs);
+  g_free (tasks);
+}
+
+static void
+debug_benchmark_async_func (GimpAsync      *async,
+                            DebugAsyncTask *task)
+{
+  volatile guint32 hash = 0;
+  gint             i;
+
+  for (i = 0; i < task->size; i++)
+    hash = hash * 31 + i;
+
+  task->end_time = g_get_monotonic_time ();
+
+  gimp_async_finish (async, NULL);
+}
+
+static gint
+debug_benchmark_async_compare (const gint64 *latency1,
+                               const gint64 *latency2)
+{
+  if (*latency1 < *latency2)
+    return -1;
+  else if (*latency1 > *latency2)
+    return 1;
+  else
+    return 0;
+}
+
+static gboolean
+debug_benchmark_layer_stack (Gimp *gimp)
+{
+  static const GimpLayerMode modes[] =
+  {
+    GIMP_LAYER_MODE_NORMAL,
+    GIMP_LAYER_MODE_MULTIPLY,
+    GIMP_LAYER_MODE_SCREEN,
+    GIMP_LAYER_MODE_OVERLAY,
+    GIMP_LAYER_MODE_ADDITION,
+    GIMP_LAYER_MODE_DIFFERENCE,
+    GIMP_LAYER_MODE_SOFTLIGHT,
+    GIMP_LAYER_MODE_HSV_HUE,
+    GIMP_LAYER_MODE_LCH_COLOR
+  };
+
+  GimpOperationLayerStackLayer  layers[DEBUG_BENCHMARK_LAYER_STACK_N_LAYERS];
+  GeglNode                     *graph;
+  GeglNode                     *chain = NULL;
+  GeglNode                     *stack;
+  GeglBuffer                   *chain_buffer;
+  GeglBuffer                   *stack_buffer;
+  GeglBufferIterator           *iter;
+  GRand                        *rand;
+  gfloat                       *data;
+  const gint                    layer_size = DEBUG_BENCHMARK_LAYER_STACK_LAYER_SIZE;
+  const gint                    image_size = DEBUG_BENCHMARK_LAYER_STACK_IMAGE_SIZE;
+  gdouble                       chain_time;
+  gdouble                       stack_time;
+  gfloat                        max_diff   = 0.0f;
+  gint                          i;
+  gint                          j;
+
+  rand = g_rand_new_with_seed (0);
+  data = g_new (gfloat, 4 * layer_size * layer_size);
+
+  graph = gegl_node_new ();
+
+  for (i = 0; i < DEBUG_BENCHMARK_LAYER_STACK_N_LAYERS; i++)
+    {
+      GimpOperationLayerStackLayer *layer = &layers[i];
+      GeglNode                     *source;
+      GeglNode                     *offset;
+      GeglNode                     *mode;
+
+      for (j = 0; j < 4 * layer_size * layer_size; j++)
+        data[j] = g_rand_double (rand);
+
+      layer->buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                       layer_size, layer_size),
+                                       babl_format ("R'G'B'A float"));
+      gegl_buffer_set (layer->buffer, NULL, 0, NULL,
+                       data, GEGL_AUTO_ROWSTRIDE);
+
+      layer->mask            = NULL;
+      layer->offset_x        = g_rand_int_range (rand,
+                                                 0, image_size - layer_size);
+      layer->offset_y        = g_rand_int_range (rand,
+                                                 0, image_size - layer_size);
+      layer->mode            = modes[i % G_N_ELEMENTS (modes)];
+      layer->blend_space     = GIMP_LAYER_COLOR_SPACE_AUTO;
+      layer->composite_space = GIMP_LAYER_COLOR_SPACE_AUTO;
+      layer->composite_mode  = GIMP_LAYER_COMPOSITE_AUTO;
+      layer->opacity         = g_rand_double_range (rand, 0.5, 1.0);
+
+      /* the same graph a layer stack would otherwise build */
+      source = gegl_node_new_child (graph,
+                                    "operation", "gegl:buffer-source",
+                                    "buffer",    layer->buffer,
+                                    NULL);
+      offset = gegl_node_new_child (graph,
+                                    "operation", "gegl:translate",
+                                    "x",         (gdouble) layer->offset_x,
+                                    "y",         (gdouble) layer->offset_y,
+                                    NULL);
+      mode   = gegl_node_new_child (graph,
+                                    "operation", "gimp:normal",
+                                    NULL);
+
+      gimp_gegl_mode_node_set_mode (mode,
+                                    layer->mode,
+                                    layer->blend_space,
+                                    layer->composite_space,
+                                    layer->composite_mode);
+      gimp_gegl_mode_node_set_opacity (mode, layer->opacity);
+
+      gegl_node_link (source, offset);
+      gegl_node_connect_to (offset, "output",
+                            mode,   "aux");
+
+      if (chain)
+        gegl_node_link (chain, mode);
+
+      chain = mode;
+    }
+
+  stack = gegl_node_new_child (graph,
+                               "operation", "gimp:layer-stack",
+                               NULL);
+  gimp_operation_layer_stack_set_layers (stack, layers,
+                                         DEBUG_BENCHMARK_LAYER_STACK_N_LAYERS);
+
+  chain_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, image_size, image_size),
+                                  babl_format ("RGBA float"));
+  stack_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, image_size, image_size),
+                                  babl_format ("RGBA float"));
+
+  chain_time = debug_benchmark_layer_stack_blit (chain, chain_buffer);
+  stack_time = debug_benchmark_layer_stack_blit (stack, stack_buffer);
+
+  iter = gegl_buffer_iterator_new (chain_buffer, NULL, 0, NULL,
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
+  gegl_buffer_iterator_add (iter, stack_buffer, NULL, 0, NULL,
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const gfloat *chain_data = iter->items[0].data;
+      const gfloat *stack_data = iter->items[1].data;
+
+      for (j = 0; j < 4 * iter->length; j++)
+        max_diff = MAX (max_diff, fabsf (chain_data[j] - stack_data[j]));
+    }
+
+  g_print ("Layer stack: %d layers of %dx%d, "
+           "chain %0.4f seconds, fused %0.4f seconds (%0.2fx), "
+           "max difference %g\n",
+           DEBUG_BENCHMARK_LAYER_STACK_N_LAYERS, layer_size, layer_size,
+           chain_time, stack_time, chain_time / stack_time,
+           max_diff);
+
+  g_object_unref (stack_buffer);
+  g_object_unref (chain_buffer);
+
+  g_object_unref (graph);
+
+  for (i = 0; i < DEBUG_BENCHMARK_LAYER_STACK_N_LAYERS; i++)
+    g_object_unref (layers[i].buffer);
+
+  g_free (data);
+  g_rand_free (rand);
+
+  return FALSE;
+}
+
+static gdouble
+debug_benchmark_layer_stack_blit (GeglNode   *node,
+                                  GeglBuffer *buffer)
+{
+  gint64 start_time;
+
+  start_time = g_get_monotonic_time ();
+
+  gegl_node_blit_buffer (node, buffer, NULL, 0, GEGL_ABYSS_NONE);
+
+  return (g_get_monotonic_time () - start_time) / 1000000.0;
+}
+
 static gboolean
 debug_show_image_graph (GimpImage *source_image)
 {
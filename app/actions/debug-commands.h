@@ -28,6 +28,12 @@ void   debug_mem_profile_cmd_callback             (GimpAction *action,
 void   debug_benchmark_projection_cmd_callback    (GimpAction *action,
                                                    GVariant   *value,
                                                    gpointer    data);
+void   debug_benchmark_async_cmd_callback         (GimpAction *action,
+                                                   GVariant   *value,
+                                                   gpointer    data);
+void   debug_benchmark_layer_stack_cmd_callback   (GimpAction *action,
+                                                   GVariant   *value,
+                                                   gpointer    data);
 void   debug_show_image_graph_cmd_callback        (GimpAction *action,
                                                    GVariant   *value,
                                                    gpointer    data);
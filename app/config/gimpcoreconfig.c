@@ -121,6 +121,9 @@ enum
   PROP_IMPORT_PROMOTE_DITHER,
   PROP_IMPORT_ADD_ALPHA,
   PROP_IMPORT_RAW_PLUG_IN,
+  PROP_XCF_LAZY_LOADING,
+  PROP_XCF_ZSTD_COMPRESSION,
+  PROP_DATA_LAZY_LOADING,
   PROP_EXPORT_FILE_TYPE,
   PROP_EXPORT_COLOR_PROFILE,
   PROP_EXPORT_COMMENT,
@@ -768,6 +771,28 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                          GIMP_PARAM_STATIC_STRINGS |
                          GIMP_CONFIG_PARAM_RESTART);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                            "xcf-lazy-loading",
+                            "XCF lazy loading",
+                            XCF_LAZY_LOADING_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_ZSTD_COMPRESSION,
+                            "xcf-zstd-compression",
+                            "XCF zstd compression",
+                            XCF_ZSTD_COMPRESSION_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_DATA_LAZY_LOADING,
+                            "data-lazy-loading",
+                            "Data lazy loading",
+                            DATA_LAZY_LOADING_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS |
+                            GIMP_CONFIG_PARAM_RESTART);
+
   GIMP_CONFIG_PROP_ENUM (object_class, PROP_EXPORT_FILE_TYPE,
                          "export-file-type",
                          "Default export file type",
@@ -1142,6 +1167,15 @@ gimp_core_config_set_property (GObject      *object,
       g_free (core_config->import_raw_plug_in);
       core_config->import_raw_plug_in = g_value_dup_string (value);
       break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_ZSTD_COMPRESSION:
+      core_config->xcf_zstd_compression = g_value_get_boolean (value);
+      break;
+    case PROP_DATA_LAZY_LOADING:
+      core_config->data_lazy_loading = g_value_get_boolean (value);
+      break;
     case PROP_EXPORT_FILE_TYPE:
       core_config->export_file_type = g_value_get_enum (value);
       break;
@@ -1371,6 +1405,15 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_IMPORT_RAW_PLUG_IN:
       g_value_set_string (value, core_config->import_raw_plug_in);
       break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
+    case PROP_XCF_ZSTD_COMPRESSION:
+      g_value_set_boolean (value, core_config->xcf_zstd_compression);
+      break;
+    case PROP_DATA_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->data_lazy_loading);
+      break;
     case PROP_EXPORT_FILE_TYPE:
       g_value_set_enum (value, core_config->export_file_type);
       break;
@@ -96,6 +96,9 @@ struct _GimpCoreConfig
   gboolean                import_promote_dither;
   gboolean                import_add_alpha;
   gchar                  *import_raw_plug_in;
+  gboolean                xcf_lazy_loading;
+  gboolean                xcf_zstd_compression;
+  gboolean                data_lazy_loading;
   GimpExportFileType      export_file_type;
   gboolean                export_color_profile;
   gboolean                export_comment;
@@ -217,6 +217,23 @@ _("Add an alpha channel to all layers of imported images.")
 #define IMPORT_RAW_PLUG_IN_BLURB \
 _("Which plug-in to use for importing raw digital camera files.")
 
+#define XCF_LAZY_LOADING_BLURB \
+_("When opening XCF files, map the file into memory and decode the pixel " \
+  "data only when it is first needed.  Files on remote filesystems are " \
+  "always read completely.  The file must not be truncated or overwritten " \
+  "in place by other programs while the image is open, or GIMP will " \
+  "crash.")
+
+#define XCF_ZSTD_COMPRESSION_BLURB \
+_("When saving XCF files with compression, use zstd instead of zlib.  It is " \
+  "faster, but the files can only be opened by GIMP 3.0 and later.  Has no " \
+  "effect if GIMP was built without zstd support.")
+
+#define DATA_LAZY_LOADING_BLURB \
+_("When loading brushes and patterns, only read their headers, and decode " \
+  "their pixels when they are first used.  Pixels which haven't been used " \
+  "for a while are dropped again when too many are loaded.")
+
 #define EXPORT_FILE_TYPE_BLURB \
 _("Export file type used by default.")
 
@@ -228,6 +228,7 @@ typedef struct _GimpWaitable                    GimpWaitable;    /* dummy typede
 /*  non-object types  */
 
 typedef struct _GimpBacktrace                   GimpBacktrace;
+typedef struct _GimpBoundaryCache               GimpBoundaryCache;
 typedef struct _GimpBoundSeg                    GimpBoundSeg;
 typedef struct _GimpChunkIterator               GimpChunkIterator;
 typedef struct _GimpCoords                      GimpCoords;
@@ -235,6 +236,7 @@ typedef struct _GimpGradientSegment             GimpGradientSegment;
 typedef struct _GimpPaletteEntry                GimpPaletteEntry;
 typedef struct _GimpScanConvert                 GimpScanConvert;
 typedef struct _GimpTempBuf                     GimpTempBuf;
+typedef struct _GimpTileDelta                   GimpTileDelta;
 typedef         guint32                         GimpTattoo;
 
 /* The following hack is made so that we can reuse the definition
@@ -76,12 +76,12 @@ gimp_data_factories_init (Gimp *gimp)
                                "brush factory");
   gimp_data_loader_factory_add_loader (gimp->brush_factory,
                                        "GIMP Brush",
-                                       gimp_brush_load,
+                                       gimp_brush_load_lazy,
                                        GIMP_BRUSH_FILE_EXTENSION,
                                        TRUE);
   gimp_data_loader_factory_add_loader (gimp->brush_factory,
                                        "GIMP Brush Pixmap",
-                                       gimp_brush_load,
+                                       gimp_brush_load_lazy,
                                        GIMP_BRUSH_PIXMAP_FILE_EXTENSION,
                                        FALSE);
   gimp_data_loader_factory_add_loader (gimp->brush_factory,
@@ -149,7 +149,7 @@ gimp_data_factories_init (Gimp *gimp)
                                "pattern factory");
   gimp_data_loader_factory_add_loader (gimp->pattern_factory,
                                        "GIMP Pattern",
-                                       gimp_pattern_load,
+                                       gimp_pattern_load_lazy,
                                        GIMP_PATTERN_FILE_EXTENSION,
                                        TRUE);
   gimp_data_loader_factory_add_fallback (gimp->pattern_factory,
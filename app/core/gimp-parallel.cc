@@ -46,7 +46,7 @@ extern "C"
 
 
 #define GIMP_PARALLEL_MAX_THREADS           64
-#define GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS  1
+#define GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS GIMP_PARALLEL_MAX_THREADS
 
 
 typedef struct
@@ -61,10 +61,23 @@ typedef struct
 typedef struct
 {
   GThread   *thread;
+  gint       index;
 
   gboolean   quit;
 
   GimpAsync *current_async;
+
+  /* the thread's own task queue, sorted by priority.  tasks are popped
+   * from the head by the owning thread, and stolen from the head by idle
+   * threads whose own queue is empty.  'mutex' protects 'queue',
+   * 'current_async' and 'stopped'; 'n_tasks' mirrors the queue length,
+   * and may be read without locking.  once the thread is stopped, and its
+   * queue drained, no more tasks may be added to it.
+   */
+  GMutex     mutex;
+  GQueue     queue;
+  gint       n_tasks;
+  gboolean   stopped;
 } GimpParallelRunAsyncThread;
 
 
@@ -78,8 +91,14 @@ static void                       gimp_parallel_set_n_threads           (gint
 static void                       gimp_parallel_run_async_set_n_threads (gint                        n_threads,
                                                                          gboolean                    finish_tasks);
 static gpointer                   gimp_parallel_run_async_thread_func   (GimpParallelRunAsyncThread *thread);
-static void                       gimp_parallel_run_async_enqueue_task  (GimpParallelRunAsyncTask   *task);
-static GimpParallelRunAsyncTask * gimp_parallel_run_async_dequeue_task  (void);
+static void                       gimp_parallel_run_async_run_task      (GimpParallelRunAsyncThread *thread,
+                                                                         GimpParallelRunAsyncTask   *task);
+static void                       gimp_parallel_run_async_enqueue_task  (GimpParallelRunAsyncThread *thread,
+                                                                         GimpParallelRunAsyncTask   *task);
+static GimpParallelRunAsyncTask * gimp_parallel_run_async_dequeue_task  (GimpParallelRunAsyncThread *thread);
+static GimpParallelRunAsyncTask * gimp_parallel_run_async_steal_task    (GimpParallelRunAsyncThread *thief);
+static GList                    * gimp_parallel_run_async_lock_task     (GimpAsync                  *async,
+                                                                         GimpParallelRunAsyncThread **thread);
 static gboolean                   gimp_parallel_run_async_execute_task  (GimpParallelRunAsyncTask   *task);
 static void                       gimp_parallel_run_async_abort_task    (GimpParallelRunAsyncTask   *task);
 static void                       gimp_parallel_run_async_cancel        (GimpAsync                  *async);
@@ -90,10 +109,14 @@ static void                       gimp_parallel_run_async_waiting       (GimpAsy
 
 static gint                       gimp_parallel_run_async_n_threads = 0;
 static GimpParallelRunAsyncThread gimp_parallel_run_async_threads[GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS];
+static GPrivate                   gimp_parallel_run_async_current_thread = G_PRIVATE_INIT (NULL);
+
+static gint                       gimp_parallel_run_async_n_tasks   = 0;
+static gint                       gimp_parallel_run_async_n_idle    = 0;
+static gint                       gimp_parallel_run_async_next      = 0;
 
 static GMutex                     gimp_parallel_run_async_mutex;
 static GCond                      gimp_parallel_run_async_cond;
-static GQueue                     gimp_parallel_run_async_queue = G_QUEUE_INIT;
 
 
 /*  public functions  */
@@ -143,6 +166,7 @@ gimp_parallel_run_async_full (gint             priority,
 {
   GimpAsync                *async;
   GimpParallelRunAsyncTask *task;
+  gint                      n_threads;
 
   g_return_val_if_fail (func != NULL, NULL);
 
@@ -156,8 +180,12 @@ gimp_parallel_run_async_full (gint             priority,
   task->user_data              = user_data;
   task->user_data_destroy_func = user_data_destroy_func;
 
-  if (gimp_parallel_run_async_n_threads > 0)
+  n_threads = g_atomic_int_get (&gimp_parallel_run_async_n_threads);
+
+  if (n_threads > 0)
     {
+      GimpParallelRunAsyncThread *thread;
+
       g_signal_connect_after (async, "cancel",
                               G_CALLBACK (gimp_parallel_run_async_cancel),
                               NULL);
@@ -165,13 +193,23 @@ gimp_parallel_run_async_full (gint             priority,
                               G_CALLBACK (gimp_parallel_run_async_waiting),
                               NULL);
 
-      g_mutex_lock (&gimp_parallel_run_async_mutex);
+      /* tasks spawned by a worker thread go to the thread's own queue,
+       * other tasks are distributed round-robin.  idle threads steal
+       * whatever ends up unbalanced.
+       */
+      thread = (GimpParallelRunAsyncThread *)
+        g_private_get (&gimp_parallel_run_async_current_thread);
 
-      gimp_parallel_run_async_enqueue_task (task);
+      if (! thread)
+        {
+          guint next;
 
-      g_cond_signal (&gimp_parallel_run_async_cond);
+          next = (guint) g_atomic_int_add (&gimp_parallel_run_async_next, 1);
 
-      g_mutex_unlock (&gimp_parallel_run_async_mutex);
+          thread = &gimp_parallel_run_async_threads[next % n_threads];
+        }
+
+      gimp_parallel_run_async_enqueue_task (thread, task);
     }
   else
     {
@@ -282,16 +320,28 @@ gimp_parallel_run_async_set_n_threads (gint     n_threads,
           GimpParallelRunAsyncThread *thread =
             &gimp_parallel_run_async_threads[i];
 
-          thread->quit = FALSE;
+          thread->index = i;
+          thread->quit  = FALSE;
+
+          g_mutex_lock (&thread->mutex);
+
+          thread->stopped = FALSE;
+
+          g_mutex_unlock (&thread->mutex);
 
           thread->thread = g_thread_new (
             "async",
             (GThreadFunc) gimp_parallel_run_async_thread_func,
             thread);
         }
+
+      g_atomic_int_set (&gimp_parallel_run_async_n_threads, n_threads);
     }
   else if (n_threads < gimp_parallel_run_async_n_threads) /* need less threads */
     {
+      gint old_n_threads = gimp_parallel_run_async_n_threads;
+      gint j             = 0;
+
       g_mutex_lock (&gimp_parallel_run_async_mutex);
 
       for (i = n_threads; i < gimp_parallel_run_async_n_threads; i++)
@@ -299,10 +349,7 @@ gimp_parallel_run_async_set_n_threads (gint     n_threads,
           GimpParallelRunAsyncThread *thread =
             &gimp_parallel_run_async_threads[i];
 
-          thread->quit = TRUE;
-
-          if (thread->current_async && ! finish_tasks)
-            gimp_cancelable_cancel (GIMP_CANCELABLE (thread->current_async));
+          g_atomic_int_set (&thread->quit, TRUE);
         }
 
       g_cond_broadcast (&gimp_parallel_run_async_cond);
@@ -313,24 +360,73 @@ gimp_parallel_run_async_set_n_threads (gint     n_threads,
         {
           GimpParallelRunAsyncThread *thread =
             &gimp_parallel_run_async_threads[i];
+          GimpAsync                  *current_async = NULL;
 
-          g_thread_join (thread->thread);
+          if (! finish_tasks)
+            {
+              g_mutex_lock (&thread->mutex);
+
+              if (thread->current_async)
+                current_async = GIMP_ASYNC (g_object_ref (thread->current_async));
+
+              g_mutex_unlock (&thread->mutex);
+            }
+
+          if (current_async)
+            {
+              gimp_cancelable_cancel (GIMP_CANCELABLE (current_async));
+
+              g_object_unref (current_async);
+            }
         }
-    }
 
-  gimp_parallel_run_async_n_threads = n_threads;
+      for (i = n_threads; i < gimp_parallel_run_async_n_threads; i++)
+        {
+          GimpParallelRunAsyncThread *thread =
+            &gimp_parallel_run_async_threads[i];
 
-  if (n_threads == 0)
-    {
-      GimpParallelRunAsyncTask *task;
+          g_thread_join (thread->thread);
+        }
 
-      /* finish remaining tasks */
-      while ((task = gimp_parallel_run_async_dequeue_task ()))
+      /* from now on, new tasks only go to the remaining threads */
+      g_atomic_int_set (&gimp_parallel_run_async_n_threads, n_threads);
+
+      /* move the tasks of the stopped threads to the remaining threads, or
+       * finish them here if there are no threads left.  a task may still be
+       * on its way to a stopped thread, by a caller that read the thread
+       * count before it was updated; marking the thread as stopped under
+       * its lock makes gimp_parallel_run_async_enqueue_task() redirect the
+       * task instead, once we're about to drain the queue.
+       */
+      for (i = n_threads; i < old_n_threads; i++)
         {
-          if (finish_tasks)
-            while (gimp_parallel_run_async_execute_task (task));
-          else
-            gimp_parallel_run_async_abort_task (task);
+          GimpParallelRunAsyncThread *thread =
+            &gimp_parallel_run_async_threads[i];
+          GimpParallelRunAsyncTask   *task;
+
+          g_mutex_lock (&thread->mutex);
+
+          thread->stopped = TRUE;
+
+          g_mutex_unlock (&thread->mutex);
+
+          while ((task = gimp_parallel_run_async_dequeue_task (thread)))
+            {
+              if (n_threads > 0)
+                {
+                  gimp_parallel_run_async_enqueue_task (
+                    &gimp_parallel_run_async_threads[j++ % n_threads],
+                    task);
+                }
+              else if (finish_tasks)
+                {
+                  while (gimp_parallel_run_async_execute_task (task));
+                }
+              else
+                {
+                  gimp_parallel_run_async_abort_task (task);
+                }
+            }
         }
     }
 }
@@ -338,54 +434,94 @@ gimp_parallel_run_async_set_n_threads (gint     n_threads,
 static gpointer
 gimp_parallel_run_async_thread_func (GimpParallelRunAsyncThread *thread)
 {
-  g_mutex_lock (&gimp_parallel_run_async_mutex);
+  g_private_set (&gimp_parallel_run_async_current_thread, thread);
 
-  while (TRUE)
+  while (! g_atomic_int_get (&thread->quit))
     {
       GimpParallelRunAsyncTask *task;
 
-      while (! thread->quit &&
-             (task = gimp_parallel_run_async_dequeue_task ()))
-        {
-          gboolean resume;
+      task = gimp_parallel_run_async_dequeue_task (thread);
 
-          thread->current_async = GIMP_ASYNC (g_object_ref (task->async));
+      if (! task)
+        task = gimp_parallel_run_async_steal_task (thread);
 
-          do
-            {
-              g_mutex_unlock (&gimp_parallel_run_async_mutex);
+      if (task)
+        {
+          gimp_parallel_run_async_run_task (thread, task);
 
-              resume = gimp_parallel_run_async_execute_task (task);
+          continue;
+        }
 
-              g_mutex_lock (&gimp_parallel_run_async_mutex);
-            }
-          while (resume &&
-                 (g_queue_is_empty (&gimp_parallel_run_async_queue) ||
-                  task->priority <
-                  ((GimpParallelRunAsyncTask *)
-                     g_queue_peek_head (
-                       &gimp_parallel_run_async_queue))->priority));
+      g_mutex_lock (&gimp_parallel_run_async_mutex);
 
-          g_clear_object (&thread->current_async);
+      /* increment the idle count before checking for tasks, so that either
+       * we see the new task, or gimp_parallel_run_async_enqueue_task() sees
+       * us, and wakes us up
+       */
+      g_atomic_int_inc (&gimp_parallel_run_async_n_idle);
 
-          if (resume)
-            gimp_parallel_run_async_enqueue_task (task);
+      while (! thread->quit &&
+             ! g_atomic_int_get (&gimp_parallel_run_async_n_tasks))
+        {
+          g_cond_wait (&gimp_parallel_run_async_cond,
+                       &gimp_parallel_run_async_mutex);
         }
 
-      if (thread->quit)
-        break;
+      g_atomic_int_add (&gimp_parallel_run_async_n_idle, -1);
 
-      g_cond_wait (&gimp_parallel_run_async_cond,
-                   &gimp_parallel_run_async_mutex);
+      g_mutex_unlock (&gimp_parallel_run_async_mutex);
     }
 
-  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+  g_private_set (&gimp_parallel_run_async_current_thread, NULL);
 
   return NULL;
 }
 
 static void
-gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncTask *task)
+gimp_parallel_run_async_run_task (GimpParallelRunAsyncThread *thread,
+                                  GimpParallelRunAsyncTask   *task)
+{
+  gboolean preempted = FALSE;
+
+  g_mutex_lock (&thread->mutex);
+
+  thread->current_async = GIMP_ASYNC (g_object_ref (task->async));
+
+  g_mutex_unlock (&thread->mutex);
+
+  while (gimp_parallel_run_async_execute_task (task))
+    {
+      GimpParallelRunAsyncTask *next_task;
+
+      g_mutex_lock (&thread->mutex);
+
+      next_task = (GimpParallelRunAsyncTask *) g_queue_peek_head (
+                                                 &thread->queue);
+
+      /* keep running the task as long as there's no task of a higher
+       * priority waiting in our queue
+       */
+      preempted = next_task && next_task->priority <= task->priority;
+
+      g_mutex_unlock (&thread->mutex);
+
+      if (preempted)
+        break;
+    }
+
+  g_mutex_lock (&thread->mutex);
+
+  g_clear_object (&thread->current_async);
+
+  g_mutex_unlock (&thread->mutex);
+
+  if (preempted)
+    gimp_parallel_run_async_enqueue_task (thread, task);
+}
+
+static void
+gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncThread *thread,
+                                      GimpParallelRunAsyncTask   *task)
 {
   GList *link;
   GList *iter;
@@ -397,13 +533,41 @@ gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncTask *task)
       return;
     }
 
+  g_mutex_lock (&thread->mutex);
+
+  /* the thread was stopped after the caller picked it, pick one of the
+   * remaining threads instead.  the thread count is updated before any
+   * thread is marked as stopped.
+   */
+  while (thread->stopped)
+    {
+      gint n_threads;
+
+      g_mutex_unlock (&thread->mutex);
+
+      n_threads = g_atomic_int_get (&gimp_parallel_run_async_n_threads);
+
+      if (n_threads == 0)
+        {
+          while (gimp_parallel_run_async_execute_task (task));
+
+          return;
+        }
+
+      thread = &gimp_parallel_run_async_threads[thread->index % n_threads];
+
+      g_mutex_lock (&thread->mutex);
+    }
+
   link       = g_list_alloc ();
   link->data = task;
 
   g_object_set_data (G_OBJECT (task->async),
                      "gimp-parallel-run-async-link", link);
+  g_object_set_data (G_OBJECT (task->async),
+                     "gimp-parallel-run-async-thread", thread);
 
-  for (iter = g_queue_peek_tail_link (&gimp_parallel_run_async_queue);
+  for (iter = g_queue_peek_tail_link (&thread->queue);
        iter;
        iter = g_list_previous (iter))
     {
@@ -424,33 +588,130 @@ gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncTask *task)
       if (link->next)
         link->next->prev = link;
       else
-        gimp_parallel_run_async_queue.tail = link;
+        thread->queue.tail = link;
 
-      gimp_parallel_run_async_queue.length++;
+      thread->queue.length++;
     }
   else
     {
-      g_queue_push_head_link (&gimp_parallel_run_async_queue, link);
+      g_queue_push_head_link (&thread->queue, link);
+    }
+
+  g_atomic_int_inc (&thread->n_tasks);
+  g_atomic_int_inc (&gimp_parallel_run_async_n_tasks);
+
+  g_mutex_unlock (&thread->mutex);
+
+  if (g_atomic_int_get (&gimp_parallel_run_async_n_idle))
+    {
+      g_mutex_lock (&gimp_parallel_run_async_mutex);
+
+      g_cond_signal (&gimp_parallel_run_async_cond);
+
+      g_mutex_unlock (&gimp_parallel_run_async_mutex);
     }
 }
 
 static GimpParallelRunAsyncTask *
-gimp_parallel_run_async_dequeue_task (void)
+gimp_parallel_run_async_dequeue_task (GimpParallelRunAsyncThread *thread)
 {
   GimpParallelRunAsyncTask *task;
 
-  task = (GimpParallelRunAsyncTask *) g_queue_pop_head (
-                                        &gimp_parallel_run_async_queue);
+  if (! g_atomic_int_get (&thread->n_tasks))
+    return NULL;
+
+  g_mutex_lock (&thread->mutex);
+
+  task = (GimpParallelRunAsyncTask *) g_queue_pop_head (&thread->queue);
 
   if (task)
     {
       g_object_set_data (G_OBJECT (task->async),
                          "gimp-parallel-run-async-link", NULL);
+      g_object_set_data (G_OBJECT (task->async),
+                         "gimp-parallel-run-async-thread", NULL);
+
+      g_atomic_int_add (&thread->n_tasks, -1);
+      g_atomic_int_add (&gimp_parallel_run_async_n_tasks, -1);
     }
 
+  g_mutex_unlock (&thread->mutex);
+
   return task;
 }
 
+static GimpParallelRunAsyncTask *
+gimp_parallel_run_async_steal_task (GimpParallelRunAsyncThread *thief)
+{
+  GimpParallelRunAsyncThread *victim        = NULL;
+  gint                        best_priority = G_MAXINT;
+  gint                        n_threads;
+  gint                        i;
+
+  n_threads = g_atomic_int_get (&gimp_parallel_run_async_n_threads);
+
+  /* steal the highest-priority task at the head of the other threads'
+   * queues, so that priorities are honored across threads
+   */
+  for (i = 1; i < n_threads; i++)
+    {
+      GimpParallelRunAsyncThread *thread;
+      GimpParallelRunAsyncTask   *task;
+
+      thread = &gimp_parallel_run_async_threads[(thief->index + i) % n_threads];
+
+      if (thread == thief || ! g_atomic_int_get (&thread->n_tasks))
+        continue;
+
+      g_mutex_lock (&thread->mutex);
+
+      task = (GimpParallelRunAsyncTask *) g_queue_peek_head (&thread->queue);
+
+      if (task && (! victim || task->priority < best_priority))
+        {
+          victim        = thread;
+          best_priority = task->priority;
+        }
+
+      g_mutex_unlock (&thread->mutex);
+    }
+
+  if (victim)
+    return gimp_parallel_run_async_dequeue_task (victim);
+
+  return NULL;
+}
+
+static GList *
+gimp_parallel_run_async_lock_task (GimpAsync                   *async,
+                                   GimpParallelRunAsyncThread **thread)
+{
+  GimpParallelRunAsyncThread *owner;
+
+  /* the task may move between queues while we wait for the lock, so
+   * retry until the queue we locked is the one holding the task
+   */
+  while ((owner = (GimpParallelRunAsyncThread *)
+                    g_object_get_data (G_OBJECT (async),
+                                       "gimp-parallel-run-async-thread")))
+    {
+      g_mutex_lock (&owner->mutex);
+
+      if (g_object_get_data (G_OBJECT (async),
+                             "gimp-parallel-run-async-thread") == owner)
+        {
+          *thread = owner;
+
+          return (GList *) g_object_get_data (G_OBJECT (async),
+                                              "gimp-parallel-run-async-link");
+        }
+
+      g_mutex_unlock (&owner->mutex);
+    }
+
+  return NULL;
+}
+
 static gboolean
 gimp_parallel_run_async_execute_task (GimpParallelRunAsyncTask *task)
 {
@@ -491,63 +752,52 @@ gimp_parallel_run_async_abort_task (GimpParallelRunAsyncTask *task)
 static void
 gimp_parallel_run_async_cancel (GimpAsync *async)
 {
-  GList                    *link;
-  GimpParallelRunAsyncTask *task = NULL;
+  GimpParallelRunAsyncThread *thread;
+  GList                      *link;
+  GimpParallelRunAsyncTask   *task = NULL;
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+  link = gimp_parallel_run_async_lock_task (async, &thread);
 
   if (! link)
     return;
 
-  g_mutex_lock (&gimp_parallel_run_async_mutex);
+  g_object_set_data (G_OBJECT (async),
+                     "gimp-parallel-run-async-link", NULL);
+  g_object_set_data (G_OBJECT (async),
+                     "gimp-parallel-run-async-thread", NULL);
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+  task = (GimpParallelRunAsyncTask *) link->data;
 
-  if (link)
-    {
-      g_object_set_data (G_OBJECT (async),
-                         "gimp-parallel-run-async-link", NULL);
+  g_queue_delete_link (&thread->queue, link);
 
-      task = (GimpParallelRunAsyncTask *) link->data;
+  g_atomic_int_add (&thread->n_tasks, -1);
+  g_atomic_int_add (&gimp_parallel_run_async_n_tasks, -1);
 
-      g_queue_delete_link (&gimp_parallel_run_async_queue, link);
-    }
-
-  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+  g_mutex_unlock (&thread->mutex);
 
-  if (task)
-    gimp_parallel_run_async_abort_task (task);
+  gimp_parallel_run_async_abort_task (task);
 }
 
 static void
 gimp_parallel_run_async_waiting (GimpAsync *async)
 {
-  GList *link;
+  GimpParallelRunAsyncThread *thread;
+  GList                      *link;
+  GimpParallelRunAsyncTask   *task;
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+  link = gimp_parallel_run_async_lock_task (async, &thread);
 
   if (! link)
     return;
 
-  g_mutex_lock (&gimp_parallel_run_async_mutex);
+  task = (GimpParallelRunAsyncTask *) link->data;
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+  task->priority = G_MININT;
 
-  if (link)
-    {
-      GimpParallelRunAsyncTask *task = (GimpParallelRunAsyncTask *) link->data;
-
-      task->priority = G_MININT;
-
-      g_queue_unlink         (&gimp_parallel_run_async_queue, link);
-      g_queue_push_head_link (&gimp_parallel_run_async_queue, link);
-    }
+  g_queue_unlink         (&thread->queue, link);
+  g_queue_push_head_link (&thread->queue, link);
 
-  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+  g_mutex_unlock (&thread->mutex);
 }
 
 } /* extern "C" */
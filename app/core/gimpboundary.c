@@ -32,8 +32,18 @@
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* the scanlines are processed in bands of this many rows, which are
+ * distributed among threads, and cached by GimpBoundaryCache
+ */
+#define BAND_HEIGHT   64
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
 
-typedef struct _GimpBoundary GimpBoundary;
+
+typedef struct _GimpBoundary       GimpBoundary;
+typedef struct _GimpBoundaryParams GimpBoundaryParams;
+typedef struct _GimpBoundaryBand   GimpBoundaryBand;
 
 struct _GimpBoundary
 {
@@ -52,6 +62,52 @@ struct _GimpBoundary
   gint          max_empty_segs;
 };
 
+struct _GimpBoundaryParams
+{
+  GeglBuffer       *buffer;
+  GeglRectangle     region;
+  const Babl       *format;
+  GimpBoundaryType  type;
+  gint              x1;
+  gint              y1;
+  gint              x2;
+  gint              y2;
+  gfloat            threshold;
+
+  /*  The range of scanlines to process  */
+  gint              start;
+  gint              end;
+};
+
+struct _GimpBoundaryBand
+{
+  gint          start;
+  gint          end;
+
+  /*  The horizontal segments of the band's scanlines, in order  */
+  GimpBoundSeg *segs;
+  gint          num_segs;
+  gboolean      valid;
+};
+
+struct _GimpBoundaryCache
+{
+  /*  the cache is invalidated from the buffer's "changed" signal, which
+   *  is emitted from whatever thread writes to the buffer
+   */
+  GMutex              mutex;
+
+  GimpBoundaryParams  params;
+  GimpBoundaryBand   *bands;
+  gint                n_bands;
+};
+
+typedef struct
+{
+  GimpBoundaryCache *cache;
+  const gint        *invalid;
+} GimpBoundaryBandsData;
+
 
 /*  local function prototypes  */
 
@@ -91,7 +147,9 @@ static void           make_horiz_segs          (GimpBoundary        *boundary,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
-static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
+
+static void           init_params              (GimpBoundaryParams  *params,
+                                                GeglBuffer          *buffer,
                                                 const GeglRectangle *region,
                                                 const Babl          *format,
                                                 GimpBoundaryType     type,
@@ -100,6 +158,18 @@ static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 gint                 x2,
                                                 gint                 y2,
                                                 gfloat               threshold);
+static gboolean       params_equal             (const GimpBoundaryParams *params1,
+                                                const GimpBoundaryParams *params2);
+static void           init_bands               (GimpBoundaryCache   *cache);
+static void           clear_bands              (GimpBoundaryCache   *cache);
+static void           generate_band            (const GimpBoundaryParams *params,
+                                                GimpBoundaryBand    *band,
+                                                gfloat              *line_data);
+static void           generate_bands_range     (gsize                offset,
+                                                gsize                size,
+                                                GimpBoundaryBandsData *data);
+static void           generate_bands           (GimpBoundaryCache   *cache);
+static GimpBoundary * generate_boundary        (GimpBoundaryCache   *cache);
 
 static gint       cmp_segptr_xy1_addr     (const GimpBoundSeg **seg_ptr_a,
                                            const GimpBoundSeg **seg_ptr_b);
@@ -164,8 +234,8 @@ gimp_boundary_find (GeglBuffer          *buffer,
                     gfloat               threshold,
                     int                 *num_segs)
 {
-  GimpBoundary  *boundary;
-  GeglRectangle  rect = { 0, };
+  GimpBoundaryCache *cache;
+  GimpBoundSeg      *segs;
 
   g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
   g_return_val_if_fail (num_segs != NULL, NULL);
@@ -173,18 +243,79 @@ gimp_boundary_find (GeglBuffer          *buffer,
   g_return_val_if_fail (babl_format_get_bytes_per_pixel (format) ==
                         sizeof (gfloat), NULL);
 
-  if (region)
-    {
-      rect = *region;
-    }
-  else
+  cache = gimp_boundary_cache_new ();
+
+  segs = gimp_boundary_find_cached (cache, buffer, region, format, type,
+                                    x1, y1, x2, y2, threshold, num_segs);
+
+  gimp_boundary_cache_free (cache);
+
+  return segs;
+}
+
+/**
+ * gimp_boundary_find_cached:
+ * @cache:     a #GimpBoundaryCache
+ * @buffer:    a #GeglBuffer
+ * @region:    the area of @buffer to analyze, or %NULL for all of it
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        bottom side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but keeps the segments of each band of
+ * scanlines in @cache, and only scans the bands again that were
+ * invalidated by gimp_boundary_cache_invalidate() since the last call
+ * with the same parameters.
+ *
+ * Returns: the boundary array.
+ **/
+GimpBoundSeg *
+gimp_boundary_find_cached (GimpBoundaryCache   *cache,
+                           GeglBuffer          *buffer,
+                           const GeglRectangle *region,
+                           const Babl          *format,
+                           GimpBoundaryType     type,
+                           gint                 x1,
+                           gint                 y1,
+                           gint                 x2,
+                           gint                 y2,
+                           gfloat               threshold,
+                           gint                *num_segs)
+{
+  GimpBoundary       *boundary;
+  GimpBoundaryParams  params;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (babl_format_get_bytes_per_pixel (format) ==
+                        sizeof (gfloat), NULL);
+
+  init_params (&params, buffer, region, format, type,
+               x1, y1, x2, y2, threshold);
+
+  g_mutex_lock (&cache->mutex);
+
+  if (! cache->bands || ! params_equal (&params, &cache->params))
     {
-      rect.width  = gegl_buffer_get_width  (buffer);
-      rect.height = gegl_buffer_get_height (buffer);
+      clear_bands (cache);
+
+      cache->params = params;
+
+      init_bands (cache);
     }
 
-  boundary = generate_boundary (buffer, &rect, format, type,
-                                x1, y1, x2, y2, threshold);
+  generate_bands (cache);
+
+  boundary = generate_boundary (cache);
+
+  g_mutex_unlock (&cache->mutex);
 
   *num_segs = boundary->num_segs;
 
@@ -381,6 +512,108 @@ gimp_boundary_simplify (GimpBoundSeg *sorted_segs,
   return (GimpBoundSeg *) g_array_free (new_bounds, FALSE);
 }
 
+/**
+ * gimp_boundary_cache_new:
+ *
+ * Creates a cache for gimp_boundary_find_cached(), which is meant to be
+ * kept alongside a buffer whose boundary is found repeatedly.
+ *
+ * Returns: a new #GimpBoundaryCache
+ **/
+GimpBoundaryCache *
+gimp_boundary_cache_new (void)
+{
+  GimpBoundaryCache *cache = g_slice_new0 (GimpBoundaryCache);
+
+  g_mutex_init (&cache->mutex);
+
+  return cache;
+}
+
+void
+gimp_boundary_cache_free (GimpBoundaryCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  clear_bands (cache);
+
+  g_mutex_clear (&cache->mutex);
+
+  g_slice_free (GimpBoundaryCache, cache);
+}
+
+/**
+ * gimp_boundary_cache_invalidate:
+ * @cache: a #GimpBoundaryCache
+ * @rect:  the area of the buffer that changed, or %NULL
+ *
+ * Marks the bands of scanlines whose segments depend on the pixels in
+ * @rect as out of date, or all of them if @rect is %NULL, which is
+ * also what to do when the buffer is replaced.
+ *
+ * This function may be called from any thread.
+ **/
+void
+gimp_boundary_cache_invalidate (GimpBoundaryCache   *cache,
+                                const GeglRectangle *rect)
+{
+  gint i;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->mutex);
+
+  if (! rect)
+    {
+      clear_bands (cache);
+
+      g_mutex_unlock (&cache->mutex);
+
+      return;
+    }
+
+  for (i = 0; i < cache->n_bands; i++)
+    {
+      GimpBoundaryBand *band = &cache->bands[i];
+
+      /*  the segments of a scanline depend on the scanlines above and
+       *  below it too
+       */
+      if (band->valid                           &&
+          band->start <= rect->y + rect->height &&
+          band->end   >= rect->y)
+        {
+          g_clear_pointer (&band->segs, g_free);
+          band->num_segs = 0;
+          band->valid    = FALSE;
+        }
+    }
+
+  g_mutex_unlock (&cache->mutex);
+}
+
+gint64
+gimp_boundary_cache_get_memsize (GimpBoundaryCache *cache)
+{
+  gint64 memsize = 0;
+  gint   i;
+
+  if (! cache)
+    return 0;
+
+  g_mutex_lock (&cache->mutex);
+
+  memsize += sizeof (GimpBoundaryCache);
+  memsize += cache->n_bands * sizeof (GimpBoundaryBand);
+
+  for (i = 0; i < cache->n_bands; i++)
+    memsize += cache->bands[i].num_segs * sizeof (GimpBoundSeg);
+
+  g_mutex_unlock (&cache->mutex);
+
+  return memsize;
+}
+
 void
 gimp_boundary_offset (GimpBoundSeg *segs,
                       gint          num_segs,
@@ -631,6 +864,9 @@ process_horiz_seg (GimpBoundary *boundary,
   gimp_boundary_add_seg (boundary, x1, y1, x2, y2, open);
 }
 
+/*  records the horizontal segments of a scanline, which are turned into
+ *  the final boundary by process_horiz_seg() in generate_boundary()
+ */
 static void
 make_horiz_segs (GimpBoundary *boundary,
                  gint          start,
@@ -650,97 +886,186 @@ make_horiz_segs (GimpBoundary *boundary,
 
       if (e_s <= start && e_e >= end)
         {
-          process_horiz_seg (boundary,
-                             start, scanline, end, scanline, top);
+          gimp_boundary_add_seg (boundary,
+                                 start, scanline, end, scanline, top);
         }
       else if ((e_s > start && e_s < end) ||
                (e_e < end && e_e > start))
         {
-          process_horiz_seg (boundary,
-                             MAX (e_s, start), scanline,
-                             MIN (e_e, end), scanline, top);
+          gimp_boundary_add_seg (boundary,
+                                 MAX (e_s, start), scanline,
+                                 MIN (e_e, end), scanline, top);
         }
     }
 }
 
-static GimpBoundary *
-generate_boundary (GeglBuffer          *buffer,
-                   const GeglRectangle *region,
-                   const Babl          *format,
-                   GimpBoundaryType     type,
-                   gint                 x1,
-                   gint                 y1,
-                   gint                 x2,
-                   gint                 y2,
-                   gfloat               threshold)
+static void
+init_params (GimpBoundaryParams  *params,
+             GeglBuffer          *buffer,
+             const GeglRectangle *region,
+             const Babl          *format,
+             GimpBoundaryType     type,
+             gint                 x1,
+             gint                 y1,
+             gint                 x2,
+             gint                 y2,
+             gfloat               threshold)
+{
+  memset (params, 0, sizeof (GimpBoundaryParams));
+
+  params->buffer = buffer;
+
+  if (region)
+    {
+      params->region = *region;
+    }
+  else
+    {
+      params->region.width  = gegl_buffer_get_width  (buffer);
+      params->region.height = gegl_buffer_get_height (buffer);
+    }
+
+  params->format    = format;
+  params->type      = type;
+  params->x1        = x1;
+  params->y1        = y1;
+  params->x2        = x2;
+  params->y2        = y2;
+  params->threshold = threshold;
+
+  if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
+    {
+      params->start = y1;
+      params->end   = y2;
+    }
+  else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
+    {
+      params->start = params->region.y;
+      params->end   = params->region.y + params->region.height;
+    }
+}
+
+static gboolean
+params_equal (const GimpBoundaryParams *params1,
+              const GimpBoundaryParams *params2)
+{
+  return (params1->buffer    == params2->buffer    &&
+          params1->format    == params2->format    &&
+          params1->type      == params2->type      &&
+          params1->x1        == params2->x1        &&
+          params1->y1        == params2->y1        &&
+          params1->x2        == params2->x2        &&
+          params1->y2        == params2->y2        &&
+          params1->threshold == params2->threshold &&
+          gegl_rectangle_equal (&params1->region, &params2->region));
+}
+
+static void
+init_bands (GimpBoundaryCache *cache)
+{
+  const GimpBoundaryParams *params = &cache->params;
+  gint                      i;
+
+  cache->n_bands = (MAX (params->end - params->start, 0) + BAND_HEIGHT - 1) /
+                   BAND_HEIGHT;
+
+  /*  always have at least one band, so that an empty range of scanlines
+   *  still counts as known
+   */
+  cache->n_bands = MAX (cache->n_bands, 1);
+
+  cache->bands = g_new0 (GimpBoundaryBand, cache->n_bands);
+
+  for (i = 0; i < cache->n_bands; i++)
+    {
+      cache->bands[i].start = params->start + i * BAND_HEIGHT;
+      cache->bands[i].end   = MIN (cache->bands[i].start + BAND_HEIGHT,
+                                   params->end);
+    }
+}
+
+static void
+clear_bands (GimpBoundaryCache *cache)
+{
+  gint i;
+
+  for (i = 0; i < cache->n_bands; i++)
+    g_free (cache->bands[i].segs);
+
+  g_clear_pointer (&cache->bands, g_free);
+  cache->n_bands = 0;
+}
+
+static void
+generate_band (const GimpBoundaryParams *params,
+               GimpBoundaryBand         *band,
+               gfloat                   *line_data)
 {
   GimpBoundary  *boundary;
   GeglRectangle  line_rect = { 0, };
-  gfloat        *line_data;
   gint           scanline;
   gint           i;
-  gint           start, end;
   gint          *tmp_segs;
 
   gint          num_empty_n = 0;
   gint          num_empty_c = 0;
   gint          num_empty_l = 0;
 
-  boundary = gimp_boundary_new (region);
+  boundary = gimp_boundary_new (&params->region);
 
-  line_rect.width  = gegl_buffer_get_width (buffer);
+  line_rect.width  = gegl_buffer_get_width (params->buffer);
   line_rect.height = 1;
 
-  line_data = g_alloca (sizeof (gfloat) * line_rect.width);
-
-  start = 0;
-  end   = 0;
-
-  if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
-    {
-      start = y1;
-      end   = y2;
-    }
-  else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
+  /*  Find the empty segments for the previous and current scanlines  */
+  if (band->start > params->start)
     {
-      start = region->y;
-      end   = region->y + region->height;
+      line_rect.y = band->start - 1;
+      gegl_buffer_get (params->buffer, &line_rect, 1.0, params->format,
+                       line_data, GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
     }
 
-  /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
-                   start - 1, boundary->empty_segs_l,
+  find_empty_segs (&params->region,
+                   band->start > params->start ? line_data : NULL,
+                   band->start - 1, boundary->empty_segs_l,
                    boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
+                   params->type,
+                   params->x1, params->y1, params->x2, params->y2,
+                   params->threshold);
 
-  line_rect.y = start;
-  gegl_buffer_get (buffer, &line_rect, 1.0, format,
+  line_rect.y = band->start;
+  gegl_buffer_get (params->buffer, &line_rect, 1.0, params->format,
                    line_data, GEGL_AUTO_ROWSTRIDE,
                    GEGL_ABYSS_NONE);
 
-  find_empty_segs (region, line_data,
-                   start, boundary->empty_segs_c,
+  find_empty_segs (&params->region, line_data,
+                   band->start, boundary->empty_segs_c,
                    boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
+                   params->type,
+                   params->x1, params->y1, params->x2, params->y2,
+                   params->threshold);
 
-  for (scanline = start; scanline < end; scanline++)
+  for (scanline = band->start; scanline < band->end; scanline++)
     {
+      const gfloat *next_data = NULL;
+
       /*  find the empty segment list for the next scanline  */
-      line_rect.y = scanline + 1;
-      if (scanline + 1 == end)
-        line_data = NULL;
-      else
-        gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                         line_data, GEGL_AUTO_ROWSTRIDE,
-                         GEGL_ABYSS_NONE);
+      if (scanline + 1 < params->end)
+        {
+          line_rect.y = scanline + 1;
+          gegl_buffer_get (params->buffer, &line_rect, 1.0, params->format,
+                           line_data, GEGL_AUTO_ROWSTRIDE,
+                           GEGL_ABYSS_NONE);
 
-      find_empty_segs (region, line_data,
+          next_data = line_data;
+        }
+
+      find_empty_segs (&params->region, next_data,
                        scanline + 1, boundary->empty_segs_n,
                        boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
+                       params->type,
+                       params->x1, params->y1, params->x2, params->y2,
+                       params->threshold);
 
       /*  process the segments on the current scanline  */
       for (i = 1; i < num_empty_c - 1; i += 2)
@@ -766,6 +1091,97 @@ generate_boundary (GeglBuffer          *buffer,
       boundary->empty_segs_n = tmp_segs;
     }
 
+  band->num_segs = boundary->num_segs;
+  band->segs     = gimp_boundary_free (boundary, FALSE);
+  band->segs     = g_renew (GimpBoundSeg, band->segs, band->num_segs);
+  band->valid    = TRUE;
+}
+
+static void
+generate_bands_range (gsize                  offset,
+                      gsize                  size,
+                      GimpBoundaryBandsData *data)
+{
+  GimpBoundaryCache *cache = data->cache;
+  gfloat            *line_data;
+  gsize              i;
+
+  line_data = g_new (gfloat, gegl_buffer_get_width (cache->params.buffer));
+
+  for (i = offset; i < offset + size; i++)
+    {
+      generate_band (&cache->params,
+                     &cache->bands[data->invalid[i]],
+                     line_data);
+    }
+
+  g_free (line_data);
+}
+
+static void
+generate_bands (GimpBoundaryCache *cache)
+{
+  gint *invalid;
+  gint  n_invalid = 0;
+  gint  i;
+
+  invalid = g_new (gint, cache->n_bands);
+
+  for (i = 0; i < cache->n_bands; i++)
+    {
+      if (! cache->bands[i].valid)
+        invalid[n_invalid++] = i;
+    }
+
+  if (n_invalid > 0)
+    {
+      gint width = gegl_buffer_get_width (cache->params.buffer);
+
+      /*  each band only depends on its own scanlines, and the ones right
+       *  above and below it, so they can be scanned in parallel
+       */
+      GimpBoundaryBandsData data;
+
+      data.cache   = cache;
+      data.invalid = invalid;
+
+      gegl_parallel_distribute_range (
+        n_invalid,
+        PIXELS_PER_THREAD / ((gdouble) BAND_HEIGHT * MAX (width, 1)),
+        (GeglParallelDistributeRangeFunc) generate_bands_range,
+        &data);
+    }
+
+  g_free (invalid);
+}
+
+static GimpBoundary *
+generate_boundary (GimpBoundaryCache *cache)
+{
+  GimpBoundary *boundary;
+  gint          i, j;
+
+  boundary = gimp_boundary_new (&cache->params.region);
+
+  /*  stitch the bands together.  the vertical segments which close in
+   *  the horizontal ones may span any number of bands, so they are only
+   *  generated here, with the horizontal segments in their original
+   *  order, which gives the same result as scanning the whole buffer at
+   *  once.
+   */
+  for (i = 0; i < cache->n_bands; i++)
+    {
+      const GimpBoundaryBand *band = &cache->bands[i];
+
+      for (j = 0; j < band->num_segs; j++)
+        {
+          const GimpBoundSeg *seg = &band->segs[j];
+
+          process_horiz_seg (boundary,
+                             seg->x1, seg->y1, seg->x2, seg->y2, seg->open);
+        }
+    }
+
   return boundary;
 }
 
@@ -41,28 +41,45 @@ struct _GimpBoundSeg
 };
 
 
-GimpBoundSeg * gimp_boundary_find      (GeglBuffer          *buffer,
-                                        const GeglRectangle *region,
-                                        const Babl          *format,
-                                        GimpBoundaryType     type,
-                                        gint                 x1,
-                                        gint                 y1,
-                                        gint                 x2,
-                                        gint                 y2,
-                                        gfloat               threshold,
-                                        gint                *num_segs);
-GimpBoundSeg * gimp_boundary_sort      (const GimpBoundSeg  *segs,
-                                        gint                 num_segs,
-                                        gint                *num_groups);
-GimpBoundSeg * gimp_boundary_simplify  (GimpBoundSeg        *sorted_segs,
-                                        gint                 num_groups,
-                                        gint                *num_segs);
+GimpBoundSeg      * gimp_boundary_find              (GeglBuffer          *buffer,
+                                                     const GeglRectangle *region,
+                                                     const Babl          *format,
+                                                     GimpBoundaryType     type,
+                                                     gint                 x1,
+                                                     gint                 y1,
+                                                     gint                 x2,
+                                                     gint                 y2,
+                                                     gfloat               threshold,
+                                                     gint                *num_segs);
+GimpBoundSeg      * gimp_boundary_find_cached       (GimpBoundaryCache   *cache,
+                                                     GeglBuffer          *buffer,
+                                                     const GeglRectangle *region,
+                                                     const Babl          *format,
+                                                     GimpBoundaryType     type,
+                                                     gint                 x1,
+                                                     gint                 y1,
+                                                     gint                 x2,
+                                                     gint                 y2,
+                                                     gfloat               threshold,
+                                                     gint                *num_segs);
+GimpBoundSeg      * gimp_boundary_sort              (const GimpBoundSeg  *segs,
+                                                     gint                 num_segs,
+                                                     gint                *num_groups);
+GimpBoundSeg      * gimp_boundary_simplify          (GimpBoundSeg        *sorted_segs,
+                                                     gint                 num_groups,
+                                                     gint                *num_segs);
 
 /* offsets in-place */
-void       gimp_boundary_offset        (GimpBoundSeg        *segs,
-                                        gint                 num_segs,
-                                        gint                 off_x,
-                                        gint                 off_y);
+void                gimp_boundary_offset            (GimpBoundSeg        *segs,
+                                                     gint                 num_segs,
+                                                     gint                 off_x,
+                                                     gint                 off_y);
+
+GimpBoundaryCache * gimp_boundary_cache_new         (void);
+void                gimp_boundary_cache_free        (GimpBoundaryCache   *cache);
+void                gimp_boundary_cache_invalidate  (GimpBoundaryCache   *cache,
+                                                     const GeglRectangle *rect);
+gint64              gimp_boundary_cache_get_memsize (GimpBoundaryCache   *cache);
 
 
 #endif  /*  __GIMP_BOUNDARY_H__  */
@@ -38,7 +38,8 @@ gimp_brush_transform_boundary_exact (GimpBrush *brush,
                                      gboolean   reflect,
                                      gdouble    hardness)
 {
-  const GimpTempBuf *mask;
+  GimpTempBuf    *mask;
+  GimpBezierDesc *path = NULL;
 
   mask = gimp_brush_transform_mask (brush,
                                     scale, aspect_ratio,
@@ -50,7 +51,7 @@ gimp_brush_transform_boundary_exact (GimpBrush *brush,
       GimpBoundSeg  *bound_segs;
       gint           n_bound_segs;
 
-      buffer = gimp_temp_buf_create_buffer ((GimpTempBuf *) mask);
+      buffer = gimp_temp_buf_create_buffer (mask);
 
       bound_segs = gimp_boundary_find (buffer, NULL,
                                        babl_format ("Y float"),
@@ -75,20 +76,18 @@ gimp_brush_transform_boundary_exact (GimpBrush *brush,
 
           if (stroke_segs)
             {
-              GimpBezierDesc *path;
-
               path = gimp_bezier_desc_new_from_bound_segs (stroke_segs,
                                                            n_bound_segs,
                                                            n_stroke_groups);
 
               g_free (stroke_segs);
-
-              return path;
             }
         }
+
+      gimp_temp_buf_unref (mask);
     }
 
-  return NULL;
+  return path;
 }
 
 static GimpBezierDesc *
@@ -26,10 +26,14 @@
 
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
+#include "gimp.h"
 #include "gimpbrush.h"
 #include "gimpbrush-header.h"
 #include "gimpbrush-load.h"
 #include "gimpbrush-private.h"
+#include "gimpcontext.h"
 #include "gimppattern-header.h"
 #include "gimptempbuf.h"
 
@@ -68,6 +72,21 @@ struct _AbrSampledBrushHeader
 
 /*  local function prototypes  */
 
+static gboolean    gimp_brush_load_header        (GFile             *file,
+                                                  GInputStream      *input,
+                                                  GimpBrushHeader   *header,
+                                                  gchar            **name,
+                                                  GError           **error);
+static gboolean    gimp_brush_load_mask          (GimpBrush         *brush,
+                                                  GInputStream      *input,
+                                                  GimpBrushHeader   *header,
+                                                  GError           **error);
+static GimpBrush * gimp_brush_load_brush_real    (GimpContext       *context,
+                                                  GFile             *file,
+                                                  GInputStream      *input,
+                                                  gboolean           lazy,
+                                                  GError           **error);
+
 static GList     * gimp_brush_load_abr_v12       (GDataInputStream  *input,
                                                   AbrHeader         *abr_hdr,
                                                   GFile             *file,
@@ -135,116 +154,269 @@ gimp_brush_load_brush (GimpContext   *context,
                        GInputStream  *input,
                        GError       **error)
 {
-  GimpBrush       *brush;
-  gsize            bn_size;
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return gimp_brush_load_brush_real (context, file, input, FALSE, error);
+}
+
+/*  like gimp_brush_load(), but if "data-lazy-loading" is enabled, only
+ *  reads the brush's header, and leaves its pixels to
+ *  gimp_brush_load_pixels()
+ */
+GList *
+gimp_brush_load_lazy (GimpContext   *context,
+                      GFile         *file,
+                      GInputStream  *input,
+                      GError       **error)
+{
+  GimpBrush *brush;
+
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  brush = gimp_brush_load_brush_real (context, file, input,
+                                      context->gimp->config->data_lazy_loading,
+                                      error);
+  if (! brush)
+    return NULL;
+
+  return g_list_prepend (NULL, brush);
+}
+
+/*  loads the pixels of a lazily loaded brush, from the start of its file.
+ *  if 'input' is NULL, or on error, the brush is left with a cleared mask
+ *  of the size read initially.
+ */
+gboolean
+gimp_brush_load_pixels (GimpData      *data,
+                        GInputStream  *input,
+                        GError       **error)
+{
+  GimpBrush       *brush = GIMP_BRUSH (data);
   GimpBrushHeader  header;
-  gchar           *name = NULL;
-  guchar          *mask;
-  gsize            bytes_read;
-  gssize           i, size;
-  gboolean         success = TRUE;
+
+  g_return_val_if_fail (input == NULL || G_IS_INPUT_STREAM (input), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (input)
+    {
+      if (! gimp_brush_load_header (gimp_data_get_file (data), input,
+                                    &header, NULL, error))
+        {
+          input = NULL;
+        }
+      else if (header.width  != brush->priv->lazy_width ||
+               header.height != brush->priv->lazy_height)
+        {
+          g_set_error_literal (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                               _("The brush's size changed."));
+          input = NULL;
+        }
+    }
+
+  if (input && gimp_brush_load_mask (brush, input, &header, error))
+    return TRUE;
+
+  g_clear_pointer (&brush->priv->mask,   gimp_temp_buf_unref);
+  g_clear_pointer (&brush->priv->pixmap, gimp_temp_buf_unref);
+
+  brush->priv->mask = gimp_temp_buf_new (brush->priv->lazy_width,
+                                         brush->priv->lazy_height,
+                                         babl_format ("Y u8"));
+  gimp_temp_buf_data_clear (brush->priv->mask);
+
+  return FALSE;
+}
+
+GList *
+gimp_brush_load_abr (GimpContext   *context,
+                     GFile         *file,
+                     GInputStream  *input,
+                     GError       **error)
+{
+  GDataInputStream *data_input;
+  AbrHeader         abr_hdr;
+  GList            *brush_list = NULL;
+  GError           *my_error   = NULL;
 
   g_return_val_if_fail (G_IS_FILE (file), NULL);
   g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  data_input = g_data_input_stream_new (input);
+
+  g_data_input_stream_set_byte_order (data_input,
+                                      G_DATA_STREAM_BYTE_ORDER_BIG_ENDIAN);
+
+  abr_hdr.version = abr_read_short (data_input, &my_error);
+  if (my_error)
+    goto done;
+
+  /* sub-version for ABR v6 */
+  abr_hdr.count = abr_read_short (data_input, &my_error);
+  if (my_error)
+    goto done;
+
+  if (abr_supported (&abr_hdr, &my_error))
+    {
+      switch (abr_hdr.version)
+        {
+        case 1:
+        case 2:
+          brush_list = gimp_brush_load_abr_v12 (data_input, &abr_hdr,
+                                                file, &my_error);
+          break;
+
+        case 10:
+        case 6:
+          brush_list = gimp_brush_load_abr_v6 (data_input, &abr_hdr,
+                                               file, &my_error);
+          break;
+        }
+    }
+
+ done:
+
+  g_object_unref (data_input);
+
+  if (! brush_list)
+    {
+      if (! my_error)
+        g_set_error (&my_error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                     _("Unable to decode abr format version %d."),
+                     abr_hdr.version);
+    }
+
+  if (my_error)
+    g_propagate_error (error, my_error);
+
+  return g_list_reverse (brush_list);
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_brush_load_header (GFile            *file,
+                        GInputStream     *input,
+                        GimpBrushHeader  *header,
+                        gchar           **name,
+                        GError          **error)
+{
+  gsize bn_size;
+  gsize bytes_read;
+
   /*  read the header  */
-  if (! g_input_stream_read_all (input, &header, sizeof (header),
+  if (! g_input_stream_read_all (input, header, sizeof (*header),
                                  &bytes_read, NULL, error) ||
-      bytes_read != sizeof (header))
+      bytes_read != sizeof (*header))
     {
-      return NULL;
+      return FALSE;
     }
 
   /*  rearrange the bytes in each unsigned int  */
-  header.header_size  = g_ntohl (header.header_size);
-  header.version      = g_ntohl (header.version);
-  header.width        = g_ntohl (header.width);
-  header.height       = g_ntohl (header.height);
-  header.bytes        = g_ntohl (header.bytes);
-  header.magic_number = g_ntohl (header.magic_number);
-  header.spacing      = g_ntohl (header.spacing);
+  header->header_size  = g_ntohl (header->header_size);
+  header->version      = g_ntohl (header->version);
+  header->width        = g_ntohl (header->width);
+  header->height       = g_ntohl (header->height);
+  header->bytes        = g_ntohl (header->bytes);
+  header->magic_number = g_ntohl (header->magic_number);
+  header->spacing      = g_ntohl (header->spacing);
 
   /*  Check for correct file format */
 
-  if (header.width == 0)
+  if (header->width == 0)
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Fatal parse error in brush file: Width = 0."));
-      return NULL;
+      return FALSE;
     }
 
-  if (header.height == 0)
+  if (header->height == 0)
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Fatal parse error in brush file: Height = 0."));
-      return NULL;
+      return FALSE;
     }
 
-  if (header.bytes == 0)
+  if (header->bytes == 0)
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Fatal parse error in brush file: Bytes = 0."));
-      return NULL;
+      return FALSE;
     }
 
-  if (header.width  > GIMP_BRUSH_MAX_SIZE ||
-      header.height > GIMP_BRUSH_MAX_SIZE ||
-      G_MAXSIZE / header.width / header.height / MAX (4, header.bytes) < 1)
+  if (header->width  > GIMP_BRUSH_MAX_SIZE ||
+      header->height > GIMP_BRUSH_MAX_SIZE ||
+      G_MAXSIZE / header->width / header->height / MAX (4, header->bytes) < 1)
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Fatal parse error in brush file: %dx%d over max size."),
-                   header.width, header.height);
-      return NULL;
+                   header->width, header->height);
+      return FALSE;
     }
 
-  switch (header.version)
+  switch (header->version)
     {
     case 1:
       /*  If this is a version 1 brush, set the fp back 8 bytes  */
       if (! g_seekable_seek (G_SEEKABLE (input), -8, G_SEEK_CUR,
                              NULL, error))
-        return NULL;
+        return FALSE;
 
-      header.header_size += 8;
+      header->header_size += 8;
       /*  spacing is not defined in version 1  */
-      header.spacing = 25;
+      header->spacing = 25;
       break;
 
     case 3:  /*  cinepaint brush  */
-      if (header.bytes == 18  /* FLOAT16_GRAY_GIMAGE */)
+      if (header->bytes == 18  /* FLOAT16_GRAY_GIMAGE */)
         {
-          header.bytes = 2;
+          header->bytes = 2;
         }
       else
         {
           g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                        _("Fatal parse error in brush file: Unknown depth %d."),
-                       header.bytes);
-          return NULL;
+                       header->bytes);
+          return FALSE;
         }
       /*  fallthrough  */
 
     case 2:
-      if (header.magic_number == GIMP_BRUSH_MAGIC)
+      if (header->magic_number == GIMP_BRUSH_MAGIC)
         break;
 
     default:
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Fatal parse error in brush file: Unknown version %d."),
-                   header.version);
-      return NULL;
+                   header->version);
+      return FALSE;
     }
 
-  if (header.header_size < sizeof (GimpBrushHeader))
+  if (header->header_size < sizeof (GimpBrushHeader))
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Unsupported brush format"));
-      return NULL;
+      return FALSE;
+    }
+
+  if (header->bytes != 1 && header->bytes != 2 && header->bytes != 4)
+    {
+      g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                   _("Fatal parse error in brush file:\n"
+                     "Unsupported brush depth %d\n"
+                     "GIMP brushes must be GRAY or RGBA."),
+                   header->bytes);
+      return FALSE;
     }
 
   /*  Read in the brush name  */
-  if ((bn_size = (header.header_size - sizeof (header))))
+  if ((bn_size = (header->header_size - sizeof (*header))))
     {
       gchar *utf8;
 
@@ -255,42 +427,53 @@ gimp_brush_load_brush (GimpContext   *context,
                          "Brush name is too long: %lu"),
                        gimp_file_get_utf8_name (file),
                        (gulong) bn_size);
-          return NULL;
+          return FALSE;
         }
 
-      name = g_new0 (gchar, bn_size + 1);
+      if (! name)
+        return g_input_stream_skip (input, bn_size, NULL, error) == bn_size;
 
-      if (! g_input_stream_read_all (input, name, bn_size,
+      *name = g_new0 (gchar, bn_size + 1);
+
+      if (! g_input_stream_read_all (input, *name, bn_size,
                                      &bytes_read, NULL, error) ||
           bytes_read != bn_size)
         {
-          g_free (name);
-          return NULL;
+          g_clear_pointer (name, g_free);
+          return FALSE;
         }
 
-      utf8 = gimp_any_to_utf8 (name, bn_size - 1,
+      utf8 = gimp_any_to_utf8 (*name, bn_size - 1,
                                _("Invalid UTF-8 string in brush file '%s'."),
                                gimp_file_get_utf8_name (file));
-      g_free (name);
-      name = utf8;
+      g_free (*name);
+      *name = utf8;
     }
 
-  if (! name)
-    name = g_strdup (_("Unnamed"));
+  return TRUE;
+}
 
-  brush = g_object_new (GIMP_TYPE_BRUSH,
-                        "name",      name,
-                        "mime-type", "image/x-gimp-gbr",
-                        NULL);
-  g_free (name);
+static gboolean
+gimp_brush_load_mask (GimpBrush        *brush,
+                      GInputStream     *input,
+                      GimpBrushHeader  *header,
+                      GError          **error)
+{
+  guchar   *mask;
+  gsize     bytes_read;
+  gssize    i, size;
+  gboolean  success = TRUE;
 
-  brush->priv->mask = gimp_temp_buf_new (header.width, header.height,
+  g_clear_pointer (&brush->priv->mask,   gimp_temp_buf_unref);
+  g_clear_pointer (&brush->priv->pixmap, gimp_temp_buf_unref);
+
+  brush->priv->mask = gimp_temp_buf_new (header->width, header->height,
                                          babl_format ("Y u8"));
 
   mask = gimp_temp_buf_get_data (brush->priv->mask);
-  size = header.width * header.height * header.bytes;
+  size = header->width * header->height * header->bytes;
 
-  switch (header.bytes)
+  switch (header->bytes)
     {
     case 1:
       success = (g_input_stream_read_all (input, mask, size,
@@ -323,8 +506,8 @@ gimp_brush_load_brush (GimpContext   *context,
                   ph.version      == 1                         &&
                   ph.header_size  > sizeof (GimpPatternHeader) &&
                   ph.bytes        == 3                         &&
-                  ph.width        == header.width              &&
-                  ph.height       == header.height             &&
+                  ph.width        == header->width             &&
+                  ph.height       == header->height            &&
                   g_input_stream_skip (input,
                                        ph.header_size -
                                        sizeof (GimpPatternHeader),
@@ -335,7 +518,7 @@ gimp_brush_load_brush (GimpContext   *context,
                   gssize  pixmap_size;
 
                   brush->priv->pixmap =
-                    gimp_temp_buf_new (header.width, header.height,
+                    gimp_temp_buf_new (header->width, header->height,
                                        babl_format ("R'G'B' u8"));
 
                   pixmap = gimp_temp_buf_get_data (brush->priv->pixmap);
@@ -405,7 +588,7 @@ gimp_brush_load_brush (GimpContext   *context,
         guchar *pixmap;
         guchar  buf[8 * 1024];
 
-        brush->priv->pixmap = gimp_temp_buf_new (header.width, header.height,
+        brush->priv->pixmap = gimp_temp_buf_new (header->width, header->height,
                                                  babl_format ("R'G'B' u8"));
         pixmap = gimp_temp_buf_get_data (brush->priv->pixmap);
 
@@ -437,98 +620,57 @@ gimp_brush_load_brush (GimpContext   *context,
       break;
 
     default:
-      g_object_unref (brush);
-      g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
-                   _("Fatal parse error in brush file:\n"
-                     "Unsupported brush depth %d\n"
-                     "GIMP brushes must be GRAY or RGBA."),
-                   header.bytes);
-      return NULL;
-    }
-
-  if (! success)
-    {
-      g_object_unref (brush);
-      return NULL;
+      g_return_val_if_reached (FALSE);
     }
 
-  brush->priv->spacing  = header.spacing;
-  brush->priv->x_axis.x = header.width  / 2.0;
-  brush->priv->x_axis.y = 0.0;
-  brush->priv->y_axis.x = 0.0;
-  brush->priv->y_axis.y = header.height / 2.0;
-
-  return brush;
+  return success;
 }
 
-GList *
-gimp_brush_load_abr (GimpContext   *context,
-                     GFile         *file,
-                     GInputStream  *input,
-                     GError       **error)
+static GimpBrush *
+gimp_brush_load_brush_real (GimpContext   *context,
+                            GFile         *file,
+                            GInputStream  *input,
+                            gboolean       lazy,
+                            GError       **error)
 {
-  GDataInputStream *data_input;
-  AbrHeader         abr_hdr;
-  GList            *brush_list = NULL;
-  GError           *my_error   = NULL;
-
-  g_return_val_if_fail (G_IS_FILE (file), NULL);
-  g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
-  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-  data_input = g_data_input_stream_new (input);
+  GimpBrush       *brush;
+  GimpBrushHeader  header;
+  gchar           *name = NULL;
 
-  g_data_input_stream_set_byte_order (data_input,
-                                      G_DATA_STREAM_BYTE_ORDER_BIG_ENDIAN);
+  if (! gimp_brush_load_header (file, input, &header, &name, error))
+    return NULL;
 
-  abr_hdr.version = abr_read_short (data_input, &my_error);
-  if (my_error)
-    goto done;
+  if (! name)
+    name = g_strdup (_("Unnamed"));
 
-  /* sub-version for ABR v6 */
-  abr_hdr.count = abr_read_short (data_input, &my_error);
-  if (my_error)
-    goto done;
+  brush = g_object_new (GIMP_TYPE_BRUSH,
+                        "name",      name,
+                        "mime-type", "image/x-gimp-gbr",
+                        NULL);
+  g_free (name);
 
-  if (abr_supported (&abr_hdr, &my_error))
+  if (lazy)
     {
-      switch (abr_hdr.version)
-        {
-        case 1:
-        case 2:
-          brush_list = gimp_brush_load_abr_v12 (data_input, &abr_hdr,
-                                                file, &my_error);
-          break;
+      brush->priv->lazy_width  = header.width;
+      brush->priv->lazy_height = header.height;
 
-        case 10:
-        case 6:
-          brush_list = gimp_brush_load_abr_v6 (data_input, &abr_hdr,
-                                               file, &my_error);
-          break;
-        }
+      gimp_data_set_lazy (GIMP_DATA (brush), context->gimp);
     }
-
- done:
-
-  g_object_unref (data_input);
-
-  if (! brush_list)
+  else if (! gimp_brush_load_mask (brush, input, &header, error))
     {
-      if (! my_error)
-        g_set_error (&my_error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
-                     _("Unable to decode abr format version %d."),
-                     abr_hdr.version);
+      g_object_unref (brush);
+      return NULL;
     }
 
-  if (my_error)
-    g_propagate_error (error, my_error);
+  brush->priv->spacing  = header.spacing;
+  brush->priv->x_axis.x = header.width  / 2.0;
+  brush->priv->x_axis.y = 0.0;
+  brush->priv->y_axis.x = 0.0;
+  brush->priv->y_axis.y = header.height / 2.0;
 
-  return g_list_reverse (brush_list);
+  return brush;
 }
 
-
-/*  private functions  */
-
 static GList *
 gimp_brush_load_abr_v12 (GDataInputStream  *input,
                          AbrHeader         *abr_hdr,
@@ -33,6 +33,13 @@ GimpBrush * gimp_brush_load_brush  (GimpContext   *context,
                                     GFile         *file,
                                     GInputStream  *input,
                                     GError       **error);
+GList     * gimp_brush_load_lazy   (GimpContext   *context,
+                                    GFile         *file,
+                                    GInputStream  *input,
+                                    GError       **error);
+gboolean    gimp_brush_load_pixels (GimpData      *data,
+                                    GInputStream  *input,
+                                    GError       **error);
 
 GList     * gimp_brush_load_abr    (GimpContext   *context,
                                     GFile         *file,
@@ -41,6 +41,9 @@ struct _GimpBrushPrivate
   GimpBrushCache  *mask_cache;
   GimpBrushCache  *pixmap_cache;
   GimpBrushCache  *boundary_cache;
+
+  gint             lazy_width;  /*  the size of a lazily loaded brush, */
+  gint             lazy_height; /*  whose mask may not be loaded       */
 };
 
 
@@ -43,6 +43,12 @@
 #include "gimp-intl.h"
 
 
+/*  the maximal distance, in pixels, by which the edge of a brush may be
+ *  displaced by rounding the brush angle
+ */
+#define MAX_ANGLE_ERROR 0.25
+
+
 enum
 {
   SPACING_CHANGED,
@@ -85,6 +91,7 @@ static void          gimp_brush_dirty                 (GimpData             *dat
 static const gchar * gimp_brush_get_extension         (GimpData             *data);
 static void          gimp_brush_copy                  (GimpData             *data,
                                                        GimpData             *src_data);
+static gboolean      gimp_brush_unload_lazy           (GimpData             *data);
 
 static void          gimp_brush_real_begin_use        (GimpBrush            *brush);
 static void          gimp_brush_real_end_use          (GimpBrush            *brush);
@@ -95,6 +102,13 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
                                                        const GimpCoords     *last_coords,
                                                        const GimpCoords     *current_coords);
 
+static void          gimp_brush_get_mask_size         (GimpBrush            *brush,
+                                                       gint                 *width,
+                                                       gint                 *height);
+static gdouble       gimp_brush_quantize_angle        (GimpBrush            *brush,
+                                                       gdouble               scale,
+                                                       gdouble               angle);
+
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
 
@@ -139,6 +153,8 @@ gimp_brush_class_init (GimpBrushClass *klass)
   data_class->save                  = gimp_brush_save;
   data_class->get_extension         = gimp_brush_get_extension;
   data_class->copy                  = gimp_brush_copy;
+  data_class->load_lazy             = gimp_brush_load_pixels;
+  data_class->unload_lazy           = gimp_brush_unload_lazy;
 
   klass->begin_use                  = gimp_brush_real_begin_use;
   klass->end_use                    = gimp_brush_real_end_use;
@@ -258,10 +274,7 @@ gimp_brush_get_size (GimpViewable *viewable,
                      gint         *width,
                      gint         *height)
 {
-  GimpBrush *brush = GIMP_BRUSH (viewable);
-
-  *width  = gimp_temp_buf_get_width  (brush->priv->mask);
-  *height = gimp_temp_buf_get_height (brush->priv->mask);
+  gimp_brush_get_mask_size (GIMP_BRUSH (viewable), width, height);
 
   return TRUE;
 }
@@ -272,17 +285,24 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
                             gint          width,
                             gint          height)
 {
-  GimpBrush         *brush       = GIMP_BRUSH (viewable);
-  const GimpTempBuf *mask_buf    = brush->priv->mask;
-  const GimpTempBuf *pixmap_buf  = brush->priv->pixmap;
-  GimpTempBuf       *return_buf  = NULL;
-  gint               mask_width;
-  gint               mask_height;
-  guchar            *mask_data;
-  guchar            *mask;
-  guchar            *buf;
-  gint               x, y;
-  gboolean           scaled = FALSE;
+  GimpBrush   *brush      = GIMP_BRUSH (viewable);
+  GimpTempBuf *mask_buf;
+  GimpTempBuf *pixmap_buf = NULL;
+  GimpTempBuf *return_buf = NULL;
+  gint         mask_width;
+  gint         mask_height;
+  guchar      *mask_data;
+  guchar      *mask;
+  guchar      *buf;
+  gint         x, y;
+  gboolean     scaled = FALSE;
+
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
+  mask_buf = gimp_temp_buf_ref (brush->priv->mask);
+
+  if (brush->priv->pixmap)
+    pixmap_buf = gimp_temp_buf_ref (brush->priv->pixmap);
 
   mask_width  = gimp_temp_buf_get_width  (mask_buf);
   mask_height = gimp_temp_buf_get_height (mask_buf);
@@ -297,6 +317,8 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
         {
           gimp_brush_begin_use (brush);
 
+          gimp_temp_buf_unref (mask_buf);
+
           if (GIMP_IS_BRUSH_GENERATED (brush))
             {
                GimpBrushGenerated *gen_brush = GIMP_BRUSH_GENERATED (brush);
@@ -314,16 +336,16 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
           if (! mask_buf)
             {
               mask_buf = gimp_temp_buf_new (1, 1, babl_format ("Y u8"));
-              gimp_temp_buf_data_clear ((GimpTempBuf *) mask_buf);
-            }
-          else
-            {
-              gimp_temp_buf_ref ((GimpTempBuf *) mask_buf);
+              gimp_temp_buf_data_clear (mask_buf);
             }
 
           if (pixmap_buf)
-            pixmap_buf = gimp_brush_transform_pixmap (brush, scale,
-                                                      0.0, 0.0, FALSE, 1.0);
+            {
+              gimp_temp_buf_unref (pixmap_buf);
+
+              pixmap_buf = gimp_brush_transform_pixmap (brush, scale,
+                                                        0.0, 0.0, FALSE, 1.0);
+            }
 
           mask_width  = gimp_temp_buf_get_width  (mask_buf);
           mask_height = gimp_temp_buf_get_height (mask_buf);
@@ -377,12 +399,11 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
 
   gimp_temp_buf_unlock (mask_buf, mask_data);
 
-  if (scaled)
-    {
-      gimp_temp_buf_unref ((GimpTempBuf *) mask_buf);
+  gimp_temp_buf_unref (mask_buf);
+  g_clear_pointer (&pixmap_buf, gimp_temp_buf_unref);
 
-      gimp_brush_end_use (brush);
-    }
+  if (scaled)
+    gimp_brush_end_use (brush);
 
   return return_buf;
 }
@@ -392,11 +413,14 @@ gimp_brush_get_description (GimpViewable  *viewable,
                             gchar        **tooltip)
 {
   GimpBrush *brush = GIMP_BRUSH (viewable);
+  gint       width;
+  gint       height;
+
+  gimp_brush_get_mask_size (brush, &width, &height);
 
   return g_strdup_printf ("%s (%d × %d)",
                           gimp_object_get_name (brush),
-                          gimp_temp_buf_get_width  (brush->priv->mask),
-                          gimp_temp_buf_get_height (brush->priv->mask));
+                          width, height);
 }
 
 static void
@@ -449,28 +473,68 @@ gimp_brush_copy (GimpData *data,
   gimp_data_dirty (data);
 }
 
+static gboolean
+gimp_brush_unload_lazy (GimpData *data)
+{
+  GimpBrush *brush = GIMP_BRUSH (data);
+
+  if (brush->priv->use_count > 0)
+    return FALSE;
+
+  g_clear_pointer (&brush->priv->mask,           gimp_temp_buf_unref);
+  g_clear_pointer (&brush->priv->pixmap,         gimp_temp_buf_unref);
+  g_clear_pointer (&brush->priv->blurred_mask,   gimp_temp_buf_unref);
+  g_clear_pointer (&brush->priv->blurred_pixmap, gimp_temp_buf_unref);
+
+  gimp_brush_mipmap_clear (brush);
+
+  if (brush->priv->mask_cache)
+    gimp_brush_cache_clear (brush->priv->mask_cache);
+
+  if (brush->priv->pixmap_cache)
+    gimp_brush_cache_clear (brush->priv->pixmap_cache);
+
+  if (brush->priv->boundary_cache)
+    gimp_brush_cache_clear (brush->priv->boundary_cache);
+
+  return TRUE;
+}
+
 static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
+  if (brush->priv->mask_cache)
+    return;
+
   brush->priv->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GBoxedCopyFunc)         gimp_temp_buf_ref,
+                          (GDestroyNotify)         gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'M', 'm');
 
   brush->priv->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GBoxedCopyFunc)         gimp_temp_buf_ref,
+                          (GDestroyNotify)         gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'P', 'p');
 
   brush->priv->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GBoxedCopyFunc)         gimp_bezier_desc_copy,
+                          (GDestroyNotify)         gimp_bezier_desc_free,
+                          (GimpBrushCacheSizeFunc) gimp_bezier_desc_get_memsize,
+                          'B', 'b');
 }
 
 static void
 gimp_brush_real_end_use (GimpBrush *brush)
 {
-  g_clear_object (&brush->priv->mask_cache);
-  g_clear_object (&brush->priv->pixmap_cache);
-  g_clear_object (&brush->priv->boundary_cache);
-
   g_clear_pointer (&brush->priv->blurred_mask,   gimp_temp_buf_unref);
   g_clear_pointer (&brush->priv->blurred_pixmap, gimp_temp_buf_unref);
+
+  /*  the brush caches share a common memory budget, so we keep them
+   *  around until the brush is finalized, instead of transforming the
+   *  brush all over again the next time it's used
+   */
 }
 
 static GimpBrush *
@@ -489,12 +553,58 @@ gimp_brush_real_want_null_motion (GimpBrush        *brush,
   return TRUE;
 }
 
+static void
+gimp_brush_get_mask_size (GimpBrush *brush,
+                          gint      *width,
+                          gint      *height)
+{
+  if (brush->priv->mask)
+    {
+      *width  = gimp_temp_buf_get_width  (brush->priv->mask);
+      *height = gimp_temp_buf_get_height (brush->priv->mask);
+    }
+  else
+    {
+      *width  = brush->priv->lazy_width;
+      *height = brush->priv->lazy_height;
+    }
+}
+
+/*  rounds 'angle' so that the brush edge moves by at most MAX_ANGLE_ERROR
+ *  pixels.  this way, continuously varying angles, as produced by angle
+ *  dynamics or jitter, map to a finite number of cached masks.  multiples of
+ *  a quarter turn are always kept exact.
+ */
+static gdouble
+gimp_brush_quantize_angle (GimpBrush *brush,
+                           gdouble    scale,
+                           gdouble    angle)
+{
+  gint    width;
+  gint    height;
+  gdouble radius;
+  gdouble n_steps;
+
+  gimp_brush_get_mask_size (brush, &width, &height);
+
+  radius = scale * hypot (width, height) / 2.0;
+
+  n_steps = 4.0 * ceil (G_PI * radius / MAX_ANGLE_ERROR / 4.0);
+
+  if (n_steps < 4.0)
+    return angle;
+
+  return RINT (angle * n_steps) / n_steps;
+}
+
 static gchar *
 gimp_brush_get_checksum (GimpTagged *tagged)
 {
   GimpBrush *brush           = GIMP_BRUSH (tagged);
   gchar     *checksum_string = NULL;
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   if (brush->priv->mask)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
@@ -561,6 +671,9 @@ gimp_brush_begin_use (GimpBrush *brush)
 {
   g_return_if_fail (GIMP_IS_BRUSH (brush));
 
+  /*  brushes in use are never unloaded  */
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   brush->priv->use_count++;
 
   if (brush->priv->use_count == 1)
@@ -625,18 +738,20 @@ gimp_brush_transform_size (GimpBrush     *brush,
       aspect_ratio      == 0.0 &&
       fmod (angle, 0.5) == 0.0)
     {
-      *width  = gimp_temp_buf_get_width  (brush->priv->mask);
-      *height = gimp_temp_buf_get_height (brush->priv->mask);
+      gimp_brush_get_mask_size (brush, width, height);
 
       return;
     }
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   GIMP_BRUSH_GET_CLASS (brush)->transform_size (brush,
                                                 scale, aspect_ratio, angle, reflect,
                                                 width, height);
 }
 
-const GimpTempBuf *
+/*  returns a new reference to the transformed mask  */
+GimpTempBuf *
 gimp_brush_transform_mask (GimpBrush *brush,
                            gdouble    scale,
                            gdouble    aspect_ratio,
@@ -644,14 +759,18 @@ gimp_brush_transform_mask (GimpBrush *brush,
                            gboolean   reflect,
                            gdouble    hardness)
 {
-  const GimpTempBuf *mask;
-  gint               width;
-  gint               height;
-  gdouble            effective_hardness = hardness;
+  GimpTempBuf *mask;
+  gint         width;
+  gint         height;
+  gdouble      effective_hardness = hardness;
 
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
+  angle = gimp_brush_quantize_angle (brush, scale, angle);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -695,7 +814,7 @@ gimp_brush_transform_mask (GimpBrush *brush,
                                                            effective_hardness);
 
       gimp_brush_cache_add (brush->priv->mask_cache,
-                            (gpointer) mask,
+                            gimp_temp_buf_ref (mask),
                             width, height,
                             scale, aspect_ratio, angle, reflect, effective_hardness);
     }
@@ -703,7 +822,8 @@ gimp_brush_transform_mask (GimpBrush *brush,
   return mask;
 }
 
-const GimpTempBuf *
+/*  returns a new reference to the transformed pixmap  */
+GimpTempBuf *
 gimp_brush_transform_pixmap (GimpBrush *brush,
                              gdouble    scale,
                              gdouble    aspect_ratio,
@@ -711,15 +831,17 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
                              gboolean   reflect,
                              gdouble    hardness)
 {
-  const GimpTempBuf *pixmap;
-  gint               width;
-  gint               height;
-  gdouble            effective_hardness = hardness;
+  GimpTempBuf *pixmap;
+  gint         width;
+  gint         height;
+  gdouble      effective_hardness = hardness;
 
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
-  g_return_val_if_fail (brush->priv->pixmap != NULL, NULL);
+  g_return_val_if_fail (gimp_brush_get_pixmap (brush) != NULL, NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  angle = gimp_brush_quantize_angle (brush, scale, angle);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -758,7 +880,7 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
                                                                effective_hardness);
 
       gimp_brush_cache_add (brush->priv->pixmap_cache,
-                            (gpointer) pixmap,
+                            gimp_temp_buf_ref (pixmap),
                             width, height,
                             scale, aspect_ratio, angle, reflect, effective_hardness);
     }
@@ -766,7 +888,8 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
   return pixmap;
 }
 
-const GimpBezierDesc *
+/*  returns a newly allocated copy of the transformed boundary  */
+GimpBezierDesc *
 gimp_brush_transform_boundary (GimpBrush *brush,
                                gdouble    scale,
                                gdouble    aspect_ratio,
@@ -776,13 +899,17 @@ gimp_brush_transform_boundary (GimpBrush *brush,
                                gint      *width,
                                gint      *height)
 {
-  const GimpBezierDesc *boundary;
+  GimpBezierDesc *boundary;
 
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
   g_return_val_if_fail (width != NULL, NULL);
   g_return_val_if_fail (height != NULL, NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
+  angle = gimp_brush_quantize_angle (brush, scale, angle);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              width, height);
@@ -810,7 +937,7 @@ gimp_brush_transform_boundary (GimpBrush *brush,
        */
       if (boundary)
         gimp_brush_cache_add (brush->priv->boundary_cache,
-                              (gpointer) boundary,
+                              gimp_bezier_desc_copy (boundary),
                               *width, *height,
                               scale, aspect_ratio, angle, reflect, hardness);
     }
@@ -824,6 +951,8 @@ gimp_brush_get_mask (GimpBrush *brush)
   g_return_val_if_fail (brush != NULL, NULL);
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   if (brush->priv->blurred_mask)
     {
       return brush->priv->blurred_mask;
@@ -837,6 +966,8 @@ gimp_brush_get_pixmap (GimpBrush *brush)
   g_return_val_if_fail (brush != NULL, NULL);
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   if(brush->priv->blurred_pixmap)
     {
       return brush->priv->blurred_pixmap;
@@ -881,6 +1012,9 @@ gimp_brush_get_width (GimpBrush *brush)
   if (brush->priv->blurred_pixmap)
     return gimp_temp_buf_get_width (brush->priv->blurred_pixmap);
 
+  if (! brush->priv->mask)
+    return brush->priv->lazy_width;
+
   return gimp_temp_buf_get_width (brush->priv->mask);
 }
 
@@ -895,6 +1029,9 @@ gimp_brush_get_height (GimpBrush *brush)
   if (brush->priv->blurred_pixmap)
     return gimp_temp_buf_get_height (brush->priv->blurred_pixmap);
 
+  if (! brush->priv->mask)
+    return brush->priv->lazy_height;
+
   return gimp_temp_buf_get_height (brush->priv->mask);
 }
 
@@ -33,13 +33,19 @@
 #include "gimp-intl.h"
 
 
-#define MAX_CACHED_DATA 20
+/*  the total size of the data kept in all brush caches.  the least recently
+ *  used data is evicted, regardless of which cache it belongs to, once the
+ *  total exceeds this size.
+ */
+#define MAX_CACHED_MEMSIZE (128 * 1024 * 1024)
 
 
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_COPY,
+  PROP_DATA_DESTROY,
+  PROP_DATA_SIZE
 };
 
 
@@ -47,28 +53,39 @@ typedef struct _GimpBrushCacheUnit GimpBrushCacheUnit;
 
 struct _GimpBrushCacheUnit
 {
-  gpointer data;
-
-  gint     width;
-  gint     height;
-  gdouble  scale;
-  gdouble  aspect_ratio;
-  gdouble  angle;
-  gboolean reflect;
-  gdouble  hardness;
+  GimpBrushCache *cache;
+  GList           link;  /*  link in the global LRU list  */
+
+  gpointer        data;
+  gsize           size;
+
+  gint            width;
+  gint            height;
+  gdouble         scale;
+  gdouble         aspect_ratio;
+  gdouble         angle;
+  gboolean        reflect;
+  gdouble         hardness;
 };
 
 
-static void   gimp_brush_cache_constructed  (GObject      *object);
-static void   gimp_brush_cache_finalize     (GObject      *object);
-static void   gimp_brush_cache_set_property (GObject      *object,
-                                             guint         property_id,
-                                             const GValue *value,
-                                             GParamSpec   *pspec);
-static void   gimp_brush_cache_get_property (GObject      *object,
-                                             guint         property_id,
-                                             GValue       *value,
-                                             GParamSpec   *pspec);
+static void       gimp_brush_cache_constructed  (GObject                  *object);
+static void       gimp_brush_cache_finalize     (GObject                  *object);
+static void       gimp_brush_cache_set_property (GObject                  *object,
+                                                 guint                     property_id,
+                                                 const GValue             *value,
+                                                 GParamSpec               *pspec);
+static void       gimp_brush_cache_get_property (GObject                  *object,
+                                                 guint                     property_id,
+                                                 GValue                   *value,
+                                                 GParamSpec               *pspec);
+
+static guint      gimp_brush_cache_unit_hash    (const GimpBrushCacheUnit *unit);
+static gboolean   gimp_brush_cache_unit_equal   (const GimpBrushCacheUnit *unit1,
+                                                 const GimpBrushCacheUnit *unit2);
+static void       gimp_brush_cache_unit_remove  (GimpBrushCacheUnit       *unit,
+                                                 GSList                  **garbage);
+static void       gimp_brush_cache_unit_free    (GimpBrushCacheUnit       *unit);
 
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
@@ -76,6 +93,18 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 #define parent_class gimp_brush_cache_parent_class
 
 
+/*  all the caches share a single LRU list, and a single lock protecting it,
+ *  as well as the caches' own hash tables.
+ */
+static GMutex   gimp_brush_cache_mutex;
+static GQueue   gimp_brush_cache_lru = G_QUEUE_INIT;
+
+static guint64  gimp_brush_cache_total_memsize;
+static guint64  gimp_brush_cache_total_evicted;
+static gint     gimp_brush_cache_n_hits;
+static gint     gimp_brush_cache_n_misses;
+
+
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
@@ -86,16 +115,31 @@ gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
   object_class->set_property = gimp_brush_cache_set_property;
   object_class->get_property = gimp_brush_cache_get_property;
 
+  g_object_class_install_property (object_class, PROP_DATA_COPY,
+                                   g_param_spec_pointer ("data-copy",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
+
   g_object_class_install_property (object_class, PROP_DATA_DESTROY,
                                    g_param_spec_pointer ("data-destroy",
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_SIZE,
+                                   g_param_spec_pointer ("data-size",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
-gimp_brush_cache_init (GimpBrushCache *brush)
+gimp_brush_cache_init (GimpBrushCache *cache)
 {
+  cache->cached_units =
+    g_hash_table_new ((GHashFunc)  gimp_brush_cache_unit_hash,
+                      (GEqualFunc) gimp_brush_cache_unit_equal);
 }
 
 static void
@@ -105,7 +149,9 @@ gimp_brush_cache_constructed (GObject *object)
 
   G_OBJECT_CLASS (parent_class)->constructed (object);
 
+  gimp_assert (cache->data_copy    != NULL);
   gimp_assert (cache->data_destroy != NULL);
+  gimp_assert (cache->data_size    != NULL);
 }
 
 static void
@@ -115,6 +161,8 @@ gimp_brush_cache_finalize (GObject *object)
 
   gimp_brush_cache_clear (cache);
 
+  g_clear_pointer (&cache->cached_units, g_hash_table_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -128,10 +176,18 @@ gimp_brush_cache_set_property (GObject      *object,
 
   switch (property_id)
     {
+    case PROP_DATA_COPY:
+      cache->data_copy = g_value_get_pointer (value);
+      break;
+
     case PROP_DATA_DESTROY:
       cache->data_destroy = g_value_get_pointer (value);
       break;
 
+    case PROP_DATA_SIZE:
+      cache->data_size = g_value_get_pointer (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -148,30 +204,101 @@ gimp_brush_cache_get_property (GObject    *object,
 
   switch (property_id)
     {
+    case PROP_DATA_COPY:
+      g_value_set_pointer (value, cache->data_copy);
+      break;
+
     case PROP_DATA_DESTROY:
       g_value_set_pointer (value, cache->data_destroy);
       break;
 
+    case PROP_DATA_SIZE:
+      g_value_set_pointer (value, cache->data_size);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
 }
 
+static guint
+gimp_brush_cache_unit_hash (const GimpBrushCacheUnit *unit)
+{
+  guint hash;
+
+  hash =               unit->width;
+  hash = hash * 31 +   unit->height;
+  hash = hash * 31 +   g_double_hash (&unit->scale);
+  hash = hash * 31 +   g_double_hash (&unit->aspect_ratio);
+  hash = hash * 31 +   g_double_hash (&unit->angle);
+  hash = hash * 31 + ! unit->reflect;
+  hash = hash * 31 +   g_double_hash (&unit->hardness);
+
+  return hash;
+}
+
+static gboolean
+gimp_brush_cache_unit_equal (const GimpBrushCacheUnit *unit1,
+                             const GimpBrushCacheUnit *unit2)
+{
+  return unit1->width        == unit2->width        &&
+         unit1->height       == unit2->height       &&
+         unit1->scale        == unit2->scale        &&
+         unit1->aspect_ratio == unit2->aspect_ratio &&
+         unit1->angle        == unit2->angle        &&
+         ! unit1->reflect    == ! unit2->reflect    &&
+         unit1->hardness     == unit2->hardness;
+}
+
+/*  must be called with the lock held.  the unit is added to 'garbage', and
+ *  should be freed after releasing the lock, since destroying the data might
+ *  be expensive.
+ */
+static void
+gimp_brush_cache_unit_remove (GimpBrushCacheUnit  *unit,
+                              GSList             **garbage)
+{
+  g_hash_table_remove (unit->cache->cached_units, unit);
+  g_queue_unlink (&gimp_brush_cache_lru, &unit->link);
+
+  gimp_brush_cache_total_memsize -= unit->size;
+
+  *garbage = g_slist_prepend (*garbage, unit);
+}
+
+static void
+gimp_brush_cache_unit_free (GimpBrushCacheUnit *unit)
+{
+  unit->cache->data_destroy (unit->data);
+
+  g_slice_free (GimpBrushCacheUnit, unit);
+}
+
 
 /*  public functions  */
 
+/*  'data_copy' should return a reference to, or a copy of, the cached data.
+ *  it's used to hand out data which stays valid even if another thread
+ *  evicts it from the cache in the meantime.
+ */
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GBoxedCopyFunc         data_copy,
+                      GDestroyNotify         data_destroy,
+                      GimpBrushCacheSizeFunc data_size,
+                      gchar                  debug_hit,
+                      gchar                  debug_miss)
 {
   GimpBrushCache *cache;
 
+  g_return_val_if_fail (data_copy != NULL, NULL);
   g_return_val_if_fail (data_destroy != NULL, NULL);
+  g_return_val_if_fail (data_size != NULL, NULL);
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
+                         "data-copy",    data_copy,
                          "data-destroy", data_destroy,
+                         "data-size",    data_size,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -183,25 +310,38 @@ gimp_brush_cache_new (GDestroyNotify  data_destroy,
 void
 gimp_brush_cache_clear (GimpBrushCache *cache)
 {
+  GHashTableIter  iter;
+  gpointer        unit;
+  GSList         *garbage = NULL;
+
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->cached_units)
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  g_hash_table_iter_init (&iter, cache->cached_units);
+
+  while (g_hash_table_iter_next (&iter, &unit, NULL))
     {
-      GList *iter;
+      g_hash_table_iter_steal (&iter);
 
-      for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-        {
-          GimpBrushCacheUnit *unit = iter->data;
+      g_queue_unlink (&gimp_brush_cache_lru,
+                      &((GimpBrushCacheUnit *) unit)->link);
 
-          cache->data_destroy (unit->data);
-        }
+      gimp_brush_cache_total_memsize -= ((GimpBrushCacheUnit *) unit)->size;
 
-      g_list_free_full (cache->cached_units, g_free);
-      cache->cached_units = NULL;
+      garbage = g_slist_prepend (garbage, unit);
     }
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+
+  g_slist_free_full (garbage, (GDestroyNotify) gimp_brush_cache_unit_free);
 }
 
-gconstpointer
+/*  returns a new reference to, or a copy of, the cached data, as returned by
+ *  the cache's 'data_copy' function, which should be freed with its
+ *  'data_destroy' function.
+ */
+gpointer
 gimp_brush_cache_get (GimpBrushCache *cache,
                       gint            width,
                       gint            height,
@@ -211,43 +351,57 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList *iter;
+  GimpBrushCacheUnit  key;
+  GimpBrushCacheUnit *unit;
+  gpointer            data = NULL;
 
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  key.width        = width;
+  key.height       = height;
+  key.scale        = scale;
+  key.aspect_ratio = aspect_ratio;
+  key.angle        = angle;
+  key.reflect      = reflect;
+  key.hardness     = hardness;
+
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  unit = g_hash_table_lookup (cache->cached_units, &key);
+
+  if (unit)
     {
-      GimpBrushCacheUnit *unit = iter->data;
-
-      if (unit->data                         &&
-          unit->width        == width        &&
-          unit->height       == height       &&
-          unit->scale        == scale        &&
-          unit->aspect_ratio == aspect_ratio &&
-          unit->angle        == angle        &&
-          unit->reflect      == reflect      &&
-          unit->hardness     == hardness)
-        {
-          if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-            g_printerr ("%c", cache->debug_hit);
-
-          /* Make the returned cached brush first in the list. */
-          cache->cached_units = g_list_remove_link (cache->cached_units, iter);
-          iter->next = cache->cached_units;
-          if (cache->cached_units)
-            cache->cached_units->prev = iter;
-          cache->cached_units = iter;
-
-          return (gconstpointer) unit->data;
-        }
+      /* Make the returned cached brush first in the list. */
+      g_queue_unlink (&gimp_brush_cache_lru, &unit->link);
+      g_queue_push_head_link (&gimp_brush_cache_lru, &unit->link);
+
+      data = cache->data_copy (unit->data);
     }
 
-  if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-    g_printerr ("%c", cache->debug_miss);
+  g_mutex_unlock (&gimp_brush_cache_mutex);
 
-  return NULL;
+  if (data)
+    {
+      g_atomic_int_inc (&gimp_brush_cache_n_hits);
+
+      if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
+        g_printerr ("%c", cache->debug_hit);
+    }
+  else
+    {
+      g_atomic_int_inc (&gimp_brush_cache_n_misses);
+
+      if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
+        g_printerr ("%c", cache->debug_miss);
+    }
+
+  return data;
 }
 
+/*  takes ownership of 'data'.  if the cache already contains data for the
+ *  same parameters, e.g. because another thread added it first, the old data
+ *  is replaced.
+ */
 void
 gimp_brush_cache_add (GimpBrushCache *cache,
                       gpointer        data,
@@ -259,37 +413,19 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList              *iter;
   GimpBrushCacheUnit *unit;
-  GList              *last   = NULL;
-  gint                length = 0;
+  GimpBrushCacheUnit *old_unit;
+  GSList             *garbage = NULL;
 
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-    {
-      unit = iter->data;
-
-      if (data == unit->data)
-        return;
-
-      length++;
-      last = iter;
-    }
-
-  if (length > MAX_CACHED_DATA)
-    {
-      unit = last->data;
-
-      cache->data_destroy (unit->data);
-      cache->cached_units = g_list_delete_link (cache->cached_units, last);
-      g_free (unit);
-    }
-
-  unit = g_new0 (GimpBrushCacheUnit, 1);
+  unit = g_slice_new0 (GimpBrushCacheUnit);
 
+  unit->cache        = cache;
+  unit->link.data    = unit;
   unit->data         = data;
+  unit->size         = cache->data_size (data);
   unit->width        = width;
   unit->height       = height;
   unit->scale        = scale;
@@ -298,5 +434,71 @@ gimp_brush_cache_add (GimpBrushCache *cache,
   unit->reflect      = reflect;
   unit->hardness     = hardness;
 
-  cache->cached_units = g_list_prepend (cache->cached_units, unit);
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  old_unit = g_hash_table_lookup (cache->cached_units, unit);
+
+  if (old_unit)
+    gimp_brush_cache_unit_remove (old_unit, &garbage);
+
+  g_hash_table_add (cache->cached_units, unit);
+  g_queue_push_head_link (&gimp_brush_cache_lru, &unit->link);
+
+  gimp_brush_cache_total_memsize += unit->size;
+
+  /*  evict the least recently used data, but always keep the data we just
+   *  added, even if it exceeds the budget on its own
+   */
+  while (gimp_brush_cache_total_memsize > MAX_CACHED_MEMSIZE &&
+         gimp_brush_cache_lru.tail != &unit->link)
+    {
+      GimpBrushCacheUnit *lru_unit = gimp_brush_cache_lru.tail->data;
+
+      gimp_brush_cache_total_evicted += lru_unit->size;
+
+      gimp_brush_cache_unit_remove (lru_unit, &garbage);
+    }
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+
+  g_slist_free_full (garbage, (GDestroyNotify) gimp_brush_cache_unit_free);
+}
+
+guint64
+gimp_brush_cache_get_total_memsize (void)
+{
+  guint64 memsize;
+
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  memsize = gimp_brush_cache_total_memsize;
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+
+  return memsize;
+}
+
+guint64
+gimp_brush_cache_get_total_evicted (void)
+{
+  guint64 evicted;
+
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  evicted = gimp_brush_cache_total_evicted;
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+
+  return evicted;
+}
+
+void
+gimp_brush_cache_get_hit_miss (gint *n_hits,
+                               gint *n_misses)
+{
+  if (n_hits)
+    *n_hits = g_atomic_int_get (&gimp_brush_cache_n_hits);
+
+  if (n_misses)
+    *n_misses = g_atomic_int_get (&gimp_brush_cache_n_misses);
 }
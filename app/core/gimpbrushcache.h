@@ -35,16 +35,20 @@
 
 typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
+typedef gsize (* GimpBrushCacheSizeFunc) (gconstpointer data);
+
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject              parent_instance;
 
-  GDestroyNotify  data_destroy;
+  GBoxedCopyFunc          data_copy;
+  GDestroyNotify          data_destroy;
+  GimpBrushCacheSizeFunc  data_size;
 
-  GList          *cached_units;
+  GHashTable             *cached_units;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                   debug_hit;
+  gchar                   debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -53,31 +57,38 @@ struct _GimpBrushCacheClass
 };
 
 
-GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
-
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
-
-void             gimp_brush_cache_clear    (GimpBrushCache *cache);
-
-gconstpointer    gimp_brush_cache_get      (GimpBrushCache *cache,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gboolean        reflect,
-                                            gdouble         hardness);
-void             gimp_brush_cache_add      (GimpBrushCache *cache,
-                                            gpointer        data,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gboolean        reflect,
-                                            gdouble         hardness);
+GType            gimp_brush_cache_get_type           (void) G_GNUC_CONST;
+
+GimpBrushCache * gimp_brush_cache_new                (GBoxedCopyFunc          data_copy,
+                                                      GDestroyNotify          data_destroy,
+                                                      GimpBrushCacheSizeFunc  data_size,
+                                                      gchar                   debug_hit,
+                                                      gchar                   debug_miss);
+
+void             gimp_brush_cache_clear              (GimpBrushCache         *cache);
+
+gpointer         gimp_brush_cache_get                (GimpBrushCache         *cache,
+                                                      gint                    width,
+                                                      gint                    height,
+                                                      gdouble                 scale,
+                                                      gdouble                 aspect_ratio,
+                                                      gdouble                 angle,
+                                                      gboolean                reflect,
+                                                      gdouble                 hardness);
+void             gimp_brush_cache_add                (GimpBrushCache         *cache,
+                                                      gpointer                data,
+                                                      gint                    width,
+                                                      gint                    height,
+                                                      gdouble                 scale,
+                                                      gdouble                 aspect_ratio,
+                                                      gdouble                 angle,
+                                                      gboolean                reflect,
+                                                      gdouble                 hardness);
+
+guint64          gimp_brush_cache_get_total_memsize  (void);
+guint64          gimp_brush_cache_get_total_evicted  (void);
+void             gimp_brush_cache_get_hit_miss       (gint                   *n_hits,
+                                                      gint                   *n_misses);
 
 
 #endif  /*  __GIMP_BRUSH_CACHE_H__  */
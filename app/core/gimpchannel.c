@@ -312,6 +312,8 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->segs_in_cache  = gimp_boundary_cache_new ();
+  channel->segs_out_cache = gimp_boundary_cache_new ();
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -334,6 +336,9 @@ gimp_channel_finalize (GObject *object)
   g_clear_pointer (&channel->segs_in,  g_free);
   g_clear_pointer (&channel->segs_out, g_free);
 
+  g_clear_pointer (&channel->segs_in_cache,  gimp_boundary_cache_free);
+  g_clear_pointer (&channel->segs_out_cache, gimp_boundary_cache_free);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -346,6 +351,9 @@ gimp_channel_get_memsize (GimpObject *object,
   *gui_size += channel->num_segs_in  * sizeof (GimpBoundSeg);
   *gui_size += channel->num_segs_out * sizeof (GimpBoundSeg);
 
+  *gui_size += gimp_boundary_cache_get_memsize (channel->segs_in_cache);
+  *gui_size += gimp_boundary_cache_get_memsize (channel->segs_out_cache);
+
   return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
 }
 
@@ -966,6 +974,10 @@ gimp_channel_set_buffer (GimpDrawable        *drawable,
                                                   push_undo, undo_desc,
                                                   buffer, bounds);
 
+  /*  a new buffer may well end up at the address of the old one  */
+  gimp_boundary_cache_invalidate (channel->segs_in_cache,  NULL);
+  gimp_boundary_cache_invalidate (channel->segs_out_cache, NULL);
+
   gegl_buffer_signal_connect (buffer, "changed",
                               G_CALLBACK (gimp_channel_buffer_changed),
                               channel);
@@ -1040,12 +1052,14 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
+          channel->segs_out =
+            gimp_boundary_find_cached (channel->segs_out_cache,
+                                       buffer, &rect,
+                                       babl_format ("Y float"),
+                                       GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                       x1, y1, x2, y2,
+                                       GIMP_BOUNDARY_HALF_WAY,
+                                       &channel->num_segs_out);
           x1 = MAX (x1, x3);
           y1 = MAX (y1, y3);
           x2 = MIN (x2, x4);
@@ -1053,12 +1067,14 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           if (x2 > x1 && y2 > y1)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              channel->segs_in =
+                gimp_boundary_find_cached (channel->segs_in_cache,
+                                           buffer, NULL,
+                                           babl_format ("Y float"),
+                                           GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                           x1, y1, x2, y2,
+                                           GIMP_BOUNDARY_HALF_WAY,
+                                           &channel->num_segs_in);
             }
           else
             {
@@ -1494,6 +1510,13 @@ gimp_channel_buffer_changed (GeglBuffer          *buffer,
                              const GeglRectangle *rect,
                              GimpChannel         *channel)
 {
+  /*  only the bands of the boundary around 'rect' need to be found again.
+   *  "changed" is emitted by whatever thread wrote to the buffer, e.g. the
+   *  paint core's workers, which the boundary caches are locked against
+   */
+  gimp_boundary_cache_invalidate (channel->segs_in_cache,  rect);
+  gimp_boundary_cache_invalidate (channel->segs_out_cache, rect);
+
   gimp_drawable_invalidate_boundary (GIMP_DRAWABLE (channel));
 }
 
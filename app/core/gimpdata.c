@@ -27,6 +27,7 @@
 
 #include "core-types.h"
 
+#include "gimp.h"
 #include "gimp-memsize.h"
 #include "gimpdata.h"
 #include "gimpmarshal.h"
@@ -52,6 +53,12 @@ enum
 };
 
 
+/*  the amount of memory the pixels of lazily loaded data may take, before
+ *  the least recently used ones are dropped again
+ */
+#define LAZY_CACHE_SIZE (64 * 1024 * 1024)
+
+
 struct _GimpDataPrivate
 {
   GFile  *file;
@@ -63,6 +70,18 @@ struct _GimpDataPrivate
   gint    freeze_count;
   gint64  mtime;
 
+  /* Lazily loaded data, whose pixels may be loaded from another
+   * thread, which is why these are not bitfields. lazy_link is its
+   * link in lazy_queue while its pixels are loaded, and lazy_size the
+   * memory they took when they were. lazy_gimp is used to report
+   * errors while loading them.
+   */
+  gboolean  lazy;
+  gboolean  loaded;
+  GList    *lazy_link;
+  gint64    lazy_size;
+  Gimp     *lazy_gimp;
+
   /* Identifies the GimpData object across sessions. Used when there
    * is not a filename associated with the object.
    */
@@ -74,9 +93,17 @@ struct _GimpDataPrivate
 #define GIMP_DATA_GET_PRIVATE(obj) (((GimpData *) (obj))->priv)
 
 
+typedef struct
+{
+  Gimp  *gimp;
+  gchar *message;
+} GimpDataLazyReport;
+
+
 static void       gimp_data_tagged_iface_init (GimpTaggedInterface *iface);
 
 static void       gimp_data_constructed       (GObject             *object);
+static void       gimp_data_dispose           (GObject             *object);
 static void       gimp_data_finalize          (GObject             *object);
 static void       gimp_data_set_property      (GObject             *object,
                                                guint                property_id,
@@ -106,6 +133,13 @@ static GList    * gimp_data_get_tags          (GimpTagged          *tagged);
 static gchar    * gimp_data_get_identifier    (GimpTagged          *tagged);
 static gchar    * gimp_data_get_checksum      (GimpTagged          *tagged);
 
+static void       gimp_data_lazy_ensure_loaded (GimpData           *data);
+static void       gimp_data_lazy_load         (GimpData            *data);
+static void       gimp_data_lazy_forget       (GimpData            *data);
+static void       gimp_data_unset_lazy        (GimpData            *data);
+static gboolean   gimp_data_lazy_evict_idle   (gpointer             user_data);
+static gboolean   gimp_data_lazy_report_idle  (gpointer             user_data);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpData, gimp_data, GIMP_TYPE_VIEWABLE,
                          G_ADD_PRIVATE (GimpData)
@@ -116,6 +150,15 @@ G_DEFINE_TYPE_WITH_CODE (GimpData, gimp_data, GIMP_TYPE_VIEWABLE,
 
 static guint data_signals[LAST_SIGNAL] = { 0 };
 
+/*  the lazily loaded data whose pixels are loaded, least recently used
+ *  first.  the queue, and the loading and dropping of the pixels, are
+ *  protected by lazy_mutex.
+ */
+static GMutex  lazy_mutex;
+static GQueue  lazy_queue   = G_QUEUE_INIT;
+static gint64  lazy_total   = 0;
+static guint   lazy_idle_id = 0;
+
 
 static void
 gimp_data_class_init (GimpDataClass *klass)
@@ -135,6 +178,7 @@ gimp_data_class_init (GimpDataClass *klass)
                   G_TYPE_NONE, 0);
 
   object_class->constructed        = gimp_data_constructed;
+  object_class->dispose            = gimp_data_dispose;
   object_class->finalize           = gimp_data_finalize;
   object_class->set_property       = gimp_data_set_property;
   object_class->get_property       = gimp_data_get_property;
@@ -151,6 +195,8 @@ gimp_data_class_init (GimpDataClass *klass)
   klass->copy                      = NULL;
   klass->duplicate                 = gimp_data_real_duplicate;
   klass->compare                   = gimp_data_real_compare;
+  klass->load_lazy                 = NULL;
+  klass->unload_lazy               = NULL;
 
   g_object_class_install_property (object_class, PROP_FILE,
                                    g_param_spec_object ("file", NULL, NULL,
@@ -212,6 +258,24 @@ gimp_data_constructed (GObject *object)
   gimp_data_thaw (GIMP_DATA (object));
 }
 
+static void
+gimp_data_dispose (GObject *object)
+{
+  GimpDataPrivate *private = GIMP_DATA_GET_PRIVATE (object);
+
+  /*  make sure the eviction idle doesn't see the object while its
+   *  subclasses are being finalized
+   */
+  if (private->lazy_link)
+    {
+      g_mutex_lock (&lazy_mutex);
+      gimp_data_lazy_forget (GIMP_DATA (object));
+      g_mutex_unlock (&lazy_mutex);
+    }
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
 static void
 gimp_data_finalize (GObject *object)
 {
@@ -335,6 +399,9 @@ gimp_data_is_name_editable (GimpViewable *viewable)
 static void
 gimp_data_real_dirty (GimpData *data)
 {
+  /*  changed data can't be reloaded from its file anymore  */
+  gimp_data_unset_lazy (data);
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (data));
 
   /* Emit the "name-changed" to signal general dirtiness, our name
@@ -728,6 +795,9 @@ gimp_data_delete_from_disk (GimpData  *data,
   if (private->internal)
     return TRUE;
 
+  /*  the object may outlive its file  */
+  gimp_data_unset_lazy (data);
+
   return g_file_delete (private->file, NULL, error);
 }
 
@@ -779,6 +849,9 @@ gimp_data_set_file (GimpData *data,
   if (private->internal)
     return;
 
+  if (private->file && ! g_file_equal (file, private->file))
+    gimp_data_unset_lazy (data);
+
   g_set_object (&private->file, file);
 
   private->writable  = FALSE;
@@ -1111,7 +1184,12 @@ gimp_data_copy (GimpData *data,
                     GIMP_DATA_GET_CLASS (src_data)->copy);
 
   if (data != src_data)
-    GIMP_DATA_GET_CLASS (data)->copy (data, src_data);
+    {
+      gimp_data_ensure_loaded (src_data);
+      gimp_data_unset_lazy (data);
+
+      GIMP_DATA_GET_CLASS (data)->copy (data, src_data);
+    }
 }
 
 gboolean
@@ -1230,6 +1308,128 @@ gimp_data_compare (GimpData *data1,
   return GIMP_DATA_GET_CLASS (data1)->compare (data1, data2);
 }
 
+/**
+ * gimp_data_set_lazy:
+ * @data: a #GimpData object.
+ * @gimp: the #Gimp instance, used to report errors.
+ *
+ * Marks @data, which was just loaded without its pixels, as lazily
+ * loaded. Its pixels will be loaded from its file, using the class'
+ * load_lazy() method, when gimp_data_ensure_loaded() is first called,
+ * and dropped again using unload_lazy() when the pixels of too many
+ * lazily loaded objects are loaded at the same time.
+ *
+ * Any code accessing the pixels of @data must call
+ * gimp_data_ensure_loaded() first, or gimp_data_lock_loaded() when
+ * not on the main thread.
+ **/
+void
+gimp_data_set_lazy (GimpData *data,
+                    Gimp     *gimp)
+{
+  GimpDataPrivate *private;
+
+  g_return_if_fail (GIMP_IS_DATA (data));
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (GIMP_DATA_GET_CLASS (data)->load_lazy   != NULL);
+  g_return_if_fail (GIMP_DATA_GET_CLASS (data)->unload_lazy != NULL);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  private->lazy      = TRUE;
+  private->loaded    = FALSE;
+  private->lazy_gimp = gimp;
+}
+
+/**
+ * gimp_data_ensure_loaded:
+ * @data: a #GimpData object.
+ *
+ * Makes sure the pixels of @data are loaded, if it was lazily loaded,
+ * and marks it as most recently used.  If loading the pixels fails,
+ * @data keeps empty pixels of the right size.
+ *
+ * The pixels are only dropped again from the main loop, so on the main
+ * thread, they stay valid until control returns to it.  Other threads
+ * must use gimp_data_lock_loaded() instead, and take a reference to the
+ * pixels they use.
+ **/
+void
+gimp_data_ensure_loaded (GimpData *data)
+{
+  GimpDataPrivate *private;
+
+  g_return_if_fail (GIMP_IS_DATA (data));
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (! private->lazy)
+    return;
+
+  g_mutex_lock (&lazy_mutex);
+
+  gimp_data_lazy_ensure_loaded (data);
+
+  g_mutex_unlock (&lazy_mutex);
+}
+
+/**
+ * gimp_data_lock_loaded:
+ * @data: a #GimpData object.
+ *
+ * Like gimp_data_ensure_loaded(), but keeps the pixels of all lazily
+ * loaded data from being dropped until gimp_data_unlock_loaded() is
+ * called, so that references to them can be taken from any thread.
+ * Don't do anything more than that while the lock is held.
+ **/
+void
+gimp_data_lock_loaded (GimpData *data)
+{
+  GimpDataPrivate *private;
+
+  g_return_if_fail (GIMP_IS_DATA (data));
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  g_mutex_lock (&lazy_mutex);
+
+  if (private->lazy)
+    gimp_data_lazy_ensure_loaded (data);
+}
+
+/**
+ * gimp_data_unlock_loaded:
+ * @data: a #GimpData object.
+ *
+ * Releases the lock taken by gimp_data_lock_loaded().
+ **/
+void
+gimp_data_unlock_loaded (GimpData *data)
+{
+  g_return_if_fail (GIMP_IS_DATA (data));
+
+  g_mutex_unlock (&lazy_mutex);
+}
+
+/**
+ * gimp_data_is_loaded:
+ * @data: a #GimpData object.
+ *
+ * Returns: %FALSE if @data was lazily loaded, and its pixels are not
+ *          currently loaded, %TRUE otherwise.
+ **/
+gboolean
+gimp_data_is_loaded (GimpData *data)
+{
+  GimpDataPrivate *private;
+
+  g_return_val_if_fail (GIMP_IS_DATA (data), FALSE);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  return ! private->lazy || private->loaded;
+}
+
 /**
  * gimp_data_error_quark:
  *
@@ -1243,3 +1443,208 @@ gimp_data_error_quark (void)
 {
   return g_quark_from_static_string ("gimp-data-error-quark");
 }
+
+
+/*  private functions  */
+
+/*  called with lazy_mutex held  */
+static void
+gimp_data_lazy_ensure_loaded (GimpData *data)
+{
+  GimpDataPrivate *private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (! private->loaded)
+    {
+      gimp_data_lazy_load (data);
+
+      private->loaded = TRUE;
+
+      if (private->lazy)
+        {
+          private->lazy_size = gimp_object_get_memsize (GIMP_OBJECT (data),
+                                                        NULL);
+
+          g_queue_push_tail (&lazy_queue, data);
+          private->lazy_link = lazy_queue.tail;
+
+          lazy_total += private->lazy_size;
+        }
+    }
+  else if (private->lazy_link)
+    {
+      g_queue_unlink (&lazy_queue, private->lazy_link);
+      g_queue_push_tail_link (&lazy_queue, private->lazy_link);
+    }
+
+  if (lazy_total > LAZY_CACHE_SIZE && ! lazy_idle_id)
+    {
+      lazy_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                      gimp_data_lazy_evict_idle,
+                                      NULL, NULL);
+    }
+}
+
+/*  called with lazy_mutex held  */
+static void
+gimp_data_lazy_load (GimpData *data)
+{
+  GimpDataPrivate *private = GIMP_DATA_GET_PRIVATE (data);
+  GInputStream    *input   = NULL;
+  GError          *error   = NULL;
+  gboolean         success = FALSE;
+
+  if (private->file)
+    {
+      GFileInfo *info;
+
+      info = g_file_query_info (private->file,
+                                G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                G_FILE_QUERY_INFO_NONE,
+                                NULL, &error);
+
+      if (info)
+        {
+          /*  don't read pixels that don't belong to the header we read  */
+          if (g_file_info_get_attribute_uint64 (info,
+                                                G_FILE_ATTRIBUTE_TIME_MODIFIED) ==
+              private->mtime)
+            {
+              input = G_INPUT_STREAM (g_file_read (private->file,
+                                                   NULL, &error));
+            }
+          else
+            {
+              g_set_error_literal (&error,
+                                   GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                                   _("The file was changed on disk."));
+            }
+
+          g_object_unref (info);
+        }
+    }
+  else
+    {
+      g_set_error_literal (&error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_OPEN,
+                           _("The data has no file."));
+    }
+
+  if (input)
+    {
+      GInputStream *buffered = g_buffered_input_stream_new (input);
+
+      success = GIMP_DATA_GET_CLASS (data)->load_lazy (data, buffered,
+                                                       &error);
+
+      g_object_unref (buffered);
+      g_object_unref (input);
+    }
+  else
+    {
+      GIMP_DATA_GET_CLASS (data)->load_lazy (data, NULL, NULL);
+    }
+
+  if (! success)
+    {
+      GimpDataLazyReport *report = g_slice_new (GimpDataLazyReport);
+
+      /*  we may be on any thread, so report the error from the main
+       *  loop, the same way the data factory reports loading errors
+       */
+      report->gimp    = private->lazy_gimp;
+      report->message = g_strdup_printf (_("Could not read the pixels of "
+                                           "'%s': %s"),
+                                         gimp_object_get_name (data),
+                                         error ? error->message :
+                                                 _("Unknown error"));
+
+      g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                       gimp_data_lazy_report_idle,
+                       report, NULL);
+
+      g_clear_error (&error);
+
+      /*  keep the empty pixels, instead of failing again next time  */
+      private->lazy = FALSE;
+    }
+}
+
+/*  called with lazy_mutex held  */
+static void
+gimp_data_lazy_forget (GimpData *data)
+{
+  GimpDataPrivate *private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (private->lazy_link)
+    {
+      g_queue_delete_link (&lazy_queue, private->lazy_link);
+      private->lazy_link = NULL;
+
+      lazy_total -= private->lazy_size;
+      private->lazy_size = 0;
+    }
+}
+
+/*  turns lazily loaded data into regular data, which keeps its pixels  */
+static void
+gimp_data_unset_lazy (GimpData *data)
+{
+  GimpDataPrivate *private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (private->lazy)
+    {
+      gimp_data_ensure_loaded (data);
+
+      g_mutex_lock (&lazy_mutex);
+
+      gimp_data_lazy_forget (data);
+      private->lazy = FALSE;
+
+      g_mutex_unlock (&lazy_mutex);
+    }
+}
+
+static gboolean
+gimp_data_lazy_evict_idle (gpointer user_data)
+{
+  GList *list;
+
+  g_mutex_lock (&lazy_mutex);
+
+  list = lazy_queue.head;
+
+  while (list && lazy_total > LAZY_CACHE_SIZE)
+    {
+      GimpData        *data    = list->data;
+      GimpDataPrivate *private = GIMP_DATA_GET_PRIVATE (data);
+
+      list = g_list_next (list);
+
+      /*  data in use refuses to be unloaded, and stays where it is  */
+      if (GIMP_DATA_GET_CLASS (data)->unload_lazy (data))
+        {
+          gimp_data_lazy_forget (data);
+
+          private->loaded = FALSE;
+        }
+    }
+
+  lazy_idle_id = 0;
+
+  g_mutex_unlock (&lazy_mutex);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+gimp_data_lazy_report_idle (gpointer user_data)
+{
+  GimpDataLazyReport *report = user_data;
+
+  gimp_message (report->gimp, NULL, GIMP_MESSAGE_ERROR,
+                _("Failed to load data:\n\n%s"), report->message);
+
+  g_free (report->message);
+  g_slice_free (GimpDataLazyReport, report);
+
+  return G_SOURCE_REMOVE;
+}
@@ -69,6 +69,10 @@ struct _GimpDataClass
   GimpData    * (* duplicate)     (GimpData       *data);
   gint          (* compare)       (GimpData       *data1,
                                    GimpData       *data2);
+  gboolean      (* load_lazy)     (GimpData       *data,
+                                   GInputStream   *input,
+                                   GError        **error);
+  gboolean      (* unload_lazy)   (GimpData       *data);
 };
 
 
@@ -125,6 +129,13 @@ gboolean      gimp_data_is_internal      (GimpData     *data);
 gint          gimp_data_compare          (GimpData     *data1,
                                           GimpData     *data2);
 
+void          gimp_data_set_lazy         (GimpData     *data,
+                                          Gimp         *gimp);
+void          gimp_data_ensure_loaded    (GimpData     *data);
+void          gimp_data_lock_loaded      (GimpData     *data);
+void          gimp_data_unlock_loaded    (GimpData     *data);
+gboolean      gimp_data_is_loaded        (GimpData     *data);
+
 #define GIMP_DATA_ERROR (gimp_data_error_quark ())
 
 GQuark        gimp_data_error_quark      (void) G_GNUC_CONST;
@@ -89,9 +89,11 @@ gimp_drawable_edit_can_fill_direct (GimpDrawable    *drawable,
             const Babl  *format;
 
             pattern = gimp_context_get_pattern (context);
-            mask    = gimp_pattern_get_mask (pattern);
+            mask    = gimp_pattern_ref_mask (pattern);
             format  = gimp_temp_buf_get_format (mask);
 
+            gimp_temp_buf_unref (mask);
+
             return ! babl_format_has_alpha (format);
           }
         }
@@ -207,6 +207,9 @@ gimp_drawable_merge_filter (GimpDrawable *drawable,
 
   if (! buffer)
     {
+      /*  we modify the drawable before pushing its undo  */
+      gimp_image_undo_compact (image);
+
       gegl_rectangle_align_to_buffer (
         &undo_rect,
         &rect,
@@ -24,10 +24,16 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-loops.h"
+
 #include "gimp-memsize.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
 #include "gimpimage.h"
 #include "gimpdrawable.h"
 #include "gimpdrawableundo.h"
+#include "gimptiledelta.h"
+#include "gimpwaitable.h"
 
 
 enum
@@ -39,24 +45,39 @@ enum
 };
 
 
-static void     gimp_drawable_undo_constructed  (GObject             *object);
-static void     gimp_drawable_undo_set_property (GObject             *object,
-                                                 guint                property_id,
-                                                 const GValue        *value,
-                                                 GParamSpec          *pspec);
-static void     gimp_drawable_undo_get_property (GObject             *object,
-                                                 guint                property_id,
-                                                 GValue              *value,
-                                                 GParamSpec          *pspec);
+typedef struct
+{
+  GeglBuffer *buffer;
+  GeglBuffer *reference;
+} CompactData;
+
+
+static void     gimp_drawable_undo_constructed   (GObject             *object);
+static void     gimp_drawable_undo_set_property  (GObject             *object,
+                                                  guint                property_id,
+                                                  const GValue        *value,
+                                                  GParamSpec          *pspec);
+static void     gimp_drawable_undo_get_property  (GObject             *object,
+                                                  guint                property_id,
+                                                  GValue              *value,
+                                                  GParamSpec          *pspec);
 
-static gint64   gimp_drawable_undo_get_memsize  (GimpObject          *object,
-                                                 gint64              *gui_size);
+static gint64   gimp_drawable_undo_get_memsize   (GimpObject          *object,
+                                                  gint64              *gui_size);
 
-static void     gimp_drawable_undo_pop          (GimpUndo            *undo,
-                                                 GimpUndoMode         undo_mode,
-                                                 GimpUndoAccumulator *accum);
-static void     gimp_drawable_undo_free         (GimpUndo            *undo,
-                                                 GimpUndoMode         undo_mode);
+static void     gimp_drawable_undo_pop           (GimpUndo            *undo,
+                                                  GimpUndoMode         undo_mode,
+                                                  GimpUndoAccumulator *accum);
+static void     gimp_drawable_undo_free          (GimpUndo            *undo,
+                                                  GimpUndoMode         undo_mode);
+
+static void     gimp_drawable_undo_compact_async (GimpAsync           *async,
+                                                  CompactData         *data);
+static void     gimp_drawable_undo_compacted     (GimpAsync           *async,
+                                                  GimpDrawableUndo    *drawable_undo);
+static void     gimp_drawable_undo_expand        (GimpDrawableUndo    *drawable_undo);
+
+static void     compact_data_free                (CompactData         *data);
 
 
 G_DEFINE_TYPE (GimpDrawableUndo, gimp_drawable_undo, GIMP_TYPE_ITEM_UNDO)
@@ -113,6 +134,8 @@ gimp_drawable_undo_constructed (GObject *object)
 
   gimp_assert (GIMP_IS_DRAWABLE (GIMP_ITEM_UNDO (object)->item));
   gimp_assert (GEGL_IS_BUFFER (drawable_undo->buffer));
+
+  drawable_undo->extent = *gegl_buffer_get_extent (drawable_undo->buffer);
 }
 
 static void
@@ -175,6 +198,7 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   gint64            memsize       = 0;
 
   memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
+  memsize += gimp_tile_delta_get_memsize (drawable_undo->delta);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -189,10 +213,20 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
+  gimp_drawable_undo_wait (drawable_undo);
+
+  if (drawable_undo->delta)
+    gimp_drawable_undo_expand (drawable_undo);
+
   gimp_drawable_swap_pixels (GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item),
                              drawable_undo->buffer,
                              drawable_undo->x,
                              drawable_undo->y);
+
+  /*  the drawable is now in the state it will be in when we're popped
+   *  again, so we can compact the swapped pixels right away
+   */
+  gimp_drawable_undo_compact (drawable_undo);
 }
 
 static void
@@ -201,7 +235,162 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
 
+  if (drawable_undo->compact_async)
+    {
+      GimpAsync *async = g_object_ref (drawable_undo->compact_async);
+
+      gimp_async_cancel_and_wait (async);
+
+      g_object_unref (async);
+    }
+
   g_clear_object (&drawable_undo->buffer);
+  g_clear_pointer (&drawable_undo->delta, gimp_tile_delta_free);
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+static void
+gimp_drawable_undo_compact_async (GimpAsync   *async,
+                                  CompactData *data)
+{
+  GimpTileDelta *delta;
+
+  delta = gimp_tile_delta_new (data->buffer, data->reference, async);
+
+  compact_data_free (data);
+
+  if (delta)
+    gimp_async_finish (async, delta);
+  else
+    gimp_async_abort (async);
+}
+
+static void
+gimp_drawable_undo_compacted (GimpAsync        *async,
+                              GimpDrawableUndo *drawable_undo)
+{
+  if (gimp_async_is_finished (async))
+    {
+      drawable_undo->delta = gimp_async_get_result (async);
+
+      g_clear_object (&drawable_undo->buffer);
+    }
+
+  g_clear_object (&drawable_undo->compact_async);
+}
+
+/*  turns the delta back into a full buffer, by applying it on top of the
+ *  drawable's current pixels
+ */
+static void
+gimp_drawable_undo_expand (GimpDrawableUndo *drawable_undo)
+{
+  GimpDrawable        *drawable = GIMP_DRAWABLE (GIMP_ITEM_UNDO (drawable_undo)->item);
+  const GeglRectangle *extent   = &drawable_undo->extent;
+
+  drawable_undo->buffer =
+    gegl_buffer_new (extent, gimp_tile_delta_get_format (drawable_undo->delta));
+
+  gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (drawable_undo->x,
+                                         drawable_undo->y,
+                                         extent->width,
+                                         extent->height),
+                         GEGL_ABYSS_NONE,
+                         drawable_undo->buffer,
+                         extent);
+
+  gimp_tile_delta_apply (drawable_undo->delta, drawable_undo->buffer);
+
+  g_clear_pointer (&drawable_undo->delta, gimp_tile_delta_free);
+}
+
+static void
+compact_data_free (CompactData *data)
+{
+  g_object_unref (data->buffer);
+  g_object_unref (data->reference);
+
+  g_slice_free (CompactData, data);
+}
+
+
+/*  public functions  */
+
+/*  starts replacing the undo's buffer by the compressed tiles that differ
+ *  from the drawable's current pixels, in the background.  the drawable
+ *  must be in the state it will be in when the undo is popped, i.e., the
+ *  operation the undo belongs to must be complete, and no other operation
+ *  may have started modifying the drawable yet.  the tiles that didn't
+ *  change are taken from the drawable again when the undo is popped.
+ */
+void
+gimp_drawable_undo_compact (GimpDrawableUndo *undo)
+{
+  GimpDrawable *drawable;
+  CompactData  *data;
+  GimpAsync    *async;
+  const Babl   *format;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE_UNDO (undo));
+
+  if (! undo->buffer || undo->compact_async)
+    return;
+
+  drawable = GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item);
+  format   = gegl_buffer_get_format (undo->buffer);
+
+  /*  we can only compare against pixels of the same format  */
+  if (format != gimp_drawable_get_format (drawable))
+    return;
+
+  data = g_slice_new (CompactData);
+
+  data->buffer    = g_object_ref (undo->buffer);
+  data->reference = gegl_buffer_new (&undo->extent, format);
+
+  /*  for tile-aligned undos, which is the common case, this is a cheap
+   *  copy-on-write copy, sharing its tiles with the drawable
+   */
+  gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (undo->x,
+                                         undo->y,
+                                         undo->extent.width,
+                                         undo->extent.height),
+                         GEGL_ABYSS_NONE,
+                         data->reference,
+                         &undo->extent);
+
+  async = gimp_parallel_run_async_full (
+    +1,
+    (GimpRunAsyncFunc) gimp_drawable_undo_compact_async,
+    data,
+    (GDestroyNotify) compact_data_free);
+
+  undo->compact_async = g_object_ref (async);
+
+  gimp_async_add_callback_for_object (
+    async,
+    (GimpAsyncCallback) gimp_drawable_undo_compacted,
+    undo,
+    undo);
+
+  g_object_unref (async);
+}
+
+/*  waits for a pending compaction of the undo to finish  */
+void
+gimp_drawable_undo_wait (GimpDrawableUndo *undo)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE_UNDO (undo));
+
+  if (undo->compact_async)
+    {
+      GimpAsync *async = g_object_ref (undo->compact_async);
+
+      gimp_waitable_wait (GIMP_WAITABLE (async));
+
+      g_object_unref (async);
+    }
+}
@@ -35,11 +35,18 @@ typedef struct _GimpDrawableUndoClass GimpDrawableUndoClass;
 
 struct _GimpDrawableUndo
 {
-  GimpItemUndo  parent_instance;
+  GimpItemUndo   parent_instance;
 
-  GeglBuffer   *buffer;
-  gint          x;
-  gint          y;
+  GeglBuffer    *buffer;
+  gint           x;
+  gint           y;
+
+  /*  once compacted, 'buffer' is replaced by the tiles that differ from
+   *  the drawable
+   */
+  GimpTileDelta *delta;
+  GeglRectangle  extent;
+  GimpAsync     *compact_async;
 };
 
 struct _GimpDrawableUndoClass
@@ -50,5 +57,8 @@ struct _GimpDrawableUndoClass
 
 GType   gimp_drawable_undo_get_type (void) G_GNUC_CONST;
 
+void    gimp_drawable_undo_compact  (GimpDrawableUndo *undo);
+void    gimp_drawable_undo_wait     (GimpDrawableUndo *undo);
+
 
 #endif /* __GIMP_DRAWABLE_UNDO_H__ */
@@ -46,6 +46,8 @@ static void   gimp_filter_stack_add_node         (GimpFilterStack *stack,
                                                   GimpFilter      *filter);
 static void   gimp_filter_stack_remove_node      (GimpFilterStack *stack,
                                                   GimpFilter      *filter);
+static void   gimp_filter_stack_detach_node      (GimpFilterStack *stack,
+                                                  GimpFilter      *filter);
 static void   gimp_filter_stack_update_last_node (GimpFilterStack *stack);
 
 static void   gimp_filter_stack_filter_active    (GimpFilter      *filter,
@@ -69,6 +71,8 @@ gimp_filter_stack_class_init (GimpFilterStackClass *klass)
   container_class->add      = gimp_filter_stack_add;
   container_class->remove   = gimp_filter_stack_remove;
   container_class->reorder  = gimp_filter_stack_reorder;
+
+  klass->update_graph       = NULL;
 }
 
 static void
@@ -115,7 +119,11 @@ gimp_filter_stack_add (GimpContainer *container,
       if (stack->graph)
         {
           gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
-          gimp_filter_stack_add_node (stack, filter);
+
+          if (GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+            GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph (stack);
+          else
+            gimp_filter_stack_add_node (stack, filter);
         }
 
       gimp_filter_stack_update_last_node (stack);
@@ -131,7 +139,7 @@ gimp_filter_stack_remove (GimpContainer *container,
 
   if (stack->graph && gimp_filter_get_active (filter))
     {
-      gimp_filter_stack_remove_node (stack, filter);
+      gimp_filter_stack_detach_node (stack, filter);
       gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
     }
 
@@ -139,6 +147,9 @@ gimp_filter_stack_remove (GimpContainer *container,
 
   if (gimp_filter_get_active (filter))
     {
+      if (stack->graph && GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+        GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph (stack);
+
       gimp_filter_set_is_last_node (filter, FALSE);
       gimp_filter_stack_update_last_node (stack);
     }
@@ -153,7 +164,7 @@ gimp_filter_stack_reorder (GimpContainer *container,
   GimpFilter      *filter = GIMP_FILTER (object);
 
   if (stack->graph && gimp_filter_get_active (filter))
-    gimp_filter_stack_remove_node (stack, filter);
+    gimp_filter_stack_detach_node (stack, filter);
 
   GIMP_CONTAINER_CLASS (parent_class)->reorder (container, object, new_index);
 
@@ -162,7 +173,12 @@ gimp_filter_stack_reorder (GimpContainer *container,
       gimp_filter_stack_update_last_node (stack);
 
       if (stack->graph)
-        gimp_filter_stack_add_node (stack, filter);
+        {
+          if (GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+            GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph (stack);
+          else
+            gimp_filter_stack_add_node (stack, filter);
+        }
     }
 }
 
@@ -222,6 +238,9 @@ gimp_filter_stack_get_graph (GimpFilterStack *stack)
   gegl_node_connect_to (previous, "output",
                         output,   "input");
 
+  if (GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+    GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph (stack);
+
   return stack->graph;
 }
 
@@ -301,6 +320,19 @@ gimp_filter_stack_remove_node (GimpFilterStack *stack,
                         node_above, "input");
 }
 
+static void
+gimp_filter_stack_detach_node (GimpFilterStack *stack,
+                               GimpFilter      *filter)
+{
+  /*  when the graph is rewired as a whole, only disconnect the node; the
+   *  rest of the graph is reconnected by update_graph()
+   */
+  if (GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+    gegl_node_disconnect (gimp_filter_get_node (filter), "input");
+  else
+    gimp_filter_stack_remove_node (stack, filter);
+}
+
 static void
 gimp_filter_stack_update_last_node (GimpFilterStack *stack)
 {
@@ -334,13 +366,18 @@ gimp_filter_stack_filter_active (GimpFilter      *filter,
       if (gimp_filter_get_active (filter))
         {
           gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
-          gimp_filter_stack_add_node (stack, filter);
+
+          if (! GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+            gimp_filter_stack_add_node (stack, filter);
         }
       else
         {
-          gimp_filter_stack_remove_node (stack, filter);
+          gimp_filter_stack_detach_node (stack, filter);
           gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
         }
+
+      if (GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph)
+        GIMP_FILTER_STACK_GET_CLASS (stack)->update_graph (stack);
     }
 
   gimp_filter_stack_update_last_node (stack);
@@ -29,6 +29,7 @@
 #define GIMP_FILTER_STACK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GIMP_TYPE_FILTER_STACK, GimpFilterStackClass))
 #define GIMP_IS_FILTER_STACK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_FILTER_STACK))
 #define GIMP_IS_FILTER_STACK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GIMP_TYPE_FILTER_STACK))
+#define GIMP_FILTER_STACK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GIMP_TYPE_FILTER_STACK, GimpFilterStackClass))
 
 
 typedef struct _GimpFilterStackClass GimpFilterStackClass;
@@ -43,6 +44,11 @@ struct _GimpFilterStack
 struct _GimpFilterStackClass
 {
   GimpListClass  parent_class;
+
+  /*  if implemented, called to rewire the entire graph whenever the set
+   *  or order of active filters changes, instead of updating it in place
+   */
+  void (* update_graph) (GimpFilterStack *stack);
 };
 
 
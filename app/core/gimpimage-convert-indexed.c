@@ -192,6 +192,27 @@
 #define G_SCALE 24              /*  scale G (a*) distances by this much  */
 #define B_SCALE 26              /*  and B (b*) by this much              */
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+/*  the colors of an area are counted in a table of this many entries
+ *  before they are added to the histogram, see generate_histogram_rgb().
+ */
+#define COLOR_TABLE_BITS 12
+#define COLOR_TABLE_SIZE (1 << COLOR_TABLE_BITS)
+#define COLOR_TABLE_MAX  (COLOR_TABLE_SIZE / 4 * 3)
+
+/*  the number of colors each thread remembers the colormap index of,
+ *  see pass2_lookup_rgb().
+ */
+#define PALETTE_CACHE_BITS 12
+#define PALETTE_CACHE_SIZE (1 << PALETTE_CACHE_BITS)
+
+/*  a color packed into a non-zero 32-bit key, and its hash  */
+#define COLOR_KEY(r,g,b)       (((guint32) (r) << 16) | ((g) << 8) | (b) | \
+                                (1 << 24))
+#define COLOR_HASH(key,bits)   (((guint32) (key) * 2654435761u) >> (32 - (bits)))
+
 
 typedef struct _Color Color;
 typedef struct _QuantizeObj QuantizeObj;
@@ -515,6 +536,52 @@ typedef struct
 
 } box, *boxptr;
 
+/*  the state shared by the threads building the histogram of a layer  */
+typedef struct
+{
+  GeglBuffer  *buffer;
+  const Babl  *format;
+  CFHistogram  histogram;
+  gint         col_limit;
+  gboolean     dither_alpha;
+  gint         offsetx;
+  gint         offsety;
+  GMutex       mutex;
+} HistogramData;
+
+/*  the pixel counts of the colors of an area, hashed by COLOR_KEY()  */
+typedef struct
+{
+  guint32      keys[COLOR_TABLE_SIZE];
+  gulong       counts[COLOR_TABLE_SIZE];
+  ColorFreq   *cells[COLOR_TABLE_SIZE];
+  gint         n_colors;
+} ColorTable;
+
+/*  the state shared by the threads mapping a layer to the colormap  */
+typedef struct
+{
+  QuantizeObj *quantobj;
+  GeglBuffer  *src_buffer;
+  GeglBuffer  *new_buffer;
+  gboolean     is_gray;
+  gint         offsetx;
+  gint         offsety;
+  GMutex       mutex;
+} Pass2Data;
+
+typedef void (* Pass2AreaFunc) (const GeglRectangle *area,
+                                Pass2Data           *data);
+
+/*  a direct-mapped cache of the colormap indices of recently mapped
+ *  colors, private to each thread
+ */
+typedef struct
+{
+  guint32      keys[PALETTE_CACHE_SIZE];
+  guchar       indices[PALETTE_CACHE_SIZE];
+} PaletteCache;
+
 
 static void          zero_histogram_gray     (CFHistogram   histogram);
 static void          zero_histogram_rgb      (CFHistogram   histogram);
@@ -524,8 +591,7 @@ static void          generate_histogram_gray (CFHistogram   hostogram,
 static void          generate_histogram_rgb  (CFHistogram   histogram,
                                               GimpLayer    *layer,
                                               gint          col_limit,
-                                              gboolean      dither_alpha,
-                                              GimpProgress *progress);
+                                              gboolean      dither_alpha);
 
 static QuantizeObj * initialize_median_cut   (GimpImageBaseType      old_type,
                                               gint                   max_colors,
@@ -742,10 +808,25 @@ color_quicksort (const void *c1,
   gdouble v1 = GIMP_RGB_LUMINANCE (color1->red, color1->green, color1->blue);
   gdouble v2 = GIMP_RGB_LUMINANCE (color2->red, color2->green, color2->blue);
 
+  guint32 k1;
+  guint32 k2;
+
   if (v1 < v2)
     return -1;
   else if (v1 > v2)
     return 1;
+
+  /* break ties on the color itself, so that the order of the palette
+   * doesn't depend on the order in which the colors were found, which
+   * isn't deterministic when the histogram is filled in parallel
+   */
+  k1 = COLOR_KEY (color1->red, color1->green, color1->blue);
+  k2 = COLOR_KEY (color2->red, color2->green, color2->blue);
+
+  if (k1 < k2)
+    return -1;
+  else if (k1 > k2)
+    return 1;
   else
     return 0;
 }
@@ -881,8 +962,7 @@ gimp_image_convert_indexed (GimpImage               *image,
                * specified by the user.
                */
               generate_histogram_rgb (quantobj->histogram,
-                                      layer, max_colors, dither_alpha,
-                                      sub_progress);
+                                      layer, max_colors, dither_alpha);
             }
         }
     }
@@ -1120,272 +1200,308 @@ zero_histogram_rgb (CFHistogram histogram)
 
 
 static void
-generate_histogram_gray (CFHistogram  histogram,
-                         GimpLayer   *layer,
-                         gboolean     dither_alpha)
+generate_histogram_gray_area (const GeglRectangle *area,
+                              HistogramData       *data)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
+  ColorFreq           counts[256] = { 0, };
   gint                bpp;
   gboolean            has_alpha;
+  gint                i;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-
-  g_return_if_fail (format == babl_format ("Y' u8") ||
-                    format == babl_format ("Y'A u8"));
-
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
+  bpp       = babl_format_get_bytes_per_pixel (data->format);
+  has_alpha = babl_format_has_alpha (data->format);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer, area, 0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
 
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
 
       if (has_alpha)
         {
           while (length--)
             {
-              if (data[ALPHA_G] > 127)
-                histogram[*data]++;
+              if (src[ALPHA_G] > 127)
+                counts[*src]++;
 
-              data += bpp;
+              src += bpp;
             }
         }
       else
         {
           while (length--)
             {
-              histogram[*data]++;
+              counts[*src]++;
 
-              data += bpp;
+              src += bpp;
             }
         }
     }
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < 256; i++)
+    data->histogram[i] += counts[i];
+
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+generate_histogram_gray (CFHistogram  histogram,
+                         GimpLayer   *layer,
+                         gboolean     dither_alpha)
+{
+  HistogramData data = { 0, };
+  const Babl   *format;
+
+  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  g_return_if_fail (format == babl_format ("Y' u8") ||
+                    format == babl_format ("Y'A u8"));
+
+  data.buffer    = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.format    = format;
+  data.histogram = histogram;
+
+  g_mutex_init (&data.mutex);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) generate_histogram_gray_area,
+    &data);
+
+  g_mutex_clear (&data.mutex);
 }
 
+/*  remembers a color of the image, unless we already know it needs to be
+ *  quantized.  must be called with the histogram mutex locked.
+ */
 static void
-check_white_or_black (const guchar *data)
+add_found_color (gint   col_limit,
+                 guchar r,
+                 guchar g,
+                 guchar b)
 {
-  if (data[RED]   == 255 &&
-      data[GREEN] == 255 &&
-      data[BLUE]  == 255)
-    had_white = TRUE;
-  if (data[RED]  ==0 &&
-      data[GREEN]==0 &&
-      data[BLUE] ==0)
-    had_black = TRUE;
+  gint nfc_iter;
+
+  for (nfc_iter = 0; nfc_iter < num_found_cols; nfc_iter++)
+    {
+      if ((r == found_cols[nfc_iter][0]) &&
+          (g == found_cols[nfc_iter][1]) &&
+          (b == found_cols[nfc_iter][2]))
+        return;
+    }
+
+  /* Color was not in the table of existing colors */
+
+  num_found_cols++;
+
+  if (num_found_cols > col_limit)
+    {
+      /* There are more colors in the image than were allowed.  We
+       *  switch to plain histogram calculation with a view to
+       *  quantizing at a later stage.
+       */
+      needs_quantize = TRUE;
+    }
+  else
+    {
+      /* Remember the new color we just found. */
+      found_cols[num_found_cols-1][0] = r;
+      found_cols[num_found_cols-1][1] = g;
+      found_cols[num_found_cols-1][2] = b;
+    }
 }
 
+/*  adds the colors counted in 'table' to the histogram, and empties it.
+ *  the colors are converted to histogram space before taking the lock,
+ *  since that's the expensive part, and it's done only once per color.
+ */
 static void
-generate_histogram_rgb (CFHistogram   histogram,
-                        GimpLayer    *layer,
-                        gint          col_limit,
-                        gboolean      dither_alpha,
-                        GimpProgress *progress)
+flush_color_table (ColorTable    *table,
+                   HistogramData *data)
+{
+  gboolean white = FALSE;
+  gboolean black = FALSE;
+  gint     i;
+
+  for (i = 0; i < COLOR_TABLE_SIZE; i++)
+    {
+      guint32 key = table->keys[i];
+      guchar  r, g, b;
+
+      if (! key)
+        continue;
+
+      r = (key >> 16) & 0xff;
+      g = (key >>  8) & 0xff;
+      b = (key      ) & 0xff;
+
+      table->cells[i] = HIST_RGB (data->histogram, r, g, b);
+
+      if (r == 255 && g == 255 && b == 255)
+        white = TRUE;
+      if (r == 0 && g == 0 && b == 0)
+        black = TRUE;
+    }
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < COLOR_TABLE_SIZE; i++)
+    {
+      if (table->keys[i])
+        *table->cells[i] += table->counts[i];
+    }
+
+  for (i = 0; i < COLOR_TABLE_SIZE && ! needs_quantize; i++)
+    {
+      guint32 key = table->keys[i];
+
+      if (key)
+        {
+          add_found_color (data->col_limit,
+                           (key >> 16) & 0xff,
+                           (key >>  8) & 0xff,
+                           (key      ) & 0xff);
+        }
+    }
+
+  had_white |= white;
+  had_black |= black;
+
+  g_mutex_unlock (&data->mutex);
+
+  memset (table->keys, 0, sizeof (table->keys));
+  table->n_colors = 0;
+}
+
+static void
+generate_histogram_rgb_area (const GeglRectangle *area,
+                             HistogramData       *data)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
   GeglRectangle      *roi;
-  ColorFreq          *colfreq;
-  gint                nfc_iter;
+  ColorTable         *table;
   gint                row, col, coledge;
-  gint                offsetx, offsety;
-  glong               layer_size;
-  glong               total_size = 0;
-  gint                count      = 0;
   gint                bpp;
   gboolean            has_alpha;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  bpp       = babl_format_get_bytes_per_pixel (data->format);
+  has_alpha = babl_format_has_alpha (data->format);
 
-  g_return_if_fail (format == babl_format ("R'G'B' u8") ||
-                    format == babl_format ("R'G'B'A u8"));
-
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
+  table = g_new0 (ColorTable, 1);
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
-
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer, area, 0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
   roi = &iter->items[0].roi;
 
-  if (progress)
-    gimp_progress_set_value (progress, 0.0);
-
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
 
-      total_size += length;
-
-      /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, src_roi->y, offsetx, offsety); */
+      /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+      col = roi->x + data->offsetx;
+      coledge = col + roi->width;
+      row = roi->y + data->offsety;
 
-      if (needs_quantize)
+      while (length--)
         {
-          if (dither_alpha)
-            {
-              /* if alpha-dithering,
-                 we need to be deterministic w.r.t. offsets */
+          gboolean transparent = FALSE;
 
-              col = roi->x + offsetx;
-              coledge = col + roi->width;
-              row = roi->y + offsety;
-
-              while (length--)
+          if (has_alpha)
+            {
+              if (data->dither_alpha)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (has_alpha &&
-                      data[ALPHA] <
+                  if (src[ALPHA] <
                       DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
                     transparent = TRUE;
-
-                  if (! transparent)
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      check_white_or_black (data);
-                      (*colfreq)++;
-                    }
-
-                  col++;
-                  if (col == coledge)
-                    {
-                      col = roi->x + offsetx;
-                      row++;
-                    }
-
-                  data += bpp;
                 }
-            }
-          else
-            {
-              while (length--)
+              else
                 {
-                  if ((has_alpha && ((data[ALPHA] > 127)))
-                      || (!has_alpha))
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      check_white_or_black (data);
-                      (*colfreq)++;
-                    }
-
-                  data += bpp;
+                  if (src[ALPHA] <= 127)
+                    transparent = TRUE;
                 }
             }
-        }
-      else
-        {
-          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
-          col = roi->x + offsetx;
-          coledge = col + roi->width;
-          row = roi->y + offsety;
 
-          while (length--)
+          if (! transparent)
             {
-              gboolean transparent = FALSE;
+              guint32 key = COLOR_KEY (src[RED], src[GREEN], src[BLUE]);
+              guint   i   = COLOR_HASH (key, COLOR_TABLE_BITS);
 
-              if (has_alpha)
+              while (table->keys[i] && table->keys[i] != key)
+                i = (i + 1) & (COLOR_TABLE_SIZE - 1);
+
+              if (! table->keys[i])
                 {
-                  if (dither_alpha)
-                    {
-                      if (data[ALPHA] <
-                          DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (data[ALPHA] <= 127)
-                        transparent = TRUE;
-                    }
+                  table->keys[i]   = key;
+                  table->counts[i] = 0;
+                  table->n_colors++;
                 }
 
-              if (! transparent)
-                {
-                  colfreq = HIST_RGB (histogram,
-                                      data[RED],
-                                      data[GREEN],
-                                      data[BLUE]);
-                  (*colfreq)++;
+              table->counts[i]++;
 
-                  if (!needs_quantize)
-                    {
-                      for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
-                           nfc_iter++)
-                        {
-                          if ((data[RED]   == found_cols[nfc_iter][0]) &&
-                              (data[GREEN] == found_cols[nfc_iter][1]) &&
-                              (data[BLUE]  == found_cols[nfc_iter][2]))
-                            goto already_found;
-                        }
+              if (table->n_colors == COLOR_TABLE_MAX)
+                flush_color_table (table, data);
+            }
 
-                      /* Color was not in the table of
-                       * existing colors
-                       */
+          col++;
+          if (col == coledge)
+            {
+              col = roi->x + data->offsetx;
+              row++;
+            }
 
-                      num_found_cols++;
+          src += bpp;
+        }
+    }
 
-                      if (num_found_cols > col_limit)
-                        {
-                          /* There are more colors in the image than
-                           *  were allowed.  We switch to plain
-                           *  histogram calculation with a view to
-                           *  quantizing at a later stage.
-                           */
-                          needs_quantize = TRUE;
-                          /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
-                          goto already_found;
-                        }
-                      else
-                        {
-                          /* Remember the new color we just found.
-                           */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
+  if (table->n_colors)
+    flush_color_table (table, data);
 
-                          check_white_or_black (data);
-                        }
-                    }
-                }
-            already_found:
+  g_free (table);
+}
 
-              col++;
-              if (col == coledge)
-                {
-                  col = roi->x + offsetx;
-                  row++;
-                }
+/*  the layer is split between threads, each of which counts its pixels
+ *  per color in a small hash table, so that a color is only converted to
+ *  histogram space, and only looked up in the colors found so far, once
+ *  per table flush rather than once per pixel.
+ */
+static void
+generate_histogram_rgb (CFHistogram   histogram,
+                        GimpLayer    *layer,
+                        gint          col_limit,
+                        gboolean      dither_alpha)
+{
+  HistogramData data = { 0, };
+  const Babl   *format;
 
-              data += bpp;
-            }
-        }
+  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
 
-      if (progress && (count % 16 == 0))
-        gimp_progress_set_value (progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
-    }
+  g_return_if_fail (format == babl_format ("R'G'B' u8") ||
+                    format == babl_format ("R'G'B'A u8"));
+
+  data.buffer       = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.format       = format;
+  data.histogram    = histogram;
+  data.col_limit    = col_limit;
+  data.dither_alpha = dither_alpha;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offsetx, &data.offsety);
+
+  g_mutex_init (&data.mutex);
 
-/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) generate_histogram_rgb_area,
+    &data);
+
+  g_mutex_clear (&data.mutex);
 }
 
 
@@ -2771,6 +2887,36 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
 }
 
 
+/* Find the colormap entry nearest to histogram cell R/G/B, like
+ * fill_inverse_cmap_rgb(), but without writing it to the histogram, so
+ * that it can be called from several threads at once.
+ */
+static gint
+find_inverse_cmap_rgb (QuantizeObj *quantobj,
+                       gint         R,
+                       gint         G,
+                       gint         B)
+{
+  gint minR, minG, minB; /* lower left corner of update box */
+  gint colorlist[MAXNUMCOLORS];
+  gint numcolors;
+  gint bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+
+  minR = ((R >> BOX_R_LOG) << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
+  minG = ((G >> BOX_G_LOG) << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
+  minB = ((B >> BOX_B_LOG) << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
+
+  numcolors = find_nearby_colors (quantobj, minR, minG, minB, colorlist);
+
+  find_best_colors (quantobj, minR, minG, minB, numcolors, colorlist,
+                    bestcolor);
+
+  return bestcolor[((R & (BOX_R_ELEMS - 1)) * BOX_G_ELEMS +
+                    (G & (BOX_G_ELEMS - 1))) * BOX_B_ELEMS +
+                   (B & (BOX_B_ELEMS - 1))];
+}
+
+
 /*  This is pass 1  */
 
 static void
@@ -2904,11 +3050,105 @@ custompal_pass1 (QuantizeObj *quantobj)
  * Map some rows of pixels to the output colormapped representation.
  */
 
+/*  the layer is split between threads, each of which maps its own area,
+ *  and counts the colormap indices it uses on its own.
+ */
 static void
-median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
-                                 GimpLayer   *layer,
-                                 GeglBuffer  *new_buffer)
+median_cut_pass2_distribute (QuantizeObj   *quantobj,
+                             GimpLayer     *layer,
+                             GeglBuffer    *new_buffer,
+                             Pass2AreaFunc  func)
+{
+  Pass2Data data = { 0, };
+
+  data.quantobj   = quantobj;
+  data.src_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.new_buffer = new_buffer;
+  data.is_gray    = gimp_drawable_is_gray (GIMP_DRAWABLE (layer));
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offsetx, &data.offsety);
+
+  g_mutex_init (&data.mutex);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.src_buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) func,
+    &data);
+
+  g_mutex_clear (&data.mutex);
+}
+
+static void
+pass2_add_used_counts (Pass2Data    *data,
+                       const gulong *index_used_count)
+{
+  gint i;
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < 256; i++)
+    data->quantobj->index_used_count[i] += index_used_count[i];
+
+  g_mutex_unlock (&data->mutex);
+}
+
+/*  returns the colormap index of the color nearest to r/g/b.  the inverse
+ *  colormap in the histogram is shared by all threads, and is only accessed
+ *  with the mutex locked; each thread also keeps the indices of the colors
+ *  it looked up recently in 'cache', so that most pixels skip the
+ *  conversion to histogram space and the mutex altogether.
+ */
+static inline gint
+pass2_lookup_rgb (Pass2Data    *data,
+                  PaletteCache *cache,
+                  guchar        r,
+                  guchar        g,
+                  guchar        b)
 {
+  QuantizeObj *quantobj = data->quantobj;
+  guint32      key      = COLOR_KEY (r, g, b);
+  guint        i        = COLOR_HASH (key, PALETTE_CACHE_BITS);
+  ColorFreq   *cachep;
+  ColorFreq    index;
+  gint         R, G, B;
+
+  if (cache->keys[i] == key)
+    return cache->indices[i];
+
+  rgb_to_lin (r, g, b, &R, &G, &B);
+
+  cachep = HIST_LIN (quantobj->histogram, R, G, B);
+
+  g_mutex_lock (&data->mutex);
+  index = *cachep;
+  g_mutex_unlock (&data->mutex);
+
+  /* If we have not seen this color before, find nearest colormap entry
+   * and update the cache.  Another thread may be doing the same, but it
+   * will come up with the same entry.
+   */
+  if (index == 0)
+    {
+      index = find_inverse_cmap_rgb (quantobj, R, G, B) + 1;
+
+      g_mutex_lock (&data->mutex);
+      *cachep = index;
+      g_mutex_unlock (&data->mutex);
+    }
+
+  cache->keys[i]    = key;
+  cache->indices[i] = index - 1;
+
+  return index - 1;
+}
+
+
+static void
+median_cut_pass2_no_dither_gray_area (const GeglRectangle *area,
+                                      Pass2Data           *data)
+{
+  QuantizeObj        *quantobj = data->quantobj;
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
@@ -2918,27 +3158,26 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
   gint                src_bpp;
   gint                dest_bpp;
   gint                has_alpha;
-  gulong             *index_used_count = quantobj->index_used_count;
+  gulong              index_used_count[256] = { 0, };
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
+  gint                offsetx          = data->offsetx;
+  gint                offsety          = data->offsety;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+  src_format  = gegl_buffer_get_format (data->src_buffer);
+  dest_format = gegl_buffer_get_format (data->new_buffer);
 
   src_bpp  = babl_format_get_bytes_per_pixel (src_format);
   dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
 
   has_alpha = babl_format_has_alpha (src_format);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->new_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -2956,12 +3195,8 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
               /* get pixel value and index into the cache */
               gint pixel = src[GRAY];
 
+              /* the cache was filled by median_cut_pass2_gray_init() */
               cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
 
               if (has_alpha)
                 {
@@ -3002,13 +3237,25 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
             }
         }
     }
+
+  pass2_add_used_counts (data, index_used_count);
 }
 
+
 static void
-median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
-                                    GimpLayer   *layer,
-                                    GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
+                                 GimpLayer   *layer,
+                                 GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_no_dither_gray_area);
+}
+
+static void
+median_cut_pass2_fixed_dither_gray_area (const GeglRectangle *area,
+                                         Pass2Data           *data)
 {
+  QuantizeObj        *quantobj = data->quantobj;
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
@@ -3024,27 +3271,26 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
   gint                err2;
   Color              *color1;
   Color              *color2;
-  gulong             *index_used_count = quantobj->index_used_count;
+  gulong              index_used_count[256] = { 0, };
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  gint                offsetx          = data->offsetx;
+  gint                offsety          = data->offsety;
 
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+  src_format  = gegl_buffer_get_format (data->src_buffer);
+  dest_format = gegl_buffer_get_format (data->new_buffer);
 
   src_bpp  = babl_format_get_bytes_per_pixel (src_format);
   dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
 
   has_alpha = babl_format_has_alpha (src_format);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->new_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -3067,12 +3313,8 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
               /* get pixel value and index into the cache */
               pixel = src[GRAY];
 
+              /* the cache was filled by median_cut_pass2_gray_init() */
               cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
 
               pixval1 = *cachep - 1;
               color1 = &quantobj->cmap[pixval1];
@@ -3087,11 +3329,6 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
                       const gint R = CLAMP0255 (RV);
 
                       cachep = &histogram[R];
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_gray (quantobj, histogram, R);
 
                       pixval2 = *cachep - 1;
                       RV += re;
@@ -3170,73 +3407,77 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
             }
         }
     }
+
+  pass2_add_used_counts (data, index_used_count);
 }
 
+
 static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
+                                    GimpLayer   *layer,
+                                    GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_fixed_dither_gray_area);
+}
+
+static void
+median_cut_pass2_no_dither_rgb_area (const GeglRectangle *area,
+                                     Pass2Data           *data)
 {
+  QuantizeObj        *quantobj = data->quantobj;
   GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
+  PaletteCache       *cache;
   const Babl         *src_format;
   const Babl         *dest_format;
   GeglRectangle      *src_roi;
   gint                src_bpp;
   gint                dest_bpp;
   gint                has_alpha;
-  gint                R, G, B;
+  gint                pixval;
   gint                red_pix          = RED;
   gint                green_pix        = GREEN;
   gint                blue_pix         = BLUE;
   gint                alpha_pix        = ALPHA;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
+  gint                offsetx          = data->offsetx;
+  gint                offsety          = data->offsety;
+  gulong              index_used_count[256] = { 0, };
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+  src_format  = gegl_buffer_get_format (data->src_buffer);
+  dest_format = gegl_buffer_get_format (data->new_buffer);
 
   src_bpp  = babl_format_get_bytes_per_pixel (src_format);
   dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
 
   has_alpha = babl_format_has_alpha (src_format);
 
+  cache = g_new0 (PaletteCache, 1);
+
   /*  In the case of web/mono palettes, we actually force
    *   grayscale drawables through the rgb pass2 functions
    */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
+  if (data->is_gray)
     {
       red_pix = green_pix = blue_pix = GRAY;
       alpha_pix = ALPHA_G;
     }
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->new_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3272,19 +3513,14 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
                     }
                 }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
-                          &R, &G, &B);
-
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+              /* get the colormap index of the pixel value */
+              pixval = pass2_lookup_rgb (data, cache,
+                                         src[red_pix],
+                                         src[green_pix],
+                                         src[blue_pix]);
 
               /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
+              index_used_count[dest[INDEXED] = pixval]++;
 
             next_pixel:
 
@@ -3292,21 +3528,30 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
               dest += dest_bpp;
             }
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (gdouble) total_size / (gdouble) layer_size);
     }
+
+  g_free (cache);
+
+  pass2_add_used_counts (data, index_used_count);
 }
 
+
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                GeglBuffer  *new_buffer)
 {
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_no_dither_rgb_area);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb_area (const GeglRectangle *area,
+                                        Pass2Data           *data)
+{
+  QuantizeObj        *quantobj = data->quantobj;
   GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
+  PaletteCache       *cache;
   const Babl         *src_format;
   const Babl         *dest_format;
   GeglRectangle      *src_roi;
@@ -3317,7 +3562,6 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
   gint                pixval2 = 0;
   Color              *color1;
   Color              *color2;
-  gint                R, G, B;
   gint                err1;
   gint                err2;
   gint                red_pix          = RED;
@@ -3325,51 +3569,44 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
   gint                blue_pix         = BLUE;
   gint                alpha_pix        = ALPHA;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
+  gint                offsetx          = data->offsetx;
+  gint                offsety          = data->offsety;
+  gulong              index_used_count[256] = { 0, };
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+  src_format  = gegl_buffer_get_format (data->src_buffer);
+  dest_format = gegl_buffer_get_format (data->new_buffer);
 
   src_bpp  = babl_format_get_bytes_per_pixel (src_format);
   dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
 
   has_alpha = babl_format_has_alpha (src_format);
 
+  cache = g_new0 (PaletteCache, 1);
+
   /*  In the case of web/mono palettes, we actually force
    *   grayscale drawables through the rgb pass2 functions
    */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
+  if (data->is_gray)
     {
       red_pix = green_pix = blue_pix = GRAY;
       alpha_pix = ALPHA_G;
     }
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->new_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3406,16 +3643,11 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                     }
                 }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
-                          &R, &G, &B);
-
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+              /* get the colormap index of the pixel value */
+              pixval1 = pass2_lookup_rgb (data, cache,
+                                          src[red_pix],
+                                          src[green_pix],
+                                          src[blue_pix]);
 
               /* We now try to find a color which, when mixed in some
                * fashion with the closest match, yields something
@@ -3426,7 +3658,6 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                * intended color to determine their relative
                * probabilities of being chosen.
                */
-              pixval1 = *cachep - 1;
               color1 = &quantobj->cmap[pixval1];
 
               if (quantobj->actual_number_of_colors > 2)
@@ -3440,19 +3671,10 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
 
                   do
                     {
-                      rgb_to_lin ((CLAMP0255(RV)),
-                                  (CLAMP0255(GV)),
-                                  (CLAMP0255(BV)),
-                                  &R, &G, &B);
-
-                      cachep = HIST_LIN (histogram, R, G, B);
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-                      pixval2 = *cachep - 1;
+                      pixval2 = pass2_lookup_rgb (data, cache,
+                                                  CLAMP0255 (RV),
+                                                  CLAMP0255 (GV),
+                                                  CLAMP0255 (BV));
                       RV += re;  GV += ge;  BV += be;
                     }
                   while ((pixval1 == pixval2) &&
@@ -3524,18 +3746,28 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
               dest += dest_bpp;
             }
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
     }
+
+  g_free (cache);
+
+  pass2_add_used_counts (data, index_used_count);
 }
 
+
 static void
-median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
-                                        GimpLayer   *layer,
-                                        GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   GeglBuffer  *new_buffer)
 {
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_fixed_dither_rgb_area);
+}
+
+static void
+median_cut_pass2_nodestruct_dither_rgb_area (const GeglRectangle *area,
+                                             Pass2Data           *data)
+{
+  QuantizeObj        *quantobj = data->quantobj;
   GeglBufferIterator *iter;
   const Babl         *src_format;
   const Babl         *dest_format;
@@ -3552,25 +3784,24 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
   gint                lastred      = -1;
   gint                lastgreen    = -1;
   gint                lastblue     = -1;
-  gint                offsetx, offsety;
+  gint                offsetx          = data->offsetx;
+  gint                offsety          = data->offsety;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+  src_format  = gegl_buffer_get_format (data->src_buffer);
+  dest_format = gegl_buffer_get_format (data->new_buffer);
 
   src_bpp  = babl_format_get_bytes_per_pixel (src_format);
   dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
 
   has_alpha = babl_format_has_alpha (src_format);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->new_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -3655,6 +3886,15 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
     }
 }
 
+static void
+median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
+                                        GimpLayer   *layer,
+                                        GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_nodestruct_dither_rgb_area);
+}
+
 
 /*
  * Initialize the error-limiting transfer function (lookup table).
@@ -3991,10 +4231,18 @@ median_cut_pass2_rgb_init (QuantizeObj *quantobj)
 static void
 median_cut_pass2_gray_init (QuantizeObj *quantobj)
 {
+  gint i;
+
   zero_histogram_gray (quantobj->histogram);
 
   /* Mark all indices as currently unused */
   memset (quantobj->index_used_count, 0, 256 * sizeof (gulong));
+
+  /* Fill the whole inverse colormap up front, it's only 256 entries,
+   * and the pass2 functions can then read it from several threads
+   */
+  for (i = 0; i < 256; i++)
+    fill_inverse_cmap_gray (quantobj, quantobj->histogram, i);
 }
 
 static void
@@ -26,6 +26,7 @@
 
 #include "gimp.h"
 #include "gimp-utils.h"
+#include "gimpdrawableundo.h"
 #include "gimpimage.h"
 #include "gimpimage-private.h"
 #include "gimpimage-undo.h"
@@ -43,6 +44,9 @@ static void          gimp_image_undo_pop_stack       (GimpImage     *image,
 static void          gimp_image_undo_free_space      (GimpImage     *image);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
+static void          gimp_image_undo_compact_undo    (GimpUndo      *undo);
+static void          gimp_image_undo_wait_undo       (GimpUndo      *undo);
+
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
 
 
@@ -87,7 +91,12 @@ gimp_image_undo_freeze (GimpImage *image)
   private->undo_freeze_count++;
 
   if (private->undo_freeze_count == 1)
-    gimp_image_undo_event (image, GIMP_UNDO_EVENT_UNDO_FREEZE, NULL);
+    {
+      /*  the image may be modified without pushing undos from now on  */
+      gimp_image_undo_compact (image);
+
+      gimp_image_undo_event (image, GIMP_UNDO_EVENT_UNDO_FREEZE, NULL);
+    }
 
   return TRUE;
 }
@@ -262,6 +271,30 @@ gimp_image_undo_free (GimpImage *image)
    */
 }
 
+/*  compacts the most recent undo, or the last undo of the most recent
+ *  undo group, in the background, if it is a drawable undo, keeping only
+ *  the compressed tiles that differ from the drawable's current pixels.
+ *  this happens automatically when the next undo is pushed, also inside
+ *  a group, and when the undo is frozen, but operations that modify a
+ *  drawable before pushing their undo must call this before they start
+ *  modifying it.
+ */
+void
+gimp_image_undo_compact (GimpImage *image)
+{
+  GimpImagePrivate *private;
+  GimpUndo         *undo;
+
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  undo = gimp_undo_stack_peek (private->undo_stack);
+
+  if (undo)
+    gimp_image_undo_compact_undo (undo);
+}
+
 gint
 gimp_image_get_undo_group_count (GimpImage *image)
 {
@@ -306,6 +339,8 @@ gimp_image_undo_group_start (GimpImage    *image,
   /*  nuke the redo stack  */
   gimp_image_undo_free_redo (image);
 
+  gimp_image_undo_compact (image);
+
   undo_group = gimp_undo_stack_new (image);
 
   gimp_object_set_name (GIMP_OBJECT (undo_group), name);
@@ -408,6 +443,9 @@ gimp_image_undo_push (GimpImage     *image,
   /*  nuke the redo stack  */
   gimp_image_undo_free_redo (image);
 
+  /*  the previous undo, in the current group if any, is complete now  */
+  gimp_image_undo_compact (image);
+
   if (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE)
     {
       gimp_undo_stack_push_undo (private->undo_stack, undo);
@@ -537,6 +575,15 @@ gimp_image_undo_free_space (GimpImage *image)
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
 
+  /*  the last steps may still be compacting, and will likely fit once
+   *  they're done, so don't expire anything before that
+   */
+  if (gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size)
+    {
+      gimp_container_foreach (container,
+                              (GFunc) gimp_image_undo_wait_undo, NULL);
+    }
+
   while ((gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size) ||
          (gimp_container_get_n_children (container) > max_undo_levels))
     {
@@ -605,6 +652,34 @@ gimp_image_undo_free_redo (GimpImage *image)
     }
 }
 
+static void
+gimp_image_undo_compact_undo (GimpUndo *undo)
+{
+  /*  the other undos of a group have been compacted when the undo
+   *  following them was pushed, against the drawable's pixels at that
+   *  time, and must not be compacted against its final pixels
+   */
+  if (GIMP_IS_UNDO_STACK (undo))
+    undo = gimp_undo_stack_peek (GIMP_UNDO_STACK (undo));
+
+  if (undo && GIMP_IS_DRAWABLE_UNDO (undo))
+    gimp_drawable_undo_compact (GIMP_DRAWABLE_UNDO (undo));
+}
+
+static void
+gimp_image_undo_wait_undo (GimpUndo *undo)
+{
+  if (GIMP_IS_UNDO_STACK (undo))
+    {
+      gimp_container_foreach (GIMP_UNDO_STACK (undo)->undos,
+                              (GFunc) gimp_image_undo_wait_undo, NULL);
+    }
+  else if (GIMP_IS_DRAWABLE_UNDO (undo))
+    {
+      gimp_drawable_undo_wait (GIMP_DRAWABLE_UNDO (undo));
+    }
+}
+
 static GimpDirtyMask
 gimp_image_undo_dirty_from_type (GimpUndoType undo_type)
 {
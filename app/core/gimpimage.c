@@ -2793,12 +2793,23 @@ gimp_image_get_xcf_version (GimpImage    *image,
       version = MAX (12, version);
     }
 
-  /* need version 8 for zlib compression */
+  /* need version 8 for zlib compression, and version 15 for zstd
+   * compression, which replaces it when enabled
+   */
   if (zlib_compression)
     {
-      ADD_REASON (g_strdup_printf (_("Internal zlib compression was "
-                                     "added in %s"), "GIMP 2.10"));
-      version = MAX (8, version);
+      if (gimp_image_get_xcf_zstd_compression (image))
+        {
+          ADD_REASON (g_strdup_printf (_("Internal zstd compression was "
+                                         "added in %s"), "GIMP 3.0"));
+          version = MAX (15, version);
+        }
+      else
+        {
+          ADD_REASON (g_strdup_printf (_("Internal zlib compression was "
+                                         "added in %s"), "GIMP 2.10"));
+          version = MAX (8, version);
+        }
     }
 
   /* if version is 10 (lots of new layer modes), go to version 11 with
@@ -2851,9 +2862,15 @@ gimp_image_get_xcf_version (GimpImage    *image,
     case 11:
     case 12:
     case 13:
+    case 14:
       if (gimp_version)   *gimp_version   = 210;
       if (version_string) *version_string = "GIMP 2.10";
       break;
+
+    case 15:
+      if (gimp_version)   *gimp_version   = 300;
+      if (version_string) *version_string = "GIMP 3.0";
+      break;
     }
 
   if (version_reason && reasons)
@@ -2894,6 +2911,21 @@ gimp_image_get_xcf_compression (GimpImage *image)
   return GIMP_IMAGE_GET_PRIVATE (image)->xcf_compression;
 }
 
+/*  returns whether XCF compression, when enabled for @image, uses zstd
+ *  instead of zlib.  zstd is opt-in, since it requires XCF version 15.
+ */
+gboolean
+gimp_image_get_xcf_zstd_compression (GimpImage *image)
+{
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+
+#ifdef HAVE_ZSTD
+  return image->gimp->config->xcf_zstd_compression;
+#else
+  return FALSE;
+#endif
+}
+
 void
 gimp_image_set_resolution (GimpImage *image,
                            gdouble    xresolution,
@@ -189,6 +189,8 @@ gint            gimp_image_get_xcf_version       (GimpImage          *image,
 void            gimp_image_set_xcf_compression   (GimpImage          *image,
                                                   gboolean            compression);
 gboolean        gimp_image_get_xcf_compression   (GimpImage          *image);
+gboolean        gimp_image_get_xcf_zstd_compression
+                                                 (GimpImage          *image);
 
 void            gimp_image_set_resolution        (GimpImage          *image,
                                                   gdouble             xres,
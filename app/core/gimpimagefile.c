@@ -38,6 +38,8 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimpasync.h"
+#include "gimpcancelable.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
 #include "gimpimage.h"
@@ -51,6 +53,17 @@
 #include "gimp-intl.h"
 
 
+/*  the number of threads checking and loading thumbnails.  they mostly
+ *  wait for the file system, which may be a network share, so they don't
+ *  take from the processors the parallel threads use, and they are few,
+ *  so as not to flood the share
+ */
+#define GIMP_IMAGEFILE_THUMB_THREADS    4
+
+/*  the number of queued thumbnails each thread takes at once  */
+#define GIMP_IMAGEFILE_THUMB_BATCH_SIZE 8
+
+
 enum
 {
   INFO_CHANGED,
@@ -58,6 +71,22 @@ enum
 };
 
 
+typedef struct
+{
+  GimpAsync     *async;
+  GimpThumbnail *thumbnail;  /*  the thread's own copy, for the same URI  */
+  gint           size;
+  gint           priority;
+} ThumbTask;
+
+typedef struct
+{
+  GimpThumbnail *thumbnail;
+  GdkPixbuf     *pixbuf;
+  GError        *error;
+} ThumbResult;
+
+
 typedef struct _GimpImagefilePrivate GimpImagefilePrivate;
 
 struct _GimpImagefilePrivate
@@ -69,6 +98,11 @@ struct _GimpImagefilePrivate
   GIcon         *icon;
   GCancellable  *icon_cancellable;
 
+  GimpAsync     *thumb_async;
+  GdkPixbuf     *thumb_pixbuf;
+  gint           thumb_size;
+  gboolean       thumb_loaded;
+
   gchar         *description;
   gboolean       static_desc;
 };
@@ -99,6 +133,15 @@ static void        gimp_imagefile_icon_callback    (GObject        *source_objec
 static GdkPixbuf * gimp_imagefile_load_thumb       (GimpImagefile  *imagefile,
                                                     gint            width,
                                                     gint            height);
+static GdkPixbuf * gimp_imagefile_scale_thumb      (GdkPixbuf      *pixbuf,
+                                                    gint            width,
+                                                    gint            height);
+static void        gimp_imagefile_load_thumb_async (GimpImagefile  *imagefile,
+                                                    gint            size);
+static void        gimp_imagefile_load_thumb_callback
+                                                   (GimpAsync      *async,
+                                                    GimpImagefile  *imagefile);
+static void        gimp_imagefile_cancel_thumb     (GimpImagefile  *imagefile);
 static gboolean    gimp_imagefile_save_thumb       (GimpImagefile  *imagefile,
                                                     GimpImage      *image,
                                                     gint            size,
@@ -115,6 +158,26 @@ static void     gimp_thumbnail_set_info            (GimpThumbnail  *thumbnail,
                                                     const Babl     *format,
                                                     gint            num_layers);
 
+static gint        gimp_imagefile_thumb_task_compare
+                                                   (const ThumbTask *task1,
+                                                    const ThumbTask *task2,
+                                                    gpointer        data);
+static gint        gimp_imagefile_thumb_task_find  (const ThumbTask *task,
+                                                    GimpAsync      *async);
+static void        gimp_imagefile_thumb_queue_push (ThumbTask      *task);
+static ThumbTask * gimp_imagefile_thumb_queue_take (GimpAsync      *async);
+static void        gimp_imagefile_thumb_queue_cancel
+                                                   (GimpAsync      *async);
+static void        gimp_imagefile_thumb_queue_waiting
+                                                   (GimpAsync      *async);
+static void        gimp_imagefile_thumb_thread_func
+                                                   (gpointer        data,
+                                                    gpointer        user_data);
+static void        gimp_imagefile_thumb_task_run   (ThumbTask      *task);
+static void        gimp_imagefile_thumb_task_free  (ThumbTask      *task);
+static void        gimp_imagefile_thumb_result_free
+                                                   (ThumbResult    *result);
+
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpImagefile, gimp_imagefile, GIMP_TYPE_VIEWABLE)
 
@@ -122,6 +185,13 @@ G_DEFINE_TYPE_WITH_PRIVATE (GimpImagefile, gimp_imagefile, GIMP_TYPE_VIEWABLE)
 
 static guint gimp_imagefile_signals[LAST_SIGNAL] = { 0 };
 
+/*  the thumbnails waiting to be checked and loaded, sorted by priority  */
+static GMutex       gimp_imagefile_thumb_mutex;
+static GQueue       gimp_imagefile_thumb_queue     = G_QUEUE_INIT;
+static GThreadPool *gimp_imagefile_thumb_pool      = NULL;
+static gint         gimp_imagefile_thumb_n_threads = 0;
+static gint         gimp_imagefile_thumb_serial    = 0;
+
 
 static void
 gimp_imagefile_class_init (GimpImagefileClass *klass)
@@ -181,6 +251,8 @@ gimp_imagefile_dispose (GObject *object)
       g_clear_object (&private->icon_cancellable);
     }
 
+  gimp_imagefile_cancel_thumb (GIMP_IMAGEFILE (object));
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -212,6 +284,8 @@ gimp_imagefile_name_changed (GimpObject *object)
   if (GIMP_OBJECT_CLASS (parent_class)->name_changed)
     GIMP_OBJECT_CLASS (parent_class)->name_changed (object);
 
+  gimp_imagefile_cancel_thumb (GIMP_IMAGEFILE (object));
+
   gimp_thumbnail_set_uri (private->thumbnail, gimp_object_get_name (object));
 
   g_clear_object (&private->file);
@@ -226,12 +300,32 @@ gimp_imagefile_get_new_pixbuf (GimpViewable *viewable,
                                gint          width,
                                gint          height)
 {
-  GimpImagefile *imagefile = GIMP_IMAGEFILE (viewable);
+  GimpImagefile        *imagefile = GIMP_IMAGEFILE (viewable);
+  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
 
   if (! gimp_object_get_name (imagefile))
     return NULL;
 
-  return gimp_imagefile_load_thumb (imagefile, width, height);
+  /*  without an interface there is nobody to redraw the preview later  */
+  if (! private->gimp || private->gimp->no_interface)
+    return gimp_imagefile_load_thumb (imagefile, width, height);
+
+  /*  a thumbnail loaded for a larger preview does for smaller ones too,
+   *  so that views of different sizes don't keep replacing it
+   */
+  if (private->thumb_loaded &&
+      private->thumb_size >= MAX (width, height))
+    {
+      if (! private->thumb_pixbuf)
+        return NULL;
+
+      return gimp_imagefile_scale_thumb (g_object_ref (private->thumb_pixbuf),
+                                         width, height);
+    }
+
+  gimp_imagefile_load_thumb_async (imagefile, MAX (width, height));
+
+  return NULL;
 }
 
 static gchar *
@@ -380,6 +474,7 @@ gimp_imagefile_update (GimpImagefile *imagefile)
 
   private = GET_PRIVATE (imagefile);
 
+  gimp_imagefile_cancel_thumb (imagefile);
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
 
   g_object_get (private->thumbnail,
@@ -393,7 +488,10 @@ gimp_imagefile_update (GimpImagefile *imagefile)
 
       if (documents_imagefile != imagefile &&
           GIMP_IS_IMAGEFILE (documents_imagefile))
-        gimp_viewable_invalidate_preview (GIMP_VIEWABLE (documents_imagefile));
+        {
+          gimp_imagefile_cancel_thumb (documents_imagefile);
+          gimp_viewable_invalidate_preview (GIMP_VIEWABLE (documents_imagefile));
+        }
 
       g_free (uri);
     }
@@ -871,10 +969,6 @@ gimp_imagefile_load_thumb (GimpImagefile *imagefile,
   GdkPixbuf            *pixbuf    = NULL;
   GError               *error     = NULL;
   gint                  size      = MAX (width, height);
-  gint                  pixbuf_width;
-  gint                  pixbuf_height;
-  gint                  preview_width;
-  gint                  preview_height;
 
   if (gimp_thumbnail_peek_thumb (thumbnail, size) < GIMP_THUMB_STATE_EXISTS)
     return NULL;
@@ -897,6 +991,20 @@ gimp_imagefile_load_thumb (GimpImagefile *imagefile,
       return NULL;
     }
 
+  return gimp_imagefile_scale_thumb (pixbuf, width, height);
+}
+
+/*  takes ownership of 'pixbuf'  */
+static GdkPixbuf *
+gimp_imagefile_scale_thumb (GdkPixbuf *pixbuf,
+                            gint       width,
+                            gint       height)
+{
+  gint pixbuf_width;
+  gint pixbuf_height;
+  gint preview_width;
+  gint preview_height;
+
   pixbuf_width  = gdk_pixbuf_get_width  (pixbuf);
   pixbuf_height = gdk_pixbuf_get_height (pixbuf);
 
@@ -941,6 +1049,102 @@ gimp_imagefile_load_thumb (GimpImagefile *imagefile,
   return pixbuf;
 }
 
+/*  queues checking and loading the thumbnail for previews up to 'size'.
+ *  the preview is invalidated once it's done, and the thumbnail is then
+ *  used by get_new_pixbuf() until the next gimp_imagefile_update().
+ */
+static void
+gimp_imagefile_load_thumb_async (GimpImagefile *imagefile,
+                                 gint           size)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+  ThumbTask            *task;
+
+  if (private->thumb_async && private->thumb_size >= size)
+    return;
+
+  gimp_imagefile_cancel_thumb (imagefile);
+
+  private->thumb_async = gimp_async_new ();
+  private->thumb_size  = size;
+
+  task = g_slice_new0 (ThumbTask);
+
+  task->async     = g_object_ref (private->thumb_async);
+  task->thumbnail = gimp_thumbnail_new ();
+  task->size      = size;
+
+  gimp_thumbnail_set_uri (task->thumbnail, gimp_object_get_name (imagefile));
+
+  gimp_async_add_callback_for_object (
+    private->thumb_async,
+    (GimpAsyncCallback) gimp_imagefile_load_thumb_callback,
+    imagefile,
+    imagefile);
+
+  gimp_imagefile_thumb_queue_push (task);
+}
+
+static void
+gimp_imagefile_load_thumb_callback (GimpAsync     *async,
+                                    GimpImagefile *imagefile)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+  ThumbResult          *result;
+
+  /*  canceled, or replaced by a newer request  */
+  if (async != private->thumb_async)
+    return;
+
+  g_clear_object (&private->thumb_async);
+
+  if (! gimp_async_is_finished (async))
+    return;
+
+  result = gimp_async_get_result (async);
+
+  if (result->error)
+    {
+      gimp_message (private->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    _("Could not open thumbnail '%s': %s"),
+                    result->thumbnail->thumb_filename,
+                    result->error->message);
+    }
+
+  g_clear_object (&private->thumb_pixbuf);
+
+  if (result->pixbuf)
+    private->thumb_pixbuf = g_object_ref (result->pixbuf);
+
+  private->thumb_loaded = TRUE;
+
+  gimp_thumbnail_set_from_thumbnail (private->thumbnail, result->thumbnail);
+
+  gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
+}
+
+/*  drops the loaded thumbnail, and the pending request, if any  */
+static void
+gimp_imagefile_cancel_thumb (GimpImagefile *imagefile)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+
+  if (private->thumb_async)
+    {
+      GimpAsync *async = private->thumb_async;
+
+      /*  clear it first, so the callback ignores the aborted request  */
+      private->thumb_async = NULL;
+
+      gimp_cancelable_cancel (GIMP_CANCELABLE (async));
+      g_object_unref (async);
+    }
+
+  g_clear_object (&private->thumb_pixbuf);
+
+  private->thumb_loaded = FALSE;
+}
+
 static gboolean
 gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
                            GimpImage      *image,
@@ -1074,3 +1278,246 @@ gimp_thumbnail_set_info (GimpThumbnail *thumbnail,
                   "image-num-layers", num_layers,
                   NULL);
 }
+
+/*  the thumbnail queue  */
+
+static gint
+gimp_imagefile_thumb_task_compare (const ThumbTask *task1,
+                                   const ThumbTask *task2,
+                                   gpointer         data)
+{
+  return (task1->priority > task2->priority) -
+         (task1->priority < task2->priority);
+}
+
+static gint
+gimp_imagefile_thumb_task_find (const ThumbTask *task,
+                                GimpAsync       *async)
+{
+  return task->async != async;
+}
+
+static void
+gimp_imagefile_thumb_queue_push (ThumbTask *task)
+{
+  gboolean start_thread = FALSE;
+
+  /*  previews are requested as they are drawn, so the latest requests
+   *  are for the rows that are visible now, and go first
+   */
+  task->priority = -(++gimp_imagefile_thumb_serial);
+
+  g_signal_connect_after (task->async, "cancel",
+                          G_CALLBACK (gimp_imagefile_thumb_queue_cancel),
+                          NULL);
+  g_signal_connect_after (task->async, "waiting",
+                          G_CALLBACK (gimp_imagefile_thumb_queue_waiting),
+                          NULL);
+
+  if (! gimp_imagefile_thumb_pool)
+    {
+      gimp_imagefile_thumb_pool =
+        g_thread_pool_new (gimp_imagefile_thumb_thread_func, NULL,
+                           GIMP_IMAGEFILE_THUMB_THREADS, FALSE, NULL);
+    }
+
+  g_mutex_lock (&gimp_imagefile_thumb_mutex);
+
+  g_queue_insert_sorted (&gimp_imagefile_thumb_queue, task,
+                         (GCompareDataFunc) gimp_imagefile_thumb_task_compare,
+                         NULL);
+
+  if (gimp_imagefile_thumb_n_threads < GIMP_IMAGEFILE_THUMB_THREADS)
+    {
+      gimp_imagefile_thumb_n_threads++;
+
+      start_thread = TRUE;
+    }
+
+  g_mutex_unlock (&gimp_imagefile_thumb_mutex);
+
+  /*  the threads run until the queue is empty, so they only need to be
+   *  started, not to be handed the tasks
+   */
+  if (start_thread)
+    {
+      g_thread_pool_push (gimp_imagefile_thumb_pool,
+                          &gimp_imagefile_thumb_queue, NULL);
+    }
+}
+
+/*  removes the task of 'async' from the queue, if it hasn't been taken
+ *  by a thread yet.  must be called with the queue locked.
+ */
+static ThumbTask *
+gimp_imagefile_thumb_queue_take (GimpAsync *async)
+{
+  GList *link;
+
+  link = g_queue_find_custom (&gimp_imagefile_thumb_queue, async,
+                              (GCompareFunc) gimp_imagefile_thumb_task_find);
+
+  if (link)
+    {
+      ThumbTask *task = link->data;
+
+      g_queue_delete_link (&gimp_imagefile_thumb_queue, link);
+
+      return task;
+    }
+
+  return NULL;
+}
+
+static void
+gimp_imagefile_thumb_queue_cancel (GimpAsync *async)
+{
+  ThumbTask *task;
+
+  g_mutex_lock (&gimp_imagefile_thumb_mutex);
+
+  task = gimp_imagefile_thumb_queue_take (async);
+
+  g_mutex_unlock (&gimp_imagefile_thumb_mutex);
+
+  /*  a task already taken by a thread is aborted there  */
+  if (task)
+    {
+      gimp_async_abort (task->async);
+
+      gimp_imagefile_thumb_task_free (task);
+    }
+}
+
+static void
+gimp_imagefile_thumb_queue_waiting (GimpAsync *async)
+{
+  ThumbTask *task;
+
+  g_mutex_lock (&gimp_imagefile_thumb_mutex);
+
+  task = gimp_imagefile_thumb_queue_take (async);
+
+  if (task)
+    {
+      task->priority = G_MININT;
+
+      g_queue_push_head (&gimp_imagefile_thumb_queue, task);
+    }
+
+  g_mutex_unlock (&gimp_imagefile_thumb_mutex);
+}
+
+static void
+gimp_imagefile_thumb_thread_func (gpointer data,
+                                  gpointer user_data)
+{
+  while (TRUE)
+    {
+      ThumbTask *tasks[GIMP_IMAGEFILE_THUMB_BATCH_SIZE];
+      gint       n_tasks = 0;
+      gint       i;
+
+      g_mutex_lock (&gimp_imagefile_thumb_mutex);
+
+      while (n_tasks < GIMP_IMAGEFILE_THUMB_BATCH_SIZE &&
+             ! g_queue_is_empty (&gimp_imagefile_thumb_queue))
+        {
+          tasks[n_tasks++] = g_queue_pop_head (&gimp_imagefile_thumb_queue);
+        }
+
+      if (! n_tasks)
+        gimp_imagefile_thumb_n_threads--;
+
+      g_mutex_unlock (&gimp_imagefile_thumb_mutex);
+
+      if (! n_tasks)
+        return;
+
+      /*  stat all the images of the batch first, so that the missing
+       *  ones, common in an old document history, are done with before
+       *  any thumbnail is read
+       */
+      for (i = 0; i < n_tasks; i++)
+        {
+          if (gimp_async_is_canceled (tasks[i]->async))
+            continue;
+
+          gimp_thumbnail_peek_image (tasks[i]->thumbnail);
+
+          if (tasks[i]->thumbnail->image_state == GIMP_THUMB_STATE_NOT_FOUND)
+            {
+              gimp_imagefile_thumb_task_run (tasks[i]);
+
+              tasks[i] = NULL;
+            }
+        }
+
+      for (i = 0; i < n_tasks; i++)
+        {
+          if (! tasks[i])
+            continue;
+
+          if (gimp_async_is_canceled (tasks[i]->async))
+            {
+              gimp_async_abort (tasks[i]->async);
+
+              gimp_imagefile_thumb_task_free (tasks[i]);
+            }
+          else
+            {
+              gimp_imagefile_thumb_task_run (tasks[i]);
+            }
+        }
+    }
+}
+
+/*  checks and loads the thumbnail of a task, on its private GimpThumbnail,
+ *  and finishes the task with it, so the imagefile can take it over in
+ *  the main thread
+ */
+static void
+gimp_imagefile_thumb_task_run (ThumbTask *task)
+{
+  GimpThumbnail *thumbnail = task->thumbnail;
+  ThumbResult   *result;
+
+  result = g_slice_new0 (ThumbResult);
+
+  result->thumbnail = g_object_ref (thumbnail);
+
+  /*  the image was peeked already, don't look for thumbnails of the
+   *  missing ones
+   */
+  if (thumbnail->image_state != GIMP_THUMB_STATE_NOT_FOUND &&
+      gimp_thumbnail_peek_thumb (thumbnail,
+                                 task->size) >= GIMP_THUMB_STATE_EXISTS)
+    {
+      result->pixbuf = gimp_thumbnail_load_thumb (thumbnail, task->size,
+                                                  &result->error);
+    }
+
+  gimp_async_finish_full (task->async, result,
+                          (GDestroyNotify) gimp_imagefile_thumb_result_free);
+
+  gimp_imagefile_thumb_task_free (task);
+}
+
+static void
+gimp_imagefile_thumb_task_free (ThumbTask *task)
+{
+  g_object_unref (task->async);
+  g_object_unref (task->thumbnail);
+
+  g_slice_free (ThumbTask, task);
+}
+
+static void
+gimp_imagefile_thumb_result_free (ThumbResult *result)
+{
+  g_object_unref (result->thumbnail);
+  g_clear_object (&result->pixbuf);
+  g_clear_error (&result->error);
+
+  g_slice_free (ThumbResult, result);
+}
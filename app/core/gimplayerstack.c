@@ -25,13 +25,26 @@
 
 #include "core-types.h"
 
+#include "operations/layer-modes/gimpoperationlayerstack.h"
+
+#include "gimpdrawable-filters.h"
+#include "gimpdrawable-floating-selection.h"
 #include "gimplayer.h"
+#include "gimplayer-floating-selection.h"
+#include "gimplayermask.h"
 #include "gimplayerstack.h"
 
 
+/*  the minimal number of consecutive layers that are composited using a
+ *  single "gimp:layer-stack" node
+ */
+#define MIN_FUSED_LAYERS 2
+
+
 /*  local function prototypes  */
 
 static void   gimp_layer_stack_constructed             (GObject       *object);
+static void   gimp_layer_stack_finalize                (GObject       *object);
 
 static void   gimp_layer_stack_add                     (GimpContainer *container,
                                                         GimpObject    *object);
@@ -41,6 +54,8 @@ static void   gimp_layer_stack_reorder                 (GimpContainer *container
                                                         GimpObject    *object,
                                                         gint           new_index);
 
+static void   gimp_layer_stack_update_graph            (GimpFilterStack *filter_stack);
+
 static void   gimp_layer_stack_layer_active            (GimpLayer      *layer,
                                                         GimpLayerStack *stack);
 static void   gimp_layer_stack_layer_excludes_backdrop (GimpLayer      *layer,
@@ -54,6 +69,26 @@ static void   gimp_layer_stack_update_range            (GimpLayerStack *stack,
                                                         gint            first,
                                                         gint            last);
 
+static void   gimp_layer_stack_layer_update            (GimpLayer      *layer,
+                                                        gint            x,
+                                                        gint            y,
+                                                        gint            width,
+                                                        gint            height,
+                                                        GimpLayerStack *stack);
+static void   gimp_layer_stack_layer_changed           (GimpLayer      *layer,
+                                                        GimpLayerStack *stack);
+static void   gimp_layer_stack_layer_notify            (GimpLayer        *layer,
+                                                        const GParamSpec *pspec,
+                                                        GimpLayerStack   *stack);
+
+static gboolean   gimp_layer_stack_layer_is_fusable    (GimpLayer      *layer);
+static GeglNode * gimp_layer_stack_fuse_layers         (GimpLayerStack *stack,
+                                                        GeglNode       *previous,
+                                                        GList          *layers);
+static void       gimp_layer_stack_set_fused_layers    (GeglNode       *node,
+                                                        GList          *layers,
+                                                        gboolean        force);
+
 
 G_DEFINE_TYPE (GimpLayerStack, gimp_layer_stack, GIMP_TYPE_DRAWABLE_STACK)
 
@@ -63,19 +98,24 @@ G_DEFINE_TYPE (GimpLayerStack, gimp_layer_stack, GIMP_TYPE_DRAWABLE_STACK)
 static void
 gimp_layer_stack_class_init (GimpLayerStackClass *klass)
 {
-  GObjectClass       *object_class    = G_OBJECT_CLASS (klass);
-  GimpContainerClass *container_class = GIMP_CONTAINER_CLASS (klass);
+  GObjectClass         *object_class       = G_OBJECT_CLASS (klass);
+  GimpContainerClass   *container_class    = GIMP_CONTAINER_CLASS (klass);
+  GimpFilterStackClass *filter_stack_class = GIMP_FILTER_STACK_CLASS (klass);
+
+  object_class->constructed        = gimp_layer_stack_constructed;
+  object_class->finalize           = gimp_layer_stack_finalize;
 
-  object_class->constructed = gimp_layer_stack_constructed;
+  container_class->add             = gimp_layer_stack_add;
+  container_class->remove          = gimp_layer_stack_remove;
+  container_class->reorder         = gimp_layer_stack_reorder;
 
-  container_class->add      = gimp_layer_stack_add;
-  container_class->remove   = gimp_layer_stack_remove;
-  container_class->reorder  = gimp_layer_stack_reorder;
+  filter_stack_class->update_graph = gimp_layer_stack_update_graph;
 }
 
 static void
 gimp_layer_stack_init (GimpLayerStack *stack)
 {
+  stack->fusable = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 static void
@@ -94,6 +134,43 @@ gimp_layer_stack_constructed (GObject *object)
   gimp_container_add_handler (container, "excludes-backdrop-changed",
                               G_CALLBACK (gimp_layer_stack_layer_excludes_backdrop),
                               container);
+  gimp_container_add_handler (container, "update",
+                              G_CALLBACK (gimp_layer_stack_layer_update),
+                              container);
+  gimp_container_add_handler (container, "effective-mode-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_changed),
+                              container);
+  gimp_container_add_handler (container, "opacity-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_changed),
+                              container);
+  gimp_container_add_handler (container, "mask-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_changed),
+                              container);
+  gimp_container_add_handler (container, "apply-mask-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_changed),
+                              container);
+  gimp_container_add_handler (container, "notify::buffer",
+                              G_CALLBACK (gimp_layer_stack_layer_notify),
+                              container);
+  gimp_container_add_handler (container, "notify::offset-x",
+                              G_CALLBACK (gimp_layer_stack_layer_notify),
+                              container);
+  gimp_container_add_handler (container, "notify::offset-y",
+                              G_CALLBACK (gimp_layer_stack_layer_notify),
+                              container);
+}
+
+static void
+gimp_layer_stack_finalize (GObject *object)
+{
+  GimpLayerStack *stack = GIMP_LAYER_STACK (object);
+
+  g_list_free_full (stack->fused_nodes, g_object_unref);
+  stack->fused_nodes = NULL;
+
+  g_clear_pointer (&stack->fusable, g_hash_table_unref);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -166,6 +243,74 @@ gimp_layer_stack_new (GType layer_type)
 
 /*  private functions  */
 
+static void
+gimp_layer_stack_update_graph (GimpFilterStack *filter_stack)
+{
+  GimpLayerStack *stack = GIMP_LAYER_STACK (filter_stack);
+  GList          *list;
+  GList          *run   = NULL;
+  GeglNode       *previous;
+  GeglNode       *output;
+
+  while (stack->fused_nodes)
+    {
+      GeglNode *node = stack->fused_nodes->data;
+
+      stack->fused_nodes = g_list_delete_link (stack->fused_nodes,
+                                               stack->fused_nodes);
+
+      gegl_node_disconnect (node, "input");
+      gegl_node_remove_child (filter_stack->graph, node);
+      g_object_unref (node);
+    }
+
+  g_hash_table_remove_all (stack->fusable);
+
+  previous = gegl_node_get_input_proxy (filter_stack->graph, "input");
+
+  /* rewire the graph bottom to top, compositing runs of consecutive
+   * fusable layers using a single node each
+   */
+  for (list = GIMP_LIST (stack)->queue->tail;
+       list;
+       list = g_list_previous (list))
+    {
+      GimpLayer *layer = list->data;
+      GeglNode  *node;
+
+      if (! gimp_filter_get_active (GIMP_FILTER (layer)))
+        continue;
+
+      if (gimp_layer_stack_layer_is_fusable (layer))
+        {
+          g_hash_table_insert (stack->fusable, layer, NULL);
+
+          run = g_list_prepend (run, layer);
+
+          continue;
+        }
+
+      previous = gimp_layer_stack_fuse_layers (stack, previous,
+                                               g_list_reverse (run));
+      run = NULL;
+
+      node = gimp_filter_get_node (GIMP_FILTER (layer));
+
+      gegl_node_connect_to (previous, "output",
+                            node,     "input");
+
+      previous = node;
+    }
+
+  previous = gimp_layer_stack_fuse_layers (stack, previous,
+                                           g_list_reverse (run));
+
+  output = gegl_node_get_output_proxy (filter_stack->graph, "output");
+
+  gegl_node_connect_to (previous, "output",
+                        output,   "input");
+}
+
 static void
 gimp_layer_stack_layer_active (GimpLayer      *layer,
                                GimpLayerStack *stack)
@@ -241,3 +386,178 @@ gimp_layer_stack_update_range (GimpLayerStack *stack,
         }
     }
 }
+
+static void
+gimp_layer_stack_layer_update (GimpLayer      *layer,
+                               gint            x,
+                               gint            y,
+                               gint            width,
+                               gint            height,
+                               GimpLayerStack *stack)
+{
+  if (! GIMP_FILTER_STACK (stack)->graph ||
+      ! gimp_filter_get_active (GIMP_FILTER (layer)))
+    {
+      return;
+    }
+
+  /* adding or removing the layer's filters, or its floating selection, is
+   * not otherwise signalled to the stack, but always results in an update.
+   * this is called for every paint dab, so only do the constant-time check
+   * here; changes to the fused layers' parameters are handled by
+   * gimp_layer_stack_layer_changed().
+   */
+  if (gimp_layer_stack_layer_is_fusable (layer) !=
+      g_hash_table_contains (stack->fusable, layer))
+    {
+      gimp_layer_stack_update_graph (GIMP_FILTER_STACK (stack));
+    }
+}
+
+static void
+gimp_layer_stack_layer_changed (GimpLayer      *layer,
+                                GimpLayerStack *stack)
+{
+  GeglNode *node;
+
+  if (! GIMP_FILTER_STACK (stack)->graph ||
+      ! gimp_filter_get_active (GIMP_FILTER (layer)))
+    {
+      return;
+    }
+
+  if (gimp_layer_stack_layer_is_fusable (layer) !=
+      g_hash_table_contains (stack->fusable, layer))
+    {
+      gimp_layer_stack_update_graph (GIMP_FILTER_STACK (stack));
+
+      return;
+    }
+
+  node = g_hash_table_lookup (stack->fusable, layer);
+
+  if (node)
+    {
+      GList *layers = g_object_get_data (G_OBJECT (node),
+                                         "gimp-layer-stack-layers");
+
+      gimp_layer_stack_set_fused_layers (node, layers, FALSE);
+    }
+}
+
+static void
+gimp_layer_stack_layer_notify (GimpLayer        *layer,
+                               const GParamSpec *pspec,
+                               GimpLayerStack   *stack)
+{
+  gimp_layer_stack_layer_changed (layer, stack);
+}
+
+static gboolean
+gimp_layer_stack_layer_is_fusable (GimpLayer *layer)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (layer);
+
+  /* only plain layers, whose node composites the layer's buffer as-is, can
+   * be fused
+   */
+  return (! gimp_viewable_get_children (GIMP_VIEWABLE (layer)) &&
+          ! gimp_layer_is_floating_sel (layer)                 &&
+          ! gimp_drawable_get_floating_sel (drawable)          &&
+          ! gimp_drawable_has_filters (drawable)               &&
+          ! (layer->mask && gimp_layer_get_show_mask (layer)));
+}
+
+static GeglNode *
+gimp_layer_stack_fuse_layers (GimpLayerStack *stack,
+                              GeglNode       *previous,
+                              GList          *layers)
+{
+  GeglNode *graph = GIMP_FILTER_STACK (stack)->graph;
+  GeglNode *node;
+  GList    *list;
+
+  if (g_list_length (layers) < MIN_FUSED_LAYERS)
+    {
+      for (list = layers; list; list = g_list_next (list))
+        {
+          node = gimp_filter_get_node (list->data);
+
+          gegl_node_connect_to (previous, "output",
+                                node,     "input");
+
+          previous = node;
+        }
+
+      g_list_free (layers);
+
+      return previous;
+    }
+
+  /* the layers' own nodes stay in the graph, disconnected, so that they
+   * can be reconnected when the stack changes
+   */
+  for (list = layers; list; list = g_list_next (list))
+    gegl_node_disconnect (gimp_filter_get_node (list->data), "input");
+
+  node = gegl_node_new_child (graph,
+                              "operation", "gimp:layer-stack",
+                              NULL);
+
+  g_object_set_data_full (G_OBJECT (node), "gimp-layer-stack-layers",
+                          layers, (GDestroyNotify) g_list_free);
+
+  gimp_layer_stack_set_fused_layers (node, layers, TRUE);
+
+  for (list = layers; list; list = g_list_next (list))
+    g_hash_table_insert (stack->fusable, list->data, node);
+
+  gegl_node_connect_to (previous, "output",
+                        node,     "input");
+
+  stack->fused_nodes = g_list_prepend (stack->fused_nodes,
+                                       g_object_ref (node));
+
+  return node;
+}
+
+static void
+gimp_layer_stack_set_fused_layers (GeglNode *node,
+                                   GList    *layers,
+                                   gboolean  force)
+{
+  GimpOperationLayerStackLayer *entries;
+  gint                          n_entries;
+  gint                          i;
+  GList                        *list;
+
+  n_entries = g_list_length (layers);
+  entries   = g_newa (GimpOperationLayerStackLayer, n_entries);
+
+  for (list = layers, i = 0; list; list = g_list_next (list), i++)
+    {
+      GimpLayer                    *layer = list->data;
+      GimpOperationLayerStackLayer *entry = &entries[i];
+
+      entry->buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+      entry->mask   = NULL;
+
+      if (layer->mask && gimp_layer_get_apply_mask (layer))
+        entry->mask = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer->mask));
+
+      gimp_item_get_offset (GIMP_ITEM (layer),
+                            &entry->offset_x, &entry->offset_y);
+
+      entry->mode            = layer->effective_mode;
+      entry->blend_space     = layer->effective_blend_space;
+      entry->composite_space = layer->effective_composite_space;
+      entry->composite_mode  = layer->effective_composite_mode;
+      entry->opacity         = gimp_layer_get_opacity (layer);
+    }
+
+  if (force ||
+      ! gimp_operation_layer_stack_equal_layers (node, entries, n_entries))
+    {
+      gimp_operation_layer_stack_set_layers (node, entries, n_entries);
+    }
+}
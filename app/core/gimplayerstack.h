@@ -36,6 +36,9 @@ typedef struct _GimpLayerStackClass GimpLayerStackClass;
 struct _GimpLayerStack
 {
   GimpDrawableStack  parent_instance;
+
+  GList             *fused_nodes;
+  GHashTable        *fusable;
 };
 
 struct _GimpLayerStackClass
@@ -26,6 +26,10 @@
 
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
+#include "gimp.h"
+#include "gimpcontext.h"
 #include "gimppattern.h"
 #include "gimppattern-header.h"
 #include "gimppattern-load.h"
@@ -34,78 +38,218 @@
 #include "gimp-intl.h"
 
 
+static gboolean      gimp_pattern_load_header (GFile              *file,
+                                               GInputStream       *input,
+                                               GimpPatternHeader  *header,
+                                               gchar             **name,
+                                               GError            **error);
+static const Babl  * gimp_pattern_get_format  (gint                 bytes);
+static GList       * gimp_pattern_load_real   (GimpContext        *context,
+                                               GFile              *file,
+                                               GInputStream       *input,
+                                               gboolean            lazy,
+                                               GError            **error);
+
+
+/*  public functions  */
+
 GList *
 gimp_pattern_load (GimpContext   *context,
                    GFile         *file,
                    GInputStream  *input,
                    GError       **error)
 {
-  GimpPattern       *pattern = NULL;
-  const Babl        *format  = NULL;
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return gimp_pattern_load_real (context, file, input, FALSE, error);
+}
+
+/*  like gimp_pattern_load(), but if "data-lazy-loading" is enabled, only
+ *  reads the pattern's header, and leaves its pixels to
+ *  gimp_pattern_load_pixels()
+ */
+GList *
+gimp_pattern_load_lazy (GimpContext   *context,
+                        GFile         *file,
+                        GInputStream  *input,
+                        GError       **error)
+{
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return gimp_pattern_load_real (context, file, input,
+                                 context->gimp->config->data_lazy_loading,
+                                 error);
+}
+
+/*  loads the pixels of a lazily loaded pattern, from the start of its file.
+ *  if 'input' is NULL, or on error, the pattern is left with cleared pixels
+ *  of the size read initially.
+ */
+gboolean
+gimp_pattern_load_pixels (GimpData      *data,
+                          GInputStream  *input,
+                          GError       **error)
+{
+  GimpPattern       *pattern = GIMP_PATTERN (data);
   GimpPatternHeader  header;
   gsize              size;
   gsize              bytes_read;
-  gsize              bn_size;
-  gchar             *name = NULL;
+
+  g_return_val_if_fail (input == NULL || G_IS_INPUT_STREAM (input), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (input)
+    {
+      if (! gimp_pattern_load_header (gimp_data_get_file (data), input,
+                                      &header, NULL, error))
+        {
+          input = NULL;
+        }
+      else if (header.width  != pattern->lazy_width  ||
+               header.height != pattern->lazy_height ||
+               gimp_pattern_get_format (header.bytes) != pattern->lazy_format)
+        {
+          g_set_error_literal (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                               _("The pattern's size changed."));
+          input = NULL;
+        }
+    }
+
+  g_clear_pointer (&pattern->mask, gimp_temp_buf_unref);
+  pattern->mask = gimp_temp_buf_new (pattern->lazy_width,
+                                     pattern->lazy_height,
+                                     pattern->lazy_format);
+
+  if (input)
+    {
+      size = gimp_temp_buf_get_data_size (pattern->mask);
+
+      if (g_input_stream_read_all (input,
+                                   gimp_temp_buf_get_data (pattern->mask), size,
+                                   &bytes_read, NULL, error) &&
+          bytes_read == size)
+        {
+          return TRUE;
+        }
+
+      g_prefix_error (error, _("File appears truncated."));
+    }
+
+  gimp_temp_buf_data_clear (pattern->mask);
+
+  return FALSE;
+}
+
+GList *
+gimp_pattern_load_pixbuf (GimpContext   *context,
+                          GFile         *file,
+                          GInputStream  *input,
+                          GError       **error)
+{
+  GimpPattern *pattern;
+  GdkPixbuf   *pixbuf;
+  gchar       *name;
 
   g_return_val_if_fail (G_IS_FILE (file), NULL);
   g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  pixbuf = gdk_pixbuf_new_from_stream (input, NULL, error);
+  if (! pixbuf)
+    return NULL;
+
+  name = g_strdup (gdk_pixbuf_get_option (pixbuf, "tEXt::Title"));
+
+  if (! name)
+    name = g_strdup (gdk_pixbuf_get_option (pixbuf, "tEXt::Comment"));
+
+  if (! name)
+    name = g_path_get_basename (gimp_file_get_utf8_name (file));
+
+  pattern = g_object_new (GIMP_TYPE_PATTERN,
+                          "name",      name,
+                          "mime-type", NULL, /* FIXME!! */
+                          NULL);
+  g_free (name);
+
+  pattern->mask = gimp_temp_buf_new_from_pixbuf (pixbuf, NULL);
+
+  g_object_unref (pixbuf);
+
+  return g_list_prepend (NULL, pattern);
+}
+
+/*  private functions  */
+
+static gboolean
+gimp_pattern_load_header (GFile              *file,
+                          GInputStream       *input,
+                          GimpPatternHeader  *header,
+                          gchar             **name,
+                          GError            **error)
+{
+  gsize bytes_read;
+  gsize bn_size;
+
   /*  read the size  */
-  if (! g_input_stream_read_all (input, &header, sizeof (header),
+  if (! g_input_stream_read_all (input, header, sizeof (*header),
                                  &bytes_read, NULL, error) ||
-      bytes_read != sizeof (header))
+      bytes_read != sizeof (*header))
     {
       g_prefix_error (error, _("File appears truncated: "));
-      goto error;
+      return FALSE;
     }
 
   /*  rearrange the bytes in each unsigned int  */
-  header.header_size  = g_ntohl (header.header_size);
-  header.version      = g_ntohl (header.version);
-  header.width        = g_ntohl (header.width);
-  header.height       = g_ntohl (header.height);
-  header.bytes        = g_ntohl (header.bytes);
-  header.magic_number = g_ntohl (header.magic_number);
+  header->header_size  = g_ntohl (header->header_size);
+  header->version      = g_ntohl (header->version);
+  header->width        = g_ntohl (header->width);
+  header->height       = g_ntohl (header->height);
+  header->bytes        = g_ntohl (header->bytes);
+  header->magic_number = g_ntohl (header->magic_number);
 
   /*  Check for correct file format */
-  if (header.magic_number != GIMP_PATTERN_MAGIC ||
-      header.version      != 1                  ||
-      header.header_size  <= sizeof (header))
+  if (header->magic_number != GIMP_PATTERN_MAGIC ||
+      header->version      != 1                  ||
+      header->header_size  <= sizeof (*header))
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Unknown pattern format version %d."),
-                   header.version);
-      goto error;
+                   header->version);
+      return FALSE;
     }
 
   /*  Check for supported bit depths  */
-  if (header.bytes < 1 || header.bytes > 4)
+  if (header->bytes < 1 || header->bytes > 4)
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Unsupported pattern depth %d.\n"
                      "GIMP Patterns must be GRAY or RGB."),
-                   header.bytes);
-      goto error;
+                   header->bytes);
+      return FALSE;
     }
 
   /*  Validate dimensions  */
-  if ((header.width  == 0) || (header.width  > GIMP_PATTERN_MAX_SIZE) ||
-      (header.height == 0) || (header.height > GIMP_PATTERN_MAX_SIZE) ||
-      (G_MAXSIZE / header.width / header.height / header.bytes < 1))
+  if ((header->width  == 0) || (header->width  > GIMP_PATTERN_MAX_SIZE) ||
+      (header->height == 0) || (header->height > GIMP_PATTERN_MAX_SIZE) ||
+      (G_MAXSIZE / header->width / header->height / header->bytes < 1))
     {
       g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
                    _("Invalid header data in '%s': width=%lu, height=%lu, "
                      "bytes=%lu"), gimp_file_get_utf8_name (file),
-                   (gulong) header.width,
-                   (gulong) header.height,
-                   (gulong) header.bytes);
-      goto error;
+                   (gulong) header->width,
+                   (gulong) header->height,
+                   (gulong) header->bytes);
+      return FALSE;
     }
 
-  /*  Read in the pattern name  */
-  if ((bn_size = (header.header_size - sizeof (header))))
+  /*  Read in the pattern name, or skip it if we don't need it  */
+  if ((bn_size = (header->header_size - sizeof (*header))))
     {
       gchar *utf8;
 
@@ -116,27 +260,72 @@ gimp_pattern_load (GimpContext   *context,
                          "Pattern name is too long: %lu"),
                        gimp_file_get_utf8_name (file),
                        (gulong) bn_size);
-          goto error;
+          return FALSE;
         }
 
-      name = g_new0 (gchar, bn_size + 1);
+      if (! name)
+        {
+          if (g_input_stream_skip (input, bn_size, NULL, error) != bn_size)
+            {
+              g_prefix_error (error, _("File appears truncated."));
+              return FALSE;
+            }
+
+          return TRUE;
+        }
 
-      if (! g_input_stream_read_all (input, name, bn_size,
+      *name = g_new0 (gchar, bn_size + 1);
+
+      if (! g_input_stream_read_all (input, *name, bn_size,
                                      &bytes_read, NULL, error) ||
           bytes_read != bn_size)
         {
           g_prefix_error (error, _("File appears truncated."));
-          g_free (name);
-          goto error;
+          g_clear_pointer (name, g_free);
+          return FALSE;
         }
 
-      utf8 = gimp_any_to_utf8 (name, bn_size - 1,
+      utf8 = gimp_any_to_utf8 (*name, bn_size - 1,
                                _("Invalid UTF-8 string in pattern file '%s'."),
                                gimp_file_get_utf8_name (file));
-      g_free (name);
-      name = utf8;
+      g_free (*name);
+      *name = utf8;
+    }
+
+  return TRUE;
+}
+
+static const Babl *
+gimp_pattern_get_format (gint bytes)
+{
+  switch (bytes)
+    {
+    case 1: return babl_format ("Y' u8");
+    case 2: return babl_format ("Y'A u8");
+    case 3: return babl_format ("R'G'B' u8");
+    case 4: return babl_format ("R'G'B'A u8");
     }
 
+  return NULL;
+}
+
+static GList *
+gimp_pattern_load_real (GimpContext   *context,
+                        GFile         *file,
+                        GInputStream  *input,
+                        gboolean       lazy,
+                        GError       **error)
+{
+  GimpPattern       *pattern = NULL;
+  const Babl        *format  = NULL;
+  GimpPatternHeader  header;
+  gsize              size;
+  gsize              bytes_read;
+  gchar             *name    = NULL;
+
+  if (! gimp_pattern_load_header (file, input, &header, &name, error))
+    goto error;
+
   if (! name)
     name = g_strdup (_("Unnamed"));
 
@@ -147,12 +336,17 @@ gimp_pattern_load (GimpContext   *context,
 
   g_free (name);
 
-  switch (header.bytes)
+  format = gimp_pattern_get_format (header.bytes);
+
+  if (lazy)
     {
-    case 1: format = babl_format ("Y' u8");      break;
-    case 2: format = babl_format ("Y'A u8");     break;
-    case 3: format = babl_format ("R'G'B' u8");  break;
-    case 4: format = babl_format ("R'G'B'A u8"); break;
+      pattern->lazy_width  = header.width;
+      pattern->lazy_height = header.height;
+      pattern->lazy_format = format;
+
+      gimp_data_set_lazy (GIMP_DATA (pattern), context->gimp);
+
+      return g_list_prepend (NULL, pattern);
     }
 
   pattern->mask = gimp_temp_buf_new (header.width, header.height, format);
@@ -178,42 +372,3 @@ gimp_pattern_load (GimpContext   *context,
 
   return NULL;
 }
-
-GList *
-gimp_pattern_load_pixbuf (GimpContext   *context,
-                          GFile         *file,
-                          GInputStream  *input,
-                          GError       **error)
-{
-  GimpPattern *pattern;
-  GdkPixbuf   *pixbuf;
-  gchar       *name;
-
-  g_return_val_if_fail (G_IS_FILE (file), NULL);
-  g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
-  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-  pixbuf = gdk_pixbuf_new_from_stream (input, NULL, error);
-  if (! pixbuf)
-    return NULL;
-
-  name = g_strdup (gdk_pixbuf_get_option (pixbuf, "tEXt::Title"));
-
-  if (! name)
-    name = g_strdup (gdk_pixbuf_get_option (pixbuf, "tEXt::Comment"));
-
-  if (! name)
-    name = g_path_get_basename (gimp_file_get_utf8_name (file));
-
-  pattern = g_object_new (GIMP_TYPE_PATTERN,
-                          "name",      name,
-                          "mime-type", NULL, /* FIXME!! */
-                          NULL);
-  g_free (name);
-
-  pattern->mask = gimp_temp_buf_new_from_pixbuf (pixbuf, NULL);
-
-  g_object_unref (pixbuf);
-
-  return g_list_prepend (NULL, pattern);
-}
@@ -56,6 +56,11 @@ static gchar       * gimp_pattern_get_description   (GimpViewable         *viewa
 static const gchar * gimp_pattern_get_extension     (GimpData             *data);
 static void          gimp_pattern_copy              (GimpData             *data,
                                                      GimpData             *src_data);
+static gboolean      gimp_pattern_unload_lazy       (GimpData             *data);
+
+static void          gimp_pattern_get_mask_size     (GimpPattern          *pattern,
+                                                     gint                 *width,
+                                                     gint                 *height);
 
 static gchar       * gimp_pattern_get_checksum      (GimpTagged           *tagged);
 
@@ -87,6 +92,8 @@ gimp_pattern_class_init (GimpPatternClass *klass)
   data_class->save                  = gimp_pattern_save;
   data_class->get_extension         = gimp_pattern_get_extension;
   data_class->copy                  = gimp_pattern_copy;
+  data_class->load_lazy             = gimp_pattern_load_pixels;
+  data_class->unload_lazy           = gimp_pattern_unload_lazy;
 }
 
 static void
@@ -129,10 +136,7 @@ gimp_pattern_get_size (GimpViewable *viewable,
                        gint         *width,
                        gint         *height)
 {
-  GimpPattern *pattern = GIMP_PATTERN (viewable);
-
-  *width  = gimp_temp_buf_get_width  (pattern->mask);
-  *height = gimp_temp_buf_get_height (pattern->mask);
+  gimp_pattern_get_mask_size (GIMP_PATTERN (viewable), width, height);
 
   return TRUE;
 }
@@ -144,19 +148,20 @@ gimp_pattern_get_new_preview (GimpViewable *viewable,
                               gint          height)
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
+  GimpTempBuf *mask    = gimp_pattern_ref_mask (pattern);
   GimpTempBuf *temp_buf;
   GeglBuffer  *src_buffer;
   GeglBuffer  *dest_buffer;
   gint         copy_width;
   gint         copy_height;
 
-  copy_width  = MIN (width,  gimp_temp_buf_get_width  (pattern->mask));
-  copy_height = MIN (height, gimp_temp_buf_get_height (pattern->mask));
+  copy_width  = MIN (width,  gimp_temp_buf_get_width  (mask));
+  copy_height = MIN (height, gimp_temp_buf_get_height (mask));
 
   temp_buf = gimp_temp_buf_new (copy_width, copy_height,
-                                gimp_temp_buf_get_format (pattern->mask));
+                                gimp_temp_buf_get_format (mask));
 
-  src_buffer  = gimp_temp_buf_create_buffer (pattern->mask);
+  src_buffer  = gimp_temp_buf_create_buffer (mask);
   dest_buffer = gimp_temp_buf_create_buffer (temp_buf);
 
   gimp_gegl_buffer_copy (src_buffer,
@@ -167,6 +172,8 @@ gimp_pattern_get_new_preview (GimpViewable *viewable,
   g_object_unref (src_buffer);
   g_object_unref (dest_buffer);
 
+  gimp_temp_buf_unref (mask);
+
   return temp_buf;
 }
 
@@ -175,11 +182,14 @@ gimp_pattern_get_description (GimpViewable  *viewable,
                               gchar        **tooltip)
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
+  gint         width;
+  gint         height;
+
+  gimp_pattern_get_mask_size (pattern, &width, &height);
 
   return g_strdup_printf ("%s (%d × %d)",
                           gimp_object_get_name (pattern),
-                          gimp_temp_buf_get_width  (pattern->mask),
-                          gimp_temp_buf_get_height (pattern->mask));
+                          width, height);
 }
 
 static const gchar *
@@ -201,22 +211,57 @@ gimp_pattern_copy (GimpData *data,
   gimp_data_dirty (data);
 }
 
+static gboolean
+gimp_pattern_unload_lazy (GimpData *data)
+{
+  GimpPattern *pattern = GIMP_PATTERN (data);
+
+  /*  only called from the main loop, and users of the mask outside of it
+   *  take their own reference using gimp_pattern_ref_mask()
+   */
+  g_clear_pointer (&pattern->mask, gimp_temp_buf_unref);
+
+  return TRUE;
+}
+
+static void
+gimp_pattern_get_mask_size (GimpPattern *pattern,
+                            gint        *width,
+                            gint        *height)
+{
+  if (pattern->mask)
+    {
+      *width  = gimp_temp_buf_get_width  (pattern->mask);
+      *height = gimp_temp_buf_get_height (pattern->mask);
+    }
+  else
+    {
+      *width  = pattern->lazy_width;
+      *height = pattern->lazy_height;
+    }
+}
+
 static gchar *
 gimp_pattern_get_checksum (GimpTagged *tagged)
 {
   GimpPattern *pattern         = GIMP_PATTERN (tagged);
+  GimpTempBuf *mask;
   gchar       *checksum_string = NULL;
 
-  if (pattern->mask)
+  mask = gimp_pattern_ref_mask (pattern);
+
+  if (mask)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
 
-      g_checksum_update (checksum, gimp_temp_buf_get_data (pattern->mask),
-                         gimp_temp_buf_get_data_size (pattern->mask));
+      g_checksum_update (checksum, gimp_temp_buf_get_data (mask),
+                         gimp_temp_buf_get_data_size (mask));
 
       checksum_string = g_strdup (g_checksum_get_string (checksum));
 
       g_checksum_free (checksum);
+
+      gimp_temp_buf_unref (mask);
     }
 
   return checksum_string;
@@ -270,18 +315,53 @@ gimp_pattern_get_standard (GimpContext *context)
   return standard_pattern;
 }
 
+/*  returns the pattern's mask, without a reference.  the pixels of lazily
+ *  loaded patterns are dropped from the main loop, so the mask may only be
+ *  used on the main thread, until control returns to the main loop.  use
+ *  gimp_pattern_ref_mask() otherwise.
+ */
 GimpTempBuf *
 gimp_pattern_get_mask (GimpPattern *pattern)
 {
   g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (pattern));
+
   return pattern->mask;
 }
 
+/*  returns a reference to the pattern's mask, which stays valid even if
+ *  the pattern's pixels are dropped.  can be called from any thread.
+ */
+GimpTempBuf *
+gimp_pattern_ref_mask (GimpPattern *pattern)
+{
+  GimpTempBuf *mask = NULL;
+
+  g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
+
+  gimp_data_lock_loaded (GIMP_DATA (pattern));
+
+  if (pattern->mask)
+    mask = gimp_temp_buf_ref (pattern->mask);
+
+  gimp_data_unlock_loaded (GIMP_DATA (pattern));
+
+  return mask;
+}
+
 GeglBuffer *
 gimp_pattern_create_buffer (GimpPattern *pattern)
 {
+  GimpTempBuf *mask;
+  GeglBuffer  *buffer;
+
   g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
 
-  return gimp_temp_buf_create_buffer (pattern->mask);
+  mask   = gimp_pattern_ref_mask (pattern);
+  buffer = gimp_temp_buf_create_buffer (mask);
+
+  gimp_temp_buf_unref (mask);
+
+  return buffer;
 }
@@ -37,6 +37,13 @@ struct _GimpPattern
   GimpData     parent_instance;
 
   GimpTempBuf *mask;
+
+  /*  the size and format of a lazily loaded pattern, whose mask is only
+   *  there while it's loaded
+   */
+  gint         lazy_width;
+  gint         lazy_height;
+  const Babl  *lazy_format;
 };
 
 struct _GimpPatternClass
@@ -52,6 +59,7 @@ GimpData    * gimp_pattern_new           (GimpContext *context,
 GimpData    * gimp_pattern_get_standard  (GimpContext *context);
 
 GimpTempBuf * gimp_pattern_get_mask      (GimpPattern *pattern);
+GimpTempBuf * gimp_pattern_ref_mask      (GimpPattern *pattern);
 GeglBuffer  * gimp_pattern_create_buffer (GimpPattern *pattern);
 
 
@@ -846,6 +846,10 @@ gimp_projection_chunk_render_iteration (GimpProjection *proj)
 
       gimp_tile_handler_validate_begin_validate (proj->priv->validate_handler);
 
+      /*  chunks are rendered one at a time:  the projection's graph may not
+       *  be processed by several threads at once, so only GEGL's own
+       *  per-operation threading applies to each chunk
+       */
       while (gimp_chunk_iterator_get_rect (proj->priv->iter, &rect))
         {
           gimp_projection_paint_area (proj, TRUE,
@@ -68,6 +68,12 @@ typedef struct
   GimpTagCacheRecord  current_record;
 } GimpTagCacheParseData;
 
+typedef struct
+{
+  GList              *records;
+  GHashTable         *checksums;
+} GimpTagCacheSaveData;
+
 struct _GimpTagCachePrivate
 {
   GArray *records;
@@ -238,10 +244,7 @@ gimp_tag_cache_add_object (GimpTagCache *cache,
   identifier = gimp_tagged_get_identifier (tagged);
 
   if (identifier)
-    {
-      identifier_quark = g_quark_try_string (identifier);
-      g_free (identifier);
-    }
+    identifier_quark = g_quark_try_string (identifier);
 
   if (identifier_quark)
     {
@@ -258,6 +261,7 @@ gimp_tag_cache_add_object (GimpTagCache *cache,
                 }
 
               rec->referenced = TRUE;
+              g_free (identifier);
               return;
             }
         }
@@ -266,10 +270,7 @@ gimp_tag_cache_add_object (GimpTagCache *cache,
   checksum = gimp_tagged_get_checksum (tagged);
 
   if (checksum)
-    {
-      checksum_quark = g_quark_try_string (checksum);
-      g_free (checksum);
-    }
+    checksum_quark = g_quark_try_string (checksum);
 
   if (checksum_quark)
     {
@@ -294,11 +295,29 @@ gimp_tag_cache_add_object (GimpTagCache *cache,
                 }
 
               rec->referenced = TRUE;
+              g_free (identifier);
+              g_free (checksum);
               return;
             }
         }
     }
 
+  /*  remember the checksum of new objects, so that saving the cache
+   *  doesn't have to compute it again
+   */
+  if (identifier && checksum)
+    {
+      GimpTagCacheRecord rec = { 0, };
+
+      rec.identifier = g_quark_from_string (identifier);
+      rec.checksum   = g_quark_from_string (checksum);
+      rec.referenced = TRUE;
+
+      g_array_append_val (cache->priv->records, rec);
+    }
+
+  g_free (identifier);
+  g_free (checksum);
 }
 
 static void
@@ -309,25 +328,40 @@ gimp_tag_cache_object_initialize (GimpTagged   *tagged,
 }
 
 static void
-gimp_tag_cache_tagged_to_cache_record_foreach (GimpTagged  *tagged,
-                                               GList      **cache_records)
+gimp_tag_cache_tagged_to_cache_record_foreach (GimpTagged           *tagged,
+                                               GimpTagCacheSaveData *data)
 {
   gchar *identifier = gimp_tagged_get_identifier (tagged);
 
   if (identifier)
     {
       GimpTagCacheRecord *cache_rec = g_new (GimpTagCacheRecord, 1);
-      gchar              *checksum;
-
-      checksum = gimp_tagged_get_checksum (tagged);
+      GQuark              checksum  = 0;
 
       cache_rec->identifier = g_quark_from_string (identifier);
-      cache_rec->checksum   = g_quark_from_string (checksum);
-      cache_rec->tags       = g_list_copy (gimp_tagged_get_tags (tagged));
 
-      g_free (checksum);
+      /*  don't load the pixels of lazily loaded data just to compute a
+       *  checksum we already know
+       */
+      if (GIMP_IS_DATA (tagged) && ! gimp_data_is_loaded (GIMP_DATA (tagged)))
+        {
+          checksum = GPOINTER_TO_UINT (g_hash_table_lookup (data->checksums,
+                                                            GUINT_TO_POINTER (cache_rec->identifier)));
+        }
+
+      if (! checksum)
+        {
+          gchar *string = gimp_tagged_get_checksum (tagged);
+
+          checksum = g_quark_from_string (string);
+
+          g_free (string);
+        }
 
-      *cache_records = g_list_prepend (*cache_records, cache_rec);
+      cache_rec->checksum = checksum;
+      cache_rec->tags     = g_list_copy (gimp_tagged_get_tags (tagged));
+
+      data->records = g_list_prepend (data->records, cache_rec);
     }
 
   g_free (identifier);
@@ -342,22 +376,32 @@ gimp_tag_cache_tagged_to_cache_record_foreach (GimpTagged  *tagged,
 void
 gimp_tag_cache_save (GimpTagCache *cache)
 {
-  GString       *buf;
-  GList         *saved_records;
-  GList         *iterator;
-  GFile         *file;
-  GOutputStream *output;
-  GError        *error = NULL;
-  gint           i;
+  GimpTagCacheSaveData  data;
+  GString              *buf;
+  GList                *saved_records;
+  GList                *iterator;
+  GFile                *file;
+  GOutputStream        *output;
+  GError               *error = NULL;
+  gint                  i;
 
   g_return_if_fail (GIMP_IS_TAG_CACHE (cache));
 
+  data.checksums = g_hash_table_new (NULL, NULL);
+
   saved_records = NULL;
   for (i = 0; i < cache->priv->records->len; i++)
     {
       GimpTagCacheRecord *current_record = &g_array_index (cache->priv->records,
                                                            GimpTagCacheRecord, i);
 
+      if (current_record->referenced && current_record->identifier)
+        {
+          g_hash_table_insert (data.checksums,
+                               GUINT_TO_POINTER (current_record->identifier),
+                               GUINT_TO_POINTER (current_record->checksum));
+        }
+
       if (! current_record->referenced && current_record->tags)
         {
           /* keep tagged objects which have tags assigned
@@ -373,16 +417,20 @@ gimp_tag_cache_save (GimpTagCache *cache)
         }
     }
 
+  data.records = saved_records;
+
   for (iterator = cache->priv->containers;
        iterator;
        iterator = g_list_next (iterator))
     {
       gimp_container_foreach (GIMP_CONTAINER (iterator->data),
                               (GFunc) gimp_tag_cache_tagged_to_cache_record_foreach,
-                              &saved_records);
+                              &data);
     }
 
-  saved_records = g_list_reverse (saved_records);
+  g_hash_table_unref (data.checksums);
+
+  saved_records = g_list_reverse (data.records);
 
   buf = g_string_new ("");
   g_string_append (buf, "<?xml version='1.0' encoding='UTF-8'?>\n");
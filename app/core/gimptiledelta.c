@@ -0,0 +1,314 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimptiledelta.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "core-types.h"
+
+#include "gimpasync.h"
+#include "gimptiledelta.h"
+
+
+/*  a tile delta holds the tiles of a buffer that differ from a reference
+ *  buffer of the same extent, each one compressed on its own.  the tiles
+ *  that are equal aren't stored at all; applying the delta on top of a copy
+ *  of the reference gives back the original buffer.
+ *
+ *  the tiles follow the buffer's tile grid, anchored at its extent, so that
+ *  for buffers aligned to their drawable's tiles (as undo buffers usually
+ *  are), a changed pixel only costs the one tile it lives in.
+ *
+ *  without zstd, the changed tiles are stored uncompressed.
+ */
+
+
+/*  zstd's fastest level.  tiles are compressed in the background, but we
+ *  want them to be done before the next few operations, and higher levels
+ *  gain little on pixel data.
+ */
+#define ZSTD_LEVEL 1
+
+
+typedef struct
+{
+  GeglRectangle  rect;
+  gboolean       compressed;
+  gsize          size;
+  guchar        *data;
+} GimpTileDeltaTile;
+
+struct _GimpTileDelta
+{
+  const Babl    *format;
+  GeglRectangle  extent;
+  gint           tile_width;
+  gint           tile_height;
+
+  GArray        *tiles;
+  gint64         data_size;
+};
+
+
+/*  public functions  */
+
+/*  creates a delta of 'buffer' against 'reference', which must have the
+ *  same extent.  returns NULL if 'async' was canceled while creating the
+ *  delta.
+ */
+GimpTileDelta *
+gimp_tile_delta_new (GeglBuffer *buffer,
+                     GeglBuffer *reference,
+                     GimpAsync  *async)
+{
+  GimpTileDelta       *delta;
+  const GeglRectangle *extent;
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx           *cctx;
+  guchar              *dest;
+  gsize                bound;
+#endif
+  guchar              *data;
+  guchar              *ref_data;
+  gsize                tile_size;
+  gboolean             canceled = FALSE;
+  gint                 bpp;
+  gint                 x, y;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (reference), NULL);
+  g_return_val_if_fail (gegl_rectangle_equal (gegl_buffer_get_extent (buffer),
+                                              gegl_buffer_get_extent (reference)),
+                        NULL);
+  g_return_val_if_fail (async == NULL || GIMP_IS_ASYNC (async), NULL);
+
+  extent = gegl_buffer_get_extent (buffer);
+
+  delta = g_slice_new0 (GimpTileDelta);
+
+  delta->format = gegl_buffer_get_format (buffer);
+  delta->extent = *extent;
+  delta->tiles  = g_array_new (FALSE, FALSE, sizeof (GimpTileDeltaTile));
+
+  g_object_get (buffer,
+                "tile-width",  &delta->tile_width,
+                "tile-height", &delta->tile_height,
+                NULL);
+
+  bpp       = babl_format_get_bytes_per_pixel (delta->format);
+  tile_size = (gsize) delta->tile_width * delta->tile_height * bpp;
+
+  data     = g_malloc (tile_size);
+  ref_data = g_malloc (tile_size);
+
+#ifdef HAVE_ZSTD
+  bound = ZSTD_compressBound (tile_size);
+  dest  = g_malloc (bound);
+  cctx  = ZSTD_createCCtx ();
+#endif
+
+  for (y = extent->y; ! canceled && y < extent->y + extent->height;
+       y += delta->tile_height)
+    {
+      for (x = extent->x; x < extent->x + extent->width;
+           x += delta->tile_width)
+        {
+          GimpTileDeltaTile tile;
+          gsize             size;
+#ifdef HAVE_ZSTD
+          gsize             len;
+#endif
+
+          if (async && gimp_async_is_canceled (async))
+            {
+              canceled = TRUE;
+
+              break;
+            }
+
+          tile.rect.x      = x;
+          tile.rect.y      = y;
+          tile.rect.width  = MIN (delta->tile_width,
+                                  extent->x + extent->width - x);
+          tile.rect.height = MIN (delta->tile_height,
+                                  extent->y + extent->height - y);
+
+          size = (gsize) tile.rect.width * tile.rect.height * bpp;
+
+          gegl_buffer_get (buffer, &tile.rect, 1.0, delta->format, data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+          gegl_buffer_get (reference, &tile.rect, 1.0, delta->format, ref_data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          if (! memcmp (data, ref_data, size))
+            continue;
+
+#ifdef HAVE_ZSTD
+          len = ZSTD_compressCCtx (cctx, dest, bound, data, size, ZSTD_LEVEL);
+
+          if (! ZSTD_isError (len) && len < size)
+            {
+              tile.compressed = TRUE;
+              tile.size       = len;
+              tile.data       = g_malloc (len);
+
+              memcpy (tile.data, dest, len);
+            }
+          else
+#endif
+            {
+              tile.compressed = FALSE;
+              tile.size       = size;
+              tile.data       = g_malloc (size);
+
+              memcpy (tile.data, data, size);
+            }
+
+          g_array_append_val (delta->tiles, tile);
+
+          delta->data_size += tile.size;
+        }
+    }
+
+#ifdef HAVE_ZSTD
+  ZSTD_freeCCtx (cctx);
+  g_free (dest);
+#endif
+
+  g_free (data);
+  g_free (ref_data);
+
+  if (canceled)
+    g_clear_pointer (&delta, gimp_tile_delta_free);
+
+  return delta;
+}
+
+void
+gimp_tile_delta_free (GimpTileDelta *delta)
+{
+  gint i;
+
+  g_return_if_fail (delta != NULL);
+
+  for (i = 0; i < delta->tiles->len; i++)
+    g_free (g_array_index (delta->tiles, GimpTileDeltaTile, i).data);
+
+  g_array_free (delta->tiles, TRUE);
+
+  g_slice_free (GimpTileDelta, delta);
+}
+
+/*  writes the tiles of 'delta' to 'buffer', which normally holds a copy of
+ *  the reference the delta was created against.  returns FALSE if a tile
+ *  couldn't be decompressed.
+ */
+gboolean
+gimp_tile_delta_apply (const GimpTileDelta *delta,
+                       GeglBuffer          *buffer)
+{
+  guchar   *data;
+  gboolean  success = TRUE;
+  gint      bpp;
+  gint      i;
+
+  g_return_val_if_fail (delta != NULL, FALSE);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+
+  bpp  = babl_format_get_bytes_per_pixel (delta->format);
+  data = g_malloc ((gsize) delta->tile_width * delta->tile_height * bpp);
+
+  for (i = 0; i < delta->tiles->len; i++)
+    {
+      const GimpTileDeltaTile *tile;
+      const guchar            *src;
+
+      tile = &g_array_index (delta->tiles, GimpTileDeltaTile, i);
+
+#ifdef HAVE_ZSTD
+      if (tile->compressed)
+        {
+          gsize size = (gsize) tile->rect.width * tile->rect.height * bpp;
+          gsize len;
+
+          len = ZSTD_decompress (data, size, tile->data, tile->size);
+
+          if (ZSTD_isError (len) || len != size)
+            {
+              g_warning ("%s: failed to decompress tile at %d,%d",
+                         G_STRFUNC, tile->rect.x, tile->rect.y);
+
+              success = FALSE;
+
+              continue;
+            }
+
+          src = data;
+        }
+      else
+#endif
+        {
+          src = tile->data;
+        }
+
+      gegl_buffer_set (buffer, &tile->rect, 0, delta->format, src,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (data);
+
+  return success;
+}
+
+const Babl *
+gimp_tile_delta_get_format (const GimpTileDelta *delta)
+{
+  g_return_val_if_fail (delta != NULL, NULL);
+
+  return delta->format;
+}
+
+gint
+gimp_tile_delta_get_n_tiles (const GimpTileDelta *delta)
+{
+  g_return_val_if_fail (delta != NULL, 0);
+
+  return delta->tiles->len;
+}
+
+gint64
+gimp_tile_delta_get_memsize (const GimpTileDelta *delta)
+{
+  if (delta)
+    {
+      return (sizeof (GimpTileDelta) +
+              delta->tiles->len * sizeof (GimpTileDeltaTile) +
+              delta->data_size);
+    }
+
+  return 0;
+}
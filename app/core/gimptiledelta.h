@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimptiledelta.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TILE_DELTA_H__
+#define __GIMP_TILE_DELTA_H__
+
+
+GimpTileDelta * gimp_tile_delta_new         (GeglBuffer          *buffer,
+                                             GeglBuffer          *reference,
+                                             GimpAsync           *async) G_GNUC_WARN_UNUSED_RESULT;
+void            gimp_tile_delta_free        (GimpTileDelta       *delta);
+
+gboolean        gimp_tile_delta_apply       (const GimpTileDelta *delta,
+                                             GeglBuffer          *buffer);
+
+const Babl    * gimp_tile_delta_get_format  (const GimpTileDelta *delta);
+gint            gimp_tile_delta_get_n_tiles (const GimpTileDelta *delta);
+
+gint64          gimp_tile_delta_get_memsize (const GimpTileDelta *delta);
+
+
+#endif  /*  __GIMP_TILE_DELTA_H__  */
@@ -827,6 +827,12 @@ gimp_display_paint_area (GimpDisplay *display,
       return;
     }
 
+  gimp_display_shell_render_invalidate_image (shell,
+                                              rect.x,
+                                              rect.y,
+                                              rect.width,
+                                              rect.height);
+
   /*  display the area  */
   gimp_display_shell_transform_bounds (shell,
                                        rect.x,
@@ -267,7 +267,7 @@ gimp_display_shell_canvas_size_allocate (GtkWidget        *widget,
       shell->disp_height != allocation->height)
     {
       g_clear_pointer (&shell->render_cache, cairo_surface_destroy);
-      gimp_display_shell_render_invalidate_full (shell);
+      gimp_display_shell_render_invalidate_view (shell);
 
       shell->disp_width  = allocation->width;
       shell->disp_height = allocation->height;
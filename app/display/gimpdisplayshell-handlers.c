@@ -1111,7 +1111,7 @@ gimp_display_shell_monitor_res_notify_handler (GObject          *config,
       gimp_display_shell_scaled (shell);
 
       gimp_display_shell_expose_full (shell);
-      gimp_display_shell_render_invalidate_full (shell);
+      gimp_display_shell_render_invalidate_view (shell);
     }
 }
 
@@ -20,6 +20,7 @@
 #include <gegl.h>
 #include <gtk/gtk.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 #include "libgimpcolor/gimpcolor.h"
 #include "libgimpwidgets/gimpwidgets.h"
@@ -43,6 +44,68 @@
 #define GIMP_DISPLAY_RENDER_ENABLE_SCALING 1
 #define GIMP_DISPLAY_RENDER_MAX_SCALE      4
 
+#define GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE 256
+#define GIMP_DISPLAY_RENDER_LEVELS_MAX_SIZE (64 << 20)  /* bytes per shell */
+
+/*  the origin of the tile containing level coordinate 'x'  */
+#define RENDER_TILE_ORIGIN(x) \
+  ((x) - ((((x) % GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE) + \
+           GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE) %        \
+          GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE))
+
+
+/*  besides the render cache, which holds what is currently on screen,
+ *  each shell keeps the tiles it rendered at the last few zoom levels,
+ *  in scaled image coordinates, so that scrolling back to them, or
+ *  zooming back and forth, doesn't need to render them again.
+ */
+
+typedef struct _RenderLevel RenderLevel;
+typedef struct _RenderTile  RenderTile;
+
+struct _RenderLevel
+{
+  gdouble         scale_x;
+  gdouble         scale_y;
+  gint            render_scale;
+  gboolean        show_all;
+
+  GHashTable     *tiles;
+  cairo_region_t *valid;
+};
+
+struct _RenderTile
+{
+  gint             x;
+  gint             y;
+
+  cairo_surface_t *surface;
+  gint64           last_used;
+};
+
+
+static RenderLevel * gimp_display_shell_render_get_level    (GimpDisplayShell *shell,
+                                                             gboolean          create);
+static void          gimp_display_shell_render_level_free   (RenderLevel      *level);
+static gboolean      gimp_display_shell_render_fetch_level  (GimpDisplayShell *shell,
+                                                             gint              x,
+                                                             gint              y,
+                                                             gint              width,
+                                                             gint              height);
+static void          gimp_display_shell_render_store_level  (GimpDisplayShell *shell,
+                                                             gint              x,
+                                                             gint              y,
+                                                             gint              width,
+                                                             gint              height);
+static void          gimp_display_shell_render_trim_levels  (GimpDisplayShell *shell);
+
+static guint         render_tile_hash                       (const RenderTile *tile);
+static gboolean      render_tile_equal                      (const RenderTile *tile1,
+                                                             const RenderTile *tile2);
+static void          render_tile_free                       (RenderTile       *tile);
+
+
+/*  public functions  */
 
 void
 gimp_display_shell_render_set_scale (GimpDisplayShell *shell,
@@ -57,7 +120,7 @@ gimp_display_shell_render_set_scale (GimpDisplayShell *shell,
     {
       shell->render_scale = scale;
 
-      gimp_display_shell_render_invalidate_full (shell);
+      gimp_display_shell_render_invalidate_view (shell);
     }
 #endif
 }
@@ -68,6 +131,23 @@ gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
 
   g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
+
+  g_list_free_full (shell->render_levels,
+                    (GDestroyNotify) gimp_display_shell_render_level_free);
+  shell->render_levels      = NULL;
+  shell->render_levels_size = 0;
+}
+
+/*  like gimp_display_shell_render_invalidate_full(), but only for changes
+ *  of the view, not of what is rendered, so that the tiles cached per
+ *  zoom level stay valid
+ */
+void
+gimp_display_shell_render_invalidate_view (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
 }
 
 void
@@ -92,6 +172,43 @@ gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
     }
 }
 
+/*  invalidates the tiles cached per zoom level which show the given area,
+ *  in image coordinates
+ */
+void
+gimp_display_shell_render_invalidate_image (GimpDisplayShell *shell,
+                                            gint              x,
+                                            gint              y,
+                                            gint              width,
+                                            gint              height)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  for (list = shell->render_levels; list; list = g_list_next (list))
+    {
+      RenderLevel           *level = list->data;
+      cairo_rectangle_int_t  rect;
+      gint                   x1, y1, x2, y2;
+
+      /*  also accommodate for spill introduced by box filtering, like
+       *  gimp_display_paint_area() does
+       */
+      x1 = floor (x            * level->scale_x - 1.0) * level->render_scale;
+      y1 = floor (y            * level->scale_y - 1.0) * level->render_scale;
+      x2 = ceil  ((x + width)  * level->scale_x + 1.0) * level->render_scale;
+      y2 = ceil  ((y + height) * level->scale_y + 1.0) * level->render_scale;
+
+      rect.x      = x1;
+      rect.y      = y1;
+      rect.width  = x2 - x1;
+      rect.height = y2 - y1;
+
+      cairo_region_subtract_rectangle (level->valid, &rect);
+    }
+}
+
 void
 gimp_display_shell_render_validate_area (GimpDisplayShell *shell,
                                          gint              x,
@@ -192,6 +309,29 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   twidth  *= shell->render_scale;
   theight *= shell->render_scale;
 
+  if (! shell->render_cache)
+    {
+      shell->render_cache = cairo_surface_create_similar_image (
+        cairo_get_target (cr),
+        CAIRO_FORMAT_ARGB32,
+        shell->disp_width  * shell->render_scale,
+        shell->disp_height * shell->render_scale);
+    }
+
+  if (! shell->render_cache_valid)
+    {
+      shell->render_cache_valid = cairo_region_create ();
+    }
+
+  /*  if we rendered the chunk at this zoom level before, just copy it
+   *  to the render cache
+   */
+  if (gimp_display_shell_render_fetch_level (shell,
+                                             tx, ty, twidth, theight))
+    {
+      return;
+    }
+
   display_config = shell->display->config;
 
   if (shell->show_all)
@@ -224,20 +364,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
   cairo_surface_flush (shell->render_surface);
 
-  if (! shell->render_cache)
-    {
-      shell->render_cache = cairo_surface_create_similar_image (
-        cairo_get_target (cr),
-        CAIRO_FORMAT_ARGB32,
-        shell->disp_width  * shell->render_scale,
-        shell->disp_height * shell->render_scale);
-    }
-
-  if (! shell->render_cache_valid)
-    {
-      shell->render_cache_valid = cairo_region_create ();
-    }
-
   my_cr = cairo_create (shell->render_cache);
 
   /* clip to chunk bounds, in screen space */
@@ -519,4 +645,335 @@ gimp_display_shell_render (GimpDisplayShell *shell,
     }
 
   cairo_destroy (my_cr);
+
+  gimp_display_shell_render_store_level (shell, tx, ty, twidth, theight);
+}
+
+
+/*  private functions  */
+
+static RenderLevel *
+gimp_display_shell_render_get_level (GimpDisplayShell *shell,
+                                     gboolean          create)
+{
+  RenderLevel *level;
+  GList       *list;
+
+  /*  the tiles are only reusable if the view is a plain translation of
+   *  them, and if we didn't draw anything on top of the image
+   */
+  if (shell->rotate_transform || shell->mask)
+    return NULL;
+
+  for (list = shell->render_levels; list; list = g_list_next (list))
+    {
+      level = list->data;
+
+      if (level->scale_x      == shell->scale_x      &&
+          level->scale_y      == shell->scale_y      &&
+          level->render_scale == shell->render_scale &&
+          level->show_all     == shell->show_all)
+        {
+          /*  keep the list in most recently used order  */
+          shell->render_levels = g_list_remove_link (shell->render_levels,
+                                                     list);
+          shell->render_levels = g_list_concat (list, shell->render_levels);
+
+          return level;
+        }
+    }
+
+  if (! create)
+    return NULL;
+
+  level = g_slice_new0 (RenderLevel);
+
+  level->scale_x      = shell->scale_x;
+  level->scale_y      = shell->scale_y;
+  level->render_scale = shell->render_scale;
+  level->show_all     = shell->show_all;
+
+  level->tiles = g_hash_table_new_full ((GHashFunc) render_tile_hash,
+                                        (GEqualFunc) render_tile_equal,
+                                        (GDestroyNotify) render_tile_free,
+                                        NULL);
+  level->valid = cairo_region_create ();
+
+  shell->render_levels = g_list_prepend (shell->render_levels, level);
+
+  return level;
+}
+
+static void
+gimp_display_shell_render_level_free (RenderLevel *level)
+{
+  g_hash_table_unref (level->tiles);
+  cairo_region_destroy (level->valid);
+
+  g_slice_free (RenderLevel, level);
+}
+
+static gboolean
+gimp_display_shell_render_fetch_level (GimpDisplayShell *shell,
+                                       gint              x,
+                                       gint              y,
+                                       gint              width,
+                                       gint              height)
+{
+  RenderLevel           *level;
+  cairo_rectangle_int_t  rect;
+  cairo_t               *cr;
+  gint                   offset_x;
+  gint                   offset_y;
+  gint                   tile_x;
+  gint                   tile_y;
+  gint64                 now;
+
+  level = gimp_display_shell_render_get_level (shell, FALSE);
+
+  if (! level)
+    return FALSE;
+
+  /*  from render cache to level coordinates  */
+  offset_x = shell->offset_x * shell->render_scale;
+  offset_y = shell->offset_y * shell->render_scale;
+
+  rect.x      = x + offset_x;
+  rect.y      = y + offset_y;
+  rect.width  = width;
+  rect.height = height;
+
+  if (cairo_region_contains_rectangle (level->valid, &rect) !=
+      CAIRO_REGION_OVERLAP_IN)
+    {
+      return FALSE;
+    }
+
+  now = g_get_monotonic_time ();
+
+  cr = cairo_create (shell->render_cache);
+
+  cairo_rectangle (cr, x, y, width, height);
+  cairo_clip (cr);
+
+  cairo_translate (cr, -offset_x, -offset_y);
+
+  /*  SOURCE so the destination's alpha is replaced  */
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+  for (tile_y = RENDER_TILE_ORIGIN (rect.y);
+       tile_y < rect.y + rect.height;
+       tile_y += GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE)
+    {
+      for (tile_x = RENDER_TILE_ORIGIN (rect.x);
+           tile_x < rect.x + rect.width;
+           tile_x += GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE)
+        {
+          RenderTile  key = { tile_x, tile_y, };
+          RenderTile *tile;
+
+          tile = g_hash_table_lookup (level->tiles, &key);
+
+          /*  can't happen, the valid area is always covered by tiles  */
+          if (! tile)
+            continue;
+
+          tile->last_used = now;
+
+          cairo_save (cr);
+
+          cairo_rectangle (cr,
+                           tile->x, tile->y,
+                           GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE,
+                           GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE);
+          cairo_clip (cr);
+
+          cairo_set_source_surface (cr, tile->surface, tile->x, tile->y);
+          cairo_paint (cr);
+
+          cairo_restore (cr);
+        }
+    }
+
+  cairo_destroy (cr);
+
+  return TRUE;
+}
+
+static void
+gimp_display_shell_render_store_level (GimpDisplayShell *shell,
+                                       gint              x,
+                                       gint              y,
+                                       gint              width,
+                                       gint              height)
+{
+  RenderLevel           *level;
+  cairo_rectangle_int_t  rect;
+  gint                   offset_x;
+  gint                   offset_y;
+  gint                   tile_x;
+  gint                   tile_y;
+  gint64                 now;
+
+  level = gimp_display_shell_render_get_level (shell, TRUE);
+
+  if (! level)
+    return;
+
+  if (! gimp_rectangle_intersect (x, y, width, height,
+                                  0, 0,
+                                  shell->disp_width  * shell->render_scale,
+                                  shell->disp_height * shell->render_scale,
+                                  &x, &y, &width, &height))
+    {
+      return;
+    }
+
+  /*  from render cache to level coordinates  */
+  offset_x = shell->offset_x * shell->render_scale;
+  offset_y = shell->offset_y * shell->render_scale;
+
+  rect.x      = x + offset_x;
+  rect.y      = y + offset_y;
+  rect.width  = width;
+  rect.height = height;
+
+  now = g_get_monotonic_time ();
+
+  cairo_surface_flush (shell->render_cache);
+
+  for (tile_y = RENDER_TILE_ORIGIN (rect.y);
+       tile_y < rect.y + rect.height;
+       tile_y += GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE)
+    {
+      for (tile_x = RENDER_TILE_ORIGIN (rect.x);
+           tile_x < rect.x + rect.width;
+           tile_x += GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE)
+        {
+          RenderTile  key = { tile_x, tile_y, };
+          RenderTile *tile;
+          cairo_t    *cr;
+
+          tile = g_hash_table_lookup (level->tiles, &key);
+
+          if (! tile)
+            {
+              tile = g_slice_new0 (RenderTile);
+
+              tile->x       = tile_x;
+              tile->y       = tile_y;
+              tile->surface = cairo_surface_create_similar_image (
+                shell->render_cache,
+                CAIRO_FORMAT_ARGB32,
+                GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE,
+                GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE);
+
+              g_hash_table_add (level->tiles, tile);
+
+              shell->render_levels_size +=
+                cairo_image_surface_get_stride (tile->surface) *
+                GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE;
+            }
+
+          tile->last_used = now;
+
+          cr = cairo_create (tile->surface);
+
+          cairo_rectangle (cr,
+                           rect.x - tile->x, rect.y - tile->y,
+                           rect.width, rect.height);
+          cairo_clip (cr);
+
+          cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+          cairo_set_source_surface (cr, shell->render_cache,
+                                    offset_x - tile->x,
+                                    offset_y - tile->y);
+          cairo_paint (cr);
+
+          cairo_destroy (cr);
+        }
+    }
+
+  cairo_region_union_rectangle (level->valid, &rect);
+
+  gimp_display_shell_render_trim_levels (shell);
+}
+
+/*  drops the least recently used tiles, of any zoom level, until the
+ *  levels fit in their budget again
+ */
+static void
+gimp_display_shell_render_trim_levels (GimpDisplayShell *shell)
+{
+  while (shell->render_levels_size > GIMP_DISPLAY_RENDER_LEVELS_MAX_SIZE)
+    {
+      RenderLevel           *oldest_level = NULL;
+      RenderTile            *oldest_tile  = NULL;
+      cairo_rectangle_int_t  rect;
+      GList                 *list;
+
+      for (list = shell->render_levels; list; list = g_list_next (list))
+        {
+          RenderLevel    *level = list->data;
+          GHashTableIter  iter;
+          RenderTile     *tile;
+
+          g_hash_table_iter_init (&iter, level->tiles);
+
+          while (g_hash_table_iter_next (&iter, (gpointer *) &tile, NULL))
+            {
+              if (! oldest_tile || tile->last_used < oldest_tile->last_used)
+                {
+                  oldest_level = level;
+                  oldest_tile  = tile;
+                }
+            }
+        }
+
+      if (! oldest_tile)
+        break;
+
+      rect.x      = oldest_tile->x;
+      rect.y      = oldest_tile->y;
+      rect.width  = GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE;
+      rect.height = GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE;
+
+      cairo_region_subtract_rectangle (oldest_level->valid, &rect);
+
+      shell->render_levels_size -=
+        cairo_image_surface_get_stride (oldest_tile->surface) *
+        GIMP_DISPLAY_RENDER_LEVEL_TILE_SIZE;
+
+      g_hash_table_remove (oldest_level->tiles, oldest_tile);
+
+      if (g_hash_table_size (oldest_level->tiles) == 0)
+        {
+          shell->render_levels = g_list_remove (shell->render_levels,
+                                                oldest_level);
+
+          gimp_display_shell_render_level_free (oldest_level);
+        }
+    }
+}
+
+static guint
+render_tile_hash (const RenderTile *tile)
+{
+  return (guint) tile->x * 7919u + (guint) tile->y;
+}
+
+static gboolean
+render_tile_equal (const RenderTile *tile1,
+                   const RenderTile *tile2)
+{
+  return tile1->x == tile2->x && tile1->y == tile2->y;
+}
+
+static void
+render_tile_free (RenderTile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+
+  g_slice_free (RenderTile, tile);
 }
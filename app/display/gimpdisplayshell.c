@@ -757,8 +757,9 @@ gimp_display_shell_dispose (GObject *object)
       shell->filter_idle_id = 0;
     }
 
-  g_clear_pointer (&shell->render_cache,       cairo_surface_destroy);
-  g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
+  gimp_display_shell_render_invalidate_full (shell);
+
+  g_clear_pointer (&shell->render_cache, cairo_surface_destroy);
 
   g_clear_pointer (&shell->render_surface, cairo_surface_destroy);
   g_clear_pointer (&shell->mask_surface,   cairo_surface_destroy);
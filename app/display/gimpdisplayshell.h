@@ -176,6 +176,9 @@ struct _GimpDisplayShell
   cairo_surface_t   *render_cache;
   cairo_region_t    *render_cache_valid;
 
+  GList             *render_levels;    /*  render cache tiles per zoom level  */
+  gsize              render_levels_size;
+
   gint               render_buf_width;
   gint               render_buf_height;
 
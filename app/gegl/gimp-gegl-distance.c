@@ -0,0 +1,422 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-distance.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "gimp-gegl-types.h"
+
+#include "gimp-gegl-distance.h"
+
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+/*  number of pixels read or written at once by each thread  */
+#define STRIP_SIZE    (64 * 1024)
+
+/*  vertical distance meaning "no feature pixel in the column", and also
+ *  used for distances too large to be stored
+ */
+#define DISTANCE_NONE G_MAXUINT16
+
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  const GeglRectangle *src_rect;
+  gfloat               threshold;
+  gboolean             invert;
+  gboolean             outside;
+  const gdouble       *cost_x;
+  gint                 n_cost_x;
+  const gdouble       *cost_y;
+  gint                 n_cost_y;
+  GimpDistanceMapFunc  map_func;
+  gpointer             map_data;
+  GeglBuffer          *dest_buffer;
+  const GeglRectangle *dest_rect;
+
+  /*  for each pixel, the vertical distance to the nearest feature pixel
+   *  in its column
+   */
+  guint16             *distance_y;
+} DistanceData;
+
+
+/*  local function prototypes  */
+
+static void   gimp_gegl_distance_columns (gsize         offset,
+                                          gsize         size,
+                                          DistanceData *data);
+static void   gimp_gegl_distance_rows    (gsize         offset,
+                                          gsize         size,
+                                          DistanceData *data);
+
+
+/*  public functions  */
+
+void
+gimp_gegl_distance_transform (GeglBuffer          *src_buffer,
+                              const GeglRectangle *src_rect,
+                              gfloat               threshold,
+                              gboolean             invert,
+                              gboolean             outside,
+                              const gdouble       *cost_x,
+                              gint                 n_cost_x,
+                              const gdouble       *cost_y,
+                              gint                 n_cost_y,
+                              GimpDistanceMapFunc  map_func,
+                              gpointer             map_data,
+                              GeglBuffer          *dest_buffer,
+                              const GeglRectangle *dest_rect)
+{
+  DistanceData data;
+
+  g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
+  g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
+  g_return_if_fail (cost_x != NULL && n_cost_x >= 2);
+  g_return_if_fail (cost_y != NULL && n_cost_y >= 2);
+
+  if (! src_rect)
+    src_rect = gegl_buffer_get_extent (src_buffer);
+
+  if (! dest_rect)
+    dest_rect = gegl_buffer_get_extent (dest_buffer);
+
+  g_return_if_fail (src_rect->width  == dest_rect->width &&
+                    src_rect->height == dest_rect->height);
+
+  if (gegl_rectangle_is_empty (src_rect))
+    return;
+
+  data.src_buffer  = src_buffer;
+  data.src_rect    = src_rect;
+  data.threshold   = threshold;
+  data.invert      = invert;
+  data.outside     = outside;
+  data.cost_x      = cost_x;
+  data.n_cost_x    = n_cost_x;
+  data.cost_y      = cost_y;
+  data.n_cost_y    = n_cost_y;
+  data.map_func    = map_func;
+  data.map_data    = map_data;
+  data.dest_buffer = dest_buffer;
+  data.dest_rect   = dest_rect;
+
+  data.distance_y  = g_new (guint16,
+                            (gsize) src_rect->width * src_rect->height);
+
+  /*  first, the distances along the columns, in bands of columns ...  */
+  gegl_parallel_distribute_range (
+    src_rect->width, PIXELS_PER_THREAD / src_rect->height,
+    (GeglParallelDistributeRangeFunc) gimp_gegl_distance_columns,
+    &data);
+
+  /*  ... then, from them, the distances along the rows, in bands of rows  */
+  gegl_parallel_distribute_range (
+    src_rect->height, PIXELS_PER_THREAD / src_rect->width,
+    (GeglParallelDistributeRangeFunc) gimp_gegl_distance_rows,
+    &data);
+
+  g_free (data.distance_y);
+}
+
+void
+gimp_gegl_distance_ellipse_costs (gdouble *cost,
+                                  gint     n_cost,
+                                  gdouble  radius)
+{
+  gint d;
+
+  g_return_if_fail (cost != NULL);
+  g_return_if_fail (radius > 0.0);
+
+  for (d = 0; d < n_cost; d++)
+    {
+      gdouble t = MAX (d - 0.5, 0.0);
+
+      cost[d] = SQR (t) / SQR (radius);
+    }
+}
+
+
+/*  private functions  */
+
+static inline gdouble
+gimp_gegl_distance_cost (const gdouble *cost,
+                         gint           n_cost,
+                         gint           d)
+{
+  if (d < n_cost)
+    return cost[d];
+
+  /*  keep going at the last step's slope, so the costs stay convex  */
+  return cost[n_cost - 1] +
+         (d - (n_cost - 1)) * (cost[n_cost - 1] - cost[n_cost - 2]);
+}
+
+static void
+gimp_gegl_distance_columns (gsize         offset,
+                            gsize         size,
+                            DistanceData *data)
+{
+  const GeglRectangle *rect   = data->src_rect;
+  const Babl          *format = babl_format ("Y float");
+  gint                 x1     = offset;
+  gint                 x2     = offset + size;
+  gint                 n_rows = MAX (STRIP_SIZE / (gint) size, 1);
+  gfloat              *strip;
+  gint                 x, y;
+
+  strip = g_new (gfloat, size * n_rows);
+
+  /*  top to bottom, the distance to the nearest feature pixel above  */
+  for (y = 0; y < rect->height; y += n_rows)
+    {
+      gint height = MIN (n_rows, rect->height - y);
+      gint row;
+
+      gegl_buffer_get (data->src_buffer,
+                       GEGL_RECTANGLE (rect->x + x1, rect->y + y,
+                                       size, height),
+                       1.0, format, strip,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (row = 0; row < height; row++)
+        {
+          const gfloat  *src  = strip + row * size - x1;
+          guint16       *dist = data->distance_y +
+                                (gsize) (y + row) * rect->width;
+          const guint16 *above;
+
+          if (y + row == 0)
+            {
+              for (x = x1; x < x2; x++)
+                {
+                  if ((src[x] >= data->threshold) != data->invert)
+                    dist[x] = 0;
+                  else
+                    dist[x] = data->outside ? 1 : DISTANCE_NONE;
+                }
+
+              continue;
+            }
+
+          above = dist - rect->width;
+
+          for (x = x1; x < x2; x++)
+            {
+              if ((src[x] >= data->threshold) != data->invert)
+                dist[x] = 0;
+              else if (above[x] < DISTANCE_NONE)
+                dist[x] = above[x] + 1;
+              else
+                dist[x] = DISTANCE_NONE;
+            }
+        }
+    }
+
+  g_free (strip);
+
+  /*  bottom to top, the distance to the nearest feature pixel above or
+   *  below
+   */
+  for (y = rect->height - 1; y >= 0; y--)
+    {
+      guint16       *dist = data->distance_y + (gsize) y * rect->width;
+      const guint16 *below;
+
+      if (y == rect->height - 1)
+        {
+          if (data->outside)
+            {
+              for (x = x1; x < x2; x++)
+                dist[x] = MIN (dist[x], 1);
+            }
+
+          continue;
+        }
+
+      below = dist + rect->width;
+
+      for (x = x1; x < x2; x++)
+        {
+          if (below[x] < dist[x])
+            dist[x] = below[x] + 1;
+        }
+    }
+}
+
+/*  the cost of reaching column 'x' from the nearest feature pixel of
+ *  column 'q', whose vertical cost is 'cost_q'
+ */
+#define COST(q, cost_q, x) \
+  ((cost_q) + gimp_gegl_distance_cost (data->cost_x, data->n_cost_x, \
+                                       ABS ((x) - (q))))
+
+static void
+gimp_gegl_distance_rows (gsize         offset,
+                         gsize         size,
+                         DistanceData *data)
+{
+  const GeglRectangle *rect   = data->src_rect;
+  const Babl          *format = babl_format ("Y float");
+  gint                 width  = rect->width;
+  gint                 n_rows = MAX (STRIP_SIZE / width, 1);
+  gint                 q_min  = data->outside ? -1    : 0;
+  gint                 q_max  = data->outside ? width : width - 1;
+  gint                *v;       /*  the columns making up the envelope     */
+  gdouble             *v_cost;  /*  ... their vertical costs               */
+  gint                *z;       /*  ... and the first pixel each one wins  */
+  gfloat              *strip;
+  gint                 y;
+
+  v      = g_new (gint,    width + 2);
+  v_cost = g_new (gdouble, width + 2);
+  z      = g_new (gint,    width + 2);
+  strip  = g_new (gfloat,  (gsize) width * n_rows);
+
+  for (y = offset; y < offset + size; y += n_rows)
+    {
+      gint height = MIN (n_rows, offset + size - y);
+      gint row;
+
+      for (row = 0; row < height; row++)
+        {
+          const guint16 *dist = data->distance_y +
+                                (gsize) (y + row) * width;
+          gfloat        *out  = strip + row * width;
+          gint           k    = -1;
+          gint           q;
+          gint           x;
+
+          /*  find the lower envelope of the costs of reaching each pixel
+           *  of the row from each column.  since the horizontal costs are
+           *  convex, the cost from a column further right, once lower than
+           *  from one further left, stays lower, so each column wins one
+           *  interval of the row at most.
+           */
+          for (q = q_min; q <= q_max; q++)
+            {
+              gdouble cost_q;
+              gint    s = 0;
+
+              if (q < 0 || q >= width)
+                {
+                  /*  the columns outside are all feature pixels  */
+                  cost_q = data->cost_y[0];
+                }
+              else if (dist[q] == DISTANCE_NONE)
+                {
+                  continue;
+                }
+              else
+                {
+                  cost_q = gimp_gegl_distance_cost (data->cost_y,
+                                                    data->n_cost_y,
+                                                    dist[q]);
+                }
+
+              while (k >= 0)
+                {
+                  gint lo = z[k];
+                  gint hi = width;
+
+                  /*  find the first pixel where 'q' beats the envelope's
+                   *  last column
+                   */
+                  while (lo < hi)
+                    {
+                      gint mid = lo + (hi - lo) / 2;
+
+                      if (COST (q, cost_q, mid) <= COST (v[k], v_cost[k], mid))
+                        hi = mid;
+                      else
+                        lo = mid + 1;
+                    }
+
+                  s = lo;
+
+                  if (s > z[k])
+                    break;
+
+                  /*  'q' beats it everywhere it won, drop it  */
+                  k--;
+                  s = 0;
+                }
+
+              if (s < width)
+                {
+                  k++;
+
+                  v[k]      = q;
+                  v_cost[k] = cost_q;
+                  z[k]      = s;
+                }
+            }
+
+          if (k < 0)
+            {
+              gfloat value = G_MAXFLOAT;
+
+              if (data->map_func)
+                value = data->map_func (G_MAXDOUBLE, data->map_data);
+
+              for (x = 0; x < width; x++)
+                out[x] = value;
+            }
+          else
+            {
+              gint j = 0;
+
+              for (x = 0; x < width; x++)
+                {
+                  gdouble cost;
+
+                  while (j < k && z[j + 1] <= x)
+                    j++;
+
+                  cost = COST (v[j], v_cost[j], x);
+
+                  if (data->map_func)
+                    out[x] = data->map_func (cost, data->map_data);
+                  else
+                    out[x] = MIN (cost, G_MAXFLOAT);
+                }
+            }
+        }
+
+      gegl_buffer_set (data->dest_buffer,
+                       GEGL_RECTANGLE (data->dest_rect->x,
+                                       data->dest_rect->y + y,
+                                       width, height),
+                       0, format, strip, GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (v);
+  g_free (v_cost);
+  g_free (z);
+  g_free (strip);
+}
+
+#undef COST
@@ -0,0 +1,71 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-distance.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_GEGL_DISTANCE_H__
+#define __GIMP_GEGL_DISTANCE_H__
+
+
+/*  maps the distance of a pixel to the nearest feature pixel, as the
+ *  sum of the costs of its horizontal and vertical offsets, to the
+ *  pixel's output value.  'cost' is G_MAXDOUBLE if there is no feature
+ *  pixel in reach.
+ */
+typedef gfloat (* GimpDistanceMapFunc) (gdouble  cost,
+                                        gpointer user_data);
+
+
+/*  a separable distance transform, in the manner of Felzenszwalb and
+ *  Meijster: the feature pixels of 'src_buffer' are the ones at or above
+ *  'threshold' (below it, if 'invert' is TRUE), and all the pixels
+ *  outside of 'src_rect' if 'outside' is TRUE.  'cost_x' and 'cost_y'
+ *  give the cost of an offset of 0, 1, 2, ... pixels along each axis,
+ *  and must be nondecreasing; 'cost_x' must also be convex.  costs of
+ *  offsets past the end of the tables are extrapolated linearly.
+ *
+ *  with 'cost_x' and 'cost_y' both being d^2, this is the exact squared
+ *  euclidean distance transform.  its time doesn't depend on how far the
+ *  tables reach, and the columns, then the rows, are processed in
+ *  parallel.
+ */
+void       gimp_gegl_distance_transform (GeglBuffer          *src_buffer,
+                                         const GeglRectangle *src_rect,
+                                         gfloat               threshold,
+                                         gboolean             invert,
+                                         gboolean             outside,
+                                         const gdouble       *cost_x,
+                                         gint                 n_cost_x,
+                                         const gdouble       *cost_y,
+                                         gint                 n_cost_y,
+                                         GimpDistanceMapFunc  map_func,
+                                         gpointer             map_data,
+                                         GeglBuffer          *dest_buffer,
+                                         const GeglRectangle *dest_rect);
+
+/*  fills 'cost' with the costs of offsets of 0 to 'n_cost' - 1 pixels
+ *  along an axis of an ellipse with the given radius, which are less than
+ *  1.0 for the offsets within the ellipse.  an offset of 'd' pixels is
+ *  measured between the near edges of the pixels, as d - 0.5.
+ */
+void       gimp_gegl_distance_ellipse_costs
+                                        (gdouble             *cost,
+                                         gint                 n_cost,
+                                         gdouble              radius);
+
+
+#endif /* __GIMP_GEGL_DISTANCE_H__ */
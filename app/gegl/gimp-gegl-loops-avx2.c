@@ -0,0 +1,421 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-loops-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "gimp-gegl-types.h"
+
+#include "gimp-gegl-loops-avx2.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 */
+#include <immintrin.h>
+
+
+/* the alpha components of a pair of RGBA pixels */
+#define ALPHA_MASK 0x88
+
+
+/*  the functions in this file evaluate the same expressions, in the same
+ *  order and at the same precision, as the generic code in
+ *  gimp-gegl-loops.cc, so that their results are bit-identical.
+ *
+ *  the per-pixel functions process two RGBA pixels per 256-bit vector, and
+ *  use masked loads and stores for a trailing odd pixel.  the convolution
+ *  works on one pixel at a time, accumulating its four components in
+ *  double precision, like the generic code.
+ */
+
+
+/*  local function prototypes  */
+
+static inline __m256i   get_tail_mask      (void);
+static inline __m256d   convolve_tap       (__m256d       total,
+                                            const gfloat *s,
+                                            gfloat        m,
+                                            gboolean      alpha_weighting);
+static inline __m256    smudge_blend       (__m256        src1,
+                                            __m256        src1_rate,
+                                            __m256        src2,
+                                            __m256        src2_rate,
+                                            gboolean      no_erasing_src2);
+
+
+/*  private functions  */
+
+
+/* returns a mask selecting the first pixel of a pair */
+static inline __m256i
+get_tail_mask (void)
+{
+  return _mm256_setr_epi32 (-1, -1, -1, -1, 0, 0, 0, 0);
+}
+
+/* adds a single kernel tap to the totals of gimp_gegl_convolve() */
+static inline __m256d
+convolve_tap (__m256d       total,
+              const gfloat *s,
+              gfloat        m,
+              gboolean      alpha_weighting)
+{
+  if (alpha_weighting)
+    {
+      const gfloat a = s[3];
+
+      if (a)
+        {
+          const __m256d mult_alpha = _mm256_set1_pd (m * a);
+          __m256d       v;
+
+          /* the alpha total is the sum of the weights, which also serves
+           * as the weighted divisor
+           */
+          v = _mm256_cvtps_pd (_mm_loadu_ps (s));
+          v = _mm256_blend_pd (v, _mm256_set1_pd (1.0), 0x8);
+
+          total = _mm256_add_pd (total, _mm256_mul_pd (mult_alpha, v));
+        }
+    }
+  else
+    {
+      const __m128 v = _mm_mul_ps (_mm_set1_ps (m), _mm_loadu_ps (s));
+
+      total = _mm256_add_pd (total, _mm256_cvtps_pd (v));
+    }
+
+  return total;
+}
+
+/* blends a pair of pixels of src1 and src2, see
+ * gimp_gegl_smudge_with_paint_blend()
+ */
+static inline __m256
+smudge_blend (__m256   src1,
+              __m256   src1_rate,
+              __m256   src2,
+              __m256   src2_rate,
+              gboolean no_erasing_src2)
+{
+  const __m256 orginal_src2_alpha = _mm256_permute_ps (src2,
+                                                       _MM_SHUFFLE (3, 3, 3, 3));
+  __m256       src1_alpha;
+  __m256       src2_alpha;
+  __m256       result_alpha;
+  __m256       nonzero;
+  __m256       result;
+
+  src1_alpha   = _mm256_mul_ps (src1_rate,
+                                _mm256_permute_ps (src1,
+                                                   _MM_SHUFFLE (3, 3, 3, 3)));
+  src2_alpha   = _mm256_mul_ps (src2_rate, orginal_src2_alpha);
+  result_alpha = _mm256_add_ps (src1_alpha, src2_alpha);
+
+  nonzero = _mm256_cmp_ps (result_alpha, _mm256_setzero_ps (), _CMP_NEQ_UQ);
+
+  result = _mm256_div_ps (_mm256_add_ps (_mm256_mul_ps (src1, src1_alpha),
+                                         _mm256_mul_ps (src2, src2_alpha)),
+                          result_alpha);
+
+  if (no_erasing_src2)
+    result_alpha = _mm256_max_ps (result_alpha, orginal_src2_alpha);
+
+  result = _mm256_blend_ps (result, result_alpha, ALPHA_MASK);
+
+  return _mm256_and_ps (result, nonzero);
+}
+
+
+/*  public functions  */
+
+
+/* convolves the RGBA pixels [x, x + width) of row y of src, see
+ * gimp_gegl_convolve()
+ */
+void
+gimp_gegl_convolve_row_avx2 (const gfloat *src,
+                             gint          src_rowstride,
+                             gint          src_width,
+                             gint          src_height,
+                             gfloat       *dest,
+                             gint          x,
+                             gint          y,
+                             gint          width,
+                             const gfloat *kernel,
+                             gint          kernel_size,
+                             gdouble       divisor,
+                             gdouble       offset,
+                             gboolean      absolute,
+                             gboolean      alpha_weighting)
+{
+  const gint    margin   = kernel_size / 2;
+  const gint    x2       = src_width  - 1;
+  const gint    y2       = src_height - 1;
+  const gint    x_end    = x + width;
+  const __m256d v_zero   = _mm256_setzero_pd ();
+  const __m256d v_one    = _mm256_set1_pd (1.0);
+  const __m256d v_offset = _mm256_set1_pd (offset);
+  const __m256d v_sign   = _mm256_set1_pd (-0.0);
+
+  for (; x < x_end; x++, dest += 4)
+    {
+      const gfloat   *m      = kernel;
+      const gboolean  inside = x - margin >= 0 && x + margin <= x2;
+      __m256d         total  = v_zero;
+      gint            i, j;
+
+      for (j = y - margin; j <= y + margin; j++)
+        {
+          const gfloat *row = src + CLAMP (j, 0, y2) * src_rowstride;
+
+          if (inside)
+            {
+              const gfloat *s = row + (x - margin) * 4;
+
+              for (i = x - margin; i <= x + margin; i++, m++, s += 4)
+                total = convolve_tap (total, s, *m, alpha_weighting);
+            }
+          else
+            {
+              for (i = x - margin; i <= x + margin; i++, m++)
+                {
+                  const gfloat *s = row + CLAMP (i, 0, x2) * 4;
+
+                  total = convolve_tap (total, s, *m, alpha_weighting);
+                }
+            }
+        }
+
+      if (alpha_weighting)
+        {
+          gdouble weighted_divisor;
+
+          weighted_divisor =
+            _mm256_cvtsd_f64 (_mm256_permute4x64_pd (total,
+                                                     _MM_SHUFFLE (3, 3, 3, 3)));
+
+          if (weighted_divisor == 0.0)
+            weighted_divisor = divisor;
+
+          total = _mm256_div_pd (total,
+                                 _mm256_setr_pd (weighted_divisor,
+                                                 weighted_divisor,
+                                                 weighted_divisor,
+                                                 divisor));
+        }
+      else
+        {
+          total = _mm256_div_pd (total, _mm256_set1_pd (divisor));
+        }
+
+      total = _mm256_add_pd (total, v_offset);
+
+      if (absolute)
+        {
+          total = _mm256_blendv_pd (total,
+                                    _mm256_xor_pd (total, v_sign),
+                                    _mm256_cmp_pd (total, v_zero, _CMP_LT_OQ));
+        }
+
+      /* the operand order makes NaNs pass through, like CLAMP() */
+      total = _mm256_min_pd (v_one, _mm256_max_pd (v_zero, total));
+
+      _mm_storeu_ps (dest, _mm256_cvtpd_ps (total));
+    }
+}
+
+/* the GIMP_TRANSFER_HIGHLIGHTS case of gimp_gegl_dodgeburn() */
+void
+gimp_gegl_dodgeburn_highlights_avx2 (const gfloat *src,
+                                     gfloat       *dest,
+                                     gint          count,
+                                     gfloat        factor)
+{
+  const __m256 v_factor = _mm256_set1_ps (factor);
+
+  for (; count >= 2; count -= 2, src += 8, dest += 8)
+    {
+      const __m256 s = _mm256_loadu_ps (src);
+
+      _mm256_storeu_ps (dest,
+                        _mm256_blend_ps (_mm256_mul_ps (s, v_factor),
+                                         s, ALPHA_MASK));
+    }
+
+  if (count)
+    {
+      const __m256i mask = get_tail_mask ();
+      const __m256  s    = _mm256_maskload_ps (src, mask);
+
+      _mm256_maskstore_ps (dest, mask,
+                           _mm256_blend_ps (_mm256_mul_ps (s, v_factor),
+                                            s, ALPHA_MASK));
+    }
+}
+
+/* the GIMP_TRANSFER_SHADOWS case of gimp_gegl_dodgeburn().  @dodge is
+ * whether the exposure is non-negative.
+ */
+void
+gimp_gegl_dodgeburn_shadows_avx2 (const gfloat *src,
+                                  gfloat       *dest,
+                                  gint          count,
+                                  gfloat        factor,
+                                  gboolean      dodge)
+{
+  const __m256  v_factor = _mm256_set1_ps (factor);
+  const __m256d v_denom  = _mm256_set1_pd (1.0 - factor);
+  const __m256i mask     = get_tail_mask ();
+
+  while (count > 0)
+    {
+      __m256 s;
+      __m256 d;
+
+      if (count >= 2)
+        s = _mm256_loadu_ps (src);
+      else
+        s = _mm256_maskload_ps (src, mask);
+
+      if (dodge)
+        {
+          d = _mm256_sub_ps (_mm256_add_ps (v_factor, s),
+                             _mm256_mul_ps (v_factor, s));
+        }
+      else
+        {
+          const __m256 diff = _mm256_sub_ps (s, v_factor);
+          __m128       lo;
+          __m128       hi;
+
+          /* the generic code divides in double precision */
+          lo = _mm256_cvtpd_ps (
+                 _mm256_div_pd (_mm256_cvtps_pd (_mm256_castps256_ps128 (diff)),
+                                v_denom));
+          hi = _mm256_cvtpd_ps (
+                 _mm256_div_pd (_mm256_cvtps_pd (_mm256_extractf128_ps (diff, 1)),
+                                v_denom));
+
+          d = _mm256_insertf128_ps (_mm256_castps128_ps256 (lo), hi, 1);
+          d = _mm256_andnot_ps (_mm256_cmp_ps (s, v_factor, _CMP_LT_OQ), d);
+        }
+
+      d = _mm256_blend_ps (d, s, ALPHA_MASK);
+
+      if (count >= 2)
+        _mm256_storeu_ps (dest, d);
+      else
+        _mm256_maskstore_ps (dest, mask, d);
+
+      count -= 2;
+      src   += 8;
+      dest  += 8;
+    }
+}
+
+/* helper function of gimp_gegl_smudge_with_paint() */
+void
+gimp_gegl_smudge_with_paint_process_avx2 (gfloat       *accum,
+                                          const gfloat *canvas,
+                                          gfloat       *paint,
+                                          gint          count,
+                                          const gfloat *brush_color,
+                                          gfloat        brush_a,
+                                          gboolean      no_erasing,
+                                          gfloat        flow,
+                                          gfloat        rate)
+{
+  const __m256  v_rate       = _mm256_set1_ps (rate);
+  const __m256  v_rate_inv   = _mm256_set1_ps (1 - rate);
+  const __m256  v_flow       = _mm256_set1_ps (flow);
+  const __m256  v_flow_inv   = _mm256_set1_ps (1 - flow);
+  const __m256i mask         = get_tail_mask ();
+  __m256        v_brush      = _mm256_setzero_ps ();
+
+  if (brush_color)
+    {
+      const __m128 c = _mm_loadu_ps (brush_color);
+
+      v_brush = _mm256_insertf128_ps (_mm256_castps128_ps256 (c), c, 1);
+    }
+
+  while (count > 0)
+    {
+      const gboolean tail = count < 2;
+      __m256         a;
+      __m256         c;
+      __m256         p;
+
+      if (! tail)
+        {
+          a = _mm256_loadu_ps (accum);
+          c = _mm256_loadu_ps (canvas);
+        }
+      else
+        {
+          a = _mm256_maskload_ps (accum,  mask);
+          c = _mm256_maskload_ps (canvas, mask);
+        }
+
+      /* blend accum_buffer and canvas_buffer to accum_buffer */
+      a = smudge_blend (a, v_rate, c, v_rate_inv, no_erasing);
+
+      /* blend accum_buffer and brush color/pixmap to paint_buffer */
+      if (brush_a == 0) /* pure smudge */
+        {
+          p = a;
+        }
+      else
+        {
+          __m256 src1;
+
+          if (brush_color)
+            src1 = v_brush;
+          else if (! tail)
+            src1 = _mm256_loadu_ps (paint);
+          else
+            src1 = _mm256_maskload_ps (paint, mask);
+
+          p = smudge_blend (src1, v_flow, a, v_flow_inv, no_erasing);
+        }
+
+      if (! tail)
+        {
+          _mm256_storeu_ps (accum, a);
+          _mm256_storeu_ps (paint, p);
+        }
+      else
+        {
+          _mm256_maskstore_ps (accum, mask, a);
+          _mm256_maskstore_ps (paint, mask, p);
+        }
+
+      count  -= 2;
+      accum  += 8;
+      canvas += 8;
+      paint  += 8;
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
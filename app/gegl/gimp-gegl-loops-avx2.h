@@ -0,0 +1,64 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-loops-avx2.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_GEGL_LOOPS_AVX2_H__
+#define __GIMP_GEGL_LOOPS_AVX2_H__
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+void   gimp_gegl_convolve_row_avx2               (const gfloat *src,
+                                                  gint          src_rowstride,
+                                                  gint          src_width,
+                                                  gint          src_height,
+                                                  gfloat       *dest,
+                                                  gint          x,
+                                                  gint          y,
+                                                  gint          width,
+                                                  const gfloat *kernel,
+                                                  gint          kernel_size,
+                                                  gdouble       divisor,
+                                                  gdouble       offset,
+                                                  gboolean      absolute,
+                                                  gboolean      alpha_weighting);
+
+void   gimp_gegl_dodgeburn_highlights_avx2       (const gfloat *src,
+                                                  gfloat       *dest,
+                                                  gint          count,
+                                                  gfloat        factor);
+void   gimp_gegl_dodgeburn_shadows_avx2          (const gfloat *src,
+                                                  gfloat       *dest,
+                                                  gint          count,
+                                                  gfloat        factor,
+                                                  gboolean      dodge);
+
+void   gimp_gegl_smudge_with_paint_process_avx2  (gfloat       *accum,
+                                                  const gfloat *canvas,
+                                                  gfloat       *paint,
+                                                  gint          count,
+                                                  const gfloat *brush_color,
+                                                  gfloat        brush_a,
+                                                  gboolean      no_erasing,
+                                                  gfloat        flow,
+                                                  gfloat        rate);
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
+#endif /* __GIMP_GEGL_LOOPS_AVX2_H__ */
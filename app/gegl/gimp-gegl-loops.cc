@@ -38,6 +38,7 @@ extern "C"
 
 #include "gimp-babl.h"
 #include "gimp-gegl-loops.h"
+#include "gimp-gegl-loops-avx2.h"
 #include "gimp-gegl-loops-sse2.h"
 
 #include "core/gimp-atomic.h"
@@ -211,6 +212,10 @@ gimp_gegl_convolve (GeglBuffer          *src_buffer,
   gint        src_components;
   gint        dest_components;
   gfloat      offset;
+#if COMPILE_AVX2_INTRINISICS
+  gboolean    avx2 = (gimp_cpu_accel_get_support () &
+                      GIMP_CPU_ACCEL_X86_AVX2);
+#endif
 
   if (! src_rect)
     src_rect = gegl_buffer_get_extent (src_buffer);
@@ -297,6 +302,21 @@ gimp_gegl_convolve (GeglBuffer          *src_buffer,
             {
               gfloat *d = dest;
 
+#if COMPILE_AVX2_INTRINISICS
+              if (avx2 && components == 4 && dest_components == 4)
+                {
+                  gimp_gegl_convolve_row_avx2 (src, src_rowstride,
+                                               src_rect->width,
+                                               src_rect->height,
+                                               d, dest_x1, y,
+                                               dest_x2 - dest_x1,
+                                               kernel, kernel_size,
+                                               divisor, offset,
+                                               mode != GIMP_NORMAL_CONVOL,
+                                               alpha_weighting);
+                }
+              else
+#endif
               if (alpha_weighting)
                 {
                   for (x = dest_x1; x < dest_x2; x++)
@@ -408,6 +428,11 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
                      GimpDodgeBurnType    type,
                      GimpTransferMode     mode)
 {
+#if COMPILE_AVX2_INTRINISICS
+  gboolean avx2 = (gimp_cpu_accel_get_support () &
+                   GIMP_CPU_ACCEL_X86_AVX2);
+#endif
+
   if (type == GIMP_DODGE_BURN_TYPE_BURN)
     exposure = -exposure;
 
@@ -446,6 +471,15 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
               gfloat *dest  = (gfloat *) iter->items[1].data;
               gint    count = iter->length;
 
+#if COMPILE_AVX2_INTRINISICS
+              if (avx2)
+                {
+                  gimp_gegl_dodgeburn_highlights_avx2 (src, dest, count,
+                                                       factor);
+                  continue;
+                }
+#endif
+
               while (count--)
                 {
                   *dest++ = *src++ * factor;
@@ -492,6 +526,15 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
               gfloat *dest  = (gfloat *) iter->items[1].data;
               gint    count = iter->length;
 
+#if COMPILE_AVX2_INTRINISICS
+              if (avx2)
+                {
+                  gimp_gegl_dodgeburn_shadows_avx2 (src, dest, count,
+                                                    factor, exposure >= 0);
+                  continue;
+                }
+#endif
+
               while (count--)
                 {
                   if (exposure >= 0)
@@ -632,6 +675,10 @@ gimp_gegl_smudge_with_paint (GeglBuffer          *accum_buffer,
   GeglAccessMode paint_buffer_access_mode = (brush_color ?
                                              GEGL_ACCESS_WRITE :
                                              GEGL_ACCESS_READWRITE);
+#if COMPILE_AVX2_INTRINISICS
+  gboolean       avx2 = (gimp_cpu_accel_get_support () &
+                         GIMP_CPU_ACCEL_X86_AVX2);
+#endif
 #if COMPILE_SSE2_INTRINISICS
   gboolean       sse2 = (gimp_cpu_accel_get_support () &
                          GIMP_CPU_ACCEL_X86_SSE2);
@@ -686,6 +733,17 @@ gimp_gegl_smudge_with_paint (GeglBuffer          *accum_buffer,
           gfloat       *paint  = (gfloat *)       iter->items[2].data;
           gint          count  = iter->length;
 
+#if COMPILE_AVX2_INTRINISICS
+          if (avx2)
+            {
+              gimp_gegl_smudge_with_paint_process_avx2 (accum, canvas, paint, count,
+                                                        brush_color ? brush_color_float :
+                                                                      NULL,
+                                                        brush_a,
+                                                        no_erasing, flow, rate);
+            }
+          else
+#endif
 #if COMPILE_SSE2_INTRINISICS
           if (sse2 && ((guintptr) accum                                     |
                        (guintptr) canvas                                    |
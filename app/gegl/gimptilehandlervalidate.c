@@ -38,6 +38,14 @@ enum
   LAST_SIGNAL
 };
 
+typedef struct
+{
+  GimpTileHandlerValidate *validate;
+  GeglBuffer              *buffer;
+  const GeglRectangle     *rects;
+  gint                     n_rects;
+} ValidateRectsData;
+
 enum
 {
   PROP_0,
@@ -69,6 +77,10 @@ static void     gimp_tile_handler_validate_real_validate_buffer (GimpTileHandler
                                                                  const GeglRectangle     *rect,
                                                                  GeglBuffer              *buffer);
 
+static void     gimp_tile_handler_validate_validate_rects_func  (gint             i,
+                                                                 gint             n,
+                                                                 ValidateRectsData *data);
+
 static gpointer gimp_tile_handler_validate_command              (GeglTileSource  *source,
                                                                  GeglTileCommand  command,
                                                                  gint             x,
@@ -271,6 +283,19 @@ gimp_tile_handler_validate_real_validate_buffer (GimpTileHandlerValidate *valida
     }
 }
 
+static void
+gimp_tile_handler_validate_validate_rects_func (gint               i,
+                                                gint               n,
+                                                ValidateRectsData *data)
+{
+  GimpTileHandlerValidateClass *klass;
+
+  klass = GIMP_TILE_HANDLER_VALIDATE_GET_CLASS (data->validate);
+
+  for (; i < data->n_rects; i += n)
+    klass->validate_buffer (data->validate, &data->rects[i], data->buffer);
+}
+
 static GeglTile *
 gimp_tile_handler_validate_validate_tile (GeglTileSource *source,
                                           gint            x,
@@ -623,6 +648,70 @@ gimp_tile_handler_validate_validate (GimpTileHandlerValidate *validate,
     }
 }
 
+/* validates a set of non-overlapping rectangles of @buffer, and removes them
+ * from the dirty region once all of them are done.
+ *
+ * a graph may not be processed by several threads at once:  each blit
+ * prepares the graph's operations, which modifies their state (for example,
+ * "gimp:layer-stack" rebuilds its per-layer infos in prepare()).  GEGL
+ * already prepares the graph once per blit, on the calling thread, and then
+ * distributes the processing of each operation among its threads, so when
+ * the handler renders its graph, the rectangles are blitted one after the
+ * other.  handlers that implement validate() instead only write to the
+ * rectangle they are given, without touching shared state, and the
+ * rectangles are validated concurrently, one per thread.
+ */
+void
+gimp_tile_handler_validate_validate_rects (GimpTileHandlerValidate *validate,
+                                           GeglBuffer              *buffer,
+                                           const GeglRectangle     *rects,
+                                           gint                     n_rects)
+{
+  GimpTileHandlerValidateClass *klass;
+  gint                          i;
+
+  g_return_if_fail (GIMP_IS_TILE_HANDLER_VALIDATE (validate));
+  g_return_if_fail (gimp_tile_handler_validate_get_assigned (buffer) ==
+                    validate);
+  g_return_if_fail (rects != NULL || n_rects == 0);
+
+  if (n_rects == 0)
+    return;
+
+  klass = GIMP_TILE_HANDLER_VALIDATE_GET_CLASS (validate);
+
+  gimp_tile_handler_validate_begin_validate (validate);
+
+  if (klass->validate == gimp_tile_handler_validate_real_validate)
+    {
+      for (i = 0; i < n_rects; i++)
+        klass->validate_buffer (validate, &rects[i], buffer);
+    }
+  else
+    {
+      ValidateRectsData data;
+
+      data.validate = validate;
+      data.buffer   = buffer;
+      data.rects    = rects;
+      data.n_rects  = n_rects;
+
+      gegl_parallel_distribute (
+        n_rects,
+        (GeglParallelDistributeFunc) gimp_tile_handler_validate_validate_rects_func,
+        &data);
+    }
+
+  gimp_tile_handler_validate_end_validate (validate);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_region_subtract_rectangle (
+        validate->dirty_region,
+        (const cairo_rectangle_int_t *) &rects[i]);
+    }
+}
+
 gboolean
 gimp_tile_handler_validate_buffer_set_extent (GeglBuffer          *buffer,
                                               const GeglRectangle *extent)
@@ -97,6 +97,10 @@ void                      gimp_tile_handler_validate_validate          (GimpTile
                                                                         const GeglRectangle     *rect,
                                                                         gboolean                 intersect,
                                                                         gboolean                 chunked);
+void                      gimp_tile_handler_validate_validate_rects    (GimpTileHandlerValidate *validate,
+                                                                        GeglBuffer              *buffer,
+                                                                        const GeglRectangle     *rects,
+                                                                        gint                     n_rects);
 
 gboolean                  gimp_tile_handler_validate_buffer_set_extent (GeglBuffer              *buffer,
                                                                         const GeglRectangle     *extent);
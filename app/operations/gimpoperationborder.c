@@ -29,6 +29,8 @@
 
 #include "operations-types.h"
 
+#include "gegl/gimp-gegl-distance.h"
+
 #include "gimpoperationborder.h"
 
 
@@ -328,421 +330,165 @@ compute_transition (gfloat    *transition,
     }
 }
 
-static gboolean
-gimp_operation_border_process (GeglOperation       *operation,
-                               GeglBuffer          *input,
-                               GeglBuffer          *output,
-                               const GeglRectangle *roi,
-                               gint                 level)
+/* Computes the transition pixels of the whole region, row by row, into
+   `output'. */
+static void
+compute_transitions (GimpOperationBorder *self,
+                     GeglBuffer          *input,
+                     GeglBuffer          *output,
+                     const GeglRectangle *roi,
+                     const Babl          *format)
 {
-  /* This function has no bugs, but if you imagine some you can blame
-   * them on jaycox@gimp.org
-   */
-  GimpOperationBorder *self          = GIMP_OPERATION_BORDER (operation);
-  const Babl          *input_format  = gegl_operation_get_format (operation, "input");
-  const Babl          *output_format = gegl_operation_get_format (operation, "output");
-
-  gint32 i, j, x, y;
-
-  /* A cache used in the algorithm as it works its way down. `buf[1]' is the
-     current row. Thus, at algorithm initialization, `buf[0]' represents the
-     row 'above' the first row of the region. */
-  gfloat  *buf[3];
-
-  /* The resulting selection is calculated row by row, and this buffer holds the
-     output for each individual row, on each iteration. */
-  gfloat  *out;
-
-  /* Keeps track of transitional pixels (pixels that are selected and have
-     unselected neighbouring pixels). */
-  gfloat **transition;
-
-  /* TODO: Figure out role clearly in algorithm. */
-  gint16  *max;
-
-  /* TODO: Figure out role clearly in algorithm. */
-  gfloat **density;
-
-  gint16   last_index;
-
-  /* optimize this case specifically */
-  if (self->radius_x == 1 && self->radius_y == 1)
-    {
-      gfloat *transition;
-      gfloat *source[3];
-
-      for (i = 0; i < 3; i++)
-        source[i] = g_new (gfloat, roi->width);
-
-      transition = g_new (gfloat, roi->width);
-
-      /* With `self->edge_lock', initialize row above image as
-       * selected, otherwise, initialize as unselected.
-       */
-      if (self->edge_lock)
-        {
-          for (i = 0; i < roi->width; i++)
-            source[0][i] = 1.0;
-        }
-      else
-        {
-          memset (source[0], 0, roi->width * sizeof (gfloat));
-        }
-
-      gegl_buffer_get (input,
-                       GEGL_RECTANGLE (roi->x, roi->y + 0,
-                                       roi->width, 1),
-                       1.0, input_format, source[1],
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-      if (roi->height > 1)
-        gegl_buffer_get (input,
-                         GEGL_RECTANGLE (roi->x, roi->y + 1,
-                                         roi->width, 1),
-                         1.0, input_format, source[2],
-                         GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      else
-        memcpy (source[2], source[1], roi->width * sizeof (gfloat));
-
-      compute_transition (transition, source, roi->width, self->edge_lock);
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y,
-                                       roi->width, 1),
-                       0, output_format, transition,
-                       GEGL_AUTO_ROWSTRIDE);
-
-      for (y = 1; y < roi->height; y++)
-        {
-          rotate_pointers (source, 3);
-
-          if (y + 1 < roi->height)
-            {
-              gegl_buffer_get (input,
-                               GEGL_RECTANGLE (roi->x, roi->y + y + 1,
-                                               roi->width, 1),
-                               1.0, input_format, source[2],
-                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-            }
-          else
-            {
-              /* Depending on `self->edge_lock', set the row below the
-               * image as either selected or non-selected.
-               */
-              if (self->edge_lock)
-                {
-                  for (i = 0; i < roi->width; i++)
-                    source[2][i] = 1.0;
-                }
-              else
-                {
-                  memset (source[2], 0, roi->width * sizeof (gfloat));
-                }
-            }
-
-          compute_transition (transition, source, roi->width, self->edge_lock);
-          gegl_buffer_set (output,
-                           GEGL_RECTANGLE (roi->x, roi->y + y,
-                                           roi->width, 1),
-                           0, output_format, transition,
-                           GEGL_AUTO_ROWSTRIDE);
-        }
-
-      for (i = 0; i < 3; i++)
-        g_free (source[i]);
-
-      g_free (transition);
-
-      /* Finished handling the radius = 1 special case, return here. */
-      return TRUE;
-    }
-
-  max = g_new (gint16, roi->width + 2 * self->radius_x);
-
-  for (i = 0; i < (roi->width + 2 * self->radius_x); i++)
-    max[i] = self->radius_y + 2;
-
-  max += self->radius_x;
+  gfloat *transition;
+  gfloat *source[3];
+  gint    i, y;
 
   for (i = 0; i < 3; i++)
-    buf[i] = g_new (gfloat, roi->width);
-
-  transition = g_new (gfloat *, self->radius_y + 1);
-
-  for (i = 0; i < self->radius_y + 1; i++)
-    {
-      transition[i] = g_new (gfloat, roi->width + 2 * self->radius_x);
-      memset (transition[i], 0,
-              (roi->width + 2 * self->radius_x) * sizeof (gfloat));
-      transition[i] += self->radius_x;
-    }
-
-  out = g_new (gfloat, roi->width);
-
-  density = g_new (gfloat *, 2 * self->radius_x + 1);
-  density += self->radius_x;
-
-  /* allocate density[][] */
-  for (x = 0; x < (self->radius_x + 1); x++)
-    {
-      density[ x]  = g_new (gfloat, 2 * self->radius_y + 1);
-      density[ x] += self->radius_y;
-      density[-x]  = density[x];
-    }
-
-  /* compute density[][] */
-  for (x = 0; x < (self->radius_x + 1); x++)
-    {
-      gdouble tmpx, tmpy, dist;
-      gfloat  a;
-
-      if (x > 0)
-        tmpx = x - 0.5;
-      else if (x < 0)
-        tmpx = x + 0.5;
-      else
-        tmpx = 0.0;
-
-      for (y = 0; y < (self->radius_y + 1); y++)
-        {
-          if (y > 0)
-            tmpy = y - 0.5;
-          else if (y < 0)
-            tmpy = y + 0.5;
-          else
-            tmpy = 0.0;
+    source[i] = g_new (gfloat, roi->width);
 
-          dist = ((tmpy * tmpy) / (self->radius_y * self->radius_y) +
-                  (tmpx * tmpx) / (self->radius_x * self->radius_x));
+  transition = g_new (gfloat, roi->width);
 
-          if (dist < 1.0)
-            {
-              if (self->feather)
-                a = 1.0 - sqrt (dist);
-              else
-                a = 1.0;
-            }
-          else
-            {
-              a = 0.0;
-            }
-
-          density[ x][ y] = a;
-          density[ x][-y] = a;
-          density[-x][ y] = a;
-          density[-x][-y] = a;
-        }
-    }
-
-  /* Since the algorithm considerers `buf[0]' to be 'over' the row
-   * currently calculated, we must start with `buf[0]' as non-selected
-   * if there is no `self->edge_lock. If there is an
-   * 'self->edge_lock', initialize the first row to 'selected'. Refer
-   * to bug #350009.
+  /* With `self->edge_lock', initialize row above image as
+   * selected, otherwise, initialize as unselected.
    */
   if (self->edge_lock)
     {
       for (i = 0; i < roi->width; i++)
-        buf[0][i] = 1.0;
+        source[0][i] = 1.0;
     }
   else
     {
-      memset (buf[0], 0, roi->width * sizeof (gfloat));
+      memset (source[0], 0, roi->width * sizeof (gfloat));
     }
 
   gegl_buffer_get (input,
                    GEGL_RECTANGLE (roi->x, roi->y + 0,
                                    roi->width, 1),
-                   1.0, input_format, buf[1],
+                   1.0, format, source[1],
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
   if (roi->height > 1)
     gegl_buffer_get (input,
                      GEGL_RECTANGLE (roi->x, roi->y + 1,
                                      roi->width, 1),
-                     1.0, input_format, buf[2],
+                     1.0, format, source[2],
                      GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
   else
-    memcpy (buf[2], buf[1], roi->width * sizeof (gfloat));
+    memcpy (source[2], source[1], roi->width * sizeof (gfloat));
 
-  compute_transition (transition[1], buf, roi->width, self->edge_lock);
-
-   /* set up top of image */
-  for (y = 1; y < self->radius_y && y + 1 < roi->height; y++)
-    {
-      rotate_pointers (buf, 3);
-      gegl_buffer_get (input,
-                       GEGL_RECTANGLE (roi->x, roi->y + y + 1,
-                                       roi->width, 1),
-                       1.0, input_format, buf[2],
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      compute_transition (transition[y + 1], buf, roi->width, self->edge_lock);
-    }
-
-  /* set up max[] for top of image */
-  for (x = 0; x < roi->width; x++)
-    {
-      max[x] = -(self->radius_y + 7);
-
-      for (j = 1; j < self->radius_y + 1; j++)
-        if (transition[j][x])
-          {
-            max[x] = j;
-            break;
-          }
-    }
+  compute_transition (transition, source, roi->width, self->edge_lock);
+  gegl_buffer_set (output,
+                   GEGL_RECTANGLE (roi->x, roi->y,
+                                   roi->width, 1),
+                   0, format, transition,
+                   GEGL_AUTO_ROWSTRIDE);
 
-  /* main calculation loop */
-  for (y = 0; y < roi->height; y++)
+  for (y = 1; y < roi->height; y++)
     {
-      rotate_pointers (buf, 3);
-      rotate_pointers (transition, self->radius_y + 1);
+      rotate_pointers (source, 3);
 
-      if (y < roi->height - (self->radius_y + 1))
+      if (y + 1 < roi->height)
         {
           gegl_buffer_get (input,
-                           GEGL_RECTANGLE (roi->x,
-                                           roi->y + y + self->radius_y + 1,
+                           GEGL_RECTANGLE (roi->x, roi->y + y + 1,
                                            roi->width, 1),
-                           1.0, input_format, buf[2],
+                           1.0, format, source[2],
                            GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-          compute_transition (transition[self->radius_y], buf, roi->width, self->edge_lock);
         }
       else
         {
+          /* Depending on `self->edge_lock', set the row below the
+           * image as either selected or non-selected.
+           */
           if (self->edge_lock)
             {
-              memcpy (transition[self->radius_y], transition[self->radius_y - 1], roi->width * sizeof (gfloat));
-            }
-          else
-            {
-              /* No edge lock, set everything 'below canvas' as seen
-               * from the algorithm as unselected.
-               */
-              memset (buf[2], 0, roi->width * sizeof (gfloat));
-              compute_transition (transition[self->radius_y], buf, roi->width, self->edge_lock);
-            }
-        }
-
-      /* update max array */
-      for (x = 0; x < roi->width; x++)
-        {
-          if (max[x] < 1)
-            {
-              if (max[x] <= -self->radius_y)
-                {
-                  if (transition[self->radius_y][x])
-                    max[x] = self->radius_y;
-                  else
-                    max[x]--;
-                }
-              else
-                {
-                  if (transition[-max[x]][x])
-                    max[x] = -max[x];
-                  else if (transition[-max[x] + 1][x])
-                    max[x] = -max[x] + 1;
-                  else
-                    max[x]--;
-                }
+              for (i = 0; i < roi->width; i++)
+                source[2][i] = 1.0;
             }
           else
             {
-              max[x]--;
+              memset (source[2], 0, roi->width * sizeof (gfloat));
             }
-
-          if (max[x] < -self->radius_y - 1)
-            max[x] = -self->radius_y - 1;
         }
 
-      last_index = 1;
-
-       /* render scan line */
-      for (x = 0 ; x < roi->width; x++)
-        {
-          gfloat last_max;
-
-          last_index--;
-
-          if (last_index >= 0)
-            {
-              last_max = 0.0;
-
-              for (i = self->radius_x; i >= 0; i--)
-                if (max[x + i] <= self->radius_y && max[x + i] >= -self->radius_y &&
-                    density[i][max[x+i]] > last_max)
-                  {
-                    last_max = density[i][max[x + i]];
-                    last_index = i;
-                  }
+      compute_transition (transition, source, roi->width, self->edge_lock);
+      gegl_buffer_set (output,
+                       GEGL_RECTANGLE (roi->x, roi->y + y,
+                                       roi->width, 1),
+                       0, format, transition,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
 
-              out[x] = last_max;
-            }
-          else
-            {
-              last_max = 0.0;
+  for (i = 0; i < 3; i++)
+    g_free (source[i]);
 
-              for (i = self->radius_x; i >= -self->radius_x; i--)
-                if (max[x + i] <= self->radius_y && max[x + i] >= -self->radius_y &&
-                    density[i][max[x + i]] > last_max)
-                  {
-                    last_max = density[i][max[x + i]];
-                    last_index = i;
-                  }
+  g_free (transition);
+}
 
-              out[x] = last_max;
-            }
+static gfloat
+gimp_operation_border_map (gdouble  cost,
+                           gpointer user_data)
+{
+  GimpOperationBorder *self = user_data;
 
-          if (last_max <= 0.0)
-            {
-              for (i = x + 1; i < roi->width; i++)
-                {
-                  if (max[i] >= -self->radius_y)
-                    break;
-                }
+  /*  within the ellipse around a transition pixel  */
+  if (cost < 1.0)
+    return self->feather ? 1.0 - sqrt (cost) : 1.0;
 
-              if (i - x > self->radius_x)
-                {
-                  for (; x < i - self->radius_x; x++)
-                    out[x] = 0;
+  return 0.0;
+}
 
-                  x--;
-                }
+static gboolean
+gimp_operation_border_process (GeglOperation       *operation,
+                               GeglBuffer          *input,
+                               GeglBuffer          *output,
+                               const GeglRectangle *roi,
+                               gint                 level)
+{
+  GimpOperationBorder *self   = GIMP_OPERATION_BORDER (operation);
+  const Babl          *format = gegl_operation_get_format (operation, "input");
+  GeglBuffer          *transition;
+  gdouble             *cost_x;
+  gdouble             *cost_y;
+  gint                 n_cost_x;
+  gint                 n_cost_y;
 
-              last_index = self->radius_x;
-            }
-        }
+  /* optimize this case specifically */
+  if (self->radius_x == 1 && self->radius_y == 1)
+    {
+      compute_transitions (self, input, output, roi, format);
 
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y + y,
-                                       roi->width, 1),
-                       0, output_format, out,
-                       GEGL_AUTO_ROWSTRIDE);
+      /* Finished handling the radius = 1 special case, return here. */
+      return TRUE;
     }
 
-  g_free (out);
+  /* Otherwise, the border is everything within the radius of a
+     transition pixel, found through a distance transform of the
+     transition pixels, which is linear in the size of the region
+     whatever the radius. */
+  transition = gegl_buffer_new (roi, babl_format ("Y u8"));
 
-  for (i = 0; i < 3; i++)
-    g_free (buf[i]);
+  compute_transitions (self, input, transition, roi, format);
 
-  max -= self->radius_x;
-  g_free (max);
+  n_cost_x = self->radius_x + 2;
+  n_cost_y = self->radius_y + 2;
+  cost_x   = g_new (gdouble, n_cost_x);
+  cost_y   = g_new (gdouble, n_cost_y);
 
-  for (i = 0; i < self->radius_y + 1; i++)
-    {
-      transition[i] -= self->radius_x;
-      g_free (transition[i]);
-    }
+  gimp_gegl_distance_ellipse_costs (cost_x, n_cost_x, self->radius_x);
+  gimp_gegl_distance_ellipse_costs (cost_y, n_cost_y, self->radius_y);
 
-  g_free (transition);
+  gimp_gegl_distance_transform (transition, roi,
+                                0.5, FALSE, FALSE,
+                                cost_x, n_cost_x,
+                                cost_y, n_cost_y,
+                                gimp_operation_border_map, self,
+                                output, roi);
 
-  for (i = 0; i < self->radius_x + 1 ; i++)
-    {
-      density[i] -= self->radius_y;
-      g_free (density[i]);
-    }
+  g_free (cost_x);
+  g_free (cost_y);
 
-  density -= self->radius_x;
-  g_free (density);
+  g_object_unref (transition);
 
   return TRUE;
 }
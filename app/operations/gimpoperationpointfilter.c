@@ -46,6 +46,8 @@ gimp_operation_point_filter_class_init (GimpOperationPointFilterClass *klass)
   object_class->finalize = gimp_operation_point_filter_finalize;
 
   operation_class->prepare = gimp_operation_point_filter_prepare;
+
+  klass->separable = FALSE;
 }
 
 static void
@@ -113,29 +115,36 @@ gimp_operation_point_filter_set_property (GObject      *object,
     }
 }
 
-static void
-gimp_operation_point_filter_prepare (GeglOperation *operation)
+/*  the format the filter processes, for the given space  */
+const Babl *
+gimp_operation_point_filter_get_format (GimpOperationPointFilter *filter,
+                                        const Babl               *space)
 {
-  GimpOperationPointFilter *self = GIMP_OPERATION_POINT_FILTER (operation);
-  const Babl               *space = gegl_operation_get_source_space (operation,
-                                                                     "input");
-  const Babl               *format;
+  g_return_val_if_fail (GIMP_IS_OPERATION_POINT_FILTER (filter), NULL);
 
-  switch (self->trc)
+  switch (filter->trc)
     {
     default:
     case GIMP_TRC_LINEAR:
-      format = babl_format_with_space ("RGBA float", space);
-      break;
+      return babl_format_with_space ("RGBA float", space);
 
     case GIMP_TRC_NON_LINEAR:
-      format = babl_format_with_space ("R'G'B'A float", space);
-      break;
+      return babl_format_with_space ("R'G'B'A float", space);
 
     case GIMP_TRC_PERCEPTUAL:
-      format = babl_format_with_space ("R~G~B~A float", space);
-      break;
+      return babl_format_with_space ("R~G~B~A float", space);
     }
+}
+
+static void
+gimp_operation_point_filter_prepare (GeglOperation *operation)
+{
+  GimpOperationPointFilter *self = GIMP_OPERATION_POINT_FILTER (operation);
+  const Babl               *space = gegl_operation_get_source_space (operation,
+                                                                     "input");
+  const Babl               *format;
+
+  format = gimp_operation_point_filter_get_format (self, space);
 
   gegl_operation_set_format (operation, "input",  format);
   gegl_operation_set_format (operation, "output", format);
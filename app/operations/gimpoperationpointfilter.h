@@ -55,19 +55,27 @@ struct _GimpOperationPointFilter
 struct _GimpOperationPointFilterClass
 {
   GeglOperationPointFilterClass  parent_class;
+
+  /*  each output channel is a continuous function of the same input
+   *  channel alone, so the filter can be sampled into lookup tables
+   */
+  gboolean                       separable;
 };
 
 
-GType   gimp_operation_point_filter_get_type     (void) G_GNUC_CONST;
+GType        gimp_operation_point_filter_get_type     (void) G_GNUC_CONST;
+
+void         gimp_operation_point_filter_get_property (GObject                  *object,
+                                                       guint                     property_id,
+                                                       GValue                   *value,
+                                                       GParamSpec               *pspec);
+void         gimp_operation_point_filter_set_property (GObject                  *object,
+                                                       guint                     property_id,
+                                                       const GValue             *value,
+                                                       GParamSpec               *pspec);
 
-void    gimp_operation_point_filter_get_property (GObject      *object,
-                                                  guint         property_id,
-                                                  GValue       *value,
-                                                  GParamSpec   *pspec);
-void    gimp_operation_point_filter_set_property (GObject      *object,
-                                                  guint         property_id,
-                                                  const GValue *value,
-                                                  GParamSpec   *pspec);
+const Babl * gimp_operation_point_filter_get_format   (GimpOperationPointFilter *filter,
+                                                       const Babl               *space);
 
 
 #endif /* __GIMP_OPERATION_POINT_FILTER_H__ */
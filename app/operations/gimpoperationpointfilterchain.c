@@ -0,0 +1,590 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationpointfilterchain.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl-plugin.h>
+
+#include "operations-types.h"
+
+#include "gimpoperationpointfilter.h"
+#include "gimpoperationpointfilterchain.h"
+
+
+/*  the operation applies a run of point filters to its input in a single
+ *  pass: each chunk is processed by all the filters in turn while it is
+ *  still in the cache, instead of every filter reading and writing an
+ *  intermediate buffer covering the entire roi.
+ *
+ *  consecutive separable filters working in the same format are sampled
+ *  together into a per-channel lookup table, which replaces their
+ *  per-pixel math (such as the levels gamma) with a single interpolated
+ *  lookup.  values outside of [0, 1], which the table doesn't cover, are
+ *  still processed by the filters themselves.
+ */
+
+
+/*  number of intervals of the lookup tables over [0, 1]  */
+#define LUT_SIZE (1 << 14)
+
+
+enum
+{
+  PROP_0,
+  PROP_FILTERS
+};
+
+
+struct _GimpOperationPointFilterChainStage
+{
+  /* the stage's filters, in order */
+  GimpOperationPointFilter **filters;
+  gint                       n_filters;
+
+  const Babl                *format;
+
+  /* 4 * (LUT_SIZE + 1) values, for separable stages */
+  gfloat                    *lut;
+};
+
+
+static void       gimp_operation_point_filter_chain_finalize     (GObject                            *object);
+static void       gimp_operation_point_filter_chain_get_property (GObject                            *object,
+                                                                  guint                               property_id,
+                                                                  GValue                             *value,
+                                                                  GParamSpec                         *pspec);
+static void       gimp_operation_point_filter_chain_set_property (GObject                            *object,
+                                                                  guint                               property_id,
+                                                                  const GValue                       *value,
+                                                                  GParamSpec                         *pspec);
+
+static void       gimp_operation_point_filter_chain_prepare      (GeglOperation                      *operation);
+static gboolean   gimp_operation_point_filter_chain_process      (GeglOperation                      *operation,
+                                                                  void                               *in_buf,
+                                                                  void                               *out_buf,
+                                                                  glong                               samples,
+                                                                  const GeglRectangle                *roi,
+                                                                  gint                                level);
+
+static void       gimp_operation_point_filter_chain_clear_stages (GimpOperationPointFilterChain      *self);
+static void       gimp_operation_point_filter_chain_build_stages (GimpOperationPointFilterChain      *self,
+                                                                  const Babl                         *space);
+static gfloat   * gimp_operation_point_filter_chain_run_stage    (GimpOperationPointFilterChainStage *stage,
+                                                                  gfloat                             *buf,
+                                                                  gfloat                             *temp,
+                                                                  glong                               samples,
+                                                                  const GeglRectangle                *roi,
+                                                                  gint                                level);
+static void       gimp_operation_point_filter_chain_map_stage    (GimpOperationPointFilterChainStage *stage,
+                                                                  const gfloat                       *src,
+                                                                  gfloat                             *dest,
+                                                                  glong                               samples,
+                                                                  const GeglRectangle                *roi,
+                                                                  gint                                level);
+
+
+G_DEFINE_TYPE (GimpOperationPointFilterChain, gimp_operation_point_filter_chain,
+               GEGL_TYPE_OPERATION_POINT_FILTER)
+
+#define parent_class gimp_operation_point_filter_chain_parent_class
+
+
+static void
+gimp_operation_point_filter_chain_class_init (GimpOperationPointFilterChainClass *klass)
+{
+  GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+
+  object_class->finalize     = gimp_operation_point_filter_chain_finalize;
+  object_class->set_property = gimp_operation_point_filter_chain_set_property;
+  object_class->get_property = gimp_operation_point_filter_chain_get_property;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:point-filter-chain",
+                                 "categories",  "color",
+                                 "description", "GIMP fused point filter chain operation",
+                                 NULL);
+
+  operation_class->prepare = gimp_operation_point_filter_chain_prepare;
+
+  point_class->process     = gimp_operation_point_filter_chain_process;
+
+  g_object_class_install_property (object_class, PROP_FILTERS,
+                                   g_param_spec_pointer ("filters",
+                                                         "Filters",
+                                                         "An array of nodes of GimpOperationPointFilter "
+                                                         "operations, first to last, terminated by NULL",
+                                                         G_PARAM_READWRITE));
+}
+
+static void
+gimp_operation_point_filter_chain_init (GimpOperationPointFilterChain *self)
+{
+}
+
+static void
+gimp_operation_point_filter_chain_finalize (GObject *object)
+{
+  GimpOperationPointFilterChain *self = GIMP_OPERATION_POINT_FILTER_CHAIN (object);
+  gint                           i;
+
+  gimp_operation_point_filter_chain_clear_stages (self);
+
+  for (i = 0; i < self->n_filters; i++)
+    g_object_unref (self->filters[i]);
+
+  g_clear_pointer (&self->filters, g_free);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_point_filter_chain_get_property (GObject    *object,
+                                                guint       property_id,
+                                                GValue     *value,
+                                                GParamSpec *pspec)
+{
+  GimpOperationPointFilterChain *self = GIMP_OPERATION_POINT_FILTER_CHAIN (object);
+
+  switch (property_id)
+    {
+    case PROP_FILTERS:
+      g_value_set_pointer (value, self->filters);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_point_filter_chain_set_property (GObject      *object,
+                                                guint         property_id,
+                                                const GValue *value,
+                                                GParamSpec   *pspec)
+{
+  GimpOperationPointFilterChain *self = GIMP_OPERATION_POINT_FILTER_CHAIN (object);
+
+  switch (property_id)
+    {
+    case PROP_FILTERS:
+      {
+        GeglNode **filters = g_value_get_pointer (value);
+        GeglNode **old     = self->filters;
+        gint       n_old   = self->n_filters;
+        gint       i;
+
+        /* the filters' settings may have changed even if the filters
+         * didn't, so the stages are always rebuilt
+         */
+        gimp_operation_point_filter_chain_clear_stages (self);
+
+        self->filters   = NULL;
+        self->n_filters = 0;
+
+        if (filters)
+          {
+            while (filters[self->n_filters])
+              self->n_filters++;
+
+            self->filters = g_new0 (GeglNode *, self->n_filters + 1);
+
+            for (i = 0; i < self->n_filters; i++)
+              self->filters[i] = g_object_ref (filters[i]);
+          }
+
+        for (i = 0; i < n_old; i++)
+          g_object_unref (old[i]);
+
+        g_free (old);
+      }
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_point_filter_chain_prepare (GeglOperation *operation)
+{
+  GimpOperationPointFilterChain *self  = GIMP_OPERATION_POINT_FILTER_CHAIN (operation);
+  const Babl                    *space = gegl_operation_get_source_space (operation,
+                                                                          "input");
+
+  if (! self->stages || space != self->space)
+    gimp_operation_point_filter_chain_build_stages (self, space);
+
+  if (self->n_stages > 0)
+    {
+      gegl_operation_set_format (operation, "input",
+                                 self->stages[0].format);
+      gegl_operation_set_format (operation, "output",
+                                 self->stages[self->n_stages - 1].format);
+    }
+  else
+    {
+      gegl_operation_set_format (operation, "input",
+                                 babl_format_with_space ("RGBA float", space));
+      gegl_operation_set_format (operation, "output",
+                                 babl_format_with_space ("RGBA float", space));
+    }
+}
+
+static gboolean
+gimp_operation_point_filter_chain_process (GeglOperation       *operation,
+                                           void                *in_buf,
+                                           void                *out_buf,
+                                           glong                samples,
+                                           const GeglRectangle *roi,
+                                           gint                 level)
+{
+  GimpOperationPointFilterChain *self = GIMP_OPERATION_POINT_FILTER_CHAIN (operation);
+  gfloat                        *out  = out_buf;
+  gfloat                        *temp;
+  gfloat                        *bufs[2];
+  const gfloat                  *src;
+  const Babl                    *src_format;
+  gint                           i;
+
+  if (self->n_stages == 0)
+    {
+      if (in_buf != out_buf)
+        memcpy (out_buf, in_buf, 4 * samples * sizeof (gfloat));
+
+      return TRUE;
+    }
+
+  temp = gegl_scratch_new (gfloat, 4 * samples);
+
+  bufs[0] = out;
+  bufs[1] = temp;
+
+  src        = in_buf;
+  src_format = self->stages[0].format;
+
+  for (i = 0; i < self->n_stages; i++)
+    {
+      GimpOperationPointFilterChainStage *stage = &self->stages[i];
+      gfloat                             *dest;
+
+      /* process into whichever buffer doesn't hold the source.  an input
+       * buffer separate from the output is never written to.
+       */
+      dest = (src == bufs[0]) ? bufs[1] : bufs[0];
+
+      if (src_format != stage->format)
+        {
+          babl_process (babl_fish (src_format, stage->format),
+                        src, dest, samples);
+
+          src  = dest;
+          dest = (src == bufs[0]) ? bufs[1] : bufs[0];
+
+          src_format = stage->format;
+        }
+
+      if (stage->lut)
+        {
+          gimp_operation_point_filter_chain_map_stage (stage, src, dest,
+                                                       samples, roi, level);
+        }
+      else
+        {
+          GeglOperation *filter = GEGL_OPERATION (stage->filters[0]);
+
+          if (! GEGL_OPERATION_POINT_FILTER_GET_CLASS (filter)->process (
+                  filter, (gpointer) src, dest, samples, roi, level))
+            {
+              memcpy (dest, src, 4 * samples * sizeof (gfloat));
+            }
+        }
+
+      src = dest;
+    }
+
+  if (src != out)
+    memcpy (out, src, 4 * samples * sizeof (gfloat));
+
+  gegl_scratch_free (temp);
+
+  return TRUE;
+}
+
+static void
+gimp_operation_point_filter_chain_clear_stages (GimpOperationPointFilterChain *self)
+{
+  gint i;
+
+  for (i = 0; i < self->n_stages; i++)
+    {
+      g_free (self->stages[i].filters);
+      g_free (self->stages[i].lut);
+    }
+
+  g_clear_pointer (&self->stages, g_free);
+  self->n_stages = 0;
+  self->space    = NULL;
+}
+
+static void
+gimp_operation_point_filter_chain_build_stages (GimpOperationPointFilterChain *self,
+                                                const Babl                    *space)
+{
+  GeglRectangle lut_roi = { 0, 0, LUT_SIZE + 1, 1 };
+  gint          i;
+
+  gimp_operation_point_filter_chain_clear_stages (self);
+
+  self->space  = space;
+  self->stages = g_new0 (GimpOperationPointFilterChainStage,
+                         MAX (self->n_filters, 1));
+
+  /* group consecutive separable filters working in the same format */
+  for (i = 0; i < self->n_filters; i++)
+    {
+      GimpOperationPointFilterChainStage *stage = NULL;
+      GimpOperationPointFilter           *filter;
+      const Babl                         *format;
+      gboolean                            separable;
+
+      filter = GIMP_OPERATION_POINT_FILTER (
+        gegl_node_get_gegl_operation (self->filters[i]));
+
+      format    = gimp_operation_point_filter_get_format (filter, space);
+      separable = GIMP_OPERATION_POINT_FILTER_GET_CLASS (filter)->separable;
+
+      if (separable && self->n_stages > 0)
+        {
+          stage = &self->stages[self->n_stages - 1];
+
+          if (! stage->lut || stage->format != format)
+            stage = NULL;
+        }
+
+      if (! stage)
+        {
+          stage = &self->stages[self->n_stages++];
+
+          stage->filters = g_new0 (GimpOperationPointFilter *,
+                                   self->n_filters - i);
+          stage->format  = format;
+
+          /* the table is filled once all the stages are known */
+          if (separable)
+            stage->lut = g_new (gfloat, 4 * (LUT_SIZE + 1));
+        }
+
+      stage->filters[stage->n_filters++] = filter;
+    }
+
+  /* sample the separable stages over [0, 1], all channels at once */
+  for (i = 0; i < self->n_stages; i++)
+    {
+      GimpOperationPointFilterChainStage *stage = &self->stages[i];
+      gfloat                             *temp;
+      gfloat                             *result;
+      gint                                j;
+
+      if (! stage->lut)
+        continue;
+
+      for (j = 0; j <= LUT_SIZE; j++)
+        {
+          gfloat value = (gfloat) j / LUT_SIZE;
+
+          stage->lut[4 * j + 0] = value;
+          stage->lut[4 * j + 1] = value;
+          stage->lut[4 * j + 2] = value;
+          stage->lut[4 * j + 3] = value;
+        }
+
+      temp = g_new (gfloat, 4 * (LUT_SIZE + 1));
+
+      result = gimp_operation_point_filter_chain_run_stage (stage,
+                                                            stage->lut, temp,
+                                                            LUT_SIZE + 1,
+                                                            &lut_roi, 0);
+
+      if (result == temp)
+        {
+          temp       = stage->lut;
+          stage->lut = result;
+        }
+
+      g_free (temp);
+    }
+}
+
+/*  runs 'buf' through all the filters of 'stage', using 'temp' as the
+ *  other half of a ping-pong pair, and returns whichever holds the result
+ */
+static gfloat *
+gimp_operation_point_filter_chain_run_stage (GimpOperationPointFilterChainStage *stage,
+                                             gfloat                             *buf,
+                                             gfloat                             *temp,
+                                             glong                               samples,
+                                             const GeglRectangle                *roi,
+                                             gint                                level)
+{
+  gfloat *src  = buf;
+  gfloat *dest = temp;
+  gint    i;
+
+  for (i = 0; i < stage->n_filters; i++)
+    {
+      GeglOperation *filter = GEGL_OPERATION (stage->filters[i]);
+
+      if (GEGL_OPERATION_POINT_FILTER_GET_CLASS (filter)->process (
+            filter, src, dest, samples, roi, level))
+        {
+          gfloat *swap = src;
+
+          src  = dest;
+          dest = swap;
+        }
+    }
+
+  return src;
+}
+
+static void
+gimp_operation_point_filter_chain_map_stage (GimpOperationPointFilterChainStage *stage,
+                                             const gfloat                       *src,
+                                             gfloat                             *dest,
+                                             glong                               samples,
+                                             const GeglRectangle                *roi,
+                                             gint                                level)
+{
+  const gfloat *lut        = stage->lut;
+  glong        *outliers   = NULL;
+  glong         n_outliers = 0;
+  glong         i;
+
+  for (i = 0; i < samples; i++)
+    {
+      gboolean outlier = FALSE;
+      gint     c;
+
+      for (c = 0; c < 4; c++)
+        {
+          gfloat value = src[4 * i + c];
+          gfloat x;
+          gint   j;
+
+          /* NaNs fail this, too */
+          if (! (value >= 0.0f && value <= 1.0f))
+            {
+              outlier = TRUE;
+              continue;
+            }
+
+          x = value * LUT_SIZE;
+          j = MIN ((gint) x, LUT_SIZE - 1);
+          x -= j;
+
+          dest[4 * i + c] = lut[4 * j + c] +
+                            x * (lut[4 * (j + 1) + c] - lut[4 * j + c]);
+        }
+
+      if (outlier)
+        {
+          if (! outliers)
+            outliers = gegl_scratch_new (glong, samples);
+
+          outliers[n_outliers++] = i;
+        }
+    }
+
+  /* gather the pixels the table doesn't cover, process them directly,
+   * and scatter the results back
+   */
+  if (n_outliers > 0)
+    {
+      gfloat *buf  = gegl_scratch_new (gfloat, 4 * n_outliers);
+      gfloat *temp = gegl_scratch_new (gfloat, 4 * n_outliers);
+      gfloat *result;
+
+      for (i = 0; i < n_outliers; i++)
+        memcpy (buf + 4 * i, src + 4 * outliers[i], 4 * sizeof (gfloat));
+
+      result = gimp_operation_point_filter_chain_run_stage (stage, buf, temp,
+                                                            n_outliers,
+                                                            roi, level);
+
+      for (i = 0; i < n_outliers; i++)
+        memcpy (dest + 4 * outliers[i], result + 4 * i, 4 * sizeof (gfloat));
+
+      gegl_scratch_free (temp);
+      gegl_scratch_free (buf);
+      gegl_scratch_free (outliers);
+    }
+}
+
+
+/*  public functions  */
+
+gboolean
+gimp_operation_point_filter_chain_can_chain (GeglNode *filter)
+{
+  GeglOperation      *operation;
+  GeglOperationClass *point_filter_class;
+
+  g_return_val_if_fail (GEGL_IS_NODE (filter), FALSE);
+
+  operation = gegl_node_get_gegl_operation (filter);
+
+  if (! GIMP_IS_OPERATION_POINT_FILTER (operation))
+    return FALSE;
+
+  /* filters choosing their own formats, or looking at their source while
+   * processing, can't be run outside of their node
+   */
+  point_filter_class = g_type_class_peek (GIMP_TYPE_OPERATION_POINT_FILTER);
+
+  return GEGL_OPERATION_GET_CLASS (operation)->prepare ==
+         point_filter_class->prepare;
+}
+
+void
+gimp_operation_point_filter_chain_set_filters (GeglNode  *node,
+                                               GeglNode **filters,
+                                               gint       n_filters)
+{
+  GeglNode **terminated;
+
+  g_return_if_fail (GEGL_IS_NODE (node));
+  g_return_if_fail (filters != NULL || n_filters == 0);
+
+  terminated = g_new0 (GeglNode *, n_filters + 1);
+
+  if (n_filters > 0)
+    memcpy (terminated, filters, n_filters * sizeof (GeglNode *));
+
+  gegl_node_set (node,
+                 "filters", terminated,
+                 NULL);
+
+  g_free (terminated);
+}
@@ -29,6 +29,9 @@
 
 #include "operations-types.h"
 
+#include "gegl/gimp-gegl-distance.h"
+#include "gegl/gimp-gegl-mask.h"
+
 #include "gimpoperationshrink.h"
 
 
@@ -242,6 +245,14 @@ rotate_pointers (gfloat  **p,
   p[i] = tmp;
 }
 
+static gfloat
+gimp_operation_shrink_map (gdouble  cost,
+                           gpointer user_data)
+{
+  /*  within the ellipse around an unselected pixel  */
+  return cost <= 1.0 ? 0.0f : 1.0f;
+}
+
 static gboolean
 gimp_operation_shrink_process (GeglOperation       *operation,
                                GeglBuffer          *input,
@@ -269,6 +280,33 @@ gimp_operation_shrink_process (GeglOperation       *operation,
   gfloat              *buffer;
   gint                 buffer_size;
 
+  /*  binary masks, which most selections are, are shrunk exactly the
+   *  same through a distance transform, which is linear in the size of
+   *  the mask whatever the radius
+   */
+  if (gimp_gegl_mask_is_binary (input, roi))
+    {
+      gint     n_cost_x = self->radius_x + 2;
+      gint     n_cost_y = self->radius_y + 2;
+      gdouble *cost_x   = g_new (gdouble, n_cost_x);
+      gdouble *cost_y   = g_new (gdouble, n_cost_y);
+
+      gimp_gegl_distance_ellipse_costs (cost_x, n_cost_x, self->radius_x);
+      gimp_gegl_distance_ellipse_costs (cost_y, n_cost_y, self->radius_y);
+
+      gimp_gegl_distance_transform (input, roi,
+                                    0.5, TRUE, ! self->edge_lock,
+                                    cost_x, n_cost_x,
+                                    cost_y, n_cost_y,
+                                    gimp_operation_shrink_map, NULL,
+                                    output, roi);
+
+      g_free (cost_x);
+      g_free (cost_y);
+
+      return TRUE;
+    }
+
   max = g_new (gfloat *, roi->width + 2 * self->radius_x);
   buf = g_new (gfloat *, self->radius_y + 1);
 
@@ -0,0 +1,581 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-blend-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode.h"
+#include "gimpoperationlayermode-blend.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 */
+#include <immintrin.h>
+
+
+#define EPSILON      1e-6f
+
+#define SAFE_DIV_MIN EPSILON
+#define SAFE_DIV_MAX (1.0f / SAFE_DIV_MIN)
+
+/* the alpha components of a pair of RGBA pixels */
+#define ALPHA_MASK   0x88
+
+
+/*  the functions in this file process two pixels per 256-bit vector.  the
+ *  per-component blend kernels are evaluated for all pixels, regardless of
+ *  their alpha, which is allowed since comp[RED..BLUE] is unconstrained when
+ *  in[ALPHA] or layer[ALPHA] are zero.  the kernels perform the same
+ *  operations, in the same order, as their generic counterparts, so that
+ *  the results are identical, including for NaN and infinite components
+ *  (see test-layer-modes-avx2.)  a trailing odd pixel is handled by the
+ *  generic function.
+ */
+
+
+typedef __m256 (* BlendKernel) (__m256 in,
+                                __m256 layer);
+
+
+/*  local function prototypes  */
+
+static inline __m256   safe_div       (__m256                  a,
+                                       __m256                  b);
+static inline __m256   luminance_avx2 (__m256                  rgba,
+                                       __m256d                 luminance);
+
+static inline void     blend_avx2     (GeglOperation          *operation,
+                                       const gfloat           *in,
+                                       const gfloat           *layer,
+                                       gfloat                 *comp,
+                                       gint                    samples,
+                                       BlendKernel             kernel,
+                                       GimpLayerModeBlendFunc  generic);
+
+
+/*  private functions  */
+
+
+/* returns a / b, clamped to [-SAFE_DIV_MAX, SAFE_DIV_MAX].
+ * if -SAFE_DIV_MIN <= a <= SAFE_DIV_MIN, returns 0.
+ */
+static inline __m256
+safe_div (__m256 a,
+          __m256 b)
+{
+  const __m256 v_sign_mask = _mm256_set1_ps (-0.0f);
+  __m256       result;
+  __m256       nonzero;
+
+  nonzero = _mm256_cmp_ps (_mm256_andnot_ps (v_sign_mask, a),
+                           _mm256_set1_ps (SAFE_DIV_MIN),
+                           _CMP_GT_OQ);
+
+  /* max and min return their second operand when either one is NaN, so
+   * pass the result last, in order to keep NaN like CLAMP() does.
+   */
+  result = _mm256_div_ps (a, b);
+  result = _mm256_min_ps (_mm256_set1_ps (SAFE_DIV_MAX),
+                          _mm256_max_ps (_mm256_set1_ps (-SAFE_DIV_MAX),
+                                         result));
+
+  return _mm256_and_ps (result, nonzero);
+}
+
+/* returns the luminance of each of the two pixels, broadcast over the
+ * pixel's components.  like the generic code, the luminance is accumulated
+ * in double precision, and then rounded to single precision.  the alpha
+ * components are cleared first, since multiplying an infinite or NaN alpha
+ * by 0 would otherwise make the luminance NaN.
+ */
+static inline __m256
+luminance_avx2 (__m256  rgba,
+                __m256d luminance)
+{
+  __m256d lo;
+  __m256d hi;
+
+  rgba = _mm256_blend_ps (rgba, _mm256_setzero_ps (), ALPHA_MASK);
+
+  lo = _mm256_mul_pd (_mm256_cvtps_pd (_mm256_castps256_ps128 (rgba)),
+                      luminance);
+  hi = _mm256_mul_pd (_mm256_cvtps_pd (_mm256_extractf128_ps (rgba, 1)),
+                      luminance);
+
+  lo = _mm256_hadd_pd (lo, lo);
+  hi = _mm256_hadd_pd (hi, hi);
+
+  lo = _mm256_add_pd (lo, _mm256_permute2f128_pd (lo, lo, 1));
+  hi = _mm256_add_pd (hi, _mm256_permute2f128_pd (hi, hi, 1));
+
+  return _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm256_cvtpd_ps (lo)),
+                               _mm256_cvtpd_ps (hi), 1);
+}
+
+static inline void
+blend_avx2 (GeglOperation          *operation,
+            const gfloat           *in,
+            const gfloat           *layer,
+            gfloat                 *comp,
+            gint                    samples,
+            BlendKernel             kernel,
+            GimpLayerModeBlendFunc  generic)
+{
+  while (samples >= 2)
+    {
+      __m256 v_in    = _mm256_loadu_ps (in);
+      __m256 v_layer = _mm256_loadu_ps (layer);
+      __m256 v_comp;
+
+      v_comp = kernel (v_in, v_layer);
+
+      /* comp[ALPHA] = layer[ALPHA] */
+      v_comp = _mm256_blend_ps (v_comp, v_layer, ALPHA_MASK);
+
+      _mm256_storeu_ps (comp, v_comp);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    generic (operation, in, layer, comp, samples);
+}
+
+
+/*  blend kernels  */
+
+
+static inline __m256
+kernel_addition (__m256 in,
+                 __m256 layer)
+{
+  return _mm256_add_ps (in, layer);
+}
+
+static inline __m256
+kernel_burn (__m256 in,
+             __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  return _mm256_sub_ps (v_one,
+                        safe_div (_mm256_sub_ps (v_one, in), layer));
+}
+
+static inline __m256
+kernel_darken_only (__m256 in,
+                    __m256 layer)
+{
+  /* MIN (in, layer) */
+  return _mm256_blendv_ps (layer, in,
+                           _mm256_cmp_ps (in, layer, _CMP_LT_OQ));
+}
+
+static inline __m256
+kernel_difference (__m256 in,
+                   __m256 layer)
+{
+  return _mm256_andnot_ps (_mm256_set1_ps (-0.0f),
+                           _mm256_sub_ps (in, layer));
+}
+
+static inline __m256
+kernel_divide (__m256 in,
+               __m256 layer)
+{
+  return safe_div (in, layer);
+}
+
+static inline __m256
+kernel_dodge (__m256 in,
+              __m256 layer)
+{
+  return safe_div (in, _mm256_sub_ps (_mm256_set1_ps (1.0f), layer));
+}
+
+static inline __m256
+kernel_exclusion (__m256 in,
+                  __m256 layer)
+{
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+
+  return _mm256_sub_ps (v_half,
+                        _mm256_mul_ps (_mm256_mul_ps (_mm256_set1_ps (2.0f),
+                                                      _mm256_sub_ps (in, v_half)),
+                                       _mm256_sub_ps (layer, v_half)));
+}
+
+static inline __m256
+kernel_grain_extract (__m256 in,
+                      __m256 layer)
+{
+  return _mm256_add_ps (_mm256_sub_ps (in, layer), _mm256_set1_ps (0.5f));
+}
+
+static inline __m256
+kernel_grain_merge (__m256 in,
+                    __m256 layer)
+{
+  return _mm256_sub_ps (_mm256_add_ps (in, layer), _mm256_set1_ps (0.5f));
+}
+
+static inline __m256
+kernel_hard_mix (__m256 in,
+                 __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  return _mm256_and_ps (_mm256_cmp_ps (_mm256_add_ps (in, layer), v_one,
+                                       _CMP_NLT_UQ),
+                        v_one);
+}
+
+static inline __m256
+kernel_hardlight (__m256 in,
+                  __m256 layer)
+{
+  const __m256 v_one  = _mm256_set1_ps (1.0f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+  __m256       high;
+  __m256       low;
+
+  high = _mm256_mul_ps (_mm256_sub_ps (v_one, in),
+                        _mm256_sub_ps (v_one,
+                                       _mm256_mul_ps (_mm256_sub_ps (layer,
+                                                                     v_half),
+                                                      v_two)));
+  high = _mm256_sub_ps (v_one, high);
+  high = _mm256_blendv_ps (v_one, high,
+                           _mm256_cmp_ps (high, v_one, _CMP_LT_OQ));
+
+  low = _mm256_mul_ps (in, _mm256_mul_ps (layer, v_two));
+  low = _mm256_blendv_ps (v_one, low,
+                          _mm256_cmp_ps (low, v_one, _CMP_LT_OQ));
+
+  return _mm256_blendv_ps (low, high,
+                           _mm256_cmp_ps (layer, v_half, _CMP_GT_OQ));
+}
+
+static inline __m256
+kernel_lch_color (__m256 in,
+                  __m256 layer)
+{
+  /* in[0], layer[1], layer[2] */
+  return _mm256_blend_ps (in, layer, 0x66);
+}
+
+static inline __m256
+kernel_lch_lightness (__m256 in,
+                      __m256 layer)
+{
+  /* layer[0], in[1], in[2] */
+  return _mm256_blend_ps (in, layer, 0x11);
+}
+
+static inline __m256
+kernel_lighten_only (__m256 in,
+                     __m256 layer)
+{
+  /* MAX (in, layer) */
+  return _mm256_blendv_ps (layer, in,
+                           _mm256_cmp_ps (in, layer, _CMP_GT_OQ));
+}
+
+static inline __m256
+kernel_linear_burn (__m256 in,
+                    __m256 layer)
+{
+  return _mm256_sub_ps (_mm256_add_ps (in, layer), _mm256_set1_ps (1.0f));
+}
+
+static inline __m256
+kernel_linear_light (__m256 in,
+                     __m256 layer)
+{
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+  __m256       low;
+  __m256       high;
+
+  low  = _mm256_sub_ps (_mm256_add_ps (in, _mm256_mul_ps (v_two, layer)),
+                        _mm256_set1_ps (1.0f));
+  high = _mm256_add_ps (in, _mm256_mul_ps (v_two,
+                                           _mm256_sub_ps (layer, v_half)));
+
+  return _mm256_blendv_ps (high, low,
+                           _mm256_cmp_ps (layer, v_half, _CMP_LE_OQ));
+}
+
+static inline __m256
+kernel_multiply (__m256 in,
+                 __m256 layer)
+{
+  return _mm256_mul_ps (in, layer);
+}
+
+static inline __m256
+kernel_overlay (__m256 in,
+                __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+  const __m256 v_two = _mm256_set1_ps (2.0f);
+  __m256       low;
+  __m256       high;
+
+  low  = _mm256_mul_ps (_mm256_mul_ps (v_two, in), layer);
+  high = _mm256_sub_ps (v_one,
+                        _mm256_mul_ps (_mm256_mul_ps (v_two,
+                                                      _mm256_sub_ps (v_one,
+                                                                     layer)),
+                                       _mm256_sub_ps (v_one, in)));
+
+  return _mm256_blendv_ps (high, low,
+                           _mm256_cmp_ps (in, _mm256_set1_ps (0.5f),
+                                          _CMP_LT_OQ));
+}
+
+static inline __m256
+kernel_pin_light (__m256 in,
+                  __m256 layer)
+{
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+  __m256       high;
+  __m256       low;
+
+  high = _mm256_mul_ps (v_two, _mm256_sub_ps (layer, v_half));
+  high = _mm256_blendv_ps (high, in, _mm256_cmp_ps (in, high, _CMP_GT_OQ));
+
+  low  = _mm256_mul_ps (v_two, layer);
+  low  = _mm256_blendv_ps (low, in, _mm256_cmp_ps (in, low, _CMP_LT_OQ));
+
+  return _mm256_blendv_ps (low, high,
+                           _mm256_cmp_ps (layer, v_half, _CMP_GT_OQ));
+}
+
+static inline __m256
+kernel_screen (__m256 in,
+               __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  return _mm256_sub_ps (v_one,
+                        _mm256_mul_ps (_mm256_sub_ps (v_one, in),
+                                       _mm256_sub_ps (v_one, layer)));
+}
+
+static inline __m256
+kernel_softlight (__m256 in,
+                  __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+  __m256       multiply;
+  __m256       screen;
+
+  multiply = _mm256_mul_ps (in, layer);
+  screen   = kernel_screen (in, layer);
+
+  return _mm256_add_ps (_mm256_mul_ps (_mm256_sub_ps (v_one, in), multiply),
+                        _mm256_mul_ps (in, screen));
+}
+
+static inline __m256
+kernel_subtract (__m256 in,
+                 __m256 layer)
+{
+  return _mm256_sub_ps (in, layer);
+}
+
+static inline __m256
+kernel_vivid_light (__m256 in,
+                    __m256 layer)
+{
+  const __m256 v_zero = _mm256_setzero_ps ();
+  const __m256 v_one  = _mm256_set1_ps (1.0f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  __m256       low;
+  __m256       high;
+
+  low  = _mm256_sub_ps (v_one,
+                        safe_div (_mm256_sub_ps (v_one, in),
+                                  _mm256_mul_ps (v_two, layer)));
+  low  = _mm256_blendv_ps (v_zero, low,
+                           _mm256_cmp_ps (low, v_zero, _CMP_GT_OQ));
+
+  high = safe_div (in, _mm256_mul_ps (v_two, _mm256_sub_ps (v_one, layer)));
+  high = _mm256_blendv_ps (v_one, high,
+                           _mm256_cmp_ps (high, v_one, _CMP_LT_OQ));
+
+  return _mm256_blendv_ps (high, low,
+                           _mm256_cmp_ps (layer, _mm256_set1_ps (0.5f),
+                                          _CMP_LE_OQ));
+}
+
+
+/*  public functions  */
+
+
+#define DEFINE_BLEND_FUNC(name)                                              \
+void                                                                         \
+gimp_operation_layer_mode_blend_##name##_avx2 (GeglOperation *operation,     \
+                                               const gfloat  *in,            \
+                                               const gfloat  *layer,         \
+                                               gfloat        *comp,          \
+                                               gint           samples)       \
+{                                                                            \
+  blend_avx2 (operation, in, layer, comp, samples,                           \
+              kernel_##name,                                                 \
+              gimp_operation_layer_mode_blend_##name);                       \
+}
+
+DEFINE_BLEND_FUNC (addition)
+DEFINE_BLEND_FUNC (burn)
+DEFINE_BLEND_FUNC (darken_only)
+DEFINE_BLEND_FUNC (difference)
+DEFINE_BLEND_FUNC (divide)
+DEFINE_BLEND_FUNC (dodge)
+DEFINE_BLEND_FUNC (exclusion)
+DEFINE_BLEND_FUNC (grain_extract)
+DEFINE_BLEND_FUNC (grain_merge)
+DEFINE_BLEND_FUNC (hard_mix)
+DEFINE_BLEND_FUNC (hardlight)
+DEFINE_BLEND_FUNC (lch_color)
+DEFINE_BLEND_FUNC (lch_lightness)
+DEFINE_BLEND_FUNC (lighten_only)
+DEFINE_BLEND_FUNC (linear_burn)
+DEFINE_BLEND_FUNC (linear_light)
+DEFINE_BLEND_FUNC (multiply)
+DEFINE_BLEND_FUNC (overlay)
+DEFINE_BLEND_FUNC (pin_light)
+DEFINE_BLEND_FUNC (screen)
+DEFINE_BLEND_FUNC (softlight)
+DEFINE_BLEND_FUNC (subtract)
+DEFINE_BLEND_FUNC (vivid_light)
+
+#undef DEFINE_BLEND_FUNC
+
+void
+gimp_operation_layer_mode_blend_luma_darken_only_avx2 (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples)
+{
+  const Babl *space = gimp_operation_layer_mode_get_input_space (operation);
+  double      red_luminance, green_luminance, blue_luminance;
+  __m256d     v_luminance;
+
+  babl_space_get_rgb_luminance (space,
+    &red_luminance, &green_luminance, &blue_luminance);
+
+  v_luminance = _mm256_setr_pd (red_luminance, green_luminance,
+                                blue_luminance, 0.0);
+
+  while (samples >= 2)
+    {
+      __m256 v_in    = _mm256_loadu_ps (in);
+      __m256 v_layer = _mm256_loadu_ps (layer);
+      __m256 dest_luminance;
+      __m256 src_luminance;
+      __m256 v_comp;
+
+      dest_luminance = luminance_avx2 (v_in,    v_luminance);
+      src_luminance  = luminance_avx2 (v_layer, v_luminance);
+
+      v_comp = _mm256_blendv_ps (v_layer, v_in,
+                                 _mm256_cmp_ps (dest_luminance, src_luminance,
+                                                _CMP_LE_OQ));
+      v_comp = _mm256_blend_ps (v_comp, v_layer, ALPHA_MASK);
+
+      _mm256_storeu_ps (comp, v_comp);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_blend_luma_darken_only (operation,
+                                                        in, layer, comp,
+                                                        samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_blend_luma_lighten_only_avx2 (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples)
+{
+  const Babl *space = gimp_operation_layer_mode_get_input_space (operation);
+  double      red_luminance, green_luminance, blue_luminance;
+  __m256d     v_luminance;
+
+  babl_space_get_rgb_luminance (space,
+    &red_luminance, &green_luminance, &blue_luminance);
+
+  v_luminance = _mm256_setr_pd (red_luminance, green_luminance,
+                                blue_luminance, 0.0);
+
+  while (samples >= 2)
+    {
+      __m256 v_in    = _mm256_loadu_ps (in);
+      __m256 v_layer = _mm256_loadu_ps (layer);
+      __m256 dest_luminance;
+      __m256 src_luminance;
+      __m256 v_comp;
+
+      dest_luminance = luminance_avx2 (v_in,    v_luminance);
+      src_luminance  = luminance_avx2 (v_layer, v_luminance);
+
+      v_comp = _mm256_blendv_ps (v_layer, v_in,
+                                 _mm256_cmp_ps (dest_luminance, src_luminance,
+                                                _CMP_GE_OQ));
+      v_comp = _mm256_blend_ps (v_comp, v_layer, ALPHA_MASK);
+
+      _mm256_storeu_ps (comp, v_comp);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_blend_luma_lighten_only (operation,
+                                                         in, layer, comp,
+                                                         samples);
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
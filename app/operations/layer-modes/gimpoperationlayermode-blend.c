@@ -32,6 +32,7 @@
 
 #include "../operations-types.h"
 
+#include "gimpoperationlayermode.h"
 #include "gimpoperationlayermode-blend.h"
 
 
@@ -815,7 +816,7 @@ gimp_operation_layer_mode_blend_luma_darken_only (GeglOperation *operation,
                                                   gfloat        *comp,
                                                   gint           samples)
 {
-  const Babl *space  = gegl_operation_get_source_space (operation, "input");
+  const Babl *space  = gimp_operation_layer_mode_get_input_space (operation);
   double red_luminance, green_luminance, blue_luminance;
   babl_space_get_rgb_luminance (space, 
     &red_luminance, &green_luminance, &blue_luminance);
@@ -863,7 +864,7 @@ gimp_operation_layer_mode_blend_luma_lighten_only (GeglOperation *operation,
                                                    gfloat        *comp,
                                                    gint           samples)
 {
-  const Babl *space  = gegl_operation_get_source_space (operation, "input");
+  const Babl *space  = gimp_operation_layer_mode_get_input_space (operation);
   double red_luminance, green_luminance, blue_luminance;
   babl_space_get_rgb_luminance (space, 
     &red_luminance, &green_luminance, &blue_luminance);
@@ -915,7 +916,7 @@ gimp_operation_layer_mode_blend_luminance (GeglOperation *operation,
   gfloat     *scratch;
   gfloat     *in_Y;
   gfloat     *layer_Y;
-  const Babl *space = gegl_operation_get_source_space (operation, "input");
+  const Babl *space = gimp_operation_layer_mode_get_input_space (operation);
 
   fish = babl_fish (babl_format_with_space ("RGBA float", space),
                     babl_format_with_space ("Y float",    space));
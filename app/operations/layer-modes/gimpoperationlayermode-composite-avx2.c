@@ -0,0 +1,576 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-composite-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-composite.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 */
+#include <immintrin.h>
+
+
+/* the alpha components of a pair of RGBA pixels */
+#define ALPHA_MASK 0x88
+
+
+/*  the functions in this file process two pixels per 256-bit vector.  all
+ *  the cases of the generic functions are evaluated for both pixels, and
+ *  the right one is selected per pixel, in the same order of precedence as
+ *  the generic code.  a trailing odd pixel is handled by the generic
+ *  function.
+ */
+
+
+/*  local function prototypes  */
+
+static inline __m256   get_alpha (__m256        rgba);
+static inline __m256   get_mask  (const gfloat *mask);
+static inline __m256   is_zero   (__m256        v);
+
+
+/*  private functions  */
+
+
+/* returns the alpha of each of the two pixels, broadcast over the pixel's
+ * components.
+ */
+static inline __m256
+get_alpha (__m256 rgba)
+{
+  return _mm256_permute_ps (rgba, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+/* returns mask[0] and mask[1], broadcast over the corresponding pixel's
+ * components.
+ */
+static inline __m256
+get_mask (const gfloat *mask)
+{
+  return _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm_set1_ps (mask[0])),
+                               _mm_set1_ps (mask[1]), 1);
+}
+
+static inline __m256
+is_zero (__m256 v)
+{
+  return _mm256_cmp_ps (v, _mm256_setzero_ps (), _CMP_EQ_OQ);
+}
+
+
+/*  public functions  */
+
+
+/*  non-subtractive compositing functions  */
+
+
+void
+gimp_operation_layer_mode_composite_union_avx2 (const gfloat *in,
+                                                const gfloat *layer,
+                                                const gfloat *comp,
+                                                const gfloat *mask,
+                                                gfloat        opacity,
+                                                gfloat       *out,
+                                                gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = get_alpha (v_in);
+      __m256 layer_alpha = _mm256_mul_ps (get_alpha (v_layer), v_opacity);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      new_alpha = _mm256_add_ps (layer_alpha,
+                                 _mm256_mul_ps (_mm256_sub_ps (v_one,
+                                                               layer_alpha),
+                                                in_alpha));
+
+      ratio = _mm256_div_ps (layer_alpha, new_alpha);
+
+      v_out = _mm256_mul_ps (in_alpha, _mm256_sub_ps (v_comp, v_layer));
+      v_out = _mm256_sub_ps (_mm256_add_ps (v_out, v_layer), v_in);
+      v_out = _mm256_add_ps (_mm256_mul_ps (ratio, v_out), v_in);
+
+      v_out = _mm256_blendv_ps (v_out, v_layer, is_zero (in_alpha));
+      v_out = _mm256_blendv_ps (v_out, v_in,
+                                _mm256_or_ps (is_zero (layer_alpha),
+                                              is_zero (new_alpha)));
+
+      v_out = _mm256_blend_ps (v_out, new_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union (in, layer, comp, mask,
+                                                 opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_avx2 (const gfloat *in,
+                                                           const gfloat *layer,
+                                                           const gfloat *comp,
+                                                           const gfloat *mask,
+                                                           gfloat        opacity,
+                                                           gfloat       *out,
+                                                           gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = get_alpha (v_in);
+      __m256 layer_alpha = _mm256_mul_ps (get_alpha (v_comp), v_opacity);
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      v_out = _mm256_add_ps (_mm256_mul_ps (v_comp, layer_alpha),
+                             _mm256_mul_ps (v_in,
+                                            _mm256_sub_ps (v_one,
+                                                           layer_alpha)));
+
+      v_out = _mm256_blendv_ps (v_out, v_in,
+                                _mm256_or_ps (is_zero (in_alpha),
+                                              is_zero (layer_alpha)));
+
+      v_out = _mm256_blend_ps (v_out, in_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop (in, layer, comp,
+                                                            mask, opacity,
+                                                            out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_layer_avx2 (const gfloat *in,
+                                                        const gfloat *layer,
+                                                        const gfloat *comp,
+                                                        const gfloat *mask,
+                                                        gfloat        opacity,
+                                                        gfloat       *out,
+                                                        gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = get_alpha (v_in);
+      __m256 layer_alpha = _mm256_mul_ps (get_alpha (v_layer), v_opacity);
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      v_out = _mm256_add_ps (_mm256_mul_ps (v_comp, in_alpha),
+                             _mm256_mul_ps (v_layer,
+                                            _mm256_sub_ps (v_one, in_alpha)));
+
+      v_out = _mm256_blendv_ps (v_out, v_layer, is_zero (in_alpha));
+      v_out = _mm256_blendv_ps (v_out, v_in,    is_zero (layer_alpha));
+
+      v_out = _mm256_blend_ps (v_out, layer_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_layer (in, layer, comp,
+                                                         mask, opacity,
+                                                         out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_intersection_avx2 (const gfloat *in,
+                                                       const gfloat *layer,
+                                                       const gfloat *comp,
+                                                       const gfloat *mask,
+                                                       gfloat        opacity,
+                                                       gfloat       *out,
+                                                       gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in      = _mm256_loadu_ps (in);
+      __m256 v_comp    = _mm256_loadu_ps (comp);
+      __m256 new_alpha;
+      __m256 v_out;
+
+      new_alpha = _mm256_mul_ps (_mm256_mul_ps (get_alpha (v_in),
+                                                get_alpha (v_comp)),
+                                 v_opacity);
+
+      if (mask)
+        {
+          new_alpha = _mm256_mul_ps (new_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      v_out = _mm256_blendv_ps (v_comp, v_in, is_zero (new_alpha));
+
+      v_out = _mm256_blend_ps (v_out, new_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_intersection (in, layer, comp,
+                                                        mask, opacity,
+                                                        out, samples);
+    }
+}
+
+
+/*  subtractive compositing functions  */
+
+
+void
+gimp_operation_layer_mode_composite_union_sub_avx2 (const gfloat *in,
+                                                    const gfloat *layer,
+                                                    const gfloat *comp,
+                                                    const gfloat *mask,
+                                                    gfloat        opacity,
+                                                    gfloat       *out,
+                                                    gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_two     = _mm256_set1_ps (2.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = get_alpha (v_in);
+      __m256 layer_alpha = _mm256_mul_ps (get_alpha (v_layer), v_opacity);
+      __m256 comp_alpha  = get_alpha (v_comp);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 layer_coeff;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      new_alpha = _mm256_mul_ps (_mm256_mul_ps (_mm256_sub_ps (v_two,
+                                                               comp_alpha),
+                                                in_alpha),
+                                 layer_alpha);
+      new_alpha = _mm256_sub_ps (_mm256_add_ps (in_alpha, layer_alpha),
+                                 new_alpha);
+
+      ratio       = _mm256_div_ps (in_alpha, new_alpha);
+      layer_coeff = _mm256_sub_ps (_mm256_div_ps (v_one, in_alpha), v_one);
+
+      v_out = _mm256_add_ps (_mm256_mul_ps (comp_alpha, v_comp),
+                             _mm256_mul_ps (layer_coeff, v_layer));
+      v_out = _mm256_mul_ps (layer_alpha, _mm256_sub_ps (v_out, v_in));
+      v_out = _mm256_mul_ps (ratio, _mm256_add_ps (v_out, v_in));
+
+      v_out = _mm256_blendv_ps (v_out, v_layer, is_zero (in_alpha));
+      v_out = _mm256_blendv_ps (v_out, v_in,
+                                _mm256_or_ps (is_zero (layer_alpha),
+                                              is_zero (new_alpha)));
+
+      v_out = _mm256_blend_ps (v_out, new_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union_sub (in, layer, comp, mask,
+                                                     opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_sub_avx2 (const gfloat *in,
+                                                               const gfloat *layer,
+                                                               const gfloat *comp,
+                                                               const gfloat *mask,
+                                                               gfloat        opacity,
+                                                               gfloat       *out,
+                                                               gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = get_alpha (v_in);
+      __m256 layer_alpha = _mm256_mul_ps (get_alpha (v_layer), v_opacity);
+      __m256 comp_alpha  = get_alpha (v_comp);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      comp_alpha = _mm256_mul_ps (comp_alpha, layer_alpha);
+
+      new_alpha = _mm256_add_ps (_mm256_sub_ps (v_one, layer_alpha),
+                                 comp_alpha);
+
+      ratio = _mm256_div_ps (comp_alpha, new_alpha);
+
+      v_out = _mm256_add_ps (_mm256_mul_ps (v_comp, ratio),
+                             _mm256_mul_ps (v_in,
+                                            _mm256_sub_ps (v_one, ratio)));
+
+      v_out = _mm256_blendv_ps (v_out, v_in,
+                                _mm256_or_ps (is_zero (in_alpha),
+                                              is_zero (comp_alpha)));
+
+      new_alpha = _mm256_mul_ps (new_alpha, in_alpha);
+
+      v_out = _mm256_blend_ps (v_out, new_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop_sub (in, layer,
+                                                                comp, mask,
+                                                                opacity,
+                                                                out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_layer_sub_avx2 (const gfloat *in,
+                                                            const gfloat *layer,
+                                                            const gfloat *comp,
+                                                            const gfloat *mask,
+                                                            gfloat        opacity,
+                                                            gfloat       *out,
+                                                            gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = get_alpha (v_in);
+      __m256 layer_alpha = _mm256_mul_ps (get_alpha (v_layer), v_opacity);
+      __m256 comp_alpha  = get_alpha (v_comp);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      comp_alpha = _mm256_mul_ps (comp_alpha, in_alpha);
+
+      new_alpha = _mm256_add_ps (_mm256_sub_ps (v_one, in_alpha),
+                                 comp_alpha);
+
+      ratio = _mm256_div_ps (comp_alpha, new_alpha);
+
+      v_out = _mm256_add_ps (_mm256_mul_ps (v_comp, ratio),
+                             _mm256_mul_ps (v_layer,
+                                            _mm256_sub_ps (v_one, ratio)));
+
+      v_out = _mm256_blendv_ps (v_out, v_layer, is_zero (in_alpha));
+      v_out = _mm256_blendv_ps (v_out, v_in,    is_zero (layer_alpha));
+
+      new_alpha = _mm256_mul_ps (new_alpha, layer_alpha);
+
+      v_out = _mm256_blend_ps (v_out, new_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_layer_sub (in, layer,
+                                                             comp, mask,
+                                                             opacity,
+                                                             out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_intersection_sub_avx2 (const gfloat *in,
+                                                           const gfloat *layer,
+                                                           const gfloat *comp,
+                                                           const gfloat *mask,
+                                                           gfloat        opacity,
+                                                           gfloat       *out,
+                                                           gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  while (samples >= 2)
+    {
+      __m256 v_in      = _mm256_loadu_ps (in);
+      __m256 v_layer   = _mm256_loadu_ps (layer);
+      __m256 v_comp    = _mm256_loadu_ps (comp);
+      __m256 new_alpha;
+      __m256 v_out;
+
+      new_alpha = _mm256_mul_ps (_mm256_mul_ps (_mm256_mul_ps (get_alpha (v_in),
+                                                               get_alpha (v_layer)),
+                                                get_alpha (v_comp)),
+                                 v_opacity);
+
+      if (mask)
+        {
+          new_alpha = _mm256_mul_ps (new_alpha, get_mask (mask));
+
+          mask += 2;
+        }
+
+      v_out = _mm256_blendv_ps (v_comp, v_in, is_zero (new_alpha));
+
+      v_out = _mm256_blend_ps (v_out, new_alpha, ALPHA_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in      += 8;
+      layer   += 8;
+      comp    += 8;
+      out     += 8;
+      samples -= 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_intersection_sub (in, layer, comp,
+                                                            mask, opacity,
+                                                            out, samples);
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
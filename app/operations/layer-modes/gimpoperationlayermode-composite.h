@@ -94,5 +94,67 @@ void gimp_operation_layer_mode_composite_clip_to_backdrop_sse2 (const gfloat
 
 #endif /* COMPILE_SSE2_INTRINISICS */
 
+#if COMPILE_AVX2_INTRINISICS
+
+void gimp_operation_layer_mode_composite_union_avx2                (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+void gimp_operation_layer_mode_composite_clip_to_backdrop_avx2     (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+void gimp_operation_layer_mode_composite_clip_to_layer_avx2        (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+void gimp_operation_layer_mode_composite_intersection_avx2         (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+
+void gimp_operation_layer_mode_composite_union_sub_avx2            (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+void gimp_operation_layer_mode_composite_clip_to_backdrop_sub_avx2 (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+void gimp_operation_layer_mode_composite_clip_to_layer_sub_avx2    (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+void gimp_operation_layer_mode_composite_intersection_sub_avx2     (const gfloat        *in,
+                                                                   const gfloat        *layer,
+                                                                   const gfloat        *comp,
+                                                                   const gfloat        *mask,
+                                                                   gfloat               opacity,
+                                                                   gfloat              *out,
+                                                                   gint                 samples);
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
 
 #endif /* __GIMP_OPERATION_LAYER_MODE_COMPOSITE_H__ */
@@ -205,6 +205,20 @@ gimp_operation_layer_mode_class_init (GimpOperationLayerModeClass *klass)
   if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
     composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_sse2;
 #endif
+
+#if COMPILE_AVX2_INTRINISICS
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2)
+    {
+      composite_union                = gimp_operation_layer_mode_composite_union_avx2;
+      composite_clip_to_backdrop     = gimp_operation_layer_mode_composite_clip_to_backdrop_avx2;
+      composite_clip_to_layer        = gimp_operation_layer_mode_composite_clip_to_layer_avx2;
+      composite_intersection         = gimp_operation_layer_mode_composite_intersection_avx2;
+      composite_union_sub            = gimp_operation_layer_mode_composite_union_sub_avx2;
+      composite_clip_to_backdrop_sub = gimp_operation_layer_mode_composite_clip_to_backdrop_sub_avx2;
+      composite_clip_to_layer_sub    = gimp_operation_layer_mode_composite_clip_to_layer_sub_avx2;
+      composite_intersection_sub     = gimp_operation_layer_mode_composite_intersection_sub_avx2;
+    }
+#endif
 }
 
 static void
@@ -663,7 +677,8 @@ gimp_operation_layer_mode_real_process (GeglOperation       *operation,
       /* Make sure the cache is set up from the start as the
        * operation's prepare() method may have not been run yet.
        */
-      gimp_operation_layer_mode_cache_fishes (layer_mode, NULL);
+      if (! layer_mode->cached_fish_format)
+        gimp_operation_layer_mode_cache_fishes (layer_mode, NULL);
       composite_to_blend_fish = layer_mode->space_fish [composite_space - 1]
                                                        [blend_space     - 1];
 
@@ -939,6 +954,46 @@ gimp_operation_layer_mode_cache_fishes (GimpOperationLayerMode *op,
 /*  public functions  */
 
 
+/* prepares @layer_mode for processing pixels outside of a graph, in the
+ * format returned by gimp_layer_mode_get_format() for @preferred_format.
+ */
+void
+gimp_operation_layer_mode_set_preferred_format (GimpOperationLayerMode *layer_mode,
+                                                const Babl             *preferred_format)
+{
+  g_return_if_fail (GIMP_IS_OPERATION_LAYER_MODE (layer_mode));
+
+  gimp_operation_layer_mode_cache_fishes (layer_mode, preferred_format);
+}
+
+/*  sets the space of the input, as seen by the blend functions, for
+ *  instances that process pixels on behalf of another operation, and
+ *  aren't connected to their input themselves.
+ */
+void
+gimp_operation_layer_mode_set_input_space (GimpOperationLayerMode *layer_mode,
+                                           const Babl             *space)
+{
+  g_return_if_fail (GIMP_IS_OPERATION_LAYER_MODE (layer_mode));
+
+  layer_mode->has_input_space = TRUE;
+  layer_mode->input_space     = space;
+}
+
+/*  returns the space of the input, which the blend functions use in place
+ *  of gegl_operation_get_source_space()
+ */
+const Babl *
+gimp_operation_layer_mode_get_input_space (GeglOperation *operation)
+{
+  GimpOperationLayerMode *layer_mode = (GimpOperationLayerMode *) operation;
+
+  if (GIMP_IS_OPERATION_LAYER_MODE (operation) && layer_mode->has_input_space)
+    return layer_mode->input_space;
+
+  return gegl_operation_get_source_space (operation, "input");
+}
+
 GimpLayerCompositeRegion
 gimp_operation_layer_mode_get_affected_region (GimpOperationLayerMode *layer_mode)
 {
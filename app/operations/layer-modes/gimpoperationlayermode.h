@@ -54,6 +54,12 @@ struct _GimpOperationLayerMode
   GimpLayerModeBlendFunc       blend_function;
   gboolean                     is_last_node;
   gboolean                     has_mask;
+
+  /* the space of the input, for instances that aren't connected to
+   * their input, see gimp_operation_layer_mode_set_input_space()
+   */
+  gboolean                     has_input_space;
+  const Babl                  *input_space;
 };
 
 struct _GimpOperationLayerModeClass
@@ -83,9 +89,15 @@ struct _GimpOperationLayerModeClass
 };
 
 
-GType                    gimp_operation_layer_mode_get_type            (void) G_GNUC_CONST;
+GType                    gimp_operation_layer_mode_get_type             (void) G_GNUC_CONST;
+
+void                     gimp_operation_layer_mode_set_preferred_format (GimpOperationLayerMode *layer_mode,
+                                                                         const Babl             *preferred_format);
+void                     gimp_operation_layer_mode_set_input_space      (GimpOperationLayerMode *layer_mode,
+                                                                         const Babl             *space);
+const Babl             * gimp_operation_layer_mode_get_input_space      (GeglOperation          *operation);
 
-GimpLayerCompositeRegion gimp_operation_layer_mode_get_affected_region (GimpOperationLayerMode *layer_mode);
+GimpLayerCompositeRegion gimp_operation_layer_mode_get_affected_region  (GimpOperationLayerMode *layer_mode);
 
 
 #endif /* __GIMP_OPERATION_LAYER_MODE_H__ */
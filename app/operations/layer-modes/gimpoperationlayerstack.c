@@ -0,0 +1,743 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayerstack.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gegl/gimptilehandlervalidate.h"
+
+#include "gimp-layer-modes.h"
+#include "gimpoperationlayermode.h"
+#include "gimpoperationlayerstack.h"
+
+
+/*  the operation composites a run of layers over its input in a single pass:
+ *  each chunk of the output is processed by all the layers in turn, while it
+ *  is still in the cache, rather than having every layer read and write an
+ *  intermediate buffer covering the entire roi, as a chain of "gimp:layer-mode"
+ *  nodes does.  the actual blending and compositing is performed by private
+ *  instances of the same layer-mode operations, hence the result is identical.
+ */
+
+
+enum
+{
+  PROP_0,
+  PROP_LAYERS
+};
+
+
+struct _GimpOperationLayerStackInfo
+{
+  GeglNode               *node;
+  GimpOperationLayerMode *layer_mode;
+  GimpLayerModeFunc       function;
+
+  const Babl             *format;
+  const Babl             *mask_format;
+
+  /* the layer bounds, in level-0 coordinates */
+  GeglRectangle           rect;
+
+  gboolean                is_last_node;
+  gboolean                use_last_node_shortcut;
+  gboolean                can_skip;
+};
+
+
+static void            gimp_operation_layer_stack_finalize         (GObject                 *object);
+static void            gimp_operation_layer_stack_get_property     (GObject                 *object,
+                                                                    guint                    property_id,
+                                                                    GValue                  *value,
+                                                                    GParamSpec              *pspec);
+static void            gimp_operation_layer_stack_set_property     (GObject                 *object,
+                                                                    guint                    property_id,
+                                                                    const GValue            *value,
+                                                                    GParamSpec              *pspec);
+
+static void            gimp_operation_layer_stack_prepare          (GeglOperation           *operation);
+static GeglRectangle   gimp_operation_layer_stack_get_bounding_box (GeglOperation           *operation);
+static gboolean        gimp_operation_layer_stack_operation_process
+                                                                   (GeglOperation           *operation,
+                                                                    GeglOperationContext    *context,
+                                                                    const gchar             *output_prop,
+                                                                    const GeglRectangle     *result,
+                                                                    gint                     level);
+static gboolean        gimp_operation_layer_stack_process          (GeglOperation           *operation,
+                                                                    GeglBuffer              *input,
+                                                                    GeglBuffer              *output,
+                                                                    const GeglRectangle     *roi,
+                                                                    gint                     level);
+
+static void            gimp_operation_layer_stack_clear            (GimpOperationLayerStack *self);
+static void            gimp_operation_layer_stack_validate_buffer  (GeglBuffer              *buffer,
+                                                                    const GeglRectangle     *rect);
+static GeglRectangle   gimp_operation_layer_stack_get_layer_rect   (GimpOperationLayerStackLayer *layer);
+static void            gimp_operation_layer_stack_process_last_node
+                                                                   (const gfloat            *layer,
+                                                                    const gfloat            *mask,
+                                                                    gfloat                   opacity,
+                                                                    gfloat                  *out,
+                                                                    gint                     samples);
+
+
+G_DEFINE_TYPE (GimpOperationLayerStack, gimp_operation_layer_stack,
+               GEGL_TYPE_OPERATION_FILTER)
+
+#define parent_class gimp_operation_layer_stack_parent_class
+
+
+static void
+gimp_operation_layer_stack_class_init (GimpOperationLayerStackClass *klass)
+{
+  GObjectClass             *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass       *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationFilterClass *filter_class    = GEGL_OPERATION_FILTER_CLASS (klass);
+
+  object_class->finalize           = gimp_operation_layer_stack_finalize;
+  object_class->set_property       = gimp_operation_layer_stack_set_property;
+  object_class->get_property       = gimp_operation_layer_stack_get_property;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:layer-stack",
+                                 "categories",  "compositors",
+                                 "description", "GIMP fused layer stack operation",
+                                 NULL);
+
+  operation_class->prepare          = gimp_operation_layer_stack_prepare;
+  operation_class->get_bounding_box = gimp_operation_layer_stack_get_bounding_box;
+  operation_class->process          = gimp_operation_layer_stack_operation_process;
+  operation_class->threaded         = TRUE;
+  operation_class->want_in_place    = FALSE;
+  operation_class->cache_policy     = GEGL_CACHE_POLICY_NEVER;
+
+  filter_class->process             = gimp_operation_layer_stack_process;
+
+  g_object_class_install_property (object_class, PROP_LAYERS,
+                                   g_param_spec_pointer ("layers",
+                                                         "Layers",
+                                                         "An array of GimpOperationLayerStackLayer, "
+                                                         "bottom to top, terminated by an element "
+                                                         "whose buffer is NULL",
+                                                         G_PARAM_READWRITE));
+}
+
+static void
+gimp_operation_layer_stack_init (GimpOperationLayerStack *self)
+{
+}
+
+static void
+gimp_operation_layer_stack_finalize (GObject *object)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (object);
+
+  gimp_operation_layer_stack_clear (self);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_layer_stack_get_property (GObject    *object,
+                                         guint       property_id,
+                                         GValue     *value,
+                                         GParamSpec *pspec)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (object);
+
+  switch (property_id)
+    {
+    case PROP_LAYERS:
+      g_value_set_pointer (value, self->layers);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_layer_stack_set_property (GObject      *object,
+                                         guint         property_id,
+                                         const GValue *value,
+                                         GParamSpec   *pspec)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (object);
+
+  switch (property_id)
+    {
+    case PROP_LAYERS:
+      {
+        const GimpOperationLayerStackLayer *layers = g_value_get_pointer (value);
+        gint                                i;
+
+        gimp_operation_layer_stack_clear (self);
+
+        if (! layers)
+          break;
+
+        while (layers[self->n_layers].buffer)
+          self->n_layers++;
+
+        self->layers = g_new0 (GimpOperationLayerStackLayer, self->n_layers + 1);
+        self->infos  = g_new0 (GimpOperationLayerStackInfo,  self->n_layers);
+
+        for (i = 0; i < self->n_layers; i++)
+          {
+            GimpOperationLayerStackLayer *layer = &self->layers[i];
+            GimpOperationLayerStackInfo  *info  = &self->infos[i];
+
+            *layer = layers[i];
+
+            g_object_ref (layer->buffer);
+
+            if (layer->mask)
+              g_object_ref (layer->mask);
+
+            if (layer->blend_space == GIMP_LAYER_COLOR_SPACE_AUTO)
+              layer->blend_space = gimp_layer_mode_get_blend_space (layer->mode);
+
+            if (layer->composite_space == GIMP_LAYER_COLOR_SPACE_AUTO)
+              layer->composite_space = gimp_layer_mode_get_composite_space (layer->mode);
+
+            if (layer->composite_mode == GIMP_LAYER_COMPOSITE_AUTO)
+              layer->composite_mode = gimp_layer_mode_get_composite_mode (layer->mode);
+
+            /* each layer gets a private layer-mode operation, so that we
+             * can configure it independently of any other node.
+             */
+            info->node = gegl_node_new_child (
+              NULL,
+              "operation", gimp_layer_mode_get_operation_name (layer->mode),
+              NULL);
+
+            info->layer_mode = GIMP_OPERATION_LAYER_MODE (
+              gegl_node_get_gegl_operation (info->node));
+
+            info->layer_mode->layer_mode      = layer->mode;
+            info->layer_mode->opacity         = layer->opacity;
+            info->layer_mode->blend_space     = layer->blend_space;
+            info->layer_mode->composite_space = layer->composite_space;
+            info->layer_mode->blend_function  =
+              gimp_layer_mode_get_blend_function (layer->mode);
+
+            info->function =
+              GIMP_OPERATION_LAYER_MODE_GET_CLASS (info->layer_mode)->process;
+          }
+      }
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_layer_stack_prepare (GeglOperation *operation)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (operation);
+  const GeglRectangle     *input_extent;
+  const Babl              *preferred_format = NULL;
+  const Babl              *input_space;
+  gboolean                 has_input;
+  gint                     i;
+
+  input_extent = gegl_operation_source_get_bounding_box (operation, "input");
+  input_space  = gegl_operation_get_source_space (operation, "input");
+
+  has_input = input_extent && ! gegl_rectangle_is_empty (input_extent);
+
+  if (has_input)
+    preferred_format = gegl_operation_get_source_format (operation, "input");
+
+  for (i = 0; i < self->n_layers; i++)
+    {
+      GimpOperationLayerStackLayer *layer      = &self->layers[i];
+      GimpOperationLayerStackInfo  *info       = &self->infos[i];
+      GimpOperationLayerMode       *layer_mode = info->layer_mode;
+      GimpLayerCompositeRegion      included_region;
+      GimpLayerCompositeRegion      affected_region;
+
+      info->rect = gimp_operation_layer_stack_get_layer_rect (layer);
+
+      layer_mode->composite_mode = layer->composite_mode;
+      layer_mode->function       = info->function;
+
+      /* the private operations aren't connected to an input, so give
+       * them the space their input would have in the per-layer chain,
+       * for the blend functions that depend on it.
+       */
+      gimp_operation_layer_mode_set_input_space (layer_mode, input_space);
+
+      affected_region =
+        gimp_operation_layer_mode_get_affected_region (layer_mode);
+
+      /* like "gimp:layer-mode", the bottom layer is rendered (as if) using
+       * UNION mode.
+       */
+      info->is_last_node           = ! has_input;
+      info->use_last_node_shortcut = FALSE;
+
+      layer_mode->is_last_node = info->is_last_node;
+
+      if (info->is_last_node)
+        {
+          if (affected_region & GIMP_LAYER_COMPOSITE_REGION_SOURCE)
+            layer_mode->composite_mode = GIMP_LAYER_COMPOSITE_UNION;
+          else
+            info->use_last_node_shortcut = TRUE;
+
+          preferred_format = gegl_buffer_get_format (layer->buffer);
+        }
+
+      included_region =
+        gimp_layer_mode_get_included_region (layer->mode,
+                                             layer_mode->composite_mode);
+
+      /* layers that don't affect the backdrop outside of their bounds can
+       * be skipped for chunks they don't intersect.
+       */
+      info->can_skip =
+        ! info->is_last_node                                           &&
+        (included_region & GIMP_LAYER_COMPOSITE_REGION_DESTINATION)    &&
+        ! (affected_region & GIMP_LAYER_COMPOSITE_REGION_DESTINATION);
+
+      gimp_operation_layer_mode_set_preferred_format (layer_mode,
+                                                      preferred_format);
+
+      info->format = gimp_layer_mode_get_format (layer->mode,
+                                                 layer->blend_space,
+                                                 layer->composite_space,
+                                                 layer_mode->composite_mode,
+                                                 preferred_format);
+      info->mask_format = babl_format_with_space ("Y float", info->format);
+
+      preferred_format = info->format;
+      input_space      = babl_format_get_space (info->format);
+
+      if (! has_input)
+        {
+          has_input = ! gegl_rectangle_is_empty (&info->rect) &&
+                      layer->opacity != 0.0;
+        }
+    }
+
+  if (self->n_layers > 0)
+    {
+      gegl_operation_set_format (operation, "input",  self->infos[0].format);
+      gegl_operation_set_format (operation, "output",
+                                 self->infos[self->n_layers - 1].format);
+    }
+  else
+    {
+      gegl_operation_set_format (operation, "input",
+                                 babl_format_with_space ("RGBA float",
+                                                         preferred_format));
+      gegl_operation_set_format (operation, "output",
+                                 babl_format_with_space ("RGBA float",
+                                                         preferred_format));
+    }
+}
+
+static GeglRectangle
+gimp_operation_layer_stack_get_bounding_box (GeglOperation *operation)
+{
+  GimpOperationLayerStack *self   = GIMP_OPERATION_LAYER_STACK (operation);
+  GeglRectangle            result = {};
+  GeglRectangle           *in_rect;
+  gint                     i;
+
+  in_rect = gegl_operation_source_get_bounding_box (operation, "input");
+
+  if (in_rect)
+    result = *in_rect;
+
+  /* same as gimp_operation_layer_mode_get_bounding_box(), applied to each
+   * layer in turn.
+   */
+  for (i = 0; i < self->n_layers; i++)
+    {
+      GimpOperationLayerStackLayer *layer    = &self->layers[i];
+      GeglRectangle                 src_rect;
+      GeglRectangle                 dst_rect = result;
+      GimpLayerCompositeRegion      included_region;
+
+      src_rect = gimp_operation_layer_stack_get_layer_rect (layer);
+
+      if (gegl_rectangle_is_empty (&dst_rect))
+        {
+          included_region = GIMP_LAYER_COMPOSITE_REGION_SOURCE;
+        }
+      else
+        {
+          included_region =
+            gimp_layer_mode_get_included_region (layer->mode,
+                                                 layer->composite_mode);
+        }
+
+      if (layer->opacity == 0.0)
+        included_region &= ~GIMP_LAYER_COMPOSITE_REGION_SOURCE;
+
+      gegl_rectangle_intersect (&result, &src_rect, &dst_rect);
+
+      if (included_region & GIMP_LAYER_COMPOSITE_REGION_SOURCE)
+        gegl_rectangle_bounding_box (&result, &result, &src_rect);
+
+      if (included_region & GIMP_LAYER_COMPOSITE_REGION_DESTINATION)
+        gegl_rectangle_bounding_box (&result, &result, &dst_rect);
+    }
+
+  return result;
+}
+
+static gboolean
+gimp_operation_layer_stack_operation_process (GeglOperation        *operation,
+                                              GeglOperationContext *context,
+                                              const gchar          *output_prop,
+                                              const GeglRectangle  *result,
+                                              gint                  level)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (operation);
+  gint                     i;
+
+  /* validate the layer buffers before processing, like
+   * "gimp:buffer-source-validate" does, since the actual processing may
+   * happen in multiple threads.
+   */
+  for (i = 0; i < self->n_layers; i++)
+    {
+      GimpOperationLayerStackLayer *layer = &self->layers[i];
+      GeglRectangle                 rect;
+
+      rect.x      = (result->x << level) - layer->offset_x;
+      rect.y      = (result->y << level) - layer->offset_y;
+      rect.width  = result->width  << level;
+      rect.height = result->height << level;
+
+      gimp_operation_layer_stack_validate_buffer (layer->buffer, &rect);
+
+      if (layer->mask)
+        gimp_operation_layer_stack_validate_buffer (layer->mask, &rect);
+    }
+
+  return GEGL_OPERATION_CLASS (parent_class)->process (operation, context,
+                                                       output_prop, result,
+                                                       level);
+}
+
+static gboolean
+gimp_operation_layer_stack_process (GeglOperation       *operation,
+                                    GeglBuffer          *input,
+                                    GeglBuffer          *output,
+                                    const GeglRectangle *roi,
+                                    gint                 level)
+{
+  GimpOperationLayerStack *self       = GIMP_OPERATION_LAYER_STACK (operation);
+  const Babl              *in_format  = gegl_operation_get_format (operation,
+                                                                   "input");
+  const Babl              *out_format = gegl_operation_get_format (operation,
+                                                                   "output");
+  GeglBufferIterator      *iter;
+  gdouble                  scale      = 1.0 / (1 << level);
+
+  iter = gegl_buffer_iterator_new (output, roi, level, out_format,
+                                   GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 2);
+
+  if (input)
+    {
+      gegl_buffer_iterator_add (iter, input, roi, level, in_format,
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const GeglRectangle *rect     = &iter->items[0].roi;
+      gint                 samples  = iter->length;
+      gfloat              *out      = iter->items[0].data;
+      gfloat              *temp;
+      gfloat              *layer_data;
+      gfloat              *mask_data;
+      gfloat              *bufs[2];
+      const gfloat        *src;
+      const Babl          *src_format;
+      GeglRectangle        level_0_rect;
+      gint                 i;
+
+      temp       = gegl_scratch_new (gfloat, 4 * samples);
+      layer_data = gegl_scratch_new (gfloat, 4 * samples);
+      mask_data  = gegl_scratch_new (gfloat,     samples);
+
+      bufs[0] = out;
+      bufs[1] = temp;
+
+      if (input)
+        {
+          src = iter->items[1].data;
+        }
+      else
+        {
+          memset (out, 0, 4 * samples * sizeof (gfloat));
+
+          src = out;
+        }
+
+      src_format = in_format;
+
+      level_0_rect.x      = rect->x      << level;
+      level_0_rect.y      = rect->y      << level;
+      level_0_rect.width  = rect->width  << level;
+      level_0_rect.height = rect->height << level;
+
+      for (i = 0; i < self->n_layers; i++)
+        {
+          GimpOperationLayerStackLayer *layer = &self->layers[i];
+          GimpOperationLayerStackInfo  *info  = &self->infos[i];
+          gfloat                       *dest;
+          GeglRectangle                 layer_rect;
+
+          if (info->can_skip &&
+              (layer->opacity == 0.0 ||
+               ! gegl_rectangle_intersect (NULL, &info->rect, &level_0_rect)))
+            {
+              continue;
+            }
+
+          /* process into whichever buffer doesn't hold the source.  an
+           * input-buffer source is read only, hence it's as good as any.
+           */
+          dest = (src == bufs[0]) ? bufs[1] : bufs[0];
+
+          if (src_format != info->format)
+            {
+              babl_process (babl_fish (src_format, info->format),
+                            src, dest, samples);
+
+              src  = dest;
+              dest = (src == bufs[0]) ? bufs[1] : bufs[0];
+
+              src_format = info->format;
+            }
+
+          layer_rect.x      = rect->x - (layer->offset_x >> level);
+          layer_rect.y      = rect->y - (layer->offset_y >> level);
+          layer_rect.width  = rect->width;
+          layer_rect.height = rect->height;
+
+          gegl_buffer_get (layer->buffer, &layer_rect, scale,
+                           info->format, layer_data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          if (layer->mask)
+            {
+              gegl_buffer_get (layer->mask, &layer_rect, scale,
+                               info->mask_format, mask_data,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+            }
+
+          if (info->use_last_node_shortcut)
+            {
+              gimp_operation_layer_stack_process_last_node (
+                layer_data, layer->mask ? mask_data : NULL, layer->opacity,
+                dest, samples);
+            }
+          else
+            {
+              info->function ((GeglOperation *) info->layer_mode,
+                              (gpointer) src, layer_data,
+                              layer->mask ? mask_data : NULL,
+                              dest, samples, rect, level);
+            }
+
+          src = dest;
+        }
+
+      if (src_format != out_format)
+        {
+          babl_process (babl_fish (src_format, out_format),
+                        src, out, samples);
+        }
+      else if (src != out)
+        {
+          memcpy (out, src, 4 * samples * sizeof (gfloat));
+        }
+
+      gegl_scratch_free (mask_data);
+      gegl_scratch_free (layer_data);
+      gegl_scratch_free (temp);
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_operation_layer_stack_clear (GimpOperationLayerStack *self)
+{
+  gint i;
+
+  for (i = 0; i < self->n_layers; i++)
+    {
+      g_clear_object (&self->layers[i].buffer);
+      g_clear_object (&self->layers[i].mask);
+
+      g_clear_object (&self->infos[i].node);
+    }
+
+  g_clear_pointer (&self->layers, g_free);
+  g_clear_pointer (&self->infos,  g_free);
+
+  self->n_layers = 0;
+}
+
+static void
+gimp_operation_layer_stack_validate_buffer (GeglBuffer          *buffer,
+                                            const GeglRectangle *rect)
+{
+  GimpTileHandlerValidate *validate_handler;
+  GeglRectangle            validate_rect;
+
+  validate_handler = gimp_tile_handler_validate_get_assigned (buffer);
+
+  if (validate_handler &&
+      gegl_rectangle_intersect (&validate_rect, rect,
+                                gegl_buffer_get_extent (buffer)))
+    {
+      /* align the rectangle to the tile grid */
+      gegl_rectangle_align_to_buffer (&validate_rect, &validate_rect, buffer,
+                                      GEGL_RECTANGLE_ALIGNMENT_SUPERSET);
+
+      gimp_tile_handler_validate_validate (validate_handler,
+                                           buffer,
+                                           &validate_rect,
+                                           TRUE, FALSE);
+    }
+}
+
+static GeglRectangle
+gimp_operation_layer_stack_get_layer_rect (GimpOperationLayerStackLayer *layer)
+{
+  GeglRectangle rect = *gegl_buffer_get_extent (layer->buffer);
+
+  if (layer->mask)
+    gegl_rectangle_intersect (&rect, &rect, gegl_buffer_get_extent (layer->mask));
+
+  rect.x += layer->offset_x;
+  rect.y += layer->offset_y;
+
+  return rect;
+}
+
+/* same as the "last node" shortcut of "gimp:layer-mode" */
+static void
+gimp_operation_layer_stack_process_last_node (const gfloat *layer,
+                                              const gfloat *mask,
+                                              gfloat        opacity,
+                                              gfloat       *out,
+                                              gint          samples)
+{
+  while (samples--)
+    {
+      memcpy (out, layer, 3 * sizeof (gfloat));
+
+      out[ALPHA] = layer[ALPHA] * opacity;
+      if (mask)
+        out[ALPHA] *= *mask++;
+
+      layer += 4;
+      out   += 4;
+    }
+}
+
+
+/*  public functions  */
+
+void
+gimp_operation_layer_stack_set_layers (GeglNode                           *node,
+                                       const GimpOperationLayerStackLayer *layers,
+                                       gint                                n_layers)
+{
+  GimpOperationLayerStackLayer *terminated;
+
+  g_return_if_fail (GEGL_IS_NODE (node));
+  g_return_if_fail (layers != NULL || n_layers == 0);
+
+  terminated = g_new0 (GimpOperationLayerStackLayer, n_layers + 1);
+
+  if (n_layers > 0)
+    memcpy (terminated, layers, n_layers * sizeof (GimpOperationLayerStackLayer));
+
+  gegl_node_set (node,
+                 "layers", terminated,
+                 NULL);
+
+  g_free (terminated);
+}
+
+gboolean
+gimp_operation_layer_stack_equal_layers (GeglNode                           *node,
+                                         const GimpOperationLayerStackLayer *layers,
+                                         gint                                n_layers)
+{
+  GimpOperationLayerStack *self;
+  gint                     i;
+
+  g_return_val_if_fail (GEGL_IS_NODE (node), FALSE);
+
+  self = GIMP_OPERATION_LAYER_STACK (gegl_node_get_gegl_operation (node));
+
+  if (self->n_layers != n_layers)
+    return FALSE;
+
+  for (i = 0; i < n_layers; i++)
+    {
+      const GimpOperationLayerStackLayer *a = &self->layers[i];
+      const GimpOperationLayerStackLayer *b = &layers[i];
+
+      if (a->buffer   != b->buffer   ||
+          a->mask     != b->mask     ||
+          a->offset_x != b->offset_x ||
+          a->offset_y != b->offset_y ||
+          a->mode     != b->mode     ||
+          a->opacity  != b->opacity)
+        {
+          return FALSE;
+        }
+
+      /* the stored spaces and composite mode are resolved */
+      if ((b->blend_space != GIMP_LAYER_COLOR_SPACE_AUTO &&
+           a->blend_space != b->blend_space)                 ||
+          (b->composite_space != GIMP_LAYER_COLOR_SPACE_AUTO &&
+           a->composite_space != b->composite_space)         ||
+          (b->composite_mode != GIMP_LAYER_COMPOSITE_AUTO &&
+           a->composite_mode != b->composite_mode))
+        {
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
@@ -0,0 +1,86 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayerstack.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_OPERATION_LAYER_STACK_H__
+#define __GIMP_OPERATION_LAYER_STACK_H__
+
+
+#include <gegl-plugin.h>
+
+
+#define GIMP_TYPE_OPERATION_LAYER_STACK            (gimp_operation_layer_stack_get_type ())
+#define GIMP_OPERATION_LAYER_STACK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStack))
+#define GIMP_OPERATION_LAYER_STACK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStackClass))
+#define GIMP_IS_OPERATION_LAYER_STACK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_OPERATION_LAYER_STACK))
+#define GIMP_IS_OPERATION_LAYER_STACK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_OPERATION_LAYER_STACK))
+#define GIMP_OPERATION_LAYER_STACK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStackClass))
+
+
+typedef struct _GimpOperationLayerStackLayer GimpOperationLayerStackLayer;
+typedef struct _GimpOperationLayerStackInfo  GimpOperationLayerStackInfo;
+typedef struct _GimpOperationLayerStack      GimpOperationLayerStack;
+typedef struct _GimpOperationLayerStackClass GimpOperationLayerStackClass;
+
+/* a single layer of the stack, composited over the layers below it exactly
+ * like a "gimp:layer-mode" node whose "aux" input is @buffer translated by
+ * (@offset_x, @offset_y), and whose "aux2" input is @mask, translated by the
+ * same offset.
+ */
+struct _GimpOperationLayerStackLayer
+{
+  GeglBuffer             *buffer;
+  GeglBuffer             *mask;
+  gint                    offset_x;
+  gint                    offset_y;
+
+  GimpLayerMode           mode;
+  GimpLayerColorSpace     blend_space;
+  GimpLayerColorSpace     composite_space;
+  GimpLayerCompositeMode  composite_mode;
+  gdouble                 opacity;
+};
+
+struct _GimpOperationLayerStack
+{
+  GeglOperationFilter           parent_instance;
+
+  /* bottom to top */
+  GimpOperationLayerStackLayer *layers;
+  gint                          n_layers;
+
+  GimpOperationLayerStackInfo  *infos;
+};
+
+struct _GimpOperationLayerStackClass
+{
+  GeglOperationFilterClass  parent_class;
+};
+
+
+GType      gimp_operation_layer_stack_get_type        (void) G_GNUC_CONST;
+
+void       gimp_operation_layer_stack_set_layers      (GeglNode                           *node,
+                                                       const GimpOperationLayerStackLayer *layers,
+                                                       gint                                n_layers);
+gboolean   gimp_operation_layer_stack_equal_layers    (GeglNode                           *node,
+                                                       const GimpOperationLayerStackLayer *layers,
+                                                       gint                                n_layers);
+
+
+#endif /* __GIMP_OPERATION_LAYER_STACK_H__ */
@@ -224,6 +224,9 @@ gimp_brush_core_finalize (GObject *object)
 
   g_clear_pointer (&core->pressure_brush, gimp_temp_buf_unref);
 
+  g_clear_pointer (&core->transform_brush,  gimp_temp_buf_unref);
+  g_clear_pointer (&core->transform_pixmap, gimp_temp_buf_unref);
+
   for (i = 0; i < BRUSH_CORE_SOLID_SUBSAMPLE; i++)
     for (j = 0; j < BRUSH_CORE_SOLID_SUBSAMPLE; j++)
       g_clear_pointer (&core->solid_brushes[i][j], gimp_temp_buf_unref);
@@ -1065,7 +1068,13 @@ gimp_brush_core_transform_mask (GimpBrushCore *core,
                                     core->hardness);
 
   if (mask == core->transform_brush)
-    return mask;
+    {
+      gimp_temp_buf_unref (mask);
+
+      return core->transform_brush;
+    }
+
+  g_clear_pointer (&core->transform_brush, gimp_temp_buf_unref);
 
   core->transform_brush         = mask;
   core->subsample_cache_invalid = TRUE;
@@ -1131,7 +1140,13 @@ gimp_brush_core_get_brush_pixmap (GimpBrushCore *core)
                                         core->hardness);
 
   if (pixmap == core->transform_pixmap)
-    return pixmap;
+    {
+      gimp_temp_buf_unref (pixmap);
+
+      return core->transform_pixmap;
+    }
+
+  g_clear_pointer (&core->transform_pixmap, gimp_temp_buf_unref);
 
   core->transform_pixmap        = pixmap;
   core->subsample_cache_invalid = TRUE;
@@ -0,0 +1,895 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpheal-laplace.c
+ * Copyright (C) Jean-Yves Couleaud <cjyves@free.fr>
+ * Copyright (C) 2013 Loren Merritt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-types.h"
+
+#include "gimpheal-laplace.h"
+
+
+/* NOTES
+ *
+ * We solve DeltaI=0 (Laplace) for the pixels inside the mask, with
+ * Dirichlet conditions given by the pixels outside the mask, and Neumann
+ * conditions at the edges of the canvas.
+ *
+ * Small areas are solved with a red/black checker Gauss-Seidel with
+ * over-relaxation.  Its convergence rate degrades with the size of the
+ * area, so larger areas are solved with multigrid V-cycles instead: the
+ * residual of a few Gauss-Seidel sweeps is restricted to a grid of half
+ * the size, whose solution is used to correct the low-frequency error
+ * that Gauss-Seidel is slow to remove, recursively.  Both solvers stop at
+ * the same tolerance.
+ */
+
+/* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
+#define EPSILON  (0.1/255)
+#define MAX_ITER 500
+
+/* areas whose width or height is below this size are solved with SOR */
+#define MULTIGRID_MIN_SIZE       64
+/* stop coarsening once both dimensions are at most this size */
+#define MULTIGRID_COARSEST_SIZE  8
+#define MULTIGRID_MAX_CYCLES     30
+#define MULTIGRID_PRE_SMOOTH     2
+#define MULTIGRID_POST_SMOOTH    2
+#define MULTIGRID_OMEGA          1.15
+#define MULTIGRID_COARSEST_ITER  64
+#define MULTIGRID_COARSEST_OMEGA 1.5
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
+typedef struct
+{
+  gint    width;
+  gint    height;
+  gfloat *x;    /*  the pixels at the finest level, the correction otherwise  */
+  gfloat *b;    /*  the right-hand side, or NULL at the finest level          */
+  gfloat *r;    /*  the residual                                               */
+  guchar *mask; /*  nonzero for unknown cells                                  */
+} HealLevel;
+
+typedef struct
+{
+  HealLevel *level;
+  HealLevel *coarse;
+  gint       depth;
+  gint       parity;
+  gfloat     omega;
+
+  GMutex     mutex;
+  gdouble    err;
+} HealMultigridData;
+
+
+/*  local function prototypes  */
+
+static void      gimp_heal_laplace_loop               (gfloat            *pixels,
+                                                       gint               height,
+                                                       gint               depth,
+                                                       gint               width,
+                                                       const guchar      *mask);
+
+static gboolean  gimp_heal_laplace_multigrid          (gfloat            *pixels,
+                                                       gint               width,
+                                                       gint               height,
+                                                       gint               depth,
+                                                       const guchar      *mask);
+
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+static float
+gimp_heal_laplace_iteration_sse (gfloat *pixels,
+                                 gfloat *Adiag,
+                                 gint   *Aidx,
+                                 gfloat  w,
+                                 gint    nmask)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint i;
+  v4sf wv  = { w, w, w, w };
+  v4sf err = { 0, 0, 0, 0 };
+  union { v4sf v; float f[4]; } erru;
+
+#define Xv(j) (*(v4sf*)&pixels[Aidx[i * 5 + j]])
+
+  for (i = 0; i < nmask; i++)
+    {
+      v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+      v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
+
+      Xv(0) -= diff;
+      err += diff * diff;
+    }
+
+  erru.v = err;
+
+  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
+}
+#endif
+
+/* Perform one iteration of Gauss-Seidel, and return the sum squared residual.
+ */
+static float
+gimp_heal_laplace_iteration (gfloat *pixels,
+                             gfloat *Adiag,
+                             gint   *Aidx,
+                             gfloat  w,
+                             gint    nmask,
+                             gint    depth)
+{
+  gint   i, k;
+  gfloat err = 0;
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+  if (depth == 4)
+    return gimp_heal_laplace_iteration_sse (pixels, Adiag, Aidx, w, nmask);
+#endif
+
+  for (i = 0; i < nmask; i++)
+    {
+      gint   j0 = Aidx[i * 5 + 0];
+      gint   j1 = Aidx[i * 5 + 1];
+      gint   j2 = Aidx[i * 5 + 2];
+      gint   j3 = Aidx[i * 5 + 3];
+      gint   j4 = Aidx[i * 5 + 4];
+      gfloat a  = Adiag[i];
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat diff = (a * pixels[j0 + k] -
+                         w * (pixels[j1 + k] +
+                              pixels[j2 + k] +
+                              pixels[j3 + k] +
+                              pixels[j4 + k]));
+
+          pixels[j0 + k] -= diff;
+          err += diff * diff;
+        }
+    }
+
+  return err;
+}
+
+/* Solve the laplace equation for pixels and store the result in-place.
+ */
+static void
+gimp_heal_laplace_loop (gfloat       *pixels,
+                        gint          height,
+                        gint          depth,
+                        gint          width,
+                        const guchar *mask)
+{
+  gint    i, j, iter, parity, nmask, zero;
+  gfloat *Adiag;
+  gint   *Aidx;
+  gfloat  w;
+
+  Adiag = g_new (gfloat, width * height);
+  Aidx  = g_new (gint, 5 * width * height);
+
+  /* All off-diagonal elements of A are either -1 or 0. We could store it as a
+   * general-purpose sparse matrix, but that adds some unnecessary overhead to
+   * the inner loop. Instead, assume exactly 4 off-diagonal elements in each
+   * row, all of which have value -1. Any row that in fact wants less than 4
+   * coefs can put them in a dummy column to be multiplied by an empty pixel.
+   */
+  zero = depth * width * height;
+  memset (pixels + zero, 0, depth * sizeof (gfloat));
+
+  /* Construct the system of equations.
+   * Arrange Aidx in checkerboard order, so that a single linear pass over that
+   * array results updating all of the red cells and then all of the black cells.
+   */
+  nmask = 0;
+  for (parity = 0; parity < 2; parity++)
+    for (i = 0; i < height; i++)
+      for (j = (i&1)^parity; j < width; j+=2)
+        if (mask[j + i * width])
+          {
+#define A_NEIGHBOR(o,di,dj) \
+            if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
+              Aidx[o + nmask * 5] = zero; \
+            else                                               \
+              Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
+
+            /* Omit Dirichlet conditions for any neighbors off the
+             * edge of the canvas.
+             */
+            Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
+            A_NEIGHBOR (0,  0,  0);
+            A_NEIGHBOR (1,  0,  1);
+            A_NEIGHBOR (2,  1,  0);
+            A_NEIGHBOR (3,  0, -1);
+            A_NEIGHBOR (4, -1,  0);
+            nmask++;
+          }
+
+  /* Empirically optimal over-relaxation factor. (Benchmarked on
+   * round brushes, at least. I don't know whether aspect ratio
+   * affects it.)
+   */
+  w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
+  w *= 0.25;
+  for (i = 0; i < nmask; i++)
+    Adiag[i] *= w;
+
+  /* Gauss-Seidel with successive over-relaxation */
+  for (iter = 0; iter < MAX_ITER; iter++)
+    {
+      gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
+                                                w, nmask, depth);
+      if (err < EPSILON * EPSILON * w * w)
+        break;
+    }
+
+  g_free (Adiag);
+  g_free (Aidx);
+}
+
+/*  one red/black Gauss-Seidel half-sweep over the cells [x0, x1) of a row */
+static void
+gimp_heal_multigrid_smooth_row (const HealLevel *level,
+                                gint             depth,
+                                gint             y,
+                                gint             x0,
+                                gint             x1,
+                                gint             parity,
+                                gfloat           omega)
+{
+  static const gfloat  inv_n[5] = { 0.0, 1.0, 1.0 / 2.0, 1.0 / 3.0, 1.0 / 4.0 };
+  gint                 width    = level->width;
+  gint                 height   = level->height;
+  gint                 stride   = width * depth;
+  const guchar        *m        = level->mask + y * width;
+  gfloat              *x        = level->x    + y * stride;
+  const gfloat        *b        = level->b ? level->b + y * stride : NULL;
+  gint                 i;
+
+  for (i = x0 + ((x0 + y + parity) & 1); i < x1; i += 2)
+    {
+      gfloat *p    = x + i * depth;
+      gfloat  s[4] = { 0, };
+      gint    n    = 0;
+      gint    k;
+
+      if (! m[i])
+        continue;
+
+      /* omit the neighbors off the edge of the canvas */
+#define ADD_NEIGHBOR(cond, offset)             \
+      if (cond)                                 \
+        {                                       \
+          for (k = 0; k < depth; k++)           \
+            s[k] += p[(offset) + k];            \
+          n++;                                  \
+        }
+
+      ADD_NEIGHBOR (i > 0,          -depth);
+      ADD_NEIGHBOR (i < width - 1,  +depth);
+      ADD_NEIGHBOR (y > 0,          -stride);
+      ADD_NEIGHBOR (y < height - 1, +stride);
+
+#undef ADD_NEIGHBOR
+
+      if (b)
+        {
+          for (k = 0; k < depth; k++)
+            s[k] += b[i * depth + k];
+        }
+
+      for (k = 0; k < depth; k++)
+        p[k] += omega * (s[k] * inv_n[n] - p[k]);
+    }
+}
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+/*  same as above, for the inner cells of an inner row of RGBA cells  */
+static void
+gimp_heal_multigrid_smooth_row_sse (const HealLevel *level,
+                                    gint             y,
+                                    gint             parity,
+                                    gfloat           omega)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint          width   = level->width;
+  gint          stride  = width;
+  const guchar *m       = level->mask + y * width;
+  v4sf         *x       = (v4sf *) level->x + y * stride;
+  const v4sf   *b       = level->b ? (const v4sf *) level->b + y * stride : NULL;
+  v4sf          omegav  = { omega, omega, omega, omega };
+  v4sf          quarter = { 0.25f, 0.25f, 0.25f, 0.25f };
+  gint          i;
+
+  for (i = 1 + ((1 + y + parity) & 1); i < width - 1; i += 2)
+    {
+      v4sf *p = x + i;
+      v4sf  s;
+
+      if (! m[i])
+        continue;
+
+      s = p[-1] + p[1] + p[-stride] + p[stride];
+
+      if (b)
+        s += b[i];
+
+      *p += omegav * (quarter * s - *p);
+    }
+}
+#endif
+
+/*  all the cells of one color only depend on cells of the other color, so
+ *  rows can be smoothed in parallel.
+ */
+static void
+gimp_heal_multigrid_smooth_rows (gsize              offset,
+                                 gsize              size,
+                                 HealMultigridData *data)
+{
+  const HealLevel *level = data->level;
+  gint             width = level->width;
+  gint             y;
+
+  for (y = offset; y < offset + size; y++)
+    {
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+      if (data->depth == 4 && y > 0 && y < level->height - 1 && width > 2)
+        {
+          gimp_heal_multigrid_smooth_row (level, 4, y, 0, 1,
+                                          data->parity, data->omega);
+          gimp_heal_multigrid_smooth_row_sse (level, y,
+                                              data->parity, data->omega);
+          gimp_heal_multigrid_smooth_row (level, 4, y, width - 1, width,
+                                          data->parity, data->omega);
+
+          continue;
+        }
+#endif
+
+      gimp_heal_multigrid_smooth_row (level, data->depth, y, 0, width,
+                                      data->parity, data->omega);
+    }
+}
+
+static void
+gimp_heal_multigrid_smooth (HealMultigridData *data,
+                            HealLevel         *level,
+                            gfloat             omega,
+                            gint               n_sweeps)
+{
+  data->level = level;
+  data->omega = omega;
+
+  while (n_sweeps--)
+    {
+      for (data->parity = 0; data->parity < 2; data->parity++)
+        {
+          gegl_parallel_distribute_range (
+            level->height, PIXELS_PER_THREAD / level->width,
+            (GeglParallelDistributeRangeFunc) gimp_heal_multigrid_smooth_rows,
+            data);
+        }
+    }
+}
+
+/*  computes the residual of the cells [x0, x1) of a row, and returns its
+ *  sum of squares
+ */
+static gdouble
+gimp_heal_multigrid_residual_row (const HealLevel *level,
+                                  gint             depth,
+                                  gint             y,
+                                  gint             x0,
+                                  gint             x1)
+{
+  gint          width  = level->width;
+  gint          height = level->height;
+  gint          stride = width * depth;
+  const guchar *m      = level->mask + y * width;
+  const gfloat *x      = level->x    + y * stride;
+  const gfloat *b      = level->b ? level->b + y * stride : NULL;
+  gfloat       *r      = level->r    + y * stride;
+  gdouble       err    = 0.0;
+  gint          i;
+
+  for (i = x0; i < x1; i++)
+    {
+      const gfloat *p    = x + i * depth;
+      gfloat        s[4] = { 0, };
+      gint          n    = 0;
+      gint          k;
+
+      if (! m[i])
+        {
+          for (k = 0; k < depth; k++)
+            r[i * depth + k] = 0.0f;
+
+          continue;
+        }
+
+#define ADD_NEIGHBOR(cond, offset)             \
+      if (cond)                                 \
+        {                                       \
+          for (k = 0; k < depth; k++)           \
+            s[k] += p[(offset) + k];            \
+          n++;                                  \
+        }
+
+      ADD_NEIGHBOR (i > 0,          -depth);
+      ADD_NEIGHBOR (i < width - 1,  +depth);
+      ADD_NEIGHBOR (y > 0,          -stride);
+      ADD_NEIGHBOR (y < height - 1, +stride);
+
+#undef ADD_NEIGHBOR
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat res = s[k] - n * p[k];
+
+          if (b)
+            res += b[i * depth + k];
+
+          r[i * depth + k] = res;
+
+          err += res * res;
+        }
+    }
+
+  return err;
+}
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+/*  same as above, for the inner cells of an inner row of RGBA cells  */
+static gdouble
+gimp_heal_multigrid_residual_row_sse (const HealLevel *level,
+                                      gint             y)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint          width  = level->width;
+  gint          stride = width;
+  const guchar *m      = level->mask + y * width;
+  const v4sf   *x      = (const v4sf *) level->x + y * stride;
+  const v4sf   *b      = level->b ? (const v4sf *) level->b + y * stride : NULL;
+  v4sf         *r      = (v4sf *) level->r + y * stride;
+  v4sf          four   = { 4.0f, 4.0f, 4.0f, 4.0f };
+  v4sf          zero   = { 0.0f, 0.0f, 0.0f, 0.0f };
+  v4sf          err    = zero;
+  gint          i;
+
+  for (i = 1; i < width - 1; i++)
+    {
+      const v4sf *p = x + i;
+      v4sf        res;
+
+      if (! m[i])
+        {
+          r[i] = zero;
+
+          continue;
+        }
+
+      res = p[-1] + p[1] + p[-stride] + p[stride] - four * *p;
+
+      if (b)
+        res += b[i];
+
+      r[i] = res;
+      err += res * res;
+    }
+
+  return err[0] + err[1] + err[2] + err[3];
+}
+#endif
+
+static void
+gimp_heal_multigrid_residual_rows (gsize              offset,
+                                   gsize              size,
+                                   HealMultigridData *data)
+{
+  const HealLevel *level = data->level;
+  gint             width = level->width;
+  gdouble          err   = 0.0;
+  gint             y;
+
+  for (y = offset; y < offset + size; y++)
+    {
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+      if (data->depth == 4 && y > 0 && y < level->height - 1 && width > 2)
+        {
+          err += gimp_heal_multigrid_residual_row (level, 4, y, 0, 1);
+          err += gimp_heal_multigrid_residual_row_sse (level, y);
+          err += gimp_heal_multigrid_residual_row (level, 4, y,
+                                                   width - 1, width);
+
+          continue;
+        }
+#endif
+
+      err += gimp_heal_multigrid_residual_row (level, data->depth, y,
+                                               0, width);
+    }
+
+  g_mutex_lock (&data->mutex);
+
+  data->err += err;
+
+  g_mutex_unlock (&data->mutex);
+}
+
+/*  computes the residual of 'level', and returns its sum of squares  */
+static gdouble
+gimp_heal_multigrid_residual (HealMultigridData *data,
+                              HealLevel         *level)
+{
+  data->level = level;
+  data->err   = 0.0;
+
+  gegl_parallel_distribute_range (
+    level->height, PIXELS_PER_THREAD / level->width,
+    (GeglParallelDistributeRangeFunc) gimp_heal_multigrid_residual_rows,
+    data);
+
+  return data->err;
+}
+
+/*  sums the residual of each 2x2 block of fine cells into the right-hand
+ *  side of the corresponding coarse cell.  since the coarse grid spacing
+ *  is doubled, this is the properly scaled right-hand side for the
+ *  unscaled 5-point laplacian used at all levels.
+ */
+static void
+gimp_heal_multigrid_restrict_rows (gsize              offset,
+                                   gsize              size,
+                                   HealMultigridData *data)
+{
+  const HealLevel *fine   = data->level;
+  HealLevel       *coarse = data->coarse;
+  gint             depth  = data->depth;
+  gint             y;
+
+  for (y = offset; y < offset + size; y++)
+    {
+      const guchar *m  = coarse->mask + y * coarse->width;
+      gfloat       *b  = coarse->b    + y * coarse->width * depth;
+      gfloat       *x  = coarse->x    + y * coarse->width * depth;
+      gint          y0 = 2 * y;
+      gint          y1 = MIN (2 * y + 1, fine->height - 1);
+      gint          i;
+
+      memset (x, 0, coarse->width * depth * sizeof (gfloat));
+
+      for (i = 0; i < coarse->width; i++)
+        {
+          gint x0 = 2 * i;
+          gint x1 = MIN (2 * i + 1, fine->width - 1);
+          gint k;
+
+          if (! m[i])
+            {
+              for (k = 0; k < depth; k++)
+                b[i * depth + k] = 0.0f;
+
+              continue;
+            }
+
+          for (k = 0; k < depth; k++)
+            {
+              gfloat sum;
+
+              sum = fine->r[(y0 * fine->width + x0) * depth + k];
+
+              if (x1 != x0)
+                sum += fine->r[(y0 * fine->width + x1) * depth + k];
+
+              if (y1 != y0)
+                {
+                  sum += fine->r[(y1 * fine->width + x0) * depth + k];
+
+                  if (x1 != x0)
+                    sum += fine->r[(y1 * fine->width + x1) * depth + k];
+                }
+
+              b[i * depth + k] = sum;
+            }
+        }
+    }
+}
+
+/*  adds the bilinearly-interpolated coarse correction to the unknown fine
+ *  cells.  known coarse cells have a zero correction, matching the zero
+ *  error of the known fine cells.
+ */
+static void
+gimp_heal_multigrid_prolong_rows (gsize              offset,
+                                  gsize              size,
+                                  HealMultigridData *data)
+{
+  HealLevel       *fine   = data->level;
+  const HealLevel *coarse = data->coarse;
+  gint             depth  = data->depth;
+  gint             cw     = coarse->width;
+  gint             y;
+
+  for (y = offset; y < offset + size; y++)
+    {
+      const guchar *m  = fine->mask + y * fine->width;
+      gfloat       *x  = fine->x    + y * fine->width * depth;
+      gint          y0 = y / 2;
+      gint          y1 = CLAMP (y0 + ((y & 1) ? 1 : -1), 0, coarse->height - 1);
+      const gfloat *c0 = coarse->x + y0 * cw * depth;
+      const gfloat *c1 = coarse->x + y1 * cw * depth;
+      gint          i;
+
+      for (i = 0; i < fine->width; i++)
+        {
+          gint x0 = i / 2;
+          gint x1 = CLAMP (x0 + ((i & 1) ? 1 : -1), 0, cw - 1);
+          gint k;
+
+          if (! m[i])
+            continue;
+
+          for (k = 0; k < depth; k++)
+            {
+              x[i * depth + k] += (9.0f / 16.0f) * c0[x0 * depth + k] +
+                                  (3.0f / 16.0f) * c0[x1 * depth + k] +
+                                  (3.0f / 16.0f) * c1[x0 * depth + k] +
+                                  (1.0f / 16.0f) * c1[x1 * depth + k];
+            }
+        }
+    }
+}
+
+/*  performs one V-cycle on 'levels', and returns the sum of squares of the
+ *  residual of the finest level after pre-smoothing
+ */
+static gdouble
+gimp_heal_multigrid_cycle (HealMultigridData *data,
+                           HealLevel         *levels,
+                           gint               n_levels)
+{
+  HealLevel *level = &levels[0];
+  gdouble    err;
+
+  if (n_levels == 1)
+    {
+      gimp_heal_multigrid_smooth (data, level,
+                                  MULTIGRID_COARSEST_OMEGA,
+                                  MULTIGRID_COARSEST_ITER);
+
+      return gimp_heal_multigrid_residual (data, level);
+    }
+
+  gimp_heal_multigrid_smooth (data, level,
+                              MULTIGRID_OMEGA, MULTIGRID_PRE_SMOOTH);
+
+  err = gimp_heal_multigrid_residual (data, level);
+
+  data->level  = level;
+  data->coarse = &levels[1];
+
+  gegl_parallel_distribute_range (
+    levels[1].height, PIXELS_PER_THREAD / levels[1].width,
+    (GeglParallelDistributeRangeFunc) gimp_heal_multigrid_restrict_rows,
+    data);
+
+  gimp_heal_multigrid_cycle (data, levels + 1, n_levels - 1);
+
+  data->level  = level;
+  data->coarse = &levels[1];
+
+  gegl_parallel_distribute_range (
+    level->height, PIXELS_PER_THREAD / level->width,
+    (GeglParallelDistributeRangeFunc) gimp_heal_multigrid_prolong_rows,
+    data);
+
+  gimp_heal_multigrid_smooth (data, level,
+                              MULTIGRID_OMEGA, MULTIGRID_POST_SMOOTH);
+
+  return err;
+}
+
+/*  builds the coarser levels, with a coarse cell being unknown only if all
+ *  of its fine cells are, so that the boundary never vanishes, and returns
+ *  the number of levels.
+ */
+static gint
+gimp_heal_multigrid_build_levels (HealLevel *levels,
+                                  gint       max_levels,
+                                  gint       depth)
+{
+  gint n_levels;
+
+  for (n_levels = 1; n_levels < max_levels; n_levels++)
+    {
+      const HealLevel *fine   = &levels[n_levels - 1];
+      HealLevel       *coarse = &levels[n_levels];
+      gint             n_unknown = 0;
+      gsize            size;
+      gint             y;
+
+      if (fine->width  <= MULTIGRID_COARSEST_SIZE &&
+          fine->height <= MULTIGRID_COARSEST_SIZE)
+        {
+          break;
+        }
+
+      coarse->width  = (fine->width  + 1) / 2;
+      coarse->height = (fine->height + 1) / 2;
+      coarse->mask   = g_new (guchar, coarse->width * coarse->height);
+
+      for (y = 0; y < coarse->height; y++)
+        {
+          const guchar *m0 = fine->mask + 2 * y * fine->width;
+          const guchar *m1 = fine->mask +
+                             MIN (2 * y + 1, fine->height - 1) * fine->width;
+          guchar       *m  = coarse->mask + y * coarse->width;
+          gint          i;
+
+          for (i = 0; i < coarse->width; i++)
+            {
+              gint x0 = 2 * i;
+              gint x1 = MIN (2 * i + 1, fine->width - 1);
+
+              m[i] = m0[x0] && m0[x1] && m1[x0] && m1[x1];
+
+              n_unknown += m[i];
+            }
+        }
+
+      if (n_unknown == 0)
+        {
+          g_free (coarse->mask);
+
+          break;
+        }
+
+      /*  the SSE code needs 16-byte aligned cells  */
+      size = coarse->width * coarse->height * depth * sizeof (gfloat);
+
+      coarse->x = gegl_malloc (size);
+      coarse->b = gegl_malloc (size);
+      coarse->r = gegl_malloc (size);
+    }
+
+  return n_levels;
+}
+
+/*  returns FALSE if the problem isn't suitable for multigrid, without
+ *  touching 'pixels'.
+ */
+static gboolean
+gimp_heal_laplace_multigrid (gfloat       *pixels,
+                             gint          width,
+                             gint          height,
+                             gint          depth,
+                             const guchar *mask)
+{
+  HealMultigridData  data = { 0, };
+  HealLevel          levels[32];
+  gint               n_levels;
+  gint               n_unknown = 0;
+  gdouble            prev_err  = G_MAXDOUBLE;
+  gint               cycle;
+  gint               i;
+
+  if (depth > 4)
+    return FALSE;
+
+  for (i = 0; i < width * height; i++)
+    n_unknown += mask[i] != 0;
+
+  /* without any known pixel, there's no boundary to interpolate from, and
+   * the coarse problems are singular.
+   */
+  if (n_unknown == 0 || n_unknown == width * height)
+    return FALSE;
+
+  levels[0].width  = width;
+  levels[0].height = height;
+  levels[0].x      = pixels;
+  levels[0].b      = NULL;
+  levels[0].r      = gegl_malloc (width * height * depth * sizeof (gfloat));
+  levels[0].mask   = (guchar *) mask;
+
+  n_levels = gimp_heal_multigrid_build_levels (levels, G_N_ELEMENTS (levels),
+                                               depth);
+
+  data.depth = depth;
+  g_mutex_init (&data.mutex);
+
+  for (cycle = 0; cycle < MULTIGRID_MAX_CYCLES; cycle++)
+    {
+      gdouble err = gimp_heal_multigrid_cycle (&data, levels, n_levels);
+
+      /* stop once we're within tolerance, or once single-precision
+       * rounding keeps the residual from decreasing any further.
+       */
+      if (err < EPSILON * EPSILON || err > 0.5 * prev_err)
+        break;
+
+      prev_err = err;
+    }
+
+  g_mutex_clear (&data.mutex);
+
+  gegl_free (levels[0].r);
+
+  for (i = 1; i < n_levels; i++)
+    {
+      gegl_free (levels[i].x);
+      gegl_free (levels[i].b);
+      gegl_free (levels[i].r);
+      g_free (levels[i].mask);
+    }
+
+  return TRUE;
+}
+
+
+/*  public functions  */
+
+/*  solves the laplace equation for the pixels whose 'mask' value is
+ *  nonzero, using the rest of 'pixels' as boundary conditions, and stores
+ *  the result in-place.  'pixels' holds 'depth' interleaved components per
+ *  pixel, must be 16-byte aligned, and must have room for 'depth' extra
+ *  components past its end.
+ */
+void
+gimp_heal_laplace (gfloat                *pixels,
+                   gint                   width,
+                   gint                   height,
+                   gint                   depth,
+                   const guchar          *mask,
+                   GimpHealLaplaceSolver  solver)
+{
+  g_return_if_fail (pixels != NULL);
+  g_return_if_fail (mask != NULL);
+  g_return_if_fail (width > 0 && height > 0);
+  g_return_if_fail (depth > 0);
+
+  if (solver == GIMP_HEAL_LAPLACE_AUTO)
+    {
+      if (width >= MULTIGRID_MIN_SIZE && height >= MULTIGRID_MIN_SIZE)
+        solver = GIMP_HEAL_LAPLACE_MULTIGRID;
+      else
+        solver = GIMP_HEAL_LAPLACE_SOR;
+    }
+
+  if (solver == GIMP_HEAL_LAPLACE_MULTIGRID &&
+      gimp_heal_laplace_multigrid (pixels, width, height, depth, mask))
+    {
+      return;
+    }
+
+  gimp_heal_laplace_loop (pixels, height, depth, width, mask);
+}
@@ -89,6 +89,7 @@ gimp_paintbrush_class_init (GimpPaintbrushClass *klass)
   GimpPaintCoreClass *paint_core_class = GIMP_PAINT_CORE_CLASS (klass);
   GimpBrushCoreClass *brush_core_class = GIMP_BRUSH_CORE_CLASS (klass);
 
+  paint_core_class->handles_pipelining     = TRUE;
   paint_core_class->paint                  = gimp_paintbrush_paint;
 
   brush_core_class->handles_changing_brush = TRUE;
@@ -326,6 +327,10 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
           (! paint_pixmap && (gimp_rgba_distance (&paint_color,
                                                   &paintbrush->paint_color))))
         {
+          /* a reused paint buffer may still be in use by pending dabs */
+          if (paint_buffer == paintbrush->paint_buffer)
+            gimp_paint_core_sync_dabs (paint_core);
+
           if (paint_buffer != paintbrush->paint_buffer)
             {
               if (paintbrush->paint_buffer)
@@ -0,0 +1,343 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppaintcore-dabs.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "paint-types.h"
+
+#include "core/gimp-parallel.h"
+#include "core/gimpasync.h"
+#include "core/gimpdrawable.h"
+#include "core/gimptempbuf.h"
+
+#include "gimppaintcore-loops.h"
+#include "gimppaintcore-dabs.h"
+
+
+/* the maximal number of dabs that may be queued or in flight at once.
+ * pushing a dab while the queue is full blocks until one of the pending
+ * dabs has been applied, so that the paint thread doesn't race too far
+ * ahead of the actual painting.
+ */
+#define MAX_PENDING_DABS 4
+
+
+typedef struct _GimpPaintCoreDab GimpPaintCoreDab;
+
+struct _GimpPaintCoreDab
+{
+  GimpPaintCoreDabs           *dabs;
+
+  GimpPaintCoreLoopsParams     params;
+  GimpPaintCoreLoopsAlgorithm  algorithms;
+  GeglRectangle                rect;
+
+  gboolean                     running;
+};
+
+struct _GimpPaintCoreDabs
+{
+  GMutex  mutex;
+  GCond   cond;
+
+  GQueue  queue;   /*  queued and running dabs, in paste order  */
+  GArray *applied; /*  applied dabs whose area wasn't updated yet  */
+};
+
+
+/*  local function prototypes  */
+
+static GimpPaintCoreDab * gimp_paint_core_dab_new        (GimpPaintCoreDabs              *dabs,
+                                                          const GimpPaintCoreLoopsParams *params,
+                                                          GimpPaintCoreLoopsAlgorithm     algorithms,
+                                                          const GeglRectangle            *rect);
+static void               gimp_paint_core_dab_free       (GimpPaintCoreDab               *dab);
+
+static GList            * gimp_paint_core_dabs_schedule  (GimpPaintCoreDabs              *dabs);
+static void               gimp_paint_core_dabs_run       (GList                          *list);
+static void               gimp_paint_core_dabs_apply     (GimpAsync                      *async,
+                                                          GimpPaintCoreDab               *dab);
+
+
+/*  private functions  */
+
+static GimpPaintCoreDab *
+gimp_paint_core_dab_new (GimpPaintCoreDabs              *dabs,
+                         const GimpPaintCoreLoopsParams *params,
+                         GimpPaintCoreLoopsAlgorithm     algorithms,
+                         const GeglRectangle            *rect)
+{
+  GimpPaintCoreDab *dab = g_slice_new0 (GimpPaintCoreDab);
+
+  dab->dabs       = dabs;
+  dab->params     = *params;
+  dab->algorithms = algorithms;
+  dab->rect       = *rect;
+
+  /*  the paint core keeps reusing its brush masks and paint buffer for the
+   *  next dabs, so hold on to our own copies.  the paint buffer is only
+   *  rewritten after gimp_paint_core_sync_dabs(), so a reference is enough.
+   */
+  if (params->paint_buf)
+    gimp_temp_buf_ref (params->paint_buf);
+
+  if (params->paint_mask)
+    dab->params.paint_mask = gimp_temp_buf_copy (params->paint_mask);
+
+  if (params->canvas_buffer)
+    g_object_ref (params->canvas_buffer);
+
+  if (params->src_buffer)
+    g_object_ref (params->src_buffer);
+
+  if (params->dest_buffer)
+    g_object_ref (params->dest_buffer);
+
+  if (params->mask_buffer)
+    g_object_ref (params->mask_buffer);
+
+  return dab;
+}
+
+static void
+gimp_paint_core_dab_free (GimpPaintCoreDab *dab)
+{
+  g_clear_pointer (&dab->params.paint_buf, gimp_temp_buf_unref);
+  g_clear_pointer (&dab->params.paint_mask, gimp_temp_buf_unref);
+
+  g_clear_object (&dab->params.canvas_buffer);
+  g_clear_object (&dab->params.src_buffer);
+  g_clear_object (&dab->params.dest_buffer);
+  g_clear_object (&dab->params.mask_buffer);
+
+  g_slice_free (GimpPaintCoreDab, dab);
+}
+
+/*  returns the list of queued dabs that can start running now, i.e., whose
+ *  area doesn't intersect any earlier dab that's still pending.  must be
+ *  called with the mutex held.
+ */
+static GList *
+gimp_paint_core_dabs_schedule (GimpPaintCoreDabs *dabs)
+{
+  GList *list = NULL;
+  GList *iter;
+
+  for (iter = dabs->queue.head; iter; iter = g_list_next (iter))
+    {
+      GimpPaintCoreDab *dab = iter->data;
+      GList            *prev;
+
+      if (dab->running)
+        continue;
+
+      for (prev = g_list_previous (iter); prev; prev = g_list_previous (prev))
+        {
+          GimpPaintCoreDab *prev_dab = prev->data;
+
+          if (gegl_rectangle_intersect (NULL, &dab->rect, &prev_dab->rect))
+            break;
+        }
+
+      if (! prev)
+        {
+          dab->running = TRUE;
+
+          list = g_list_prepend (list, dab);
+        }
+    }
+
+  return list;
+}
+
+/*  must be called without the mutex held, since the dabs may be applied
+ *  synchronously when there are no worker threads
+ */
+static void
+gimp_paint_core_dabs_run (GList *list)
+{
+  GList *iter;
+
+  for (iter = list; iter; iter = g_list_next (iter))
+    {
+      GimpAsync *async;
+
+      async = gimp_parallel_run_async (
+        (GimpRunAsyncFunc) gimp_paint_core_dabs_apply,
+        iter->data);
+
+      g_object_unref (async);
+    }
+
+  g_list_free (list);
+}
+
+static void
+gimp_paint_core_dabs_apply (GimpAsync        *async,
+                            GimpPaintCoreDab *dab)
+{
+  GimpPaintCoreDabs *dabs = dab->dabs;
+  GeglRectangle      rect = dab->rect;
+  GList             *list;
+
+  gimp_paint_core_loops_process (&dab->params, dab->algorithms);
+
+  gimp_async_finish (async, NULL);
+
+  g_mutex_lock (&dabs->mutex);
+
+  g_queue_remove (&dabs->queue, dab);
+  gimp_paint_core_dab_free (dab);
+
+  g_array_append_val (dabs->applied, rect);
+
+  list = gimp_paint_core_dabs_schedule (dabs);
+
+  g_cond_broadcast (&dabs->cond);
+
+  g_mutex_unlock (&dabs->mutex);
+
+  /*  'dabs' may be gone by now, unless we have more dabs to run, in which
+   *  case it's kept alive until they're applied.
+   */
+  gimp_paint_core_dabs_run (list);
+}
+
+
+/*  public functions  */
+
+GimpPaintCoreDabs *
+gimp_paint_core_dabs_new (void)
+{
+  GimpPaintCoreDabs *dabs = g_slice_new0 (GimpPaintCoreDabs);
+
+  g_mutex_init (&dabs->mutex);
+  g_cond_init (&dabs->cond);
+
+  g_queue_init (&dabs->queue);
+
+  dabs->applied = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  return dabs;
+}
+
+void
+gimp_paint_core_dabs_free (GimpPaintCoreDabs *dabs)
+{
+  g_return_if_fail (dabs != NULL);
+
+  gimp_paint_core_dabs_wait (dabs);
+
+  g_array_free (dabs->applied, TRUE);
+
+  g_cond_clear (&dabs->cond);
+  g_mutex_clear (&dabs->mutex);
+
+  g_slice_free (GimpPaintCoreDabs, dabs);
+}
+
+/*  queues a dab for asynchronous application.  'rect' is the area of
+ *  'params->dest_buffer' affected by the dab; dabs whose areas intersect
+ *  are applied in the order they were pushed, while other dabs are applied
+ *  concurrently.
+ */
+void
+gimp_paint_core_dabs_push (GimpPaintCoreDabs              *dabs,
+                           const GimpPaintCoreLoopsParams *params,
+                           GimpPaintCoreLoopsAlgorithm     algorithms,
+                           const GeglRectangle            *rect)
+{
+  GimpPaintCoreDab *dab;
+  GList            *list;
+
+  g_return_if_fail (dabs != NULL);
+  g_return_if_fail (params != NULL);
+  g_return_if_fail (rect != NULL);
+
+  dab = gimp_paint_core_dab_new (dabs, params, algorithms, rect);
+
+  g_mutex_lock (&dabs->mutex);
+
+  while (g_queue_get_length (&dabs->queue) >= MAX_PENDING_DABS)
+    g_cond_wait (&dabs->cond, &dabs->mutex);
+
+  g_queue_push_tail (&dabs->queue, dab);
+
+  list = gimp_paint_core_dabs_schedule (dabs);
+
+  g_mutex_unlock (&dabs->mutex);
+
+  gimp_paint_core_dabs_run (list);
+}
+
+void
+gimp_paint_core_dabs_wait (GimpPaintCoreDabs *dabs)
+{
+  g_return_if_fail (dabs != NULL);
+
+  g_mutex_lock (&dabs->mutex);
+
+  while (! g_queue_is_empty (&dabs->queue))
+    g_cond_wait (&dabs->cond, &dabs->mutex);
+
+  g_mutex_unlock (&dabs->mutex);
+}
+
+/*  updates 'drawable' for all the dabs applied since the last call.  this
+ *  must be called from the thread driving the paint core, and never from
+ *  the workers applying the dabs, since updating the drawable while
+ *  painting isn't thread-safe.
+ */
+void
+gimp_paint_core_dabs_update (GimpPaintCoreDabs *dabs,
+                             GimpDrawable      *drawable)
+{
+  GArray *applied;
+  gint    i;
+
+  g_return_if_fail (dabs != NULL);
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  g_mutex_lock (&dabs->mutex);
+
+  if (dabs->applied->len == 0)
+    {
+      g_mutex_unlock (&dabs->mutex);
+
+      return;
+    }
+
+  applied       = dabs->applied;
+  dabs->applied = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  g_mutex_unlock (&dabs->mutex);
+
+  for (i = 0; i < applied->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (applied, GeglRectangle, i);
+
+      gimp_drawable_update (drawable,
+                            rect->x, rect->y, rect->width, rect->height);
+    }
+
+  g_array_free (applied, TRUE);
+}
@@ -0,0 +1,37 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppaintcore-dabs.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_PAINT_CORE_DABS_H__
+#define __GIMP_PAINT_CORE_DABS_H__
+
+
+GimpPaintCoreDabs * gimp_paint_core_dabs_new    (void);
+void                gimp_paint_core_dabs_free   (GimpPaintCoreDabs              *dabs);
+
+void                gimp_paint_core_dabs_push   (GimpPaintCoreDabs              *dabs,
+                                                 const GimpPaintCoreLoopsParams *params,
+                                                 GimpPaintCoreLoopsAlgorithm     algorithms,
+                                                 const GeglRectangle            *rect);
+void                gimp_paint_core_dabs_wait   (GimpPaintCoreDabs              *dabs);
+
+void                gimp_paint_core_dabs_update (GimpPaintCoreDabs              *dabs,
+                                                 GimpDrawable                   *drawable);
+
+
+#endif /* __GIMP_PAINT_CORE_DABS_H__ */
@@ -50,6 +50,7 @@
 
 #include "gimppaintcore.h"
 #include "gimppaintcoreundo.h"
+#include "gimppaintcore-dabs.h"
 #include "gimppaintcore-loops.h"
 #include "gimppaintoptions.h"
 
@@ -118,6 +119,9 @@ static GimpUndo* gimp_paint_core_real_push_undo      (GimpPaintCore    *core,
                                                       GimpImage        *image,
                                                       const gchar      *undo_desc);
 
+static void      gimp_paint_core_finish_dabs         (GimpPaintCore    *core,
+                                                      GimpDrawable     *drawable);
+
 
 G_DEFINE_TYPE (GimpPaintCore, gimp_paint_core, GIMP_TYPE_OBJECT)
 
@@ -292,6 +296,19 @@ gimp_paint_core_real_push_undo (GimpPaintCore *core,
                                NULL);
 }
 
+static void
+gimp_paint_core_finish_dabs (GimpPaintCore *core,
+                             GimpDrawable  *drawable)
+{
+  if (core->dabs)
+    {
+      gimp_paint_core_dabs_wait (core->dabs);
+      gimp_paint_core_dabs_update (core->dabs, drawable);
+
+      g_clear_pointer (&core->dabs, gimp_paint_core_dabs_free);
+    }
+}
+
 
 /*  public functions  */
 
@@ -388,6 +405,11 @@ gimp_paint_core_start (GimpPaintCore     *core,
       return FALSE;
     }
 
+  /*  we paint on the drawable before pushing its undo, so the last undo
+   *  step must be compacted against its current pixels now
+   */
+  gimp_image_undo_compact (image);
+
   /*  Allocate the undo structure  */
   if (core->undo_buffer)
     g_object_unref (core->undo_buffer);
@@ -467,6 +489,11 @@ gimp_paint_core_start (GimpPaintCore     *core,
       gimp_applicator_set_dest_buffer (core->applicator,
                                        gimp_drawable_get_buffer (drawable));
     }
+  else if (core->pipelined &&
+           GIMP_PAINT_CORE_GET_CLASS (core)->handles_pipelining)
+    {
+      core->dabs = gimp_paint_core_dabs_new ();
+    }
 
   /*  Freeze the drawable preview so that it isn't constantly updated.  */
   gimp_viewable_preview_freeze (GIMP_VIEWABLE (drawable));
@@ -485,6 +512,8 @@ gimp_paint_core_finish (GimpPaintCore *core,
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
 
+  gimp_paint_core_finish_dabs (core, drawable);
+
   g_clear_object (&core->applicator);
 
   if (core->stroke_buffer)
@@ -562,6 +591,8 @@ gimp_paint_core_cancel (GimpPaintCore *core,
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
 
+  gimp_paint_core_finish_dabs (core, drawable);
+
   /*  Determine if any part of the image has been altered--
    *  if nothing has, then just return...
    */
@@ -603,6 +634,8 @@ gimp_paint_core_cleanup (GimpPaintCore *core)
 {
   g_return_if_fail (GIMP_IS_PAINT_CORE (core));
 
+  g_clear_pointer (&core->dabs, gimp_paint_core_dabs_free);
+
   g_clear_object (&core->undo_buffer);
   g_clear_object (&core->saved_proj_buffer);
   g_clear_object (&core->canvas_buffer);
@@ -645,6 +678,35 @@ gimp_paint_core_get_show_all (GimpPaintCore *core)
   return core->show_all;
 }
 
+/*  in pipelined mode, the dabs pasted by cores which handle pipelining are
+ *  applied asynchronously, while the paint core goes on to generate the
+ *  next ones.  the drawable is only updated for the applied dabs when
+ *  pasting the next dabs, or when calling gimp_paint_core_flush_dabs(), so
+ *  it's safe to do both from a thread other than the main thread, as long
+ *  as it's the same thread that's driving the paint core.
+ *
+ *  takes effect on the next gimp_paint_core_start().
+ */
+void
+gimp_paint_core_set_pipelined (GimpPaintCore *core,
+                               gboolean       pipelined)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+
+  core->pipelined = pipelined;
+}
+
+void
+gimp_paint_core_flush_dabs (GimpPaintCore *core,
+                            GimpDrawable  *drawable)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  if (core->dabs)
+    gimp_paint_core_dabs_update (core->dabs, drawable);
+}
+
 void
 gimp_paint_core_set_current_coords (GimpPaintCore    *core,
                                     const GimpCoords *coords)
@@ -778,6 +840,18 @@ gimp_paint_core_get_image_pickable (GimpPaintCore *core)
   return core->image_pickable;
 }
 
+/*  waits until all the pasted dabs have been applied.  cores must call this
+ *  before modifying their paint buffer in-place.
+ */
+void
+gimp_paint_core_sync_dabs (GimpPaintCore *core)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+
+  if (core->dabs)
+    gimp_paint_core_dabs_wait (core->dabs);
+}
+
 GeglBuffer *
 gimp_paint_core_get_orig_image (GimpPaintCore *core)
 {
@@ -964,7 +1038,17 @@ gimp_paint_core_paste (GimpPaintCore            *core,
           algorithms |= GIMP_PAINT_CORE_LOOPS_ALGORITHM_MASK_COMPONENTS;
         }
 
-      gimp_paint_core_loops_process (&params, algorithms);
+      if (core->dabs)
+        {
+          gimp_paint_core_dabs_push (core->dabs, &params, algorithms,
+                                     GEGL_RECTANGLE (core->paint_buffer_x,
+                                                     core->paint_buffer_y,
+                                                     width, height));
+        }
+      else
+        {
+          gimp_paint_core_loops_process (&params, algorithms);
+        }
     }
 
   /*  Update the undo extents  */
@@ -974,10 +1058,17 @@ gimp_paint_core_paste (GimpPaintCore            *core,
   core->y2 = MAX (core->y2, core->paint_buffer_y + height);
 
   /*  Update the drawable  */
-  gimp_drawable_update (drawable,
-                        core->paint_buffer_x,
-                        core->paint_buffer_y,
-                        width, height);
+  if (core->dabs)
+    {
+      gimp_paint_core_dabs_update (core->dabs, drawable);
+    }
+  else
+    {
+      gimp_drawable_update (drawable,
+                            core->paint_buffer_x,
+                            core->paint_buffer_y,
+                            width, height);
+    }
 }
 
 /* This works similarly to gimp_paint_core_paste. However, instead of
@@ -1014,6 +1105,8 @@ gimp_paint_core_replace (GimpPaintCore            *core,
       return;
     }
 
+  gimp_paint_core_sync_dabs (core);
+
   width  = gegl_buffer_get_width  (core->paint_buffer);
   height = gegl_buffer_get_height (core->paint_buffer);
 
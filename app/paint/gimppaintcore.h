@@ -72,6 +72,9 @@ struct _GimpPaintCore
 
   GimpApplicator *applicator;
 
+  gboolean        pipelined;         /*  apply dabs asynchronously           */
+  GimpPaintCoreDabs *dabs;           /*  dabs which are being applied        */
+
   GArray         *stroke_buffer;
 };
 
@@ -79,6 +82,9 @@ struct _GimpPaintCoreClass
 {
   GimpObjectClass  parent_class;
 
+  /*  Set for cores whose pasted dabs may be applied asynchronously  */
+  gboolean         handles_pipelining;
+
   /*  virtual functions  */
   gboolean     (* start)            (GimpPaintCore    *core,
                                      GimpDrawable     *drawable,
@@ -154,6 +160,11 @@ void      gimp_paint_core_set_show_all              (GimpPaintCore    *core,
                                                      gboolean          show_all);
 gboolean  gimp_paint_core_get_show_all              (GimpPaintCore    *core);
 
+void      gimp_paint_core_set_pipelined             (GimpPaintCore    *core,
+                                                     gboolean          pipelined);
+void      gimp_paint_core_flush_dabs                (GimpPaintCore    *core,
+                                                     GimpDrawable     *drawable);
+
 void      gimp_paint_core_set_current_coords        (GimpPaintCore    *core,
                                                      const GimpCoords *coords);
 void      gimp_paint_core_get_current_coords        (GimpPaintCore    *core,
@@ -186,6 +197,8 @@ GeglBuffer * gimp_paint_core_get_paint_buffer       (GimpPaintCore    *core,
 
 GimpPickable * gimp_paint_core_get_image_pickable   (GimpPaintCore    *core);
 
+void         gimp_paint_core_sync_dabs              (GimpPaintCore    *core);
+
 GeglBuffer * gimp_paint_core_get_orig_image         (GimpPaintCore    *core);
 GeglBuffer * gimp_paint_core_get_orig_proj          (GimpPaintCore    *core);
 
@@ -42,6 +42,8 @@ typedef struct _GimpPencil           GimpPencil;
 typedef struct _GimpPerspectiveClone GimpPerspectiveClone;
 typedef struct _GimpSmudge           GimpSmudge;
 
+typedef struct _GimpPaintCoreDabs    GimpPaintCoreDabs;
+
 
 /*  paint options  */
 
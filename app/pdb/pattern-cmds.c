@@ -65,14 +65,16 @@ pattern_get_info_invoker (GimpProcedure         *procedure,
 
       if (pattern)
         {
-          const Babl *format;
+          GimpTempBuf *mask = gimp_pattern_ref_mask (pattern);
+          const Babl  *format;
 
-          format = gimp_babl_compat_u8_format (
-            gimp_temp_buf_get_format (pattern->mask));
+          format = gimp_babl_compat_u8_format (gimp_temp_buf_get_format (mask));
 
-          width  = gimp_temp_buf_get_width  (pattern->mask);
-          height = gimp_temp_buf_get_height (pattern->mask);
+          width  = gimp_temp_buf_get_width  (mask);
+          height = gimp_temp_buf_get_height (mask);
           bpp    = babl_format_get_bytes_per_pixel (format);
+
+          gimp_temp_buf_unref (mask);
         }
       else
         success = FALSE;
@@ -116,20 +118,21 @@ pattern_get_pixels_invoker (GimpProcedure         *procedure,
 
       if (pattern)
         {
-          const Babl *format;
-          gpointer    data;
+          GimpTempBuf *mask = gimp_pattern_ref_mask (pattern);
+          const Babl  *format;
+          gpointer     data;
 
-          format = gimp_babl_compat_u8_format (
-            gimp_temp_buf_get_format (pattern->mask));
-          data   = gimp_temp_buf_lock (pattern->mask, format, GEGL_ACCESS_READ);
+          format = gimp_babl_compat_u8_format (gimp_temp_buf_get_format (mask));
+          data   = gimp_temp_buf_lock (mask, format, GEGL_ACCESS_READ);
 
-          width           = gimp_temp_buf_get_width  (pattern->mask);
-          height          = gimp_temp_buf_get_height (pattern->mask);
+          width           = gimp_temp_buf_get_width  (mask);
+          height          = gimp_temp_buf_get_height (mask);
           bpp             = babl_format_get_bytes_per_pixel (format);
-          num_color_bytes = gimp_temp_buf_get_data_size (pattern->mask);
+          num_color_bytes = gimp_temp_buf_get_data_size (mask);
           color_bytes     = g_memdup (data, num_color_bytes);
 
-          gimp_temp_buf_unlock (pattern->mask, data);
+          gimp_temp_buf_unlock (mask, data);
+          gimp_temp_buf_unref (mask);
         }
       else
         success = FALSE;
@@ -47,6 +47,7 @@
 #include "gimpplugin-cleanup.h"
 #include "gimpplugin-message.h"
 #include "gimppluginmanager.h"
+#include "gimppluginmap.h"
 #include "gimpplugindef.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
@@ -63,6 +64,12 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_tile_batch_get   (GimpPlugIn      *plug_in,
+                                                  GPTileBatchReq  *request);
+static void gimp_plug_in_handle_drawable_map     (GimpPlugIn      *plug_in,
+                                                  GPDrawableMap   *request);
+static void gimp_plug_in_handle_drawable_sync    (GimpPlugIn      *plug_in,
+                                                  GPDrawableSync  *request);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -160,6 +167,27 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILE_BATCH_REQ:
+      gimp_plug_in_handle_tile_batch_get (plug_in, msg->data);
+      break;
+
+    case GP_TILE_BATCH_DATA:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a TILE_BATCH_DATA message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
+
+    case GP_DRAWABLE_MAP:
+      gimp_plug_in_handle_drawable_map (plug_in, msg->data);
+      break;
+
+    case GP_DRAWABLE_SYNC:
+      gimp_plug_in_handle_drawable_sync (plug_in, msg->data);
+      break;
     }
 }
 
@@ -184,83 +212,46 @@ gimp_plug_in_handle_tile_request (GimpPlugIn *plug_in,
     gimp_plug_in_handle_tile_get (plug_in, request);
 }
 
-static void
-gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
-                              GPTileReq  *request)
+static GeglBuffer *
+gimp_plug_in_get_tile_buffer (GimpPlugIn *plug_in,
+                              gint32      drawable_id,
+                              gboolean    shadow,
+                              gboolean    write)
 {
-  GPTileData       tile_data;
-  GPTileData      *tile_info;
-  GimpWireMessage  msg;
-  GimpDrawable    *drawable;
-  GeglBuffer      *buffer;
-  const Babl      *format;
-  GeglRectangle    tile_rect;
-
-  tile_data.drawable_id = -1;
-  tile_data.tile_num    = 0;
-  tile_data.shadow      = 0;
-  tile_data.bpp         = 0;
-  tile_data.width       = 0;
-  tile_data.height      = 0;
-  tile_data.use_shm     = (plug_in->manager->shm != NULL);
-  tile_data.data        = NULL;
-
-  if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
-    {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "%s: ERROR", G_STRFUNC);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
-    }
-
-  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-    {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "%s: ERROR", G_STRFUNC);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
-    }
-
-  if (msg.type != GP_TILE_DATA)
-    {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "expected tile data and received: %d", msg.type);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
-    }
-
-  tile_info = msg.data;
+  GimpDrawable *drawable;
+  GeglBuffer   *buffer;
 
   drawable = (GimpDrawable *) gimp_item_get_by_id (plug_in->manager->gimp,
-                                                   tile_info->drawable_id);
+                                                   drawable_id);
 
   if (! GIMP_IS_DRAWABLE (drawable))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried writing to invalid drawable %d (killing)",
+                    "tried %s invalid drawable %d (killing)",
                     gimp_object_get_name (plug_in),
                     gimp_file_get_utf8_name (plug_in->file),
-                    tile_info->drawable_id);
+                    write ? "writing to" : "reading from",
+                    drawable_id);
       gimp_plug_in_close (plug_in, TRUE);
-      return;
+      return NULL;
     }
   else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried writing to drawable %d which was removed "
+                    "tried %s drawable %d which was removed "
                     "from the image (killing)",
                     gimp_object_get_name (plug_in),
                     gimp_file_get_utf8_name (plug_in->file),
-                    tile_info->drawable_id);
+                    write ? "writing to" : "reading from",
+                    drawable_id);
       gimp_plug_in_close (plug_in, TRUE);
-      return;
+      return NULL;
     }
 
-  if (tile_info->shadow)
+  if (shadow)
     {
-
       /*  don't check whether the drawable is a group or locked here,
        *  the plugin will get a proper error message when it tries to
        *  merge the shadow tiles, which is much better than just
@@ -272,32 +263,113 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
     }
   else
     {
-      if (gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+      if (write && gimp_item_is_content_locked (GIMP_ITEM (drawable)))
         {
           gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                         "Plug-in \"%s\"\n(%s)\n\n"
                         "tried writing to a locked drawable %d (killing)",
                         gimp_object_get_name (plug_in),
                         gimp_file_get_utf8_name (plug_in->file),
-                        tile_info->drawable_id);
+                        drawable_id);
           gimp_plug_in_close (plug_in, TRUE);
-          return;
+          return NULL;
         }
-      else if (gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+      else if (write && gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
         {
           gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                         "Plug-in \"%s\"\n(%s)\n\n"
                         "tried writing to a group layer %d (killing)",
                         gimp_object_get_name (plug_in),
                         gimp_file_get_utf8_name (plug_in->file),
-                        tile_info->drawable_id);
+                        drawable_id);
           gimp_plug_in_close (plug_in, TRUE);
-          return;
+          return NULL;
         }
 
       buffer = gimp_drawable_get_buffer (drawable);
     }
 
+  return buffer;
+}
+
+static gboolean
+gimp_plug_in_get_tile_batch_rects (GimpPlugIn    *plug_in,
+                                   GeglBuffer    *buffer,
+                                   guint          n_tiles,
+                                   const guint32 *tile_nums,
+                                   gsize          max_length,
+                                   gboolean       write,
+                                   GeglRectangle *tile_rects,
+                                   gsize         *length)
+{
+  gint  bpp;
+  guint i;
+
+  bpp = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer));
+
+  *length = 0;
+
+  if (n_tiles < 1 || n_tiles > GP_TILE_BATCH_MAX_TILES)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "requested a batch of %u tiles for %s (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    n_tiles,
+                    write ? "writing" : "reading");
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      if (! gimp_gegl_buffer_get_tile_rect (buffer,
+                                            GIMP_PLUG_IN_TILE_WIDTH,
+                                            GIMP_PLUG_IN_TILE_HEIGHT,
+                                            tile_nums[i],
+                                            &tile_rects[i]))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-in \"%s\"\n(%s)\n\n"
+                        "requested invalid tile #%d for %s (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file),
+                        tile_nums[i],
+                        write ? "writing" : "reading");
+          gimp_plug_in_close (plug_in, TRUE);
+          return FALSE;
+        }
+
+      *length += (gsize) tile_rects[i].width * tile_rects[i].height * bpp;
+    }
+
+  if (*length > max_length)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "requested a tile batch exceeding %" G_GSIZE_FORMAT " "
+                    "bytes for %s (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    max_length,
+                    write ? "writing" : "reading");
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gimp_plug_in_put_tile (GimpPlugIn *plug_in,
+                       GeglBuffer *buffer,
+                       GPTileData *tile_info,
+                       gboolean    use_shm)
+{
+  const Babl    *format;
+  GeglRectangle  tile_rect;
+
   if (! gimp_gegl_buffer_get_tile_rect (buffer,
                                         GIMP_PLUG_IN_TILE_WIDTH,
                                         GIMP_PLUG_IN_TILE_HEIGHT,
@@ -311,12 +383,12 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
                     gimp_file_get_utf8_name (plug_in->file),
                     tile_info->tile_num);
       gimp_plug_in_close (plug_in, TRUE);
-      return;
+      return FALSE;
     }
 
   format = gegl_buffer_get_format (buffer);
 
-  if (tile_data.use_shm)
+  if (use_shm)
     {
       gegl_buffer_set (buffer, &tile_rect, 0, format,
                        gimp_plug_in_shm_get_addr (plug_in->manager->shm),
@@ -329,67 +401,171 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
                        GEGL_AUTO_ROWSTRIDE);
     }
 
-  gimp_wire_destroy (&msg);
+  return TRUE;
+}
 
-  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+static gboolean
+gimp_plug_in_put_tile_batch (GimpPlugIn      *plug_in,
+                             GeglBuffer      *buffer,
+                             GPTileBatchData *batch_info,
+                             gboolean         use_shm)
+{
+  const Babl    *format;
+  GeglRectangle  tile_rects[GP_TILE_BATCH_MAX_TILES];
+  const guchar  *data;
+  gsize          max_length;
+  gsize          length;
+  gsize          offset;
+  gint           bpp;
+  guint          i;
+
+  if (use_shm)
     {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "%s: ERROR", G_STRFUNC);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
+      data       = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+      max_length = gimp_plug_in_shm_get_size (plug_in->manager->shm);
+    }
+  else
+    {
+      data       = batch_info->data;
+      max_length = batch_info->data_length;
     }
+
+  if (! gimp_plug_in_get_tile_batch_rects (plug_in, buffer,
+                                           batch_info->n_tiles,
+                                           batch_info->tile_nums,
+                                           max_length, TRUE,
+                                           tile_rects, &length))
+    {
+      return FALSE;
+    }
+
+  format = gegl_buffer_get_format (buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+
+  for (i = 0, offset = 0; i < batch_info->n_tiles; i++)
+    {
+      gegl_buffer_set (buffer, &tile_rects[i], 0, format,
+                       data + offset,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      offset += (gsize) tile_rects[i].width * tile_rects[i].height * bpp;
+    }
+
+  return TRUE;
 }
 
 static void
-gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
+gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
                               GPTileReq  *request)
 {
   GPTileData       tile_data;
   GimpWireMessage  msg;
-  GimpDrawable    *drawable;
   GeglBuffer      *buffer;
-  const Babl      *format;
-  GeglRectangle    tile_rect;
-  gint             tile_size;
+  gint32           drawable_id;
+  gboolean         shadow;
+  gboolean         success;
 
-  drawable = (GimpDrawable *) gimp_item_get_by_id (plug_in->manager->gimp,
-                                                   request->drawable_id);
+  tile_data.drawable_id = -1;
+  tile_data.tile_num    = 0;
+  tile_data.shadow      = 0;
+  tile_data.bpp         = 0;
+  tile_data.width       = 0;
+  tile_data.height      = 0;
+  tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.data        = NULL;
 
-  if (! GIMP_IS_DRAWABLE (drawable))
+  if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried reading from invalid drawable %d (killing)",
-                    gimp_object_get_name (plug_in),
-                    gimp_file_get_utf8_name (plug_in->file),
-                    request->drawable_id);
+                    "%s: ERROR", G_STRFUNC);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
-  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried reading from drawable %d which was removed "
-                    "from the image (killing)",
-                    gimp_object_get_name (plug_in),
-                    gimp_file_get_utf8_name (plug_in->file),
-                    request->drawable_id);
+                    "%s: ERROR", G_STRFUNC);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
-  if (request->shadow)
+  /*  the plug-in either sends a single tile or a batch of tiles  */
+  if (msg.type == GP_TILE_DATA)
     {
-      buffer = gimp_drawable_get_shadow_buffer (drawable);
+      GPTileData *tile_info = msg.data;
 
-      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+      drawable_id = tile_info->drawable_id;
+      shadow      = tile_info->shadow;
+    }
+  else if (msg.type == GP_TILE_BATCH_DATA)
+    {
+      GPTileBatchData *batch_info = msg.data;
+
+      drawable_id = batch_info->drawable_id;
+      shadow      = batch_info->shadow;
     }
   else
     {
-      buffer = gimp_drawable_get_buffer (drawable);
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile data and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in, drawable_id, shadow, TRUE);
+
+  if (! buffer)
+    {
+      gimp_wire_destroy (&msg);
+      return;
+    }
+
+  if (msg.type == GP_TILE_DATA)
+    {
+      success = gimp_plug_in_put_tile (plug_in, buffer, msg.data,
+                                       tile_data.use_shm);
+    }
+  else
+    {
+      success = gimp_plug_in_put_tile_batch (plug_in, buffer, msg.data,
+                                             tile_data.use_shm);
     }
 
+  gimp_wire_destroy (&msg);
+
+  if (! success)
+    return;
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static void
+gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
+                              GPTileReq  *request)
+{
+  GPTileData       tile_data;
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle    tile_rect;
+  gint             tile_size;
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         request->drawable_id,
+                                         request->shadow,
+                                         FALSE);
+
+  if (! buffer)
+    return;
+
   if (! gimp_gegl_buffer_get_tile_rect (buffer,
                                         GIMP_PLUG_IN_TILE_WIDTH,
                                         GIMP_PLUG_IN_TILE_HEIGHT,
@@ -461,6 +637,258 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   gimp_wire_destroy (&msg);
 }
 
+static void
+gimp_plug_in_handle_tile_batch_get (GimpPlugIn     *plug_in,
+                                    GPTileBatchReq *request)
+{
+  GPTileBatchData  batch_data;
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle    tile_rects[GP_TILE_BATCH_MAX_TILES];
+  guchar          *data;
+  gsize            max_length;
+  gsize            length;
+  gsize            offset;
+  gint             bpp;
+  guint            i;
+
+  g_return_if_fail (request != NULL);
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         request->drawable_id,
+                                         request->shadow,
+                                         FALSE);
+
+  if (! buffer)
+    return;
+
+  if (plug_in->manager->shm)
+    max_length = gimp_plug_in_shm_get_size (plug_in->manager->shm);
+  else
+    max_length = G_MAXUINT32;
+
+  if (! gimp_plug_in_get_tile_batch_rects (plug_in, buffer,
+                                           request->n_tiles,
+                                           request->tile_nums,
+                                           max_length, FALSE,
+                                           tile_rects, &length))
+    {
+      return;
+    }
+
+  format = gegl_buffer_get_format (buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+
+  batch_data.drawable_id = request->drawable_id;
+  batch_data.shadow      = request->shadow;
+  batch_data.bpp         = bpp;
+  batch_data.n_tiles     = request->n_tiles;
+  batch_data.tile_nums   = request->tile_nums;
+  batch_data.use_shm     = (plug_in->manager->shm != NULL);
+  batch_data.data_length = length;
+  batch_data.data        = NULL;
+
+  if (batch_data.use_shm)
+    {
+      data = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+    }
+  else
+    {
+      batch_data.data = g_malloc (length);
+
+      data = batch_data.data;
+    }
+
+  /*  the tiles are packed back to back, in the order they were requested  */
+  for (i = 0, offset = 0; i < request->n_tiles; i++)
+    {
+      gegl_buffer_get (buffer, &tile_rects[i], 1.0, format,
+                       data + offset,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      offset += (gsize) tile_rects[i].width * tile_rects[i].height * bpp;
+    }
+
+  if (! gp_tile_batch_data_write (plug_in->my_write, &batch_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      g_free (batch_data.data);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  g_free (batch_data.data);
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gimp_wire_destroy (&msg);
+}
+
+static void
+gimp_plug_in_handle_drawable_map (GimpPlugIn    *plug_in,
+                                  GPDrawableMap *request)
+{
+  GPDrawableMap  drawable_map;
+  GimpDrawable  *drawable;
+  GeglBuffer    *buffer;
+  GimpPlugInMap *map   = NULL;
+  GError        *error = NULL;
+
+  g_return_if_fail (request != NULL);
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         request->drawable_id,
+                                         request->shadow,
+                                         FALSE);
+
+  if (! buffer)
+    return;
+
+  drawable = (GimpDrawable *) gimp_item_get_by_id (plug_in->manager->gimp,
+                                                   request->drawable_id);
+
+  /*  if the pixels can't be mapped, the plug-in falls back to
+   *  transferring tiles
+   */
+  if (gimp_plug_in_map_can_send (plug_in->my_write))
+    map = gimp_plug_in_map_new (drawable, request->shadow, buffer, &error);
+
+  if (map)
+    {
+      plug_in->maps = g_list_prepend (plug_in->maps, map);
+    }
+  else if (error)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_WARNING,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "could not map drawable %d, "
+                    "falling back to transferring tiles: %s",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_id,
+                    error->message);
+      g_clear_error (&error);
+    }
+
+  drawable_map.drawable_id = request->drawable_id;
+  drawable_map.shadow      = request->shadow;
+  drawable_map.fd          = map ? gimp_plug_in_map_get_fd (map) : -1;
+  drawable_map.width       = gegl_buffer_get_width  (buffer);
+  drawable_map.height      = gegl_buffer_get_height (buffer);
+  drawable_map.bpp         = babl_format_get_bytes_per_pixel (
+                               gegl_buffer_get_format (buffer));
+
+  if (! gp_drawable_map_write (plug_in->my_write, &drawable_map, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  /*  the plug-in waits for the file descriptor right after the reply  */
+  if (map && ! gimp_plug_in_map_send (map, plug_in->my_write, &error))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "could not pass mapped drawable %d (killing): %s",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_id,
+                    error->message);
+      g_clear_error (&error);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static void
+gimp_plug_in_handle_drawable_sync (GimpPlugIn     *plug_in,
+                                   GPDrawableSync *request)
+{
+  GimpPlugInMap *map = NULL;
+  GList         *list;
+
+  g_return_if_fail (request != NULL);
+
+  for (list = plug_in->maps; list; list = g_list_next (list))
+    {
+      GimpPlugInMap *m        = list->data;
+      GimpDrawable  *drawable = gimp_plug_in_map_get_drawable (m);
+
+      if (gimp_plug_in_map_get_fd (m) == request->fd                     &&
+          gimp_item_get_id (GIMP_ITEM (drawable)) == request->drawable_id &&
+          gimp_plug_in_map_get_shadow (m) == (request->shadow != 0))
+        {
+          map = m;
+          break;
+        }
+    }
+
+  if (! map)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "tried syncing drawable %d which it did not map (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_id);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (request->width > 0 && request->height > 0)
+    {
+      GeglBuffer *buffer;
+
+      buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                             request->drawable_id,
+                                             request->shadow,
+                                             TRUE);
+
+      if (! buffer)
+        return;
+
+      gimp_plug_in_map_store (map, buffer,
+                              GEGL_RECTANGLE (request->x,
+                                              request->y,
+                                              request->width,
+                                              request->height));
+    }
+
+  if (request->unmap)
+    {
+      plug_in->maps = g_list_remove (plug_in->maps, map);
+
+      gimp_plug_in_map_free (map);
+    }
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
 static void
 gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
                                 GimpPlugInProcFrame *proc_frame,
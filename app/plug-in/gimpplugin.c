@@ -90,6 +90,7 @@
 #include "gimppluginmanager.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-locale-domain.h"
+#include "gimppluginmap.h"
 #include "gimptemporaryprocedure.h"
 
 #include "gimp-intl.h"
@@ -433,9 +434,10 @@ gimp_plug_in_open (GimpPlugIn         *plug_in,
   g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), FALSE);
   g_return_val_if_fail (plug_in->call_mode == GIMP_PLUG_IN_CALL_NONE, FALSE);
 
-  /* Open two pipes. (Bidirectional communication).
+  /* Open two pipes. (Bidirectional communication).  The one to the
+   * plug-in may be a socket, see gimp_plug_in_map_pipe().
    */
-  if ((pipe (my_read) == -1) || (pipe (my_write) == -1))
+  if ((pipe (my_read) == -1) || (gimp_plug_in_map_pipe (my_write) == -1))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Unable to run plug-in \"%s\"\n(%s)\n\npipe() failed: %s",
@@ -721,6 +723,9 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
 
   gimp_wire_clear_error ();
 
+  g_list_free_full (plug_in->maps, (GDestroyNotify) gimp_plug_in_map_free);
+  plug_in->maps = NULL;
+
   while (plug_in->temp_proc_frames)
     {
       GimpPlugInProcFrame *proc_frame = plug_in->temp_proc_frames->data;
@@ -61,6 +61,8 @@ struct _GimpPlugIn
 
   GSList              *temp_procedures; /*  Temporary procedures              */
 
+  GList               *maps;            /*  Drawables mapped by the plug-in   */
+
   GMainLoop           *ext_main_loop;   /*  for waiting for extension_ack     */
 
   GimpPlugInProcFrame  main_proc_frame;
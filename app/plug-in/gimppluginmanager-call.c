@@ -63,6 +63,39 @@ gimp_allow_set_foreground_window (GimpPlugIn *plug_in)
 #endif
 }
 
+static gboolean
+gimp_plug_in_manager_query_recv_message (GIOChannel   *channel,
+                                         GIOCondition  cond,
+                                         GimpPlugIn   *plug_in)
+{
+  if (cond & (G_IO_IN | G_IO_PRI))
+    {
+      GimpWireMessage msg;
+
+      if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+        {
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+      else
+        {
+          gimp_plug_in_handle_message (plug_in, &msg);
+          gimp_wire_destroy (&msg);
+        }
+    }
+  else if (cond & (G_IO_ERR | G_IO_HUP))
+    {
+      /*  only close the plug-in once all its messages are read, which
+       *  is when the pipe stops being readable
+       */
+      if (cond & G_IO_HUP)
+        plug_in->hup = TRUE;
+
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+
+  return plug_in->open;
+}
+
 
 /*  public functions  */
 
@@ -106,6 +139,102 @@ gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
     }
 }
 
+void
+gimp_plug_in_manager_call_query_all (GimpPlugInManager *manager,
+                                     GimpContext       *context,
+                                     GSList            *plug_in_defs,
+                                     gint               max_queries,
+                                     GFunc              started_func,
+                                     gpointer           user_data)
+{
+  GMainContext *main_context;
+  GList        *running   = NULL;
+  gint          n_running = 0;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
+
+  max_queries = MAX (max_queries, 1);
+
+  /*  the plug-ins are serviced from a private main context, so that
+   *  nothing but their messages is dispatched while they are queried.
+   *  each plug-in only adds procedures to, and sets the domains of, its
+   *  own plug-in def, so the defs come out the same, whatever order the
+   *  plug-ins answer in.
+   */
+  main_context = g_main_context_new ();
+
+  while (plug_in_defs || running)
+    {
+      GList *list;
+
+      while (plug_in_defs && n_running < max_queries)
+        {
+          GimpPlugInDef *plug_in_def = plug_in_defs->data;
+          GimpPlugIn    *plug_in;
+
+          plug_in_defs = g_slist_next (plug_in_defs);
+
+          if (started_func)
+            started_func (plug_in_def, user_data);
+
+          plug_in = gimp_plug_in_new (manager, context, NULL,
+                                      NULL, plug_in_def->file);
+
+          if (! plug_in)
+            continue;
+
+          plug_in->plug_in_def = plug_in_def;
+
+          if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+            {
+              GSource *source;
+
+              source = g_io_create_watch (plug_in->my_read,
+                                          G_IO_IN  | G_IO_PRI |
+                                          G_IO_ERR | G_IO_HUP);
+
+              g_source_set_callback (source,
+                                     (GSourceFunc) gimp_plug_in_manager_query_recv_message,
+                                     plug_in, NULL);
+
+              g_source_attach (source, main_context);
+              g_source_unref (source);
+
+              running = g_list_prepend (running, plug_in);
+              n_running++;
+            }
+          else
+            {
+              g_object_unref (plug_in);
+            }
+        }
+
+      if (! running)
+        break;
+
+      g_main_context_iteration (main_context, TRUE);
+
+      for (list = running; list; )
+        {
+          GimpPlugIn *plug_in = list->data;
+          GList      *next    = g_list_next (list);
+
+          if (! plug_in->open)
+            {
+              running = g_list_delete_link (running, list);
+              n_running--;
+
+              g_object_unref (plug_in);
+            }
+
+          list = next;
+        }
+    }
+
+  g_main_context_unref (main_context);
+}
+
 void
 gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
                                 GimpContext       *context,
@@ -27,33 +27,43 @@
 
 /*  Call the plug-in's query() function
  */
-void             gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
-                                                     GimpContext            *context,
-                                                     GimpPlugInDef          *plug_in_def);
+void             gimp_plug_in_manager_call_query     (GimpPlugInManager      *manager,
+                                                      GimpContext            *context,
+                                                      GimpPlugInDef          *plug_in_def);
+
+/*  Call the query() function of all the plug-ins in a list, running up
+ *  to max_queries of them at once
+ */
+void             gimp_plug_in_manager_call_query_all (GimpPlugInManager      *manager,
+                                                      GimpContext            *context,
+                                                      GSList                 *plug_in_defs,
+                                                      gint                    max_queries,
+                                                      GFunc                   started_func,
+                                                      gpointer                user_data);
 
 /*  Call the plug-in's init() function
  */
-void             gimp_plug_in_manager_call_init     (GimpPlugInManager      *manager,
-                                                     GimpContext            *context,
-                                                     GimpPlugInDef          *plug_in_def);
+void             gimp_plug_in_manager_call_init      (GimpPlugInManager      *manager,
+                                                      GimpContext            *context,
+                                                      GimpPlugInDef          *plug_in_def);
 
 /*  Run a plug-in as if it were a procedure database procedure
  */
-GimpValueArray * gimp_plug_in_manager_call_run      (GimpPlugInManager      *manager,
-                                                     GimpContext            *context,
-                                                     GimpProgress           *progress,
-                                                     GimpPlugInProcedure    *procedure,
-                                                     GimpValueArray         *args,
-                                                     gboolean                synchronous,
-                                                     GimpDisplay            *display);
+GimpValueArray * gimp_plug_in_manager_call_run       (GimpPlugInManager      *manager,
+                                                      GimpContext            *context,
+                                                      GimpProgress           *progress,
+                                                      GimpPlugInProcedure    *procedure,
+                                                      GimpValueArray         *args,
+                                                      gboolean                synchronous,
+                                                      GimpDisplay            *display);
 
 /*  Run a temp plug-in proc as if it were a procedure database procedure
  */
-GimpValueArray * gimp_plug_in_manager_call_run_temp (GimpPlugInManager      *manager,
-                                                     GimpContext            *context,
-                                                     GimpProgress           *progress,
-                                                     GimpTemporaryProcedure *procedure,
-                                                     GimpValueArray         *args);
+GimpValueArray * gimp_plug_in_manager_call_run_temp  (GimpPlugInManager      *manager,
+                                                      GimpContext            *context,
+                                                      GimpProgress           *progress,
+                                                      GimpTemporaryProcedure *procedure,
+                                                      GimpValueArray         *args);
 
 
 #endif /* __GIMP_PLUG_IN_MANAGER_CALL_H__ */
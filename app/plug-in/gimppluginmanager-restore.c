@@ -48,40 +48,57 @@
 #include "gimppluginmanager-restore.h"
 #include "gimppluginprocedure.h"
 #include "plug-in-rc.h"
+#include "plug-in-rc-cache.h"
 
+#include "gimp-log.h"
 #include "gimp-intl.h"
 
 
-static void    gimp_plug_in_manager_search            (GimpPlugInManager    *manager,
-                                                       GimpInitStatusFunc    status_callback);
-static void    gimp_plug_in_manager_search_directory  (GimpPlugInManager    *manager,
-                                                       GFile                *directory);
-static GFile * gimp_plug_in_manager_get_pluginrc      (GimpPlugInManager    *manager);
-static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager    *manager,
-                                                       GFile                *file,
-                                                       GimpInitStatusFunc    status_callback);
-static void    gimp_plug_in_manager_query_new         (GimpPlugInManager    *manager,
-                                                       GimpContext          *context,
-                                                       GimpInitStatusFunc    status_callback);
-static void    gimp_plug_in_manager_init_plug_ins     (GimpPlugInManager    *manager,
-                                                       GimpContext          *context,
-                                                       GimpInitStatusFunc    status_callback);
-static void    gimp_plug_in_manager_run_extensions    (GimpPlugInManager    *manager,
-                                                       GimpContext          *context,
-                                                       GimpInitStatusFunc    status_callback);
-static void    gimp_plug_in_manager_bind_text_domains (GimpPlugInManager    *manager);
-static void    gimp_plug_in_manager_add_from_file     (GimpPlugInManager    *manager,
-                                                       GFile                *file,
-                                                       guint64               mtime);
-static void    gimp_plug_in_manager_add_from_rc       (GimpPlugInManager    *manager,
-                                                       GimpPlugInDef        *plug_in_def);
-static void    gimp_plug_in_manager_add_to_db         (GimpPlugInManager    *manager,
-                                                       GimpContext          *context,
-                                                       GimpPlugInProcedure  *proc);
-static void    gimp_plug_in_manager_sort_file_procs   (GimpPlugInManager    *manager);
-static gint    gimp_plug_in_manager_file_proc_compare (gconstpointer         a,
-                                                       gconstpointer         b,
-                                                       gpointer              data);
+typedef struct
+{
+  GimpPlugInManager  *manager;
+  GimpInitStatusFunc  status_callback;
+  gint                nth;
+  gint                n_plugins;
+} QueryStatus;
+
+
+static void     gimp_plug_in_manager_search             (GimpPlugInManager    *manager,
+                                                         GimpInitStatusFunc    status_callback);
+static void     gimp_plug_in_manager_search_directory   (GimpPlugInManager    *manager,
+                                                         GFile                *directory);
+static GFile  * gimp_plug_in_manager_get_pluginrc       (GimpPlugInManager    *manager);
+static GFile  * gimp_plug_in_manager_get_pluginrc_cache (GFile                *pluginrc);
+static gboolean gimp_plug_in_manager_read_pluginrc      (GimpPlugInManager    *manager,
+                                                         GFile                *file,
+                                                         GFile                *cache_file,
+                                                         GimpInitStatusFunc    status_callback);
+static void     gimp_plug_in_manager_query_started      (GimpPlugInDef        *plug_in_def,
+                                                         QueryStatus          *status);
+static void     gimp_plug_in_manager_query_new          (GimpPlugInManager    *manager,
+                                                         GimpContext          *context,
+                                                         GimpInitStatusFunc    status_callback);
+static void     gimp_plug_in_manager_init_plug_ins      (GimpPlugInManager    *manager,
+                                                         GimpContext          *context,
+                                                         GimpInitStatusFunc    status_callback);
+static void     gimp_plug_in_manager_run_extensions     (GimpPlugInManager    *manager,
+                                                         GimpContext          *context,
+                                                         GimpInitStatusFunc    status_callback);
+static void     gimp_plug_in_manager_bind_text_domains  (GimpPlugInManager    *manager);
+static void     gimp_plug_in_manager_add_from_file      (GimpPlugInManager    *manager,
+                                                         GFile                *file,
+                                                         guint64               mtime);
+static void     gimp_plug_in_manager_add_from_rc        (GimpPlugInManager    *manager,
+                                                         GimpPlugInDef        *plug_in_def);
+static void     gimp_plug_in_manager_add_to_db          (GimpPlugInManager    *manager,
+                                                         GimpContext          *context,
+                                                         GimpPlugInProcedure  *proc);
+static void     gimp_plug_in_manager_sort_file_procs    (GimpPlugInManager    *manager);
+static gint     gimp_plug_in_manager_file_proc_compare  (gconstpointer         a,
+                                                         gconstpointer         b,
+                                                         gpointer              data);
+static void     gimp_plug_in_manager_log_phase          (GTimer               *timer,
+                                                         const gchar          *phase);
 
 
 
@@ -90,10 +107,14 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
                               GimpContext        *context,
                               GimpInitStatusFunc  status_callback)
 {
-  Gimp   *gimp;
-  GFile  *pluginrc;
-  GSList *list;
-  GError *error = NULL;
+  Gimp     *gimp;
+  GFile    *pluginrc;
+  GFile    *pluginrc_cache;
+  gboolean  cache_valid;
+  GSList   *list;
+  GTimer   *timer;
+  GTimer   *total_timer;
+  GError   *error = NULL;
 
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -101,22 +122,33 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
 
   gimp = manager->gimp;
 
+  /* time the phases of the startup, see GIMP_LOG=startup */
+  timer       = g_timer_new ();
+  total_timer = g_timer_new ();
+
   /* need a GimpPDBContext for calling gimp_plug_in_manager_run_foo() */
   context = gimp_pdb_context_new (gimp, context, TRUE);
 
   /* search for binaries in the plug-in directory path */
   gimp_plug_in_manager_search (manager, status_callback);
+  gimp_plug_in_manager_log_phase (timer, "searching plug-ins");
 
   /* read the pluginrc file for cached data */
-  pluginrc = gimp_plug_in_manager_get_pluginrc (manager);
+  pluginrc       = gimp_plug_in_manager_get_pluginrc (manager);
+  pluginrc_cache = gimp_plug_in_manager_get_pluginrc_cache (pluginrc);
 
-  gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
+  cache_valid = gimp_plug_in_manager_read_pluginrc (manager,
+                                                    pluginrc, pluginrc_cache,
+                                                    status_callback);
+  gimp_plug_in_manager_log_phase (timer, "reading pluginrc");
 
   /* query any plug-ins that changed since we last wrote out pluginrc */
   gimp_plug_in_manager_query_new (manager, context, status_callback);
+  gimp_plug_in_manager_log_phase (timer, "querying new plug-ins");
 
   /* initialize the plug-ins */
   gimp_plug_in_manager_init_plug_ins (manager, context, status_callback);
+  gimp_plug_in_manager_log_phase (timer, "initializing plug-ins");
 
   /* add the procedures to manager->plug_in_procedures */
   for (list = manager->plug_in_defs; list; list = list->next)
@@ -136,16 +168,47 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
       if (gimp->be_verbose)
         g_print ("Writing '%s'\n", gimp_file_get_utf8_name (pluginrc));
 
-      if (! plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+      if (plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+        {
+          cache_valid = FALSE;
+        }
+      else
         {
           gimp_message_literal (gimp,
                                 NULL, GIMP_MESSAGE_ERROR, error->message);
           g_clear_error (&error);
+
+          /* keep the cache matching the pluginrc that is still on disk */
+          cache_valid = TRUE;
         }
 
       manager->write_pluginrc = FALSE;
+
+      gimp_plug_in_manager_log_phase (timer, "writing pluginrc");
+    }
+
+  /* write the pluginrc cache if the pluginrc changed, or if the cache
+   * was missing or out of date
+   */
+  if (! cache_valid)
+    {
+      if (gimp->be_verbose)
+        g_print ("Writing '%s'\n", gimp_file_get_utf8_name (pluginrc_cache));
+
+      if (! plug_in_rc_cache_write (manager->plug_in_defs,
+                                    pluginrc_cache, pluginrc, &error))
+        {
+          /* not fatal, we just parse the pluginrc next time */
+          if (gimp->be_verbose)
+            g_printerr ("%s\n", error->message);
+
+          g_clear_error (&error);
+        }
+
+      gimp_plug_in_manager_log_phase (timer, "writing pluginrc cache");
     }
 
+  g_object_unref (pluginrc_cache);
   g_object_unref (pluginrc);
 
   /* create locale and help domain lists */
@@ -188,8 +251,15 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
 
   /* sort the load, save and export procedures, make the raw handler list */
   gimp_plug_in_manager_sort_file_procs (manager);
+  gimp_plug_in_manager_log_phase (timer, "registering procedures");
 
   gimp_plug_in_manager_run_extensions (manager, context, status_callback);
+  gimp_plug_in_manager_log_phase (timer, "running extensions");
+
+  gimp_plug_in_manager_log_phase (total_timer, "total");
+
+  g_timer_destroy (timer);
+  g_timer_destroy (total_timer);
 
   g_object_unref (context);
 }
@@ -418,22 +488,61 @@ gimp_plug_in_manager_get_pluginrc (GimpPlugInManager *manager)
   return pluginrc;
 }
 
-/* read the pluginrc file for cached data */
-static void
+/* the binary pluginrc cache lives next to the pluginrc */
+static GFile *
+gimp_plug_in_manager_get_pluginrc_cache (GFile *pluginrc)
+{
+  GFile *parent   = g_file_get_parent (pluginrc);
+  gchar *basename = g_file_get_basename (pluginrc);
+  gchar *name     = g_strconcat (basename, ".cache", NULL);
+  GFile *cache    = g_file_get_child (parent, name);
+
+  g_free (name);
+  g_free (basename);
+  g_object_unref (parent);
+
+  return cache;
+}
+
+/* read the pluginrc file for cached data, from its binary cache if it is
+ * up to date.  returns whether the cache was used.
+ */
+static gboolean
 gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
                                     GFile              *pluginrc,
+                                    GFile              *cache_file,
                                     GimpInitStatusFunc  status_callback)
 {
-  GSList *rc_defs;
-  GError *error = NULL;
+  GSList   *rc_defs;
+  gboolean  cache_valid;
+  GError   *error = NULL;
 
   status_callback (_("Resource configuration"),
                    gimp_file_get_utf8_name (pluginrc), 0.0);
 
-  if (manager->gimp->be_verbose)
-    g_print ("Parsing '%s'\n", gimp_file_get_utf8_name (pluginrc));
+  cache_valid = plug_in_rc_cache_parse (manager->gimp, cache_file, pluginrc,
+                                        &rc_defs, &error);
+
+  if (cache_valid)
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Parsed '%s'\n", gimp_file_get_utf8_name (cache_file));
+    }
+  else
+    {
+      if (error)
+        {
+          if (manager->gimp->be_verbose)
+            g_printerr ("%s\n", error->message);
+
+          g_clear_error (&error);
+        }
 
-  rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+      if (manager->gimp->be_verbose)
+        g_print ("Parsing '%s'\n", gimp_file_get_utf8_name (pluginrc));
+
+      rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+    }
 
   if (rc_defs)
     {
@@ -452,6 +561,24 @@ gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
 
       g_clear_error (&error);
     }
+
+  return cache_valid;
+}
+
+static void
+gimp_plug_in_manager_query_started (GimpPlugInDef *plug_in_def,
+                                    QueryStatus   *status)
+{
+  gchar *basename;
+
+  basename = g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
+  status->status_callback (NULL, basename,
+                           (gdouble) status->nth++ / (gdouble) status->n_plugins);
+  g_free (basename);
+
+  if (status->manager->gimp->be_verbose)
+    g_print ("Querying plug-in: '%s'\n",
+             gimp_file_get_utf8_name (plug_in_def->file));
 }
 
 /* query any plug-ins that changed since we last wrote out pluginrc */
@@ -461,45 +588,50 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
                                 GimpInitStatusFunc  status_callback)
 {
   GSList *list;
-  gint    n_plugins;
+  GSList *query_defs = NULL;
 
   status_callback (_("Querying new Plug-ins"), "", 0.0);
 
-  for (list = manager->plug_in_defs, n_plugins = 0; list; list = list->next)
+  for (list = manager->plug_in_defs; list; list = list->next)
     {
       GimpPlugInDef *plug_in_def = list->data;
 
       if (plug_in_def->needs_query)
-        n_plugins++;
+        query_defs = g_slist_prepend (query_defs, plug_in_def);
     }
 
-  if (n_plugins)
+  if (query_defs)
     {
-      gint nth;
+      QueryStatus status;
+      gint        max_queries;
 
       manager->write_pluginrc = TRUE;
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
-        {
-          GimpPlugInDef *plug_in_def = list->data;
+      query_defs = g_slist_reverse (query_defs);
 
-          if (plug_in_def->needs_query)
-            {
-              gchar *basename;
+      status.manager         = manager;
+      status.status_callback = status_callback;
+      status.nth             = 0;
+      status.n_plugins       = g_slist_length (query_defs);
 
-              basename =
-                g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
+      /* the plug-ins spend most of their query() starting up, so run
+       * as many at once as we have processors, but only one at a time
+       * when debugging them
+       */
+      if (manager->debug)
+        max_queries = 1;
+      else
+        max_queries = GIMP_GEGL_CONFIG (manager->gimp->config)->num_processors;
 
-              if (manager->gimp->be_verbose)
-                g_print ("Querying plug-in: '%s'\n",
-                         gimp_file_get_utf8_name (plug_in_def->file));
+      GIMP_LOG (STARTUP, "querying %d plug-ins, %d at a time",
+                status.n_plugins, max_queries);
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
-            }
-        }
+      gimp_plug_in_manager_call_query_all (manager, context, query_defs,
+                                           max_queries,
+                                           (GFunc) gimp_plug_in_manager_query_started,
+                                           &status);
+
+      g_slist_free (query_defs);
     }
 
   status_callback (NULL, "", 1.0);
@@ -1065,3 +1197,12 @@ gimp_plug_in_manager_file_proc_compare (gconstpointer a,
 
   return strcmp (gimp_object_get_name (proc_a), gimp_object_get_name (proc_b));
 }
+
+static void
+gimp_plug_in_manager_log_phase (GTimer      *timer,
+                                const gchar *phase)
+{
+  GIMP_LOG (STARTUP, "%s: %.3f s", phase, g_timer_elapsed (timer, NULL));
+
+  g_timer_start (timer);
+}
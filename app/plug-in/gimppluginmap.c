@@ -0,0 +1,296 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmap.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_MEMFD_CREATE
+#define _GNU_SOURCE  /* for memfd_create() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "plug-in-types.h"
+
+#include "core/gimpdrawable.h"
+
+#include "gimppluginmap.h"
+
+#include "gimp-log.h"
+
+
+/*  A GimpPlugInMap is a snapshot of a drawable's pixels in an anonymous
+ *  memory file, which the plug-in maps into its address space to access
+ *  the pixels directly, instead of transferring them tile by tile.  The
+ *  file descriptor is passed to the plug-in over the wire, which is a
+ *  socket for this purpose, see gimp_plug_in_map_pipe().
+ */
+
+struct _GimpPlugInMap
+{
+  GimpDrawable  *drawable;
+  gboolean       shadow;
+  gint           fd;
+  guchar        *addr;
+  gsize          size;
+  GeglRectangle  extent;
+  const Babl    *format;
+};
+
+
+/*  creates the pipe the core writes to the plug-in through, which is a
+ *  socket where possible, so that mappings can be passed along
+ */
+gint
+gimp_plug_in_map_pipe (gint fds[2])
+{
+#ifdef HAVE_MEMFD_CREATE
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) == 0)
+    return 0;
+#endif
+
+  return pipe (fds);
+}
+
+/*  returns whether mappings can be passed to the plug-in over @channel  */
+gboolean
+gimp_plug_in_map_can_send (GIOChannel *channel)
+{
+#ifdef HAVE_MEMFD_CREATE
+  struct stat st;
+
+  g_return_val_if_fail (channel != NULL, FALSE);
+
+  return (fstat (g_io_channel_unix_get_fd (channel), &st) == 0 &&
+          S_ISSOCK (st.st_mode));
+#else
+  return FALSE;
+#endif
+}
+
+GimpPlugInMap *
+gimp_plug_in_map_new (GimpDrawable  *drawable,
+                      gboolean       shadow,
+                      GeglBuffer    *buffer,
+                      GError       **error)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GimpPlugInMap *map;
+  const Babl    *format;
+  gint           bpp;
+  guchar        *addr;
+  gsize          size;
+  gint           fd;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  format = gegl_buffer_get_format (buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+  size   = ((gsize) gegl_buffer_get_width (buffer) *
+            (gsize) gegl_buffer_get_height (buffer) * bpp);
+
+  if (size == 0)
+    return NULL;
+
+  fd = memfd_create ("gimp-drawable", MFD_CLOEXEC);
+
+  if (fd == -1)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "memfd_create() failed: %s", g_strerror (errno));
+      return NULL;
+    }
+
+  if (ftruncate (fd, size) == -1)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "ftruncate() failed: %s", g_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+
+  addr = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (addr == MAP_FAILED)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "mmap() failed: %s", g_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+
+  map = g_slice_new0 (GimpPlugInMap);
+
+  map->drawable = g_object_ref (drawable);
+  map->shadow   = shadow;
+  map->fd       = fd;
+  map->addr     = addr;
+  map->size     = size;
+  map->extent   = *gegl_buffer_get_extent (buffer);
+  map->format   = format;
+
+  gegl_buffer_get (buffer, &map->extent, 1.0, format,
+                   map->addr, map->extent.width * bpp,
+                   GEGL_ABYSS_NONE);
+
+  GIMP_LOG (SHM, "mapped drawable %d to fd %d (%" G_GSIZE_FORMAT " bytes)",
+            gimp_item_get_id (GIMP_ITEM (drawable)), fd, size);
+
+  return map;
+#else
+  return NULL;
+#endif
+}
+
+void
+gimp_plug_in_map_free (GimpPlugInMap *map)
+{
+  g_return_if_fail (map != NULL);
+
+#ifdef HAVE_MEMFD_CREATE
+  munmap (map->addr, map->size);
+  close (map->fd);
+
+  GIMP_LOG (SHM, "unmapped fd %d", map->fd);
+#endif
+
+  g_object_unref (map->drawable);
+
+  g_slice_free (GimpPlugInMap, map);
+}
+
+/*  passes the mapping's file descriptor to the plug-in, as ancillary data
+ *  of a single byte following the GP_DRAWABLE_MAP reply on @channel
+ */
+gboolean
+gimp_plug_in_map_send (GimpPlugInMap  *map,
+                       GIOChannel     *channel,
+                       GError        **error)
+{
+#ifdef HAVE_MEMFD_CREATE
+  union
+  {
+    struct cmsghdr header;
+    gchar          buf[CMSG_SPACE (sizeof (gint))];
+  } control;
+  struct msghdr   msg;
+  struct cmsghdr *cmsg;
+  struct iovec    iov;
+  guchar          byte = 0;
+  gssize          bytes;
+
+  g_return_val_if_fail (map != NULL, FALSE);
+  g_return_val_if_fail (channel != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  memset (&msg,     0, sizeof (msg));
+  memset (&control, 0, sizeof (control));
+
+  iov.iov_base = &byte;
+  iov.iov_len  = 1;
+
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  cmsg = CMSG_FIRSTHDR (&msg);
+
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type  = SCM_RIGHTS;
+  cmsg->cmsg_len   = CMSG_LEN (sizeof (gint));
+
+  memcpy (CMSG_DATA (cmsg), &map->fd, sizeof (gint));
+
+  do
+    bytes = sendmsg (g_io_channel_unix_get_fd (channel), &msg, 0);
+  while (bytes == -1 && errno == EINTR);
+
+  if (bytes != 1)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "sendmsg() failed: %s", g_strerror (errno));
+      return FALSE;
+    }
+
+  return TRUE;
+#else
+  g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+                       "Mapping drawables is not supported");
+  return FALSE;
+#endif
+}
+
+gint
+gimp_plug_in_map_get_fd (GimpPlugInMap *map)
+{
+  g_return_val_if_fail (map != NULL, -1);
+
+  return map->fd;
+}
+
+GimpDrawable *
+gimp_plug_in_map_get_drawable (GimpPlugInMap *map)
+{
+  g_return_val_if_fail (map != NULL, NULL);
+
+  return map->drawable;
+}
+
+gboolean
+gimp_plug_in_map_get_shadow (GimpPlugInMap *map)
+{
+  g_return_val_if_fail (map != NULL, FALSE);
+
+  return map->shadow;
+}
+
+void
+gimp_plug_in_map_store (GimpPlugInMap       *map,
+                        GeglBuffer          *buffer,
+                        const GeglRectangle *rect)
+{
+  GeglRectangle area;
+  gint          bpp;
+
+  g_return_if_fail (map != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (rect != NULL);
+
+  if (! gegl_rectangle_intersect (&area, rect, &map->extent))
+    return;
+
+  bpp = babl_format_get_bytes_per_pixel (map->format);
+
+  gegl_buffer_set (buffer, &area, 0, map->format,
+                   map->addr +
+                   ((gsize) (area.y - map->extent.y) * map->extent.width +
+                    (area.x - map->extent.x)) * bpp,
+                   map->extent.width * bpp);
+}
@@ -0,0 +1,46 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmap.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_PLUG_IN_MAP_H__
+#define __GIMP_PLUG_IN_MAP_H__
+
+
+gint            gimp_plug_in_map_pipe         (gint                 fds[2]);
+gboolean        gimp_plug_in_map_can_send     (GIOChannel          *channel);
+
+GimpPlugInMap * gimp_plug_in_map_new          (GimpDrawable        *drawable,
+                                               gboolean             shadow,
+                                               GeglBuffer          *buffer,
+                                               GError             **error);
+void            gimp_plug_in_map_free         (GimpPlugInMap       *map);
+
+gboolean        gimp_plug_in_map_send         (GimpPlugInMap       *map,
+                                               GIOChannel          *channel,
+                                               GError             **error);
+
+gint            gimp_plug_in_map_get_fd       (GimpPlugInMap       *map);
+GimpDrawable  * gimp_plug_in_map_get_drawable (GimpPlugInMap       *map);
+gboolean        gimp_plug_in_map_get_shadow   (GimpPlugInMap       *map);
+
+void            gimp_plug_in_map_store        (GimpPlugInMap       *map,
+                                               GeglBuffer          *buffer,
+                                               const GeglRectangle *rect);
+
+
+#endif /* __GIMP_PLUG_IN_MAP_H__ */
@@ -62,6 +62,8 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "core/gimp-utils.h"
@@ -71,7 +73,9 @@
 #include "gimp-log.h"
 
 
-#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 32)
+/*  large enough for a full batch of 4 bytes per pixel tiles  */
+#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * \
+                       4 * GP_TILE_BATCH_MAX_TILES)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -299,3 +303,11 @@ gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
 
   return shm->shm_addr;
 }
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return TILE_MAP_SIZE;
+}
@@ -0,0 +1,1081 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-rc-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpconfig/gimpconfig.h"
+
+#include "libgimp/gimpgpparams.h"
+
+#include "plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "gimpplugindef.h"
+#include "gimppluginprocedure.h"
+#include "plug-in-rc-cache.h"
+
+#include "gimp-intl.h"
+
+
+/*  the pluginrc cache is a binary copy of the pluginrc, which is mapped
+ *  into memory at startup instead of being tokenized.  it is only ever
+ *  written right after the pluginrc itself, and remembers the pluginrc's
+ *  modification time and size; if they don't match anymore, the cache
+ *  is ignored and the pluginrc is parsed as usual.
+ *
+ *  the file is a header, followed by arrays of fixed-size records for
+ *  the plug-in defs, their procedures, the procedures' arguments and
+ *  return values, and the procedures' menu paths, followed by a pool of
+ *  NUL-terminated strings and icon data.  records refer to each other by
+ *  index, and to the pool by offset, where offset 0 means NULL.  numbers
+ *  are stored in the host's byte order; a cache written on a host with a
+ *  different byte order is simply ignored.
+ */
+
+
+#define PLUG_IN_RC_CACHE_MAGIC      "GIMPPRC"
+#define PLUG_IN_RC_CACHE_VERSION    1
+#define PLUG_IN_RC_CACHE_BYTE_ORDER 0x01020304
+
+
+enum
+{
+  PROC_FILE_PROC      = 1 << 0,
+  PROC_HANDLES_REMOTE = 1 << 1,
+  PROC_HANDLES_RAW    = 1 << 2
+};
+
+
+typedef struct
+{
+  gchar    magic[8];
+  guint32  byte_order;
+  guint32  cache_version;
+  guint32  protocol_version;
+  guint32  data_size;
+  gint64   pluginrc_mtime;
+  guint64  pluginrc_size;
+  guint32  n_defs;
+  guint32  n_procs;
+  guint32  n_args;
+  guint32  n_menu_paths;
+} PlugInRcCacheHeader;
+
+typedef struct
+{
+  guint32  path;
+  guint32  locale_domain_name;
+  guint32  locale_domain_path;
+  guint32  help_domain_name;
+  guint32  help_domain_uri;
+  guint32  has_init;
+  guint32  first_proc;
+  guint32  n_procs;
+  gint64   mtime;
+} PlugInRcCacheDef;
+
+typedef struct
+{
+  guint32  name;
+  guint32  proc_type;
+  guint32  blurb;
+  guint32  help;
+  guint32  authors;
+  guint32  copyright;
+  guint32  date;
+  guint32  menu_label;
+  guint32  first_menu_path;
+  guint32  n_menu_paths;
+  guint32  icon_type;
+  gint32   icon_data_length;
+  guint32  icon_data;
+  guint32  flags;
+  guint32  extensions;
+  guint32  prefixes;
+  guint32  magics;
+  guint32  mime_types;
+  guint32  thumb_loader;
+  gint32   priority;
+  guint32  image_types;
+  guint32  first_arg;
+  guint32  n_args;
+  guint32  n_values;
+} PlugInRcCacheProc;
+
+typedef struct
+{
+  guint32  param_def_type;
+  guint32  type_name;
+  guint32  value_type_name;
+  guint32  name;
+  guint32  nick;
+  guint32  blurb;
+  guint32  flags;
+  guint32  meta_string;
+  gint64   meta_int[3];
+  gdouble  meta_float[4];
+} PlugInRcCacheArg;
+
+G_STATIC_ASSERT (sizeof (PlugInRcCacheHeader) % 8 == 0);
+G_STATIC_ASSERT (sizeof (PlugInRcCacheDef)    % 8 == 0);
+G_STATIC_ASSERT (sizeof (PlugInRcCacheProc)   % 8 == 0);
+G_STATIC_ASSERT (sizeof (PlugInRcCacheArg)    % 8 == 0);
+
+typedef struct
+{
+  const PlugInRcCacheHeader *header;
+  const PlugInRcCacheDef    *defs;
+  const PlugInRcCacheProc   *procs;
+  const PlugInRcCacheArg    *args;
+  const guint32             *menu_paths;
+  const gchar               *data;
+
+  GEnumClass                *icon_type_class;
+} PlugInRcCacheReader;
+
+typedef struct
+{
+  GArray                    *defs;
+  GArray                    *procs;
+  GArray                    *args;
+  GArray                    *menu_paths;
+  GByteArray                *data;
+
+  GHashTable                *strings;
+} PlugInRcCacheWriter;
+
+
+static gboolean              plug_in_rc_cache_stat        (GFile                     *pluginrc,
+                                                           gint64                    *mtime,
+                                                           guint64                   *size);
+
+static gboolean              plug_in_rc_cache_get_string  (PlugInRcCacheReader       *reader,
+                                                           guint32                    offset,
+                                                           const gchar              **string);
+static gboolean              plug_in_rc_cache_dup_string  (PlugInRcCacheReader       *reader,
+                                                           guint32                    offset,
+                                                           gchar                    **string);
+static GimpPlugInDef       * plug_in_rc_cache_decode_def  (PlugInRcCacheReader       *reader,
+                                                           const PlugInRcCacheDef    *record);
+static GimpPlugInProcedure * plug_in_rc_cache_decode_proc (PlugInRcCacheReader       *reader,
+                                                           const PlugInRcCacheProc   *record,
+                                                           GFile                     *file);
+static gboolean              plug_in_rc_cache_decode_arg  (PlugInRcCacheReader       *reader,
+                                                           const PlugInRcCacheArg    *record,
+                                                           GimpProcedure             *procedure,
+                                                           gboolean                   return_value);
+
+static guint32               plug_in_rc_cache_add_string  (PlugInRcCacheWriter       *writer,
+                                                           const gchar               *string);
+static guint32               plug_in_rc_cache_add_data    (PlugInRcCacheWriter       *writer,
+                                                           const guint8              *data,
+                                                           gint                       length);
+static void                  plug_in_rc_cache_encode_proc (PlugInRcCacheWriter       *writer,
+                                                           GimpPlugInProcedure       *proc);
+static void                  plug_in_rc_cache_encode_arg  (PlugInRcCacheWriter       *writer,
+                                                           GParamSpec                *pspec);
+
+
+/*  public functions  */
+
+/*  returns FALSE, without setting an error, if there is no cache, or if
+ *  it is out of date; and FALSE with an error if the cache is damaged.
+ */
+gboolean
+plug_in_rc_cache_parse (Gimp     *gimp,
+                        GFile    *cache_file,
+                        GFile    *pluginrc,
+                        GSList  **plug_in_defs,
+                        GError  **error)
+{
+  PlugInRcCacheReader  reader = { 0, };
+  GMappedFile         *mapped;
+  const gchar         *contents;
+  gsize                length;
+  guint64              expected;
+  gint64               pluginrc_mtime;
+  guint64              pluginrc_size;
+  GSList              *defs    = NULL;
+  gboolean             success = TRUE;
+  guint                i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
+  g_return_val_if_fail (G_IS_FILE (cache_file), FALSE);
+  g_return_val_if_fail (G_IS_FILE (pluginrc), FALSE);
+  g_return_val_if_fail (plug_in_defs != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  *plug_in_defs = NULL;
+
+  if (! g_file_is_native (cache_file) ||
+      ! plug_in_rc_cache_stat (pluginrc, &pluginrc_mtime, &pluginrc_size))
+    return FALSE;
+
+  mapped = g_mapped_file_new (g_file_peek_path (cache_file), FALSE, NULL);
+
+  if (! mapped)
+    return FALSE;
+
+  contents = g_mapped_file_get_contents (mapped);
+  length   = g_mapped_file_get_length (mapped);
+
+  reader.header = (const PlugInRcCacheHeader *) contents;
+
+  if (length < sizeof (PlugInRcCacheHeader)                       ||
+      memcmp (reader.header->magic, PLUG_IN_RC_CACHE_MAGIC,
+              sizeof (PLUG_IN_RC_CACHE_MAGIC))                     ||
+      reader.header->byte_order       != PLUG_IN_RC_CACHE_BYTE_ORDER ||
+      reader.header->cache_version    != PLUG_IN_RC_CACHE_VERSION    ||
+      reader.header->protocol_version != GIMP_PROTOCOL_VERSION       ||
+      reader.header->pluginrc_mtime   != pluginrc_mtime              ||
+      reader.header->pluginrc_size    != pluginrc_size)
+    {
+      g_mapped_file_unref (mapped);
+
+      return FALSE;
+    }
+
+  expected = (sizeof (PlugInRcCacheHeader)                                  +
+              (guint64) reader.header->n_defs  * sizeof (PlugInRcCacheDef)  +
+              (guint64) reader.header->n_procs * sizeof (PlugInRcCacheProc) +
+              (guint64) reader.header->n_args  * sizeof (PlugInRcCacheArg)  +
+              (guint64) reader.header->n_menu_paths * sizeof (guint32)      +
+              reader.header->data_size);
+
+  if (expected != length || reader.header->data_size == 0)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_PARSE,
+                   _("Skipping '%s': file is truncated or corrupt."),
+                   gimp_file_get_utf8_name (cache_file));
+
+      g_mapped_file_unref (mapped);
+
+      return FALSE;
+    }
+
+  reader.defs       = (const PlugInRcCacheDef *) (reader.header + 1);
+  reader.procs      = (const PlugInRcCacheProc *) (reader.defs +
+                                                   reader.header->n_defs);
+  reader.args       = (const PlugInRcCacheArg *) (reader.procs +
+                                                  reader.header->n_procs);
+  reader.menu_paths = (const guint32 *) (reader.args + reader.header->n_args);
+  reader.data       = (const gchar *) (reader.menu_paths +
+                                       reader.header->n_menu_paths);
+
+  reader.icon_type_class = g_type_class_ref (GIMP_TYPE_ICON_TYPE);
+
+  for (i = 0; i < reader.header->n_defs; i++)
+    {
+      GimpPlugInDef *plug_in_def;
+
+      plug_in_def = plug_in_rc_cache_decode_def (&reader, &reader.defs[i]);
+
+      if (! plug_in_def)
+        {
+          g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_PARSE,
+                       _("Skipping '%s': file is truncated or corrupt."),
+                       gimp_file_get_utf8_name (cache_file));
+
+          g_slist_free_full (defs, (GDestroyNotify) g_object_unref);
+          defs    = NULL;
+          success = FALSE;
+
+          break;
+        }
+
+      defs = g_slist_prepend (defs, plug_in_def);
+    }
+
+  g_type_class_unref (reader.icon_type_class);
+
+  g_mapped_file_unref (mapped);
+
+  *plug_in_defs = g_slist_reverse (defs);
+
+  return success;
+}
+
+/*  writes the cache for 'plug_in_defs', which must have just been written
+ *  to 'pluginrc', with the same rules as plug_in_rc_write().
+ */
+gboolean
+plug_in_rc_cache_write (GSList  *plug_in_defs,
+                        GFile   *cache_file,
+                        GFile   *pluginrc,
+                        GError **error)
+{
+  PlugInRcCacheWriter  writer;
+  PlugInRcCacheHeader  header = { { 0, }, };
+  GByteArray          *contents;
+  GSList              *list;
+  gboolean             success;
+
+  g_return_val_if_fail (G_IS_FILE (cache_file), FALSE);
+  g_return_val_if_fail (G_IS_FILE (pluginrc), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (! plug_in_rc_cache_stat (pluginrc,
+                               &header.pluginrc_mtime,
+                               &header.pluginrc_size))
+    {
+      /*  without a pluginrc, there is nothing to cache  */
+      return TRUE;
+    }
+
+  writer.defs       = g_array_new (FALSE, TRUE, sizeof (PlugInRcCacheDef));
+  writer.procs      = g_array_new (FALSE, TRUE, sizeof (PlugInRcCacheProc));
+  writer.args       = g_array_new (FALSE, TRUE, sizeof (PlugInRcCacheArg));
+  writer.menu_paths = g_array_new (FALSE, TRUE, sizeof (guint32));
+  writer.data       = g_byte_array_new ();
+  writer.strings    = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, NULL);
+
+  /*  offset 0 is NULL  */
+  g_byte_array_append (writer.data, (const guint8 *) "", 1);
+
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    {
+      GimpPlugInDef    *plug_in_def = list->data;
+      PlugInRcCacheDef  def         = { 0, };
+      GSList           *list2;
+      gchar            *path;
+
+      if (! plug_in_def->procedures)
+        continue;
+
+      path = gimp_file_get_config_path (plug_in_def->file, NULL);
+      if (! path)
+        continue;
+
+      def.path       = plug_in_rc_cache_add_string (&writer, path);
+      def.mtime      = plug_in_def->mtime;
+      def.has_init   = plug_in_def->has_init;
+      def.first_proc = writer.procs->len;
+
+      g_free (path);
+
+      for (list2 = plug_in_def->procedures; list2; list2 = g_slist_next (list2))
+        {
+          GimpPlugInProcedure *proc = list2->data;
+
+          if (proc->installed_during_init)
+            continue;
+
+          plug_in_rc_cache_encode_proc (&writer, proc);
+        }
+
+      def.n_procs = writer.procs->len - def.first_proc;
+
+      if (plug_in_def->locale_domain_name)
+        {
+          def.locale_domain_name =
+            plug_in_rc_cache_add_string (&writer,
+                                         plug_in_def->locale_domain_name);
+
+          if (plug_in_def->locale_domain_path)
+            {
+              path = gimp_config_path_unexpand (plug_in_def->locale_domain_path,
+                                                TRUE, NULL);
+
+              def.locale_domain_path = plug_in_rc_cache_add_string (&writer,
+                                                                    path);
+
+              g_free (path);
+            }
+        }
+
+      if (plug_in_def->help_domain_name)
+        {
+          def.help_domain_name =
+            plug_in_rc_cache_add_string (&writer,
+                                         plug_in_def->help_domain_name);
+          def.help_domain_uri  =
+            plug_in_rc_cache_add_string (&writer,
+                                         plug_in_def->help_domain_uri);
+        }
+
+      g_array_append_val (writer.defs, def);
+    }
+
+  memcpy (header.magic, PLUG_IN_RC_CACHE_MAGIC, sizeof (PLUG_IN_RC_CACHE_MAGIC));
+  header.byte_order       = PLUG_IN_RC_CACHE_BYTE_ORDER;
+  header.cache_version    = PLUG_IN_RC_CACHE_VERSION;
+  header.protocol_version = GIMP_PROTOCOL_VERSION;
+  header.data_size        = writer.data->len;
+  header.n_defs           = writer.defs->len;
+  header.n_procs          = writer.procs->len;
+  header.n_args           = writer.args->len;
+  header.n_menu_paths     = writer.menu_paths->len;
+
+  contents = g_byte_array_sized_new (sizeof (header)                              +
+                                     writer.defs->len  * sizeof (PlugInRcCacheDef)  +
+                                     writer.procs->len * sizeof (PlugInRcCacheProc) +
+                                     writer.args->len  * sizeof (PlugInRcCacheArg)  +
+                                     writer.menu_paths->len * sizeof (guint32)      +
+                                     writer.data->len);
+
+  g_byte_array_append (contents, (const guint8 *) &header, sizeof (header));
+  g_byte_array_append (contents, (const guint8 *) writer.defs->data,
+                       writer.defs->len * sizeof (PlugInRcCacheDef));
+  g_byte_array_append (contents, (const guint8 *) writer.procs->data,
+                       writer.procs->len * sizeof (PlugInRcCacheProc));
+  g_byte_array_append (contents, (const guint8 *) writer.args->data,
+                       writer.args->len * sizeof (PlugInRcCacheArg));
+  g_byte_array_append (contents, (const guint8 *) writer.menu_paths->data,
+                       writer.menu_paths->len * sizeof (guint32));
+  g_byte_array_append (contents, writer.data->data, writer.data->len);
+
+  g_array_free (writer.defs,       TRUE);
+  g_array_free (writer.procs,      TRUE);
+  g_array_free (writer.args,       TRUE);
+  g_array_free (writer.menu_paths, TRUE);
+  g_byte_array_free (writer.data,  TRUE);
+  g_hash_table_unref (writer.strings);
+
+  success = g_file_replace_contents (cache_file,
+                                     (const gchar *) contents->data,
+                                     contents->len,
+                                     NULL, FALSE, G_FILE_CREATE_NONE,
+                                     NULL, NULL, error);
+
+  g_byte_array_free (contents, TRUE);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+static gboolean
+plug_in_rc_cache_stat (GFile   *pluginrc,
+                       gint64  *mtime,
+                       guint64 *size)
+{
+  GFileInfo *info;
+
+  info = g_file_query_info (pluginrc,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+
+  if (! info)
+    return FALSE;
+
+  *mtime = ((gint64) g_file_info_get_attribute_uint64 (info,
+                                                       G_FILE_ATTRIBUTE_TIME_MODIFIED) *
+            G_USEC_PER_SEC +
+            g_file_info_get_attribute_uint32 (info,
+                                              G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+  *size  = g_file_info_get_size (info);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+static gboolean
+plug_in_rc_cache_get_string (PlugInRcCacheReader  *reader,
+                             guint32               offset,
+                             const gchar         **string)
+{
+  guint32 data_size = reader->header->data_size;
+
+  if (offset >= data_size ||
+      ! memchr (reader->data + offset, '\0', data_size - offset))
+    {
+      return FALSE;
+    }
+
+  if (offset == 0 || ! reader->data[offset])
+    *string = NULL;
+  else
+    *string = reader->data + offset;
+
+  return TRUE;
+}
+
+static gboolean
+plug_in_rc_cache_dup_string (PlugInRcCacheReader  *reader,
+                             guint32               offset,
+                             gchar               **string)
+{
+  const gchar *str;
+
+  if (! plug_in_rc_cache_get_string (reader, offset, &str))
+    return FALSE;
+
+  *string = g_strdup (str);
+
+  return TRUE;
+}
+
+static GimpPlugInDef *
+plug_in_rc_cache_decode_def (PlugInRcCacheReader    *reader,
+                             const PlugInRcCacheDef *record)
+{
+  GimpPlugInDef *plug_in_def;
+  GFile         *file;
+  const gchar   *path;
+  const gchar   *domain_name;
+  const gchar   *domain_path;
+  guint          i;
+
+  if (! plug_in_rc_cache_get_string (reader, record->path, &path) || ! path)
+    return NULL;
+
+  if ((guint64) record->first_proc + record->n_procs >
+      reader->header->n_procs)
+    return NULL;
+
+  file = gimp_file_new_for_config_path (path, NULL);
+
+  if (! file)
+    return NULL;
+
+  plug_in_def = gimp_plug_in_def_new (file);
+  g_object_unref (file);
+
+  plug_in_def->mtime = record->mtime;
+
+  for (i = 0; i < record->n_procs; i++)
+    {
+      GimpPlugInProcedure *proc;
+
+      proc = plug_in_rc_cache_decode_proc (reader,
+                                           &reader->procs[record->first_proc + i],
+                                           plug_in_def->file);
+
+      if (! proc)
+        {
+          g_object_unref (plug_in_def);
+
+          return NULL;
+        }
+
+      gimp_plug_in_def_add_procedure (plug_in_def, proc);
+      g_object_unref (proc);
+    }
+
+  if (! plug_in_rc_cache_get_string (reader, record->locale_domain_name,
+                                     &domain_name) ||
+      ! plug_in_rc_cache_get_string (reader, record->locale_domain_path,
+                                     &domain_path))
+    {
+      g_object_unref (plug_in_def);
+
+      return NULL;
+    }
+
+  if (domain_name)
+    {
+      gchar *expanded_path = NULL;
+
+      if (domain_path)
+        expanded_path = gimp_config_path_expand (domain_path, TRUE, NULL);
+
+      gimp_plug_in_def_set_locale_domain (plug_in_def,
+                                          domain_name, expanded_path);
+
+      g_free (expanded_path);
+    }
+
+  if (! plug_in_rc_cache_get_string (reader, record->help_domain_name,
+                                     &domain_name) ||
+      ! plug_in_rc_cache_get_string (reader, record->help_domain_uri,
+                                     &domain_path))
+    {
+      g_object_unref (plug_in_def);
+
+      return NULL;
+    }
+
+  if (domain_name)
+    gimp_plug_in_def_set_help_domain (plug_in_def, domain_name, domain_path);
+
+  if (record->has_init)
+    gimp_plug_in_def_set_has_init (plug_in_def, TRUE);
+
+  return plug_in_def;
+}
+
+static GimpPlugInProcedure *
+plug_in_rc_cache_decode_proc (PlugInRcCacheReader     *reader,
+                              const PlugInRcCacheProc *record,
+                              GFile                   *file)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+  const gchar         *name;
+  const gchar         *str;
+  guint8              *icon_data        = NULL;
+  gint                 icon_data_length = -1;
+  guint                i;
+
+  if (! plug_in_rc_cache_get_string (reader, record->name, &name) || ! name)
+    return NULL;
+
+  if (record->proc_type != GIMP_PDB_PROC_TYPE_PLUGIN &&
+      record->proc_type != GIMP_PDB_PROC_TYPE_EXTENSION)
+    return NULL;
+
+  if (! g_enum_get_value (reader->icon_type_class, record->icon_type))
+    return NULL;
+
+  if ((guint64) record->first_menu_path + record->n_menu_paths >
+      reader->header->n_menu_paths)
+    return NULL;
+
+  if ((guint64) record->first_arg + record->n_args + record->n_values >
+      reader->header->n_args)
+    return NULL;
+
+  procedure = gimp_plug_in_procedure_new (record->proc_type, file);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_set_name (GIMP_OBJECT (procedure), name);
+
+  if (! plug_in_rc_cache_dup_string (reader, record->blurb,
+                                     &procedure->blurb)     ||
+      ! plug_in_rc_cache_dup_string (reader, record->help,
+                                     &procedure->help)      ||
+      ! plug_in_rc_cache_dup_string (reader, record->authors,
+                                     &procedure->authors)   ||
+      ! plug_in_rc_cache_dup_string (reader, record->copyright,
+                                     &procedure->copyright) ||
+      ! plug_in_rc_cache_dup_string (reader, record->date,
+                                     &procedure->date)      ||
+      ! plug_in_rc_cache_dup_string (reader, record->menu_label,
+                                     &proc->menu_label))
+    goto error;
+
+  for (i = 0; i < record->n_menu_paths; i++)
+    {
+      guint32 offset = reader->menu_paths[record->first_menu_path + i];
+
+      if (! plug_in_rc_cache_get_string (reader, offset, &str))
+        goto error;
+
+      proc->menu_paths = g_list_append (proc->menu_paths, g_strdup (str));
+    }
+
+  switch ((GimpIconType) record->icon_type)
+    {
+    case GIMP_ICON_TYPE_ICON_NAME:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      if (! plug_in_rc_cache_get_string (reader, record->icon_data, &str))
+        goto error;
+
+      icon_data = (guint8 *) g_strdup (str);
+      break;
+
+    case GIMP_ICON_TYPE_PIXBUF:
+      if (record->icon_data_length < 0 ||
+          (guint64) record->icon_data + record->icon_data_length >
+          reader->header->data_size)
+        goto error;
+
+      icon_data_length = record->icon_data_length;
+      icon_data        = g_memdup (reader->data + record->icon_data,
+                                   icon_data_length);
+      break;
+    }
+
+  gimp_plug_in_procedure_take_icon (proc, record->icon_type,
+                                    icon_data, icon_data_length,
+                                    NULL);
+
+  if (record->flags & PROC_FILE_PROC)
+    {
+      proc->file_proc = TRUE;
+
+      if (! plug_in_rc_cache_dup_string (reader, record->extensions,
+                                         &proc->extensions) ||
+          ! plug_in_rc_cache_dup_string (reader, record->prefixes,
+                                         &proc->prefixes)   ||
+          ! plug_in_rc_cache_dup_string (reader, record->magics,
+                                         &proc->magics))
+        goto error;
+
+      if (record->priority)
+        gimp_plug_in_procedure_set_priority (proc, record->priority);
+
+      if (! plug_in_rc_cache_get_string (reader, record->mime_types, &str))
+        goto error;
+
+      if (str)
+        gimp_plug_in_procedure_set_mime_types (proc, str);
+
+      if (record->flags & PROC_HANDLES_REMOTE)
+        gimp_plug_in_procedure_set_handles_remote (proc);
+
+      if (record->flags & PROC_HANDLES_RAW)
+        gimp_plug_in_procedure_set_handles_raw (proc);
+
+      if (! plug_in_rc_cache_get_string (reader, record->thumb_loader, &str))
+        goto error;
+
+      if (str)
+        gimp_plug_in_procedure_set_thumb_loader (proc, str);
+    }
+
+  if (! plug_in_rc_cache_get_string (reader, record->image_types, &str))
+    goto error;
+
+  gimp_plug_in_procedure_set_image_types (proc, str);
+
+  for (i = 0; i < record->n_args + record->n_values; i++)
+    {
+      if (! plug_in_rc_cache_decode_arg (reader,
+                                         &reader->args[record->first_arg + i],
+                                         procedure,
+                                         i >= record->n_args))
+        goto error;
+    }
+
+  return proc;
+
+ error:
+
+  g_object_unref (procedure);
+
+  return NULL;
+}
+
+static gboolean
+plug_in_rc_cache_decode_arg (PlugInRcCacheReader    *reader,
+                             const PlugInRcCacheArg *record,
+                             GimpProcedure          *procedure,
+                             gboolean                return_value)
+{
+  GPParamDef   param_def = { 0, };
+  GParamSpec  *pspec;
+  const gchar *type_name;
+  const gchar *value_type_name;
+  const gchar *name;
+  const gchar *nick;
+  const gchar *blurb;
+  const gchar *meta_string;
+
+  if (! plug_in_rc_cache_get_string (reader, record->type_name,
+                                     &type_name)       ||
+      ! plug_in_rc_cache_get_string (reader, record->value_type_name,
+                                     &value_type_name) ||
+      ! plug_in_rc_cache_get_string (reader, record->name,
+                                     &name)            ||
+      ! plug_in_rc_cache_get_string (reader, record->nick,
+                                     &nick)            ||
+      ! plug_in_rc_cache_get_string (reader, record->blurb,
+                                     &blurb)           ||
+      ! plug_in_rc_cache_get_string (reader, record->meta_string,
+                                     &meta_string))
+    return FALSE;
+
+  /*  the strings are only read while creating the param spec, so they
+   *  can point right into the mapped file
+   */
+  param_def.param_def_type  = record->param_def_type;
+  param_def.type_name       = (gchar *) type_name;
+  param_def.value_type_name = (gchar *) value_type_name;
+  param_def.name            = (gchar *) name;
+  param_def.nick            = (gchar *) nick;
+  param_def.blurb           = (gchar *) blurb;
+  param_def.flags           = record->flags;
+
+  switch (param_def.param_def_type)
+    {
+    case GP_PARAM_DEF_TYPE_DEFAULT:
+      break;
+
+    case GP_PARAM_DEF_TYPE_INT:
+      param_def.meta.m_int.min_val     = record->meta_int[0];
+      param_def.meta.m_int.max_val     = record->meta_int[1];
+      param_def.meta.m_int.default_val = record->meta_int[2];
+      break;
+
+    case GP_PARAM_DEF_TYPE_UNIT:
+      param_def.meta.m_unit.allow_pixels  = record->meta_int[0];
+      param_def.meta.m_unit.allow_percent = record->meta_int[1];
+      param_def.meta.m_unit.default_val   = record->meta_int[2];
+      break;
+
+    case GP_PARAM_DEF_TYPE_ENUM:
+      param_def.meta.m_enum.default_val = record->meta_int[0];
+      break;
+
+    case GP_PARAM_DEF_TYPE_BOOLEAN:
+      param_def.meta.m_boolean.default_val = record->meta_int[0];
+      break;
+
+    case GP_PARAM_DEF_TYPE_FLOAT:
+      param_def.meta.m_float.min_val     = record->meta_float[0];
+      param_def.meta.m_float.max_val     = record->meta_float[1];
+      param_def.meta.m_float.default_val = record->meta_float[2];
+      break;
+
+    case GP_PARAM_DEF_TYPE_STRING:
+      param_def.meta.m_string.default_val = (gchar *) meta_string;
+      break;
+
+    case GP_PARAM_DEF_TYPE_COLOR:
+      param_def.meta.m_color.has_alpha     = record->meta_int[0];
+      param_def.meta.m_color.default_val.r = record->meta_float[0];
+      param_def.meta.m_color.default_val.g = record->meta_float[1];
+      param_def.meta.m_color.default_val.b = record->meta_float[2];
+      param_def.meta.m_color.default_val.a = record->meta_float[3];
+      break;
+
+    case GP_PARAM_DEF_TYPE_ID:
+      param_def.meta.m_id.none_ok = record->meta_int[0];
+      break;
+
+    case GP_PARAM_DEF_TYPE_ID_ARRAY:
+      param_def.meta.m_id_array.type_name = (gchar *) meta_string;
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  pspec = _gimp_gp_param_def_to_param_spec (&param_def);
+
+  if (! pspec)
+    return FALSE;
+
+  if (return_value)
+    gimp_procedure_add_return_value (procedure, pspec);
+  else
+    gimp_procedure_add_argument (procedure, pspec);
+
+  return TRUE;
+}
+
+static guint32
+plug_in_rc_cache_add_string (PlugInRcCacheWriter *writer,
+                             const gchar         *string)
+{
+  gpointer offset;
+
+  if (! string || ! *string)
+    return 0;
+
+  if (! g_hash_table_lookup_extended (writer->strings, string, NULL, &offset))
+    {
+      offset = GUINT_TO_POINTER (writer->data->len);
+
+      g_byte_array_append (writer->data,
+                           (const guint8 *) string, strlen (string) + 1);
+
+      g_hash_table_insert (writer->strings, g_strdup (string), offset);
+    }
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static guint32
+plug_in_rc_cache_add_data (PlugInRcCacheWriter *writer,
+                           const guint8        *data,
+                           gint                 length)
+{
+  guint32 offset = writer->data->len;
+
+  if (length > 0)
+    g_byte_array_append (writer->data, data, length);
+
+  return offset;
+}
+
+static void
+plug_in_rc_cache_encode_proc (PlugInRcCacheWriter *writer,
+                              GimpPlugInProcedure *proc)
+{
+  GimpProcedure     *procedure = GIMP_PROCEDURE (proc);
+  PlugInRcCacheProc  record    = { 0, };
+  GList             *list;
+  gint               i;
+
+  record.name       = plug_in_rc_cache_add_string (writer,
+                                                   gimp_object_get_name (proc));
+  record.proc_type  = procedure->proc_type;
+  record.blurb      = plug_in_rc_cache_add_string (writer, procedure->blurb);
+  record.help       = plug_in_rc_cache_add_string (writer, procedure->help);
+  record.authors    = plug_in_rc_cache_add_string (writer, procedure->authors);
+  record.copyright  = plug_in_rc_cache_add_string (writer,
+                                                   procedure->copyright);
+  record.date       = plug_in_rc_cache_add_string (writer, procedure->date);
+  record.menu_label = plug_in_rc_cache_add_string (writer, proc->menu_label);
+
+  record.first_menu_path = writer->menu_paths->len;
+
+  for (list = proc->menu_paths; list; list = g_list_next (list))
+    {
+      guint32 offset = plug_in_rc_cache_add_string (writer, list->data);
+
+      g_array_append_val (writer->menu_paths, offset);
+    }
+
+  record.n_menu_paths = writer->menu_paths->len - record.first_menu_path;
+
+  record.icon_type = proc->icon_type;
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_ICON_NAME:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      record.icon_data_length = -1;
+      record.icon_data        =
+        plug_in_rc_cache_add_string (writer, (gchar *) proc->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_PIXBUF:
+      record.icon_data_length = MAX (proc->icon_data_length, 0);
+      record.icon_data        =
+        plug_in_rc_cache_add_data (writer,
+                                   proc->icon_data, record.icon_data_length);
+      break;
+    }
+
+  if (proc->file_proc)
+    {
+      record.flags |= PROC_FILE_PROC;
+
+      record.extensions = plug_in_rc_cache_add_string (writer,
+                                                       proc->extensions);
+      record.prefixes   = plug_in_rc_cache_add_string (writer,
+                                                       proc->prefixes);
+      record.magics     = plug_in_rc_cache_add_string (writer,
+                                                       proc->magics);
+      record.priority   = proc->priority;
+      record.mime_types = plug_in_rc_cache_add_string (writer,
+                                                       proc->mime_types);
+
+      if (proc->handles_remote)
+        record.flags |= PROC_HANDLES_REMOTE;
+
+      if (proc->handles_raw && ! proc->image_types)
+        record.flags |= PROC_HANDLES_RAW;
+
+      record.thumb_loader = plug_in_rc_cache_add_string (writer,
+                                                         proc->thumb_loader);
+    }
+
+  record.image_types = plug_in_rc_cache_add_string (writer, proc->image_types);
+
+  record.first_arg = writer->args->len;
+  record.n_args    = procedure->num_args;
+  record.n_values  = procedure->num_values;
+
+  for (i = 0; i < procedure->num_args; i++)
+    plug_in_rc_cache_encode_arg (writer, procedure->args[i]);
+
+  for (i = 0; i < procedure->num_values; i++)
+    plug_in_rc_cache_encode_arg (writer, procedure->values[i]);
+
+  g_array_append_val (writer->procs, record);
+}
+
+static void
+plug_in_rc_cache_encode_arg (PlugInRcCacheWriter *writer,
+                             GParamSpec          *pspec)
+{
+  GPParamDef       param_def = { 0, };
+  PlugInRcCacheArg record    = { 0, };
+
+  _gimp_param_spec_to_gp_param_def (pspec, &param_def);
+
+  record.param_def_type  = param_def.param_def_type;
+  record.type_name       = plug_in_rc_cache_add_string (writer,
+                                                        param_def.type_name);
+  record.value_type_name = plug_in_rc_cache_add_string (writer,
+                                                        param_def.value_type_name);
+  record.name            = plug_in_rc_cache_add_string (writer,
+                                                        g_param_spec_get_name (pspec));
+  record.nick            = plug_in_rc_cache_add_string (writer,
+                                                        g_param_spec_get_nick (pspec));
+  record.blurb           = plug_in_rc_cache_add_string (writer,
+                                                        g_param_spec_get_blurb (pspec));
+  record.flags           = pspec->flags;
+
+  switch (param_def.param_def_type)
+    {
+    case GP_PARAM_DEF_TYPE_DEFAULT:
+      break;
+
+    case GP_PARAM_DEF_TYPE_INT:
+      record.meta_int[0] = param_def.meta.m_int.min_val;
+      record.meta_int[1] = param_def.meta.m_int.max_val;
+      record.meta_int[2] = param_def.meta.m_int.default_val;
+      break;
+
+    case GP_PARAM_DEF_TYPE_UNIT:
+      record.meta_int[0] = param_def.meta.m_unit.allow_pixels;
+      record.meta_int[1] = param_def.meta.m_unit.allow_percent;
+      record.meta_int[2] = param_def.meta.m_unit.default_val;
+      break;
+
+    case GP_PARAM_DEF_TYPE_ENUM:
+      record.meta_int[0] = param_def.meta.m_enum.default_val;
+      break;
+
+    case GP_PARAM_DEF_TYPE_BOOLEAN:
+      record.meta_int[0] = param_def.meta.m_boolean.default_val;
+      break;
+
+    case GP_PARAM_DEF_TYPE_FLOAT:
+      record.meta_float[0] = param_def.meta.m_float.min_val;
+      record.meta_float[1] = param_def.meta.m_float.max_val;
+      record.meta_float[2] = param_def.meta.m_float.default_val;
+      break;
+
+    case GP_PARAM_DEF_TYPE_STRING:
+      record.meta_string =
+        plug_in_rc_cache_add_string (writer,
+                                     param_def.meta.m_string.default_val);
+      break;
+
+    case GP_PARAM_DEF_TYPE_COLOR:
+      record.meta_int[0]   = param_def.meta.m_color.has_alpha;
+      record.meta_float[0] = param_def.meta.m_color.default_val.r;
+      record.meta_float[1] = param_def.meta.m_color.default_val.g;
+      record.meta_float[2] = param_def.meta.m_color.default_val.b;
+      record.meta_float[3] = param_def.meta.m_color.default_val.a;
+      break;
+
+    case GP_PARAM_DEF_TYPE_ID:
+      record.meta_int[0] = param_def.meta.m_id.none_ok;
+      break;
+
+    case GP_PARAM_DEF_TYPE_ID_ARRAY:
+      record.meta_string =
+        plug_in_rc_cache_add_string (writer,
+                                     param_def.meta.m_id_array.type_name);
+      break;
+    }
+
+  g_array_append_val (writer->args, record);
+}
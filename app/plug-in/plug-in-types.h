@@ -32,6 +32,7 @@ typedef struct _GimpPlugIn           GimpPlugIn;
 typedef struct _GimpPlugInDebug      GimpPlugInDebug;
 typedef struct _GimpPlugInDef        GimpPlugInDef;
 typedef struct _GimpPlugInManager    GimpPlugInManager;
+typedef struct _GimpPlugInMap        GimpPlugInMap;
 typedef struct _GimpPlugInMenuBranch GimpPlugInMenuBranch;
 typedef struct _GimpPlugInProcFrame  GimpPlugInProcFrame;
 typedef struct _GimpPlugInShm        GimpPlugInShm;
@@ -0,0 +1,383 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpboundary.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_WIDTH  300
+#define GIMP_TEST_HEIGHT 500
+
+#define GIMP_BENCHMARK_ITERATIONS 3
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-boundary/" #function, gimp, function);
+
+
+/* fills 'rect' of the mask with blobs of a random size, with noise
+ * sprinkled on top, so that it has lots of boundary segments
+ */
+static void
+gimp_test_mask_fill (GeglBuffer          *buffer,
+                     const GeglRectangle *rect,
+                     guint32              seed)
+{
+  GRand  *rand = g_rand_new_with_seed (seed);
+  gfloat *pixels;
+  gint    blob = g_rand_int_range (rand, 4, 32);
+  gint    x, y;
+
+  pixels = g_new (gfloat, rect->width * rect->height);
+
+  for (y = 0; y < rect->height; y++)
+    {
+      for (x = 0; x < rect->width; x++)
+        {
+          gboolean on = (((rect->x + x) / blob) + ((rect->y + y) / blob)) & 1;
+
+          if (g_rand_int_range (rand, 0, 100) < 10)
+            on = ! on;
+
+          pixels[y * rect->width + x] = on ? 1.0 : 0.0;
+        }
+    }
+
+  gegl_buffer_set (buffer, rect, 0, babl_format ("Y float"), pixels,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  g_free (pixels);
+  g_rand_free (rand);
+}
+
+static GeglBuffer *
+gimp_test_mask_new (gint width,
+                    gint height)
+{
+  GeglBuffer *buffer;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                            babl_format ("Y float"));
+
+  gimp_test_mask_fill (buffer, GEGL_RECTANGLE (0, 0, width, height),
+                       width * height);
+
+  return buffer;
+}
+
+static void
+gimp_test_assert_segs_equal (const GimpBoundSeg *segs1,
+                             gint                num_segs1,
+                             const GimpBoundSeg *segs2,
+                             gint                num_segs2)
+{
+  gint i;
+
+  g_assert_cmpint (num_segs1, ==, num_segs2);
+
+  for (i = 0; i < num_segs1; i++)
+    {
+      g_assert_cmpint (segs1[i].x1,   ==, segs2[i].x1);
+      g_assert_cmpint (segs1[i].y1,   ==, segs2[i].y1);
+      g_assert_cmpint (segs1[i].x2,   ==, segs2[i].x2);
+      g_assert_cmpint (segs1[i].y2,   ==, segs2[i].y2);
+      g_assert_cmpint (segs1[i].open, ==, segs2[i].open);
+    }
+}
+
+/* finds the boundary the same way a selection does, once inside its
+ * bounds, and once outside of them
+ */
+static GimpBoundSeg *
+gimp_test_boundary_find (GimpBoundaryCache *cache,
+                         GeglBuffer        *buffer,
+                         GimpBoundaryType   type,
+                         gint              *num_segs)
+{
+  GeglRectangle region = { 10, 20,
+                           GIMP_TEST_WIDTH  - 30,
+                           GIMP_TEST_HEIGHT - 50 };
+  gint          x1     = 40;
+  gint          y1     = 30;
+  gint          x2     = GIMP_TEST_WIDTH  - 40;
+  gint          y2     = GIMP_TEST_HEIGHT - 30;
+
+  if (cache)
+    {
+      return gimp_boundary_find_cached (cache, buffer,
+                                        type == GIMP_BOUNDARY_IGNORE_BOUNDS ?
+                                          &region : NULL,
+                                        babl_format ("Y float"), type,
+                                        x1, y1, x2, y2,
+                                        GIMP_BOUNDARY_HALF_WAY,
+                                        num_segs);
+    }
+  else
+    {
+      return gimp_boundary_find (buffer,
+                                 type == GIMP_BOUNDARY_IGNORE_BOUNDS ?
+                                   &region : NULL,
+                                 babl_format ("Y float"), type,
+                                 x1, y1, x2, y2,
+                                 GIMP_BOUNDARY_HALF_WAY,
+                                 num_segs);
+    }
+}
+
+/**
+ * parallel_find:
+ * @data:
+ *
+ * Makes sure the boundary comes out the same, segment for segment,
+ * however many threads its bands are split between.
+ **/
+static void
+parallel_find (gconstpointer data)
+{
+  GeglBuffer       *buffer;
+  GimpBoundaryType  type;
+  gint              threads;
+
+  g_object_get (gegl_config (), "threads", &threads, NULL);
+
+  buffer = gimp_test_mask_new (GIMP_TEST_WIDTH, GIMP_TEST_HEIGHT);
+
+  for (type = GIMP_BOUNDARY_WITHIN_BOUNDS;
+       type <= GIMP_BOUNDARY_IGNORE_BOUNDS;
+       type++)
+    {
+      GimpBoundSeg *serial;
+      GimpBoundSeg *parallel;
+      gint          num_serial;
+      gint          num_parallel;
+
+      g_object_set (gegl_config (), "threads", 1, NULL);
+      serial = gimp_test_boundary_find (NULL, buffer, type, &num_serial);
+
+      g_object_set (gegl_config (), "threads", 4, NULL);
+      parallel = gimp_test_boundary_find (NULL, buffer, type, &num_parallel);
+
+      g_assert_cmpint (num_serial, >, 0);
+
+      gimp_test_assert_segs_equal (serial,   num_serial,
+                                   parallel, num_parallel);
+
+      g_free (serial);
+      g_free (parallel);
+    }
+
+  g_object_set (gegl_config (), "threads", threads, NULL);
+
+  g_object_unref (buffer);
+}
+
+/**
+ * cached_find:
+ * @data:
+ *
+ * Makes sure that after changing parts of the mask, and invalidating
+ * them, the cached boundary is the same as one found from scratch,
+ * including for changes crossing the edges of the cache's bands, and
+ * of the bounds.
+ **/
+static void
+cached_find (gconstpointer data)
+{
+  static const GeglRectangle changes[] =
+  {
+    {   0,                     0, GIMP_TEST_WIDTH,       1 },
+    {  50,                    63,              20,       2 },
+    { 100,                   128,               1,       1 },
+    {   5,                   100, GIMP_TEST_WIDTH - 5, 200 },
+    { 200, GIMP_TEST_HEIGHT - 40,             100,      40 }
+  };
+
+  GeglBuffer       *buffer;
+  GimpBoundaryType  type;
+
+  buffer = gimp_test_mask_new (GIMP_TEST_WIDTH, GIMP_TEST_HEIGHT);
+
+  for (type = GIMP_BOUNDARY_WITHIN_BOUNDS;
+       type <= GIMP_BOUNDARY_IGNORE_BOUNDS;
+       type++)
+    {
+      GimpBoundaryCache *cache = gimp_boundary_cache_new ();
+      GimpBoundSeg      *segs;
+      gint               num_segs;
+      gint               i;
+
+      segs = gimp_test_boundary_find (cache, buffer, type, &num_segs);
+      g_free (segs);
+
+      for (i = 0; i < G_N_ELEMENTS (changes); i++)
+        {
+          GimpBoundSeg *cached;
+          GimpBoundSeg *fresh;
+          gint          num_cached;
+          gint          num_fresh;
+
+          gimp_test_mask_fill (buffer, &changes[i], i + 1);
+
+          gimp_boundary_cache_invalidate (cache, &changes[i]);
+
+          cached = gimp_test_boundary_find (cache, buffer, type, &num_cached);
+          fresh  = gimp_test_boundary_find (NULL,  buffer, type, &num_fresh);
+
+          gimp_test_assert_segs_equal (cached, num_cached,
+                                       fresh,  num_fresh);
+
+          g_free (cached);
+          g_free (fresh);
+        }
+
+      gimp_boundary_cache_free (cache);
+    }
+
+  g_object_unref (buffer);
+}
+
+/**
+ * benchmark_boundary:
+ * @data:
+ *
+ * Measures the time it takes to find the boundary of noisy masks of
+ * various sizes from scratch, and again after changing a small part of
+ * them.  Only run in perf mode.
+ **/
+static void
+benchmark_boundary (gconstpointer data)
+{
+  static const gint sizes[] = { 512, 1024, 2048, 4096 };
+  gint              i;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      GimpBoundaryCache *cache;
+      GeglBuffer        *buffer;
+      GeglRectangle      change;
+      gdouble            full        = 0.0;
+      gdouble            incremental = 0.0;
+      gint               num_segs    = 0;
+      gint               j;
+
+      buffer = gimp_test_mask_new (sizes[i], sizes[i]);
+      cache  = gimp_boundary_cache_new ();
+
+      change.x      = sizes[i] / 2;
+      change.y      = sizes[i] / 2;
+      change.width  = 32;
+      change.height = 32;
+
+      for (j = 0; j < GIMP_BENCHMARK_ITERATIONS; j++)
+        {
+          GimpBoundSeg *segs;
+
+          gimp_boundary_cache_invalidate (cache, NULL);
+
+          g_test_timer_start ();
+
+          segs = gimp_boundary_find_cached (cache, buffer, NULL,
+                                            babl_format ("Y float"),
+                                            GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                            0, 0, sizes[i], sizes[i],
+                                            GIMP_BOUNDARY_HALF_WAY,
+                                            &num_segs);
+
+          full += g_test_timer_elapsed ();
+
+          g_free (segs);
+
+          gimp_test_mask_fill (buffer, &change, j);
+          gimp_boundary_cache_invalidate (cache, &change);
+
+          g_test_timer_start ();
+
+          segs = gimp_boundary_find_cached (cache, buffer, NULL,
+                                            babl_format ("Y float"),
+                                            GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                            0, 0, sizes[i], sizes[i],
+                                            GIMP_BOUNDARY_HALF_WAY,
+                                            &num_segs);
+
+          incremental += g_test_timer_elapsed ();
+
+          g_free (segs);
+        }
+
+      full        /= GIMP_BENCHMARK_ITERATIONS;
+      incremental /= GIMP_BENCHMARK_ITERATIONS;
+
+      g_test_minimized_result (full,
+                               "%d px, %d segments, full: %.2f ms",
+                               sizes[i], num_segs, full * 1000.0);
+      g_test_minimized_result (incremental,
+                               "%d px, %d segments, incremental: %.2f ms",
+                               sizes[i], num_segs, incremental * 1000.0);
+
+      gimp_boundary_cache_free (cache);
+      g_object_unref (buffer);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (parallel_find);
+  ADD_TEST (cached_find);
+
+  if (g_test_perf ())
+    ADD_TEST (benchmark_boundary);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,342 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-colormap.h"
+#include "core/gimpimage-convert-indexed.h"
+#include "core/gimplayer.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_SIZE      300
+#define GIMP_TEST_N_COLORS  16
+
+#define GIMP_BENCHMARK_SIZE 2048
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-convert-indexed/" #function, gimp, function);
+
+
+/* creates an RGB image of the given size.  with 'n_colors' > 0, the
+ * image is made of blocks of that many colors, otherwise it's a noisy
+ * gradient with many more colors than an indexed image can hold.
+ */
+static GimpImage *
+gimp_test_image_new (Gimp *gimp,
+                     gint  width,
+                     gint  height,
+                     gint  n_colors)
+{
+  GimpImage *image;
+  GimpLayer *layer;
+  GRand     *rand = g_rand_new_with_seed (width * height + n_colors);
+  guchar    *pixels;
+  gint       x, y;
+
+  image = gimp_image_new (gimp, width, height,
+                          GIMP_RGB, GIMP_PRECISION_U8_NON_LINEAR);
+
+  layer = gimp_layer_new (image, width, height,
+                          babl_format ("R'G'B' u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+  pixels = g_new (guchar, width * height * 3);
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          guchar *p = pixels + (y * width + x) * 3;
+
+          if (n_colors > 0)
+            {
+              gint color = ((x / 17) + (y / 13) * 7) % n_colors;
+
+              p[0] = color * 255 / n_colors;
+              p[1] = 255 - color * 97 % 256;
+              p[2] = color * 53 % 256;
+            }
+          else
+            {
+              p[0] = CLAMP (x * 255 / width  + g_rand_int_range (rand, -8, 8),
+                            0, 255);
+              p[1] = CLAMP (y * 255 / height + g_rand_int_range (rand, -8, 8),
+                            0, 255);
+              p[2] = g_rand_int_range (rand, 0, 256);
+            }
+        }
+    }
+
+  gegl_buffer_set (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                   GEGL_RECTANGLE (0, 0, width, height), 0,
+                   babl_format ("R'G'B' u8"), pixels,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  g_free (pixels);
+  g_rand_free (rand);
+
+  return image;
+}
+
+/* returns the pixels of the image's only layer, as RGB */
+static guchar *
+gimp_test_image_get_pixels (GimpImage *image)
+{
+  GimpLayer *layer  = gimp_image_get_layer_iter (image)->data;
+  gint       width  = gimp_image_get_width  (image);
+  gint       height = gimp_image_get_height (image);
+  guchar    *pixels;
+
+  pixels = g_new (guchar, width * height * 3);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                   GEGL_RECTANGLE (0, 0, width, height), 1.0,
+                   babl_format ("R'G'B' u8"), pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  return pixels;
+}
+
+static void
+gimp_test_image_convert (GimpImage             *image,
+                         gint                   max_colors,
+                         GimpConvertDitherType  dither_type)
+{
+  gboolean result;
+
+  result = gimp_image_convert_indexed (image,
+                                       GIMP_CONVERT_PALETTE_GENERATE,
+                                       max_colors,
+                                       FALSE,
+                                       dither_type,
+                                       FALSE,
+                                       FALSE,
+                                       NULL,
+                                       NULL,
+                                       NULL);
+
+  g_assert_true (result);
+  g_assert_cmpint (gimp_image_get_base_type (image), ==, GIMP_INDEXED);
+}
+
+/* converts a copy of the image with 1 thread, and another one with 4, and
+ * makes sure they come out the same
+ */
+static void
+gimp_test_compare_threads (Gimp                  *gimp,
+                           gint                   n_colors,
+                           gint                   max_colors,
+                           GimpConvertDitherType  dither_type)
+{
+  GimpImage *serial;
+  GimpImage *parallel;
+  guchar    *serial_pixels;
+  guchar    *parallel_pixels;
+  gint       threads;
+
+  g_object_get (gegl_config (), "threads", &threads, NULL);
+
+  serial   = gimp_test_image_new (gimp, GIMP_TEST_SIZE, GIMP_TEST_SIZE,
+                                  n_colors);
+  parallel = gimp_test_image_new (gimp, GIMP_TEST_SIZE, GIMP_TEST_SIZE,
+                                  n_colors);
+
+  g_object_set (gegl_config (), "threads", 1, NULL);
+  gimp_test_image_convert (serial, max_colors, dither_type);
+
+  g_object_set (gegl_config (), "threads", 4, NULL);
+  gimp_test_image_convert (parallel, max_colors, dither_type);
+
+  g_object_set (gegl_config (), "threads", threads, NULL);
+
+  g_assert_cmpint (gimp_image_get_colormap_size (serial), ==,
+                   gimp_image_get_colormap_size (parallel));
+  g_assert_cmpmem (gimp_image_get_colormap (serial),
+                   gimp_image_get_colormap_size (serial) * 3,
+                   gimp_image_get_colormap (parallel),
+                   gimp_image_get_colormap_size (parallel) * 3);
+
+  serial_pixels   = gimp_test_image_get_pixels (serial);
+  parallel_pixels = gimp_test_image_get_pixels (parallel);
+
+  g_assert_cmpmem (serial_pixels,   GIMP_TEST_SIZE * GIMP_TEST_SIZE * 3,
+                   parallel_pixels, GIMP_TEST_SIZE * GIMP_TEST_SIZE * 3);
+
+  g_free (serial_pixels);
+  g_free (parallel_pixels);
+
+  g_object_unref (serial);
+  g_object_unref (parallel);
+}
+
+/**
+ * exact_colors:
+ * @data:
+ *
+ * Makes sure an image with fewer colors than the limit keeps all of
+ * them, exactly.
+ **/
+static void
+exact_colors (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  guchar    *before;
+  guchar    *after;
+
+  image = gimp_test_image_new (gimp, GIMP_TEST_SIZE, GIMP_TEST_SIZE,
+                               GIMP_TEST_N_COLORS);
+
+  before = gimp_test_image_get_pixels (image);
+
+  gimp_test_image_convert (image, 256, GIMP_CONVERT_DITHER_NONE);
+
+  after = gimp_test_image_get_pixels (image);
+
+  g_assert_cmpint (gimp_image_get_colormap_size (image), ==,
+                   GIMP_TEST_N_COLORS);
+  g_assert_cmpmem (before, GIMP_TEST_SIZE * GIMP_TEST_SIZE * 3,
+                   after,  GIMP_TEST_SIZE * GIMP_TEST_SIZE * 3);
+
+  g_free (before);
+  g_free (after);
+
+  g_object_unref (image);
+}
+
+/**
+ * parallel_conversion:
+ * @data:
+ *
+ * Makes sure the histogram and the non-error-diffusion dithers give the
+ * same result however many threads they are split between.
+ **/
+static void
+parallel_conversion (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_test_compare_threads (gimp, GIMP_TEST_N_COLORS, 256,
+                             GIMP_CONVERT_DITHER_NONE);
+  gimp_test_compare_threads (gimp, 0, 64,
+                             GIMP_CONVERT_DITHER_NONE);
+  gimp_test_compare_threads (gimp, 0, 64,
+                             GIMP_CONVERT_DITHER_FIXED);
+}
+
+/**
+ * benchmark_convert_indexed:
+ * @data:
+ *
+ * Measures the time it takes to convert a noisy image to a generated
+ * 256-color palette, with each kind of dithering.  Only run in perf mode.
+ **/
+static void
+benchmark_convert_indexed (gconstpointer data)
+{
+  static const struct
+  {
+    GimpConvertDitherType  type;
+    const gchar           *name;
+  }
+  dithers[] =
+  {
+    { GIMP_CONVERT_DITHER_NONE,  "none"            },
+    { GIMP_CONVERT_DITHER_FIXED, "positioned"      },
+    { GIMP_CONVERT_DITHER_FS,    "floyd-steinberg" }
+  };
+
+  Gimp *gimp = GIMP (data);
+  gint  i;
+
+  for (i = 0; i < G_N_ELEMENTS (dithers); i++)
+    {
+      GimpImage *image;
+      gdouble    elapsed;
+
+      image = gimp_test_image_new (gimp,
+                                   GIMP_BENCHMARK_SIZE, GIMP_BENCHMARK_SIZE,
+                                   0);
+
+      g_test_timer_start ();
+
+      gimp_test_image_convert (image, 256, dithers[i].type);
+
+      elapsed = g_test_timer_elapsed ();
+
+      g_test_minimized_result (elapsed,
+                               "%d px, dither %s: %.2f ms",
+                               GIMP_BENCHMARK_SIZE, dithers[i].name,
+                               elapsed * 1000.0);
+
+      g_object_unref (image);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (exact_colors);
+  ADD_TEST (parallel_conversion);
+
+  if (g_test_perf ())
+    ADD_TEST (benchmark_convert_indexed);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,585 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 2009 Martin Nordholts
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "widgets/widgets-types.h"
+
+#include "widgets/gimpuimanager.h"
+
+#include "gegl/gimp-gegl-utils.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawableundo.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimptiledelta.h"
+#include "core/gimpundostack.h"
+
+#include "operations/gimplevelsconfig.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_IMAGE_SIZE 100
+
+#define ADD_IMAGE_TEST(function) \
+  g_test_add ("/gimp-core/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              gimp_test_image_setup, \
+              function, \
+              gimp_test_image_teardown);
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimp-core/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              NULL, \
+              function, \
+              NULL);
+
+
+typedef struct
+{
+  GimpImage *image;
+} GimpTestFixture;
+
+
+static void gimp_test_image_setup    (GimpTestFixture *fixture,
+                                      gconstpointer    data);
+static void gimp_test_image_teardown (GimpTestFixture *fixture,
+                                      gconstpointer    data);
+
+static void gimp_test_buffers_equal  (GeglBuffer      *buffer1,
+                                      GeglBuffer      *buffer2);
+static void gimp_test_fill           (GimpDrawable    *drawable,
+                                      const gchar     *color_name,
+                                      gint             x,
+                                      gint             y);
+
+
+/**
+ * gimp_test_image_setup:
+ * @fixture:
+ * @data:
+ *
+ * Test fixture setup for a single image.
+ **/
+static void
+gimp_test_image_setup (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  Gimp *gimp = GIMP (data);
+
+  fixture->image = gimp_image_new (gimp,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_RGB,
+                                   GIMP_PRECISION_FLOAT_LINEAR);
+}
+
+/**
+ * gimp_test_image_teardown:
+ * @fixture:
+ * @data:
+ *
+ * Test fixture teardown for a single image.
+ **/
+static void
+gimp_test_image_teardown (GimpTestFixture *fixture,
+                          gconstpointer    data)
+{
+  g_object_unref (fixture->image);
+}
+
+/**
+ * gimp_test_buffers_equal:
+ * @buffer1:
+ * @buffer2:
+ *
+ * Asserts that two buffers of the same format hold the same pixels.
+ **/
+static void
+gimp_test_buffers_equal (GeglBuffer *buffer1,
+                         GeglBuffer *buffer2)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer1);
+  const Babl          *format = gegl_buffer_get_format (buffer1);
+  gsize                size;
+  guchar              *data1;
+  guchar              *data2;
+
+  g_assert_true (gegl_rectangle_equal (extent,
+                                       gegl_buffer_get_extent (buffer2)));
+
+  size = (gsize) extent->width * extent->height *
+         babl_format_get_bytes_per_pixel (format);
+
+  data1 = g_malloc (size);
+  data2 = g_malloc (size);
+
+  gegl_buffer_get (buffer1, extent, 1.0, format, data1,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (buffer2, extent, 1.0, format, data2,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert_true (memcmp (data1, data2, size) == 0);
+
+  g_free (data1);
+  g_free (data2);
+}
+
+/**
+ * gimp_test_fill:
+ * @drawable:
+ * @color_name:
+ * @x:
+ * @y:
+ *
+ * Pushes an undo for all of @drawable, and fills a small square at
+ * @x, @y with @color_name.
+ **/
+static void
+gimp_test_fill (GimpDrawable *drawable,
+                const gchar  *color_name,
+                gint          x,
+                gint          y)
+{
+  GeglColor *color;
+
+  gimp_drawable_push_undo (drawable, "Test", NULL,
+                           0, 0,
+                           gimp_item_get_width  (GIMP_ITEM (drawable)),
+                           gimp_item_get_height (GIMP_ITEM (drawable)));
+
+  color = gegl_color_new (color_name);
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (x, y, 4, 4), color);
+  g_object_unref (color);
+}
+
+/**
+ * rotate_non_overlapping:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can add a layer
+ * and call gimp_item_rotate with center at (0, -10)
+ * without triggering a failed assertion .
+ **/
+static void
+rotate_non_overlapping (GimpTestFixture *fixture,
+                        gconstpointer    data)
+{
+  Gimp        *gimp    = GIMP (data);
+  GimpImage   *image   = fixture->image;
+  GimpLayer   *layer;
+  GimpContext *context = gimp_context_new (gimp, "Test", NULL /*template*/);
+  gboolean     result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  gimp_item_rotate (GIMP_ITEM (layer), context, GIMP_ROTATE_90, 0., -10., TRUE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+  g_object_unref (context);
+}
+
+/**
+ * add_layer:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can add a layer.
+ **/
+static void
+add_layer (GimpTestFixture *fixture,
+           gconstpointer    data)
+{
+  GimpImage *image = fixture->image;
+  GimpLayer *layer;
+  gboolean   result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+}
+
+/**
+ * remove_layer:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can remove a layer.
+ **/
+static void
+remove_layer (GimpTestFixture *fixture,
+              gconstpointer    data)
+{
+  GimpImage *image = fixture->image;
+  GimpLayer *layer;
+  gboolean   result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+
+  gimp_image_remove_layer (image,
+                           layer,
+                           FALSE,
+                           NULL);
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+}
+
+/**
+ * compact_drawable_undo:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a compacted drawable undo only keeps the tiles that
+ * changed, and still restores all of the drawable's pixels when
+ * undoing and redoing.
+ **/
+static void
+compact_drawable_undo (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  GimpImage        *image = fixture->image;
+  GimpLayer        *layer;
+  GimpDrawable     *drawable;
+  GimpDrawableUndo *undo;
+  GeglBuffer       *orig_buffer;
+  GeglBuffer       *new_buffer;
+  GeglColor        *color;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image,
+                        layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE);
+
+  drawable    = GIMP_DRAWABLE (layer);
+  orig_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  gimp_drawable_push_undo (drawable, "Test", NULL,
+                           0, 0,
+                           GIMP_TEST_IMAGE_SIZE, GIMP_TEST_IMAGE_SIZE);
+
+  color = gegl_color_new ("red");
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (10, 10, 4, 4), color);
+  g_object_unref (color);
+
+  new_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  undo = GIMP_DRAWABLE_UNDO (
+    gimp_undo_stack_peek (gimp_image_get_undo_stack (image)));
+
+  gimp_image_undo_compact (image);
+  gimp_drawable_undo_wait (undo);
+
+  g_assert_null (undo->buffer);
+  g_assert_nonnull (undo->delta);
+  g_assert_cmpint (gimp_tile_delta_get_n_tiles (undo->delta), ==, 1);
+
+  g_assert_true (gimp_image_undo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_assert_true (gimp_image_redo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), new_buffer);
+
+  g_assert_true (gimp_image_undo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_object_unref (orig_buffer);
+  g_object_unref (new_buffer);
+}
+
+/**
+ * compact_drawable_undo_steps:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure compacted drawable undos restore the right pixels when a
+ * later undo step overwrites the pixels changed by an earlier one.
+ **/
+static void
+compact_drawable_undo_steps (GimpTestFixture *fixture,
+                             gconstpointer    data)
+{
+  GimpImage    *image = fixture->image;
+  GimpLayer    *layer;
+  GimpDrawable *drawable;
+  GeglBuffer   *orig_buffer;
+  GeglBuffer   *red_buffer;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image,
+                        layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE);
+
+  drawable    = GIMP_DRAWABLE (layer);
+  orig_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  gimp_test_fill (drawable, "red", 10, 10);
+  red_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  /*  clear the red square again  */
+  gimp_test_fill (drawable, "transparent", 10, 10);
+
+  gimp_image_undo_compact (image);
+
+  g_assert_true (gimp_image_undo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), red_buffer);
+
+  g_assert_true (gimp_image_undo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_assert_true (gimp_image_redo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), red_buffer);
+
+  g_assert_true (gimp_image_redo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_object_unref (orig_buffer);
+  g_object_unref (red_buffer);
+}
+
+/**
+ * compact_drawable_undo_group:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure the drawable undos of an undo group are compacted against
+ * the pixels they are popped into, not against the drawable's pixels at
+ * the end of the group.
+ **/
+static void
+compact_drawable_undo_group (GimpTestFixture *fixture,
+                             gconstpointer    data)
+{
+  GimpImage    *image = fixture->image;
+  GimpLayer    *layer;
+  GimpDrawable *drawable;
+  GeglBuffer   *orig_buffer;
+  GeglBuffer   *new_buffer;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image,
+                        layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE);
+
+  drawable    = GIMP_DRAWABLE (layer);
+  orig_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  /*  fill, then clear, in one group  */
+  gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_MISC, NULL);
+
+  gimp_test_fill (drawable, "red",         10, 10);
+  gimp_test_fill (drawable, "transparent", 10, 10);
+
+  gimp_image_undo_group_end (image);
+
+  /*  fill, then scale the filled square away, in one group  */
+  gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_MISC, NULL);
+
+  gimp_test_fill (drawable, "red", 60, 60);
+  gimp_item_scale (GIMP_ITEM (layer),
+                   GIMP_TEST_IMAGE_SIZE / 2,
+                   GIMP_TEST_IMAGE_SIZE / 2,
+                   0, 0,
+                   GIMP_INTERPOLATION_NONE,
+                   NULL);
+
+  gimp_image_undo_group_end (image);
+
+  new_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  gimp_image_undo_compact (image);
+
+  g_assert_true (gimp_image_undo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_assert_true (gimp_image_undo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_assert_true (gimp_image_redo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), orig_buffer);
+
+  g_assert_true (gimp_image_redo (image));
+  gimp_test_buffers_equal (gimp_drawable_get_buffer (drawable), new_buffer);
+
+  g_object_unref (orig_buffer);
+  g_object_unref (new_buffer);
+}
+
+/**
+ * white_graypoint_in_red_levels:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure the levels algorithm can handle when the graypoint is
+ * white. It's easy to get a divide by zero problem when trying to
+ * calculate what gamma will give a white graypoint.
+ **/
+static void
+white_graypoint_in_red_levels (GimpTestFixture *fixture,
+                               gconstpointer    data)
+{
+  GimpRGB              black   = { 0, 0, 0, 0 };
+  GimpRGB              gray    = { 1, 1, 1, 1 };
+  GimpRGB              white   = { 1, 1, 1, 1 };
+  GimpHistogramChannel channel = GIMP_HISTOGRAM_RED;
+  GimpLevelsConfig    *config;
+
+  config = g_object_new (GIMP_TYPE_LEVELS_CONFIG, NULL);
+
+  gimp_levels_config_adjust_by_colors (config,
+                                       channel,
+                                       &black,
+                                       &gray,
+                                       &white);
+
+  /* Make sure we didn't end up with an invalid gamma value */
+  g_object_set (config,
+                "gamma", config->gamma[channel],
+                NULL);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_IMAGE_TEST (add_layer);
+  ADD_IMAGE_TEST (remove_layer);
+  ADD_IMAGE_TEST (rotate_non_overlapping);
+  ADD_IMAGE_TEST (compact_drawable_undo);
+  ADD_IMAGE_TEST (compact_drawable_undo_steps);
+  ADD_IMAGE_TEST (compact_drawable_undo_group);
+  ADD_TEST (white_graypoint_in_red_levels);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
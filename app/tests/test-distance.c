@@ -0,0 +1,359 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+
+#include "gegl/gimp-gegl-apply-operation.h"
+#include "gegl/gimp-gegl-distance.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/* odd sizes, so that the mask isn't symmetric */
+#define GIMP_TEST_MASK_WIDTH  67
+#define GIMP_TEST_MASK_HEIGHT 45
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-distance/" #function, gimp, function);
+
+
+/* creates a mask of random pixels, which are selected with a
+ * probability of @density, and either fully or partially selected
+ */
+static gfloat *
+gimp_test_create_mask (gdouble  density,
+                       gboolean binary)
+{
+  GRand  *rand;
+  gfloat *mask;
+  gint    n = GIMP_TEST_MASK_WIDTH * GIMP_TEST_MASK_HEIGHT;
+  gint    i;
+
+  rand = g_rand_new_with_seed (n);
+  mask = g_new (gfloat, n);
+
+  for (i = 0; i < n; i++)
+    {
+      if (g_rand_double (rand) < density)
+        mask[i] = binary ? 1.0 : g_rand_double_range (rand, 0.1, 1.0);
+      else
+        mask[i] = 0.0;
+    }
+
+  g_rand_free (rand);
+
+  return mask;
+}
+
+static GeglBuffer *
+gimp_test_create_buffer (const gfloat *mask)
+{
+  GeglBuffer *buffer;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                            GIMP_TEST_MASK_WIDTH,
+                                            GIMP_TEST_MASK_HEIGHT),
+                            babl_format ("Y float"));
+
+  gegl_buffer_set (buffer, NULL, 0, babl_format ("Y float"), mask,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  return buffer;
+}
+
+static gfloat *
+gimp_test_get_mask (GeglBuffer *buffer)
+{
+  gfloat *mask = g_new (gfloat, GIMP_TEST_MASK_WIDTH * GIMP_TEST_MASK_HEIGHT);
+
+  gegl_buffer_get (buffer, NULL, 1.0, babl_format ("Y float"), mask,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  return mask;
+}
+
+/* whether an offset of (@dx, @dy) is within the shape that grow and
+ * shrink always used, one of RINT()ed column heights
+ */
+static gboolean
+gimp_test_in_ellipse (gint dx,
+                      gint dy,
+                      gint radius_x,
+                      gint radius_y)
+{
+  gdouble t;
+
+  if (ABS (dx) > radius_x)
+    return FALSE;
+
+  t = dx ? ABS (dx) - 0.5 : 0.0;
+
+  return ABS (dy) <= RINT (radius_y / (gdouble) radius_x *
+                           sqrt (SQR (radius_x) - SQR (t)));
+}
+
+/* grows (or shrinks) @mask the slow way, by looking at the whole
+ * ellipse around each pixel
+ */
+static gfloat *
+gimp_test_grow_mask (const gfloat *mask,
+                     gint          radius_x,
+                     gint          radius_y,
+                     gboolean      shrink,
+                     gboolean      edge_lock)
+{
+  gfloat *result;
+  gint    x, y;
+  gint    dx, dy;
+
+  result = g_new (gfloat, GIMP_TEST_MASK_WIDTH * GIMP_TEST_MASK_HEIGHT);
+
+  for (y = 0; y < GIMP_TEST_MASK_HEIGHT; y++)
+    for (x = 0; x < GIMP_TEST_MASK_WIDTH; x++)
+      {
+        gfloat value = shrink ? 1.0 : 0.0;
+
+        for (dy = -radius_y; dy <= radius_y; dy++)
+          for (dx = -radius_x; dx <= radius_x; dx++)
+            {
+              gint   sx = x + dx;
+              gint   sy = y + dy;
+              gfloat v;
+
+              if (! gimp_test_in_ellipse (dx, dy, radius_x, radius_y))
+                continue;
+
+              if (sx < 0 || sx >= GIMP_TEST_MASK_WIDTH ||
+                  sy < 0 || sy >= GIMP_TEST_MASK_HEIGHT)
+                {
+                  if (! edge_lock)
+                    {
+                      v = 0.0;
+                    }
+                  else
+                    {
+                      sx = CLAMP (sx, 0, GIMP_TEST_MASK_WIDTH  - 1);
+                      sy = CLAMP (sy, 0, GIMP_TEST_MASK_HEIGHT - 1);
+
+                      v = mask[sy * GIMP_TEST_MASK_WIDTH + sx];
+                    }
+                }
+              else
+                {
+                  v = mask[sy * GIMP_TEST_MASK_WIDTH + sx];
+                }
+
+              value = shrink ? MIN (value, v) : MAX (value, v);
+            }
+
+        result[y * GIMP_TEST_MASK_WIDTH + x] = value;
+      }
+
+  return result;
+}
+
+static void
+gimp_test_compare_grow (gint     radius_x,
+                        gint     radius_y,
+                        gboolean shrink,
+                        gboolean edge_lock,
+                        gboolean binary)
+{
+  GeglBuffer *src_buffer;
+  GeglBuffer *dest_buffer;
+  gfloat     *mask;
+  gfloat     *expected;
+  gfloat     *result;
+  gint        i;
+
+  mask     = gimp_test_create_mask (shrink ? 0.95 : 0.05, binary);
+  expected = gimp_test_grow_mask (mask, radius_x, radius_y, shrink, edge_lock);
+
+  src_buffer  = gimp_test_create_buffer (mask);
+  dest_buffer = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
+                                 babl_format ("Y float"));
+
+  if (shrink)
+    gimp_gegl_apply_shrink (src_buffer, NULL, NULL, dest_buffer, NULL,
+                            radius_x, radius_y, edge_lock);
+  else
+    gimp_gegl_apply_grow (src_buffer, NULL, NULL, dest_buffer, NULL,
+                          radius_x, radius_y);
+
+  result = gimp_test_get_mask (dest_buffer);
+
+  for (i = 0; i < GIMP_TEST_MASK_WIDTH * GIMP_TEST_MASK_HEIGHT; i++)
+    g_assert_cmpfloat (result[i], ==, expected[i]);
+
+  g_object_unref (src_buffer);
+  g_object_unref (dest_buffer);
+
+  g_free (mask);
+  g_free (expected);
+  g_free (result);
+}
+
+/**
+ * euclidean:
+ * @data:
+ *
+ * Makes sure the distance transform with squared costs is the exact
+ * squared euclidean distance transform.
+ **/
+static void
+euclidean (gconstpointer data)
+{
+  GeglBuffer *src_buffer;
+  GeglBuffer *dest_buffer;
+  gfloat     *mask;
+  gfloat     *result;
+  gdouble     squares[MAX (GIMP_TEST_MASK_WIDTH, GIMP_TEST_MASK_HEIGHT)];
+  gint        x, y;
+
+  /* a table of d^2 as far as the offsets within the mask go */
+  for (x = 0; x < G_N_ELEMENTS (squares); x++)
+    squares[x] = SQR (x);
+
+  mask = gimp_test_create_mask (0.01, TRUE);
+
+  src_buffer  = gimp_test_create_buffer (mask);
+  dest_buffer = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
+                                 babl_format ("Y float"));
+
+  gimp_gegl_distance_transform (src_buffer, NULL,
+                                0.5, FALSE, FALSE,
+                                squares, G_N_ELEMENTS (squares),
+                                squares, G_N_ELEMENTS (squares),
+                                NULL, NULL,
+                                dest_buffer, NULL);
+
+  result = gimp_test_get_mask (dest_buffer);
+
+  for (y = 0; y < GIMP_TEST_MASK_HEIGHT; y++)
+    for (x = 0; x < GIMP_TEST_MASK_WIDTH; x++)
+      {
+        gfloat best = G_MAXFLOAT;
+        gint   fx, fy;
+
+        for (fy = 0; fy < GIMP_TEST_MASK_HEIGHT; fy++)
+          for (fx = 0; fx < GIMP_TEST_MASK_WIDTH; fx++)
+            {
+              if (mask[fy * GIMP_TEST_MASK_WIDTH + fx] >= 0.5)
+                best = MIN (best, SQR (fx - x) + SQR (fy - y));
+            }
+
+        g_assert_cmpfloat (result[y * GIMP_TEST_MASK_WIDTH + x], ==, best);
+      }
+
+  g_object_unref (src_buffer);
+  g_object_unref (dest_buffer);
+
+  g_free (mask);
+  g_free (result);
+}
+
+/**
+ * grow:
+ * @data:
+ *
+ * Makes sure growing a binary mask through the distance transform
+ * gives the same result as looking at the whole ellipse around each
+ * pixel.
+ **/
+static void
+grow (gconstpointer data)
+{
+  gimp_test_compare_grow (4, 4, FALSE, FALSE, TRUE);
+  gimp_test_compare_grow (7, 2, FALSE, FALSE, TRUE);
+  gimp_test_compare_grow (1, 5, FALSE, FALSE, TRUE);
+}
+
+/**
+ * grow_soft:
+ * @data:
+ *
+ * Makes sure growing a mask that isn't binary still gives the largest
+ * value within the ellipse.
+ **/
+static void
+grow_soft (gconstpointer data)
+{
+  gimp_test_compare_grow (4, 4, FALSE, FALSE, FALSE);
+  gimp_test_compare_grow (7, 2, FALSE, FALSE, FALSE);
+}
+
+/**
+ * shrink:
+ * @data:
+ *
+ * Makes sure shrinking a binary mask through the distance transform
+ * gives the same result as looking at the whole ellipse around each
+ * pixel, with and without edge lock.
+ **/
+static void
+shrink (gconstpointer data)
+{
+  gimp_test_compare_grow (4, 4, TRUE, FALSE, TRUE);
+  gimp_test_compare_grow (4, 4, TRUE, TRUE,  TRUE);
+  gimp_test_compare_grow (7, 2, TRUE, FALSE, TRUE);
+  gimp_test_compare_grow (7, 2, TRUE, TRUE,  TRUE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (euclidean);
+  ADD_TEST (grow);
+  ADD_TEST (grow_soft);
+  ADD_TEST (shrink);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,395 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpcolor/gimpcolor.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+
+#include "gegl/gimp-gegl-loops.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/* odd sizes, so that rows end in an odd pixel */
+#define GIMP_TEST_BUFFER_WIDTH  255
+#define GIMP_TEST_BUFFER_HEIGHT 129
+
+#define GIMP_BENCHMARK_BUFFER_SIZE 1024
+#define GIMP_BENCHMARK_ITERATIONS  5
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-gegl-loops/" #function, gimp, function);
+
+
+/* @aux_buffer is an additional output buffer, used by the functions that
+ * have one
+ */
+typedef void (* GimpTestLoopFunc) (GeglBuffer *src_buffer,
+                                   GeglBuffer *dest_buffer,
+                                   GeglBuffer *aux_buffer,
+                                   gint        variant);
+
+
+static gboolean
+gimp_test_have_simd (void)
+{
+  return (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2) != 0;
+}
+
+/* creates a buffer of random RGBA pixels, slightly out of the [0, 1]
+ * range, with some fully transparent pixels
+ */
+static GeglBuffer *
+gimp_test_create_buffer (gint        width,
+                         gint        height,
+                         const Babl *format)
+{
+  GeglBuffer *buffer;
+  GRand      *rand;
+  gfloat     *data;
+  gint        n = width * height * 4;
+  gint        i;
+
+  rand = g_rand_new_with_seed (width * height);
+  data = g_new (gfloat, n);
+
+  for (i = 0; i < n; i++)
+    data[i] = g_rand_double_range (rand, -0.1, 1.1);
+
+  for (i = 3; i < n; i += 4)
+    {
+      if (g_rand_int_range (rand, 0, 8) == 0)
+        data[i] = 0.0;
+    }
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height), format);
+
+  gegl_buffer_set (buffer, NULL, 0, format, data, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+  g_rand_free (rand);
+
+  return buffer;
+}
+
+static void
+gimp_test_assert_buffers_equal (GeglBuffer *buffer1,
+                                GeglBuffer *buffer2)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer1);
+  const Babl          *format = gegl_buffer_get_format (buffer1);
+  gint                 size;
+  gfloat              *data1;
+  gfloat              *data2;
+
+  size  = extent->width * extent->height * babl_format_get_bytes_per_pixel (format);
+  data1 = g_malloc (size);
+  data2 = g_malloc (size);
+
+  gegl_buffer_get (buffer1, NULL, 1.0, format, data1,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (buffer2, NULL, 1.0, format, data2,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert_true (memcmp (data1, data2, size) == 0);
+
+  g_free (data1);
+  g_free (data2);
+}
+
+/* runs @func with and without CPU acceleration, and makes sure the
+ * results are identical
+ */
+static void
+gimp_test_compare_simd (GimpTestLoopFunc  func,
+                        const Babl       *format,
+                        gint              n_variants)
+{
+  GeglBuffer *src_buffer;
+  gint        variant;
+
+  if (! gimp_test_have_simd ())
+    {
+      g_test_skip ("CPU acceleration is not available");
+      return;
+    }
+
+  src_buffer = gimp_test_create_buffer (GIMP_TEST_BUFFER_WIDTH,
+                                        GIMP_TEST_BUFFER_HEIGHT,
+                                        format);
+
+  for (variant = 0; variant < n_variants; variant++)
+    {
+      GeglBuffer *generic_buffer;
+      GeglBuffer *generic_aux_buffer;
+      GeglBuffer *simd_buffer;
+      GeglBuffer *simd_aux_buffer;
+
+      generic_buffer     = gimp_test_create_buffer (GIMP_TEST_BUFFER_WIDTH,
+                                                    GIMP_TEST_BUFFER_HEIGHT,
+                                                    format);
+      generic_aux_buffer = gimp_test_create_buffer (GIMP_TEST_BUFFER_WIDTH,
+                                                    GIMP_TEST_BUFFER_HEIGHT,
+                                                    format);
+      simd_buffer        = gegl_buffer_dup (generic_buffer);
+      simd_aux_buffer    = gegl_buffer_dup (generic_aux_buffer);
+
+      gimp_cpu_accel_set_use (FALSE);
+      func (src_buffer, generic_buffer, generic_aux_buffer, variant);
+
+      gimp_cpu_accel_set_use (TRUE);
+      func (src_buffer, simd_buffer, simd_aux_buffer, variant);
+
+      gimp_test_assert_buffers_equal (generic_buffer,     simd_buffer);
+      gimp_test_assert_buffers_equal (generic_aux_buffer, simd_aux_buffer);
+
+      g_object_unref (generic_buffer);
+      g_object_unref (generic_aux_buffer);
+      g_object_unref (simd_buffer);
+      g_object_unref (simd_aux_buffer);
+    }
+
+  g_object_unref (src_buffer);
+}
+
+/* measures @func with and without CPU acceleration */
+static void
+gimp_test_benchmark_simd (const gchar      *name,
+                          GimpTestLoopFunc  func,
+                          const Babl       *format,
+                          gint              variant)
+{
+  GeglBuffer *src_buffer;
+  GeglBuffer *dest_buffer;
+  GeglBuffer *aux_buffer;
+  gint        use;
+
+  src_buffer  = gimp_test_create_buffer (GIMP_BENCHMARK_BUFFER_SIZE,
+                                         GIMP_BENCHMARK_BUFFER_SIZE,
+                                         format);
+  dest_buffer = gimp_test_create_buffer (GIMP_BENCHMARK_BUFFER_SIZE,
+                                         GIMP_BENCHMARK_BUFFER_SIZE,
+                                         format);
+  aux_buffer  = gimp_test_create_buffer (GIMP_BENCHMARK_BUFFER_SIZE,
+                                         GIMP_BENCHMARK_BUFFER_SIZE,
+                                         format);
+
+  for (use = FALSE; use <= TRUE; use++)
+    {
+      gdouble elapsed;
+      gint    i;
+
+      if (use && ! gimp_test_have_simd ())
+        break;
+
+      gimp_cpu_accel_set_use (use);
+
+      g_test_timer_start ();
+
+      for (i = 0; i < GIMP_BENCHMARK_ITERATIONS; i++)
+        func (src_buffer, dest_buffer, aux_buffer, variant);
+
+      elapsed = g_test_timer_elapsed () / GIMP_BENCHMARK_ITERATIONS;
+
+      g_test_minimized_result (elapsed, "%s, %s: %.2f ms",
+                               name, use ? "simd" : "generic",
+                               elapsed * 1000.0);
+    }
+
+  gimp_cpu_accel_set_use (TRUE);
+
+  g_object_unref (src_buffer);
+  g_object_unref (dest_buffer);
+  g_object_unref (aux_buffer);
+}
+
+/* variant: bit 0 = alpha weighting, bits 1-2 = convolution mode */
+static void
+gimp_test_convolve (GeglBuffer *src_buffer,
+                    GeglBuffer *dest_buffer,
+                    GeglBuffer *aux_buffer,
+                    gint        variant)
+{
+  static const gfloat kernel[25] =
+  {
+     1,  2,  3,  2,  1,
+     2, -4,  6, -4,  2,
+     3,  6, -9,  6,  3,
+     2, -4,  6, -4,  2,
+     1,  2,  3,  2,  1
+  };
+
+  gimp_gegl_convolve (src_buffer, NULL,
+                      dest_buffer, NULL,
+                      kernel, 5, 20.0,
+                      (GimpConvolutionType) (variant >> 1),
+                      variant & 1);
+}
+
+/* variant: bit 0 = burn, bits 1-2 = transfer mode */
+static void
+gimp_test_dodgeburn (GeglBuffer *src_buffer,
+                     GeglBuffer *dest_buffer,
+                     GeglBuffer *aux_buffer,
+                     gint        variant)
+{
+  gimp_gegl_dodgeburn (src_buffer, NULL,
+                       dest_buffer, NULL,
+                       0.5,
+                       (variant & 1) ? GIMP_DODGE_BURN_TYPE_BURN :
+                                       GIMP_DODGE_BURN_TYPE_DODGE,
+                       (GimpTransferMode) (variant >> 1));
+}
+
+/* variant: bit 0 = no erasing, bit 1 = brush color, bit 2 = zero flow.
+ * dest_buffer is the accumulation buffer, and aux_buffer the paint buffer.
+ */
+static void
+gimp_test_smudge (GeglBuffer *src_buffer,
+                  GeglBuffer *dest_buffer,
+                  GeglBuffer *aux_buffer,
+                  gint        variant)
+{
+  GimpRGB brush_color = { 0.2, 0.5, 0.9, 0.7 };
+
+  gimp_gegl_smudge_with_paint (dest_buffer, NULL,
+                               src_buffer, NULL,
+                               (variant & 2) ? &brush_color : NULL,
+                               aux_buffer,
+                               variant & 1,
+                               (variant & 4) ? 0.0 : 0.6,
+                               0.8);
+}
+
+/**
+ * convolve_simd:
+ * @data:
+ *
+ * Makes sure the accelerated gimp_gegl_convolve() gives the same
+ * results as the generic code, for all modes.
+ **/
+static void
+convolve_simd (gconstpointer data)
+{
+  gimp_test_compare_simd (gimp_test_convolve,
+                          babl_format ("RGBA float"), 6);
+}
+
+/**
+ * dodgeburn_simd:
+ * @data:
+ *
+ * Makes sure the accelerated gimp_gegl_dodgeburn() gives the same
+ * results as the generic code, for all types and modes.
+ **/
+static void
+dodgeburn_simd (gconstpointer data)
+{
+  gimp_test_compare_simd (gimp_test_dodgeburn,
+                          babl_format ("R'G'B'A float"), 6);
+}
+
+/**
+ * smudge_simd:
+ * @data:
+ *
+ * Makes sure the accelerated gimp_gegl_smudge_with_paint() gives the
+ * same results as the generic code.
+ **/
+static void
+smudge_simd (gconstpointer data)
+{
+  gimp_test_compare_simd (gimp_test_smudge,
+                          babl_format ("RGBA float"), 8);
+}
+
+/**
+ * benchmark_brush_loops:
+ * @data:
+ *
+ * Measures the time the blur/sharpen, dodge/burn and smudge loops take
+ * on a large buffer, with and without CPU acceleration.  Only run in
+ * perf mode.
+ **/
+static void
+benchmark_brush_loops (gconstpointer data)
+{
+  gimp_test_benchmark_simd ("convolve",
+                            gimp_test_convolve,
+                            babl_format ("RGBA float"), 0);
+  gimp_test_benchmark_simd ("convolve, alpha weighting",
+                            gimp_test_convolve,
+                            babl_format ("RGBA float"), 1);
+  gimp_test_benchmark_simd ("dodge, highlights",
+                            gimp_test_dodgeburn,
+                            babl_format ("R'G'B'A float"),
+                            GIMP_TRANSFER_HIGHLIGHTS << 1);
+  gimp_test_benchmark_simd ("burn, shadows",
+                            gimp_test_dodgeburn,
+                            babl_format ("R'G'B'A float"),
+                            (GIMP_TRANSFER_SHADOWS << 1) | 1);
+  gimp_test_benchmark_simd ("smudge",
+                            gimp_test_smudge,
+                            babl_format ("RGBA float"), 0);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (convolve_simd);
+  ADD_TEST (dodgeburn_simd);
+  ADD_TEST (smudge_simd);
+
+  if (g_test_perf ())
+    ADD_TEST (benchmark_brush_loops);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,358 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "paint/paint-types.h"
+
+#include "core/gimp.h"
+
+#include "paint/gimpheal-laplace.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_SIZE     200
+
+/* the solvers stop at a total squared residual of (0.1 / 255)^2 */
+#define GIMP_TEST_MAX_RESIDUAL (2.0 * (0.1 / 255.0) * (0.1 / 255.0))
+#define GIMP_TEST_MAX_DIFF     (1.0 / 255.0)
+
+#define GIMP_BENCHMARK_ITERATIONS 3
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-heal/" #function, gimp, function);
+
+
+typedef struct
+{
+  gint    width;
+  gint    height;
+  gint    depth;
+  gfloat *pixels;
+  gfloat *pixels_alloc;
+  guchar *mask;
+} GimpTestHeal;
+
+
+/* creates a heal problem for a round brush of the given diameter,
+ * centered at (cx, cy) of a width x height area, on a smooth image with
+ * some noise
+ */
+static GimpTestHeal *
+gimp_test_heal_new (gint    width,
+                    gint    height,
+                    gint    depth,
+                    gdouble cx,
+                    gdouble cy,
+                    gdouble diameter)
+{
+  GimpTestHeal *heal = g_slice_new (GimpTestHeal);
+  GRand        *rand = g_rand_new_with_seed (width * height * depth);
+  gdouble       r2   = SQR (diameter / 2.0);
+  gint          x, y, k;
+
+  heal->width  = width;
+  heal->height = height;
+  heal->depth  = depth;
+
+  /* gimp_heal_laplace() wants 16-byte aligned pixels, with room for one
+   * extra pixel
+   */
+  heal->pixels_alloc = g_new (gfloat, (width * height + 1) * depth + 4);
+  heal->pixels       = (gfloat *) (((guintptr) heal->pixels_alloc + 15) & ~15);
+  heal->mask         = g_new (guchar, width * height);
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          gfloat *p = heal->pixels + (y * width + x) * depth;
+
+          heal->mask[y * width + x] = SQR (x + 0.5 - cx) +
+                                      SQR (y + 0.5 - cy) < r2;
+
+          for (k = 0; k < depth; k++)
+            {
+              p[k] = 0.3 * sin (0.05 * (k + 1) * x) +
+                     0.2 * cos (0.03 * (k + 2) * y) +
+                     g_rand_double_range (rand, 0.0, 0.1);
+            }
+        }
+    }
+
+  g_rand_free (rand);
+
+  return heal;
+}
+
+static GimpTestHeal *
+gimp_test_heal_copy (const GimpTestHeal *heal)
+{
+  GimpTestHeal *copy;
+
+  copy = gimp_test_heal_new (heal->width, heal->height, heal->depth,
+                             0.0, 0.0, 0.0);
+
+  memcpy (copy->pixels, heal->pixels,
+          heal->width * heal->height * heal->depth * sizeof (gfloat));
+  memcpy (copy->mask, heal->mask,
+          heal->width * heal->height);
+
+  return copy;
+}
+
+static void
+gimp_test_heal_free (GimpTestHeal *heal)
+{
+  g_free (heal->pixels_alloc);
+  g_free (heal->mask);
+
+  g_slice_free (GimpTestHeal, heal);
+}
+
+static void
+gimp_test_heal_solve (GimpTestHeal          *heal,
+                      GimpHealLaplaceSolver  solver)
+{
+  gimp_heal_laplace (heal->pixels, heal->width, heal->height, heal->depth,
+                     heal->mask, solver);
+}
+
+/* returns the total squared residual of the laplace equation inside the
+ * mask, with neumann conditions at the edges
+ */
+static gdouble
+gimp_test_heal_residual (const GimpTestHeal *heal)
+{
+  gint    width  = heal->width;
+  gint    height = heal->height;
+  gint    depth  = heal->depth;
+  gdouble err    = 0.0;
+  gint    x, y, k;
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          const gfloat *p = heal->pixels + (y * width + x) * depth;
+
+          if (! heal->mask[y * width + x])
+            continue;
+
+          for (k = 0; k < depth; k++)
+            {
+              gdouble s = 0.0;
+              gint    n = 0;
+
+              if (x > 0)          { s += p[k - depth];         n++; }
+              if (x < width - 1)  { s += p[k + depth];         n++; }
+              if (y > 0)          { s += p[k - width * depth]; n++; }
+              if (y < height - 1) { s += p[k + width * depth]; n++; }
+
+              err += SQR (s - n * p[k]);
+            }
+        }
+    }
+
+  return err;
+}
+
+static gdouble
+gimp_test_heal_max_diff (const GimpTestHeal *heal1,
+                         const GimpTestHeal *heal2)
+{
+  gdouble diff = 0.0;
+  gint    i;
+
+  for (i = 0; i < heal1->width * heal1->height * heal1->depth; i++)
+    diff = MAX (diff, fabs (heal1->pixels[i] - heal2->pixels[i]));
+
+  return diff;
+}
+
+static void
+gimp_test_heal_compare_solvers (gint    depth,
+                                gdouble cx,
+                                gdouble cy,
+                                gdouble diameter)
+{
+  GimpTestHeal *sor;
+  GimpTestHeal *multigrid;
+
+  sor       = gimp_test_heal_new (GIMP_TEST_SIZE, GIMP_TEST_SIZE, depth,
+                                  cx, cy, diameter);
+  multigrid = gimp_test_heal_copy (sor);
+
+  gimp_test_heal_solve (sor,       GIMP_HEAL_LAPLACE_SOR);
+  gimp_test_heal_solve (multigrid, GIMP_HEAL_LAPLACE_MULTIGRID);
+
+  g_assert_cmpfloat (gimp_test_heal_residual (multigrid), <,
+                     GIMP_TEST_MAX_RESIDUAL);
+  g_assert_cmpfloat (gimp_test_heal_max_diff (sor, multigrid), <,
+                     GIMP_TEST_MAX_DIFF);
+
+  gimp_test_heal_free (sor);
+  gimp_test_heal_free (multigrid);
+}
+
+/**
+ * laplace_multigrid:
+ * @data:
+ *
+ * Makes sure the multigrid solver converges, and agrees with the SOR
+ * solver, for RGBA and grayscale pixels.
+ **/
+static void
+laplace_multigrid (gconstpointer data)
+{
+  gimp_test_heal_compare_solvers (4,
+                                  GIMP_TEST_SIZE / 2.0,
+                                  GIMP_TEST_SIZE / 2.0,
+                                  GIMP_TEST_SIZE - 2.0);
+  gimp_test_heal_compare_solvers (2,
+                                  GIMP_TEST_SIZE / 2.0,
+                                  GIMP_TEST_SIZE / 2.0,
+                                  GIMP_TEST_SIZE - 2.0);
+}
+
+/**
+ * laplace_multigrid_edge:
+ * @data:
+ *
+ * Makes sure the multigrid solver handles brushes crossing the edges of
+ * the area, where the pixels only have neumann conditions.
+ **/
+static void
+laplace_multigrid_edge (gconstpointer data)
+{
+  GimpTestHeal *heal;
+
+  heal = gimp_test_heal_new (GIMP_TEST_SIZE, GIMP_TEST_SIZE / 2, 4,
+                             GIMP_TEST_SIZE / 4.0, 0.0,
+                             GIMP_TEST_SIZE);
+
+  gimp_test_heal_solve (heal, GIMP_HEAL_LAPLACE_MULTIGRID);
+
+  g_assert_cmpfloat (gimp_test_heal_residual (heal), <,
+                     GIMP_TEST_MAX_RESIDUAL);
+
+  gimp_test_heal_free (heal);
+}
+
+/**
+ * benchmark_laplace:
+ * @data:
+ *
+ * Measures the time the SOR and multigrid solvers take to heal round
+ * brushes of 100 to 1000 pixels.  Only run in perf mode.
+ **/
+static void
+benchmark_laplace (gconstpointer data)
+{
+  static const gint sizes[] = { 100, 250, 500, 1000 };
+  gint              i;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      GimpHealLaplaceSolver solver;
+      GimpTestHeal         *heal;
+
+      heal = gimp_test_heal_new (sizes[i], sizes[i], 4,
+                                 sizes[i] / 2.0, sizes[i] / 2.0,
+                                 sizes[i] - 2.0);
+
+      for (solver = GIMP_HEAL_LAPLACE_SOR;
+           solver <= GIMP_HEAL_LAPLACE_MULTIGRID;
+           solver++)
+        {
+          gdouble elapsed = 0.0;
+          gdouble err     = 0.0;
+          gint    j;
+
+          for (j = 0; j < GIMP_BENCHMARK_ITERATIONS; j++)
+            {
+              GimpTestHeal *copy = gimp_test_heal_copy (heal);
+
+              g_test_timer_start ();
+
+              gimp_test_heal_solve (copy, solver);
+
+              elapsed += g_test_timer_elapsed ();
+
+              err = gimp_test_heal_residual (copy);
+
+              gimp_test_heal_free (copy);
+            }
+
+          elapsed /= GIMP_BENCHMARK_ITERATIONS;
+
+          g_test_minimized_result (elapsed,
+                                   "%d px, %s: %.2f ms, residual %g",
+                                   sizes[i],
+                                   solver == GIMP_HEAL_LAPLACE_SOR ?
+                                     "sor" : "multigrid",
+                                   elapsed * 1000.0, err);
+        }
+
+      gimp_test_heal_free (heal);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (laplace_multigrid);
+  ADD_TEST (laplace_multigrid_edge);
+
+  if (g_test_perf ())
+    ADD_TEST (benchmark_laplace);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
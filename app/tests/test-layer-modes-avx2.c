@@ -0,0 +1,394 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+#include "operations/operations-types.h"
+
+#include "core/gimp.h"
+
+#include "operations/layer-modes/gimpoperationlayermode.h"
+#include "operations/layer-modes/gimpoperationlayermode-blend.h"
+#include "operations/layer-modes/gimpoperationlayermode-composite.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/* the AVX2 functions process two pixels at a time, so most of these leave
+ * a trailing odd pixel to the generic functions
+ */
+#define GIMP_TEST_MAX_SAMPLES 101
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-layer-modes-avx2/" #function, gimp, function);
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+typedef void (* GimpTestCompositeFunc) (const gfloat *in,
+                                        const gfloat *layer,
+                                        const gfloat *comp,
+                                        const gfloat *mask,
+                                        gfloat        opacity,
+                                        gfloat       *out,
+                                        gint          samples);
+
+typedef struct
+{
+  const gchar            *name;
+  GimpLayerModeBlendFunc  generic;
+  GimpLayerModeBlendFunc  avx2;
+} GimpTestBlendFuncs;
+
+typedef struct
+{
+  const gchar           *name;
+  GimpTestCompositeFunc  generic;
+  GimpTestCompositeFunc  avx2;
+} GimpTestCompositeFuncs;
+
+
+#define BLEND_FUNC(name)                          \
+  { #name,                                        \
+    gimp_operation_layer_mode_blend_##name,       \
+    gimp_operation_layer_mode_blend_##name##_avx2 }
+
+static const GimpTestBlendFuncs blend_funcs[] =
+{
+  BLEND_FUNC (addition),
+  BLEND_FUNC (burn),
+  BLEND_FUNC (darken_only),
+  BLEND_FUNC (difference),
+  BLEND_FUNC (divide),
+  BLEND_FUNC (dodge),
+  BLEND_FUNC (exclusion),
+  BLEND_FUNC (grain_extract),
+  BLEND_FUNC (grain_merge),
+  BLEND_FUNC (hard_mix),
+  BLEND_FUNC (hardlight),
+  BLEND_FUNC (lch_color),
+  BLEND_FUNC (lch_lightness),
+  BLEND_FUNC (lighten_only),
+  BLEND_FUNC (linear_burn),
+  BLEND_FUNC (linear_light),
+  BLEND_FUNC (luma_darken_only),
+  BLEND_FUNC (luma_lighten_only),
+  BLEND_FUNC (multiply),
+  BLEND_FUNC (overlay),
+  BLEND_FUNC (pin_light),
+  BLEND_FUNC (screen),
+  BLEND_FUNC (softlight),
+  BLEND_FUNC (subtract),
+  BLEND_FUNC (vivid_light)
+};
+
+#undef BLEND_FUNC
+
+#define COMPOSITE_FUNC(name)                          \
+  { #name,                                            \
+    gimp_operation_layer_mode_composite_##name,       \
+    gimp_operation_layer_mode_composite_##name##_avx2 }
+
+static const GimpTestCompositeFuncs composite_funcs[] =
+{
+  COMPOSITE_FUNC (union),
+  COMPOSITE_FUNC (clip_to_backdrop),
+  COMPOSITE_FUNC (clip_to_layer),
+  COMPOSITE_FUNC (intersection),
+  COMPOSITE_FUNC (union_sub),
+  COMPOSITE_FUNC (clip_to_backdrop_sub),
+  COMPOSITE_FUNC (clip_to_layer_sub),
+  COMPOSITE_FUNC (intersection_sub)
+};
+
+#undef COMPOSITE_FUNC
+
+static const gint sample_counts[] = { 1, 2, 3, 5, 7, 8, 13, 64, 101 };
+
+
+static gboolean
+gimp_test_have_avx2 (void)
+{
+  return (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2) != 0;
+}
+
+/* returns a random value, slightly out of the [0, 1] range, or, once in a
+ * while, one of the values the kernels treat specially, or that don't
+ * survive min/max and comparisons unchanged
+ */
+static gfloat
+gimp_test_random_value (GRand *rand)
+{
+  static const gfloat special[] =
+  {
+    0.0f, -0.0f, 0.5f, 1.0f, 1e-7f, -1e-7f, NAN, INFINITY, -INFINITY
+  };
+
+  if (g_rand_int_range (rand, 0, 8) == 0)
+    return special[g_rand_int_range (rand, 0, G_N_ELEMENTS (special))];
+
+  return g_rand_double_range (rand, -0.5, 1.5);
+}
+
+/* fills @pixels with random RGBA pixels, with some fully transparent ones */
+static void
+gimp_test_random_pixels (GRand  *rand,
+                         gfloat *pixels,
+                         gint    samples)
+{
+  gint i;
+
+  for (i = 0; i < samples * 4; i++)
+    pixels[i] = gimp_test_random_value (rand);
+
+  for (i = 3; i < samples * 4; i += 4)
+    {
+      if (g_rand_int_range (rand, 0, 8) == 0)
+        pixels[i] = 0.0f;
+    }
+}
+
+/* NaNs compare equal regardless of their payload, anything else has to
+ * be bit-identical
+ */
+static void
+gimp_test_assert_equal (const gchar *name,
+                        gint         samples,
+                        gint         i,
+                        gfloat       expected,
+                        gfloat       result)
+{
+  gboolean equal;
+
+  if (isnan (expected) && isnan (result))
+    equal = TRUE;
+  else
+    equal = memcmp (&expected, &result, sizeof (gfloat)) == 0;
+
+  if (! equal)
+    {
+      g_test_message ("%s_avx2 (%d samples): component %d is %g, "
+                      "expected %g",
+                      name, samples, i, result, expected);
+    }
+
+  g_assert_true (equal);
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
+/**
+ * blend_avx2:
+ * @data:
+ *
+ * Makes sure the AVX2 blend functions give the same results as the
+ * generic ones, including for NaN and infinite components, and sample
+ * counts that leave a trailing pixel.
+ **/
+static void
+blend_avx2 (gconstpointer data)
+{
+#if COMPILE_AVX2_INTRINISICS
+  GeglNode      *node;
+  GeglOperation *operation;
+  GRand         *rand;
+  gfloat         in[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat         layer[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat         expected[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat         result[GIMP_TEST_MAX_SAMPLES * 4];
+  gint           f;
+  gint           s;
+  gint           i;
+
+  if (! gimp_test_have_avx2 ())
+    {
+      g_test_skip ("AVX2 is not available");
+      return;
+    }
+
+  /* the luma blend functions take the luminance coefficients from the
+   * operation's input space
+   */
+  node = gegl_node_new ();
+  gegl_node_set (node,
+                 "operation", "gimp:normal",
+                 NULL);
+
+  operation = gegl_node_get_gegl_operation (node);
+
+  gimp_operation_layer_mode_set_input_space (GIMP_OPERATION_LAYER_MODE (operation),
+                                             babl_space ("ProPhoto"));
+
+  rand = g_rand_new_with_seed (GIMP_TEST_MAX_SAMPLES);
+
+  for (f = 0; f < G_N_ELEMENTS (blend_funcs); f++)
+    {
+      const GimpTestBlendFuncs *func = &blend_funcs[f];
+
+      for (s = 0; s < G_N_ELEMENTS (sample_counts); s++)
+        {
+          gint samples = sample_counts[s];
+
+          gimp_test_random_pixels (rand, in,    samples);
+          gimp_test_random_pixels (rand, layer, samples);
+
+          func->generic (operation, in, layer, expected, samples);
+          func->avx2    (operation, in, layer, result,   samples);
+
+          for (i = 0; i < samples * 4; i++)
+            {
+              gint pixel = i - i % 4;
+
+              /* comp[RED..BLUE] is unconstrained where either alpha is 0,
+               * and the generic functions leave it unset
+               */
+              if (i % 4 != ALPHA &&
+                  (in[pixel + ALPHA] == 0.0f || layer[pixel + ALPHA] == 0.0f))
+                {
+                  continue;
+                }
+
+              gimp_test_assert_equal (func->name, samples, i,
+                                      expected[i], result[i]);
+            }
+        }
+    }
+
+  g_rand_free (rand);
+
+  g_object_unref (node);
+#else
+  g_test_skip ("AVX2 intrinsics are not compiled in");
+#endif
+}
+
+/**
+ * composite_avx2:
+ * @data:
+ *
+ * Makes sure the AVX2 composite functions give the same results as the
+ * generic ones, with and without a mask, including for NaN and infinite
+ * components, and sample counts that leave a trailing pixel.
+ **/
+static void
+composite_avx2 (gconstpointer data)
+{
+#if COMPILE_AVX2_INTRINISICS
+  GRand  *rand;
+  gfloat  in[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat  layer[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat  comp[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat  mask[GIMP_TEST_MAX_SAMPLES];
+  gfloat  expected[GIMP_TEST_MAX_SAMPLES * 4];
+  gfloat  result[GIMP_TEST_MAX_SAMPLES * 4];
+  gint    f;
+  gint    s;
+  gint    i;
+
+  if (! gimp_test_have_avx2 ())
+    {
+      g_test_skip ("AVX2 is not available");
+      return;
+    }
+
+  rand = g_rand_new_with_seed (GIMP_TEST_MAX_SAMPLES);
+
+  for (f = 0; f < G_N_ELEMENTS (composite_funcs); f++)
+    {
+      const GimpTestCompositeFuncs *func = &composite_funcs[f];
+
+      for (s = 0; s < G_N_ELEMENTS (sample_counts) * 2; s++)
+        {
+          gint          samples   = sample_counts[s / 2];
+          const gfloat *the_mask  = NULL;
+          gfloat        opacity   = 1.0f;
+
+          gimp_test_random_pixels (rand, in,    samples);
+          gimp_test_random_pixels (rand, layer, samples);
+          gimp_test_random_pixels (rand, comp,  samples);
+
+          /* every other run uses a mask, and a random opacity */
+          if (s % 2)
+            {
+              for (i = 0; i < samples; i++)
+                mask[i] = gimp_test_random_value (rand);
+
+              the_mask = mask;
+              opacity  = g_rand_double (rand);
+            }
+
+          func->generic (in, layer, comp, the_mask, opacity,
+                         expected, samples);
+          func->avx2    (in, layer, comp, the_mask, opacity,
+                         result,   samples);
+
+          for (i = 0; i < samples * 4; i++)
+            {
+              gimp_test_assert_equal (func->name, samples, i,
+                                      expected[i], result[i]);
+            }
+        }
+    }
+
+  g_rand_free (rand);
+#else
+  g_test_skip ("AVX2 intrinsics are not compiled in");
+#endif
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (blend_avx2);
+  ADD_TEST (composite_avx2);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
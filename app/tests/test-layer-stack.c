@@ -0,0 +1,256 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+
+#include "gegl/gimp-gegl-nodes.h"
+
+#include "operations/layer-modes/gimpoperationlayerstack.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_WIDTH     96
+#define GIMP_TEST_HEIGHT    64
+#define GIMP_TEST_N_LAYERS  5
+
+#define GIMP_TEST_TOLERANCE 1e-5
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-layer-stack/" #function, gimp, function);
+
+
+/* creates a buffer of random pixels in @space */
+static GeglBuffer *
+gimp_test_create_buffer (GRand      *rand,
+                         const Babl *space,
+                         gint        width,
+                         gint        height)
+{
+  GeglBuffer *buffer;
+  const Babl *format;
+  gfloat     *pixels;
+  gint        n = width * height * 4;
+  gint        i;
+
+  format = babl_format_with_space ("R'G'B'A float", space);
+  pixels = g_new (gfloat, n);
+
+  for (i = 0; i < n; i++)
+    pixels[i] = g_rand_double (rand);
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height), format);
+
+  gegl_buffer_set (buffer, NULL, 0, format, pixels, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (pixels);
+
+  return buffer;
+}
+
+static gfloat *
+gimp_test_render (GeglNode   *node,
+                  const Babl *space)
+{
+  GeglBuffer *buffer;
+  const Babl *format;
+  gfloat     *result;
+
+  format = babl_format_with_space ("RGBA float", space);
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                            GIMP_TEST_WIDTH,
+                                            GIMP_TEST_HEIGHT),
+                            format);
+
+  gegl_node_blit_buffer (node, buffer, NULL, 0, GEGL_ABYSS_NONE);
+
+  result = g_new (gfloat, GIMP_TEST_WIDTH * GIMP_TEST_HEIGHT * 4);
+
+  gegl_buffer_get (buffer, NULL, 1.0, format,
+                   result, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_object_unref (buffer);
+
+  return result;
+}
+
+/**
+ * non_srgb_space:
+ * @data:
+ *
+ * Makes sure a fused layer stack gives the same result as the equivalent
+ * chain of layer-mode nodes when the image isn't in sRGB, including for
+ * the modes whose blend functions depend on the space of their input.
+ **/
+static void
+non_srgb_space (gconstpointer data)
+{
+  static const GimpLayerMode modes[GIMP_TEST_N_LAYERS] =
+  {
+    GIMP_LAYER_MODE_NORMAL,
+    GIMP_LAYER_MODE_LUMA_DARKEN_ONLY,
+    GIMP_LAYER_MODE_LUMA_LIGHTEN_ONLY,
+    GIMP_LAYER_MODE_LUMINANCE,
+    GIMP_LAYER_MODE_MULTIPLY
+  };
+
+  GimpOperationLayerStackLayer  layers[GIMP_TEST_N_LAYERS];
+  const Babl                   *space = babl_space ("ProPhoto");
+  GRand                        *rand;
+  GeglBuffer                   *backdrop;
+  GeglNode                     *graph;
+  GeglNode                     *input;
+  GeglNode                     *chain;
+  GeglNode                     *stack;
+  gfloat                       *expected;
+  gfloat                       *result;
+  gint                          i;
+
+  rand = g_rand_new_with_seed (GIMP_TEST_N_LAYERS);
+
+  graph = gegl_node_new ();
+
+  backdrop = gimp_test_create_buffer (rand, space,
+                                      GIMP_TEST_WIDTH, GIMP_TEST_HEIGHT);
+
+  input = gegl_node_new_child (graph,
+                               "operation", "gegl:buffer-source",
+                               "buffer",    backdrop,
+                               NULL);
+
+  chain = input;
+
+  for (i = 0; i < GIMP_TEST_N_LAYERS; i++)
+    {
+      GimpOperationLayerStackLayer *layer = &layers[i];
+      GeglNode                     *source;
+      GeglNode                     *offset;
+      GeglNode                     *mode;
+
+      layer->buffer          = gimp_test_create_buffer (rand, space,
+                                                        GIMP_TEST_WIDTH  / 2,
+                                                        GIMP_TEST_HEIGHT / 2);
+      layer->mask            = NULL;
+      layer->offset_x        = g_rand_int_range (rand,
+                                                 0, GIMP_TEST_WIDTH  / 2);
+      layer->offset_y        = g_rand_int_range (rand,
+                                                 0, GIMP_TEST_HEIGHT / 2);
+      layer->mode            = modes[i];
+      layer->blend_space     = GIMP_LAYER_COLOR_SPACE_AUTO;
+      layer->composite_space = GIMP_LAYER_COLOR_SPACE_AUTO;
+      layer->composite_mode  = GIMP_LAYER_COMPOSITE_AUTO;
+      layer->opacity         = g_rand_double_range (rand, 0.5, 1.0);
+
+      source = gegl_node_new_child (graph,
+                                    "operation", "gegl:buffer-source",
+                                    "buffer",    layer->buffer,
+                                    NULL);
+      offset = gegl_node_new_child (graph,
+                                    "operation", "gegl:translate",
+                                    "x",         (gdouble) layer->offset_x,
+                                    "y",         (gdouble) layer->offset_y,
+                                    NULL);
+      mode   = gegl_node_new_child (graph,
+                                    "operation", "gimp:normal",
+                                    NULL);
+
+      gimp_gegl_mode_node_set_mode (mode,
+                                    layer->mode,
+                                    layer->blend_space,
+                                    layer->composite_space,
+                                    layer->composite_mode);
+      gimp_gegl_mode_node_set_opacity (mode, layer->opacity);
+
+      gegl_node_link (source, offset);
+      gegl_node_connect_to (offset, "output",
+                            mode,   "aux");
+      gegl_node_link (chain, mode);
+
+      chain = mode;
+    }
+
+  expected = gimp_test_render (chain, space);
+
+  stack = gegl_node_new_child (graph,
+                               "operation", "gimp:layer-stack",
+                               NULL);
+
+  gimp_operation_layer_stack_set_layers (stack, layers, GIMP_TEST_N_LAYERS);
+
+  gegl_node_link (input, stack);
+
+  result = gimp_test_render (stack, space);
+
+  for (i = 0; i < GIMP_TEST_WIDTH * GIMP_TEST_HEIGHT * 4; i++)
+    g_assert_cmpfloat (fabs (result[i] - expected[i]), <=,
+                       GIMP_TEST_TOLERANCE);
+
+  g_free (expected);
+  g_free (result);
+
+  g_object_unref (graph);
+
+  for (i = 0; i < GIMP_TEST_N_LAYERS; i++)
+    g_object_unref (layers[i].buffer);
+
+  g_object_unref (backdrop);
+
+  g_rand_free (rand);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (non_srgb_space);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
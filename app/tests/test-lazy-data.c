@@ -0,0 +1,248 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
+
+#include "core/core-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimppattern.h"
+#include "core/gimppattern-load.h"
+#include "core/gimppattern-save.h"
+#include "core/gimptempbuf.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-lazy-data/" #function, gimp, function);
+
+
+/* saves a new pattern to a temporary file, and returns the file */
+static GFile *
+gimp_test_pattern_save (Gimp         *gimp,
+                        GimpPattern **pattern)
+{
+  GimpContext   *context = gimp_get_user_context (gimp);
+  GOutputStream *output;
+  GFile         *file;
+  GFileIOStream *iostream;
+  GError        *error   = NULL;
+
+  *pattern = GIMP_PATTERN (gimp_pattern_new (context, "Lazy Test"));
+
+  file = g_file_new_tmp ("gimp-test-XXXXXX" GIMP_PATTERN_FILE_EXTENSION,
+                         &iostream, &error);
+  g_assert_no_error (error);
+
+  output = g_io_stream_get_output_stream (G_IO_STREAM (iostream));
+
+  g_assert_true (gimp_pattern_save (GIMP_DATA (*pattern), output, &error));
+  g_assert_no_error (error);
+
+  g_io_stream_close (G_IO_STREAM (iostream), NULL, &error);
+  g_assert_no_error (error);
+
+  g_object_unref (iostream);
+
+  return file;
+}
+
+/* loads the pattern the way the data factory does, with lazy loading on */
+static GimpPattern *
+gimp_test_pattern_load_lazy (Gimp  *gimp,
+                             GFile *file)
+{
+  GimpContext  *context = gimp_get_user_context (gimp);
+  GInputStream *input;
+  GFileInfo    *info;
+  GimpData     *data;
+  GList        *list;
+  GError       *error   = NULL;
+
+  gimp->config->data_lazy_loading = TRUE;
+
+  input = G_INPUT_STREAM (g_file_read (file, NULL, &error));
+  g_assert_no_error (error);
+
+  list = gimp_pattern_load_lazy (context, file, input, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (g_list_length (list), ==, 1);
+
+  g_object_unref (input);
+
+  gimp->config->data_lazy_loading = FALSE;
+
+  data = list->data;
+  g_list_free (list);
+
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                            G_FILE_QUERY_INFO_NONE, NULL, &error);
+  g_assert_no_error (error);
+
+  gimp_data_set_file (data, file, TRUE, TRUE);
+  gimp_data_set_mtime (data,
+                       g_file_info_get_attribute_uint64 (info,
+                                                         G_FILE_ATTRIBUTE_TIME_MODIFIED));
+  gimp_data_clean (data);
+
+  g_object_unref (info);
+
+  return GIMP_PATTERN (data);
+}
+
+/**
+ * lazy_pattern:
+ * @data:
+ *
+ * Makes sure a lazily loaded pattern knows its size before its pixels
+ * are read, and that they are the same as the saved pattern's once
+ * they are.
+ **/
+static void
+lazy_pattern (gconstpointer data)
+{
+  Gimp        *gimp = GIMP (data);
+  GimpPattern *pattern;
+  GimpPattern *lazy;
+  GimpTempBuf *mask;
+  GimpTempBuf *lazy_mask;
+  GFile       *file;
+  gint         width;
+  gint         height;
+
+  file = gimp_test_pattern_save (gimp, &pattern);
+  lazy = gimp_test_pattern_load_lazy (gimp, file);
+
+  mask = gimp_pattern_get_mask (pattern);
+
+  g_assert_false (gimp_data_is_loaded (GIMP_DATA (lazy)));
+
+  g_assert_true (gimp_viewable_get_size (GIMP_VIEWABLE (lazy),
+                                         &width, &height));
+  g_assert_cmpint (width,  ==, gimp_temp_buf_get_width  (mask));
+  g_assert_cmpint (height, ==, gimp_temp_buf_get_height (mask));
+
+  g_assert_false (gimp_data_is_loaded (GIMP_DATA (lazy)));
+
+  lazy_mask = gimp_pattern_get_mask (lazy);
+
+  g_assert_true (gimp_data_is_loaded (GIMP_DATA (lazy)));
+
+  g_assert_true (gimp_temp_buf_get_format (lazy_mask) ==
+                 gimp_temp_buf_get_format (mask));
+  g_assert_cmpmem (gimp_temp_buf_get_data (lazy_mask),
+                   gimp_temp_buf_get_data_size (lazy_mask),
+                   gimp_temp_buf_get_data (mask),
+                   gimp_temp_buf_get_data_size (mask));
+
+  g_object_unref (lazy);
+  g_object_unref (pattern);
+
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+}
+
+/**
+ * lazy_pattern_changed:
+ * @data:
+ *
+ * Makes sure a lazily loaded pattern whose file changed behind its
+ * back doesn't read pixels that don't belong to its header, and falls
+ * back to an empty mask of the right size.
+ **/
+static void
+lazy_pattern_changed (gconstpointer data)
+{
+  Gimp        *gimp = GIMP (data);
+  GimpPattern *pattern;
+  GimpPattern *lazy;
+  GimpTempBuf *mask;
+  GFile       *file;
+  guchar      *pixels;
+  gsize        size;
+  gsize        i;
+
+  file = gimp_test_pattern_save (gimp, &pattern);
+  lazy = gimp_test_pattern_load_lazy (gimp, file);
+
+  gimp_data_set_mtime (GIMP_DATA (lazy),
+                       gimp_data_get_mtime (GIMP_DATA (lazy)) - 1);
+
+  mask = gimp_pattern_get_mask (lazy);
+
+  g_assert_cmpint (gimp_temp_buf_get_width (mask), ==,
+                   gimp_temp_buf_get_width (gimp_pattern_get_mask (pattern)));
+  g_assert_cmpint (gimp_temp_buf_get_height (mask), ==,
+                   gimp_temp_buf_get_height (gimp_pattern_get_mask (pattern)));
+
+  pixels = gimp_temp_buf_get_data (mask);
+  size   = gimp_temp_buf_get_data_size (mask);
+
+  for (i = 0; i < size; i++)
+    g_assert_cmpint (pixels[i], ==, 0);
+
+  g_object_unref (lazy);
+  g_object_unref (pattern);
+
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (lazy_pattern);
+  ADD_TEST (lazy_pattern_changed);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
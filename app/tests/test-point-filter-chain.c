@@ -0,0 +1,340 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpcurve.h"
+
+#include "operations/gimpbrightnesscontrastconfig.h"
+#include "operations/gimpcurvesconfig.h"
+#include "operations/gimplevelsconfig.h"
+#include "operations/gimpoperationpointfilterchain.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_WIDTH     123
+#define GIMP_TEST_HEIGHT    45
+
+/* the lookup tables are interpolated, hence the results aren't exact */
+#define GIMP_TEST_TOLERANCE 1e-3
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-point-filter-chain/" #function, gimp, function);
+
+
+typedef struct
+{
+  GeglNode *graph;
+  GeglNode *filters[4];
+  GObject  *configs[3];
+} GimpTestFilters;
+
+
+/* creates a buffer of random pixels, some of whose components are outside
+ * of [0, 1]
+ */
+static GeglBuffer *
+gimp_test_create_buffer (void)
+{
+  GeglBuffer *buffer;
+  GRand      *rand;
+  gfloat     *pixels;
+  gint        n = GIMP_TEST_WIDTH * GIMP_TEST_HEIGHT * 4;
+  gint        i;
+
+  rand   = g_rand_new_with_seed (n);
+  pixels = g_new (gfloat, n);
+
+  for (i = 0; i < n; i++)
+    {
+      if (g_rand_double (rand) < 0.05)
+        pixels[i] = g_rand_double_range (rand, -0.5, 1.5);
+      else
+        pixels[i] = g_rand_double (rand);
+    }
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                            GIMP_TEST_WIDTH,
+                                            GIMP_TEST_HEIGHT),
+                            babl_format ("RGBA float"));
+
+  gegl_buffer_set (buffer, NULL, 0, babl_format ("RGBA float"), pixels,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  g_rand_free (rand);
+  g_free (pixels);
+
+  return buffer;
+}
+
+/* a posterize filter, followed by curves and levels in the same format,
+ * and brightness-contrast in another format, which the chain splits into a
+ * directly-processed stage and two lookup-table stages
+ */
+static void
+gimp_test_create_filters (GimpTestFilters *filters)
+{
+  GimpCurvesConfig             *curves;
+  GimpLevelsConfig             *levels;
+  GimpBrightnessContrastConfig *brightness_contrast;
+
+  curves = g_object_new (GIMP_TYPE_CURVES_CONFIG, NULL);
+  gimp_curve_add_point (curves->curve[GIMP_HISTOGRAM_VALUE], 0.25, 0.4);
+  gimp_curve_add_point (curves->curve[GIMP_HISTOGRAM_RED],   0.6,  0.5);
+
+  levels = g_object_new (GIMP_TYPE_LEVELS_CONFIG, NULL);
+  levels->gamma[GIMP_HISTOGRAM_VALUE]      = 0.6;
+  levels->low_output[GIMP_HISTOGRAM_BLUE]  = 0.1;
+  levels->high_input[GIMP_HISTOGRAM_GREEN] = 0.8;
+
+  brightness_contrast = g_object_new (GIMP_TYPE_BRIGHTNESS_CONTRAST_CONFIG,
+                                      "brightness", 0.2,
+                                      "contrast",   0.3,
+                                      NULL);
+
+  filters->graph = gegl_node_new ();
+
+  filters->filters[0] = gegl_node_new_child (filters->graph,
+                                             "operation", "gimp:posterize",
+                                             "levels",    8,
+                                             NULL);
+  filters->filters[1] = gegl_node_new_child (filters->graph,
+                                             "operation", "gimp:curves",
+                                             "config",    curves,
+                                             "trc",       GIMP_TRC_NON_LINEAR,
+                                             NULL);
+  filters->filters[2] = gegl_node_new_child (filters->graph,
+                                             "operation", "gimp:levels",
+                                             "config",    levels,
+                                             "trc",       GIMP_TRC_NON_LINEAR,
+                                             NULL);
+  filters->filters[3] = gegl_node_new_child (filters->graph,
+                                             "operation", "gimp:brightness-contrast",
+                                             "config",    brightness_contrast,
+                                             NULL);
+
+  filters->configs[0] = G_OBJECT (curves);
+  filters->configs[1] = G_OBJECT (levels);
+  filters->configs[2] = G_OBJECT (brightness_contrast);
+}
+
+static void
+gimp_test_free_filters (GimpTestFilters *filters)
+{
+  gint i;
+
+  g_object_unref (filters->graph);
+
+  for (i = 0; i < G_N_ELEMENTS (filters->configs); i++)
+    g_object_unref (filters->configs[i]);
+}
+
+/* renders @src_buffer through the chain of nodes from @first to @last */
+static gfloat *
+gimp_test_render (GeglBuffer *src_buffer,
+                  GeglNode   *graph,
+                  GeglNode   *first,
+                  GeglNode   *last)
+{
+  GeglNode   *source;
+  GeglBuffer *dest_buffer;
+  gfloat     *result;
+
+  source = gegl_node_new_child (graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer",    src_buffer,
+                                NULL);
+
+  gegl_node_connect_to (source, "output",
+                        first,  "input");
+
+  dest_buffer = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
+                                 babl_format ("RGBA float"));
+
+  gegl_node_blit_buffer (last, dest_buffer, NULL, 0, GEGL_ABYSS_NONE);
+
+  result = g_new (gfloat, GIMP_TEST_WIDTH * GIMP_TEST_HEIGHT * 4);
+
+  gegl_buffer_get (dest_buffer, NULL, 1.0, babl_format ("RGBA float"),
+                   result, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_object_unref (dest_buffer);
+
+  return result;
+}
+
+static void
+gimp_test_compare (const gfloat *expected,
+                   const gfloat *result)
+{
+  gint i;
+
+  for (i = 0; i < GIMP_TEST_WIDTH * GIMP_TEST_HEIGHT * 4; i++)
+    g_assert_cmpfloat (fabs (result[i] - expected[i]), <=,
+                       GIMP_TEST_TOLERANCE);
+}
+
+/**
+ * chain:
+ * @data:
+ *
+ * Makes sure a chain of filters gives the same result as the filters
+ * applied one after the other, both inside and outside of the range its
+ * lookup tables cover.
+ **/
+static void
+chain (gconstpointer data)
+{
+  GimpTestFilters  filters;
+  GeglBuffer      *buffer;
+  GeglNode        *node;
+  gfloat          *expected;
+  gfloat          *result;
+
+  buffer = gimp_test_create_buffer ();
+
+  gimp_test_create_filters (&filters);
+
+  gegl_node_link_many (filters.filters[0],
+                       filters.filters[1],
+                       filters.filters[2],
+                       filters.filters[3],
+                       NULL);
+
+  expected = gimp_test_render (buffer, filters.graph,
+                               filters.filters[0], filters.filters[3]);
+
+  node = gegl_node_new_child (filters.graph,
+                              "operation", "gimp:point-filter-chain",
+                              NULL);
+
+  gimp_operation_point_filter_chain_set_filters (node, filters.filters,
+                                                G_N_ELEMENTS (filters.filters));
+
+  result = gimp_test_render (buffer, filters.graph, node, node);
+
+  gimp_test_compare (expected, result);
+
+  g_free (expected);
+  g_free (result);
+
+  gimp_test_free_filters (&filters);
+
+  g_object_unref (buffer);
+}
+
+/**
+ * changed_settings:
+ * @data:
+ *
+ * Makes sure setting the same filters again picks up changes to their
+ * settings.
+ **/
+static void
+changed_settings (gconstpointer data)
+{
+  GimpTestFilters   filters;
+  GimpLevelsConfig *levels;
+  GeglBuffer       *buffer;
+  GeglNode         *node;
+  gfloat           *expected;
+  gfloat           *result;
+
+  buffer = gimp_test_create_buffer ();
+
+  gimp_test_create_filters (&filters);
+
+  node = gegl_node_new_child (filters.graph,
+                              "operation", "gimp:point-filter-chain",
+                              NULL);
+
+  gimp_operation_point_filter_chain_set_filters (node, filters.filters,
+                                                G_N_ELEMENTS (filters.filters));
+
+  result = gimp_test_render (buffer, filters.graph, node, node);
+  g_free (result);
+
+  /* change the settings in place, the way the filter tools do */
+  levels = GIMP_LEVELS_CONFIG (filters.configs[1]);
+  levels->gamma[GIMP_HISTOGRAM_VALUE] = 1.7;
+
+  gimp_operation_point_filter_chain_set_filters (node, filters.filters,
+                                                G_N_ELEMENTS (filters.filters));
+
+  result = gimp_test_render (buffer, filters.graph, node, node);
+
+  gegl_node_link_many (filters.filters[0],
+                       filters.filters[1],
+                       filters.filters[2],
+                       filters.filters[3],
+                       NULL);
+
+  expected = gimp_test_render (buffer, filters.graph,
+                               filters.filters[0], filters.filters[3]);
+
+  gimp_test_compare (expected, result);
+
+  g_free (expected);
+  g_free (result);
+
+  gimp_test_free_filters (&filters);
+
+  g_object_unref (buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (chain);
+  ADD_TEST (changed_settings);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -45,6 +45,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <gegl.h>
 #include <gtk/gtk.h>
@@ -62,7 +63,6 @@
 #include "core/gimpimage.h"
 #include "core/gimppickable.h"
 #include "core/gimpscanconvert.h"
-#include "core/gimptempbuf.h"
 #include "core/gimptoolinfo.h"
 
 #include "widgets/gimphelp-ids.h"
@@ -93,9 +93,16 @@
 /* sentinel to mark seed point in ?cost? map */
 #define  SEED_POINT        9
 
-/*  Functional defines  */
-#define  PIXEL_COST(x)     ((x) >> 8)
-#define  PIXEL_DIR(x)      ((x) & 0x000000ff)
+/* link of pixels the search hasn't reached yet */
+#define  NO_LINK           255
+
+#define  SEARCH_BLOCK_SIZE 64  /* size of the blocks of search state      */
+#define  SEARCH_N_BUCKETS  512 /* must be larger than any single link cost */
+#define  MAX_SEARCHES      2   /* number of searches to keep for reuse     */
+
+#define  SEARCH_INDEX(x, y) \
+  (((y) & (SEARCH_BLOCK_SIZE - 1)) * SEARCH_BLOCK_SIZE + \
+   ((x) & (SEARCH_BLOCK_SIZE - 1)))
 
 
 struct _ISegment
@@ -112,6 +119,37 @@ struct _ICurve
   gboolean  closed;
 };
 
+/*  the state of a search over one block of the gradient map  */
+typedef struct
+{
+  guint32  cost[SEARCH_BLOCK_SIZE * SEARCH_BLOCK_SIZE];
+  guint8   link[SEARCH_BLOCK_SIZE * SEARCH_BLOCK_SIZE];
+  guint8   settled[SEARCH_BLOCK_SIZE * SEARCH_BLOCK_SIZE];
+  guint8   gradient[SEARCH_BLOCK_SIZE * SEARCH_BLOCK_SIZE * COST_WIDTH];
+} ISearchBlock;
+
+/*  a live-wire search: a Dijkstra search of the lowest cost paths from
+ *  the seed point, which is only expanded as far as the pixels asked
+ *  for so far, and kept around to be expanded further for the next ones
+ */
+struct _ISearch
+{
+  gint           x, y;        /*  the seed point                          */
+  gboolean       reverse;     /*  whether the seed is the segment's end   */
+
+  GeglBuffer    *gradient_map;
+  gint           width;
+  gint           height;
+
+  gint           n_blocks_x;
+  gint           n_blocks_y;
+  ISearchBlock **blocks;      /*  lazily allocated, row by row            */
+
+  GArray        *buckets[SEARCH_N_BUCKETS]; /*  queued pixels, by cost    */
+  gint           n_queued;
+  guint32        cost;        /*  cost of the pixels being settled        */
+};
+
 
 /*  local function prototypes  */
 
@@ -172,15 +210,9 @@ static void          gimp_iscissors_tool_commit         (GimpIscissorsTool     *
 static void          iscissors_convert         (GimpIscissorsTool *iscissors,
                                                 GimpDisplay       *display);
 static GeglBuffer  * gradient_map_new          (GimpPickable      *pickable);
+static void          gradient_map_validate     (GeglBuffer          *gradient_map,
+                                                const GeglRectangle *rect);
 
-static void          find_optimal_path         (GeglBuffer        *gradient_map,
-                                                GimpTempBuf       *dp_buf,
-                                                gint               x1,
-                                                gint               y1,
-                                                gint               x2,
-                                                gint               y2,
-                                                gint               xs,
-                                                gint               ys);
 static void          find_max_gradient         (GimpIscissorsTool *iscissors,
                                                 GimpPickable      *pickable,
                                                 gint              *x,
@@ -203,14 +235,30 @@ static gboolean      clicked_on_segment        (GimpIscissorsTool *iscissors,
                                                 gdouble            x,
                                                 gdouble            y);
 
-static GPtrArray   * plot_pixels               (GimpTempBuf       *dp_buf,
-                                                gint               x1,
-                                                gint               y1,
+static ISearch     * segment_get_search        (GimpIscissorsTool *iscissors,
+                                                ISegment          *segment,
                                                 gint               xs,
                                                 gint               ys,
                                                 gint               xe,
                                                 gint               ye);
 
+static ISearch     * isearch_new               (GeglBuffer        *gradient_map,
+                                                gint               x,
+                                                gint               y,
+                                                gboolean           reverse);
+static void          isearch_free              (ISearch           *search);
+static ISearchBlock * isearch_get_block        (ISearch           *search,
+                                                gint               x,
+                                                gint               y);
+static void          isearch_push              (ISearch           *search,
+                                                gint               x,
+                                                gint               y,
+                                                guint32            cost);
+static void          isearch_expand            (ISearch           *search);
+static GPtrArray   * isearch_find_path         (ISearch           *search,
+                                                gint               x,
+                                                gint               y);
+
 static ISegment    * isegment_new              (gint               x1,
                                                 gint               y1,
                                                 gint               x2,
@@ -1263,6 +1311,12 @@ gimp_iscissors_tool_halt (GimpIscissorsTool *iscissors,
       iscissors->redo_stack = NULL;
     }
 
+  if (iscissors->searches)
+    {
+      g_list_free_full (iscissors->searches, (GDestroyNotify) isearch_free);
+      iscissors->searches = NULL;
+    }
+
   g_clear_object (&iscissors->gradient_map);
   g_clear_object (&iscissors->mask);
 }
@@ -1483,6 +1537,7 @@ calculate_segment (GimpIscissorsTool *iscissors,
 {
   GimpDisplay  *display  = GIMP_TOOL (iscissors)->display;
   GimpPickable *pickable = GIMP_PICKABLE (gimp_display_get_image (display));
+  ISearch      *search;
   gint          width;
   gint          height;
   gint          xs, ys, xe, ye;
@@ -1501,11 +1556,12 @@ calculate_segment (GimpIscissorsTool *iscissors,
   /*  Calculate the lowest cost path from one vertex to the next as specified
    *  by the parameter "segment".
    *    Here are the steps:
-   *      1)  Calculate the appropriate working area for this operation
-   *      2)  Allocate a temp buf for the dynamic programming array
-   *      3)  Run the dynamic programming algorithm to find the optimal path
-   *      4)  Translate the optimal path into pixels in the isegment data
-   *            structure.
+   *      1)  Calculate the area the path is most likely to go through,
+   *            and compute the gradient map there in parallel
+   *      2)  Find a search seeded at one of the segment's ends, which is
+   *            kept from previous calls while the other end moves around
+   *      3)  Expand the search up to the other end, and translate the
+   *            path into pixels in the isegment data structure.
    */
 
   /*  Get the bounding box  */
@@ -1519,24 +1575,22 @@ calculate_segment (GimpIscissorsTool *iscissors,
   y2 = MAX (ys, ye) + 1;
 
   /*  expand the boundaries past the ending points by
-   *  some percentage of width and height.  This serves the following purpose:
-   *  It gives the algorithm more area to search so better solutions
-   *  are found.  This is particularly helpful in finding "bumps" which
-   *  fall outside the bounding box represented by the start and end
-   *  coordinates of the "segment".
+   *  some percentage of width and height.  Good paths often have
+   *  "bumps" which fall outside the bounding box represented by the
+   *  start and end coordinates of the "segment", and computing those
+   *  parts of the gradient map up front, in parallel, is much faster
+   *  than having the search compute them one tile at a time.
    */
   ewidth  = (x2 - x1) * EXTEND_BY + FIXED;
   eheight = (y2 - y1) * EXTEND_BY + FIXED;
 
-  if (xe >= xs)
-    x2 += CLAMP (ewidth, 0, width - x2);
-  else
-    x1 -= CLAMP (ewidth, 0, x1);
+  x1 -= CLAMP (ewidth,  0, x1);
+  y1 -= CLAMP (eheight, 0, y1);
+  x2 += CLAMP (ewidth,  0, width  - x2);
+  y2 += CLAMP (eheight, 0, height - y2);
 
-  if (ye >= ys)
-    y2 += CLAMP (eheight, 0, height - y2);
-  else
-    y1 -= CLAMP (eheight, 0, y1);
+  gradient_map_validate (iscissors->gradient_map,
+                         GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1));
 
   /* blow away any previous points list we might have */
   if (segment->points)
@@ -1545,324 +1599,329 @@ calculate_segment (GimpIscissorsTool *iscissors,
       segment->points = NULL;
     }
 
-  if ((x2 - x1) && (y2 - y1))
-    {
-      /*  If the bounding box has width and height...  */
+  search = segment_get_search (iscissors, segment, xs, ys, xe, ye);
 
-      GimpTempBuf *dp_buf; /*  dynamic programming buffer  */
-      gint         dp_width  = (x2 - x1);
-      gint         dp_height = (y2 - y1);
+  if (search->reverse)
+    segment->points = isearch_find_path (search, xs, ys);
+  else
+    segment->points = isearch_find_path (search, xe, ye);
+}
 
-      dp_buf = gimp_temp_buf_new (dp_width, dp_height,
-                                  babl_format ("Y u32"));
 
-      /*  find the optimal path of pixels from (x1, y1) to (x2, y2)  */
-      find_optimal_path (iscissors->gradient_map, dp_buf,
-                         x1, y1, x2, y2, xs, ys);
+static gint
+calculate_link (const guint8 *pixel,
+                const guint8 *neighbor,
+                gint          link)
+{
+  gint   value = 0;
+  guint8 grad;
 
-      /*  get a list of the pixels in the optimal path  */
-      segment->points = plot_pixels (dp_buf, x1, y1, xs, ys, xe, ye);
+  /* Convert the gradient into a cost: large gradients are good, and
+   * so have low cost. */
+  grad = 255 - pixel[0];
 
-      gimp_temp_buf_unref (dp_buf);
-    }
-  else if ((x2 - x1) == 0)
-    {
-      /*  If the bounding box has no width  */
+  /*  calculate the contribution of the gradient magnitude  */
+  if (link > 1)
+    value += diagonal_weight[grad] * OMEGA_G;
+  else
+    value += grad * OMEGA_G;
+
+  /*  calculate the contribution of the gradient direction  */
+  value +=
+    (direction_value[pixel[1]][link] + direction_value[neighbor[1]][link]) *
+    OMEGA_D;
+
+  return value;
+}
+
+/*  returns the search to use for "segment": one seeded at its start,
+ *  or at its end, whichever end didn't move since the last search, so
+ *  that the search only needs to be expanded as far as the new position
+ *  of the other end.
+ */
+static ISearch *
+segment_get_search (GimpIscissorsTool *iscissors,
+                    ISegment          *segment,
+                    gint               xs,
+                    gint               ys,
+                    gint               xe,
+                    gint               ye)
+{
+  ISearch  *search;
+  GList    *list;
+  gboolean  reverse;
 
-      /*  plot a vertical line  */
-      gint y   = ys;
-      gint dir = (ys > ye) ? -1 : 1;
+  for (list = iscissors->searches; list; list = g_list_next (list))
+    {
+      search = list->data;
 
-      segment->points = g_ptr_array_new ();
-      while (y != ye)
+      if (search->reverse ? (search->x == xe && search->y == ye) :
+                            (search->x == xs && search->y == ys))
         {
-          g_ptr_array_add (segment->points, GINT_TO_POINTER ((y << 16) + xs));
-          y += dir;
+          iscissors->searches = g_list_remove_link (iscissors->searches,
+                                                    list);
+          iscissors->searches = g_list_concat (list, iscissors->searches);
+
+          return search;
         }
     }
-  else if ((y2 - y1) == 0)
-    {
-      /*  If the bounding box has no height  */
 
-      /*  plot a horizontal line  */
-      gint x   = xs;
-      gint dir = (xs > xe) ? -1 : 1;
+  /*  when moving a vertex, the first segment's start is what moves  */
+  reverse = (iscissors->state == SEED_ADJUSTMENT &&
+             segment == iscissors->segment1);
 
-      segment->points = g_ptr_array_new ();
-      while (x != xe)
-        {
-          g_ptr_array_add (segment->points, GINT_TO_POINTER ((ys << 16) + x));
-          x += dir;
-        }
+  if (reverse)
+    search = isearch_new (iscissors->gradient_map, xe, ye, TRUE);
+  else
+    search = isearch_new (iscissors->gradient_map, xs, ys, FALSE);
+
+  iscissors->searches = g_list_prepend (iscissors->searches, search);
+
+  while (g_list_length (iscissors->searches) > MAX_SEARCHES)
+    {
+      list = g_list_last (iscissors->searches);
+
+      isearch_free (list->data);
+      iscissors->searches = g_list_delete_link (iscissors->searches, list);
     }
-}
 
+  return search;
+}
 
-/* badly need to get a replacement - this is _way_ too expensive */
-static gboolean
-gradient_map_value (GeglSampler         *map_sampler,
-                    const GeglRectangle *map_extent,
-                    gint                 x,
-                    gint                 y,
-                    guint8              *grad,
-                    guint8              *dir)
+static ISearch *
+isearch_new (GeglBuffer *gradient_map,
+             gint        x,
+             gint        y,
+             gboolean    reverse)
 {
-  if (x >= map_extent->x     &&
-      y >= map_extent->y     &&
-      x <  map_extent->width &&
-      y <  map_extent->height)
-    {
-      guint8 sample[2];
+  ISearch      *search = g_slice_new0 (ISearch);
+  ISearchBlock *block;
 
-      gegl_sampler_get (map_sampler, x, y, NULL, sample, GEGL_ABYSS_NONE);
+  search->x            = x;
+  search->y            = y;
+  search->reverse      = reverse;
+  search->gradient_map = g_object_ref (gradient_map);
+  search->width        = gegl_buffer_get_width  (gradient_map);
+  search->height       = gegl_buffer_get_height (gradient_map);
 
-      *grad = sample[0];
-      *dir  = sample[1];
+  search->n_blocks_x = (search->width  + SEARCH_BLOCK_SIZE - 1) /
+                       SEARCH_BLOCK_SIZE;
+  search->n_blocks_y = (search->height + SEARCH_BLOCK_SIZE - 1) /
+                       SEARCH_BLOCK_SIZE;
+  search->blocks     = g_new0 (ISearchBlock *,
+                               search->n_blocks_x * search->n_blocks_y);
 
-      return TRUE;
-    }
+  block = isearch_get_block (search, x, y);
 
-  return FALSE;
+  block->cost[SEARCH_INDEX (x, y)] = 0;
+  block->link[SEARCH_INDEX (x, y)] = SEED_POINT;
+
+  isearch_push (search, x, y, 0);
+
+  return search;
 }
 
-static gint
-calculate_link (GeglSampler         *map_sampler,
-                const GeglRectangle *map_extent,
-                gint                 x,
-                gint                 y,
-                guint32              pixel,
-                gint                 link)
+static void
+isearch_free (ISearch *search)
 {
-  gint   value = 0;
-  guint8 grad1, dir1, grad2, dir2;
+  gint i;
+
+  for (i = 0; i < search->n_blocks_x * search->n_blocks_y; i++)
+    g_free (search->blocks[i]);
 
-  if (! gradient_map_value (map_sampler, map_extent, x, y, &grad1, &dir1))
+  for (i = 0; i < SEARCH_N_BUCKETS; i++)
     {
-      grad1 = 0;
-      dir1 = 255;
+      if (search->buckets[i])
+        g_array_free (search->buckets[i], TRUE);
     }
 
-  /* Convert the gradient into a cost: large gradients are good, and
-   * so have low cost. */
-  grad1 = 255 - grad1;
+  g_free (search->blocks);
+  g_object_unref (search->gradient_map);
 
-  /*  calculate the contribution of the gradient magnitude  */
-  if (link > 1)
-    value += diagonal_weight[grad1] * OMEGA_G;
-  else
-    value += grad1 * OMEGA_G;
+  g_slice_free (ISearch, search);
+}
 
-  /*  calculate the contribution of the gradient direction  */
-  x += (gint8)(pixel & 0xff);
-  y += (gint8)((pixel & 0xff00) >> 8);
+static ISearchBlock *
+isearch_get_block (ISearch *search,
+                   gint     x,
+                   gint     y)
+{
+  ISearchBlock **block;
+  gint           bx = x / SEARCH_BLOCK_SIZE;
+  gint           by = y / SEARCH_BLOCK_SIZE;
+
+  block = &search->blocks[by * search->n_blocks_x + bx];
 
-  if (! gradient_map_value (map_sampler, map_extent, x, y, &grad2, &dir2))
+  if (! *block)
     {
-      grad2 = 0;
-      dir2 = 255;
+      *block = g_new (ISearchBlock, 1);
+
+      memset ((*block)->cost,    0xff,    sizeof ((*block)->cost));
+      memset ((*block)->link,    NO_LINK, sizeof ((*block)->link));
+      memset ((*block)->settled, 0,       sizeof ((*block)->settled));
+
+      /*  copy the block's gradients, instead of sampling the gradient
+       *  map for each link
+       */
+      gegl_buffer_get (search->gradient_map,
+                       GEGL_RECTANGLE (bx * SEARCH_BLOCK_SIZE,
+                                       by * SEARCH_BLOCK_SIZE,
+                                       SEARCH_BLOCK_SIZE,
+                                       SEARCH_BLOCK_SIZE),
+                       1.0, NULL, (*block)->gradient,
+                       SEARCH_BLOCK_SIZE * COST_WIDTH, GEGL_ABYSS_NONE);
     }
 
-  value +=
-    (direction_value[dir1][link] + direction_value[dir2][link]) * OMEGA_D;
-
-  return value;
+  return *block;
 }
 
+static void
+isearch_push (ISearch *search,
+              gint     x,
+              gint     y,
+              guint32  cost)
+{
+  GArray  **bucket = &search->buckets[cost % SEARCH_N_BUCKETS];
+  guint32   pixel  = (y << 16) + x;
 
-static GPtrArray *
-plot_pixels (GimpTempBuf *dp_buf,
-             gint         x1,
-             gint         y1,
-             gint         xs,
-             gint         ys,
-             gint         xe,
-             gint         ye)
+  if (! *bucket)
+    *bucket = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  g_array_append_val (*bucket, pixel);
+
+  search->n_queued++;
+}
+
+/*  settles the next pixel with the lowest cost.  No single link costs
+ *  SEARCH_N_BUCKETS or more, so all the queued pixels fit in the circular
+ *  array of buckets following the current cost.
+ */
+static void
+isearch_expand (ISearch *search)
 {
-  gint       x, y;
-  guint32    coords;
-  gint       link;
-  gint       width = gimp_temp_buf_get_width (dp_buf);
-  guint     *data;
-  GPtrArray *list;
+  ISearchBlock *block;
+  GArray       *bucket;
+  guint32       pixel;
+  gint          index;
+  gint          x, y;
+  gint          k;
 
-  /*  Start the data pointer at the correct location  */
-  data = (guint *) gimp_temp_buf_get_data (dp_buf) + (ye - y1) * width + (xe - x1);
+  bucket = search->buckets[search->cost % SEARCH_N_BUCKETS];
 
-  x = xe;
-  y = ye;
+  while (! bucket || bucket->len == 0)
+    {
+      search->cost++;
 
-  list = g_ptr_array_new ();
+      bucket = search->buckets[search->cost % SEARCH_N_BUCKETS];
+    }
 
-  while (TRUE)
+  pixel = g_array_index (bucket, guint32, bucket->len - 1);
+
+  g_array_set_size (bucket, bucket->len - 1);
+  search->n_queued--;
+
+  x     = pixel & 0x0000ffff;
+  y     = pixel >> 16;
+  block = isearch_get_block (search, x, y);
+  index = SEARCH_INDEX (x, y);
+
+  /*  pixels are queued again when their cost drops, skip the stale ones  */
+  if (block->settled[index] || block->cost[index] != search->cost)
+    return;
+
+  block->settled[index] = TRUE;
+
+  for (k = 0; k < 8; k++)
     {
-      coords = (y << 16) + x;
-      g_ptr_array_add (list, GINT_TO_POINTER (coords));
+      ISearchBlock *nblock;
+      gint          nx = x + move[k][0];
+      gint          ny = y + move[k][1];
+      gint          nindex;
+      guint32       cost;
+
+      if (nx < 0 || nx >= search->width ||
+          ny < 0 || ny >= search->height)
+        continue;
 
-      link = PIXEL_DIR (*data);
-      if (link == SEED_POINT)
-        return list;
+      nblock = isearch_get_block (search, nx, ny);
+      nindex = SEARCH_INDEX (nx, ny);
 
-      x += move[link][0];
-      y += move[link][1];
-      data += move[link][1] * width + move[link][0];
-    }
+      if (nblock->settled[nindex])
+        continue;
 
-  /*  won't get here  */
-  return NULL;
-}
+      /*  the cost of a link is always computed at the pixel closer to
+       *  the segment's end, so that both directions find the same paths
+       */
+      if (search->reverse)
+        cost = calculate_link (&block->gradient[index * COST_WIDTH],
+                               &nblock->gradient[nindex * COST_WIDTH],
+                               k & 3);
+      else
+        cost = calculate_link (&nblock->gradient[nindex * COST_WIDTH],
+                               &block->gradient[index * COST_WIDTH],
+                               k & 3);
 
+      cost += search->cost;
 
-#define PACK(x, y)    ((((y) & 0xff) << 8) | ((x) & 0xff))
-#define OFFSET(pixel) ((gint8)((pixel) & 0xff) + \
-                       ((gint8)(((pixel) & 0xff00) >> 8)) * \
-                       gimp_temp_buf_get_width (dp_buf))
+      if (cost < nblock->cost[nindex])
+        {
+          /*  link the neighbor back to this pixel  */
+          nblock->cost[nindex] = cost;
+          nblock->link[nindex] = k ^ 4;
 
-static void
-find_optimal_path (GeglBuffer  *gradient_map,
-                   GimpTempBuf *dp_buf,
-                   gint         x1,
-                   gint         y1,
-                   gint         x2,
-                   gint         y2,
-                   gint         xs,
-                   gint         ys)
+          isearch_push (search, nx, ny, cost);
+        }
+    }
+}
+
+/*  returns the lowest cost path between the seed point and (x, y),
+ *  from the segment's end to its start, like segments store them.
+ */
+static GPtrArray *
+isearch_find_path (ISearch *search,
+                   gint     x,
+                   gint     y)
 {
-  GeglSampler         *map_sampler;
-  const GeglRectangle *map_extent;
-  gint                 i, j, k;
-  gint                 x, y;
-  gint                 link;
-  gint                 linkdir;
-  gint                 dirx, diry;
-  gint                 min_cost;
-  gint                 new_cost;
-  gint                 offset;
-  gint                 cum_cost[8];
-  gint                 link_cost[8];
-  gint                 pixel_cost[8];
-  guint32              pixel[8];
-  guint32             *data;
-  guint32             *d;
-  gint                 dp_buf_width  = gimp_temp_buf_get_width  (dp_buf);
-  gint                 dp_buf_height = gimp_temp_buf_get_height (dp_buf);
-
-  /*  initialize the gradient map sampler and extent  */
-  map_sampler = gegl_buffer_sampler_new (gradient_map,
-                                         gegl_buffer_get_format (gradient_map),
-                                         GEGL_SAMPLER_NEAREST);
-  map_extent  = gegl_buffer_get_extent (gradient_map);
-
-  /*  initialize the dynamic programming buffer  */
-  data = (guint32 *) gimp_temp_buf_data_clear (dp_buf);
-
-  /*  what directions are we filling the array in according to?  */
-  dirx = (xs - x1 == 0) ? 1 : -1;
-  diry = (ys - y1 == 0) ? 1 : -1;
-  linkdir = (dirx * diry);
-
-  y = ys;
-
-  for (i = 0; i < dp_buf_height; i++)
+  ISearchBlock *block = isearch_get_block (search, x, y);
+  GPtrArray    *list;
+
+  while (! block->settled[SEARCH_INDEX (x, y)] && search->n_queued > 0)
+    isearch_expand (search);
+
+  list = g_ptr_array_new ();
+
+  while (TRUE)
     {
-      x = xs;
+      gint link;
 
-      d = data + (y-y1) * dp_buf_width + (x-x1);
+      g_ptr_array_add (list, GINT_TO_POINTER ((y << 16) + x));
 
-      for (j = 0; j < dp_buf_width; j++)
-        {
-          min_cost = G_MAXINT;
-
-          /* pixel[] array encodes how to get to a neighbour, if possible.
-           * 0 means no connection (eg edge).
-           * Rest packed as bottom two bytes: y offset then x offset.
-           * Initially, we assume we can't get anywhere.
-           */
-          for (k = 0; k < 8; k++)
-            pixel[k] = 0;
-
-          /*  Find the valid neighboring pixels  */
-          /*  the previous pixel  */
-          if (j)
-            pixel[((dirx == 1) ? 4 : 0)] = PACK (-dirx, 0);
-
-          /*  the previous row of pixels  */
-          if (i)
-            {
-              pixel[((diry == 1) ? 5 : 1)] = PACK (0, -diry);
+      link = block->link[SEARCH_INDEX (x, y)];
 
-              link = (linkdir == 1) ? 3 : 2;
-              if (j)
-                pixel[((diry == 1) ? (link + 4) : link)] = PACK (-dirx, -diry);
+      if (link == SEED_POINT || link == NO_LINK)
+        break;
 
-              link = (linkdir == 1) ? 2 : 3;
-              if (j != dp_buf_width - 1)
-                pixel[((diry == 1) ? (link + 4) : link)] = PACK (dirx, -diry);
-            }
+      x += move[link][0];
+      y += move[link][1];
 
-          /*  find the minimum cost of going through each neighbor to reach the
-           *  seed point...
-           */
-          link = -1;
-          for (k = 0; k < 8; k ++)
-            if (pixel[k])
-              {
-                link_cost[k] = calculate_link (map_sampler, map_extent,
-                                               xs + j*dirx, ys + i*diry,
-                                               pixel [k],
-                                               ((k > 3) ? k - 4 : k));
-                offset = OFFSET (pixel [k]);
-                pixel_cost[k] = PIXEL_COST (d[offset]);
-                cum_cost[k] = pixel_cost[k] + link_cost[k];
-                if (cum_cost[k] < min_cost)
-                  {
-                    min_cost = cum_cost[k];
-                    link = k;
-                  }
-              }
-
-          /*  If anything can be done...  */
-          if (link >= 0)
-            {
-              /*  set the cumulative cost of this pixel and the new direction
-               */
-              *d = (cum_cost[link] << 8) + link;
-
-              /*  possibly change the links from the other pixels to this pixel...
-               *  these changes occur if a neighboring pixel will receive a lower
-               *  cumulative cost by going through this pixel.
-               */
-              for (k = 0; k < 8; k ++)
-                if (pixel[k] && k != link)
-                  {
-                    /*  if the cumulative cost at the neighbor is greater than
-                     *  the cost through the link to the current pixel, change the
-                     *  neighbor's link to point to the current pixel.
-                     */
-                    new_cost = link_cost[k] + cum_cost[link];
-                    if (pixel_cost[k] > new_cost)
-                    {
-                      /*  reverse the link direction   /--------------------\ */
-                      offset = OFFSET (pixel[k]);
-                      d[offset] = (new_cost << 8) + ((k > 3) ? k - 4 : k + 4);
-                    }
-                  }
-            }
-          /*  Set the seed point  */
-          else if (!i && !j)
-            {
-              *d = SEED_POINT;
-            }
+      block = isearch_get_block (search, x, y);
+    }
 
-          /*  increment the data pointer and the x counter  */
-          d += dirx;
-          x += dirx;
-        }
+  /*  a reverse search's links lead from the segment's start to its end  */
+  if (search->reverse)
+    {
+      gint i;
+
+      for (i = 0; i < list->len / 2; i++)
+        {
+          gpointer tmp = list->pdata[i];
 
-      /*  increment the y counter  */
-      y += diry;
+          list->pdata[i]                 = list->pdata[list->len - 1 - i];
+          list->pdata[list->len - 1 - i] = tmp;
+        }
     }
 
-  g_object_unref (map_sampler);
+  return list;
 }
 
 static GeglBuffer *
@@ -1893,6 +1952,56 @@ gradient_map_new (GimpPickable *pickable)
   return buffer;
 }
 
+/*  computes the dirty tiles of the gradient map in "rect" in parallel  */
+static void
+gradient_map_validate (GeglBuffer          *gradient_map,
+                       const GeglRectangle *rect)
+{
+  GimpTileHandlerValidate *validate;
+  GArray                  *tiles;
+  gint                     tile_width;
+  gint                     tile_height;
+  gint                     x, y;
+
+  validate = gimp_tile_handler_validate_get_assigned (gradient_map);
+
+  g_object_get (gradient_map,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  tiles = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  /*  validate whole tiles, just like the tile handler does on demand,
+   *  since the gradients at tile edges depend on them
+   */
+  for (y = rect->y - rect->y % tile_height;
+       y < rect->y + rect->height;
+       y += tile_height)
+    {
+      for (x = rect->x - rect->x % tile_width;
+           x < rect->x + rect->width;
+           x += tile_width)
+        {
+          GeglRectangle tile = { x, y, tile_width, tile_height };
+
+          if (cairo_region_contains_rectangle (
+                validate->dirty_region,
+                (const cairo_rectangle_int_t *) &tile) !=
+              CAIRO_REGION_OVERLAP_OUT)
+            {
+              g_array_append_val (tiles, tile);
+            }
+        }
+    }
+
+  gimp_tile_handler_validate_validate_rects (validate, gradient_map,
+                                             (GeglRectangle *) tiles->data,
+                                             tiles->len);
+
+  g_array_free (tiles, TRUE);
+}
+
 static void
 find_max_gradient (GimpIscissorsTool *iscissors,
                    GimpPickable      *pickable,
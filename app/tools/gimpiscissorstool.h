@@ -45,6 +45,7 @@ typedef enum
 
 typedef struct _ISegment ISegment;
 typedef struct _ICurve   ICurve;
+typedef struct _ISearch  ISearch;
 
 
 #define GIMP_TYPE_ISCISSORS_TOOL            (gimp_iscissors_tool_get_type ())
@@ -79,6 +80,7 @@ struct _GimpIscissorsTool
   IscissorsState  state;        /*  state of iscissors                      */
 
   GeglBuffer     *gradient_map; /*  lazily filled gradient map              */
+  GList          *searches;     /*  live-wire searches, most recent first   */
   GimpChannel    *mask;         /*  selection mask                          */
 };
 
@@ -65,13 +65,14 @@ typedef struct
 
 /*  local function prototypes  */
 
-static gboolean   gimp_paint_tool_paint_use_thread  (GimpPaintTool   *paint_tool);
-static gpointer   gimp_paint_tool_paint_thread      (gpointer         data);
+static gboolean   gimp_paint_tool_paint_use_thread   (GimpPaintTool   *paint_tool);
+static gboolean   gimp_paint_tool_paint_use_pipeline (GimpPaintTool   *paint_tool);
+static gpointer   gimp_paint_tool_paint_thread       (gpointer         data);
 
-static gboolean   gimp_paint_tool_paint_timeout     (GimpPaintTool   *paint_tool);
+static gboolean   gimp_paint_tool_paint_timeout      (GimpPaintTool   *paint_tool);
 
-static void       gimp_paint_tool_paint_interpolate (GimpPaintTool   *paint_tool,
-                                                     InterpolateData *data);
+static void       gimp_paint_tool_paint_interpolate  (GimpPaintTool   *paint_tool,
+                                                      InterpolateData *data);
 
 
 /*  static variables  */
@@ -117,6 +118,17 @@ gimp_paint_tool_paint_use_thread (GimpPaintTool *paint_tool)
   return FALSE;
 }
 
+static gboolean
+gimp_paint_tool_paint_use_pipeline (GimpPaintTool *paint_tool)
+{
+  static gint use_paint_pipeline = -1;
+
+  if (use_paint_pipeline < 0)
+    use_paint_pipeline = g_getenv ("GIMP_NO_PAINT_PIPELINE") == NULL;
+
+  return use_paint_pipeline && gimp_paint_tool_paint_use_thread (paint_tool);
+}
+
 static gpointer
 gimp_paint_tool_paint_thread (gpointer data)
 {
@@ -170,6 +182,8 @@ gimp_paint_tool_paint_timeout (GimpPaintTool *paint_tool)
   paint_tool->paint_x = core->last_paint.x;
   paint_tool->paint_y = core->last_paint.y;
 
+  gimp_paint_core_flush_dabs (core, drawable);
+
   update = gimp_drawable_flush_paint (drawable);
 
   if (update && GIMP_PAINT_TOOL_GET_CLASS (paint_tool)->paint_flush)
@@ -273,6 +287,13 @@ gimp_paint_tool_paint_start (GimpPaintTool     *paint_tool,
   if (GIMP_PAINT_TOOL_GET_CLASS (paint_tool)->paint_prepare)
     GIMP_PAINT_TOOL_GET_CLASS (paint_tool)->paint_prepare (paint_tool, display);
 
+  /*  If we use a separate paint thread, let the paint core apply its dabs
+   *  asynchronously, while the paint thread goes on to generate the next
+   *  ones
+   */
+  gimp_paint_core_set_pipelined (core,
+                                 gimp_paint_tool_paint_use_pipeline (paint_tool));
+
   /*  Start the paint core  */
   if (! gimp_paint_core_start (core,
                                drawable, paint_options, &curr_coords,
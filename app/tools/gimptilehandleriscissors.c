@@ -41,21 +41,22 @@ enum
 };
 
 
-static void   gimp_tile_handler_iscissors_finalize     (GObject         *object);
-static void   gimp_tile_handler_iscissors_set_property (GObject         *object,
-                                                        guint            property_id,
-                                                        const GValue    *value,
-                                                        GParamSpec      *pspec);
-static void   gimp_tile_handler_iscissors_get_property (GObject         *object,
-                                                        guint            property_id,
-                                                        GValue          *value,
-                                                        GParamSpec      *pspec);
-
-static void   gimp_tile_handler_iscissors_validate     (GimpTileHandlerValidate *validate,
-                                                        const GeglRectangle     *rect,
-                                                        const Babl              *format,
-                                                        gpointer                 dest_buf,
-                                                        gint                     dest_stride);
+static void   gimp_tile_handler_iscissors_finalize       (GObject                 *object);
+static void   gimp_tile_handler_iscissors_set_property   (GObject                 *object,
+                                                          guint                    property_id,
+                                                          const GValue            *value,
+                                                          GParamSpec              *pspec);
+static void   gimp_tile_handler_iscissors_get_property   (GObject                 *object,
+                                                          guint                    property_id,
+                                                          GValue                  *value,
+                                                          GParamSpec              *pspec);
+
+static void   gimp_tile_handler_iscissors_begin_validate (GimpTileHandlerValidate *validate);
+static void   gimp_tile_handler_iscissors_validate       (GimpTileHandlerValidate *validate,
+                                                          const GeglRectangle     *rect,
+                                                          const Babl              *format,
+                                                          gpointer                 dest_buf,
+                                                          gint                     dest_stride);
 
 
 G_DEFINE_TYPE (GimpTileHandlerIscissors, gimp_tile_handler_iscissors,
@@ -72,11 +73,12 @@ gimp_tile_handler_iscissors_class_init (GimpTileHandlerIscissorsClass *klass)
 
   validate_class = GIMP_TILE_HANDLER_VALIDATE_CLASS (klass);
 
-  object_class->finalize     = gimp_tile_handler_iscissors_finalize;
-  object_class->set_property = gimp_tile_handler_iscissors_set_property;
-  object_class->get_property = gimp_tile_handler_iscissors_get_property;
+  object_class->finalize         = gimp_tile_handler_iscissors_finalize;
+  object_class->set_property     = gimp_tile_handler_iscissors_set_property;
+  object_class->get_property     = gimp_tile_handler_iscissors_get_property;
 
-  validate_class->validate   = gimp_tile_handler_iscissors_validate;
+  validate_class->begin_validate = gimp_tile_handler_iscissors_begin_validate;
+  validate_class->validate       = gimp_tile_handler_iscissors_validate;
 
   g_object_class_install_property (object_class, PROP_PICKABLE,
                                    g_param_spec_object ("pickable", NULL, NULL,
@@ -169,6 +171,19 @@ static const gfloat blur_32[9] =
 #define  MIN_GRADIENT  63      /* gradients < this are directionless */
 #define  COST_WIDTH     2      /* number of bytes for each pixel in cost map */
 
+static void
+gimp_tile_handler_iscissors_begin_validate (GimpTileHandlerValidate *validate)
+{
+  GimpTileHandlerIscissors *iscissors = GIMP_TILE_HANDLER_ISCISSORS (validate);
+
+  /*  flush once here, and not in validate(), which may be called from
+   *  several threads at once by gimp_tile_handler_validate_validate_rects()
+   */
+  gimp_pickable_flush (iscissors->pickable);
+
+  GIMP_TILE_HANDLER_VALIDATE_CLASS (parent_class)->begin_validate (validate);
+}
+
 static void
 gimp_tile_handler_iscissors_validate (GimpTileHandlerValidate *validate,
                                       const GeglRectangle     *rect,
@@ -197,8 +212,6 @@ gimp_tile_handler_iscissors_validate (GimpTileHandlerValidate *validate,
               rect->height);
 #endif
 
-  gimp_pickable_flush (iscissors->pickable);
-
   src = gimp_pickable_get_buffer (iscissors->pickable);
 
   temp0 = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
@@ -64,6 +64,7 @@
 #include "core/gimp-parallel.h"
 #include "core/gimpasync.h"
 #include "core/gimpbacktrace.h"
+#include "core/gimpbrushcache.h"
 #include "core/gimptempbuf.h"
 #include "core/gimpwaitable.h"
 
@@ -155,6 +156,9 @@ typedef enum
   VARIABLE_TILE_ALLOC_TOTAL,
   VARIABLE_SCRATCH_TOTAL,
   VARIABLE_TEMP_BUF_TOTAL,
+  VARIABLE_BRUSH_CACHE_TOTAL,
+  VARIABLE_BRUSH_CACHE_HIT_MISS,
+  VARIABLE_BRUSH_CACHE_EVICTED,
 
 
   N_VARIABLES,
@@ -372,6 +376,8 @@ static void       gimp_dashboard_sample_variable_rate_of_change (GimpDashboard
                                                                  Variable             variable);
 static void       gimp_dashboard_sample_swap_limit              (GimpDashboard       *dashboard,
                                                                  Variable             variable);
+static void       gimp_dashboard_sample_brush_cache_hit_miss    (GimpDashboard       *dashboard,
+                                                                 Variable             variable);
 #ifdef HAVE_CPU_GROUP
 static void       gimp_dashboard_sample_cpu_usage               (GimpDashboard       *dashboard,
                                                                  Variable             variable);
@@ -764,6 +770,33 @@ static const VariableInfo variables[] =
     .type             = VARIABLE_TYPE_SIZE,
     .sample_func      = gimp_dashboard_sample_function,
     .data             = gimp_temp_buf_get_total_memsize
+  },
+
+  [VARIABLE_BRUSH_CACHE_TOTAL] =
+  { .name             = "brush-cache-total",
+    .title            = NC_("dashboard-variable", "Brush cache"),
+    .description      = N_("Total size of cached brush transformations"),
+    .type             = VARIABLE_TYPE_SIZE,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_brush_cache_get_total_memsize
+  },
+
+  [VARIABLE_BRUSH_CACHE_HIT_MISS] =
+  { .name             = "brush-cache-hit-miss",
+    .title            = NC_("dashboard-variable", "Brush hit/miss"),
+    .description      = N_("Brush cache hit/miss ratio"),
+    .type             = VARIABLE_TYPE_INT_RATIO,
+    .sample_func      = gimp_dashboard_sample_brush_cache_hit_miss
+  },
+
+  [VARIABLE_BRUSH_CACHE_EVICTED] =
+  { .name             = "brush-cache-evicted",
+    .title            = NC_("dashboard-variable", "Brush evicted"),
+    .description      = N_("Total size of brush transformations evicted "
+                           "from the brush cache"),
+    .type             = VARIABLE_TYPE_SIZE,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_brush_cache_get_total_evicted
   }
 };
 
@@ -981,6 +1014,15 @@ static const GroupInfo groups[] =
                           { .variable       = VARIABLE_TEMP_BUF_TOTAL,
                             .default_active = TRUE
                           },
+                          { .variable       = VARIABLE_BRUSH_CACHE_TOTAL,
+                            .default_active = TRUE
+                          },
+                          { .variable       = VARIABLE_BRUSH_CACHE_HIT_MISS,
+                            .default_active = TRUE
+                          },
+                          { .variable       = VARIABLE_BRUSH_CACHE_EVICTED,
+                            .default_active = FALSE
+                          },
 
                           {}
                         }
@@ -2017,6 +2059,7 @@ gimp_dashboard_sample_function (GimpDashboard *dashboard,
 
     case VARIABLE_TYPE_INTEGER:
       variable_data->value.integer = CALL_FUNC (gint);
+      break;
 
     case VARIABLE_TYPE_SIZE:
       variable_data->value.size = CALL_FUNC (guint64);
@@ -2213,6 +2256,19 @@ gimp_dashboard_sample_swap_limit (GimpDashboard *dashboard,
     }
 }
 
+static void
+gimp_dashboard_sample_brush_cache_hit_miss (GimpDashboard *dashboard,
+                                            Variable       variable)
+{
+  GimpDashboardPrivate *priv          = dashboard->priv;
+  VariableData         *variable_data = &priv->variables[variable];
+
+  gimp_brush_cache_get_hit_miss (&variable_data->value.int_ratio.antecedent,
+                                 &variable_data->value.int_ratio.consequent);
+
+  variable_data->available = TRUE;
+}
+
 #ifdef HAVE_CPU_GROUP
 
 #ifdef HAVE_SYS_TIMES_H
@@ -0,0 +1,258 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <cairo.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "xcf-private.h"
+#include "xcf-load.h"
+
+#include "gimptilehandlerxcf.h"
+
+
+static void     gimp_tile_handler_xcf_finalize (GObject                 *object);
+
+static void     gimp_tile_handler_xcf_validate (GimpTileHandlerValidate *validate,
+                                                const GeglRectangle     *rect,
+                                                const Babl              *format,
+                                                gpointer                 dest_buf,
+                                                gint                     dest_stride);
+
+static gpointer gimp_tile_handler_xcf_command  (GeglTileSource          *source,
+                                                GeglTileCommand          command,
+                                                gint                     x,
+                                                gint                     y,
+                                                gint                     z,
+                                                gpointer                 data);
+
+
+G_DEFINE_TYPE (GimpTileHandlerXcf, gimp_tile_handler_xcf,
+               GIMP_TYPE_TILE_HANDLER_VALIDATE)
+
+#define parent_class gimp_tile_handler_xcf_parent_class
+
+
+static void
+gimp_tile_handler_xcf_class_init (GimpTileHandlerXcfClass *klass)
+{
+  GObjectClass                 *object_class = G_OBJECT_CLASS (klass);
+  GimpTileHandlerValidateClass *validate_class;
+
+  validate_class = GIMP_TILE_HANDLER_VALIDATE_CLASS (klass);
+
+  object_class->finalize   = gimp_tile_handler_xcf_finalize;
+
+  validate_class->validate = gimp_tile_handler_xcf_validate;
+}
+
+static void
+gimp_tile_handler_xcf_init (GimpTileHandlerXcf *xcf)
+{
+  GeglTileSource *source = GEGL_TILE_SOURCE (xcf);
+
+  xcf->parent_command = source->command;
+  source->command     = gimp_tile_handler_xcf_command;
+}
+
+static void
+gimp_tile_handler_xcf_finalize (GObject *object)
+{
+  GimpTileHandlerXcf *xcf = GIMP_TILE_HANDLER_XCF (object);
+
+  g_clear_pointer (&xcf->mapped_file, g_mapped_file_unref);
+  g_clear_pointer (&xcf->offsets, g_free);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_tile_handler_xcf_validate (GimpTileHandlerValidate *validate,
+                                const GeglRectangle     *rect,
+                                const Babl              *format,
+                                gpointer                 dest_buf,
+                                gint                     dest_stride)
+{
+  GimpTileHandlerXcf *xcf  = GIMP_TILE_HANDLER_XCF (validate);
+  const guchar       *data;
+  gint                bpp;
+  guchar             *tile_data;
+  GeglRectangle       area;
+  gint                tile_x1, tile_y1;
+  gint                tile_x2, tile_y2;
+  gint                tile_x,  tile_y;
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+
+  if (! gegl_rectangle_intersect (&area,
+                                  rect,
+                                  GEGL_RECTANGLE (0, 0,
+                                                  xcf->width, xcf->height)) ||
+      ! xcf->mapped_file)
+    {
+      gint y;
+
+      for (y = 0; y < rect->height; y++)
+        {
+          memset ((guchar *) dest_buf + y * dest_stride,
+                  0, rect->width * bpp);
+        }
+
+      return;
+    }
+
+  data      = (const guchar *) g_mapped_file_get_contents (xcf->mapped_file);
+  tile_data = g_alloca (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp);
+
+  tile_x1 = area.x / XCF_TILE_WIDTH;
+  tile_y1 = area.y / XCF_TILE_HEIGHT;
+  tile_x2 = (area.x + area.width  - 1) / XCF_TILE_WIDTH;
+  tile_y2 = (area.y + area.height - 1) / XCF_TILE_HEIGHT;
+
+  for (tile_y = tile_y1; tile_y <= tile_y2; tile_y++)
+    {
+      for (tile_x = tile_x1; tile_x <= tile_x2; tile_x++)
+        {
+          GeglRectangle tile_rect;
+          GeglRectangle blit_rect;
+          gint          i;
+          gint          y;
+          gboolean      nonzero;
+
+          i = tile_y * xcf->n_tile_cols + tile_x;
+
+          tile_rect.x      = tile_x * XCF_TILE_WIDTH;
+          tile_rect.y      = tile_y * XCF_TILE_HEIGHT;
+          tile_rect.width  = MIN (XCF_TILE_WIDTH,  xcf->width  - tile_rect.x);
+          tile_rect.height = MIN (XCF_TILE_HEIGHT, xcf->height - tile_rect.y);
+
+          /*  a tile that fails to decode is left empty, like the tiles
+           *  the regular loader skips
+           */
+          if (! xcf_load_decode_tile (xcf->compression, xcf->file_version,
+                                      format,
+                                      data + xcf->offsets[i],
+                                      xcf->offsets[i + 1] - xcf->offsets[i],
+                                      tile_data,
+                                      tile_rect.width * tile_rect.height * bpp,
+                                      &nonzero))
+            {
+              nonzero = FALSE;
+            }
+
+          gegl_rectangle_intersect (&blit_rect, &tile_rect, &area);
+
+          for (y = blit_rect.y; y < blit_rect.y + blit_rect.height; y++)
+            {
+              guchar *dest = (guchar *) dest_buf        +
+                             (y - rect->y) * dest_stride +
+                             (blit_rect.x - rect->x) * bpp;
+
+              if (nonzero)
+                {
+                  memcpy (dest,
+                          tile_data +
+                          ((y - tile_rect.y) * tile_rect.width +
+                           (blit_rect.x - tile_rect.x)) * bpp,
+                          blit_rect.width * bpp);
+                }
+              else
+                {
+                  memset (dest, 0, blit_rect.width * bpp);
+                }
+            }
+        }
+    }
+}
+
+static gpointer
+gimp_tile_handler_xcf_command (GeglTileSource  *source,
+                               GeglTileCommand  command,
+                               gint             x,
+                               gint             y,
+                               gint             z,
+                               gpointer         data)
+{
+  GimpTileHandlerXcf      *xcf      = GIMP_TILE_HANDLER_XCF (source);
+  GimpTileHandlerValidate *validate = GIMP_TILE_HANDLER_VALIDATE (source);
+  gpointer                 retval;
+
+  /*  a tile that is voided or set is about to be overwritten as a whole,
+   *  make sure we don't decode the file's data on top of it later
+   */
+  if ((command == GEGL_TILE_VOID || command == GEGL_TILE_SET) && z == 0)
+    {
+      cairo_rectangle_int_t tile_rect;
+
+      tile_rect.x      = x * validate->tile_width;
+      tile_rect.y      = y * validate->tile_height;
+      tile_rect.width  = validate->tile_width;
+      tile_rect.height = validate->tile_height;
+
+      cairo_region_subtract_rectangle (validate->dirty_region, &tile_rect);
+    }
+
+  retval = xcf->parent_command (source, command, x, y, z, data);
+
+  /*  drop the file mapping as soon as all the tiles are decoded  */
+  if (xcf->mapped_file                                &&
+      ! validate->validating                          &&
+      cairo_region_is_empty (validate->dirty_region))
+    {
+      g_clear_pointer (&xcf->mapped_file, g_mapped_file_unref);
+    }
+
+  return retval;
+}
+
+
+/*  public functions  */
+
+GeglTileHandler *
+gimp_tile_handler_xcf_new (GMappedFile        *mapped_file,
+                           const goffset      *offsets,
+                           gint                n_tiles,
+                           XcfCompressionType  compression,
+                           gint                file_version,
+                           gint                width,
+                           gint                height)
+{
+  GimpTileHandlerXcf *xcf;
+
+  g_return_val_if_fail (mapped_file != NULL, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  xcf = g_object_new (GIMP_TYPE_TILE_HANDLER_XCF, NULL);
+
+  xcf->mapped_file  = g_mapped_file_ref (mapped_file);
+  xcf->offsets      = g_memdup (offsets, (n_tiles + 1) * sizeof (goffset));
+  xcf->compression  = compression;
+  xcf->file_version = file_version;
+  xcf->width        = width;
+  xcf->height       = height;
+  xcf->n_tile_cols  = (width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+
+  return GEGL_TILE_HANDLER (xcf);
+}
@@ -0,0 +1,73 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TILE_HANDLER_XCF_H__
+#define __GIMP_TILE_HANDLER_XCF_H__
+
+
+#include "gegl/gimptilehandlervalidate.h"
+
+
+/***
+ * GimpTileHandlerXcf is a GeglTileHandler that decodes the tiles of
+ * a level of a memory-mapped XCF file when they are first accessed.
+ */
+
+#define GIMP_TYPE_TILE_HANDLER_XCF            (gimp_tile_handler_xcf_get_type ())
+#define GIMP_TILE_HANDLER_XCF(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_TILE_HANDLER_XCF, GimpTileHandlerXcf))
+#define GIMP_TILE_HANDLER_XCF_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_TILE_HANDLER_XCF, GimpTileHandlerXcfClass))
+#define GIMP_IS_TILE_HANDLER_XCF(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_TILE_HANDLER_XCF))
+#define GIMP_IS_TILE_HANDLER_XCF_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_TILE_HANDLER_XCF))
+#define GIMP_TILE_HANDLER_XCF_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_TILE_HANDLER_XCF, GimpTileHandlerXcfClass))
+
+
+typedef struct _GimpTileHandlerXcf      GimpTileHandlerXcf;
+typedef struct _GimpTileHandlerXcfClass GimpTileHandlerXcfClass;
+
+struct _GimpTileHandlerXcf
+{
+  GimpTileHandlerValidate  parent_instance;
+
+  GeglTileSourceCommand    parent_command;
+
+  GMappedFile             *mapped_file;
+  goffset                 *offsets;
+  XcfCompressionType       compression;
+  gint                     file_version;
+  gint                     width;
+  gint                     height;
+  gint                     n_tile_cols;
+};
+
+struct _GimpTileHandlerXcfClass
+{
+  GimpTileHandlerValidateClass  parent_class;
+};
+
+
+GType             gimp_tile_handler_xcf_get_type (void) G_GNUC_CONST;
+
+GeglTileHandler * gimp_tile_handler_xcf_new      (GMappedFile        *mapped_file,
+                                                  const goffset      *offsets,
+                                                  gint                n_tiles,
+                                                  XcfCompressionType  compression,
+                                                  gint                file_version,
+                                                  gint                width,
+                                                  gint                height);
+
+
+#endif /* __GIMP_TILE_HANDLER_XCF_H__ */
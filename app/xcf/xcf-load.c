@@ -19,6 +19,9 @@
 
 #include <string.h>
 #include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include <cairo.h>
 #include <gegl.h>
@@ -71,6 +74,7 @@
 
 #include "xcf-private.h"
 #include "xcf-load.h"
+#include "gimptilehandlerxcf.h"
 #include "xcf-read.h"
 #include "xcf-seek.h"
 #include "xcf-utils.h"
@@ -117,20 +121,35 @@ static gboolean        xcf_load_buffer        (XcfInfo       *info,
                                                GeglBuffer    *buffer);
 static gboolean        xcf_load_level         (XcfInfo       *info,
                                                GeglBuffer    *buffer);
+static gboolean        xcf_load_level_lazy    (XcfInfo       *info,
+                                               GeglBuffer    *buffer,
+                                               goffset        offset,
+                                               goffset        max_data_length);
 static gboolean        xcf_load_tile          (XcfInfo       *info,
                                                GeglBuffer    *buffer,
                                                GeglRectangle *tile_rect,
                                                const Babl    *format);
-static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
-static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
+static gboolean        xcf_load_tile_compressed (XcfInfo       *info,
+                                                 GeglBuffer    *buffer,
+                                                 GeglRectangle *tile_rect,
+                                                 const Babl    *format,
+                                                 gint           data_length);
+static gboolean        xcf_load_decode_rle    (const guchar  *xcfdata,
+                                               gint           data_length,
+                                               guchar        *tile_data,
+                                               gint           tile_size,
+                                               gint           bpp,
+                                               gboolean      *nonzero);
+static gboolean        xcf_load_decode_zlib   (const guchar  *xcfdata,
+                                               gint           data_length,
+                                               guchar        *tile_data,
+                                               gint           tile_size);
+#ifdef HAVE_ZSTD
+static gboolean        xcf_load_decode_zstd   (const guchar  *xcfdata,
+                                               gint           data_length,
+                                               guchar        *tile_data,
+                                               gint           tile_size);
+#endif
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -721,6 +740,81 @@ xcf_load_image (Gimp     *gimp,
   return NULL;
 }
 
+/* Decodes the on-disk data of a single tile, stored with @compression,
+ * into @tile_data, in @format.  @nonzero is set to whether the tile
+ * has any non-zero pixels; empty tiles don't need to be stored.
+ */
+gboolean
+xcf_load_decode_tile (XcfCompressionType  compression,
+                      gint                file_version,
+                      const Babl         *format,
+                      const guchar       *xcfdata,
+                      gint                data_length,
+                      guchar             *tile_data,
+                      gint                tile_size,
+                      gboolean           *nonzero)
+{
+  gint     bpp = babl_format_get_bytes_per_pixel (format);
+  gboolean success;
+
+  *nonzero = FALSE;
+
+  if (data_length <= 0)
+    return TRUE;
+
+  switch (compression)
+    {
+    case COMPRESS_NONE:
+      success = data_length >= tile_size;
+
+      if (success)
+        {
+          memcpy (tile_data, xcfdata, tile_size);
+
+          *nonzero = ! xcf_data_is_zero (tile_data, tile_size);
+        }
+      break;
+
+    case COMPRESS_RLE:
+      success = xcf_load_decode_rle (xcfdata, data_length,
+                                     tile_data, tile_size, bpp,
+                                     nonzero);
+      break;
+
+    case COMPRESS_ZLIB:
+      success = xcf_load_decode_zlib (xcfdata, data_length,
+                                      tile_data, tile_size);
+
+      if (success)
+        *nonzero = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
+
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      success = xcf_load_decode_zstd (xcfdata, data_length,
+                                      tile_data, tile_size);
+
+      if (success)
+        *nonzero = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
+#endif
+
+    default:
+      success = FALSE;
+      break;
+    }
+
+  if (success && *nonzero && file_version >= 12)
+    {
+      gint n_components = babl_format_get_n_components (format);
+
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
+    }
+
+  return success;
+}
+
 static void
 xcf_load_add_masks (GimpImage *image)
 {
@@ -843,7 +937,8 @@ xcf_load_image_props (XcfInfo   *info,
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
                 (compression != COMPRESS_ZLIB) &&
-                (compression != COMPRESS_FRACTAL))
+                (compression != COMPRESS_FRACTAL) &&
+                (compression != COMPRESS_ZSTD))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
                               GIMP_MESSAGE_ERROR,
@@ -852,6 +947,18 @@ xcf_load_image_props (XcfInfo   *info,
                 return FALSE;
               }
 
+#ifndef HAVE_ZSTD
+            if (compression == COMPRESS_ZSTD)
+              {
+                gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                                      GIMP_MESSAGE_ERROR,
+                                      _("This XCF file uses zstd compression, "
+                                        "but GIMP was built without zstd "
+                                        "support."));
+                return FALSE;
+              }
+#endif
+
             info->compression = compression;
 
             gimp_image_set_xcf_compression (image,
@@ -2308,6 +2415,21 @@ xcf_load_level (XcfInfo    *info,
   if (offset == 0)
     return TRUE;
 
+  /* when loading from a memory-mapped file, only read the offset table
+   * and decode the tiles on demand.  if the table doesn't look right,
+   * go through the regular code path, which reports the error.
+   */
+  if (info->mapped_file)
+    {
+      saved_pos = info->cp;
+
+      if (xcf_load_level_lazy (info, buffer, offset, max_data_length))
+        return TRUE;
+
+      if (! xcf_seek_pos (info, saved_pos, NULL))
+        return FALSE;
+    }
+
   n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
@@ -2370,13 +2492,10 @@ xcf_load_level (XcfInfo    *info,
             fail = TRUE;
           break;
         case COMPRESS_RLE:
-          if (! xcf_load_tile_rle (info, buffer, &rect, format,
-                                   offset2 - offset))
-            fail = TRUE;
-          break;
         case COMPRESS_ZLIB:
-          if (! xcf_load_tile_zlib (info, buffer, &rect, format,
-                                    offset2 - offset))
+        case COMPRESS_ZSTD:
+          if (! xcf_load_tile_compressed (info, buffer, &rect, format,
+                                          offset2 - offset))
             fail = TRUE;
           break;
         case COMPRESS_FRACTAL:
@@ -2417,6 +2536,99 @@ xcf_load_level (XcfInfo    *info,
   return TRUE;
 }
 
+static gboolean
+xcf_load_level_lazy (XcfInfo    *info,
+                     GeglBuffer *buffer,
+                     goffset     offset,
+                     goffset     max_data_length)
+{
+  GeglTileHandler *handler;
+  goffset         *offsets;
+  goffset          file_size;
+  gint             width;
+  gint             height;
+  gint             ntiles;
+  gint             n;
+  gint             i;
+
+  switch (info->compression)
+    {
+    case COMPRESS_NONE:
+    case COMPRESS_RLE:
+    case COMPRESS_ZLIB:
+    case COMPRESS_ZSTD:
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  width     = gegl_buffer_get_width  (buffer);
+  height    = gegl_buffer_get_height (buffer);
+  file_size = g_mapped_file_get_length (info->mapped_file);
+
+  ntiles = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT) *
+           gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
+
+  /* read the offsets of the remaining tiles, followed by the terminating
+   * 0, which we replace by the end of the last tile's data, allowing for
+   * negative compression like xcf_load_level() does.
+   */
+  offsets    = g_new (goffset, ntiles + 1);
+  offsets[0] = offset;
+
+  for (i = 1; i <= ntiles; i += n)
+    {
+      n = MIN (ntiles + 1 - i, 1024);
+
+      if (xcf_read_offset (info, offsets + i, n) != n * info->bytes_per_offset)
+        {
+          g_free (offsets);
+          return FALSE;
+        }
+    }
+
+  if (offsets[ntiles] != 0)
+    {
+      g_free (offsets);
+      return FALSE;
+    }
+
+  offsets[ntiles] = MIN (offsets[ntiles - 1] + max_data_length, file_size);
+
+  for (i = 0; i < ntiles; i++)
+    {
+      if (offsets[i] <= 0                               ||
+          offsets[i + 1] < offsets[i]                   ||
+          offsets[i + 1] - offsets[i] > max_data_length ||
+          offsets[i + 1] > file_size)
+        {
+          g_free (offsets);
+          return FALSE;
+        }
+    }
+
+  handler = gimp_tile_handler_xcf_new (info->mapped_file,
+                                       offsets, ntiles,
+                                       info->compression,
+                                       info->file_version,
+                                       width, height);
+
+  g_free (offsets);
+
+  gimp_tile_handler_validate_assign (GIMP_TILE_HANDLER_VALIDATE (handler),
+                                     buffer);
+
+  gimp_tile_handler_validate_invalidate (GIMP_TILE_HANDLER_VALIDATE (handler),
+                                         GEGL_RECTANGLE (0, 0, width, height));
+
+  g_object_unref (handler);
+
+  GIMP_LOG (XCF, "deferred loading of %d tiles", ntiles);
+
+  return TRUE;
+}
+
 static gboolean
 xcf_load_tile (XcfInfo       *info,
                GeglBuffer    *buffer,
@@ -2447,23 +2659,19 @@ xcf_load_tile (XcfInfo       *info,
 
   return TRUE;
 }
-
 static gboolean
-xcf_load_tile_rle (XcfInfo       *info,
-                   GeglBuffer    *buffer,
-                   GeglRectangle *tile_rect,
-                   const Babl    *format,
-                   gint           data_length)
+xcf_load_tile_compressed (XcfInfo       *info,
+                          GeglBuffer    *buffer,
+                          GeglRectangle *tile_rect,
+                          const Babl    *format,
+                          gint           data_length)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  guchar  nonzero   = FALSE;
-  gsize   bytes_read;
-  gint    i;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
+  gint      bpp       = babl_format_get_bytes_per_pixel (format);
+  gint      tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar   *tile_data = g_alloca (tile_size);
+  gboolean  nonzero;
+  gsize     bytes_read;
+  guchar   *xcfdata;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
    * this tile (return TRUE without storing data) as if it did not
@@ -2474,7 +2682,7 @@ xcf_load_tile_rle (XcfInfo       *info,
   if (data_length <= 0)
     return TRUE;
 
-  xcfdata = xcfodata = g_alloca (data_length);
+  xcfdata = g_alloca (data_length);
 
   /* we have to read directly instead of xcf_read_* because we may be
    * reading past the end of the file here
@@ -2483,15 +2691,37 @@ xcf_load_tile_rle (XcfInfo       *info,
                            &bytes_read, NULL, NULL);
   info->cp += bytes_read;
 
-  if (bytes_read == 0)
-    return TRUE;
+  if (! xcf_load_decode_tile (info->compression, info->file_version, format,
+                              xcfdata, bytes_read,
+                              tile_data, tile_size,
+                              &nonzero))
+    return FALSE;
 
-  xcfdatalimit = &xcfodata[bytes_read - 1];
+  if (nonzero)
+    {
+      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+xcf_load_decode_rle (const guchar *xcfdata,
+                     gint          data_length,
+                     guchar       *tile_data,
+                     gint          tile_size,
+                     gint          bpp,
+                     gboolean     *nonzero)
+{
+  const guchar *xcfdatalimit = &xcfdata[data_length - 1];
+  guchar        any          = FALSE;
+  gint          i;
 
   for (i = 0; i < bpp; i++)
     {
       guchar *data  = tile_data + i;
-      gint    size  = tile_rect->width * tile_rect->height;
+      gint    size  = tile_size / bpp;
       gint    count = 0;
       guchar  val;
       gint    length;
@@ -2537,7 +2767,7 @@ xcf_load_tile_rle (XcfInfo       *info,
               while (length-- > 0)
                 {
                   *data = *xcfdata++;
-                  nonzero |= *data;
+                  any |= *data;
                   data += bpp;
                 }
             }
@@ -2569,7 +2799,7 @@ xcf_load_tile_rle (XcfInfo       *info,
                 }
 
               val = *xcfdata++;
-              nonzero |= val;
+              any |= val;
 
               for (j = 0; j < length; j++)
                 {
@@ -2580,19 +2810,7 @@ xcf_load_tile_rle (XcfInfo       *info,
         }
     }
 
-  if (nonzero)
-    {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
-
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
-
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
-    }
+  *nonzero = any != 0;
 
   return TRUE;
 
@@ -2601,41 +2819,14 @@ xcf_load_tile_rle (XcfInfo       *info,
 }
 
 static gboolean
-xcf_load_tile_zlib (XcfInfo       *info,
-                    GeglBuffer    *buffer,
-                    GeglRectangle *tile_rect,
-                    const Babl    *format,
-                    gint           data_length)
+xcf_load_decode_zlib (const guchar *xcfdata,
+                      gint          data_length,
+                      guchar       *tile_data,
+                      gint          tile_size)
 {
   z_stream  strm;
   int       action;
   int       status;
-  gint      bpp       = babl_format_get_bytes_per_pixel (format);
-  gint      tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar   *tile_data = g_alloca (tile_size);
-  gsize     bytes_read;
-  guchar   *xcfdata;
-
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
-   */
-  if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = g_alloca (data_length);
-
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &bytes_read, NULL, NULL);
-  info->cp += bytes_read;
-
-  if (bytes_read == 0)
-    return TRUE;
 
   strm.next_out  = tile_data;
   strm.avail_out = tile_size;
@@ -2643,8 +2834,8 @@ xcf_load_tile_zlib (XcfInfo       *info,
   strm.zalloc    = Z_NULL;
   strm.zfree     = Z_NULL;
   strm.opaque    = Z_NULL;
-  strm.next_in   = xcfdata;
-  strm.avail_in  = bytes_read;
+  strm.next_in   = (guchar *) xcfdata;
+  strm.avail_in  = data_length;
 
   /* Initialize the stream decompression. */
   status = inflateInit (&strm);
@@ -2681,24 +2872,50 @@ xcf_load_tile_zlib (XcfInfo       *info,
         }
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
-    {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
+  inflateEnd (&strm);
 
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
+  return TRUE;
+}
 
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
+#ifdef HAVE_ZSTD
+static gboolean
+xcf_load_decode_zstd (const guchar *xcfdata,
+                      gint          data_length,
+                      guchar       *tile_data,
+                      gint          tile_size)
+{
+  gsize len;
+
+  /* the tile data may be followed by unrelated data, when it's the last
+   * tile of the level, so decompress only the first frame.
+   */
+  len = ZSTD_findFrameCompressedSize (xcfdata, data_length);
+
+  if (ZSTD_isError (len))
+    {
+      g_printerr ("xcf: tile decompression failed: %s",
+                  ZSTD_getErrorName (len));
+      return FALSE;
     }
 
-  inflateEnd (&strm);
+  len = ZSTD_decompress (tile_data, tile_size, xcfdata, len);
+
+  if (ZSTD_isError (len))
+    {
+      g_printerr ("xcf: tile decompression failed: %s",
+                  ZSTD_getErrorName (len));
+      return FALSE;
+    }
+  else if (len != tile_size)
+    {
+      g_printerr ("xcf: decompressed tile size doesn't match the "
+                  "expected size.");
+      return FALSE;
+    }
 
   return TRUE;
 }
+#endif
 
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
@@ -19,9 +19,18 @@
 #define __XCF_LOAD_H__
 
 
-GimpImage * xcf_load_image (Gimp     *gimp,
-                            XcfInfo  *info,
-                            GError  **error);
+GimpImage * xcf_load_image       (Gimp                *gimp,
+                                  XcfInfo             *info,
+                                  GError             **error);
+
+gboolean    xcf_load_decode_tile (XcfCompressionType   compression,
+                                  gint                 file_version,
+                                  const Babl          *format,
+                                  const guchar        *xcfdata,
+                                  gint                 data_length,
+                                  guchar              *tile_data,
+                                  gint                 tile_size,
+                                  gboolean            *nonzero);
 
 
 #endif  /* __XCF_LOAD_H__ */
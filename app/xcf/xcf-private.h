@@ -71,8 +71,9 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
-  COMPRESS_FRACTAL           =  3   /* unused */
+  COMPRESS_ZLIB              =  2,
+  COMPRESS_FRACTAL           =  3,  /* unused */
+  COMPRESS_ZSTD              =  4
 } XcfCompressionType;
 
 typedef enum
@@ -99,6 +100,7 @@ struct _XcfInfo
   Gimp               *gimp;
   GimpProgress       *progress;
   GInputStream       *input;
+  GMappedFile        *mapped_file;
   GOutputStream      *output;
   GSeekable          *seekable;
   goffset             cp;
@@ -19,6 +19,9 @@
 
 #include <string.h>
 #include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include <cairo.h>
 #include <gegl.h>
@@ -33,6 +36,8 @@
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimpasync.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpchannel.h"
 #include "core/gimpdrawable.h"
@@ -52,6 +57,7 @@
 #include "core/gimpprogress.h"
 #include "core/gimpsamplepoint.h"
 #include "core/gimpsymmetry.h"
+#include "core/gimpwaitable.h"
 
 #include "operations/layer-modes/gimp-layer-modes.h"
 
@@ -73,6 +79,37 @@
 #include "gimp-intl.h"
 
 
+/* the number of tiles per thread in each batch of the tile pipeline */
+#define XCF_SAVE_TILES_PER_THREAD 16
+
+/* the zstd compression level.  compared to zlib's default level, it
+ * yields a similar compression ratio, and is faster to both compress and
+ * decompress.
+ */
+#define XCF_SAVE_ZSTD_LEVEL       6
+
+
+typedef struct
+{
+  GeglRectangle  rect;
+  guchar        *data;
+  gint           data_length;
+  gboolean       success;
+} XcfSaveTile;
+
+typedef struct
+{
+  XcfInfo       *info;
+  GeglBuffer    *buffer;
+  const Babl    *format;
+  gint           max_data_length;
+
+  XcfSaveTile   *tiles;
+  gint           first_tile;
+  gint           n_tiles;
+} XcfSaveBatch;
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -103,22 +140,48 @@ static gboolean xcf_save_buffer        (XcfInfo           *info,
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GError           **error);
+static gboolean xcf_save_level_batch   (XcfInfo           *info,
+                                        XcfSaveBatch      *batch,
+                                        goffset           *offset_table,
+                                        goffset           *offset,
+                                        GError           **error);
+static void     xcf_save_encode_batch  (XcfSaveBatch      *batch);
+static void     xcf_save_encode_tiles  (gint               i,
+                                        gint               n,
+                                        XcfSaveBatch      *batch);
+static void     xcf_save_encode_async  (GimpAsync         *async,
+                                        XcfSaveBatch      *batch);
 static gboolean xcf_save_tile          (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GeglRectangle     *tile_rect,
                                         const Babl        *format,
-                                        GError           **error);
+                                        guchar            *data,
+                                        gint               max_data_length,
+                                        gint              *data_length);
 static gboolean xcf_save_tile_rle      (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GeglRectangle     *tile_rect,
                                         const Babl        *format,
                                         guchar            *rlebuf,
-                                        GError           **error);
+                                        gint               max_data_length,
+                                        gint              *data_length);
 static gboolean xcf_save_tile_zlib     (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GeglRectangle     *tile_rect,
                                         const Babl        *format,
-                                        GError           **error);
+                                        guchar            *data,
+                                        gint               max_data_length,
+                                        gint              *data_length);
+#ifdef HAVE_ZSTD
+static gboolean xcf_save_tile_zstd     (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        GeglRectangle     *tile_rect,
+                                        const Babl        *format,
+                                        ZSTD_CCtx         *cctx,
+                                        guchar            *data,
+                                        gint               max_data_length,
+                                        gint              *data_length);
+#endif
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -1581,21 +1644,26 @@ xcf_save_level (XcfInfo     *info,
                 GeglBuffer  *buffer,
                 GError     **error)
 {
-  const Babl *format;
-  goffset    *offset_table;
-  goffset    *next_offset;
-  goffset     saved_pos;
-  goffset     offset;
-  goffset     max_data_length;
-  guint32     width;
-  guint32     height;
-  gint        bpp;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        i;
-  guchar     *rlebuf    = NULL;
-  GError     *tmp_error = NULL;
+  const Babl   *format;
+  goffset      *offset_table;
+  goffset       saved_pos;
+  goffset       offset;
+  goffset       max_data_length;
+  guint32       width;
+  guint32       height;
+  gint          bpp;
+  gint          n_tile_rows;
+  gint          n_tile_cols;
+  guint         ntiles;
+  gint          n_threads;
+  gint          batch_size;
+  XcfSaveBatch  batches[2];
+  XcfSaveBatch *batch;
+  XcfSaveBatch *next_batch;
+  gboolean      success = TRUE;
+  gint          i;
+  gint          j;
+  GError       *tmp_error = NULL;
 
   format = gegl_buffer_get_format (buffer);
 
@@ -1606,7 +1674,11 @@ xcf_save_level (XcfInfo     *info,
   xcf_write_int32_check_error (info, (guint32 *) &width,  1);
   xcf_write_int32_check_error (info, (guint32 *) &height, 1);
 
-  saved_pos = info->cp;
+  if (info->compression == COMPRESS_FRACTAL)
+    {
+      g_warning ("xcf: fractal compression unimplemented");
+      return FALSE;
+    }
 
   /* maximal allowable size of on-disk tile data.  make it somewhat bigger than
    * the uncompressed tile size, to allow for the possibility of negative
@@ -1615,12 +1687,6 @@ xcf_save_level (XcfInfo     *info,
   max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp *
                     XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
 
-  /* allocate a temporary buffer to store the rle data before it is
-   * written to disk
-   */
-  if (info->compression == COMPRESS_RLE)
-    rlebuf = g_alloca (max_data_length);
-
   n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
@@ -1632,7 +1698,6 @@ xcf_save_level (XcfInfo     *info,
    */
   offset_table = g_alloca ((ntiles + 1) * sizeof (goffset));
   memset (offset_table, 0, (ntiles + 1) * sizeof (goffset));
-  next_offset = offset_table;
 
   /* 'saved_pos' is the offset of the tile offset table  */
   saved_pos = info->cp;
@@ -1643,51 +1708,93 @@ xcf_save_level (XcfInfo     *info,
   /* 'offset' is where we will write the next tile */
   offset = info->cp;
 
-  for (i = 0; i < ntiles; i++)
+  /* the tiles are encoded in batches, on worker threads, while the previous
+   * batch is being written, in order, on this thread.  with a single
+   * thread, each batch holds a single tile, which is encoded and written
+   * in turn.  either way, the file contents are the same.
+   */
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  if (n_threads > 1)
+    batch_size = MIN (ntiles, n_threads * XCF_SAVE_TILES_PER_THREAD);
+  else
+    batch_size = 1;
+
+  batch_size = MAX (batch_size, 1);
+
+  for (i = 0; i < 2; i++)
     {
-      GeglRectangle rect;
+      batches[i].info            = info;
+      batches[i].buffer          = buffer;
+      batches[i].format          = format;
+      batches[i].max_data_length = max_data_length;
+      batches[i].tiles           = g_new0 (XcfSaveTile, batch_size);
+      batches[i].first_tile      = 0;
+      batches[i].n_tiles         = 0;
+
+      for (j = 0; j < batch_size; j++)
+        batches[i].tiles[j].data = g_malloc (max_data_length);
+    }
 
-      /* store the offset in the table and increment the next pointer */
-      *next_offset++ = offset;
+  batch      = &batches[0];
+  next_batch = &batches[1];
 
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+  batch->n_tiles = MIN (batch_size, ntiles);
 
-      /* write out the tile. */
-      switch (info->compression)
+  xcf_save_encode_batch (batch);
+
+  while (batch->n_tiles > 0)
+    {
+      GimpAsync *async = NULL;
+
+      next_batch->first_tile = batch->first_tile + batch->n_tiles;
+      next_batch->n_tiles    = MIN (batch_size,
+                                    ntiles - next_batch->first_tile);
+
+      if (next_batch->n_tiles > 0)
         {
-        case COMPRESS_NONE:
-          xcf_check_error (xcf_save_tile (info, buffer, &rect, format,
-                                          error));
-          break;
-        case COMPRESS_RLE:
-          xcf_check_error (xcf_save_tile_rle (info, buffer, &rect, format,
-                                              rlebuf, error));
-          break;
-        case COMPRESS_ZLIB:
-          xcf_check_error (xcf_save_tile_zlib (info, buffer, &rect, format,
-                                               error));
-          break;
-        case COMPRESS_FRACTAL:
-          g_warning ("xcf: fractal compression unimplemented");
-          return FALSE;
+          if (n_threads > 1)
+            {
+              async = gimp_parallel_run_async (
+                (GimpRunAsyncFunc) xcf_save_encode_async,
+                next_batch);
+            }
+          else
+            {
+              xcf_save_encode_batch (next_batch);
+            }
         }
 
-      /* make sure the on-disk tile data didn't end up being too big.
-       * xcf_load_level() would refuse to load the file if it did.
-       */
-      if (info->cp < offset || info->cp - offset > max_data_length)
+      success = xcf_save_level_batch (info, batch, offset_table, &offset,
+                                      error);
+
+      if (async)
         {
-          g_message ("xcf: invalid tile data length: %" G_GOFFSET_FORMAT,
-                     info->cp - offset);
-          return FALSE;
+          gimp_waitable_wait (GIMP_WAITABLE (async));
+
+          g_object_unref (async);
         }
 
-      /* the next tile's offset is after the tile we just wrote */
-      offset = info->cp;
+      if (! success)
+        break;
+
+      batch      = next_batch;
+      next_batch = (batch == &batches[0]) ? &batches[1] : &batches[0];
+    }
+
+  for (i = 0; i < 2; i++)
+    {
+      for (j = 0; j < batch_size; j++)
+        g_free (batches[i].tiles[j].data);
+
+      g_free (batches[i].tiles);
     }
 
+  if (! success)
+    return FALSE;
+
   /* seek back to the offset table and write it  */
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
   xcf_write_offset_check_error (info, offset_table, ntiles + 1);
@@ -1698,33 +1805,163 @@ xcf_save_level (XcfInfo     *info,
   return TRUE;
 }
 
+static gboolean
+xcf_save_level_batch (XcfInfo       *info,
+                      XcfSaveBatch  *batch,
+                      goffset       *offset_table,
+                      goffset       *offset,
+                      GError       **error)
+{
+  GError *tmp_error = NULL;
+  gint    i;
+
+  for (i = 0; i < batch->n_tiles; i++)
+    {
+      XcfSaveTile *tile = &batch->tiles[i];
+
+      /* store the offset in the table */
+      offset_table[batch->first_tile + i] = *offset;
+
+      if (! tile->success)
+        return FALSE;
+
+      /* make sure the on-disk tile data didn't end up being too big.
+       * xcf_load_level() would refuse to load the file if it did.
+       */
+      if (tile->data_length > batch->max_data_length)
+        {
+          g_message ("xcf: invalid tile data length: %d", tile->data_length);
+          return FALSE;
+        }
+
+      /* write out the tile. */
+      xcf_write_int8_check_error (info, tile->data, tile->data_length);
+
+      /* the next tile's offset is after the tile we just wrote */
+      *offset = info->cp;
+    }
+
+  return TRUE;
+}
+
+static void
+xcf_save_encode_batch (XcfSaveBatch *batch)
+{
+  gegl_parallel_distribute (
+    batch->n_tiles,
+    (GeglParallelDistributeFunc) xcf_save_encode_tiles,
+    batch);
+}
+
+static void
+xcf_save_encode_tiles (gint          i,
+                       gint          n,
+                       XcfSaveBatch *batch)
+{
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx *cctx = NULL;
+
+  /* use a single compression context for all the tiles encoded by this
+   * thread, to avoid reallocating it for each tile
+   */
+  if (batch->info->compression == COMPRESS_ZSTD)
+    cctx = ZSTD_createCCtx ();
+#endif
+
+  for (; i < batch->n_tiles; i += n)
+    {
+      XcfSaveTile *tile = &batch->tiles[i];
+
+      gimp_gegl_buffer_get_tile_rect (batch->buffer,
+                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                      batch->first_tile + i, &tile->rect);
+
+      switch (batch->info->compression)
+        {
+        case COMPRESS_NONE:
+          tile->success = xcf_save_tile (batch->info, batch->buffer,
+                                         &tile->rect, batch->format,
+                                         tile->data, batch->max_data_length,
+                                         &tile->data_length);
+          break;
+        case COMPRESS_RLE:
+          tile->success = xcf_save_tile_rle (batch->info, batch->buffer,
+                                             &tile->rect, batch->format,
+                                             tile->data,
+                                             batch->max_data_length,
+                                             &tile->data_length);
+          break;
+        case COMPRESS_ZLIB:
+          tile->success = xcf_save_tile_zlib (batch->info, batch->buffer,
+                                              &tile->rect, batch->format,
+                                              tile->data,
+                                              batch->max_data_length,
+                                              &tile->data_length);
+          break;
+        case COMPRESS_FRACTAL:
+          tile->success = FALSE;
+          break;
+        case COMPRESS_ZSTD:
+#ifdef HAVE_ZSTD
+          tile->success = xcf_save_tile_zstd (batch->info, batch->buffer,
+                                              &tile->rect, batch->format,
+                                              cctx,
+                                              tile->data,
+                                              batch->max_data_length,
+                                              &tile->data_length);
+#else
+          tile->success = FALSE;
+#endif
+          break;
+        }
+    }
+
+#ifdef HAVE_ZSTD
+  if (cctx)
+    ZSTD_freeCCtx (cctx);
+#endif
+}
+
+static void
+xcf_save_encode_async (GimpAsync    *async,
+                       XcfSaveBatch *batch)
+{
+  xcf_save_encode_batch (batch);
+
+  gimp_async_finish (async, NULL);
+}
+
+/* the tile encoders below only read from @info, and may be called from
+ * multiple threads at once.  each of them stores the on-disk tile data in
+ * @data, which is @max_data_length bytes long, and its length in
+ * @data_length, which may exceed @max_data_length if the tile doesn't fit.
+ */
+
 static gboolean
 xcf_save_tile (XcfInfo        *info,
                GeglBuffer     *buffer,
                GeglRectangle  *tile_rect,
                const Babl     *format,
-               GError        **error)
+               guchar         *data,
+               gint            max_data_length,
+               gint           *data_length)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  GError *tmp_error = NULL;
+  gint bpp       = babl_format_get_bytes_per_pixel (format);
+  gint tile_size = bpp * tile_rect->width * tile_rect->height;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
+  gegl_buffer_get (buffer, tile_rect, 1.0, format, data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  if (info->file_version <= 11)
-    {
-      xcf_write_int8_check_error (info, tile_data, tile_size);
-    }
-  else
+  if (info->file_version >= 12)
     {
       gint n_components = babl_format_get_n_components (format);
 
-      xcf_write_component_check_error (info, bpp / n_components, tile_data,
-                                       tile_size / bpp * n_components);
+      xcf_write_to_be (bpp / n_components, data,
+                       tile_size / bpp * n_components);
     }
 
+  *data_length = tile_size;
+
   return TRUE;
 }
 
@@ -1734,14 +1971,14 @@ xcf_save_tile_rle (XcfInfo        *info,
                    GeglRectangle  *tile_rect,
                    const Babl     *format,
                    guchar         *rlebuf,
-                   GError        **error)
+                   gint            max_data_length,
+                   gint           *data_length)
 {
   gint    bpp       = babl_format_get_bytes_per_pixel (format);
   gint    tile_size = bpp * tile_rect->width * tile_rect->height;
   guchar *tile_data = g_alloca (tile_size);
   gint    len       = 0;
   gint    i, j;
-  GError *tmp_error  = NULL;
 
   gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
@@ -1857,7 +2094,7 @@ xcf_save_tile_rle (XcfInfo        *info,
         g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
+  *data_length = len;
 
   return TRUE;
 }
@@ -1867,14 +2104,16 @@ xcf_save_tile_zlib (XcfInfo        *info,
                     GeglBuffer     *buffer,
                     GeglRectangle  *tile_rect,
                     const Babl     *format,
-                    GError        **error)
+                    guchar         *data,
+                    gint            max_data_length,
+                    gint           *data_length)
 {
   gint      bpp       = babl_format_get_bytes_per_pixel (format);
   gint      tile_size = bpp * tile_rect->width * tile_rect->height;
   guchar   *tile_data = g_alloca (tile_size);
   /* The buffer for compressed data. */
   guchar   *buf       = g_alloca (tile_size);
-  GError   *tmp_error = NULL;
+  gint      len       = 0;
   z_stream  strm;
   int       action;
   int       status;
@@ -1920,7 +2159,13 @@ xcf_save_tile_zlib (XcfInfo        *info,
         {
           size_t write_size = tile_size - strm.avail_out;
 
-          xcf_write_int8_check_error (info, buf, write_size);
+          /* only copy what fits, but keep counting, so that the caller can
+           * report the actual length
+           */
+          if (len + (gint) write_size <= max_data_length)
+            memcpy (data + len, buf, write_size);
+
+          len += write_size;
 
           /* Reset next_out and avail_out. */
           strm.next_out  = buf;
@@ -1935,8 +2180,62 @@ xcf_save_tile_zlib (XcfInfo        *info,
     }
 
   deflateEnd (&strm);
+
+  *data_length = len;
+
+  return TRUE;
+}
+
+#ifdef HAVE_ZSTD
+static gboolean
+xcf_save_tile_zstd (XcfInfo        *info,
+                    GeglBuffer     *buffer,
+                    GeglRectangle  *tile_rect,
+                    const Babl     *format,
+                    ZSTD_CCtx      *cctx,
+                    guchar         *data,
+                    gint            max_data_length,
+                    gint           *data_length)
+{
+  gint    bpp       = babl_format_get_bytes_per_pixel (format);
+  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar *tile_data = g_alloca (tile_size);
+  gsize   len;
+
+  if (! cctx)
+    return FALSE;
+
+  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  if (info->file_version >= 12)
+    {
+      gint n_components = babl_format_get_n_components (format);
+
+      xcf_write_to_be (bpp / n_components, tile_data,
+                       tile_size / bpp * n_components);
+    }
+
+  /* max_data_length is always bigger than ZSTD_compressBound (tile_size),
+   * so compression can't fail for lack of space.
+   */
+  len = ZSTD_compressCCtx (cctx,
+                           data, max_data_length,
+                           tile_data, tile_size,
+                           XCF_SAVE_ZSTD_LEVEL);
+
+  if (ZSTD_isError (len))
+    {
+      g_printerr ("xcf: tile compression failed: %s",
+                  ZSTD_getErrorName (len));
+      return FALSE;
+    }
+
+  *data_length = len;
+
   return TRUE;
 }
+#endif
 
 static gboolean
 xcf_save_parasite (XcfInfo       *info,
@@ -29,6 +29,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpdrawable.h"
@@ -82,7 +84,8 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version 11 */
   xcf_load_image,   /* version 12 */
   xcf_load_image,   /* version 13 */
-  xcf_load_image    /* version 14 */
+  xcf_load_image,   /* version 14 */
+  xcf_load_image    /* version 15 */
 };
 
 
@@ -268,6 +271,36 @@ xcf_load_stream (Gimp          *gimp,
   info.file             = input_file;
   info.compression      = COMPRESS_NONE;
 
+  /* map local files into memory, so that the layers' tiles can be
+   * decoded when they are first needed, see xcf_load_level().
+   *
+   * reading a mapped page that is no longer backed by the file raises
+   * SIGBUS, so files on remote filesystems, which can be truncated or
+   * replaced behind our back at any time, are read as usual.  GIMP
+   * itself normally saves by writing a new file and renaming it over
+   * the old one, which leaves the mapped file intact.
+   */
+  if (input_file && gimp->config->xcf_lazy_loading)
+    {
+      GFileInfo *fs_info;
+      gchar     *path;
+
+      fs_info = g_file_query_filesystem_info (input_file,
+                                              G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+                                              NULL, NULL);
+      path    = g_file_get_path (input_file);
+
+      if (path && fs_info &&
+          ! g_file_info_get_attribute_boolean (fs_info,
+                                               G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE))
+        {
+          info.mapped_file = g_mapped_file_new (path, FALSE, NULL);
+        }
+
+      g_clear_object (&fs_info);
+      g_free (path);
+    }
+
   if (progress)
     gimp_progress_start (progress, FALSE, _("Opening '%s'"), filename);
 
@@ -317,6 +350,8 @@ xcf_load_stream (Gimp          *gimp,
         }
     }
 
+  g_clear_pointer (&info.mapped_file, g_mapped_file_unref);
+
   if (progress)
     gimp_progress_end (progress);
 
@@ -356,14 +391,16 @@ xcf_save_stream (Gimp           *gimp,
   info.progress         = progress;
   info.file             = output_file;
 
-  if (gimp_image_get_xcf_compression (image))
-    info.compression = COMPRESS_ZLIB;
-  else
+  if (! gimp_image_get_xcf_compression (image))
     info.compression = COMPRESS_RLE;
+  else if (gimp_image_get_xcf_zstd_compression (image))
+    info.compression = COMPRESS_ZSTD;
+  else
+    info.compression = COMPRESS_ZLIB;
 
   info.file_version = gimp_image_get_xcf_version (image,
-                                                  info.compression ==
-                                                  COMPRESS_ZLIB,
+                                                  info.compression !=
+                                                  COMPRESS_RLE,
                                                   NULL, NULL, NULL);
 
   if (info.file_version >= 11)
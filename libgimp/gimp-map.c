@@ -0,0 +1,319 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimp-map.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_MEMFD_CREATE
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#endif
+
+#include "gimp.h"
+
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpbase/gimpwire.h"
+
+#include "gimp-map.h"
+#include "gimpplugin-private.h"
+#include "gimptilebackendplugin.h"
+
+
+/*  The core exports a drawable's pixels in an anonymous memory file,
+ *  whose file descriptor it passes to us over the wire, and which we
+ *  map. Mapped drawables are private copy-on-write snapshots, mapped
+ *  shadow buffers are shared with the core, which copies the changed
+ *  area into the shadow tiles whenever the mapping is synced.
+ */
+
+typedef struct _GimpMap GimpMap;
+
+struct _GimpMap
+{
+  gint32         drawable_id;
+  gboolean       shadow;
+  gint           fd;    /* the core's file descriptor of the mapping */
+  guchar        *addr;
+  gsize          size;
+  GeglRectangle  dirty; /* the area changed since the last sync      */
+};
+
+
+#ifdef HAVE_MEMFD_CREATE
+
+static gint   gimp_map_receive_fd     (GIOChannel          *channel);
+static void   gimp_map_send           (GimpMap             *map,
+                                       gboolean             unmap);
+static void   gimp_map_destroy        (GimpMap             *map);
+static void   gimp_map_buffer_changed (GeglBuffer          *buffer,
+                                       const GeglRectangle *rect,
+                                       GimpMap             *map);
+
+
+static GRecMutex  map_mutex;
+static GList     *maps = NULL;
+
+#endif /* HAVE_MEMFD_CREATE */
+
+
+GeglBuffer *
+_gimp_map_drawable (GimpDrawable *drawable,
+                    gboolean      shadow)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GimpPlugIn      *plug_in = gimp_get_plug_in ();
+  GPDrawableMap    drawable_map;
+  GPDrawableMap   *map_info;
+  GimpWireMessage  msg;
+  GimpMap         *map;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  guchar          *addr = MAP_FAILED;
+  gsize            size;
+  gint             fd;
+
+  format = gimp_drawable_get_format (drawable);
+
+  /*  make sure the snapshot includes all the tiles we wrote  */
+  _gimp_tile_backend_plugin_sync ();
+
+  drawable_map.drawable_id = gimp_item_get_id (GIMP_ITEM (drawable));
+  drawable_map.shadow      = shadow;
+  drawable_map.fd          = -1;
+  drawable_map.width       = 0;
+  drawable_map.height      = 0;
+  drawable_map.bpp         = 0;
+
+  if (! gp_drawable_map_write (_gimp_plug_in_get_write_channel (plug_in),
+                               &drawable_map, plug_in))
+    gimp_quit ();
+
+  _gimp_plug_in_read_expect_msg (plug_in, &msg, GP_DRAWABLE_MAP);
+
+  map_info = msg.data;
+
+  if (map_info->fd == -1)
+    {
+      gimp_wire_destroy (&msg);
+
+      return NULL;
+    }
+
+  map = g_slice_new0 (GimpMap);
+
+  map->drawable_id = map_info->drawable_id;
+  map->shadow      = shadow;
+  map->fd          = map_info->fd;
+  map->size        = ((gsize) map_info->width * map_info->height *
+                      map_info->bpp);
+
+  size = map->size;
+
+  /*  the core passes its file descriptor right after the reply  */
+  fd = gimp_map_receive_fd (_gimp_plug_in_get_read_channel (plug_in));
+
+  if (fd != -1 &&
+      map_info->bpp == (guint) babl_format_get_bytes_per_pixel (format))
+    {
+      addr = mmap (NULL, size, PROT_READ | PROT_WRITE,
+                   shadow ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    }
+
+  if (fd != -1)
+    close (fd);
+
+  if (addr == MAP_FAILED)
+    {
+      /*  tell the core to drop the mapping, we use tiles instead  */
+      gimp_map_send (map, TRUE);
+
+      g_slice_free (GimpMap, map);
+      gimp_wire_destroy (&msg);
+
+      return NULL;
+    }
+
+  map->addr = addr;
+
+  buffer = gegl_buffer_linear_new_from_data (addr, format,
+                                             GEGL_RECTANGLE (0, 0,
+                                                             map_info->width,
+                                                             map_info->height),
+                                             map_info->width * map_info->bpp,
+                                             (GDestroyNotify) gimp_map_destroy,
+                                             map);
+
+  if (shadow)
+    {
+      gegl_buffer_signal_connect (buffer, "changed",
+                                  G_CALLBACK (gimp_map_buffer_changed),
+                                  map);
+    }
+
+  gimp_wire_destroy (&msg);
+
+  g_rec_mutex_lock (&map_mutex);
+
+  maps = g_list_prepend (maps, map);
+
+  g_rec_mutex_unlock (&map_mutex);
+
+  return buffer;
+#else
+  return NULL;
+#endif
+}
+
+/*  Sends the changes to all mapped shadow buffers to the core  */
+void
+_gimp_map_sync (void)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GList *list;
+
+  g_rec_mutex_lock (&map_mutex);
+
+  for (list = maps; list; list = g_list_next (list))
+    {
+      GimpMap *map = list->data;
+
+      if (! gegl_rectangle_is_empty (&map->dirty))
+        gimp_map_send (map, FALSE);
+    }
+
+  g_rec_mutex_unlock (&map_mutex);
+#endif
+}
+
+
+/*  private functions  */
+
+#ifdef HAVE_MEMFD_CREATE
+
+/*  receives a file descriptor sent along with a single byte, returns -1
+ *  if there is none
+ */
+static gint
+gimp_map_receive_fd (GIOChannel *channel)
+{
+  union
+  {
+    struct cmsghdr header;
+    gchar          buf[CMSG_SPACE (sizeof (gint))];
+  } control;
+  struct msghdr   msg;
+  struct cmsghdr *cmsg;
+  struct iovec    iov;
+  guchar          byte;
+  gssize          bytes;
+  gint            fd = -1;
+
+  memset (&msg,     0, sizeof (msg));
+  memset (&control, 0, sizeof (control));
+
+  iov.iov_base = &byte;
+  iov.iov_len  = 1;
+
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  do
+    bytes = recvmsg (g_io_channel_unix_get_fd (channel), &msg,
+                     MSG_CMSG_CLOEXEC);
+  while (bytes == -1 && errno == EINTR);
+
+  if (bytes != 1)
+    return -1;
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET &&
+          cmsg->cmsg_type  == SCM_RIGHTS &&
+          cmsg->cmsg_len   == CMSG_LEN (sizeof (gint)))
+        {
+          memcpy (&fd, CMSG_DATA (cmsg), sizeof (gint));
+        }
+    }
+
+  return fd;
+}
+
+static void
+gimp_map_send (GimpMap  *map,
+               gboolean  unmap)
+{
+  GimpPlugIn      *plug_in = gimp_get_plug_in ();
+  GPDrawableSync   drawable_sync;
+  GimpWireMessage  msg;
+
+  drawable_sync.drawable_id = map->drawable_id;
+  drawable_sync.shadow      = map->shadow;
+  drawable_sync.fd          = map->fd;
+  drawable_sync.x           = map->dirty.x;
+  drawable_sync.y           = map->dirty.y;
+  drawable_sync.width       = map->dirty.width;
+  drawable_sync.height      = map->dirty.height;
+  drawable_sync.unmap       = unmap;
+
+  map->dirty = *GEGL_RECTANGLE (0, 0, 0, 0);
+
+  if (! gp_drawable_sync_write (_gimp_plug_in_get_write_channel (plug_in),
+                                &drawable_sync, plug_in))
+    gimp_quit ();
+
+  _gimp_plug_in_read_expect_msg (plug_in, &msg, GP_TILE_ACK);
+
+  gimp_wire_destroy (&msg);
+}
+
+static void
+gimp_map_destroy (GimpMap *map)
+{
+  g_rec_mutex_lock (&map_mutex);
+
+  maps = g_list_remove (maps, map);
+
+  if (gimp_get_plug_in ())
+    gimp_map_send (map, TRUE);
+
+  g_rec_mutex_unlock (&map_mutex);
+
+  munmap (map->addr, map->size);
+
+  g_slice_free (GimpMap, map);
+}
+
+static void
+gimp_map_buffer_changed (GeglBuffer          *buffer,
+                         const GeglRectangle *rect,
+                         GimpMap             *map)
+{
+  g_rec_mutex_lock (&map_mutex);
+
+  gegl_rectangle_bounding_box (&map->dirty, &map->dirty, rect);
+
+  g_rec_mutex_unlock (&map_mutex);
+}
+
+#endif /* HAVE_MEMFD_CREATE */
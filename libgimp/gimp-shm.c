@@ -63,10 +63,15 @@
 #endif
 
 #include "gimp.h"
+
+#include "libgimpbase/gimpprotocol.h"
+
 #include "gimp-shm.h"
 
 
-#define TILE_MAP_SIZE     (gimp_tile_width () * gimp_tile_height () * 32)
+/*  large enough for a full batch of 4 bytes per pixel tiles  */
+#define TILE_MAP_SIZE     (gimp_tile_width () * gimp_tile_height () * \
+                           4 * GP_TILE_BATCH_MAX_TILES)
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
 
@@ -84,6 +89,12 @@ _gimp_shm_addr (void)
   return _shm_addr;
 }
 
+gsize
+_gimp_shm_size (void)
+{
+  return TILE_MAP_SIZE;
+}
+
 void
 _gimp_shm_open (gint shm_ID)
 {
@@ -25,6 +25,7 @@ G_BEGIN_DECLS
 
 
 guchar * _gimp_shm_addr  (void);
+gsize    _gimp_shm_size  (void);
 
 void     _gimp_shm_open  (gint shm_ID);
 void     _gimp_shm_close (void);
@@ -22,6 +22,7 @@
 
 #include "gimp.h"
 
+#include "gimp-map.h"
 #include "gimppixbuf.h"
 #include "gimptilebackendplugin.h"
 
@@ -327,6 +328,78 @@ gimp_drawable_get_shadow_buffer (GimpDrawable *drawable)
   return NULL;
 }
 
+/**
+ * gimp_drawable_map_buffer:
+ * @drawable: the ID of the #GimpDrawable to get the buffer for.
+ *
+ * Returns a #GeglBuffer of a snapshot of the specified drawable's
+ * pixels, which are mapped into the plug-in's memory when possible,
+ * so reading them doesn't transfer any tiles. This is meant for
+ * plug-ins which read large drawables, and should be preferred
+ * over gimp_drawable_get_buffer() only for reading.
+ *
+ * Changes to the returned buffer are not synced back with the
+ * drawable, unless mapping failed and the buffer is the one
+ * returned by gimp_drawable_get_buffer().
+ *
+ * Returns: (transfer full): The #GeglBuffer.
+ *
+ * See Also: gimp_drawable_map_shadow_buffer()
+ *
+ * Since: 3.0
+ */
+GeglBuffer *
+gimp_drawable_map_buffer (GimpDrawable *drawable)
+{
+  if (gimp_item_is_valid (GIMP_ITEM (drawable)))
+    {
+      GeglBuffer *buffer;
+
+      buffer = _gimp_map_drawable (drawable, FALSE);
+
+      if (! buffer)
+        buffer = gimp_drawable_get_buffer (drawable);
+
+      return buffer;
+    }
+
+  return NULL;
+}
+
+/**
+ * gimp_drawable_map_shadow_buffer:
+ * @drawable: the ID of the #GimpDrawable to get the buffer for.
+ *
+ * Like gimp_drawable_get_shadow_buffer(), but the drawable's shadow
+ * tiles are mapped into the plug-in's memory when possible. The area
+ * changed in the buffer is synced back with the core drawable's shadow
+ * tiles when the buffer gets destroyed, and before any procedure is
+ * run, so gimp_drawable_merge_shadow() sees all changes.
+ *
+ * Returns: (transfer full): The #GeglBuffer.
+ *
+ * See Also: gimp_drawable_map_buffer()
+ *
+ * Since: 3.0
+ */
+GeglBuffer *
+gimp_drawable_map_shadow_buffer (GimpDrawable *drawable)
+{
+  if (gimp_item_is_valid (GIMP_ITEM (drawable)))
+    {
+      GeglBuffer *buffer;
+
+      buffer = _gimp_map_drawable (drawable, TRUE);
+
+      if (! buffer)
+        buffer = gimp_drawable_get_shadow_buffer (drawable);
+
+      return buffer;
+    }
+
+  return NULL;
+}
+
 /**
  * gimp_drawable_get_format:
  * @drawable: the ID of the #GimpDrawable to get the format for.
@@ -74,6 +74,9 @@ GimpDrawable * gimp_drawable_get_by_id              (gint32        drawable_id);
 GeglBuffer   * gimp_drawable_get_buffer             (GimpDrawable  *drawable);
 GeglBuffer   * gimp_drawable_get_shadow_buffer      (GimpDrawable  *drawable);
 
+GeglBuffer   * gimp_drawable_map_buffer             (GimpDrawable  *drawable);
+GeglBuffer   * gimp_drawable_map_shadow_buffer      (GimpDrawable  *drawable);
+
 const Babl   * gimp_drawable_get_format             (GimpDrawable  *drawable);
 const Babl   * gimp_drawable_get_thumbnail_format   (GimpDrawable  *drawable);
 
@@ -25,12 +25,14 @@
 #include "libgimpbase/gimpprotocol.h"
 #include "libgimpbase/gimpwire.h"
 
+#include "gimp-map.h"
 #include "gimp-private.h"
 #include "gimpgpparams.h"
 #include "gimppdb-private.h"
 #include "gimppdb_pdb.h"
 #include "gimppdbprocedure.h"
 #include "gimpplugin-private.h"
+#include "gimptilebackendplugin.h"
 
 #include "libgimp-intl.h"
 
@@ -342,6 +344,10 @@ gimp_pdb_run_procedure_array (GimpPDB              *pdb,
   proc_run.n_params = gimp_value_array_length (arguments);
   proc_run.params   = _gimp_value_array_to_gp_params (arguments, FALSE);
 
+  /*  the procedure might access our drawables  */
+  _gimp_tile_backend_plugin_sync ();
+  _gimp_map_sync ();
+
   if (! gp_proc_run_write (_gimp_plug_in_get_write_channel (pdb->priv->plug_in),
                            &proc_run, pdb->priv->plug_in))
     gimp_quit ();
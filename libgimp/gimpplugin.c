@@ -29,12 +29,14 @@
 #include "libgimpbase/gimpprotocol.h"
 #include "libgimpbase/gimpwire.h"
 
+#include "gimp-map.h"
 #include "gimp-private.h"
 #include "gimp-shm.h"
 #include "gimpgpparams.h"
 #include "gimpplugin-private.h"
 #include "gimpplugin_pdb.h"
 #include "gimpprocedure-private.h"
+#include "gimptilebackendplugin.h"
 
 
 /**
@@ -1064,6 +1066,12 @@ gimp_plug_in_loop (GimpPlugIn *plug_in)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILE_BATCH_REQ:
+        case GP_TILE_BATCH_DATA:
+    case GP_DRAWABLE_MAP:
+    case GP_DRAWABLE_SYNC:
+        case GP_DRAWABLE_MAP:
+        case GP_DRAWABLE_SYNC:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
@@ -1126,6 +1134,8 @@ gimp_plug_in_process_message (GimpPlugIn      *plug_in,
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILE_BATCH_REQ:
+    case GP_TILE_BATCH_DATA:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
@@ -1166,6 +1176,9 @@ gimp_plug_in_proc_run (GimpPlugIn *plug_in,
       g_object_unref (procedure);
     }
 
+  _gimp_tile_backend_plugin_sync ();
+  _gimp_map_sync ();
+
   if (! gp_proc_return_write (plug_in->priv->write_channel,
                               &proc_return, plug_in))
     gimp_quit ();
@@ -1189,6 +1202,9 @@ gimp_plug_in_temp_proc_run (GimpPlugIn *plug_in,
                                       &proc_return);
     }
 
+  _gimp_tile_backend_plugin_sync ();
+  _gimp_map_sync ();
+
   if (! gp_temp_proc_return_write (plug_in->priv->write_channel,
                                    &proc_return, plug_in))
     gimp_quit ();
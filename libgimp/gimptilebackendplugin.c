@@ -46,48 +46,62 @@ struct _GimpTile
 
   guint   ewidth;   /* the effective width of the tile */
   guint   eheight;  /* the effective height of the tile */
-
-  guchar *data;     /* the pixel data for the tile */
 };
 
 
 struct _GimpTileBackendPluginPrivate
 {
-  gint32   drawable_id;
-  gboolean shadow;
-  gint     width;
-  gint     height;
-  gint     bpp;
-  gint     ntile_rows;
-  gint     ntile_cols;
+  gint32     drawable_id;
+  gboolean   shadow;
+  gint       width;
+  gint       height;
+  gint       bpp;
+  gint       ntile_rows;
+  gint       ntile_cols;
+
+  gint       last_tile_num;    /* the last tile read, to detect scans       */
+
+  GeglTile **read_ahead;       /* tiles fetched before they were requested  */
+  gint       read_ahead_first; /* the tile number of read_ahead[0]          */
+  gint       n_read_ahead;
+
+  guint32   *write_tile_nums;  /* tiles waiting to be sent to the core      */
+  guchar    *write_data;
+  gint       n_write_tiles;
+  gsize      write_length;
 };
 
 
-static gpointer   gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
-                                                    GeglTileCommand  command,
-                                                    gint             x,
-                                                    gint             y,
-                                                    gint             z,
-                                                    gpointer         data);
-
-static gboolean   gimp_tile_write (GimpTileBackendPlugin *backend_plugin,
-                                   gint                   x,
-                                   gint                   y,
-                                   GeglTile              *tile);
-static GeglTile * gimp_tile_read  (GimpTileBackendPlugin *backend_plugin,
-                                   gint                   x,
-                                   gint                   y);
-
-static gboolean   gimp_tile_init  (GimpTileBackendPlugin *backend_plugin,
-                                   GimpTile              *tile,
-                                   gint                   row,
-                                   gint                   col);
-static void       gimp_tile_unset (GimpTileBackendPlugin *backend_plugin,
-                                   GimpTile              *tile);
-static void       gimp_tile_get   (GimpTileBackendPlugin *backend_plugin,
-                                   GimpTile              *tile);
-static void       gimp_tile_put   (GimpTileBackendPlugin *backend_plugin,
-                                   GimpTile              *tile);
+static void       gimp_tile_backend_plugin_finalize (GObject         *object);
+
+static gpointer   gimp_tile_backend_plugin_command  (GeglTileSource  *tile_store,
+                                                     GeglTileCommand  command,
+                                                     gint             x,
+                                                     gint             y,
+                                                     gint             z,
+                                                     gpointer         data);
+
+static gboolean   gimp_tile_write           (GimpTileBackendPlugin *backend_plugin,
+                                             gint                   x,
+                                             gint                   y,
+                                             GeglTile              *tile);
+static GeglTile * gimp_tile_read            (GimpTileBackendPlugin *backend_plugin,
+                                             gint                   x,
+                                             gint                   y);
+
+static gboolean   gimp_tile_init            (GimpTileBackendPlugin *backend_plugin,
+                                             GimpTile              *tile,
+                                             gint                   row,
+                                             gint                   col);
+static gboolean   gimp_tile_is_written      (GimpTileBackendPlugin *backend_plugin,
+                                             guint                  tile_num);
+static GeglTile * gimp_tile_take_read_ahead (GimpTileBackendPlugin *backend_plugin,
+                                             guint                  tile_num);
+static void       gimp_tile_drop_read_ahead (GimpTileBackendPlugin *backend_plugin);
+static void       gimp_tile_get_batch       (GimpTileBackendPlugin *backend_plugin,
+                                             guint                  first_tile_num,
+                                             gint                   n_tiles);
+static void       gimp_tile_put_batch       (GimpTileBackendPlugin *backend_plugin);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpTileBackendPlugin, _gimp_tile_backend_plugin,
@@ -96,12 +110,16 @@ G_DEFINE_TYPE_WITH_PRIVATE (GimpTileBackendPlugin, _gimp_tile_backend_plugin,
 #define parent_class _gimp_tile_backend_plugin_parent_class
 
 
-static GMutex backend_plugin_mutex;
+static GRecMutex  backend_plugin_mutex;
+static GList     *backend_plugins = NULL;
 
 
 static void
 _gimp_tile_backend_plugin_class_init (GimpTileBackendPluginClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_tile_backend_plugin_finalize;
 }
 
 static void
@@ -111,7 +129,39 @@ _gimp_tile_backend_plugin_init (GimpTileBackendPlugin *backend)
 
   backend->priv = _gimp_tile_backend_plugin_get_instance_private (backend);
 
+  backend->priv->last_tile_num = -1;
+
   source->command = gimp_tile_backend_plugin_command;
+
+  g_rec_mutex_lock (&backend_plugin_mutex);
+
+  backend_plugins = g_list_prepend (backend_plugins, backend);
+
+  g_rec_mutex_unlock (&backend_plugin_mutex);
+}
+
+static void
+gimp_tile_backend_plugin_finalize (GObject *object)
+{
+  GimpTileBackendPlugin        *backend_plugin = GIMP_TILE_BACKEND_PLUGIN (object);
+  GimpTileBackendPluginPrivate *priv           = backend_plugin->priv;
+
+  g_rec_mutex_lock (&backend_plugin_mutex);
+
+  backend_plugins = g_list_remove (backend_plugins, backend_plugin);
+
+  if (gimp_get_plug_in ())
+    gimp_tile_put_batch (backend_plugin);
+
+  gimp_tile_drop_read_ahead (backend_plugin);
+
+  g_rec_mutex_unlock (&backend_plugin_mutex);
+
+  g_clear_pointer (&priv->read_ahead,      g_free);
+  g_clear_pointer (&priv->write_tile_nums, g_free);
+  g_clear_pointer (&priv->write_data,      g_free);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static gpointer
@@ -133,11 +183,11 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
        */
       if (z == 0)
         {
-          g_mutex_lock (&backend_plugin_mutex);
+          g_rec_mutex_lock (&backend_plugin_mutex);
 
           result = gimp_tile_read (backend_plugin, x, y);
 
-          g_mutex_unlock (&backend_plugin_mutex);
+          g_rec_mutex_unlock (&backend_plugin_mutex);
         }
       break;
 
@@ -145,17 +195,22 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
       /* TODO: actually store mipmapped tiles */
       if (z == 0)
         {
-          g_mutex_lock (&backend_plugin_mutex);
+          g_rec_mutex_lock (&backend_plugin_mutex);
 
           gimp_tile_write (backend_plugin, x, y, data);
 
-          g_mutex_unlock (&backend_plugin_mutex);
+          g_rec_mutex_unlock (&backend_plugin_mutex);
         }
 
       gegl_tile_mark_as_stored (data);
       break;
 
     case GEGL_TILE_FLUSH:
+      g_rec_mutex_lock (&backend_plugin_mutex);
+
+      gimp_tile_put_batch (backend_plugin);
+
+      g_rec_mutex_unlock (&backend_plugin_mutex);
       break;
 
     default:
@@ -202,6 +257,33 @@ _gimp_tile_backend_plugin_new (GimpDrawable *drawable,
   return backend;
 }
 
+/**
+ * _gimp_tile_backend_plugin_sync:
+ *
+ * Sends all tiles that are waiting to be written to the core, and
+ * drops all tiles that were read ahead, for all tile backends.
+ *
+ * This must be called before anything else can access the plug-in's
+ * drawables, which is whenever a procedure is run or returns.
+ */
+void
+_gimp_tile_backend_plugin_sync (void)
+{
+  GList *list;
+
+  g_rec_mutex_lock (&backend_plugin_mutex);
+
+  for (list = backend_plugins; list; list = g_list_next (list))
+    {
+      GimpTileBackendPlugin *backend_plugin = list->data;
+
+      gimp_tile_put_batch (backend_plugin);
+      gimp_tile_drop_read_ahead (backend_plugin);
+    }
+
+  g_rec_mutex_unlock (&backend_plugin_mutex);
+}
+
 
 /*  private functions  */
 
@@ -210,41 +292,35 @@ gimp_tile_read (GimpTileBackendPlugin *backend_plugin,
                 gint                   x,
                 gint                   y)
 {
-  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
-  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
+  GimpTileBackendPluginPrivate *priv      = backend_plugin->priv;
   GeglTile                     *tile;
   GimpTile                      gimp_tile = { 0, };
-  gint                          tile_size;
-  guchar                       *tile_data;
 
   if (! gimp_tile_init (backend_plugin, &gimp_tile, y, x))
     return NULL;
 
-  tile_size  = gegl_tile_backend_get_tile_size (backend);
-  tile       = gegl_tile_new (tile_size);
-  tile_data  = gegl_tile_get_data (tile);
+  tile = gimp_tile_take_read_ahead (backend_plugin, gimp_tile.tile_num);
 
-  gimp_tile_get (backend_plugin, &gimp_tile);
-
-  if (gimp_tile.ewidth * gimp_tile.eheight * priv->bpp == tile_size)
-    {
-      memcpy (tile_data, gimp_tile.data, tile_size);
-    }
-  else
+  if (! tile)
     {
-      gint tile_stride      = TILE_WIDTH * priv->bpp;
-      gint gimp_tile_stride = gimp_tile.ewidth * priv->bpp;
-      gint row;
+      gint n_tiles = 1;
 
-      for (row = 0; row < gimp_tile.eheight; row++)
-        {
-          memcpy (tile_data      + row * tile_stride,
-                  gimp_tile.data + row * gimp_tile_stride,
-                  gimp_tile_stride);
-        }
+      /*  a tile right after the previously read one is most likely
+       *  part of a linear scan, fetch the following tiles along with it
+       */
+      if ((gint) gimp_tile.tile_num == priv->last_tile_num + 1)
+        n_tiles = GP_TILE_BATCH_MAX_TILES;
+
+      /*  make sure the core has our version of the tile  */
+      if (gimp_tile_is_written (backend_plugin, gimp_tile.tile_num))
+        gimp_tile_put_batch (backend_plugin);
+
+      gimp_tile_get_batch (backend_plugin, gimp_tile.tile_num, n_tiles);
+
+      tile = gimp_tile_take_read_ahead (backend_plugin, gimp_tile.tile_num);
     }
 
-  gimp_tile_unset (backend_plugin, &gimp_tile);
+  priv->last_tile_num = gimp_tile.tile_num;
 
   return tile;
 }
@@ -258,22 +334,42 @@ gimp_tile_write (GimpTileBackendPlugin *backend_plugin,
   GimpTileBackendPluginPrivate *priv      = backend_plugin->priv;
   GeglTileBackend              *backend   = GEGL_TILE_BACKEND (backend_plugin);
   GimpTile                      gimp_tile = { 0, };
+  GeglTile                     *read_tile;
   gint                          tile_size;
+  gint                          gimp_tile_size;
   guchar                       *tile_data;
+  guchar                       *gimp_tile_data;
 
   if (! gimp_tile_init (backend_plugin, &gimp_tile, y, x))
     return FALSE;
 
-  tile_size = gegl_tile_backend_get_tile_size (backend);
-  tile_data = gegl_tile_get_data (tile);
+  /*  a tile read ahead is outdated now  */
+  read_tile = gimp_tile_take_read_ahead (backend_plugin, gimp_tile.tile_num);
 
-  gimp_tile.data = g_new (guchar,
-                          gimp_tile.ewidth * gimp_tile.eheight *
-                          priv->bpp);
+  if (read_tile)
+    gegl_tile_unref (read_tile);
+
+  tile_size      = gegl_tile_backend_get_tile_size (backend);
+  tile_data      = gegl_tile_get_data (tile);
+  gimp_tile_size = gimp_tile.ewidth * gimp_tile.eheight * priv->bpp;
+
+  if (priv->n_write_tiles == GP_TILE_BATCH_MAX_TILES ||
+      priv->write_length + gimp_tile_size > _gimp_shm_size ())
+    {
+      gimp_tile_put_batch (backend_plugin);
+    }
 
-  if (gimp_tile.ewidth * gimp_tile.eheight * priv->bpp == tile_size)
+  if (! priv->write_data)
     {
-      memcpy (gimp_tile.data, tile_data, tile_size);
+      priv->write_tile_nums = g_new (guint32, GP_TILE_BATCH_MAX_TILES);
+      priv->write_data      = g_new (guchar, _gimp_shm_size ());
+    }
+
+  gimp_tile_data = priv->write_data + priv->write_length;
+
+  if (gimp_tile_size == tile_size)
+    {
+      memcpy (gimp_tile_data, tile_data, tile_size);
     }
   else
     {
@@ -283,14 +379,14 @@ gimp_tile_write (GimpTileBackendPlugin *backend_plugin,
 
       for (row = 0; row < gimp_tile.eheight; row++)
         {
-          memcpy (gimp_tile.data + row * gimp_tile_stride,
+          memcpy (gimp_tile_data + row * gimp_tile_stride,
                   tile_data      + row * tile_stride,
                   gimp_tile_stride);
         }
     }
 
-  gimp_tile_put (backend_plugin, &gimp_tile);
-  gimp_tile_unset (backend_plugin, &gimp_tile);
+  priv->write_tile_nums[priv->n_write_tiles++] = gimp_tile.tile_num;
+  priv->write_length += gimp_tile_size;
 
   return TRUE;
 }
@@ -321,77 +417,174 @@ gimp_tile_init (GimpTileBackendPlugin *backend_plugin,
   else
     tile->eheight = TILE_HEIGHT;
 
-  tile->data = NULL;
-
   return TRUE;
 }
 
+static gboolean
+gimp_tile_is_written (GimpTileBackendPlugin *backend_plugin,
+                      guint                  tile_num)
+{
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  gint                          i;
+
+  for (i = 0; i < priv->n_write_tiles; i++)
+    {
+      if (priv->write_tile_nums[i] == tile_num)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static GeglTile *
+gimp_tile_take_read_ahead (GimpTileBackendPlugin *backend_plugin,
+                           guint                  tile_num)
+{
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  GeglTile                     *tile;
+  gint                          i;
+
+  i = (gint) tile_num - priv->read_ahead_first;
+
+  if (i < 0 || i >= priv->n_read_ahead)
+    return NULL;
+
+  tile = priv->read_ahead[i];
+  priv->read_ahead[i] = NULL;
+
+  return tile;
+}
+
 static void
-gimp_tile_unset (GimpTileBackendPlugin *backend_plugin,
-                 GimpTile              *tile)
+gimp_tile_drop_read_ahead (GimpTileBackendPlugin *backend_plugin)
 {
-  g_clear_pointer (&tile->data, g_free);
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  gint                          i;
+
+  for (i = 0; i < priv->n_read_ahead; i++)
+    {
+      if (priv->read_ahead[i])
+        gegl_tile_unref (priv->read_ahead[i]);
+    }
+
+  priv->n_read_ahead = 0;
 }
 
 static void
-gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
-               GimpTile              *tile)
+gimp_tile_get_batch (GimpTileBackendPlugin *backend_plugin,
+                     guint                  first_tile_num,
+                     gint                   n_tiles)
 {
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
+  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
   GimpPlugIn                   *plug_in = gimp_get_plug_in ();
-  GPTileReq                     tile_req;
-  GPTileData                   *tile_data;
+  GimpTile                      gimp_tiles[GP_TILE_BATCH_MAX_TILES];
+  guint32                       tile_nums[GP_TILE_BATCH_MAX_TILES];
+  GPTileBatchReq                batch_req;
+  GPTileBatchData              *batch_data;
   GimpWireMessage               msg;
+  const guchar                 *data;
+  gint                          tile_size;
+  gsize                         length = 0;
+  gint                          i;
 
-  tile_req.drawable_id = priv->drawable_id;
-  tile_req.tile_num    = tile->tile_num;
-  tile_req.shadow      = priv->shadow;
+  gimp_tile_drop_read_ahead (backend_plugin);
 
-  if (! gp_tile_req_write (_gimp_plug_in_get_write_channel (plug_in),
-                           &tile_req, plug_in))
+  n_tiles = MIN (n_tiles, GP_TILE_BATCH_MAX_TILES);
+  n_tiles = MIN (n_tiles,
+                 priv->ntile_rows * priv->ntile_cols - (gint) first_tile_num);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      guint tile_num = first_tile_num + i;
+      gsize gimp_tile_size;
+
+      /*  stop at tiles we still have to send ourselves  */
+      if (i > 0 && gimp_tile_is_written (backend_plugin, tile_num))
+        break;
+
+      gimp_tile_init (backend_plugin, &gimp_tiles[i],
+                      tile_num / priv->ntile_cols,
+                      tile_num % priv->ntile_cols);
+
+      gimp_tile_size = (gimp_tiles[i].ewidth * gimp_tiles[i].eheight *
+                        priv->bpp);
+
+      if (i > 0 && length + gimp_tile_size > _gimp_shm_size ())
+        break;
+
+      tile_nums[i]  = tile_num;
+      length       += gimp_tile_size;
+    }
+
+  n_tiles = i;
+
+  batch_req.drawable_id = priv->drawable_id;
+  batch_req.shadow      = priv->shadow;
+  batch_req.n_tiles     = n_tiles;
+  batch_req.tile_nums   = tile_nums;
+
+  if (! gp_tile_batch_req_write (_gimp_plug_in_get_write_channel (plug_in),
+                                 &batch_req, plug_in))
     gimp_quit ();
 
-  _gimp_plug_in_read_expect_msg (plug_in, &msg, GP_TILE_DATA);
+  _gimp_plug_in_read_expect_msg (plug_in, &msg, GP_TILE_BATCH_DATA);
 
-  tile_data = msg.data;
-  if (tile_data->drawable_id != priv->drawable_id ||
-      tile_data->tile_num    != tile->tile_num    ||
-      tile_data->shadow      != priv->shadow      ||
-      tile_data->width       != tile->ewidth      ||
-      tile_data->height      != tile->eheight     ||
-      tile_data->bpp         != priv->bpp)
+  batch_data = msg.data;
+  if (batch_data->drawable_id != priv->drawable_id ||
+      batch_data->shadow      != priv->shadow      ||
+      batch_data->bpp         != priv->bpp         ||
+      batch_data->n_tiles     != (guint) n_tiles   ||
+      batch_data->data_length != length            ||
+      memcmp (batch_data->tile_nums, tile_nums, n_tiles * sizeof (guint32)))
     {
-#if 0
-      g_printerr ("tile_data: %d %d %d %d %d %d\n"
-                  "tile:      %d %d %d %d %d %d\n",
-                  tile_data->drawable_id,
-                  tile_data->tile_num,
-                  tile_data->shadow,
-                  tile_data->width,
-                  tile_data->height,
-                  tile_data->bpp,
-                  priv->drawable_id,
-                  tile->tile_num,
-                  priv->shadow,
-                  tile->ewidth,
-                  tile->eheight,
-                  priv->bpp);
-#endif
       g_printerr ("received tile info did not match computed tile info");
       gimp_quit ();
     }
 
-  if (tile_data->use_shm)
-    {
-      tile->data = g_memdup (_gimp_shm_addr (),
-                             tile->ewidth * tile->eheight * priv->bpp);
-    }
+  if (batch_data->use_shm)
+    data = _gimp_shm_addr ();
   else
+    data = batch_data->data;
+
+  if (! priv->read_ahead)
+    priv->read_ahead = g_new (GeglTile *, GP_TILE_BATCH_MAX_TILES);
+
+  tile_size = gegl_tile_backend_get_tile_size (backend);
+
+  for (i = 0; i < n_tiles; i++)
     {
-      tile->data = tile_data->data;
-      tile_data->data = NULL;
+      GeglTile *tile           = gegl_tile_new (tile_size);
+      guchar   *tile_data      = gegl_tile_get_data (tile);
+      gint      gimp_tile_size = (gimp_tiles[i].ewidth *
+                                  gimp_tiles[i].eheight * priv->bpp);
+
+      if (gimp_tile_size == tile_size)
+        {
+          memcpy (tile_data, data, tile_size);
+        }
+      else
+        {
+          gint tile_stride      = TILE_WIDTH * priv->bpp;
+          gint gimp_tile_stride = gimp_tiles[i].ewidth * priv->bpp;
+          gint row;
+
+          for (row = 0; row < gimp_tiles[i].eheight; row++)
+            {
+              memcpy (tile_data + row * tile_stride,
+                      data      + row * gimp_tile_stride,
+                      gimp_tile_stride);
+            }
+        }
+
+      priv->read_ahead[i] = tile;
+
+      data += gimp_tile_size;
     }
 
+  priv->read_ahead_first = first_tile_num;
+  priv->n_read_ahead     = n_tiles;
+
   if (! gp_tile_ack_write (_gimp_plug_in_get_write_channel (plug_in),
                            plug_in))
     gimp_quit ();
@@ -400,16 +593,19 @@ gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
 }
 
 static void
-gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
-               GimpTile              *tile)
+gimp_tile_put_batch (GimpTileBackendPlugin *backend_plugin)
 {
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
   GimpPlugIn                   *plug_in = gimp_get_plug_in ();
   GPTileReq                     tile_req;
-  GPTileData                    tile_data;
+  GPTileBatchData               batch_data;
   GPTileData                   *tile_info;
   GimpWireMessage               msg;
 
+  if (priv->n_write_tiles == 0)
+    return;
+
+  /*  the request locks the core's shared memory for us  */
   tile_req.drawable_id = -1;
   tile_req.tile_num    = 0;
   tile_req.shadow      = 0;
@@ -422,32 +618,26 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
 
   tile_info = msg.data;
 
-  tile_data.drawable_id = priv->drawable_id;
-  tile_data.tile_num    = tile->tile_num;
-  tile_data.shadow      = priv->shadow;
-  tile_data.bpp         = priv->bpp;
-  tile_data.width       = tile->ewidth;
-  tile_data.height      = tile->eheight;
-  tile_data.use_shm     = tile_info->use_shm;
-  tile_data.data        = NULL;
+  batch_data.drawable_id = priv->drawable_id;
+  batch_data.shadow      = priv->shadow;
+  batch_data.bpp         = priv->bpp;
+  batch_data.n_tiles     = priv->n_write_tiles;
+  batch_data.tile_nums   = priv->write_tile_nums;
+  batch_data.use_shm     = tile_info->use_shm;
+  batch_data.data_length = priv->write_length;
+  batch_data.data        = NULL;
 
   if (tile_info->use_shm)
-    {
-      memcpy (_gimp_shm_addr (),
-              tile->data,
-              tile->ewidth * tile->eheight * priv->bpp);
-    }
+    memcpy (_gimp_shm_addr (), priv->write_data, priv->write_length);
   else
-    {
-      tile_data.data = tile->data;
-    }
+    batch_data.data = priv->write_data;
 
-  if (! gp_tile_data_write (_gimp_plug_in_get_write_channel (plug_in),
-                            &tile_data, plug_in))
-    gimp_quit ();
+  priv->n_write_tiles = 0;
+  priv->write_length  = 0;
 
-  if (! tile_info->use_shm)
-    tile_data.data = NULL;
+  if (! gp_tile_batch_data_write (_gimp_plug_in_get_write_channel (plug_in),
+                                  &batch_data, plug_in))
+    gimp_quit ();
 
   gimp_wire_destroy (&msg);
 
@@ -68,6 +68,38 @@ static void _gp_tile_data_write          (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_tile_data_destroy        (GimpWireMessage  *msg);
 
+static void _gp_tile_batch_req_read      (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_req_write     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_req_destroy   (GimpWireMessage  *msg);
+
+static void _gp_tile_batch_data_read     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_data_write    (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_data_destroy  (GimpWireMessage  *msg);
+
+static void _gp_drawable_map_read        (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_write       (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_destroy     (GimpWireMessage  *msg);
+
+static void _gp_drawable_sync_read       (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_sync_write      (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_sync_destroy    (GimpWireMessage  *msg);
+
 static void _gp_proc_run_read            (GIOChannel       *channel,
                                           GimpWireMessage  *msg,
                                           gpointer          user_data);
@@ -201,6 +233,22 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILE_BATCH_REQ,
+                      _gp_tile_batch_req_read,
+                      _gp_tile_batch_req_write,
+                      _gp_tile_batch_req_destroy);
+  gimp_wire_register (GP_TILE_BATCH_DATA,
+                      _gp_tile_batch_data_read,
+                      _gp_tile_batch_data_write,
+                      _gp_tile_batch_data_destroy);
+  gimp_wire_register (GP_DRAWABLE_MAP,
+                      _gp_drawable_map_read,
+                      _gp_drawable_map_write,
+                      _gp_drawable_map_destroy);
+  gimp_wire_register (GP_DRAWABLE_SYNC,
+                      _gp_drawable_sync_read,
+                      _gp_drawable_sync_write,
+                      _gp_drawable_sync_destroy);
 }
 
 /* public writing API */
@@ -298,6 +346,82 @@ gp_tile_data_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tile_batch_req_write (GIOChannel     *channel,
+                         GPTileBatchReq *batch_req,
+                         gpointer        user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_BATCH_REQ;
+  msg.data = batch_req;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tile_batch_data_write (GIOChannel      *channel,
+                          GPTileBatchData *batch_data,
+                          gpointer         user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_BATCH_DATA;
+  msg.data = batch_data;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_map_write (GIOChannel    *channel,
+                       GPDrawableMap *drawable_map,
+                       gpointer       user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_MAP;
+  msg.data = drawable_map;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_sync_write (GIOChannel     *channel,
+                        GPDrawableSync *drawable_sync,
+                        gpointer        user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_SYNC;
+  msg.data = drawable_sync;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 gboolean
 gp_proc_run_write (GIOChannel *channel,
                    GPProcRun  *proc_run,
@@ -877,6 +1001,358 @@ _gp_tile_data_destroy (GimpWireMessage *msg)
     }
 }
 
+/*  tile_batch_req  */
+
+static void
+_gp_tile_batch_req_read (GIOChannel      *channel,
+                         GimpWireMessage *msg,
+                         gpointer         user_data)
+{
+  GPTileBatchReq *batch_req = g_slice_new0 (GPTileBatchReq);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &batch_req->drawable_id, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_req->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_req->n_tiles, 1, user_data))
+    goto cleanup;
+
+  batch_req->tile_nums = g_new (guint32, batch_req->n_tiles);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               batch_req->tile_nums, batch_req->n_tiles,
+                               user_data))
+    goto cleanup;
+
+  msg->data = batch_req;
+  return;
+
+ cleanup:
+  g_free (batch_req->tile_nums);
+  g_slice_free (GPTileBatchReq, batch_req);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_batch_req_write (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPTileBatchReq *batch_req = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &batch_req->drawable_id, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_req->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_req->n_tiles, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                batch_req->tile_nums, batch_req->n_tiles,
+                                user_data))
+    return;
+}
+
+static void
+_gp_tile_batch_req_destroy (GimpWireMessage *msg)
+{
+  GPTileBatchReq *batch_req = msg->data;
+
+  if (batch_req)
+    {
+      g_free (batch_req->tile_nums);
+
+      g_slice_free (GPTileBatchReq, batch_req);
+    }
+}
+
+/*  tile_batch_data  */
+
+static void
+_gp_tile_batch_data_read (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPTileBatchData *batch_data = g_slice_new0 (GPTileBatchData);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &batch_data->drawable_id, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_data->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_data->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_data->n_tiles, 1, user_data))
+    goto cleanup;
+
+  batch_data->tile_nums = g_new (guint32, batch_data->n_tiles);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               batch_data->tile_nums, batch_data->n_tiles,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_data->use_shm, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &batch_data->data_length, 1, user_data))
+    goto cleanup;
+
+  if (! batch_data->use_shm)
+    {
+      batch_data->data = g_new (guchar, batch_data->data_length);
+
+      if (! _gimp_wire_read_int8 (channel,
+                                  (guint8 *) batch_data->data,
+                                  batch_data->data_length,
+                                  user_data))
+        goto cleanup;
+    }
+
+  msg->data = batch_data;
+  return;
+
+ cleanup:
+  g_free (batch_data->tile_nums);
+  g_free (batch_data->data);
+  g_slice_free (GPTileBatchData, batch_data);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_batch_data_write (GIOChannel      *channel,
+                           GimpWireMessage *msg,
+                           gpointer         user_data)
+{
+  GPTileBatchData *batch_data = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &batch_data->drawable_id, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_data->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_data->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_data->n_tiles, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                batch_data->tile_nums, batch_data->n_tiles,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_data->use_shm, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &batch_data->data_length, 1, user_data))
+    return;
+
+  if (! batch_data->use_shm)
+    {
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) batch_data->data,
+                                   batch_data->data_length,
+                                   user_data))
+        return;
+    }
+}
+
+static void
+_gp_tile_batch_data_destroy (GimpWireMessage *msg)
+{
+  GPTileBatchData *batch_data = msg->data;
+
+  if (batch_data)
+    {
+      g_free (batch_data->tile_nums);
+      g_free (batch_data->data);
+
+      g_slice_free (GPTileBatchData, batch_data);
+    }
+}
+
+/*  drawable_map  */
+
+static void
+_gp_drawable_map_read (GIOChannel      *channel,
+                       GimpWireMessage *msg,
+                       gpointer         user_data)
+{
+  GPDrawableMap *drawable_map = g_slice_new0 (GPDrawableMap);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->drawable_id, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->fd, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->bpp, 1, user_data))
+    goto cleanup;
+
+  msg->data = drawable_map;
+  return;
+
+ cleanup:
+  g_slice_free (GPDrawableMap, drawable_map);
+  msg->data = NULL;
+}
+
+static void
+_gp_drawable_map_write (GIOChannel      *channel,
+                        GimpWireMessage *msg,
+                        gpointer         user_data)
+{
+  GPDrawableMap *drawable_map = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->drawable_id, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->fd, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->bpp, 1, user_data))
+    return;
+}
+
+static void
+_gp_drawable_map_destroy (GimpWireMessage *msg)
+{
+  GPDrawableMap *drawable_map = msg->data;
+
+  if (drawable_map)
+    g_slice_free (GPDrawableMap, drawable_map);
+}
+
+/*  drawable_sync  */
+
+static void
+_gp_drawable_sync_read (GIOChannel      *channel,
+                        GimpWireMessage *msg,
+                        gpointer         user_data)
+{
+  GPDrawableSync *drawable_sync = g_slice_new0 (GPDrawableSync);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_sync->drawable_id, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_sync->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_sync->fd, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_sync->x, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_sync->y, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_sync->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_sync->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_sync->unmap, 1, user_data))
+    goto cleanup;
+
+  msg->data = drawable_sync;
+  return;
+
+ cleanup:
+  g_slice_free (GPDrawableSync, drawable_sync);
+  msg->data = NULL;
+}
+
+static void
+_gp_drawable_sync_write (GIOChannel      *channel,
+                         GimpWireMessage *msg,
+                         gpointer         user_data)
+{
+  GPDrawableSync *drawable_sync = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_sync->drawable_id, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_sync->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_sync->fd, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_sync->x, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_sync->y, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_sync->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_sync->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_sync->unmap, 1, user_data))
+    return;
+}
+
+static void
+_gp_drawable_sync_destroy (GimpWireMessage *msg)
+{
+  GPDrawableSync *drawable_sync = msg->data;
+
+  if (drawable_sync)
+    g_slice_free (GPDrawableSync, drawable_sync);
+}
+
 /*  proc_run  */
 
 static void
@@ -26,7 +26,13 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x010E
+#define GIMP_PROTOCOL_VERSION  0x0110
+
+
+/* The maximum number of tiles in a GP_TILE_BATCH_REQ or
+ * GP_TILE_BATCH_DATA message
+ */
+#define GP_TILE_BATCH_MAX_TILES  64
 
 
 enum
@@ -43,7 +49,11 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILE_BATCH_REQ,
+  GP_TILE_BATCH_DATA,
+  GP_DRAWABLE_MAP,
+  GP_DRAWABLE_SYNC
 };
 
 typedef enum
@@ -79,6 +89,10 @@ typedef struct _GPConfig           GPConfig;
 typedef struct _GPTileReq          GPTileReq;
 typedef struct _GPTileAck          GPTileAck;
 typedef struct _GPTileData         GPTileData;
+typedef struct _GPTileBatchReq     GPTileBatchReq;
+typedef struct _GPTileBatchData    GPTileBatchData;
+typedef struct _GPDrawableMap      GPDrawableMap;
+typedef struct _GPDrawableSync     GPDrawableSync;
 typedef struct _GPParamDef         GPParamDef;
 typedef struct _GPParamDefInt      GPParamDefInt;
 typedef struct _GPParamDefUnit     GPParamDefUnit;
@@ -146,6 +160,48 @@ struct _GPTileData
   guchar  *data;
 };
 
+struct _GPTileBatchReq
+{
+  gint32   drawable_id;
+  guint32  shadow;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+};
+
+struct _GPTileBatchData
+{
+  gint32   drawable_id;
+  guint32  shadow;
+  guint32  bpp;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+  guint32  use_shm;
+  guint32  data_length;
+  guchar  *data;
+};
+
+struct _GPDrawableMap
+{
+  gint32   drawable_id;
+  guint32  shadow;
+  gint32   fd;
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+};
+
+struct _GPDrawableSync
+{
+  gint32   drawable_id;
+  guint32  shadow;
+  gint32   fd;
+  gint32   x;
+  gint32   y;
+  guint32  width;
+  guint32  height;
+  guint32  unmap;
+};
+
 struct _GPParamDefInt
 {
   gint64 min_val;
@@ -305,6 +361,18 @@ gboolean  gp_tile_ack_write         (GIOChannel      *channel,
 gboolean  gp_tile_data_write        (GIOChannel      *channel,
                                      GPTileData      *tile_data,
                                      gpointer         user_data);
+gboolean  gp_tile_batch_req_write   (GIOChannel      *channel,
+                                     GPTileBatchReq  *batch_req,
+                                     gpointer         user_data);
+gboolean  gp_tile_batch_data_write  (GIOChannel      *channel,
+                                     GPTileBatchData *batch_data,
+                                     gpointer         user_data);
+gboolean  gp_drawable_map_write     (GIOChannel      *channel,
+                                     GPDrawableMap   *drawable_map,
+                                     gpointer         user_data);
+gboolean  gp_drawable_sync_write    (GIOChannel      *channel,
+                                     GPDrawableSync  *drawable_sync,
+                                     gpointer         user_data);
 gboolean  gp_proc_run_write         (GIOChannel      *channel,
                                      GPProcRun       *proc_run,
                                      gpointer         user_data);
@@ -0,0 +1,304 @@
+/* A small benchmark for the plug-in tile transfer protocol
+ *
+ * It runs both ends of the wire in one process, connected by pipes,
+ * and measures how many tiles per second get through, fetching them
+ * one at a time with GP_TILE_REQ, and in batches with GP_TILE_BATCH_REQ.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "gimpprotocol.h"
+#include "gimpwire.h"
+
+
+#define TILE_WIDTH    128
+#define TILE_HEIGHT   128
+#define TILE_BPP      4
+#define TILE_SIZE     (TILE_WIDTH * TILE_HEIGHT * TILE_BPP)
+#define SHM_SIZE      (TILE_SIZE * GP_TILE_BATCH_MAX_TILES)
+#define N_TILES       4096
+#define DRAWABLE_ID   1
+
+
+typedef struct
+{
+  GIOChannel *read;
+  GIOChannel *write;
+  guchar     *shm;
+  guchar     *pixels;
+  gboolean    use_shm;
+} WireEnd;
+
+
+static gboolean
+tile_wire_flush (GIOChannel *channel,
+                 gpointer    user_data)
+{
+  return g_io_channel_flush (channel, NULL) == G_IO_STATUS_NORMAL;
+}
+
+static GIOChannel *
+tile_wire_channel_new (gint fd)
+{
+  GIOChannel *channel = g_io_channel_unix_new (fd);
+
+  g_io_channel_set_encoding (channel, NULL, NULL);
+  g_io_channel_set_close_on_unref (channel, TRUE);
+
+  return channel;
+}
+
+static void
+tile_wire_expect (WireEnd         *end,
+                  GimpWireMessage *msg,
+                  guint32          type)
+{
+  if (! gimp_wire_read_msg (end->read, msg, end) || msg->type != type)
+    g_error ("expected message %d", type);
+}
+
+/*  the core end of the wire  */
+
+static gpointer
+tile_wire_core (gpointer data)
+{
+  WireEnd *core = data;
+
+  while (TRUE)
+    {
+      GimpWireMessage msg;
+
+      if (! gimp_wire_read_msg (core->read, &msg, core))
+        g_error ("core: read error");
+
+      if (msg.type == GP_QUIT)
+        {
+          gimp_wire_destroy (&msg);
+          break;
+        }
+      else if (msg.type == GP_TILE_REQ)
+        {
+          GPTileReq       *req = msg.data;
+          GPTileData       tile_data = { 0, };
+          GimpWireMessage  ack;
+
+          tile_data.drawable_id = req->drawable_id;
+          tile_data.tile_num    = req->tile_num;
+          tile_data.shadow      = req->shadow;
+          tile_data.bpp         = TILE_BPP;
+          tile_data.width       = TILE_WIDTH;
+          tile_data.height      = TILE_HEIGHT;
+          tile_data.use_shm     = core->use_shm;
+
+          if (core->use_shm)
+            memcpy (core->shm, core->pixels, TILE_SIZE);
+          else
+            tile_data.data = core->pixels;
+
+          if (! gp_tile_data_write (core->write, &tile_data, core))
+            g_error ("core: write error");
+
+          tile_wire_expect (core, &ack, GP_TILE_ACK);
+          gimp_wire_destroy (&ack);
+        }
+      else if (msg.type == GP_TILE_BATCH_REQ)
+        {
+          GPTileBatchReq  *req = msg.data;
+          GPTileBatchData  batch_data;
+          GimpWireMessage  ack;
+          guchar          *dest;
+          guint            i;
+
+          batch_data.drawable_id = req->drawable_id;
+          batch_data.shadow      = req->shadow;
+          batch_data.bpp         = TILE_BPP;
+          batch_data.n_tiles     = req->n_tiles;
+          batch_data.tile_nums   = req->tile_nums;
+          batch_data.use_shm     = core->use_shm;
+          batch_data.data_length = req->n_tiles * TILE_SIZE;
+          batch_data.data        = NULL;
+
+          if (core->use_shm)
+            dest = core->shm;
+          else
+            dest = batch_data.data = g_malloc (batch_data.data_length);
+
+          for (i = 0; i < req->n_tiles; i++)
+            memcpy (dest + i * TILE_SIZE, core->pixels, TILE_SIZE);
+
+          if (! gp_tile_batch_data_write (core->write, &batch_data, core))
+            g_error ("core: write error");
+
+          g_free (batch_data.data);
+
+          tile_wire_expect (core, &ack, GP_TILE_ACK);
+          gimp_wire_destroy (&ack);
+        }
+
+      gimp_wire_destroy (&msg);
+    }
+
+  return NULL;
+}
+
+/*  the plug-in end of the wire  */
+
+static void
+tile_wire_get_tiles (WireEnd *plug_in,
+                     guchar  *tile,
+                     gint     batch_size)
+{
+  gint tile_num;
+
+  for (tile_num = 0; tile_num < N_TILES; tile_num += batch_size)
+    {
+      GimpWireMessage msg;
+
+      if (batch_size == 1)
+        {
+          GPTileReq   req;
+          GPTileData *tile_data;
+
+          req.drawable_id = DRAWABLE_ID;
+          req.tile_num    = tile_num;
+          req.shadow      = FALSE;
+
+          if (! gp_tile_req_write (plug_in->write, &req, plug_in))
+            g_error ("plug-in: write error");
+
+          tile_wire_expect (plug_in, &msg, GP_TILE_DATA);
+
+          tile_data = msg.data;
+
+          memcpy (tile,
+                  tile_data->use_shm ? plug_in->shm : tile_data->data,
+                  TILE_SIZE);
+        }
+      else
+        {
+          GPTileBatchReq   req;
+          GPTileBatchData *batch_data;
+          guint32          tile_nums[GP_TILE_BATCH_MAX_TILES];
+          const guchar    *src;
+          gint             n_tiles = MIN (batch_size, N_TILES - tile_num);
+          gint             i;
+
+          for (i = 0; i < n_tiles; i++)
+            tile_nums[i] = tile_num + i;
+
+          req.drawable_id = DRAWABLE_ID;
+          req.shadow      = FALSE;
+          req.n_tiles     = n_tiles;
+          req.tile_nums   = tile_nums;
+
+          if (! gp_tile_batch_req_write (plug_in->write, &req, plug_in))
+            g_error ("plug-in: write error");
+
+          tile_wire_expect (plug_in, &msg, GP_TILE_BATCH_DATA);
+
+          batch_data = msg.data;
+
+          src = batch_data->use_shm ? plug_in->shm : batch_data->data;
+
+          for (i = 0; i < n_tiles; i++)
+            memcpy (tile, src + i * TILE_SIZE, TILE_SIZE);
+        }
+
+      if (! gp_tile_ack_write (plug_in->write, plug_in))
+        g_error ("plug-in: write error");
+
+      gimp_wire_destroy (&msg);
+    }
+}
+
+static void
+tile_wire_run (gboolean use_shm,
+               gint     batch_size)
+{
+  WireEnd  core;
+  WireEnd  plug_in;
+  GThread *thread;
+  GTimer  *timer;
+  guchar  *tile;
+  gint     to_core[2];
+  gint     to_plug_in[2];
+  gdouble  elapsed;
+
+  if (! g_unix_open_pipe (to_core,    FD_CLOEXEC, NULL) ||
+      ! g_unix_open_pipe (to_plug_in, FD_CLOEXEC, NULL))
+    {
+      g_error ("could not open pipes");
+    }
+
+  core.read     = tile_wire_channel_new (to_core[0]);
+  core.write    = tile_wire_channel_new (to_plug_in[1]);
+  core.shm      = g_malloc (SHM_SIZE);
+  core.pixels   = g_malloc0 (TILE_SIZE);
+  core.use_shm  = use_shm;
+
+  plug_in.read    = tile_wire_channel_new (to_plug_in[0]);
+  plug_in.write   = tile_wire_channel_new (to_core[1]);
+  plug_in.shm     = core.shm;
+  plug_in.pixels  = NULL;
+  plug_in.use_shm = use_shm;
+
+  tile = g_malloc (TILE_SIZE);
+
+  thread = g_thread_new ("core", tile_wire_core, &core);
+
+  timer = g_timer_new ();
+
+  tile_wire_get_tiles (&plug_in, tile, batch_size);
+
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  if (! gp_quit_write (plug_in.write, &plug_in))
+    g_error ("plug-in: write error");
+
+  g_thread_join (thread);
+
+  g_printerr ("  %-5s %3d tiles/request : %9.0f tiles/s  %7.1f MiB/s\n",
+              use_shm ? "shm" : "pipe",
+              batch_size,
+              N_TILES / elapsed,
+              N_TILES * (gdouble) TILE_SIZE / elapsed / (1 << 20));
+
+  g_timer_destroy (timer);
+  g_free (tile);
+  g_free (core.shm);
+  g_free (core.pixels);
+
+  g_io_channel_unref (core.read);
+  g_io_channel_unref (core.write);
+  g_io_channel_unref (plug_in.read);
+  g_io_channel_unref (plug_in.write);
+}
+
+int
+main (void)
+{
+  const gint batch_sizes[] = { 1, 4, 16, GP_TILE_BATCH_MAX_TILES };
+  gint       use_shm;
+  gint       i;
+
+  gp_init ();
+
+  gimp_wire_set_flusher (tile_wire_flush);
+
+  g_printerr ("Transferring %d tiles of %dx%d pixels, %d bytes per pixel...\n",
+              N_TILES, TILE_WIDTH, TILE_HEIGHT, TILE_BPP);
+
+  for (use_shm = TRUE; use_shm >= FALSE; use_shm--)
+    {
+      for (i = 0; i < G_N_ELEMENTS (batch_sizes); i++)
+        tile_wire_run (use_shm, batch_sizes[i]);
+    }
+
+  return EXIT_SUCCESS;
+}
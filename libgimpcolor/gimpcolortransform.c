@@ -65,6 +65,14 @@ enum
 };
 
 
+#define LUT_MIN_SIZE       33   /* grid points per channel of the first LUT  */
+#define LUT_MAX_SIZE       65   /* ... and of the finest one we try          */
+#define LUT_MAX_ERROR      2    /* largest error allowed, in 8-bit steps     */
+#define LUT_MAX_MEAN_ERROR 0.25 /* average error allowed, in 8-bit steps    */
+#define LUT_N_CHECKS       4096 /* number of random colors checked          */
+#define LUT_CHUNK_SIZE     1024 /* number of pixels converted at once       */
+
+
 struct _GimpColorTransformPrivate
 {
   GimpColorProfile *src_profile;
@@ -75,10 +83,31 @@ struct _GimpColorTransformPrivate
 
   cmsHTRANSFORM     transform;
   const Babl       *fish;
+
+  gfloat           *lut;
+  gint              lut_size;
+  const Babl       *lut_src_format;
+  const Babl       *lut_dest_format;
+  const Babl       *lut_src_fish;
+  const Babl       *lut_dest_fish;
 };
 
 
-static void   gimp_color_transform_finalize (GObject *object);
+static void         gimp_color_transform_finalize        (GObject                  *object);
+
+static void         gimp_color_transform_make_lut        (GimpColorTransform       *transform,
+                                                          cmsHPROFILE               src_lcms,
+                                                          cmsHPROFILE               dest_lcms,
+                                                          cmsHPROFILE               proof_lcms,
+                                                          GimpColorRenderingIntent  proof_intent,
+                                                          GimpColorRenderingIntent  intent,
+                                                          GimpColorTransformFlags   flags);
+static const Babl * gimp_color_transform_get_lut_format  (const Babl               *format);
+static gboolean     gimp_color_transform_check_lut       (GimpColorTransform       *transform);
+static void         gimp_color_transform_process_lut     (GimpColorTransform       *transform,
+                                                          gconstpointer             src,
+                                                          gpointer                  dest,
+                                                          gsize                     length);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpColorTransform, gimp_color_transform,
@@ -146,6 +175,7 @@ gimp_color_transform_finalize (GObject *object)
   g_clear_object (&transform->priv->dest_profile);
 
   g_clear_pointer (&transform->priv->transform, cmsDeleteTransform);
+  g_clear_pointer (&transform->priv->lut, g_free);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -266,7 +296,8 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
   priv->transform = cmsCreateTransform (src_lcms,  lcms_src_format,
                                         dest_lcms, lcms_dest_format,
                                         rendering_intent,
-                                        flags |
+                                        (flags &
+                                         ~GIMP_COLOR_TRANSFORM_FLAGS_LUT) |
                                         cmsFLAGS_COPY_ALPHA);
 
   if (lcms_last_error)
@@ -285,6 +316,13 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
       g_object_unref (transform);
       transform = NULL;
     }
+  else if (flags & GIMP_COLOR_TRANSFORM_FLAGS_LUT)
+    {
+      gimp_color_transform_make_lut (transform,
+                                     src_lcms, dest_lcms, NULL,
+                                     0, rendering_intent,
+                                     flags);
+    }
 
   return transform;
 }
@@ -359,7 +397,8 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
                                                 proof_lcms,
                                                 proof_intent,
                                                 display_intent,
-                                                flags                 |
+                                                (flags &
+                                                 ~GIMP_COLOR_TRANSFORM_FLAGS_LUT) |
                                                 cmsFLAGS_SOFTPROOFING |
                                                 cmsFLAGS_COPY_ALPHA);
 
@@ -379,6 +418,13 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
       g_object_unref (transform);
       transform = NULL;
     }
+  else if (flags & GIMP_COLOR_TRANSFORM_FLAGS_LUT)
+    {
+      gimp_color_transform_make_lut (transform,
+                                     src_lcms, dest_lcms, proof_lcms,
+                                     proof_intent, display_intent,
+                                     flags);
+    }
 
   return transform;
 }
@@ -455,7 +501,11 @@ gimp_color_transform_process_pixels (GimpColorTransform *transform,
       dest = dest_pixels;
     }
 
-  if (priv->transform)
+  if (priv->lut)
+    {
+      gimp_color_transform_process_lut (transform, src, dest, length);
+    }
+  else if (priv->transform)
     {
       cmsDoTransform (priv->transform, src, dest, length);
     }
@@ -555,7 +605,12 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
 
       while (gegl_buffer_iterator_next (iter))
         {
-          if (priv->transform)
+          if (priv->lut)
+            {
+              gimp_color_transform_process_lut (transform,
+                                                iter->items[0].data, iter->items[1].data, iter->length);
+            }
+          else if (priv->transform)
             {
               cmsDoTransform (priv->transform,
                               iter->items[0].data, iter->items[1].data, iter->length);
@@ -582,7 +637,12 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
 
       while (gegl_buffer_iterator_next (iter))
         {
-          if (priv->transform)
+          if (priv->lut)
+            {
+              gimp_color_transform_process_lut (transform,
+                                                iter->items[0].data, iter->items[0].data, iter->length);
+            }
+          else if (priv->transform)
             {
               cmsDoTransform (priv->transform,
                               iter->items[0].data, iter->items[0].data, iter->length);
@@ -640,3 +700,330 @@ gimp_color_transform_can_gegl_copy (GimpColorProfile *src_profile,
 
   return FALSE;
 }
+
+
+/*  private functions  */
+
+/*  bakes the transform into a LUT of the output colors at a grid of input
+ *  colors, which are interpolated tetrahedrally in between.  the LUT is
+ *  only kept if it gives the same 8-bit output as lcms, within a step or
+ *  two; otherwise, the transform keeps using lcms.
+ */
+static void
+gimp_color_transform_make_lut (GimpColorTransform       *transform,
+                               cmsHPROFILE               src_lcms,
+                               cmsHPROFILE               dest_lcms,
+                               cmsHPROFILE               proof_lcms,
+                               GimpColorRenderingIntent  proof_intent,
+                               GimpColorRenderingIntent  intent,
+                               GimpColorTransformFlags   flags)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+  cmsHTRANSFORM              lut_transform;
+  cmsUInt32Number            lcms_src_format;
+  cmsUInt32Number            lcms_dest_format;
+  gint                       size;
+
+  if (g_getenv ("GIMP_COLOR_TRANSFORM_DISABLE_LUT"))
+    return;
+
+  /*  the LUT would blur the edges of the gamut check's alarm color, and
+   *  not optimizing is asking for accuracy
+   */
+  if (flags & (GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE |
+               GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK))
+    return;
+
+  /*  the LUT is only accurate enough for 8-bit output  */
+  if (babl_format_get_type (priv->dest_format, 0) != babl_type ("u8"))
+    return;
+
+  priv->lut_src_format  = gimp_color_transform_get_lut_format (priv->src_format);
+  priv->lut_dest_format = gimp_color_transform_get_lut_format (priv->dest_format);
+
+  if (! priv->lut_src_format || ! priv->lut_dest_format)
+    return;
+
+  gimp_color_profile_get_lcms_format (priv->lut_src_format,
+                                      &lcms_src_format);
+  gimp_color_profile_get_lcms_format (priv->lut_dest_format,
+                                      &lcms_dest_format);
+
+  lcms_error_clear ();
+
+  /*  a transform with float output, for the LUT not to add 8-bit
+   *  rounding errors of its own
+   */
+  flags = (flags & ~GIMP_COLOR_TRANSFORM_FLAGS_LUT) | cmsFLAGS_COPY_ALPHA;
+
+  if (proof_lcms)
+    {
+      lut_transform = cmsCreateProofingTransform (src_lcms,  lcms_src_format,
+                                                  dest_lcms, lcms_dest_format,
+                                                  proof_lcms,
+                                                  proof_intent,
+                                                  intent,
+                                                  flags |
+                                                  cmsFLAGS_SOFTPROOFING);
+    }
+  else
+    {
+      lut_transform = cmsCreateTransform (src_lcms,  lcms_src_format,
+                                          dest_lcms, lcms_dest_format,
+                                          intent,
+                                          flags);
+    }
+
+  if (lcms_last_error || ! lut_transform)
+    {
+      if (lut_transform)
+        cmsDeleteTransform (lut_transform);
+
+      return;
+    }
+
+  priv->lut_src_fish  = babl_fish (priv->src_format,      priv->lut_src_format);
+  priv->lut_dest_fish = babl_fish (priv->lut_dest_format, priv->dest_format);
+
+  for (size = LUT_MIN_SIZE; size <= LUT_MAX_SIZE; size = 2 * size - 1)
+    {
+      gfloat *grid;
+      gint    n_points = size * size * size;
+      gint    r, g, b;
+      gint    i;
+
+      grid = g_new (gfloat, n_points * 4);
+
+      for (r = 0, i = 0; r < size; r++)
+        for (g = 0; g < size; g++)
+          for (b = 0; b < size; b++, i += 4)
+            {
+              grid[i + 0] = (gfloat) r / (size - 1);
+              grid[i + 1] = (gfloat) g / (size - 1);
+              grid[i + 2] = (gfloat) b / (size - 1);
+              grid[i + 3] = 1.0f;
+            }
+
+      cmsDoTransform (lut_transform, grid, grid, n_points);
+
+      priv->lut      = g_new (gfloat, n_points * 3);
+      priv->lut_size = size;
+
+      for (i = 0; i < n_points; i++)
+        {
+          priv->lut[i * 3 + 0] = grid[i * 4 + 0];
+          priv->lut[i * 3 + 1] = grid[i * 4 + 1];
+          priv->lut[i * 3 + 2] = grid[i * 4 + 2];
+        }
+
+      g_free (grid);
+
+      if (gimp_color_transform_check_lut (transform))
+        break;
+
+      g_clear_pointer (&priv->lut, g_free);
+    }
+
+  cmsDeleteTransform (lut_transform);
+}
+
+/*  returns the 4-channel float format with the same encoding as 'format',
+ *  as returned by gimp_color_profile_get_lcms_format(), or NULL if the
+ *  LUT can't be used for it
+ */
+static const Babl *
+gimp_color_transform_get_lut_format (const Babl *format)
+{
+  const Babl *model = babl_format_get_model (format);
+  const Babl *space = babl_format_get_space (format);
+
+  if (model == babl_model ("RGB") ||
+      model == babl_model ("RGBA"))
+    {
+      return babl_format_with_space ("RGBA float", space);
+    }
+  else if (model == babl_model ("R~G~B~") ||
+           model == babl_model ("R~G~B~A"))
+    {
+      return babl_format_with_space ("R~G~B~A float", space);
+    }
+  else if (model == babl_model ("R'G'B'") ||
+           model == babl_model ("R'G'B'A"))
+    {
+      return babl_format_with_space ("R'G'B'A float", space);
+    }
+
+  return NULL;
+}
+
+/*  compares the LUT's output against lcms', for random colors, which
+ *  mostly fall in between the LUT's grid points, where it's least accurate
+ */
+static gboolean
+gimp_color_transform_check_lut (GimpColorTransform *transform)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+  GRand                     *rand;
+  gfloat                    *colors;
+  guchar                    *src;
+  guchar                    *lcms_dest;
+  guchar                    *lut_dest;
+  gint                       dest_bpp;
+  gint                       max_error   = 0;
+  gint64                     total_error = 0;
+  gint                       i;
+
+  rand = g_rand_new_with_seed (priv->lut_size);
+
+  colors    = g_new (gfloat, LUT_N_CHECKS * 4);
+  src       = g_malloc (LUT_N_CHECKS *
+                        babl_format_get_bytes_per_pixel (priv->src_format));
+  dest_bpp  = babl_format_get_bytes_per_pixel (priv->dest_format);
+  lcms_dest = g_malloc (LUT_N_CHECKS * dest_bpp);
+  lut_dest  = g_malloc (LUT_N_CHECKS * dest_bpp);
+
+  for (i = 0; i < LUT_N_CHECKS * 4; i += 4)
+    {
+      colors[i + 0] = g_rand_double (rand);
+      colors[i + 1] = g_rand_double (rand);
+      colors[i + 2] = g_rand_double (rand);
+      colors[i + 3] = 1.0f;
+    }
+
+  babl_process (babl_fish (priv->lut_src_format, priv->src_format),
+                colors, src, LUT_N_CHECKS);
+
+  cmsDoTransform (priv->transform, src, lcms_dest, LUT_N_CHECKS);
+
+  gimp_color_transform_process_lut (transform, src, lut_dest, LUT_N_CHECKS);
+
+  for (i = 0; i < LUT_N_CHECKS * dest_bpp; i++)
+    {
+      gint error = ABS ((gint) lcms_dest[i] - (gint) lut_dest[i]);
+
+      max_error    = MAX (max_error, error);
+      total_error += error;
+    }
+
+  g_free (colors);
+  g_free (src);
+  g_free (lcms_dest);
+  g_free (lut_dest);
+
+  g_rand_free (rand);
+
+  return (max_error <= LUT_MAX_ERROR &&
+          (gdouble) total_error / (LUT_N_CHECKS * dest_bpp) <=
+          LUT_MAX_MEAN_ERROR);
+}
+
+static inline gfloat
+gimp_color_transform_lut_clamp (gfloat value)
+{
+  /*  NaNs end up as 0.0  */
+  return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+}
+
+static void
+gimp_color_transform_process_lut (GimpColorTransform *transform,
+                                  gconstpointer       src,
+                                  gpointer            dest,
+                                  gsize               length)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+  const gfloat              *lut  = priv->lut;
+  const guchar              *s    = src;
+  guchar                    *d    = dest;
+  gint                       size = priv->lut_size;
+  gint                       sr   = size * size * 3;
+  gint                       sg   = size * 3;
+  gint                       sb   = 3;
+  gint                       src_bpp;
+  gint                       dest_bpp;
+  gfloat                    *buf;
+
+  src_bpp  = babl_format_get_bytes_per_pixel (priv->src_format);
+  dest_bpp = babl_format_get_bytes_per_pixel (priv->dest_format);
+
+  buf = g_new (gfloat, MIN (length, LUT_CHUNK_SIZE) * 4);
+
+  while (length > 0)
+    {
+      gsize   n     = MIN (length, LUT_CHUNK_SIZE);
+      gfloat *pixel = buf;
+      gsize   i;
+
+      babl_process (priv->lut_src_fish, s, buf, n);
+
+      for (i = 0; i < n; i++, pixel += 4)
+        {
+          const gfloat *p;
+          gfloat        r  = gimp_color_transform_lut_clamp (pixel[0]) * (size - 1);
+          gfloat        g  = gimp_color_transform_lut_clamp (pixel[1]) * (size - 1);
+          gfloat        b  = gimp_color_transform_lut_clamp (pixel[2]) * (size - 1);
+          gint          r0 = MIN ((gint) r, size - 2);
+          gint          g0 = MIN ((gint) g, size - 2);
+          gint          b0 = MIN ((gint) b, size - 2);
+          gfloat        fr = r - r0;
+          gfloat        fg = g - g0;
+          gfloat        fb = b - b0;
+          gfloat        w1, w2, w3;
+          gint          o1, o2, o3;
+          gint          c;
+
+          /*  pick the tetrahedron of the grid cell that contains the
+           *  color, going from the cell's first corner to its last one
+           *  along the largest fraction first
+           */
+          if (fr >= fg)
+            {
+              if (fg >= fb)
+                {
+                  o1 = sr; o2 = sr + sg; w1 = fr; w2 = fg; w3 = fb;
+                }
+              else if (fr >= fb)
+                {
+                  o1 = sr; o2 = sr + sb; w1 = fr; w2 = fb; w3 = fg;
+                }
+              else
+                {
+                  o1 = sb; o2 = sr + sb; w1 = fb; w2 = fr; w3 = fg;
+                }
+            }
+          else
+            {
+              if (fb >= fg)
+                {
+                  o1 = sb; o2 = sg + sb; w1 = fb; w2 = fg; w3 = fr;
+                }
+              else if (fb >= fr)
+                {
+                  o1 = sg; o2 = sg + sb; w1 = fg; w2 = fb; w3 = fr;
+                }
+              else
+                {
+                  o1 = sg; o2 = sr + sg; w1 = fg; w2 = fr; w3 = fb;
+                }
+            }
+
+          o3 = sr + sg + sb;
+          p  = lut + r0 * sr + g0 * sg + b0 * sb;
+
+          for (c = 0; c < 3; c++)
+            {
+              pixel[c] = (p[c] +
+                          w1 * (p[o1 + c] - p[c])      +
+                          w2 * (p[o2 + c] - p[o1 + c]) +
+                          w3 * (p[o3 + c] - p[o2 + c]));
+            }
+        }
+
+      babl_process (priv->lut_dest_fish, buf, d, n);
+
+      s      += n * src_bpp;
+      d      += n * dest_bpp;
+      length -= n;
+    }
+
+  g_free (buf);
+}
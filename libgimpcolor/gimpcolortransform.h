@@ -40,6 +40,9 @@ G_BEGIN_DECLS
  *   transform result
  * @GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION: do black point
  *   compensation
+ * @GIMP_COLOR_TRANSFORM_FLAGS_LUT: bake the transform into a 3D lookup
+ *   table, when it transforms RGB to 8-bit RGB and the table is accurate
+ *   enough. Since: 3.0
  *
  * Flags for modifying #GimpColorTransform's behavior.
  **/
@@ -48,6 +51,7 @@ typedef enum
   GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE               = 0x0100,
   GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK              = 0x1000,
   GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION = 0x2000,
+  GIMP_COLOR_TRANSFORM_FLAGS_LUT                      = 0x10000000,
 } GimpColorTransformFlags;
 
 
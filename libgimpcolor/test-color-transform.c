@@ -0,0 +1,206 @@
+/* unit tests for the 3D LUT of color transforms in gimpcolortransform.c
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <babl/babl.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <glib-object.h>
+#include <cairo.h>
+
+#include "gimpcolor.h"
+
+
+#define N_PIXELS  (64 * 64 * 64)
+#define TOLERANCE 2
+
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *src_format;
+  gboolean     src_linear;
+  const gchar *dest_format;
+  gboolean     proofing;
+} TransformSample;
+
+static const TransformSample samples[] =
+{
+  /* name                     source format   linear  dest format     proof */
+
+  { "sRGB -> Adobe",          "R'G'B'A u8",   FALSE,  "R'G'B'A u8",   FALSE },
+  { "sRGB -> Adobe, RGB",     "R'G'B' u8",    FALSE,  "R'G'B' u8",    FALSE },
+  { "linear sRGB -> Adobe",   "RGBA float",   TRUE,   "R'G'B'A u8",   FALSE },
+  { "sRGB -> Adobe, proofed", "R'G'B'A u8",   FALSE,  "R'G'B'A u8",   TRUE  },
+};
+
+
+static GimpColorTransform *
+create_transform (const TransformSample   *sample,
+                  GimpColorTransformFlags  flags)
+{
+  GimpColorProfile   *src_profile;
+  GimpColorProfile   *dest_profile;
+  GimpColorTransform *transform;
+
+  if (sample->src_linear)
+    src_profile = gimp_color_profile_new_rgb_srgb_linear ();
+  else
+    src_profile = gimp_color_profile_new_rgb_srgb ();
+
+  dest_profile = gimp_color_profile_new_rgb_adobe ();
+
+  if (sample->proofing)
+    {
+      GimpColorProfile *proof_profile = gimp_color_profile_new_rgb_srgb ();
+
+      transform =
+        gimp_color_transform_new_proofing (src_profile,
+                                           babl_format (sample->src_format),
+                                           dest_profile,
+                                           babl_format (sample->dest_format),
+                                           proof_profile,
+                                           GIMP_COLOR_RENDERING_INTENT_RELATIVE_COLORIMETRIC,
+                                           GIMP_COLOR_RENDERING_INTENT_PERCEPTUAL,
+                                           flags);
+
+      g_object_unref (proof_profile);
+    }
+  else
+    {
+      transform =
+        gimp_color_transform_new (src_profile,
+                                  babl_format (sample->src_format),
+                                  dest_profile,
+                                  babl_format (sample->dest_format),
+                                  GIMP_COLOR_RENDERING_INTENT_PERCEPTUAL,
+                                  flags);
+    }
+
+  g_object_unref (src_profile);
+  g_object_unref (dest_profile);
+
+  return transform;
+}
+
+static gint
+check_transform (const TransformSample *sample,
+                 const gfloat          *colors)
+{
+  GimpColorTransform *exact;
+  GimpColorTransform *lut;
+  const Babl         *src_format  = babl_format (sample->src_format);
+  const Babl         *dest_format = babl_format (sample->dest_format);
+  guchar             *src;
+  guchar             *exact_dest;
+  guchar             *lut_dest;
+  gint                n_bytes;
+  gint                max_error   = 0;
+  gint                i;
+
+  exact = create_transform (sample, 0);
+  lut   = create_transform (sample, GIMP_COLOR_TRANSFORM_FLAGS_LUT);
+
+  if (! exact || ! lut)
+    {
+      g_print ("Couldn't create the \"%s\" transform!\n", sample->name);
+
+      g_clear_object (&exact);
+      g_clear_object (&lut);
+
+      return 1;
+    }
+
+  n_bytes    = N_PIXELS * babl_format_get_bytes_per_pixel (dest_format);
+  src        = g_malloc (N_PIXELS *
+                         babl_format_get_bytes_per_pixel (src_format));
+  exact_dest = g_malloc (n_bytes);
+  lut_dest   = g_malloc (n_bytes);
+
+  babl_process (babl_fish (babl_format ("R'G'B'A float"), src_format),
+                colors, src, N_PIXELS);
+
+  gimp_color_transform_process_pixels (exact,
+                                       src_format,  src,
+                                       dest_format, exact_dest,
+                                       N_PIXELS);
+  gimp_color_transform_process_pixels (lut,
+                                       src_format,  src,
+                                       dest_format, lut_dest,
+                                       N_PIXELS);
+
+  for (i = 0; i < n_bytes; i++)
+    max_error = MAX (max_error, ABS ((gint) exact_dest[i] - (gint) lut_dest[i]));
+
+  g_free (src);
+  g_free (exact_dest);
+  g_free (lut_dest);
+
+  g_object_unref (exact);
+  g_object_unref (lut);
+
+  if (max_error > TOLERANCE)
+    {
+      g_print ("Transform \"%s\" is off by %d with a LUT!\n",
+               sample->name, max_error);
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+main (void)
+{
+  gfloat *colors;
+  gint    failures = 0;
+  gint    r, g, b;
+  gint    i;
+
+  babl_init ();
+
+  /*  make sure the transforms go through lcms, which is what the LUT
+   *  replaces
+   */
+  g_setenv ("GIMP_COLOR_TRANSFORM_DISABLE_BABL", "1", TRUE);
+
+  g_print ("\nTesting the GIMP color transform LUT ...\n");
+
+  /*  a grid of colors that doesn't line up with the LUT's grid, plus its
+   *  corners
+   */
+  colors = g_new (gfloat, N_PIXELS * 4);
+
+  for (r = 0, i = 0; r < 64; r++)
+    for (g = 0; g < 64; g++)
+      for (b = 0; b < 64; b++, i += 4)
+        {
+          colors[i + 0] = (gfloat) r / 63.0f;
+          colors[i + 1] = (gfloat) g / 63.0f;
+          colors[i + 2] = (gfloat) b / 63.0f;
+          colors[i + 3] = (gfloat) ((r + g + b) % 4) / 3.0f;
+        }
+
+  for (i = 0; i < G_N_ELEMENTS (samples); i++)
+    failures += check_transform (samples + i, colors);
+
+  g_free (colors);
+
+  babl_exit ();
+
+  if (failures)
+    {
+      g_print ("%d out of %d samples failed!\n\n",
+               failures, (int)G_N_ELEMENTS (samples));
+      return EXIT_FAILURE;
+    }
+  else
+    {
+      g_print ("All %d samples passed.\n\n", (int)G_N_ELEMENTS (samples));
+      return EXIT_SUCCESS;
+    }
+}
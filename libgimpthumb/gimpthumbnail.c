@@ -487,6 +487,77 @@ gimp_thumbnail_set_from_thumb (GimpThumbnail  *thumbnail,
   return TRUE;
 }
 
+/**
+ * gimp_thumbnail_set_from_thumbnail:
+ * @thumbnail: a #GimpThumbnail object
+ * @source:    another #GimpThumbnail object for the same image URI
+ *
+ * Copies what @source knows about the image file and its thumbnail
+ * to @thumbnail, as if @thumbnail had been peeked or loaded itself.
+ *
+ * This allows checking and loading thumbnails in another thread, on
+ * a #GimpThumbnail object that no one else uses, and then updating
+ * the one that is shown, which emits its notifications in the thread
+ * that owns it.
+ *
+ * Since: 3.0
+ **/
+void
+gimp_thumbnail_set_from_thumbnail (GimpThumbnail *thumbnail,
+                                   GimpThumbnail *source)
+{
+  g_return_if_fail (GIMP_IS_THUMBNAIL (thumbnail));
+  g_return_if_fail (GIMP_IS_THUMBNAIL (source));
+  g_return_if_fail (g_strcmp0 (thumbnail->image_uri,
+                               source->image_uri) == 0);
+
+  GIMP_THUMB_DEBUG_CALL (thumbnail);
+
+  g_object_freeze_notify (G_OBJECT (thumbnail));
+
+  /*  the filenames go first, the states they back may be notified  */
+  if (g_strcmp0 (thumbnail->image_filename, source->image_filename))
+    {
+      g_free (thumbnail->image_filename);
+      thumbnail->image_filename = g_strdup (source->image_filename);
+    }
+
+  thumbnail->image_not_found_errno = source->image_not_found_errno;
+
+  if (g_strcmp0 (thumbnail->thumb_filename, source->thumb_filename))
+    {
+      g_free (thumbnail->thumb_filename);
+      thumbnail->thumb_filename = g_strdup (source->thumb_filename);
+    }
+
+  thumbnail->thumb_size     = source->thumb_size;
+  thumbnail->thumb_filesize = source->thumb_filesize;
+  thumbnail->thumb_mtime    = source->thumb_mtime;
+
+  /*  like the updates, only notify the states when they change  */
+  if (source->image_state != thumbnail->image_state)
+    g_object_set (thumbnail,
+                  "image-state", source->image_state,
+                  NULL);
+
+  if (source->thumb_state != thumbnail->thumb_state)
+    g_object_set (thumbnail,
+                  "thumb-state", source->thumb_state,
+                  NULL);
+
+  g_object_set (thumbnail,
+                "image-mtime",      source->image_mtime,
+                "image-filesize",   source->image_filesize,
+                "image-mimetype",   source->image_mimetype,
+                "image-width",      source->image_width,
+                "image-height",     source->image_height,
+                "image-type",       source->image_type,
+                "image-num-layers", source->image_num_layers,
+                NULL);
+
+  g_object_thaw_notify (G_OBJECT (thumbnail));
+}
+
 /**
  * gimp_thumbnail_peek_image:
  * @thumbnail: a #GimpThumbnail object
@@ -105,6 +105,9 @@ gboolean         gimp_thumbnail_set_filename     (GimpThumbnail  *thumbnail,
 gboolean         gimp_thumbnail_set_from_thumb   (GimpThumbnail  *thumbnail,
                                                   const gchar    *filename,
                                                   GError        **error);
+void             gimp_thumbnail_set_from_thumbnail
+                                                 (GimpThumbnail  *thumbnail,
+                                                  GimpThumbnail  *source);
 
 GimpThumbState   gimp_thumbnail_peek_image       (GimpThumbnail  *thumbnail);
 GimpThumbState   gimp_thumbnail_peek_thumb       (GimpThumbnail  *thumbnail,
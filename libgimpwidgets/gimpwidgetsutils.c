@@ -838,7 +838,7 @@ gimp_widget_get_color_transform (GtkWidget        *widget,
 
   if (cache->proof_profile)
     {
-      GimpColorTransformFlags flags = 0;
+      GimpColorTransformFlags flags = GIMP_COLOR_TRANSFORM_FLAGS_LUT;
 
       if (gimp_color_config_get_simulation_bpc (config))
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION;
@@ -876,7 +876,7 @@ gimp_widget_get_color_transform (GtkWidget        *widget,
     }
   else
     {
-      GimpColorTransformFlags flags = 0;
+      GimpColorTransformFlags flags = GIMP_COLOR_TRANSFORM_FLAGS_LUT;
 
       if (gimp_color_config_get_display_bpc (config))
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION;
@@ -553,8 +553,8 @@ compute_lic (GimpDrawable *drawable,
   GimpRGB     color;
   gdouble     vx, vy, tmp;
 
-  src_buffer  = gimp_drawable_get_buffer (drawable);
-  dest_buffer = gimp_drawable_get_shadow_buffer (drawable);
+  src_buffer  = gimp_drawable_map_buffer (drawable);
+  dest_buffer = gimp_drawable_map_shadow_buffer (drawable);
 
   for (ycount = 0; ycount < border_h; ycount++)
     {
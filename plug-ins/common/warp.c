@@ -1525,7 +1525,7 @@ warp_one (GimpDrawable *draw,
 
   /*  --------- Register the (many) pixel regions ----------  */
 
-  src_buffer = gimp_drawable_get_buffer (draw);
+  src_buffer = gimp_drawable_map_buffer (draw);
 
   src_format = get_u8_format (draw);
   src_bytes  = babl_format_get_bytes_per_pixel (src_format);
@@ -1536,7 +1536,7 @@ warp_one (GimpDrawable *draw,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 5);
 
 
-  dest_buffer = gimp_drawable_get_shadow_buffer (new);
+  dest_buffer = gimp_drawable_map_shadow_buffer (new);
 
   dest_format = get_u8_format (new);
   dest_bytes  = babl_format_get_bytes_per_pixel (dest_format);
@@ -1547,7 +1547,7 @@ warp_one (GimpDrawable *draw,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
 
-  map_x_buffer = gimp_drawable_get_buffer (map_x);
+  map_x_buffer = gimp_drawable_map_buffer (map_x);
 
   map_x_format = get_u8_format (map_x);
   map_x_bytes  = babl_format_get_bytes_per_pixel (map_x_format);
@@ -1558,7 +1558,7 @@ warp_one (GimpDrawable *draw,
                             GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
 
-  map_y_buffer = gimp_drawable_get_buffer (map_y);
+  map_y_buffer = gimp_drawable_map_buffer (map_y);
 
   map_y_format = get_u8_format (map_y);
   map_y_bytes  = babl_format_get_bytes_per_pixel (map_y_format);
@@ -1571,7 +1571,7 @@ warp_one (GimpDrawable *draw,
 
   if (dvals.mag_use)
     {
-      mag_buffer = gimp_drawable_get_buffer (mag_draw);
+      mag_buffer = gimp_drawable_map_buffer (mag_draw);
 
       mag_format = get_u8_format (mag_draw);
       mag_bytes  = babl_format_get_bytes_per_pixel (mag_format);